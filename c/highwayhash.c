@@ -6,9 +6,27 @@
 
 /*
 This code is compatible with C90 with the additional requirement of
-supporting uint64_t.
+supporting uint64_t. The optional SIMD implementations below additionally
+require GCC or Clang on x86-64 (for target attributes and runtime CPU
+detection) or AArch64 NEON; compile with -DHH_C_DISABLE_SIMD to omit them.
 */
 
+#if !defined(HH_C_DISABLE_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define HH_C_X86 1
+#include <immintrin.h>
+#else
+#define HH_C_X86 0
+#endif
+
+#if !defined(HH_C_DISABLE_SIMD) && defined(__aarch64__) && \
+    defined(__ARM_NEON) && defined(__ORDER_LITTLE_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HH_C_NEON 1
+#include <arm_neon.h>
+#else
+#define HH_C_NEON 0
+#endif
+
 /*////////////////////////////////////////////////////////////////////////////*/
 /* Internal implementation                                                    */
 /*////////////////////////////////////////////////////////////////////////////*/
@@ -84,12 +102,14 @@ static void Rotate32By(uint64_t count, uint64_t lanes[4]) {
   }
 }
 
-void HighwayHashUpdateRemainder(const uint8_t* bytes, const size_t size_mod32,
-                                HighwayHashState* state) {
+/* Prepares the state for the final 1..31 bytes and copies them into the
+   "packet" that is then passed to Update. */
+static void PrepareRemainder(const uint8_t* bytes, const size_t size_mod32,
+                             HighwayHashState* state, uint8_t packet[32]) {
   int i;
   const size_t size_mod4 = size_mod32 & 3;
   const uint8_t* remainder = bytes + (size_mod32 & ~3);
-  uint8_t packet[32] = {0};
+  memset(packet, 0, 32);
   for (i = 0; i < 4; ++i) {
     state->v0[i] += ((uint64_t)size_mod32 << 32) + size_mod32;
   }
@@ -108,7 +128,6 @@ void HighwayHashUpdateRemainder(const uint8_t* bytes, const size_t size_mod32,
       packet[16 + 2] = remainder[size_mod4 - 1];
     }
   }
-  HighwayHashUpdatePacket(packet, state);
 }
 
 static void Permute(const uint64_t v[4], uint64_t* permuted) {
@@ -124,6 +143,322 @@ void PermuteAndUpdate(HighwayHashState* state) {
   Update(permuted, state);
 }
 
+/*////////////////////////////////////////////////////////////////////////////*/
+/* Implementations, chosen at runtime                                         */
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/* Each implementation loads the state, updates it with "num_packets"
+   consecutive 32-byte packets or "num_rounds" PermuteAndUpdate, and stores it
+   again. All return the same results as the portable version. */
+typedef struct {
+  unsigned target;
+  void (*update_packets)(const uint8_t* packets, size_t num_packets,
+                         HighwayHashState* state);
+  void (*permute_and_update)(int num_rounds, HighwayHashState* state);
+} Implementation;
+
+static void UpdatePacketsPortable(const uint8_t* packets, size_t num_packets,
+                                  HighwayHashState* state) {
+  size_t i;
+  for (i = 0; i < num_packets; ++i) {
+    HighwayHashUpdatePacket(packets + i * 32, state);
+  }
+}
+
+static void PermuteAndUpdatePortable(int num_rounds, HighwayHashState* state) {
+  int i;
+  for (i = 0; i < num_rounds; ++i) {
+    PermuteAndUpdate(state);
+  }
+}
+
+static const Implementation kPortable = {
+    HH_C_TARGET_PORTABLE, UpdatePacketsPortable, PermuteAndUpdatePortable};
+
+#if HH_C_X86
+
+/* Byte indices of ZipperMergeAndAdd within each 128-bit half. */
+#define HH_C_ZIPPER_HI 0x070806090D0A040Bll
+#define HH_C_ZIPPER_LO 0x000F010E05020C03ll
+
+/* L = lanes 0 and 1, H = lanes 2 and 3. */
+typedef struct {
+  __m128i v0L, v0H, v1L, v1H, mul0L, mul0H, mul1L, mul1H;
+} StateSSE41;
+
+__attribute__((target("sse4.1")))
+static void LoadSSE41(const HighwayHashState* state, StateSSE41* s) {
+  s->v0L = _mm_loadu_si128((const __m128i*)(state->v0 + 0));
+  s->v0H = _mm_loadu_si128((const __m128i*)(state->v0 + 2));
+  s->v1L = _mm_loadu_si128((const __m128i*)(state->v1 + 0));
+  s->v1H = _mm_loadu_si128((const __m128i*)(state->v1 + 2));
+  s->mul0L = _mm_loadu_si128((const __m128i*)(state->mul0 + 0));
+  s->mul0H = _mm_loadu_si128((const __m128i*)(state->mul0 + 2));
+  s->mul1L = _mm_loadu_si128((const __m128i*)(state->mul1 + 0));
+  s->mul1H = _mm_loadu_si128((const __m128i*)(state->mul1 + 2));
+}
+
+__attribute__((target("sse4.1")))
+static void StoreSSE41(const StateSSE41* s, HighwayHashState* state) {
+  _mm_storeu_si128((__m128i*)(state->v0 + 0), s->v0L);
+  _mm_storeu_si128((__m128i*)(state->v0 + 2), s->v0H);
+  _mm_storeu_si128((__m128i*)(state->v1 + 0), s->v1L);
+  _mm_storeu_si128((__m128i*)(state->v1 + 2), s->v1H);
+  _mm_storeu_si128((__m128i*)(state->mul0 + 0), s->mul0L);
+  _mm_storeu_si128((__m128i*)(state->mul0 + 2), s->mul0H);
+  _mm_storeu_si128((__m128i*)(state->mul1 + 0), s->mul1L);
+  _mm_storeu_si128((__m128i*)(state->mul1 + 2), s->mul1H);
+}
+
+/* Same as Update for one 128-bit half. */
+__attribute__((target("sse4.1")))
+static void UpdateHalfSSE41(const __m128i packet, __m128i* v0, __m128i* v1,
+                            __m128i* mul0, __m128i* mul1) {
+  const __m128i zipper = _mm_set_epi64x(HH_C_ZIPPER_HI, HH_C_ZIPPER_LO);
+  *v1 = _mm_add_epi64(*v1, _mm_add_epi64(*mul0, packet));
+  *mul0 = _mm_xor_si128(*mul0, _mm_mul_epu32(*v1, _mm_srli_epi64(*v0, 32)));
+  *v0 = _mm_add_epi64(*v0, *mul1);
+  *mul1 = _mm_xor_si128(*mul1, _mm_mul_epu32(*v0, _mm_srli_epi64(*v1, 32)));
+  *v0 = _mm_add_epi64(*v0, _mm_shuffle_epi8(*v1, zipper));
+  *v1 = _mm_add_epi64(*v1, _mm_shuffle_epi8(*v0, zipper));
+}
+
+__attribute__((target("sse4.1")))
+static void UpdatePacketsSSE41(const uint8_t* packets, size_t num_packets,
+                               HighwayHashState* state) {
+  StateSSE41 s;
+  size_t i;
+  LoadSSE41(state, &s);
+  for (i = 0; i < num_packets; ++i) {
+    const __m128i* packet = (const __m128i*)(packets + i * 32);
+    UpdateHalfSSE41(_mm_loadu_si128(packet + 0), &s.v0L, &s.v1L, &s.mul0L,
+                    &s.mul1L);
+    UpdateHalfSSE41(_mm_loadu_si128(packet + 1), &s.v0H, &s.v1H, &s.mul0H,
+                    &s.mul1H);
+  }
+  StoreSSE41(&s, state);
+}
+
+__attribute__((target("sse4.1")))
+static void PermuteAndUpdateSSE41(int num_rounds, HighwayHashState* state) {
+  StateSSE41 s;
+  int i;
+  LoadSSE41(state, &s);
+  for (i = 0; i < num_rounds; ++i) {
+    /* See Permute: swapped halves and 32-bit words. */
+    const __m128i permutedL = _mm_shuffle_epi32(s.v0H, _MM_SHUFFLE(2, 3, 0, 1));
+    const __m128i permutedH = _mm_shuffle_epi32(s.v0L, _MM_SHUFFLE(2, 3, 0, 1));
+    UpdateHalfSSE41(permutedL, &s.v0L, &s.v1L, &s.mul0L, &s.mul1L);
+    UpdateHalfSSE41(permutedH, &s.v0H, &s.v1H, &s.mul0H, &s.mul1H);
+  }
+  StoreSSE41(&s, state);
+}
+
+static const Implementation kSSE41 = {
+    HH_C_TARGET_SSE41, UpdatePacketsSSE41, PermuteAndUpdateSSE41};
+
+typedef struct {
+  __m256i v0, v1, mul0, mul1;
+} StateAVX2;
+
+__attribute__((target("avx2")))
+static void LoadAVX2(const HighwayHashState* state, StateAVX2* s) {
+  s->v0 = _mm256_loadu_si256((const __m256i*)state->v0);
+  s->v1 = _mm256_loadu_si256((const __m256i*)state->v1);
+  s->mul0 = _mm256_loadu_si256((const __m256i*)state->mul0);
+  s->mul1 = _mm256_loadu_si256((const __m256i*)state->mul1);
+}
+
+__attribute__((target("avx2")))
+static void StoreAVX2(const StateAVX2* s, HighwayHashState* state) {
+  _mm256_storeu_si256((__m256i*)state->v0, s->v0);
+  _mm256_storeu_si256((__m256i*)state->v1, s->v1);
+  _mm256_storeu_si256((__m256i*)state->mul0, s->mul0);
+  _mm256_storeu_si256((__m256i*)state->mul1, s->mul1);
+}
+
+__attribute__((target("avx2")))
+static void UpdateAVX2(const __m256i packet, StateAVX2* s) {
+  const __m256i zipper = _mm256_set_epi64x(HH_C_ZIPPER_HI, HH_C_ZIPPER_LO,
+                                           HH_C_ZIPPER_HI, HH_C_ZIPPER_LO);
+  s->v1 = _mm256_add_epi64(s->v1, _mm256_add_epi64(s->mul0, packet));
+  s->mul0 = _mm256_xor_si256(
+      s->mul0, _mm256_mul_epu32(s->v1, _mm256_srli_epi64(s->v0, 32)));
+  s->v0 = _mm256_add_epi64(s->v0, s->mul1);
+  s->mul1 = _mm256_xor_si256(
+      s->mul1, _mm256_mul_epu32(s->v0, _mm256_srli_epi64(s->v1, 32)));
+  s->v0 = _mm256_add_epi64(s->v0, _mm256_shuffle_epi8(s->v1, zipper));
+  s->v1 = _mm256_add_epi64(s->v1, _mm256_shuffle_epi8(s->v0, zipper));
+}
+
+__attribute__((target("avx2")))
+static void UpdatePacketsAVX2(const uint8_t* packets, size_t num_packets,
+                              HighwayHashState* state) {
+  StateAVX2 s;
+  size_t i;
+  LoadAVX2(state, &s);
+  for (i = 0; i < num_packets; ++i) {
+    UpdateAVX2(_mm256_loadu_si256((const __m256i*)(packets + i * 32)), &s);
+  }
+  StoreAVX2(&s, state);
+}
+
+__attribute__((target("avx2")))
+static void PermuteAndUpdateAVX2(int num_rounds, HighwayHashState* state) {
+  /* See Permute: 32-bit words of lanes 2, 3, 0, 1, each pair swapped. */
+  const __m256i indices = _mm256_setr_epi32(5, 4, 7, 6, 1, 0, 3, 2);
+  StateAVX2 s;
+  int i;
+  LoadAVX2(state, &s);
+  for (i = 0; i < num_rounds; ++i) {
+    UpdateAVX2(_mm256_permutevar8x32_epi32(s.v0, indices), &s);
+  }
+  StoreAVX2(&s, state);
+}
+
+static const Implementation kAVX2 = {
+    HH_C_TARGET_AVX2, UpdatePacketsAVX2, PermuteAndUpdateAVX2};
+
+#endif /* HH_C_X86 */
+
+#if HH_C_NEON
+
+/* L = lanes 0 and 1, H = lanes 2 and 3. */
+typedef struct {
+  uint64x2_t v0L, v0H, v1L, v1H, mul0L, mul0H, mul1L, mul1H;
+} StateNEON;
+
+static void LoadNEON(const HighwayHashState* state, StateNEON* s) {
+  s->v0L = vld1q_u64(state->v0 + 0);
+  s->v0H = vld1q_u64(state->v0 + 2);
+  s->v1L = vld1q_u64(state->v1 + 0);
+  s->v1H = vld1q_u64(state->v1 + 2);
+  s->mul0L = vld1q_u64(state->mul0 + 0);
+  s->mul0H = vld1q_u64(state->mul0 + 2);
+  s->mul1L = vld1q_u64(state->mul1 + 0);
+  s->mul1H = vld1q_u64(state->mul1 + 2);
+}
+
+static void StoreNEON(const StateNEON* s, HighwayHashState* state) {
+  vst1q_u64(state->v0 + 0, s->v0L);
+  vst1q_u64(state->v0 + 2, s->v0H);
+  vst1q_u64(state->v1 + 0, s->v1L);
+  vst1q_u64(state->v1 + 2, s->v1H);
+  vst1q_u64(state->mul0 + 0, s->mul0L);
+  vst1q_u64(state->mul0 + 2, s->mul0H);
+  vst1q_u64(state->mul1 + 0, s->mul1L);
+  vst1q_u64(state->mul1 + 2, s->mul1H);
+}
+
+/* Byte indices of ZipperMergeAndAdd. */
+static const uint8_t kZipperNEON[16] = {3,  12, 2,  5,  14, 1, 15, 0,
+                                        11, 4,  10, 13, 9,  6, 8,  7};
+
+static uint64x2_t ZipperMergeNEON(const uint64x2_t v, const uint8x16_t zipper) {
+  return vreinterpretq_u64_u8(vqtbl1q_u8(vreinterpretq_u8_u64(v), zipper));
+}
+
+/* Same as Update for one 128-bit half. */
+static void UpdateHalfNEON(const uint64x2_t packet, uint64x2_t* v0,
+                           uint64x2_t* v1, uint64x2_t* mul0,
+                           uint64x2_t* mul1) {
+  const uint8x16_t zipper = vld1q_u8(kZipperNEON);
+  *v1 = vaddq_u64(*v1, vaddq_u64(*mul0, packet));
+  *mul0 = veorq_u64(*mul0, vmull_u32(vmovn_u64(*v1), vshrn_n_u64(*v0, 32)));
+  *v0 = vaddq_u64(*v0, *mul1);
+  *mul1 = veorq_u64(*mul1, vmull_u32(vmovn_u64(*v0), vshrn_n_u64(*v1, 32)));
+  *v0 = vaddq_u64(*v0, ZipperMergeNEON(*v1, zipper));
+  *v1 = vaddq_u64(*v1, ZipperMergeNEON(*v0, zipper));
+}
+
+static uint64x2_t Rotate64By32NEON(const uint64x2_t v) {
+  return vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(v)));
+}
+
+static void UpdatePacketsNEON(const uint8_t* packets, size_t num_packets,
+                              HighwayHashState* state) {
+  StateNEON s;
+  size_t i;
+  LoadNEON(state, &s);
+  for (i = 0; i < num_packets; ++i) {
+    const uint8_t* packet = packets + i * 32;
+    UpdateHalfNEON(vreinterpretq_u64_u8(vld1q_u8(packet + 0)), &s.v0L, &s.v1L,
+                   &s.mul0L, &s.mul1L);
+    UpdateHalfNEON(vreinterpretq_u64_u8(vld1q_u8(packet + 16)), &s.v0H,
+                   &s.v1H, &s.mul0H, &s.mul1H);
+  }
+  StoreNEON(&s, state);
+}
+
+static void PermuteAndUpdateNEON(int num_rounds, HighwayHashState* state) {
+  StateNEON s;
+  int i;
+  LoadNEON(state, &s);
+  for (i = 0; i < num_rounds; ++i) {
+    /* See Permute: swapped halves and 32-bit words. */
+    const uint64x2_t permutedL = Rotate64By32NEON(s.v0H);
+    const uint64x2_t permutedH = Rotate64By32NEON(s.v0L);
+    UpdateHalfNEON(permutedL, &s.v0L, &s.v1L, &s.mul0L, &s.mul1L);
+    UpdateHalfNEON(permutedH, &s.v0H, &s.v1H, &s.mul0H, &s.mul1H);
+  }
+  StoreNEON(&s, state);
+}
+
+static const Implementation kNEON = {
+    HH_C_TARGET_NEON, UpdatePacketsNEON, PermuteAndUpdateNEON};
+
+#endif /* HH_C_NEON */
+
+/* Targets excluded by HighwayHashRestrictTargets. */
+static unsigned disabled_targets = 0;
+
+unsigned HighwayHashSupportedTargets(void) {
+  unsigned targets = HH_C_TARGET_PORTABLE;
+#if HH_C_X86
+  if (__builtin_cpu_supports("sse4.1")) targets |= HH_C_TARGET_SSE41;
+  if (__builtin_cpu_supports("avx2")) targets |= HH_C_TARGET_AVX2;
+#endif
+#if HH_C_NEON
+  targets |= HH_C_TARGET_NEON; /* always available on AArch64 */
+#endif
+  return targets;
+}
+
+void HighwayHashRestrictTargets(unsigned targets) {
+  disabled_targets = ~(targets | HH_C_TARGET_PORTABLE);
+}
+
+/* Returns the best supported and enabled implementation. Checking every call
+   is cheap because __builtin_cpu_supports only tests a variable that the
+   runtime initializes at startup. */
+static const Implementation* Best(void) {
+#if HH_C_X86
+  if (!(disabled_targets & HH_C_TARGET_AVX2) &&
+      __builtin_cpu_supports("avx2")) {
+    return &kAVX2;
+  }
+  if (!(disabled_targets & HH_C_TARGET_SSE41) &&
+      __builtin_cpu_supports("sse4.1")) {
+    return &kSSE41;
+  }
+#endif
+#if HH_C_NEON
+  if (!(disabled_targets & HH_C_TARGET_NEON)) return &kNEON;
+#endif
+  return &kPortable;
+}
+
+unsigned HighwayHashCurrentTarget(void) {
+  return Best()->target;
+}
+
+void HighwayHashUpdateRemainder(const uint8_t* bytes, const size_t size_mod32,
+                                HighwayHashState* state) {
+  uint8_t packet[32];
+  PrepareRemainder(bytes, size_mod32, state, packet);
+  Best()->update_packets(packet, 1, state);
+}
+
 static void ModularReduction(uint64_t a3_unmasked, uint64_t a2, uint64_t a1,
                              uint64_t a0, uint64_t* m1, uint64_t* m0) {
   uint64_t a3 = a3_unmasked & 0x3FFFFFFFFFFFFFFFull;
@@ -132,31 +467,22 @@ static void ModularReduction(uint64_t a3_unmasked, uint64_t a2, uint64_t a1,
 }
 
 static uint64_t HighwayHashFinalize64(HighwayHashState* state) {
-  int i;
-  for (i = 0; i < 4; i++) {
-    PermuteAndUpdate(state);
-  }
+  Best()->permute_and_update(4, state);
   return state->v0[0] + state->v1[0] + state->mul0[0] + state->mul1[0];
 }
 
 static void HighwayHashFinalize128(HighwayHashState* state, uint64_t hash[2]) {
-  int i;
-  for (i = 0; i < 6; i++) {
-    PermuteAndUpdate(state);
-  }
+  Best()->permute_and_update(6, state);
   hash[0] = state->v0[0] + state->mul0[0] + state->v1[2] + state->mul1[2];
   hash[1] = state->v0[1] + state->mul0[1] + state->v1[3] + state->mul1[3];
 }
 
 static void HighwayHashFinalize256(HighwayHashState* state, uint64_t hash[4]) {
-  int i;
   /* We anticipate that 256-bit hashing will be mostly used with long messages
      because storing and using the 256-bit hash (in contrast to 128-bit)
      carries a larger additional constant cost by itself. Doing extra rounds
      here hardly increases the per-byte cost of long messages. */
-  for (i = 0; i < 10; i++) {
-    PermuteAndUpdate(state);
-  }
+  Best()->permute_and_update(10, state);
   ModularReduction(state->v1[1] + state->mul1[1], state->v1[0] + state->mul1[0],
                    state->v0[1] + state->mul0[1], state->v0[0] + state->mul0[0],
                    &hash[1], &hash[0]);
@@ -171,12 +497,14 @@ static void HighwayHashFinalize256(HighwayHashState* state, uint64_t hash[4]) {
 
 static void ProcessAll(const uint8_t* data, size_t size, const uint64_t key[4],
                        HighwayHashState* state) {
-  size_t i;
+  const Implementation* impl = Best();
   HighwayHashReset(key, state);
-  for (i = 0; i + 32 <= size; i += 32) {
-    HighwayHashUpdatePacket(data + i, state);
+  impl->update_packets(data, size / 32, state);
+  if ((size & 31) != 0) {
+    uint8_t packet[32];
+    PrepareRemainder(data + (size & ~(size_t)31), size & 31, state, packet);
+    impl->update_packets(packet, 1, state);
   }
-  if ((size & 31) != 0) HighwayHashUpdateRemainder(data + i, size & 31, state);
 }
 
 uint64_t HighwayHash64(const uint8_t* data, size_t size,
@@ -225,10 +553,10 @@ void HighwayHashCatAppend(const uint8_t* bytes, size_t num,
       state->num = 0;
     }
   }
-  while (num >= 32) {
-    HighwayHashUpdatePacket(bytes, &state->state);
-    num -= 32;
-    bytes += 32;
+  if (num >= 32) {
+    Best()->update_packets(bytes, num / 32, &state->state);
+    bytes += num & ~(size_t)31;
+    num &= 31;
   }
   for (i = 0; i < num; i++) {
     state->packet[state->num] = bytes[i];
@@ -64,6 +64,28 @@ uint64_t HighwayHashCatFinish64(const HighwayHashCat* state);
 void HighwayHashCatFinish128(const HighwayHashCat* state, uint64_t hash[2]);
 void HighwayHashCatFinish256(const HighwayHashCat* state, uint64_t hash[4]);
 
+/*////////////////////////////////////////////////////////////////////////////*/
+/* Implementations: SIMD on x86-64 (SSE4.1, AVX2) and AArch64 (NEON)          */
+/*////////////////////////////////////////////////////////////////////////////*/
+
+/* All functions above use the best implementation that the CPU supports,
+   checked on every call. They all return the same hashes. */
+#define HH_C_TARGET_PORTABLE 1
+#define HH_C_TARGET_SSE41 2
+#define HH_C_TARGET_AVX2 4
+#define HH_C_TARGET_NEON 8
+
+/* Returns the HH_C_TARGET_* bits that this build and CPU support. */
+unsigned HighwayHashSupportedTargets(void);
+
+/* Returns the HH_C_TARGET_* that hashing currently uses. */
+unsigned HighwayHashCurrentTarget(void);
+
+/* Limits subsequent hashing to the given HH_C_TARGET_* bits (the portable
+   version is always allowed), e.g. for testing or benchmarking each target.
+   Not thread-safe: only call while no other thread is hashing. */
+void HighwayHashRestrictTargets(unsigned targets);
+
 /*
 Usage examples:
 
@@ -3,6 +3,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define kMaxSize 64
 
@@ -49,18 +50,75 @@ void TestHash64(uint64_t expected, const uint8_t* data, size_t size,
   }
 }
 
+/* Compares all hash sizes and the cat API of the current target with the
+   portable implementation for all sizes up to 3 packets. */
+void TestTargetMatchesPortable(unsigned target) {
+  uint8_t data[97];
+  uint64_t expected[7];
+  uint64_t hash[7];
+  size_t size, split;
+  int i;
+  for (i = 0; i < 97; i++) {
+    data[i] = (uint8_t)(i * 7 + 3);
+  }
+  for (size = 0; size <= 96; size++) {
+    HighwayHashRestrictTargets(HH_C_TARGET_PORTABLE);
+    expected[0] = HighwayHash64(data, size, kTestKey1);
+    HighwayHash128(data, size, kTestKey1, expected + 1);
+    HighwayHash256(data, size, kTestKey1, expected + 3);
+
+    HighwayHashRestrictTargets(target);
+    hash[0] = HighwayHash64(data, size, kTestKey1);
+    HighwayHash128(data, size, kTestKey1, hash + 1);
+    HighwayHash256(data, size, kTestKey1, hash + 3);
+    if (memcmp(expected, hash, sizeof(hash)) != 0) {
+      printf("Test failed: target %u differs from portable, size: %d\n",
+             target, (int) size);
+      exit(1);
+    }
+
+    for (split = 0; split <= size; split += 5) {
+      HighwayHashCat cat;
+      HighwayHashCatStart(kTestKey1, &cat);
+      HighwayHashCatAppend(data, split, &cat);
+      HighwayHashCatAppend(data + split, size - split, &cat);
+      hash[0] = HighwayHashCatFinish64(&cat);
+      HighwayHashCatFinish128(&cat, hash + 1);
+      HighwayHashCatFinish256(&cat, hash + 3);
+      if (memcmp(expected, hash, sizeof(hash)) != 0) {
+        printf("Test failed: target %u cat differs, size: %d, split: %d\n",
+               target, (int) size, (int) split);
+        exit(1);
+      }
+    }
+  }
+}
+
 int main() {
   uint8_t data[kMaxSize + 1] = {0};
+  const unsigned targets = HighwayHashSupportedTargets();
+  unsigned target;
   int i;
-  for (i = 0; i <= kMaxSize; i++) {
-    data[i] = i;
-    TestHash64(kExpected64[i], data, i, kTestKey1);
-  }
+  for (target = 1; target <= targets; target <<= 1) {
+    if (!(targets & target)) continue;
+    HighwayHashRestrictTargets(target);
+    if (HighwayHashCurrentTarget() != target) {
+      printf("Test failed: target %u not used\n", target);
+      exit(1);
+    }
+
+    for (i = 0; i <= kMaxSize; i++) {
+      data[i] = i;
+      TestHash64(kExpected64[i], data, i, kTestKey1);
+    }
+
+    for (i = 0; i < 33; i++) {
+      data[i] = 128 + i;
+    }
+    TestHash64(0x53c516cce478cad7ull, data, 33, kTestKey2);
 
-  for (i = 0; i < 33; i++) {
-    data[i] = 128 + i;
+    TestTargetMatchesPortable(target);
   }
-  TestHash64(0x53c516cce478cad7ull, data, 33, kTestKey2);
 
   /* 128-bit and 256-bit tests to be added when they are declared frozen in the
      C++ version */
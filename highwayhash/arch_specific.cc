@@ -31,9 +31,17 @@
 #endif
 #endif
 
+#include <stdio.h>
 #include <string.h>  // memcpy
 #include <string>
 
+#if HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+#include <algorithm>
+#include <chrono>  //NOLINT
+
+#include "highwayhash/tsc_timer.h"
+#endif
+
 namespace highwayhash {
 
 const char* TargetName(const TargetBits target_bit) {
@@ -48,6 +56,10 @@ const char* TargetName(const TargetBits target_bit) {
       return "VSX";
     case HH_TARGET_NEON:
       return "NEON";
+    case HH_TARGET_AVX512:
+      return "AVX512";
+    case HH_TARGET_Generic:
+      return "Generic";
     default:
       return nullptr;  // zero, multiple, or unknown bits
   }
@@ -105,8 +117,46 @@ uint32_t ApicId() {
 
 namespace {
 
+#if __linux__ && !HH_ARCH_X64
+// Returns the maximum frequency [Hertz] of CPU 0 according to cpufreq, or zero
+// if unavailable (e.g. in some VMs).
+double CpufreqMaxRate() {
+  FILE* f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+  if (f == nullptr) return 0.0;
+  double kilohertz = 0.0;
+  if (fscanf(f, "%lf", &kilohertz) != 1) kilohertz = 0.0;
+  fclose(f);
+  return kilohertz * 1E3;
+}
+#endif
+
+#if HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+// Returns the rate of tsc_timer ticks (PMU cycles) while busy-waiting for 10 ms
+// of the steady clock; the median of several intervals, in case the thread is
+// preempted or the frequency is still ramping up.
+double MeasureTicksPerSecond() {
+  double rates[5];
+  for (double& rate : rates) {
+    const auto time0 = std::chrono::steady_clock::now();
+    const uint64_t ticks0 = Start<uint64_t>();
+    auto time1 = time0;
+    while (time1 - time0 < std::chrono::milliseconds(10)) {
+      time1 = std::chrono::steady_clock::now();
+    }
+    const uint64_t ticks1 = Stop<uint64_t>();
+    rate = (ticks1 - ticks0) /
+           std::chrono::duration<double>(time1 - time0).count();
+  }
+  std::sort(rates, rates + 5);
+  return rates[2];
+}
+#endif
+
 double DetectNominalClockRate() {
-#if HH_ARCH_X64
+#if HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+  // Actual cycles, which is what callers want to convert to.
+  return InvariantTicksPerSecond();
+#elif HH_ARCH_X64
   const std::string& brand_string = BrandString();
   // Brand strings include the maximum configured frequency. These prefixes are
   // defined by Intel CPUID documentation.
@@ -148,7 +198,7 @@ double DetectNominalClockRate() {
       }
     }
     fclose(f);
-    return freq;
+    if (freq > 0.0) return freq;
   }
 #elif __FreeBSD__
   size_t length = sizeof(freq);
@@ -158,7 +208,13 @@ double DetectNominalClockRate() {
 #endif
 #endif
 
+  // Not on x86, where InvariantTicksPerSecond (the TSC rate) is this result,
+  // but need not match the cpufreq limits.
+#if __linux__ && !HH_ARCH_X64
+  return CpufreqMaxRate();
+#else
   return 0.0;
+#endif
 }
 
 }  // namespace
@@ -185,6 +241,14 @@ double InvariantTicksPerSecond() {
   static const double cycles_per_second = 512000000;
 #endif
   return cycles_per_second;
+#elif HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+  static const double cycles_per_second = MeasureTicksPerSecond();
+  return cycles_per_second;
+#elif HH_ARCH_AARCH64
+  // Frequency of CNTVCT_EL0, set by firmware; constant and readable at EL0.
+  uint64_t ticks_per_second;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(ticks_per_second));
+  return static_cast<double>(ticks_per_second);
 #else
   return NominalClockRate();
 #endif
@@ -76,6 +76,26 @@ namespace highwayhash {
 #define HH_ARCH_PPC 0
 #endif
 
+// On AArch64, tsc_timer.h timestamps are the generic timer's virtual count
+// (CNTVCT_EL0) by default. Defining HH_TIMER_PMU_CYCLES=1 (for the entire
+// build, because arch_specific.cc must agree) instead reads the PMU cycle
+// counter PMCCNTR_EL0, i.e. actual CPU cycles, which only works if the kernel
+// has enabled user access (PMUSERENR_EL0) and otherwise raises SIGILL.
+#ifndef HH_TIMER_PMU_CYCLES
+#define HH_TIMER_PMU_CYCLES 0
+#endif
+
+// GCC/Clang vector extensions (vector_size and constant shuffles) allow a
+// target that runs on any architecture, e.g. s390x, LoongArch or MIPS, and is
+// lowered to whatever SIMD the baseline flags enable. Define
+// HH_DISABLE_GENERIC if the compiler miscompiles or rejects hh_generic.h.
+#if (HH_GCC_VERSION >= 408 || HH_CLANG_VERSION >= 304) && \
+    !defined(HH_DISABLE_GENERIC)
+#define HH_ARCH_GENERIC 1
+#else
+#define HH_ARCH_GENERIC 0
+#endif
+
 // Target := instruction set extension(s) such as SSE41. A translation unit can
 // only provide a single target-specific implementation because they require
 // different compiler flags.
@@ -88,7 +108,10 @@ namespace highwayhash {
 // To avoid excessive code size and dispatch overhead, we only support a few
 // groups of extensions, e.g. FMA+BMI2+AVX+AVX2 =: "AVX2". These names must
 // match the HH_TARGET_* suffixes below.
-#ifdef __AVX2__
+#if defined(__AVX512F__) && defined(__AVX512VL__) && \
+    defined(__AVX512BW__) && defined(__AVX512DQ__)
+#define HH_TARGET_NAME AVX512
+#elif defined(__AVX2__)
 #define HH_TARGET_NAME AVX2
 // MSVC does not set SSE4_1, but it does set AVX; checking for the latter means
 // we at least get SSE4 on machines supporting AVX but not AVX2.
@@ -130,6 +153,8 @@ namespace highwayhash {
 #define HH_TARGET_AVX2 4
 #define HH_TARGET_VSX 8
 #define HH_TARGET_NEON 16
+#define HH_TARGET_AVX512 32
+#define HH_TARGET_Generic 64
 
 // Bit array for one or more HH_TARGET_*. Used to indicate which target(s) are
 // supported or were called by InstructionSets::RunAll.
@@ -153,13 +178,18 @@ void ForeachTarget(TargetBits bits, const Func& func) {
 // bits, or nullptr if zero, multiple, or unknown bits are set.
 const char* TargetName(const TargetBits target_bit);
 
-// Returns the nominal (without Turbo Boost) CPU clock rate [Hertz]. Useful for
-// (roughly) characterizing the CPU speed.
+// Returns the nominal (without Turbo Boost) CPU clock rate [Hertz], or zero if
+// unknown. Useful for (roughly) characterizing the CPU speed and converting
+// durations to cycles. Parsed from the x86 brand string or PPC /proc/cpuinfo;
+// on other Linux systems (e.g. AArch64), the maximum cpufreq of CPU 0, or with
+// HH_TIMER_PMU_CYCLES, the measured rate of the cycle counter.
 double NominalClockRate();
 
 // Returns tsc_timer frequency, useful for converting ticks to seconds. This is
-// unaffected by CPU throttling ("invariant"). Thread-safe. Returns timebase
-// frequency on PPC and NominalClockRate on all other platforms.
+// unaffected by CPU throttling ("invariant"). Thread-safe. Returns the
+// timebase frequency on PPC, CNTFRQ_EL0 on AArch64 (or, with
+// HH_TIMER_PMU_CYCLES, the cycle rate measured against the steady clock) and
+// NominalClockRate on all other platforms.
 double InvariantTicksPerSecond();
 
 #if HH_ARCH_X64
@@ -13,31 +13,76 @@
 // limitations under the License.
 
 // Measures hash function throughput for various input sizes.
+//
+// Usage: benchmark [t|p|b|k|r|s|f|d] prints a LaTeX table (default), pgfplots
+// data, or one of the specialized comparisons below. Alternatively,
+//   benchmark --algorithms=HighwayHash,SipHash --targets=AVX2,Portable
+//             --sizes=8,64,1024 --format=json
+// measures the given algorithms, targets and input sizes (all optional) and
+// prints the results as text, JSON or CSV, e.g. for performance dashboards.
+// --events=1 adds hardware event counts (instructions, cycles, branch and L1D
+// misses per call) where the OS allows. --compare=SSE41,AVX2 measures both
+// targets in interleaved rounds and exits with code 2 if the second is slower
+// than the first by more than --max_regression percent (default 5) with 95%
+// confidence, e.g. to gate releases.
+// With --distribution=uniform:1-64 (or zipf:1.2:64, or file:histogram.txt),
+// it instead measures HighwayHash of messages whose sizes are drawn from that
+// distribution, which includes the cost of mispredicted branches. With
+// --working_sets=16K,1M,256M (or "sweep"), it hashes buffers of those sizes,
+// optionally evicted from all caches before each run (--flush=1), and compares
+// the throughput with the read bandwidth of the same buffer, i.e. shows when
+// hashing becomes memory-bound.
+// --interference=1M alternates between reading a hot buffer of that size and
+// hashing chunks of a stream that is never reused, with and without
+// HighwayHashNonTemporal (--prefetch_distance=N bytes ahead), and shows how
+// much the hashing slows down the reads, i.e. evicts the hot buffer.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>  //NOLINT
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <map>
+#include <numeric>
+#include <random>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include "highwayhash/arch_specific.h"
+#if HH_ARCH_X64
+#include <emmintrin.h>  // _mm_clflush
+#endif
 #include "highwayhash/compiler_specific.h"
 #include "highwayhash/instruction_sets.h"
 #include "highwayhash/nanobenchmark.h"
 #include "highwayhash/robust_statistics.h"
 
-// Which functions to enable (includes check for compiler support)
-#define BENCHMARK_SIP 0
-#define BENCHMARK_SIP_TREE 0
+// Which functions to compile in (includes check for compiler support). The
+// benchmarks of those compiled in are chosen at runtime via --algorithms.
+#define BENCHMARK_SIP 1
+#define BENCHMARK_SIP_TREE 1
 #define BENCHMARK_HIGHWAY 1
 #define BENCHMARK_HIGHWAY_CAT 1
+#define BENCHMARK_HIGHWAY_WIDE 1
 #define BENCHMARK_FARM 0
 #define BENCHMARK_INTERNAL 0
 
 #include "highwayhash/highwayhash_test_target.h"
+#if BENCHMARK_HIGHWAY
+#include "highwayhash/c_bindings.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/highwayhash_target.h"
+#endif
 #if BENCHMARK_SIP
 #include "highwayhash/sip_hash.h"
 #endif
@@ -57,12 +102,106 @@ namespace highwayhash {
 namespace {
 
 // Stores time measurements from benchmarks, with support for printing them
-// as LaTeX figures or tables.
+// as LaTeX figures or tables, or as text, JSON or CSV.
 class Measurements {
  public:
-  void Add(const char* caption, const size_t bytes, const double cycles) {
-    const float cpb = static_cast<float>(cycles / bytes);
-    results_.emplace_back(caption, static_cast<int>(bytes), cpb);
+  // "target" is the empty string for algorithms without per-target
+  // implementations. Side effect: sorts "durations" [ticks].
+  void Add(const char* algorithm, const char* target, const size_t bytes,
+           std::vector<float>* durations, const EventsPerCall& events) {
+    Result result;
+    result.algorithm = algorithm;
+    result.target = target;
+    result.in_size = static_cast<int>(bytes);
+    result.events = events;
+    if (events.instructions >= 0.0f || events.cycles >= 0.0f) {
+      has_events_ = true;
+    }
+    result.median_ticks = Median(durations);
+    result.mad_ticks = MedianAbsoluteDeviation(*durations, result.median_ticks);
+    result.p10_ticks = Quantile(*durations, 0.1);
+    result.p90_ticks = Quantile(*durations, 0.9);
+    // Unknown (negative) if the timer or CPU frequency is unknown, e.g.
+    // cycles on AArch64 without cpufreq, where ticks are still convertible
+    // to seconds via CNTFRQ_EL0.
+    const double seconds = result.median_ticks / InvariantTicksPerSecond();
+    const bool known_rate = InvariantTicksPerSecond() > 0.0;
+    result.cpb = (known_rate && NominalClockRate() > 0.0)
+                     ? static_cast<float>(seconds * NominalClockRate() / bytes)
+                     : -1.0f;
+    result.gbps = known_rate ? bytes / seconds * 1E-9 : -1.0;
+    results_.push_back(result);
+  }
+
+  // One line per result, for humans. Durations are in ticks. Hardware
+  // events are only printed if any were counted.
+  void PrintText() const {
+    printf("%-28s %-8s %5s %8s %8s %8s %8s %9s %9s", "Algorithm", "Target",
+           "Size", "Median", "MAD", "P10", "P90", "Cyc/B", "GB/s");
+    if (has_events_) {
+      printf(" %9s %9s %9s %9s", "Instr", "Cycles", "BrMiss", "L1DMiss");
+    }
+    printf("\n");
+    for (const Result& r : results_) {
+      printf("%-28s %-8s %5d %8.1f %8.1f %8.1f %8.1f %9s %9s",
+             r.algorithm.c_str(), r.target.c_str(), r.in_size, r.median_ticks,
+             r.mad_ticks, r.p10_ticks, r.p90_ticks, Rate(r.cpb, "-").c_str(),
+             Rate(r.gbps, "-").c_str());
+      if (has_events_) {
+        printf(" %9s %9s %9s %9s", Count(r.events.instructions, "-").c_str(),
+               Count(r.events.cycles, "-").c_str(),
+               Count(r.events.branch_misses, "-").c_str(),
+               Count(r.events.l1d_misses, "-").c_str());
+      }
+      printf("\n");
+    }
+  }
+
+  // Unknown throughputs (see Add) are null in JSON and empty in CSV.
+  void PrintJson() const {
+    printf("{\n  \"cpu\": \"%s\",\n", CpuName().c_str());
+    printf("  \"nominal_hz\": %.0f,\n", NominalClockRate());
+    printf("  \"ticks_per_second\": %.0f,\n", InvariantTicksPerSecond());
+    printf("  \"results\": [");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Result& r = results_[i];
+      printf("%s\n    {\"algorithm\": \"%s\", \"target\": \"%s\", "
+             "\"size\": %d, \"median_ticks\": %.1f, \"mad_ticks\": %.1f, "
+             "\"p10_ticks\": %.1f, \"p90_ticks\": %.1f, "
+             "\"cycles_per_byte\": %s, \"gb_per_s\": %s",
+             i == 0 ? "" : ",", r.algorithm.c_str(), r.target.c_str(),
+             r.in_size, r.median_ticks, r.mad_ticks, r.p10_ticks, r.p90_ticks,
+             Rate(r.cpb, "null").c_str(), Rate(r.gbps, "null").c_str());
+      if (has_events_) {
+        printf(", \"instructions\": %s, \"cycles\": %s, "
+               "\"branch_misses\": %s, \"l1d_misses\": %s",
+               Count(r.events.instructions, "null").c_str(),
+               Count(r.events.cycles, "null").c_str(),
+               Count(r.events.branch_misses, "null").c_str(),
+               Count(r.events.l1d_misses, "null").c_str());
+      }
+      printf("}");
+    }
+    printf("\n  ]\n}\n");
+  }
+
+  void PrintCsv() const {
+    printf("algorithm,target,size,median_ticks,mad_ticks,p10_ticks,p90_ticks,"
+           "cycles_per_byte,gb_per_s%s\n",
+           has_events_ ? ",instructions,cycles,branch_misses,l1d_misses" : "");
+    for (const Result& r : results_) {
+      printf("%s,%s,%d,%.1f,%.1f,%.1f,%.1f,%s,%s", r.algorithm.c_str(),
+             r.target.c_str(), r.in_size, r.median_ticks, r.mad_ticks,
+             r.p10_ticks, r.p90_ticks, Rate(r.cpb, "").c_str(),
+             Rate(r.gbps, "").c_str());
+      if (has_events_) {
+        printf(",%s,%s,%s,%s", Count(r.events.instructions, "").c_str(),
+               Count(r.events.cycles, "").c_str(),
+               Count(r.events.branch_misses, "").c_str(),
+               Count(r.events.l1d_misses, "").c_str());
+      }
+      printf("\n");
+    }
   }
 
   // Prints results as a LaTeX table (only for in_sizes matching the
@@ -122,17 +261,69 @@ class Measurements {
 
  private:
   struct Result {
-    Result(const char* caption, const int in_size, const float cpb)
-        : caption(caption), in_size(in_size), cpb(cpb) {}
+    // Algorithm and target name, e.g. HighwayHashAVX2.
+    std::string Caption() const { return algorithm + target; }
 
-    // Algorithm name.
-    std::string caption;
+    std::string algorithm;
+    std::string target;
     // Size of the input data [bytes].
     int in_size;
-    // Measured throughput [cycles per byte].
+    // Statistics of the measured durations [ticks].
+    float median_ticks;
+    float mad_ticks;
+    float p10_ticks;
+    float p90_ticks;
+    // Median throughput [cycles per byte].
     float cpb;
+    // Median throughput [GB/s].
+    double gbps;
+    // Hardware events per call (negative if not counted).
+    EventsPerCall events;
   };
 
+  // Returns "rate" with four decimals, or "unknown" if negative.
+  static std::string Rate(const double rate, const char* unknown) {
+    if (rate < 0.0) return unknown;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.4f", rate);
+    return buf;
+  }
+
+  // Returns "count" with two decimals, or "unknown" if negative.
+  static std::string Count(const float count, const char* unknown) {
+    if (count < 0.0f) return unknown;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.2f", count);
+    return buf;
+  }
+
+  // Returns the brand string of x86 CPUs, otherwise the architecture.
+  static std::string CpuName() {
+#if HH_ARCH_X64
+    uint32_t abcd[4];
+    Cpuid(0x80000000U, 0, abcd);
+    if (abcd[0] >= 0x80000004U) {
+      char brand[49] = {0};
+      for (uint32_t i = 0; i < 3; ++i) {
+        Cpuid(0x80000002U + i, 0, abcd);
+        memcpy(brand + i * 16, abcd, sizeof(abcd));
+      }
+      // May include leading spaces; quotes would break the JSON.
+      std::string name(brand);
+      name.erase(0, name.find_first_not_of(' '));
+      std::replace(name.begin(), name.end(), '"', '\'');
+      return name;
+    }
+    return "x86_64";
+#elif HH_ARCH_PPC
+    return "ppc64";
+#elif HH_ARCH_AARCH64
+    return "aarch64";
+#else
+    return "unknown";
+#endif
+  }
+
   // Returns set of all input sizes for the first column of a size/speed plot.
   std::vector<int> UniqueSizes() {
     std::vector<int> sizes;
@@ -150,7 +341,7 @@ class Measurements {
   SpeedsForCaption SortByCaption() const {
     SpeedsForCaption cpb_for_caption;
     for (const Result& result : results_) {
-      cpb_for_caption[result.caption].push_back(result.cpb);
+      cpb_for_caption[result.Caption()].push_back(result.cpb);
     }
     return cpb_for_caption;
   }
@@ -162,7 +353,7 @@ class Measurements {
     for (const Result& result : results_) {
       for (const size_t in_size : in_sizes) {
         if (result.in_size == static_cast<int>(in_size)) {
-          cpb_for_caption[result.caption].push_back(result.cpb);
+          cpb_for_caption[result.Caption()].push_back(result.cpb);
         }
       }
     }
@@ -170,32 +361,33 @@ class Measurements {
   }
 
   std::vector<Result> results_;
+  bool has_events_ = false;
 };
 
-void AddMeasurements(DurationsForInputs* input_map, const char* caption,
-                     Measurements* measurements) {
+// Progress is printed to stderr so that stdout only contains the results.
+void AddMeasurements(DurationsForInputs* input_map, const char* algorithm,
+                     const char* target, Measurements* measurements) {
   for (size_t i = 0; i < input_map->num_items; ++i) {
     const DurationsForInputs::Item& item = input_map->items[i];
     std::vector<float> durations(item.durations,
                                  item.durations + item.num_durations);
     const float median_ticks = Median(&durations);
     const float variability = MedianAbsoluteDeviation(durations, median_ticks);
-    const double median_cpu_cycles =
-        (median_ticks / InvariantTicksPerSecond()) * NominalClockRate();
-    printf("%s %4zu: median=%6.1f ticks; median L1 norm =%4.1f ticks\n",
-           caption, item.input, median_ticks, variability);
-    measurements->Add(caption, item.input, median_cpu_cycles);
+    fprintf(stderr,
+            "%s%s %4zu: median=%6.1f ticks; median L1 norm =%4.1f ticks\n",
+            algorithm, target, item.input, median_ticks, variability);
+    measurements->Add(algorithm, target, item.input, &durations, item.events);
   }
   input_map->num_items = 0;
 }
 
 #if BENCHMARK_SIP || BENCHMARK_FARM || BENCHMARK_INTERNAL || \
-    (BENCHMARK_SIP_TREE && defined(__AVX2__))
+    BENCHMARK_HIGHWAY || BENCHMARK_SIP_TREE
 
 void MeasureAndAdd(DurationsForInputs* input_map, const char* caption,
                    const Func func, Measurements* measurements) {
   MeasureDurations(func, input_map);
-  AddMeasurements(input_map, caption, measurements);
+  AddMeasurements(input_map, caption, "", measurements);
 }
 
 #endif
@@ -203,12 +395,56 @@ void MeasureAndAdd(DurationsForInputs* input_map, const char* caption,
 // InstructionSets::RunAll callback.
 void AddMeasurementsWithPrefix(const char* prefix, const char* target_name,
                                DurationsForInputs* input_map, void* context) {
-  std::string caption(prefix);
-  caption += target_name;
-  AddMeasurements(input_map, caption.c_str(),
+  AddMeasurements(input_map, prefix, target_name,
                   static_cast<Measurements*>(context));
 }
 
+// Calls Func<target>()(args) for a single supported "target" bit. Unlike
+// InstructionSets::RunAll, this allows measuring a subset of the targets.
+template <template <TargetBits> class Func, typename... Args>
+void RunTarget(const TargetBits target, Args&&... args) {
+  switch (target) {
+#if HH_ARCH_X64
+    case HH_TARGET_AVX512:
+      Func<HH_TARGET_AVX512>()(std::forward<Args>(args)...);
+      break;
+    case HH_TARGET_AVX2:
+      Func<HH_TARGET_AVX2>()(std::forward<Args>(args)...);
+      break;
+    case HH_TARGET_SSE41:
+      Func<HH_TARGET_SSE41>()(std::forward<Args>(args)...);
+      break;
+#elif HH_ARCH_PPC
+    case HH_TARGET_VSX:
+      Func<HH_TARGET_VSX>()(std::forward<Args>(args)...);
+      break;
+#elif HH_ARCH_NEON
+    case HH_TARGET_NEON:
+      Func<HH_TARGET_NEON>()(std::forward<Args>(args)...);
+      break;
+#endif
+#if HH_ARCH_GENERIC
+    case HH_TARGET_Generic:
+      Func<HH_TARGET_Generic>()(std::forward<Args>(args)...);
+      break;
+#endif
+    case HH_TARGET_Portable:
+      Func<HH_TARGET_Portable>()(std::forward<Args>(args)...);
+      break;
+  }
+}
+
+// Measures Func<Target> for each Target in "targets" supported by the CPU.
+template <template <TargetBits> class Func>
+void MeasureTargets(const TargetBits targets, DurationsForInputs* input_map,
+                    Measurements* measurements) {
+  HH_TARGET_NAME::ForeachTarget(
+      targets & InstructionSets::Supported(), [&](const TargetBits target) {
+        RunTarget<Func>(target, input_map, &AddMeasurementsWithPrefix,
+                        measurements);
+      });
+}
+
 #if BENCHMARK_SIP
 
 uint64_t RunSip(const void*, const size_t size) {
@@ -263,36 +499,90 @@ uint64_t RunInternal(const void*, const size_t size) {
 }
 #endif
 
-void AddMeasurements(const std::vector<size_t>& in_sizes,
-                     Measurements* measurements) {
-  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+// Measures "input_map" for those of "targets" that the algorithm supports.
+// Algorithms without per-target implementations ignore "targets".
+using MeasureFunc = void (*)(TargetBits targets, DurationsForInputs* input_map,
+                             Measurements* measurements);
+
+struct Algorithm {
+  const char* name;
+  // Whether to measure it if --algorithms is not specified.
+  bool is_default;
+  MeasureFunc measure;
+};
+
 #if BENCHMARK_SIP
-  MeasureAndAdd(&input_map, "SipHash", &RunSip, measurements);
-  MeasureAndAdd(&input_map, "SipHash13", &RunSip13, measurements);
+void MeasureSip(TargetBits, DurationsForInputs* input_map,
+                Measurements* measurements) {
+  MeasureAndAdd(input_map, "SipHash", &RunSip, measurements);
+}
+void MeasureSip13(TargetBits, DurationsForInputs* input_map,
+                  Measurements* measurements) {
+  MeasureAndAdd(input_map, "SipHash13", &RunSip13, measurements);
+}
 #endif
 
-#if BENCHMARK_SIP_TREE && defined(__AVX2__)
-  MeasureAndAdd(&input_map, "SipTreeHash", &RunSipTree, measurements);
-  MeasureAndAdd(&input_map, "SipTreeHash13", &RunSipTree13, measurements);
+#if BENCHMARK_SIP_TREE
+void MeasureSipTree(TargetBits, DurationsForInputs* input_map,
+                    Measurements* measurements) {
+  MeasureAndAdd(input_map, "SipTreeHash", &RunSipTree, measurements);
+}
+void MeasureSipTree13(TargetBits, DurationsForInputs* input_map,
+                      Measurements* measurements) {
+  MeasureAndAdd(input_map, "SipTreeHash13", &RunSipTree13, measurements);
+}
 #endif
 
 #if BENCHMARK_FARM
-  MeasureAndAdd(&input_map, "Farm", &RunFarm, measurements);
+void MeasureFarm(TargetBits, DurationsForInputs* input_map,
+                 Measurements* measurements) {
+  MeasureAndAdd(input_map, "Farm", &RunFarm, measurements);
+}
 #endif
 
 #if BENCHMARK_INTERNAL
-  MeasureAndAdd(&input_map, "Internal", &RunInternal, measurements);
+void MeasureInternal(TargetBits, DurationsForInputs* input_map,
+                     Measurements* measurements) {
+  MeasureAndAdd(input_map, "Internal", &RunInternal, measurements);
+}
 #endif
 
+// All algorithms compiled in; names are as reported in the results.
+const Algorithm kAlgorithms[] = {
+#if BENCHMARK_SIP
+    {"SipHash", false, &MeasureSip},
+    {"SipHash13", false, &MeasureSip13},
+#endif
+#if BENCHMARK_SIP_TREE
+    {"SipTreeHash", false, &MeasureSipTree},
+    {"SipTreeHash13", false, &MeasureSipTree13},
+#endif
+#if BENCHMARK_FARM
+    {"Farm", false, &MeasureFarm},
+#endif
+#if BENCHMARK_INTERNAL
+    {"Internal", false, &MeasureInternal},
+#endif
 #if BENCHMARK_HIGHWAY
-  InstructionSets::RunAll<HighwayHashBenchmark>(
-      &input_map, &AddMeasurementsWithPrefix, measurements);
+    {"HighwayHash", true, &MeasureTargets<HighwayHashBenchmark>},
 #endif
-
 #if BENCHMARK_HIGHWAY_CAT
-  InstructionSets::RunAll<HighwayHashCatBenchmark>(
-      &input_map, &AddMeasurementsWithPrefix, measurements);
+    {"HighwayHashCat", true, &MeasureTargets<HighwayHashCatBenchmark>},
+#endif
+#if BENCHMARK_HIGHWAY_WIDE
+    {"HighwayHashWide", true, &MeasureTargets<HighwayHashWideBenchmark>},
 #endif
+};
+
+// Measures the default algorithms for all targets.
+void AddMeasurements(const std::vector<size_t>& in_sizes,
+                     Measurements* measurements) {
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  for (const Algorithm& algorithm : kAlgorithms) {
+    if (algorithm.is_default) {
+      algorithm.measure(~0u, &input_map, measurements);
+    }
+  }
 }
 
 void PrintTable() {
@@ -303,6 +593,143 @@ void PrintTable() {
   measurements.PrintTable(in_sizes);
 }
 
+// InstructionSets::RunAll callback for benchmarks that process
+// kBenchmarkBatchSize items (keys or fragments) per measurement.
+void PrintItemsPerSecond(const char* prefix, const char* target_name,
+                         DurationsForInputs* input_map, void*) {
+  for (size_t i = 0; i < input_map->num_items; ++i) {
+    const DurationsForInputs::Item& item = input_map->items[i];
+    std::vector<float> durations(item.durations,
+                                 item.durations + item.num_durations);
+    const float median_ticks = Median(&durations);
+    const double ticks_per_item = median_ticks / kBenchmarkBatchSize;
+    const double items_per_second = InvariantTicksPerSecond() / ticks_per_item;
+    printf("%23s%-8s %4zu: %6.1f ticks/item; %8.2f M items/s\n", prefix,
+           target_name, item.input, ticks_per_item, items_per_second * 1E-6);
+  }
+  input_map->num_items = 0;
+}
+
+// Compares the throughput of per-message and batch hashing of short keys.
+void PrintBatch() {
+  const std::vector<size_t> in_sizes = {16, 32, 64, 128, 200, 1024};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  InstructionSets::RunAll<HighwayHashBatchBenchmark>(
+      &input_map, &PrintItemsPerSecond, nullptr);
+}
+
+#if BENCHMARK_SIP
+
+// Compares per-message and multi-buffer SipHash of short keys.
+void PrintSipBatch() {
+  const std::vector<size_t> in_sizes = {8, 16, 24, 32, 64, 128};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  InstructionSets::RunAll<SipHashBatchBenchmark>(&input_map,
+                                                 &PrintItemsPerSecond, nullptr);
+}
+
+#endif
+
+// Compares HighwayHashT and HighwayHashFixedT for fixed-width keys.
+void PrintFixed() {
+  const std::vector<size_t> in_sizes = {8, 16, 24, 32, 64};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  InstructionSets::RunAll<HighwayHashFixedBenchmark>(
+      &input_map, &PrintItemsPerSecond, nullptr);
+}
+
+// Compares HighwayHashT and HighwayHashShortT for keys of up to 32 bytes.
+void PrintShort() {
+  // Covers both tail cases of UpdateRemainder and zero to three extra bytes.
+  const std::vector<size_t> in_sizes = {1,  3,  4,  7,  8,  12,
+                                        15, 16, 21, 24, 31, 32};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  InstructionSets::RunAll<HighwayHashShortBenchmark>(
+      &input_map, &PrintItemsPerSecond, nullptr);
+}
+
+// Compares appending fragments individually and via AppendFragments.
+void PrintFragments() {
+  const std::vector<size_t> in_sizes = {8, 32, 40, 48, 60, 64};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  InstructionSets::RunAll<HighwayHashFragmentsBenchmark>(
+      &input_map, &PrintItemsPerSecond, nullptr);
+}
+
+#if BENCHMARK_HIGHWAY
+
+const HHKey kDispatchKey = {0, 1, 2, 3};
+
+// Dispatches on every call, as the C HighwayHash64 used to.
+uint64_t RunHighwayHashRun(const void*, const size_t size) {
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  HHResult64 hash;
+  InstructionSets::Run<HighwayHash>(kDispatchKey, in, size, &hash);
+  return hash;
+}
+
+uint64_t RunHighwayHashDispatch(const void*, const size_t size) {
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  HHResult64 hash;
+  HighwayHashDispatch().hash64(kDispatchKey, in, size, &hash);
+  return hash;
+}
+
+uint64_t RunHighwayHash64C(const void*, const size_t size) {
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  return HighwayHash64(kDispatchKey, in, size);
+}
+
+const HighwayHashPreparedKey& DispatchPreparedKey() {
+  static const HighwayHashPreparedKey* prepared = [] {
+    HighwayHashPreparedKey* prepared = new HighwayHashPreparedKey;
+    HighwayHashDispatch().prepare(kDispatchKey, prepared);
+    return prepared;
+  }();
+  return *prepared;
+}
+
+uint64_t RunHighwayHashPrepared(const void*, const size_t size) {
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  HHResult64 hash;
+  HighwayHashDispatch().prepared64(&DispatchPreparedKey(), in, size, &hash);
+  return hash;
+}
+
+uint64_t RunHighwayHashPrepared64C(const void*, const size_t size) {
+  static const HighwayHashPreparedKeyC* prepared =
+      HighwayHashPrepareKeyC(kDispatchKey);
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  return HighwayHashPrepared64C(prepared, in, size);
+}
+
+// Compares the per-call overhead of dispatching for short inputs.
+void PrintDispatch() {
+  printf("Dispatch table target: %s\n",
+         TargetName(HighwayHashDispatch().target));
+  const std::vector<size_t> in_sizes = {8};
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), 40);
+  Measurements measurements;
+  MeasureAndAdd(&input_map, "InstructionSets::Run", &RunHighwayHashRun,
+                &measurements);
+  MeasureAndAdd(&input_map, "HighwayHashDispatch", &RunHighwayHashDispatch,
+                &measurements);
+  MeasureAndAdd(&input_map, "HighwayHash64 (C)", &RunHighwayHash64C,
+                &measurements);
+  MeasureAndAdd(&input_map, "HighwayHashDispatch prepared",
+                &RunHighwayHashPrepared, &measurements);
+  MeasureAndAdd(&input_map, "HighwayHashPrepared64C",
+                &RunHighwayHashPrepared64C, &measurements);
+  measurements.PrintText();
+}
+
+#endif  // BENCHMARK_HIGHWAY
+
 void PrintPlots() {
   std::vector<size_t> in_sizes;
   for (int num_vectors = 0; num_vectors < 12; ++num_vectors) {
@@ -317,15 +744,896 @@ void PrintPlots() {
   measurements.PrintPlots();
 }
 
+// Largest message size for --distribution.
+const size_t kMaxDistributionSize = 64 * 1024;
+
+// Number of messages per measurement. Too many distinct sizes in a row for
+// the branch predictor to learn the sequence.
+const size_t kDistributionMessages = 1 << 16;
+
+// Counts mispredicted branches of this thread in user mode, if the OS allows.
+class BranchMissCounter {
+ public:
+  BranchMissCounter() {
+#if defined(__linux__)
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  ~BranchMissCounter() {
+#if defined(__linux__)
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  // False if unsupported, e.g. in most VMs or if perf_event_paranoid forbids.
+  bool Available() const { return fd_ >= 0; }
+
+  void Start() {
+#if defined(__linux__)
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  // Returns the number of misses since Start.
+  uint64_t Stop() {
+    uint64_t count = 0;
+#if defined(__linux__)
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd_, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+    return count;
+  }
+
+ private:
+  int fd_ = -1;
+};
+
+// Parses "uniform:MIN-MAX", "zipf:S:MAX" (P(size) ~ 1 / size^S for sizes
+// 1..MAX) or "file:PATH" (lines of "size weight"; # begins a comment) into
+// "weights", indexed by size. Returns false and prints an error if invalid.
+bool ParseDistribution(const std::string& spec, std::vector<double>* weights) {
+  weights->assign(kMaxDistributionSize + 1, 0.0);
+  unsigned long min_size, max_size;
+  double exponent;
+  char unused;
+  if (sscanf(spec.c_str(), "uniform:%lu-%lu%c", &min_size, &max_size,
+             &unused) == 2) {
+    if (min_size > max_size || max_size > kMaxDistributionSize) {
+      fprintf(stderr, "Invalid range in %s\n", spec.c_str());
+      return false;
+    }
+    std::fill(weights->begin() + min_size, weights->begin() + max_size + 1,
+              1.0);
+  } else if (sscanf(spec.c_str(), "zipf:%lf:%lu%c", &exponent, &max_size,
+                    &unused) == 2) {
+    if (max_size == 0 || max_size > kMaxDistributionSize) {
+      fprintf(stderr, "Invalid maximum in %s\n", spec.c_str());
+      return false;
+    }
+    for (size_t size = 1; size <= max_size; ++size) {
+      (*weights)[size] = 1.0 / std::pow(static_cast<double>(size), exponent);
+    }
+  } else if (spec.compare(0, 5, "file:") == 0) {
+    FILE* f = fopen(spec.c_str() + 5, "r");
+    if (f == nullptr) {
+      fprintf(stderr, "Cannot open %s\n", spec.c_str() + 5);
+      return false;
+    }
+    char line[200];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f) != nullptr) {
+      ++line_number;
+      char* comment = strchr(line, '#');
+      if (comment != nullptr) *comment = '\0';
+      unsigned long size;
+      double weight;
+      const int fields = sscanf(line, "%lu %lf", &size, &weight);
+      if (fields == EOF) continue;  // blank line
+      if (fields != 2 || size > kMaxDistributionSize || weight < 0.0) {
+        fprintf(stderr, "Invalid line %d in %s\n", line_number,
+                spec.c_str() + 5);
+        ok = false;
+      } else {
+        (*weights)[size] += weight;
+      }
+    }
+    fclose(f);
+    if (!ok) return false;
+  } else {
+    fprintf(stderr, "Unknown distribution %s\n", spec.c_str());
+    return false;
+  }
+
+  if (std::accumulate(weights->begin(), weights->end(), 0.0) <= 0.0) {
+    fprintf(stderr, "Distribution %s is empty\n", spec.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Measures HighwayHash of kDistributionMessages messages with sizes drawn
+// from "spec" for each of "targets" and prints ns per hash, GB/s and
+// mispredicted branches per hash in the given format. Returns the exit code.
+int MeasureDistribution(const std::string& spec, const TargetBits targets,
+                        const std::string& format) {
+  std::vector<double> weights;
+  if (!ParseDistribution(spec, &weights)) return 1;
+
+  std::mt19937 rng(12345);
+  std::discrete_distribution<size_t> distribution(weights.begin(),
+                                                  weights.end());
+  std::vector<char> data(2 * kMaxDistributionSize);
+  for (char& byte : data) {
+    byte = static_cast<char>(rng());
+  }
+  // Random sizes and start offsets, so that neither is predictable.
+  std::vector<StringView> messages(kDistributionMessages);
+  double total_bytes = 0.0;
+  for (StringView& message : messages) {
+    message.num_bytes = distribution(rng);
+    message.data = data.data() + rng() % (kMaxDistributionSize + 1);
+    total_bytes += message.num_bytes;
+  }
+  const double mean_size = total_bytes / messages.size();
+
+  struct Result {
+    const char* target;
+    double ns_per_hash;
+    double misses_per_hash;  // negative if unavailable
+  };
+  std::vector<Result> results;
+  BranchMissCounter counter;
+  const HHKey key = {0, 1, 2, 3};
+  HH_TARGET_NAME::ForeachTarget(
+      targets & InstructionSets::Supported(), [&](const TargetBits target) {
+        std::vector<double> ns;
+        std::vector<double> misses;
+        // The first repetition warms up caches and frequency; use the median.
+        for (int rep = 0; rep < 8; ++rep) {
+          HHResult64 sum;
+          if (counter.Available()) counter.Start();
+          const auto t0 = std::chrono::steady_clock::now();
+          RunTarget<HighwayHashMessagesBenchmark>(
+              target, key, messages.data(), messages.size(), &sum);
+          const auto t1 = std::chrono::steady_clock::now();
+          const uint64_t num_misses = counter.Available() ? counter.Stop() : 0;
+          if (rep == 0) continue;
+          // Prevents the compiler from eliding the hashing.
+          if (sum == 0) fprintf(stderr, "(zero sum)\n");
+          ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0)
+                           .count() / messages.size());
+          misses.push_back(static_cast<double>(num_misses) / messages.size());
+        }
+        Result result;
+        result.target = TargetName(target);
+        result.ns_per_hash = Median(&ns);
+        result.misses_per_hash = counter.Available() ? Median(&misses) : -1.0;
+        results.push_back(result);
+      });
+
+  if (format == "json") {
+    printf("{\n  \"distribution\": \"%s\",\n  \"mean_size\": %.2f,\n",
+           spec.c_str(), mean_size);
+    printf("  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result& r = results[i];
+      printf("%s\n    {\"target\": \"%s\", \"ns_per_hash\": %.3f, "
+             "\"gb_per_s\": %.4f, \"branch_misses_per_hash\": ",
+             i == 0 ? "" : ",", r.target, r.ns_per_hash,
+             mean_size / r.ns_per_hash);
+      if (r.misses_per_hash < 0.0) {
+        printf("null}");
+      } else {
+        printf("%.4f}", r.misses_per_hash);
+      }
+    }
+    printf("\n  ]\n}\n");
+  } else if (format == "csv") {
+    printf("distribution,target,mean_size,ns_per_hash,gb_per_s,"
+           "branch_misses_per_hash\n");
+    for (const Result& r : results) {
+      printf("%s,%s,%.2f,%.3f,%.4f,", spec.c_str(), r.target, mean_size,
+             r.ns_per_hash, mean_size / r.ns_per_hash);
+      if (r.misses_per_hash >= 0.0) printf("%.4f", r.misses_per_hash);
+      printf("\n");
+    }
+  } else {
+    printf("Distribution %s, mean size %.2f, %zu messages\n", spec.c_str(),
+           mean_size, messages.size());
+    printf("%-8s %10s %8s %14s\n", "Target", "ns/hash", "GB/s",
+           "misses/hash");
+    for (const Result& r : results) {
+      printf("%-8s %10.3f %8.3f ", r.target, r.ns_per_hash,
+             mean_size / r.ns_per_hash);
+      if (r.misses_per_hash < 0.0) {
+        printf("%14s\n", "-");
+      } else {
+        printf("%14.4f\n", r.misses_per_hash);
+      }
+    }
+  }
+  return 0;
+}
+
+// Default --working_sets=sweep: L1 through LLC to DRAM on current CPUs.
+const size_t kSweepMinWorkingSet = 16 * 1024;
+const size_t kSweepMaxWorkingSet = 256 * 1024 * 1024;
+
+// Parses a byte count with optional K, M or G suffix (powers of 1024).
+// Returns false if invalid or zero.
+bool ParseByteSize(const std::string& text, size_t* bytes) {
+  char* end;
+  unsigned long long value = strtoull(text.c_str(), &end, 10);
+  if (end == text.c_str()) return false;
+  if (*end == 'K' || *end == 'k') {
+    value <<= 10;
+    ++end;
+  } else if (*end == 'M' || *end == 'm') {
+    value <<= 20;
+    ++end;
+  } else if (*end == 'G' || *end == 'g') {
+    value <<= 30;
+    ++end;
+  }
+  *bytes = static_cast<size_t>(value);
+  return *end == '\0' && value != 0;
+}
+
+// Returns whether FlushFromCaches is supported.
+bool CanFlush() { return HH_ARCH_X64 != 0; }
+
+// Evicts all cache lines of "bytes" from every cache level.
+void FlushFromCaches(const char* bytes, const size_t size) {
+#if HH_ARCH_X64
+  for (size_t i = 0; i < size; i += 64) {
+    _mm_clflush(bytes + i);
+  }
+  _mm_clflush(bytes + size - 1);
+  _mm_mfence();
+#else
+  (void)bytes;
+  (void)size;
+#endif
+}
+
+// Reference for the hash throughput: reads all "size" bytes (a multiple of 8)
+// with independent sums, which the compiler vectorizes.
+uint64_t SumWords(const char* bytes, const size_t size) {
+  uint64_t sum[4] = {0};
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int lane = 0; lane < 4; ++lane) {
+      uint64_t word;
+      memcpy(&word, bytes + i + lane * 8, 8);
+      sum[lane] += word;
+    }
+  }
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    sum[0] += word;
+  }
+  return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+// Returns the median of the durations [s] of "num_reps" calls to "func",
+// optionally flushing "bytes" from the caches before each. Without flushing,
+// an initial call warms up the caches.
+template <class Func>
+double MedianSeconds(const char* bytes, const size_t size, const bool flush,
+                     const int num_reps, const Func& func) {
+  if (!flush) func();
+  std::vector<double> seconds;
+  for (int rep = 0; rep < num_reps; ++rep) {
+    if (flush) FlushFromCaches(bytes, size);
+    const auto t0 = std::chrono::steady_clock::now();
+    func();
+    const auto t1 = std::chrono::steady_clock::now();
+    seconds.push_back(std::chrono::duration<double>(t1 - t0).count());
+  }
+  return Median(&seconds);
+}
+
+// For each of "working_sets" and "targets", hashes a buffer of random bytes
+// of that size as consecutive messages of "message_size" bytes and prints the
+// throughput and read bandwidth of the same buffer in the given format.
+// Returns the exit code.
+int MeasureWorkingSets(const std::vector<size_t>& working_sets,
+                       const size_t message_size, const bool flush,
+                       const TargetBits targets, const std::string& format) {
+  if (flush && !CanFlush()) {
+    fprintf(stderr, "--flush is not supported on this architecture\n");
+    return 1;
+  }
+
+  struct Result {
+    size_t working_set;
+    const char* target;
+    double gbps;       // hashing
+    double read_gbps;  // SumWords of the same buffer
+  };
+  std::vector<Result> results;
+  std::mt19937_64 rng(12345);
+  const HHKey key = {0, 1, 2, 3};
+  const int kReps = 5;
+  for (const size_t requested : working_sets) {
+    // Whole messages and 64-bit words.
+    const size_t piece = std::min(message_size, requested);
+    const size_t working_set =
+        std::max<size_t>(requested / piece * piece, 8) & ~size_t{7};
+    // New random contents for each size; filling also faults in the pages.
+    std::vector<char> buffer(working_set);
+    for (size_t i = 0; i + 8 <= working_set; i += 8) {
+      const uint64_t random = rng();
+      memcpy(buffer.data() + i, &random, 8);
+    }
+    std::vector<StringView> messages;
+    for (size_t pos = 0; pos < working_set; pos += piece) {
+      StringView message;
+      message.data = buffer.data() + pos;
+      message.num_bytes = std::min(piece, working_set - pos);
+      messages.push_back(message);
+    }
+
+    uint64_t read_sum = 0;
+    const double read_seconds =
+        MedianSeconds(buffer.data(), working_set, flush, kReps, [&]() {
+          read_sum += SumWords(buffer.data(), working_set);
+        });
+
+    HH_TARGET_NAME::ForeachTarget(
+        targets & InstructionSets::Supported(), [&](const TargetBits target) {
+          HHResult64 sum = 0;
+          const double seconds =
+              MedianSeconds(buffer.data(), working_set, flush, kReps, [&]() {
+                RunTarget<HighwayHashMessagesBenchmark>(
+                    target, key, messages.data(), messages.size(), &sum);
+              });
+          // Prevents the compiler from eliding the hashing or reading.
+          if (sum == 0 && read_sum == 0) fprintf(stderr, "(zero sum)\n");
+
+          Result result;
+          result.working_set = working_set;
+          result.target = TargetName(target);
+          result.gbps = working_set / seconds * 1E-9;
+          result.read_gbps = working_set / read_seconds * 1E-9;
+          results.push_back(result);
+          fprintf(stderr, "%zu %s: %.3f GB/s\n", working_set, result.target,
+                  result.gbps);
+        });
+  }
+
+  if (format == "json") {
+    printf("{\n  \"message_size\": %zu,\n  \"flush\": %s,\n", message_size,
+           flush ? "true" : "false");
+    printf("  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result& r = results[i];
+      printf("%s\n    {\"working_set\": %zu, \"target\": \"%s\", "
+             "\"gb_per_s\": %.3f, \"read_gb_per_s\": %.3f}",
+             i == 0 ? "" : ",", r.working_set, r.target, r.gbps, r.read_gbps);
+    }
+    printf("\n  ]\n}\n");
+  } else if (format == "csv") {
+    printf("working_set,message_size,flush,target,gb_per_s,read_gb_per_s\n");
+    for (const Result& r : results) {
+      printf("%zu,%zu,%d,%s,%.3f,%.3f\n", r.working_set, message_size,
+             flush ? 1 : 0, r.target, r.gbps, r.read_gbps);
+    }
+  } else {
+    printf("%zu-byte messages, %s caches\n", message_size,
+           flush ? "flushed" : "warm");
+    printf("%12s %-8s %8s %10s %9s\n", "Working set", "Target", "GB/s",
+           "Read GB/s", "Hash/Read");
+    for (const Result& r : results) {
+      printf("%12zu %-8s %8.3f %10.3f %8.1f%%\n", r.working_set, r.target,
+             r.gbps, r.read_gbps, r.gbps / r.read_gbps * 100.0);
+    }
+  }
+  return 0;
+}
+
+#if BENCHMARK_HIGHWAY
+
+// Hashes "size" bytes with the HighwayHashFunctions pointed to by "arg".
+uint64_t RunHighwayHashFunctions(const void* arg, const size_t size) {
+  const HighwayHashFunctions* functions =
+      static_cast<const HighwayHashFunctions*>(arg);
+  char in[kMaxBenchmarkInputSize];
+  memcpy(in, &size, sizeof(size));
+  HHResult64 hash;
+  functions->hash64(kDispatchKey, in, size, &hash);
+  return hash;
+}
+
+// Compares HighwayHash of "target_b" with "target_a" for each of "in_sizes"
+// via CompareDurations and prints the relative change with its confidence
+// interval. Returns 2 if B is slower than A by more than "max_regression"
+// (a fraction) with 95% confidence, otherwise 0.
+int MeasureComparison(const TargetBits target_a, const TargetBits target_b,
+                      const std::vector<size_t>& in_sizes,
+                      const size_t samples, const double max_regression,
+                      const std::string& format) {
+  HighwayHashFunctions functions_a, functions_b;
+  RunTarget<HighwayHashSelect>(target_a, &functions_a);
+  RunTarget<HighwayHashSelect>(target_b, &functions_b);
+  DurationsForInputs input_map_a(in_sizes.data(), in_sizes.size(), samples);
+  DurationsForInputs input_map_b(in_sizes.data(), in_sizes.size(), samples);
+  std::vector<DurationComparison> comparisons(in_sizes.size());
+  comparisons.resize(CompareDurations(
+      &RunHighwayHashFunctions, &RunHighwayHashFunctions, &input_map_a,
+      &input_map_b, comparisons.data(),
+      reinterpret_cast<const uint8_t*>(&functions_a),
+      reinterpret_cast<const uint8_t*>(&functions_b)));
+
+  const char* name_a = TargetName(target_a);
+  const char* name_b = TargetName(target_b);
+  bool regressed = false;
+  for (const DurationComparison& c : comparisons) {
+    if (c.change_lower > max_regression) regressed = true;
+  }
+
+  if (format == "json") {
+    printf("{\n  \"a\": \"%s\",\n  \"b\": \"%s\",\n", name_a, name_b);
+    printf("  \"max_regression\": %.4f,\n  \"regressed\": %s,\n",
+           max_regression, regressed ? "true" : "false");
+    printf("  \"results\": [");
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+      const DurationComparison& c = comparisons[i];
+      printf("%s\n    {\"size\": %zu, \"median_ticks_a\": %.1f, "
+             "\"median_ticks_b\": %.1f, \"change\": %.4f, "
+             "\"change_lower\": %.4f, \"change_upper\": %.4f}",
+             i == 0 ? "" : ",", c.input, c.median_a, c.median_b, c.change,
+             c.change_lower, c.change_upper);
+    }
+    printf("\n  ]\n}\n");
+  } else if (format == "csv") {
+    printf("a,b,size,median_ticks_a,median_ticks_b,change,change_lower,"
+           "change_upper\n");
+    for (const DurationComparison& c : comparisons) {
+      printf("%s,%s,%zu,%.1f,%.1f,%.4f,%.4f,%.4f\n", name_a, name_b, c.input,
+             c.median_a, c.median_b, c.change, c.change_lower, c.change_upper);
+    }
+  } else {
+    printf("A = %s, B = %s; change = (B - A) / A with 95%% confidence\n",
+           name_a, name_b);
+    printf("%5s %8s %8s %8s %20s\n", "Size", "A", "B", "Change", "Interval");
+    for (const DurationComparison& c : comparisons) {
+      printf("%5zu %8.1f %8.1f %+7.1f%% [%+7.1f%%, %+7.1f%%]%s\n", c.input,
+             c.median_a, c.median_b, c.change * 100.0,
+             c.change_lower * 100.0, c.change_upper * 100.0,
+             c.change_lower > max_regression ? " REGRESSION" : "");
+    }
+  }
+
+  if (regressed) {
+    fprintf(stderr, "%s is more than %.1f%% slower than %s\n", name_b,
+            max_regression * 100.0, name_a);
+    return 2;
+  }
+  return 0;
+}
+
+// Fills "size" (a multiple of 8) bytes with random bits, which also faults in
+// the pages.
+void FillRandom(std::mt19937_64* rng, const size_t size, char* bytes) {
+  for (size_t i = 0; i + 8 <= size; i += 8) {
+    const uint64_t random = (*rng)();
+    memcpy(bytes + i, &random, 8);
+  }
+}
+
+// For each of "targets", alternates between reading a "hot_size" buffer (the
+// co-running workload, e.g. a cache-resident table) and hashing the next chunk
+// of a much larger stream that is never reused, first with HighwayHash and
+// then with HighwayHashNonTemporal (prefetching "prefetch_distance" ahead).
+// Prints the hashing throughput and the read bandwidth of the hot buffer in
+// the given format. The more of the hot buffer the hashing evicts, the lower
+// the latter compared to reading it without hashing in between. Returns the
+// exit code.
+int MeasureInterference(const size_t hot_size, const size_t prefetch_distance,
+                        const TargetBits targets, const std::string& format) {
+  struct Result {
+    const char* target;
+    const char* mode;
+    double gbps;      // hashing
+    double hot_gbps;  // SumWords of the hot buffer after each chunk
+  };
+  std::vector<Result> results;
+  std::mt19937_64 rng(12345);
+  const HHKey key = {0, 1, 2, 3};
+
+  // Many times as large as the hot buffer, and together larger than any
+  // last-level cache, so that each chunk is read from DRAM.
+  const size_t hot = std::max<size_t>(hot_size, 8) & ~size_t{7};
+  const size_t chunk = 16 * hot;
+  const size_t num_chunks = std::max<size_t>(4, (size_t{256} << 20) / chunk);
+  std::vector<char> hot_buffer(hot);
+  std::vector<char> stream(chunk * num_chunks);
+  FillRandom(&rng, hot, hot_buffer.data());
+  FillRandom(&rng, stream.size(), stream.data());
+
+  uint64_t hot_sum = 0;
+  const int kHotReps = 9;
+  const double alone_seconds =
+      MedianSeconds(hot_buffer.data(), hot, false, kHotReps, [&]() {
+        hot_sum += SumWords(hot_buffer.data(), hot);
+      });
+
+  HH_TARGET_NAME::ForeachTarget(
+      targets & InstructionSets::Supported(), [&](const TargetBits target) {
+        for (const bool non_temporal : {false, true}) {
+          HHResult64 sum = 0;
+          double hash_seconds = 0.0;
+          std::vector<double> hot_seconds;
+          // Two passes over the stream; the first chunks warm up.
+          for (size_t i = 0; i < 2 * num_chunks; ++i) {
+            // Brings the hot buffer back into the caches.
+            hot_sum += SumWords(hot_buffer.data(), hot);
+            const char* bytes = stream.data() + (i % num_chunks) * chunk;
+            HHResult64 hash;
+            const auto t0 = std::chrono::steady_clock::now();
+            if (non_temporal) {
+              RunTarget<HighwayHashNonTemporal>(target, key, bytes, chunk,
+                                                &hash, prefetch_distance);
+            } else {
+              RunTarget<HighwayHash>(target, key, bytes, chunk, &hash);
+            }
+            const auto t1 = std::chrono::steady_clock::now();
+            hot_sum += SumWords(hot_buffer.data(), hot);
+            const auto t2 = std::chrono::steady_clock::now();
+            sum += hash;
+            if (i < num_chunks) continue;
+            hash_seconds += std::chrono::duration<double>(t1 - t0).count();
+            hot_seconds.push_back(
+                std::chrono::duration<double>(t2 - t1).count());
+          }
+          // Prevents the compiler from eliding the hashing or reading.
+          if (sum == 0 && hot_sum == 0) fprintf(stderr, "(zero sum)\n");
+
+          Result result;
+          result.target = TargetName(target);
+          result.mode = non_temporal ? "NonTemporal" : "HighwayHash";
+          result.gbps = num_chunks * chunk / hash_seconds * 1E-9;
+          result.hot_gbps = hot / Median(&hot_seconds) * 1E-9;
+          results.push_back(result);
+          fprintf(stderr, "%s %s: %.3f GB/s\n", result.target, result.mode,
+                  result.gbps);
+        }
+      });
+
+  const double alone_gbps = hot / alone_seconds * 1E-9;
+  if (format == "json") {
+    printf("{\n  \"hot_size\": %zu,\n  \"chunk_size\": %zu,\n", hot, chunk);
+    printf("  \"prefetch_distance\": %zu,\n  \"hot_alone_gb_per_s\": %.3f,\n",
+           prefetch_distance, alone_gbps);
+    printf("  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result& r = results[i];
+      printf("%s\n    {\"target\": \"%s\", \"mode\": \"%s\", "
+             "\"gb_per_s\": %.3f, \"hot_gb_per_s\": %.3f}",
+             i == 0 ? "" : ",", r.target, r.mode, r.gbps, r.hot_gbps);
+    }
+    printf("\n  ]\n}\n");
+  } else if (format == "csv") {
+    printf("hot_size,chunk_size,prefetch_distance,target,mode,gb_per_s,"
+           "hot_gb_per_s,hot_alone_gb_per_s\n");
+    for (const Result& r : results) {
+      printf("%zu,%zu,%zu,%s,%s,%.3f,%.3f,%.3f\n", hot, chunk,
+             prefetch_distance, r.target, r.mode, r.gbps, r.hot_gbps,
+             alone_gbps);
+    }
+  } else {
+    printf("%zu-byte hot buffer, %zu-byte chunks, prefetch distance %zu\n",
+           hot, chunk, prefetch_distance);
+    printf("Hot buffer alone: %.3f GB/s\n", alone_gbps);
+    printf("%-8s %-12s %8s %9s %9s\n", "Target", "Mode", "GB/s", "Hot GB/s",
+           "Hot/Alone");
+    for (const Result& r : results) {
+      printf("%-8s %-12s %8.3f %9.3f %8.1f%%\n", r.target, r.mode, r.gbps,
+             r.hot_gbps, r.hot_gbps / alone_gbps * 100.0);
+    }
+  }
+  return 0;
+}
+
+#endif  // BENCHMARK_HIGHWAY
+
+// Returns the comma-separated items of "list".
+std::vector<std::string> SplitList(const char* list) {
+  std::vector<std::string> items;
+  std::string item;
+  for (const char* p = list;; ++p) {
+    if (*p == ',' || *p == '\0') {
+      if (!item.empty()) items.push_back(item);
+      item.clear();
+      if (*p == '\0') break;
+    } else {
+      item += *p;
+    }
+  }
+  return items;
+}
+
+// Returns the HH_TARGET_* bit whose TargetName is "name", or 0 if unknown.
+TargetBits ParseTarget(const std::string& name) {
+  for (TargetBits bit = 1; bit != 0; bit <<= 1) {
+    const char* target_name = TargetName(bit);
+    if (target_name != nullptr && name == target_name) return bit;
+  }
+  return 0;
+}
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: benchmark [t|p|b|k|r|s|f|d]\n"
+          "   or: benchmark [--algorithms=A,B] [--targets=T,U] "
+          "[--sizes=N,M] [--samples=N] [--events=0|1] "
+          "[--format=text|json|csv]\n"
+          "   or: benchmark --distribution=uniform:MIN-MAX|zipf:S:MAX|"
+          "file:PATH [--targets=T,U] [--format=...]\n"
+          "   or: benchmark --working_sets=N,M|sweep [--message_size=N] "
+          "[--flush=0|1] [--targets=T,U] [--format=...]\n"
+          "   or: benchmark --interference=HOT_SIZE "
+          "[--prefetch_distance=N] [--targets=T,U] [--format=...]\n"
+          "   or: benchmark --compare=A,B [--max_regression=PCT] "
+          "[--sizes=N,M] [--samples=N] [--format=...]\n"
+          "Algorithms:");
+  for (const Algorithm& algorithm : kAlgorithms) {
+    fprintf(stderr, " %s%s", algorithm.name, algorithm.is_default ? "*" : "");
+  }
+  fprintf(stderr, " (* = default)\nSupported targets:");
+  HH_TARGET_NAME::ForeachTarget(
+      InstructionSets::Supported(), [](const TargetBits target) {
+        fprintf(stderr, " %s", TargetName(target));
+      });
+  fprintf(stderr, "\nSizes: 1..%zu (default 7,8,31,32,63,64,1024)\n",
+          kMaxBenchmarkInputSize);
+}
+
+// Measures the algorithms, targets and sizes given by command-line flags and
+// prints the results in the given format. Returns the exit code.
+int RunFromFlags(int argc, char* argv[]) {
+  std::vector<const Algorithm*> algorithms;
+  TargetBits targets = ~0u;
+  std::vector<size_t> in_sizes = {7, 8, 31, 32, 63, 64, kMaxBenchmarkInputSize};
+  size_t samples = 40;
+  std::string format = "text";
+  std::string distribution;
+  std::vector<size_t> working_sets;
+  size_t message_size = 64 * 1024;
+  bool flush = false;
+  size_t interference = 0;
+  size_t prefetch_distance = HH_PREFETCH_DISTANCE;
+  bool events = false;
+  std::vector<TargetBits> compare;
+  double max_regression = 0.05;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--help") == 0) {
+      PrintUsage();
+      return 0;
+    }
+    const char* value = strchr(arg, '=');
+    if (value == nullptr) {
+      fprintf(stderr, "Expected --flag=value, got %s\n", arg);
+      PrintUsage();
+      return 1;
+    }
+    const std::string flag(arg, value - arg);
+    ++value;
+
+    if (flag == "--algorithms") {
+      for (const std::string& name : SplitList(value)) {
+        const Algorithm* found = nullptr;
+        for (const Algorithm& algorithm : kAlgorithms) {
+          if (name == algorithm.name) found = &algorithm;
+        }
+        if (found == nullptr) {
+          fprintf(stderr, "Unknown or not compiled-in algorithm %s\n",
+                  name.c_str());
+          PrintUsage();
+          return 1;
+        }
+        algorithms.push_back(found);
+      }
+    } else if (flag == "--targets") {
+      targets = 0;
+      for (const std::string& name : SplitList(value)) {
+        const TargetBits target = ParseTarget(name);
+        if (target == 0) {
+          fprintf(stderr, "Unknown target %s\n", name.c_str());
+          PrintUsage();
+          return 1;
+        }
+        if ((InstructionSets::Supported() & target) == 0) {
+          fprintf(stderr, "Skipping %s: not supported by this CPU\n",
+                  name.c_str());
+        }
+        targets |= target;
+      }
+    } else if (flag == "--sizes") {
+      in_sizes.clear();
+      for (const std::string& item : SplitList(value)) {
+        char* end;
+        const unsigned long size = strtoul(item.c_str(), &end, 10);
+        if (*end != '\0' || size == 0 || size > kMaxBenchmarkInputSize) {
+          fprintf(stderr, "Invalid size %s\n", item.c_str());
+          PrintUsage();
+          return 1;
+        }
+        in_sizes.push_back(size);
+      }
+    } else if (flag == "--samples") {
+      samples = strtoul(value, nullptr, 10);
+    } else if (flag == "--format") {
+      format = value;
+    } else if (flag == "--distribution") {
+      distribution = value;
+    } else if (flag == "--working_sets") {
+      working_sets.clear();
+      if (strcmp(value, "sweep") == 0) {
+        for (size_t bytes = kSweepMinWorkingSet; bytes <= kSweepMaxWorkingSet;
+             bytes *= 4) {
+          working_sets.push_back(bytes);
+        }
+      } else {
+        for (const std::string& item : SplitList(value)) {
+          size_t bytes;
+          if (!ParseByteSize(item, &bytes)) {
+            fprintf(stderr, "Invalid working set %s\n", item.c_str());
+            PrintUsage();
+            return 1;
+          }
+          working_sets.push_back(bytes);
+        }
+      }
+    } else if (flag == "--message_size") {
+      if (!ParseByteSize(value, &message_size)) {
+        fprintf(stderr, "Invalid message size %s\n", value);
+        PrintUsage();
+        return 1;
+      }
+    } else if (flag == "--interference") {
+      if (!ParseByteSize(value, &interference)) {
+        fprintf(stderr, "Invalid hot buffer size %s\n", value);
+        PrintUsage();
+        return 1;
+      }
+    } else if (flag == "--prefetch_distance") {
+      char* end;
+      prefetch_distance = strtoul(value, &end, 10);
+      if (*end != '\0') {
+        fprintf(stderr, "Invalid prefetch distance %s\n", value);
+        PrintUsage();
+        return 1;
+      }
+    } else if (flag == "--flush") {
+      flush = strcmp(value, "0") != 0;
+    } else if (flag == "--events") {
+      events = strcmp(value, "0") != 0;
+    } else if (flag == "--compare") {
+      for (const std::string& name : SplitList(value)) {
+        const TargetBits target = ParseTarget(name);
+        if ((InstructionSets::Supported() & target) == 0) {
+          fprintf(stderr, "Unknown or unsupported target %s\n", name.c_str());
+          PrintUsage();
+          return 1;
+        }
+        compare.push_back(target);
+      }
+      if (compare.size() != 2) {
+        fprintf(stderr, "--compare requires two targets\n");
+        PrintUsage();
+        return 1;
+      }
+    } else if (flag == "--max_regression") {
+      max_regression = strtod(value, nullptr) / 100.0;
+    } else {
+      fprintf(stderr, "Unknown flag %s\n", flag.c_str());
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  if (format != "text" && format != "json" && format != "csv") {
+    fprintf(stderr, "Unknown format %s\n", format.c_str());
+    PrintUsage();
+    return 1;
+  }
+  if (!distribution.empty()) {
+    return MeasureDistribution(distribution, targets, format);
+  }
+  if (!working_sets.empty()) {
+    return MeasureWorkingSets(working_sets, message_size, flush, targets,
+                              format);
+  }
+  if (interference != 0) {
+#if BENCHMARK_HIGHWAY
+    return MeasureInterference(interference, prefetch_distance, targets,
+                               format);
+#else
+    fprintf(stderr, "--interference requires BENCHMARK_HIGHWAY\n");
+    return 1;
+#endif
+  }
+  if (in_sizes.empty() || samples == 0) {
+    fprintf(stderr, "Need at least one size and sample\n");
+    PrintUsage();
+    return 1;
+  }
+  if (!compare.empty()) {
+#if BENCHMARK_HIGHWAY
+    return MeasureComparison(compare[0], compare[1], in_sizes, samples,
+                             max_regression, format);
+#else
+    fprintf(stderr, "--compare requires BENCHMARK_HIGHWAY\n");
+    return 1;
+#endif
+  }
+  if (algorithms.empty()) {
+    for (const Algorithm& algorithm : kAlgorithms) {
+      if (algorithm.is_default) algorithms.push_back(&algorithm);
+    }
+  }
+
+  DurationsForInputs input_map(in_sizes.data(), in_sizes.size(), samples);
+  input_map.measure_events = events;
+  Measurements measurements;
+  for (const Algorithm* algorithm : algorithms) {
+    algorithm->measure(targets, &input_map, &measurements);
+  }
+
+  if (format == "json") {
+    measurements.PrintJson();
+  } else if (format == "csv") {
+    measurements.PrintCsv();
+  } else {
+    measurements.PrintText();
+  }
+  return 0;
+}
+
 }  // namespace
 }  // namespace highwayhash
 
 int main(int argc, char* argv[]) {
+  if (argc >= 2 && argv[1][0] == '-') {
+    return highwayhash::RunFromFlags(argc, argv);
+  }
+
   // No argument or t => table
   if (argc < 2 || argv[1][0] == 't') {
     highwayhash::PrintTable();
   } else if (argv[1][0] == 'p') {
     highwayhash::PrintPlots();
+  } else if (argv[1][0] == 'b') {
+    highwayhash::PrintBatch();
+  } else if (argv[1][0] == 'k') {
+    highwayhash::PrintFixed();
+  } else if (argv[1][0] == 'r') {
+    highwayhash::PrintShort();
+#if BENCHMARK_SIP
+  } else if (argv[1][0] == 's') {
+    highwayhash::PrintSipBatch();
+#endif
+  } else if (argv[1][0] == 'f') {
+    highwayhash::PrintFragments();
+#if BENCHMARK_HIGHWAY
+  } else if (argv[1][0] == 'd') {
+    highwayhash::PrintDispatch();
+#endif
   }
   return 0;
 }
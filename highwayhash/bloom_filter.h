@@ -0,0 +1,280 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_BLOOM_FILTER_H_
+#define HIGHWAYHASH_BLOOM_FILTER_H_
+
+// Cache-line-blocked Bloom filter keyed with HighwayHash, e.g. for negative
+// lookups in front of a storage tier. Unlike filters built on unkeyed hashes,
+// an attacker who does not know the key cannot choose inputs that all map to
+// the same (saturated) block.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memset
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+#include "highwayhash/table_helpers.h"
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Each element sets one bit in each of the 8 words of a single 64-byte block,
+// so that inserts and queries touch one cache line. The block index and bit
+// positions are derived from one HHResult128: the upper 32 bits of hash[0]
+// select the block (multiply-shift, so any number of blocks up to 2^32 is
+// allowed) and successive 6-bit fields of hash[1] select the bit within each
+// word. The layout is the same for all targets, so a filter built by one
+// target may be queried by another (see Data).
+//
+// Measured false positive rate (see bloom_filter_benchmark): 0.09% for 16
+// bits per element (the default of NumBlocksFor), 1.0% for 10 and 9% for 6.
+class BloomFilter {
+ public:
+  static constexpr size_t kWordsPerBlock = 8;
+  static constexpr size_t kBlockBytes = kWordsPerBlock * sizeof(uint64_t);
+
+  // Maximum number of keys per iteration of the batch functions.
+  static constexpr size_t kBatchSize = kMaxPrefetchKeys;
+
+  // Returns the number of blocks for "num_elements" at "bits_per_element".
+  static HH_INLINE size_t NumBlocksFor(const size_t num_elements,
+                                       const size_t bits_per_element = 16) {
+    const size_t bits_per_block = kBlockBytes * 8;
+    const size_t num_blocks =
+        (num_elements * bits_per_element + bits_per_block - 1) /
+        bits_per_block;
+    return num_blocks == 0 ? 1 : num_blocks;
+  }
+
+  // "num_blocks" must be in [1, 2^32]. All bits are initially zero.
+  HH_INLINE BloomFilter(const HHKey& key, const size_t num_blocks)
+      : initial_(key),
+        num_blocks_(num_blocks),
+        allocated_(new char[num_blocks * kBlockBytes + kBlockBytes]) {
+    words_ = reinterpret_cast<uint64_t*>(AlignUp(allocated_, kBlockBytes));
+    memset(words_, 0, num_blocks * kBlockBytes);
+  }
+
+  BloomFilter(const BloomFilter&) = delete;
+  BloomFilter& operator=(const BloomFilter&) = delete;
+
+  HH_INLINE ~BloomFilter() { delete[] allocated_; }
+
+  HH_INLINE size_t NumBlocks() const { return num_blocks_; }
+  HH_INLINE size_t Bytes() const { return num_blocks_ * kBlockBytes; }
+
+  // Bytes() bytes of native-endian words, e.g. for persisting the filter.
+  // Loading them into a filter with the same key and number of blocks (on a
+  // host with the same byte order) restores it.
+  HH_INLINE const uint64_t* Data() const { return words_; }
+  HH_INLINE uint64_t* MutableData() { return words_; }
+
+  // Computes the 128-bit hash from which Insert/MayContain derive positions.
+  HH_INLINE void Hash(const char* HH_RESTRICT bytes, const size_t size,
+                      HHResult128* HH_RESTRICT hash) const {
+    HHStateT<HH_TARGET> state = initial_;
+    HighwayHashT(&state, bytes, size, hash);
+  }
+
+  HH_INLINE void Insert(const char* HH_RESTRICT bytes, const size_t size) {
+    HHResult128 hash;
+    Hash(bytes, size, &hash);
+    InsertHash(hash);
+  }
+
+  // Returns false if "bytes" was definitely not inserted.
+  HH_INLINE bool MayContain(const char* HH_RESTRICT bytes,
+                            const size_t size) const {
+    HHResult128 hash;
+    Hash(bytes, size, &hash);
+    return MayContainHash(hash);
+  }
+
+  // Same as Insert/MayContain for a caller-computed hash, which must be the
+  // result of Hash for the same key (otherwise the filter is not keyed). The
+  // HHResult256 overloads use only the first two words, e.g. for callers that
+  // already computed a 256-bit hash of the element for another purpose.
+  HH_INLINE void InsertHash(const HHResult128& hash) {
+    InsertHash(hash[0], hash[1]);
+  }
+  HH_INLINE void InsertHash(const HHResult256& hash) {
+    InsertHash(hash[0], hash[1]);
+  }
+  HH_INLINE bool MayContainHash(const HHResult128& hash) const {
+    return MayContainHash(hash[0], hash[1]);
+  }
+  HH_INLINE bool MayContainHash(const HHResult256& hash) const {
+    return MayContainHash(hash[0], hash[1]);
+  }
+
+  // Inserts each of the "num_keys" "keys". Hashes up to kBatchSize keys and
+  // prefetches their blocks before updating any, so that the cache misses
+  // overlap with each other and the remaining hashing.
+  HH_INLINE void InsertBatch(const StringView* HH_RESTRICT keys,
+                             const size_t num_keys) {
+    HHResult128 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        InsertHash(hashes[i]);
+      }
+    }
+  }
+
+  // Sets results[i] to MayContain(keys[i]) for all i < "num_keys", in the
+  // same manner as InsertBatch.
+  HH_INLINE void MayContainBatch(const StringView* HH_RESTRICT keys,
+                                 const size_t num_keys,
+                                 bool* HH_RESTRICT results) const {
+    HHResult128 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        results[first + i] = MayContainHash(hashes[i]);
+      }
+    }
+  }
+
+ private:
+  HH_INLINE const uint64_t* Block(const uint64_t hash0) const {
+    const size_t index = static_cast<size_t>(((hash0 >> 32) * num_blocks_) >>
+                                             32);
+    return words_ + index * kWordsPerBlock;
+  }
+
+  HH_INLINE void HashAndPrefetch(const StringView* HH_RESTRICT keys,
+                                 const size_t count,
+                                 HHResult128* HH_RESTRICT hashes) const {
+    for (size_t i = 0; i < count; ++i) {
+      Hash(keys[i].data, keys[i].num_bytes, &hashes[i]);
+      HH_PREFETCH(Block(hashes[i][0]));
+    }
+  }
+
+  // Bit of word "w" of the block: the 6-bit field "w" of hash1.
+  static HH_INLINE uint64_t WordMask(const uint64_t hash1, const size_t w) {
+    return 1ULL << ((hash1 >> (w * 6)) & 63);
+  }
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+  // Masks for words [0, 4) and [4, 8), i.e. WordMask for each lane.
+  static HH_INLINE void Masks(const uint64_t hash1, V4x64U* HH_RESTRICT lower,
+                              V4x64U* HH_RESTRICT upper) {
+    const V4x64U bits(hash1);
+    const V4x64U k63(63);
+    const V4x64U one(1);
+    const V4x64U shift_lower(18, 12, 6, 0);
+    const V4x64U shift_upper(42, 36, 30, 24);
+    const V4x64U pos_lower(V4x64U(_mm256_srlv_epi64(bits, shift_lower)) & k63);
+    const V4x64U pos_upper(V4x64U(_mm256_srlv_epi64(bits, shift_upper)) & k63);
+    *lower = V4x64U(_mm256_sllv_epi64(one, pos_lower));
+    *upper = V4x64U(_mm256_sllv_epi64(one, pos_upper));
+  }
+#elif HH_TARGET == HH_TARGET_NEON
+  // Masks for words [2 * i, 2 * i + 2), i.e. WordMask for each lane.
+  static HH_INLINE void Masks(const uint64_t hash1,
+                              V2x64U* HH_RESTRICT masks) {
+    const V2x64U k63(63);
+    for (size_t i = 0; i < 4; ++i) {
+      V2x64U pos(hash1);
+      pos >>= V2x64U(12 * i + 6, 12 * i);
+      pos &= k63;
+      masks[i] = V2x64U(1);
+      masks[i] <<= pos;
+    }
+  }
+#endif
+
+  HH_INLINE void InsertHash(const uint64_t hash0, const uint64_t hash1) {
+    uint64_t* HH_RESTRICT block = const_cast<uint64_t*>(Block(hash0));
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    V4x64U lower, upper;
+    Masks(hash1, &lower, &upper);
+    lower |= Load<V4x64U>(block);
+    upper |= Load<V4x64U>(block + 4);
+    Store(lower, block);
+    Store(upper, block + 4);
+#elif HH_TARGET == HH_TARGET_NEON
+    V2x64U masks[4];
+    Masks(hash1, masks);
+    for (size_t i = 0; i < 4; ++i) {
+      masks[i] |= Load<V2x64U>(block + 2 * i);
+      Store(masks[i], block + 2 * i);
+    }
+#else
+    for (size_t w = 0; w < kWordsPerBlock; ++w) {
+      block[w] |= WordMask(hash1, w);
+    }
+#endif
+  }
+
+  HH_INLINE bool MayContainHash(const uint64_t hash0,
+                                const uint64_t hash1) const {
+    const uint64_t* HH_RESTRICT block = Block(hash0);
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    V4x64U lower, upper;
+    Masks(hash1, &lower, &upper);
+    // Bits of the masks that are not set in the block.
+    const V4x64U missing = AndNot(Load<V4x64U>(block), lower) |
+                           AndNot(Load<V4x64U>(block + 4), upper);
+    return _mm256_testz_si256(missing, missing) != 0;
+#elif HH_TARGET == HH_TARGET_NEON
+    V2x64U masks[4];
+    Masks(hash1, masks);
+    V2x64U missing(masks[0].AndNot(Load<V2x64U>(block)));
+    for (size_t i = 1; i < 4; ++i) {
+      missing |= masks[i].AndNot(Load<V2x64U>(block + 2 * i));
+    }
+    return (vgetq_lane_u64(missing, 0) | vgetq_lane_u64(missing, 1)) == 0;
+#else
+    uint64_t missing = 0;
+    for (size_t w = 0; w < kWordsPerBlock; ++w) {
+      missing |= WordMask(hash1, w) & ~block[w];
+    }
+    return missing == 0;
+#endif
+  }
+
+  const HHStateT<HH_TARGET> initial_;
+  const size_t num_blocks_;
+  char* const allocated_;
+  uint64_t* words_;  // cache-line aligned, within allocated_
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_BLOOM_FILTER_H_
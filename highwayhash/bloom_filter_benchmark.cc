@@ -0,0 +1,128 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the false positive rate and query throughput of BloomFilter, with
+// MayContain per key and with MayContainBatch.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "highwayhash/bloom_filter.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kNumQueries = 1 << 22;
+const size_t kKeyBytes = 16;
+
+using Filter = HH_TARGET_NAME::BloomFilter;
+
+// Views of each kKeyBytes of "bytes", which are random and thus distinct (with
+// high probability).
+std::vector<StringView> MakeKeys(const std::vector<char>& bytes) {
+  std::vector<StringView> keys(bytes.size() / kKeyBytes);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = StringView{bytes.data() + i * kKeyBytes, kKeyBytes};
+  }
+  return keys;
+}
+
+template <class Query>
+void Measure(const char* caption, const Query& query, const size_t expected) {
+  double best = 1E10;
+  for (int rep = 0; rep < 3; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t num_positive = query();
+    const auto t1 = std::chrono::steady_clock::now();
+    if (num_positive != expected) {
+      printf("%s: wrong count %zu\n", caption, num_positive);
+      exit(1);
+    }
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  printf("%32s: %6.2f M queries/s\n", caption, kNumQueries / best * 1E-6);
+}
+
+// Inserts "num_elements" keys and queries kNumQueries keys, half of which were
+// not inserted.
+void Run(const size_t num_elements, const size_t bits_per_element) {
+  std::mt19937_64 rng(12345);
+  std::vector<char> bytes((num_elements + kNumQueries) * kKeyBytes);
+  for (char& byte : bytes) {
+    byte = static_cast<char>(rng());
+  }
+  const std::vector<StringView> keys = MakeKeys(bytes);
+
+  Filter filter(kKey, Filter::NumBlocksFor(num_elements, bits_per_element));
+  filter.InsertBatch(keys.data(), num_elements);
+
+  // Even queries are inserted keys, odd queries were not inserted.
+  std::vector<StringView> queries(kNumQueries);
+  for (size_t i = 0; i < kNumQueries; ++i) {
+    queries[i] = i % 2 == 0 ? keys[rng() % num_elements]
+                            : keys[num_elements + i];
+  }
+
+  size_t num_false_positives = 0;
+  for (size_t i = 1; i < kNumQueries; i += 2) {
+    num_false_positives +=
+        filter.MayContain(queries[i].data, queries[i].num_bytes);
+  }
+  const size_t expected = kNumQueries / 2 + num_false_positives;
+
+  printf("Target %s, %zu elements, %zu bits each, %zu KiB: %.3f%% FPR\n",
+         TargetName(HH_TARGET), num_elements, bits_per_element,
+         filter.Bytes() >> 10,
+         100.0 * num_false_positives / (kNumQueries / 2));
+  Measure("MayContain", [&] {
+    size_t num_positive = 0;
+    for (const StringView& query : queries) {
+      num_positive += filter.MayContain(query.data, query.num_bytes);
+    }
+    return num_positive;
+  }, expected);
+  Measure("MayContainBatch", [&] {
+    size_t num_positive = 0;
+    bool results[Filter::kBatchSize];
+    for (size_t first = 0; first < kNumQueries; first += Filter::kBatchSize) {
+      filter.MayContainBatch(queries.data() + first, Filter::kBatchSize,
+                             results);
+      for (size_t i = 0; i < Filter::kBatchSize; ++i) {
+        num_positive += results[i];
+      }
+    }
+    return num_positive;
+  }, expected);
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  // Cache-resident (hashing dominates) and 16 MiB (cache misses dominate).
+  for (const size_t bits_per_element : {6, 10, 16}) {
+    highwayhash::Run(size_t{1} << 12, bits_per_element);
+  }
+  highwayhash::Run(size_t{1} << 23, 16);
+  return 0;
+}
@@ -14,11 +14,36 @@
 
 #include "highwayhash/c_bindings.h"
 
-#include "highwayhash/highwayhash_target.h"
-#include "highwayhash/instruction_sets.h"
+#include <new>
 
-using highwayhash::InstructionSets;
-using highwayhash::HighwayHash;
+#include "highwayhash/highwayhash_dispatch.h"
+
+using highwayhash::HighwayHashCatStorage;
+using highwayhash::HighwayHashDispatch;
+using highwayhash::HighwayHashFunctions;
+using highwayhash::HighwayHashPreparedKey;
+
+// Opaque to C callers.
+struct HighwayHashCatC {
+  // Chosen when the state is created.
+  const HighwayHashFunctions* functions;
+  HighwayHashCatStorage storage;
+};
+
+// Opaque to C callers.
+struct HighwayHashPreparedKeyC {
+  // Chosen when the key is prepared.
+  const HighwayHashFunctions* functions;
+  HighwayHashPreparedKey storage;
+};
+
+namespace {
+
+const HHKey& KeyRef(const HHKey key) {
+  return *reinterpret_cast<const HHKey*>(key);
+}
+
+}  // namespace
 
 extern "C" {
 
@@ -27,9 +52,123 @@ extern "C" {
 uint64_t HighwayHash64(const HHKey key, const char* bytes,
                        const uint64_t size) {
   HHResult64 result;
-  InstructionSets::Run<HighwayHash>(*reinterpret_cast<const HHKey*>(key), bytes,
-                                    size, &result);
+  HighwayHashDispatch().hash64(KeyRef(key), bytes, size, &result);
+  return result;
+}
+
+void HighwayHash128(const HHKey key, const char* bytes, const uint64_t size,
+                    HHResult128 hash) {
+  HighwayHashDispatch().hash128(KeyRef(key), bytes, size,
+                                reinterpret_cast<HHResult128*>(hash));
+}
+
+void HighwayHash256(const HHKey key, const char* bytes, const uint64_t size,
+                    HHResult256 hash) {
+  HighwayHashDispatch().hash256(KeyRef(key), bytes, size,
+                                reinterpret_cast<HHResult256*>(hash));
+}
+
+void HighwayHashBatch64(const HHKey key, const StringView* messages,
+                        const uint64_t num_messages, HHResult64* hashes) {
+  HighwayHashDispatch().batch64(KeyRef(key), messages, num_messages, hashes);
+}
+
+void HighwayHashBatch128(const HHKey key, const StringView* messages,
+                         const uint64_t num_messages, HHResult128* hashes) {
+  HighwayHashDispatch().batch128(KeyRef(key), messages, num_messages, hashes);
+}
+
+void HighwayHashBatch256(const HHKey key, const StringView* messages,
+                         const uint64_t num_messages, HHResult256* hashes) {
+  HighwayHashDispatch().batch256(KeyRef(key), messages, num_messages, hashes);
+}
+
+HighwayHashCatC* HighwayHashCatStartC(const HHKey key) {
+  HighwayHashCatC* cat = new (std::nothrow) HighwayHashCatC;
+  if (cat != nullptr) {
+    cat->functions = &HighwayHashDispatch();
+    cat->functions->cat_start(KeyRef(key), &cat->storage);
+  }
+  return cat;
+}
+
+void HighwayHashCatResetC(HighwayHashCatC* cat, const HHKey key) {
+  cat->functions->cat_start(KeyRef(key), &cat->storage);
+}
+
+void HighwayHashCatAppendC(HighwayHashCatC* cat, const char* bytes,
+                           const uint64_t size) {
+  cat->functions->cat_append(&cat->storage, bytes, size);
+}
+
+uint64_t HighwayHashCatFinish64C(const HighwayHashCatC* cat) {
+  HHResult64 result;
+  cat->functions->cat_finish64(&cat->storage, &result);
+  return result;
+}
+
+void HighwayHashCatFinish128C(const HighwayHashCatC* cat, HHResult128 hash) {
+  cat->functions->cat_finish128(&cat->storage,
+                                reinterpret_cast<HHResult128*>(hash));
+}
+
+void HighwayHashCatFinish256C(const HighwayHashCatC* cat, HHResult256 hash) {
+  cat->functions->cat_finish256(&cat->storage,
+                                reinterpret_cast<HHResult256*>(hash));
+}
+
+void HighwayHashCatFreeC(HighwayHashCatC* cat) { delete cat; }
+
+void HighwayHashCatSerializeC(const HighwayHashCatC* cat,
+                              HHCatSnapshot* snapshot) {
+  cat->functions->cat_serialize(&cat->storage, snapshot);
+}
+
+HighwayHashCatC* HighwayHashCatDeserializeC(const HHCatSnapshot* snapshot) {
+  HighwayHashCatC* cat = new (std::nothrow) HighwayHashCatC;
+  if (cat != nullptr) {
+    cat->functions = &HighwayHashDispatch();
+    if (!cat->functions->cat_deserialize(*snapshot, &cat->storage)) {
+      delete cat;
+      cat = nullptr;
+    }
+  }
+  return cat;
+}
+
+HighwayHashPreparedKeyC* HighwayHashPrepareKeyC(const HHKey key) {
+  HighwayHashPreparedKeyC* prepared =
+      new (std::nothrow) HighwayHashPreparedKeyC;
+  if (prepared != nullptr) {
+    prepared->functions = &HighwayHashDispatch();
+    prepared->functions->prepare(KeyRef(key), &prepared->storage);
+  }
+  return prepared;
+}
+
+uint64_t HighwayHashPrepared64C(const HighwayHashPreparedKeyC* prepared,
+                                const char* bytes, const uint64_t size) {
+  HHResult64 result;
+  prepared->functions->prepared64(&prepared->storage, bytes, size, &result);
   return result;
 }
 
+void HighwayHashPrepared128C(const HighwayHashPreparedKeyC* prepared,
+                             const char* bytes, const uint64_t size,
+                             HHResult128 hash) {
+  prepared->functions->prepared128(&prepared->storage, bytes, size,
+                                   reinterpret_cast<HHResult128*>(hash));
+}
+
+void HighwayHashPrepared256C(const HighwayHashPreparedKeyC* prepared,
+                             const char* bytes, const uint64_t size,
+                             HHResult256 hash) {
+  prepared->functions->prepared256(&prepared->storage, bytes, size,
+                                   reinterpret_cast<HHResult256*>(hash));
+}
+
+void HighwayHashPreparedKeyFreeC(HighwayHashPreparedKeyC* prepared) {
+  delete prepared;
+}
+
 }  // extern "C"
@@ -25,11 +25,13 @@
 extern "C" {
 
 // Bring the symbols out of the namespace.
+using highwayhash::HHCatSnapshot;
 using highwayhash::HHKey;
 using highwayhash::HHPacket;
 using highwayhash::HHResult128;
 using highwayhash::HHResult256;
 using highwayhash::HHResult64;
+using highwayhash::StringView;
 #endif
 
 uint64_t SipHashC(const uint64_t* key, const char* bytes, const uint64_t size);
@@ -40,6 +42,70 @@ uint64_t SipHash13C(const uint64_t* key, const char* bytes,
 // calculates 64-bit hash of given data.
 uint64_t HighwayHash64(const HHKey key, const char* bytes, const uint64_t size);
 
+// Same as above, but stores a 128 or 256-bit hash in "hash".
+void HighwayHash128(const HHKey key, const char* bytes, const uint64_t size,
+                    HHResult128 hash);
+void HighwayHash256(const HHKey key, const char* bytes, const uint64_t size,
+                    HHResult256 hash);
+
+// Stores the hash of each of the "num_messages" "messages" in the
+// corresponding element of "hashes". Faster than separate calls for short
+// messages, see HighwayHashBatchT.
+void HighwayHashBatch64(const HHKey key, const StringView* messages,
+                        const uint64_t num_messages, HHResult64* hashes);
+void HighwayHashBatch128(const HHKey key, const StringView* messages,
+                         const uint64_t num_messages, HHResult128* hashes);
+void HighwayHashBatch256(const HHKey key, const StringView* messages,
+                         const uint64_t num_messages, HHResult256* hashes);
+
+// Incrementally hashes a series of data ranges with the best implementation
+// for the current CPU, which is chosen once by HighwayHashCatStartC. The
+// result is the same as HighwayHash of the concatenation of all the ranges.
+typedef struct HighwayHashCatC HighwayHashCatC;
+
+// Returns a new state initialized with "key", or NULL if out of memory.
+// Must be freed via HighwayHashCatFreeC.
+HighwayHashCatC* HighwayHashCatStartC(const HHKey key);
+// Resets "cat" so it can be used to hash a new string.
+void HighwayHashCatResetC(HighwayHashCatC* cat, const HHKey key);
+// Adds "size" bytes to the hash; "size" == 0 has no effect.
+void HighwayHashCatAppendC(HighwayHashCatC* cat, const char* bytes,
+                           const uint64_t size);
+// Return or store the hash of all data appended since Start/Reset. "cat" is
+// unchanged and can continue to be appended to.
+uint64_t HighwayHashCatFinish64C(const HighwayHashCatC* cat);
+void HighwayHashCatFinish128C(const HighwayHashCatC* cat, HHResult128 hash);
+void HighwayHashCatFinish256C(const HighwayHashCatC* cat, HHResult256 hash);
+void HighwayHashCatFreeC(HighwayHashCatC* cat);
+
+// Stores the state of "cat" in "snapshot", which can be resumed by
+// HighwayHashCatDeserializeC on any CPU. WARNING: reveals the key.
+void HighwayHashCatSerializeC(const HighwayHashCatC* cat,
+                              HHCatSnapshot* snapshot);
+// Returns a new state equal to the one stored in "snapshot", or NULL if
+// "snapshot" is invalid or out of memory. Must be freed via
+// HighwayHashCatFreeC.
+HighwayHashCatC* HighwayHashCatDeserializeC(const HHCatSnapshot* snapshot);
+
+// Hashes any number of inputs with the same key, which is prepared only once
+// (with the best implementation for the current CPU). The results are the
+// same as HighwayHash64/128/256 with that key.
+typedef struct HighwayHashPreparedKeyC HighwayHashPreparedKeyC;
+
+// Returns a new prepared key, or NULL if out of memory. Must be freed via
+// HighwayHashPreparedKeyFreeC. The other functions do not modify "prepared",
+// so they can be called concurrently.
+HighwayHashPreparedKeyC* HighwayHashPrepareKeyC(const HHKey key);
+uint64_t HighwayHashPrepared64C(const HighwayHashPreparedKeyC* prepared,
+                                const char* bytes, const uint64_t size);
+void HighwayHashPrepared128C(const HighwayHashPreparedKeyC* prepared,
+                             const char* bytes, const uint64_t size,
+                             HHResult128 hash);
+void HighwayHashPrepared256C(const HighwayHashPreparedKeyC* prepared,
+                             const char* bytes, const uint64_t size,
+                             HHResult256 hash);
+void HighwayHashPreparedKeyFreeC(HighwayHashPreparedKeyC* prepared);
+
 // Defined by highwayhash_target.cc, which requires a _Target* suffix.
 uint64_t HighwayHash64_TargetPortable(const HHKey key, const char* bytes,
                                       const uint64_t size);
@@ -47,6 +113,8 @@ uint64_t HighwayHash64_TargetSSE41(const HHKey key, const char* bytes,
                                    const uint64_t size);
 uint64_t HighwayHash64_TargetAVX2(const HHKey key, const char* bytes,
                                   const uint64_t size);
+uint64_t HighwayHash64_TargetAVX512(const HHKey key, const char* bytes,
+                                    const uint64_t size);
 uint64_t HighwayHash64_TargetVSX(const HHKey key, const char* bytes,
                                  const uint64_t size);
 
@@ -77,6 +77,23 @@
 #define HH_UNLIKELY(expr) __builtin_expect(!!(expr), 0)
 #endif
 
+// Hint to load the cache line containing "address"; never faults.
+#if HH_MSC_VERSION
+// Unsupported without including intrinsics headers.
+#define HH_PREFETCH(address)
+#else
+#define HH_PREFETCH(address) __builtin_prefetch(address)
+#endif
+
+// As above, but for data that will only be read once: the line bypasses or is
+// quickly evicted from the outer caches (e.g. PREFETCHNTA on x86, PLDL1STRM on
+// AArch64), which avoids displacing the working set of other code.
+#if HH_MSC_VERSION
+#define HH_PREFETCH_NTA(address)
+#else
+#define HH_PREFETCH_NTA(address) __builtin_prefetch(address, 0, 0)
+#endif
+
 #if HH_MSC_VERSION
 #include <intrin.h>
 #pragma intrinsic(_ReadWriteBarrier)
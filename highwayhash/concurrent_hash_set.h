@@ -0,0 +1,390 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_CONCURRENT_HASH_SET_H_
+#define HIGHWAYHASH_CONCURRENT_HASH_SET_H_
+
+// Lock-free set of keys identified by their keyed HighwayHash64, e.g. for a
+// deduplication front-end in which many threads insert and query at the same
+// time. Keying prevents attackers from choosing keys that all probe the
+// same cache lines, or that collide.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memset
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+#include "highwayhash/table_helpers.h"
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_SSE41
+#include "highwayhash/vector128.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Open addressing with linear probing over groups of eight 64-bit slots, i.e.
+// one cache line per group. Each slot either is empty (zero) or holds the tag
+// of a key: its HighwayHash64, or 1 if that is zero. The lower bits of the
+// tag select the first group. A lookup compares all eight tags of a group
+// with two to eight SIMD comparisons, and stops at the first group with an
+// empty slot.
+//
+// Keys are only represented by their tags, so two distinct keys are
+// considered equal with probability 2^-64 (for a billion keys, the chance of
+// any such collision is about 3%). There are no deletions, so a slot changes
+// at most once, from empty to a tag, via compare-exchange. This keeps the
+// occupied slots a prefix of each probe sequence even while other threads
+// insert, and thus lookups need no locks nor retries. Lookups load groups with
+// ordinary (SIMD) loads because every aligned 64-bit lane is read atomically
+// on all supported CPUs. There are no ordering guarantees for other memory.
+//
+// concurrent_hash_set_benchmark measures the throughput for 1..N threads:
+// single-threaded, Insert and Contains are about three times as fast as a
+// std::unordered_set of the hashes with striped mutexes, and the batch
+// functions are another 1.5 times as fast for sets larger than the caches.
+//
+// Thread-safe: any number of threads may call any member function
+// concurrently, except for the constructor, destructor and Clear.
+class ConcurrentHashSet {
+ public:
+  static constexpr size_t kSlotsPerGroup = 8;
+
+  // Maximum number of keys per iteration of the batch functions.
+  static constexpr size_t kBatchSize = kMaxPrefetchKeys;
+
+  // Returns the number of groups (a power of two) for "num_keys" at a load
+  // factor of at most "max_load". Probe sequences remain short up to 0.9.
+  static HH_INLINE size_t NumGroupsFor(const size_t num_keys,
+                                       const double max_load = 0.875) {
+    const double min_groups = num_keys / (max_load * kSlotsPerGroup);
+    size_t num_groups = 1;
+    while (num_groups < min_groups) num_groups *= 2;
+    return num_groups;
+  }
+
+  // "num_groups" must be a power of two. Initially empty.
+  HH_INLINE ConcurrentHashSet(const HHKey& key, const size_t num_groups)
+      : initial_(key),
+        mask_(num_groups - 1),
+        allocated_(new char[num_groups * kGroupBytes + kGroupBytes]) {
+    for (int i = 0; i < 4; ++i) {
+      key_[i] = key[i];
+    }
+    // So that each group is one cache line.
+    slots_ = reinterpret_cast<uint64_t*>(AlignUp(allocated_, kGroupBytes));
+    memset(slots_, 0, num_groups * kGroupBytes);
+  }
+
+  ConcurrentHashSet(const ConcurrentHashSet&) = delete;
+  ConcurrentHashSet& operator=(const ConcurrentHashSet&) = delete;
+
+  HH_INLINE ~ConcurrentHashSet() { delete[] allocated_; }
+
+  // Removes all keys. Not thread-safe: no other function may run concurrently.
+  HH_INLINE void Clear() {
+    memset(slots_, 0, Bytes());
+    overflowed_ = 0;
+  }
+
+  HH_INLINE size_t NumGroups() const { return mask_ + 1; }
+  HH_INLINE size_t Capacity() const { return NumGroups() * kSlotsPerGroup; }
+  HH_INLINE size_t Bytes() const { return NumGroups() * kGroupBytes; }
+
+  // Bytes() bytes of native-endian slots: group g is [g * kSlotsPerGroup,
+  // (g + 1) * kSlotsPerGroup). Exposed for tests and persisting the set.
+  HH_INLINE const uint64_t* Data() const { return slots_; }
+
+  // Number of keys inserted. Counts the occupied slots, i.e. takes time
+  // proportional to Capacity(); exact if no insert is in progress.
+  HH_INLINE size_t Size() const {
+    size_t size = 0;
+    for (size_t i = 0; i < Capacity(); ++i) {
+      size += LoadSlot(slots_ + i) != 0;
+    }
+    return size;
+  }
+
+  // Whether an insert found all slots occupied. Sizing the set with
+  // NumGroupsFor prevents this.
+  HH_INLINE bool Overflowed() const {
+#if HH_MSC_VERSION
+    return *reinterpret_cast<const volatile uint32_t*>(&overflowed_) != 0;
+#else
+    return __atomic_load_n(&overflowed_, __ATOMIC_RELAXED) != 0;
+#endif
+  }
+
+  // Computes the 64-bit hash from which the other functions derive the tag.
+  HH_INLINE HHResult64 Hash(const char* HH_RESTRICT bytes,
+                            const size_t size) const {
+    HHStateT<HH_TARGET> state = initial_;
+    HHResult64 hash;
+    HighwayHashT(&state, bytes, size, &hash);
+    return hash;
+  }
+
+  // Returns true if "bytes" was newly inserted, or false if it was already
+  // present (including when another thread is concurrently inserting it, in
+  // which case exactly one of them returns true) or the set overflowed.
+  HH_INLINE bool Insert(const char* HH_RESTRICT bytes, const size_t size) {
+    return InsertHash(Hash(bytes, size));
+  }
+
+  // Returns whether "bytes" was inserted. Concurrent inserts of "bytes" may
+  // or may not be visible.
+  HH_INLINE bool Contains(const char* HH_RESTRICT bytes,
+                          const size_t size) const {
+    return ContainsHash(Hash(bytes, size));
+  }
+
+  // Same as Insert/Contains for a caller-computed hash, which must be the
+  // result of Hash for the same key (otherwise the set is not keyed).
+  HH_INLINE bool InsertHash(const HHResult64 hash) {
+    const uint64_t tag = Tag(hash);
+    size_t group = GroupIndex(hash);
+    for (size_t probes = 0; probes <= mask_; ++probes) {
+      uint64_t* slots = slots_ + group * kSlotsPerGroup;
+      for (;;) {
+        uint32_t equal;
+        uint32_t empty;
+        Match(slots, tag, &equal, &empty);
+        if (equal != 0) return false;
+        if (empty == 0) break;  // next group
+
+        // Only the first empty slot, to maintain the prefix invariant.
+        const uint64_t previous =
+            CompareExchange(slots + CountTrailingZeros(empty), tag);
+        if (previous == 0) return true;
+        if (previous == tag) return false;  // inserted by another thread
+        // Another key took the slot; re-match in case it was the last.
+      }
+      group = (group + 1) & mask_;
+    }
+#if HH_MSC_VERSION
+    *reinterpret_cast<volatile uint32_t*>(&overflowed_) = 1;
+#else
+    __atomic_store_n(&overflowed_, 1, __ATOMIC_RELAXED);
+#endif
+    return false;
+  }
+
+  HH_INLINE bool ContainsHash(const HHResult64 hash) const {
+    const uint64_t tag = Tag(hash);
+    size_t group = GroupIndex(hash);
+    for (size_t probes = 0; probes <= mask_; ++probes) {
+      uint32_t equal;
+      uint32_t empty;
+      Match(slots_ + group * kSlotsPerGroup, tag, &equal, &empty);
+      if (equal != 0) return true;
+      if (empty != 0) return false;
+      group = (group + 1) & mask_;
+    }
+    return false;
+  }
+
+  // Sets inserted[i] to Insert(keys[i]) for all i < "num_keys" and returns
+  // how many were newly inserted. Hashes up to kBatchSize keys at a time with
+  // HighwayHashBatchT, which overlaps the dependency chains of pairs of keys,
+  // and prefetches their first groups before inserting any, so that the cache
+  // misses overlap with each other and the remaining hashing.
+  HH_INLINE size_t InsertBatch(const StringView* HH_RESTRICT keys,
+                               const size_t num_keys,
+                               bool* HH_RESTRICT inserted) {
+    HHResult64 hashes[kBatchSize];
+    size_t num_inserted = 0;
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        inserted[first + i] = InsertHash(hashes[i]);
+        num_inserted += inserted[first + i];
+      }
+    }
+    return num_inserted;
+  }
+
+  // Sets results[i] to Contains(keys[i]) for all i < "num_keys", in the same
+  // manner as InsertBatch.
+  HH_INLINE void ContainsBatch(const StringView* HH_RESTRICT keys,
+                               const size_t num_keys,
+                               bool* HH_RESTRICT results) const {
+    HHResult64 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        results[first + i] = ContainsHash(hashes[i]);
+      }
+    }
+  }
+
+ private:
+  static constexpr uintptr_t kGroupBytes = kSlotsPerGroup * sizeof(uint64_t);
+
+  static HH_INLINE uint64_t Tag(const HHResult64 hash) {
+    return hash == 0 ? 1 : hash;
+  }
+
+  HH_INLINE size_t GroupIndex(const HHResult64 hash) const {
+    return static_cast<size_t>(hash) & mask_;
+  }
+
+  // "x" must be nonzero.
+  static HH_INLINE int CountTrailingZeros(const uint32_t x) {
+#if HH_MSC_VERSION
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(x);
+#endif
+  }
+
+  static HH_INLINE uint64_t LoadSlot(const uint64_t* slot) {
+#if HH_MSC_VERSION
+    return *reinterpret_cast<const volatile uint64_t*>(slot);
+#else
+    return __atomic_load_n(slot, __ATOMIC_RELAXED);
+#endif
+  }
+
+  // Replaces *slot with "tag" if it is zero. Returns the previous value, i.e.
+  // zero if successful.
+  static HH_INLINE uint64_t CompareExchange(uint64_t* slot,
+                                            const uint64_t tag) {
+#if HH_MSC_VERSION
+    return static_cast<uint64_t>(_InterlockedCompareExchange64(
+        reinterpret_cast<volatile __int64*>(slot), static_cast<__int64>(tag),
+        0));
+#else
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(slot, &expected, tag, false, __ATOMIC_RELAXED,
+                                __ATOMIC_RELAXED);
+    return expected;
+#endif
+  }
+
+  // Sets bit i of *equal if slot i of the group equals "tag", and of *empty
+  // if it is zero.
+  static HH_INLINE void Match(const uint64_t* group, const uint64_t tag,
+                              uint32_t* HH_RESTRICT equal,
+                              uint32_t* HH_RESTRICT empty) {
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    V4x64U lower(Load<V4x64U>(group));
+    V4x64U upper(Load<V4x64U>(group + 4));
+    LoadOnce(&lower);
+    LoadOnce(&upper);
+    const V4x64U tags(tag);
+    const V4x64U zero(_mm256_setzero_si256());
+    *equal = Bits(lower == tags) | (Bits(upper == tags) << 4);
+    *empty = Bits(lower == zero) | (Bits(upper == zero) << 4);
+#elif HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+    const V2x64U tags(tag);
+    const V2x64U zero(uint64_t(0));
+    *equal = 0;
+    *empty = 0;
+    for (int i = 0; i < 4; ++i) {
+      V2x64U slots(Load<V2x64U>(group + 2 * i));
+      LoadOnce(&slots);
+      *equal |= Bits(slots == tags) << (2 * i);
+      *empty |= Bits(slots == zero) << (2 * i);
+    }
+#else
+    *equal = 0;
+    *empty = 0;
+    for (size_t i = 0; i < kSlotsPerGroup; ++i) {
+      const uint64_t slot = LoadSlot(group + i);
+      *equal |= static_cast<uint32_t>(slot == tag) << i;
+      *empty |= static_cast<uint32_t>(slot == 0) << i;
+    }
+#endif
+  }
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512 || \
+    HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+  // Both comparisons in Match must use the same load of each slot. The loads
+  // are not atomic, so the compiler would otherwise be free to load again for
+  // the second comparison, after which a concurrently inserted tag could be
+  // absent from *equal but occupied in *empty, i.e. inserted twice. Keeps the
+  // loaded vector in a register (a compiler fence would spill it).
+  template <class V>
+  static HH_INLINE void LoadOnce(V* HH_RESTRICT v) {
+    typename V::Intrinsic raw = *v;
+#if HH_MSC_VERSION
+    HH_COMPILER_FENCE;
+#elif HH_TARGET == HH_TARGET_NEON
+    asm volatile("" : "+w"(raw));
+#else
+    asm volatile("" : "+x"(raw));
+#endif
+    *v = V(raw);
+  }
+#endif
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+  // Returns one bit per lane of the comparison result "mask".
+  static HH_INLINE uint32_t Bits(const V4x64U& mask) {
+    return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+  }
+#elif HH_TARGET == HH_TARGET_SSE41
+  static HH_INLINE uint32_t Bits(const V2x64U& mask) {
+    return static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+  }
+#elif HH_TARGET == HH_TARGET_NEON
+  static HH_INLINE uint32_t Bits(const V2x64U& mask) {
+    const uint64x2_t lanes = mask;
+    return static_cast<uint32_t>((vgetq_lane_u64(lanes, 0) & 1) |
+                                 (vgetq_lane_u64(lanes, 1) & 2));
+  }
+#endif
+
+  HH_INLINE void HashAndPrefetch(const StringView* HH_RESTRICT keys,
+                                 const size_t count,
+                                 HHResult64* HH_RESTRICT hashes) const {
+    HighwayHashBatchT<HH_TARGET>(key_, keys, count, hashes);
+    for (size_t i = 0; i < count; ++i) {
+      HH_PREFETCH(slots_ + GroupIndex(hashes[i]) * kSlotsPerGroup);
+    }
+  }
+
+  const HHStateT<HH_TARGET> initial_;
+  HHKey key_;  // for HighwayHashBatchT
+  const size_t mask_;  // NumGroups() - 1
+  char* const allocated_;
+  uint64_t* slots_;  // cache-line aligned, within allocated_
+  uint32_t overflowed_ = 0;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_CONCURRENT_HASH_SET_H_
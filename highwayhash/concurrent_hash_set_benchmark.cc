@@ -0,0 +1,276 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the aggregate throughput of 1..N threads concurrently inserting
+// into and querying a ConcurrentHashSet, per key and via the batch functions,
+// and of a std::unordered_set of the same hashes with striped mutexes for
+// comparison. N defaults to NumUsableCPUs.
+//
+// Usage: concurrent_hash_set_benchmark [--max_threads=N]
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>  //NOLINT
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "highwayhash/concurrent_hash_set.h"
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/os_specific.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kKeyBytes = 16;
+
+// Fraction of the slots filled by inserting all distinct keys.
+const double kLoad = 0.75;
+
+// Keys per ThreadPool task; large enough to amortize the scheduling.
+const size_t kKeysPerTask = 4096;
+
+using Set = HH_TARGET_NAME::ConcurrentHashSet;
+
+// Baseline: the usual alternative to a lock-free set. Stores the same hashes
+// so that only the synchronization and table layout differ.
+class StripedSet {
+ public:
+  static constexpr size_t kNumStripes = 64;
+
+  explicit StripedSet(const size_t num_keys) {
+    for (Stripe& stripe : stripes_) {
+      stripe.hashes.reserve(num_keys / kNumStripes);
+    }
+  }
+
+  bool Insert(const HHResult64 hash) {
+    Stripe& stripe = stripes_[hash >> 58];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.hashes.insert(hash).second;
+  }
+
+  bool Contains(const HHResult64 hash) {
+    Stripe& stripe = stripes_[hash >> 58];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.hashes.count(hash) != 0;
+  }
+
+ private:
+  struct Stripe {
+    std::mutex mutex;
+    std::unordered_set<uint64_t> hashes;
+    char padding[64];  // avoids false sharing of the mutexes
+  };
+  Stripe stripes_[kNumStripes];
+};
+
+// Structures shared by all measurements for one number of distinct keys.
+struct Workload {
+  size_t num_distinct;
+  std::vector<char> bytes;  // 2 * num_distinct random keys
+  // Each of the first num_distinct keys twice, in random order, so that half
+  // of the inserts are duplicates (as in a deduplication front-end).
+  std::vector<StringView> inserts;
+  // Each inserted key and as many others once, in random order.
+  std::vector<StringView> queries;
+};
+
+Workload MakeWorkload(const size_t num_distinct) {
+  Workload workload;
+  workload.num_distinct = num_distinct;
+  std::mt19937_64 rng(12345);
+  workload.bytes.resize(2 * num_distinct * kKeyBytes);
+  for (char& byte : workload.bytes) {
+    byte = static_cast<char>(rng());
+  }
+  for (size_t i = 0; i < 2 * num_distinct; ++i) {
+    const StringView key{workload.bytes.data() + i * kKeyBytes, kKeyBytes};
+    workload.queries.push_back(key);
+    if (i < num_distinct) {
+      workload.inserts.push_back(key);
+      workload.inserts.push_back(key);
+    }
+  }
+  std::shuffle(workload.inserts.begin(), workload.inserts.end(), rng);
+  std::shuffle(workload.queries.begin(), workload.queries.end(), rng);
+  return workload;
+}
+
+// Calls operation(first, count, &sum) for disjoint ranges of "num_ops" on all
+// threads of "pool". Returns the number of operations per second, or exits if
+// the total of all sums differs from "expected". "reset" is called before
+// each of the repetitions but not timed.
+template <class Reset, class Operation>
+double Measure(const char* caption, ThreadPool* pool, const size_t num_ops,
+               const Reset& reset, const Operation& operation,
+               const size_t expected) {
+  const int num_tasks =
+      static_cast<int>((num_ops + kKeysPerTask - 1) / kKeysPerTask);
+  std::unique_ptr<size_t[]> sums(new size_t[num_tasks]);
+  double best = 1E10;
+  for (int rep = 0; rep < 3; ++rep) {
+    reset();
+    const auto t0 = std::chrono::steady_clock::now();
+    pool->Run(0, num_tasks, [&](const int task) {
+      const size_t first = task * kKeysPerTask;
+      const size_t count = std::min(kKeysPerTask, num_ops - first);
+      sums[task] = 0;
+      operation(first, count, &sums[task]);
+    });
+    const auto t1 = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int task = 0; task < num_tasks; ++task) {
+      total += sums[task];
+    }
+    if (total != expected) {
+      printf("%s: wrong count %zu, expected %zu\n", caption, total, expected);
+      exit(1);
+    }
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  return num_ops / best * 1E-6;
+}
+
+void Run(const Workload& workload, const int num_threads) {
+  const size_t num_distinct = workload.num_distinct;
+  const size_t num_groups = Set::NumGroupsFor(num_distinct, kLoad);
+  const StringView* inserts = workload.inserts.data();
+  const StringView* queries = workload.queries.data();
+  const size_t num_inserts = workload.inserts.size();
+  const size_t num_queries = workload.queries.size();
+  ThreadPool pool(num_threads);
+
+  // Filled by the insert measurements, then queried. (Not allocated with new
+  // because that ignores the alignment of HHStateT before C++17.)
+  Set set(kKey, num_groups);
+  std::unique_ptr<StripedSet> striped;
+  const auto reset = [&]() { set.Clear(); };
+  const auto reset_striped = [&]() {
+    striped.reset(new StripedSet(num_distinct));
+  };
+  const auto keep = []() {};
+  std::unique_ptr<bool[]> results(new bool[std::max(num_inserts,
+                                                    num_queries)]);
+
+  const auto insert = [&](const size_t first, const size_t count,
+                          size_t* sum) {
+    for (size_t i = first; i < first + count; ++i) {
+      *sum += set.Insert(inserts[i].data, inserts[i].num_bytes);
+    }
+  };
+  const auto insert_batch = [&](const size_t first, const size_t count,
+                                size_t* sum) {
+    *sum += set.InsertBatch(inserts + first, count, results.get() + first);
+  };
+  const auto insert_striped = [&](const size_t first, const size_t count,
+                                  size_t* sum) {
+    for (size_t i = first; i < first + count; ++i) {
+      *sum +=
+          striped->Insert(set.Hash(inserts[i].data, inserts[i].num_bytes));
+    }
+  };
+  const auto contains = [&](const size_t first, const size_t count,
+                            size_t* sum) {
+    for (size_t i = first; i < first + count; ++i) {
+      *sum += set.Contains(queries[i].data, queries[i].num_bytes);
+    }
+  };
+  const auto contains_batch = [&](const size_t first, const size_t count,
+                                  size_t* sum) {
+    set.ContainsBatch(queries + first, count, results.get() + first);
+    for (size_t i = first; i < first + count; ++i) {
+      *sum += results[i];
+    }
+  };
+  const auto contains_striped = [&](const size_t first, const size_t count,
+                                    size_t* sum) {
+    for (size_t i = first; i < first + count; ++i) {
+      *sum +=
+          striped->Contains(set.Hash(queries[i].data, queries[i].num_bytes));
+    }
+  };
+
+  // Each Insert* inserts exactly the distinct keys (once, by whichever thread
+  // first claims the slot) and each Contains* finds exactly those.
+  const double mops[6] = {
+      Measure("Insert", &pool, num_inserts, reset, insert, num_distinct),
+      Measure("InsertBatch", &pool, num_inserts, reset, insert_batch,
+              num_distinct),
+      Measure("Contains", &pool, num_queries, keep, contains, num_distinct),
+      Measure("ContainsBatch", &pool, num_queries, keep, contains_batch,
+              num_distinct),
+      Measure("StripedInsert", &pool, num_inserts, reset_striped,
+              insert_striped, num_distinct),
+      Measure("StripedContains", &pool, num_queries, keep, contains_striped,
+              num_distinct)};
+  if (set.Size() != num_distinct || set.Overflowed()) {
+    printf("Wrong size %zu, expected %zu\n", set.Size(), num_distinct);
+    exit(1);
+  }
+
+  printf("%-8s %9zu %7d %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+         TargetName(HH_TARGET), set.Bytes() >> 10, num_threads, mops[0],
+         mops[1], mops[2], mops[3], mops[4], mops[5]);
+}
+
+// Powers of two, plus "max_threads" itself.
+int NextThreadCount(const int num_threads, const int max_threads) {
+  if (num_threads == max_threads) return max_threads + 1;  // done
+  return std::min(num_threads * 2, max_threads);
+}
+
+int Run(int argc, char* argv[]) {
+  int max_threads = NumUsableCPUs();
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--max_threads=", 14) == 0) {
+      max_threads = atoi(argv[i] + 14);
+    } else {
+      fprintf(stderr, "Usage: concurrent_hash_set_benchmark "
+                      "[--max_threads=N]\n");
+      return 1;
+    }
+  }
+  if (max_threads < 1) max_threads = 1;
+
+  printf("M ops/s, %.0f%% load, %zu-byte keys, half of the inserts are "
+         "duplicates, half of the queries absent\n",
+         100.0 * kLoad, kKeyBytes);
+  printf("%-8s %9s %7s %8s %8s %8s %8s %8s %8s\n", "Target", "KiB", "Threads",
+         "Insert", "InsBatch", "Contains", "ConBatch", "StrInsrt", "StrCont");
+  // Cache-resident (hashing dominates) and 32 MiB (cache misses dominate).
+  const size_t kNumDistinct[2] = {size_t{1} << 14, size_t{1} << 21};
+  for (const size_t num_distinct : kNumDistinct) {
+    const Workload workload = MakeWorkload(num_distinct);
+    for (int num_threads = 1; num_threads <= max_threads;
+         num_threads = NextThreadCount(num_threads, max_threads)) {
+      Run(workload, num_threads);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) { return highwayhash::Run(argc, argv); }
@@ -0,0 +1,314 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_CONSISTENT_HASH_H_
+#define HIGHWAYHASH_CONSISTENT_HASH_H_
+
+// Keyed placement of keys onto nodes (e.g. shards) such that adding or removing
+// a node only moves the keys placed on that node: rendezvous (highest random
+// weight) hashing for arbitrary node sets, and jump consistent hashing for
+// buckets numbered 0..n-1.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector256.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Returns the score of the node with "seed" and index "node" (< 2^16) for a
+// key with HighwayHash64 "hash". The upper bits are a cheap mix of hash ^ seed
+// (the multipliers are 32-bit so that they map to _mm256_mul_epu32); the
+// lowest 16 bits are ~node. Scores are thus unique and their maximum also
+// identifies the node; ties in the mixed bits favor the lower index. The most
+// significant bit is zero to allow signed comparisons.
+HH_INLINE uint64_t RendezvousScore(const uint64_t hash, const uint64_t seed,
+                                   const uint32_t node) {
+  uint64_t x = hash ^ seed;
+  x ^= x >> 32;
+  x *= 0x9E3779B1ull;
+  x ^= x >> 29;
+  x *= 0x85EBCA77ull;
+  x ^= x >> 32;
+  return (x & 0x7FFFFFFFFFFF0000ull) | (0xFFFF - node);
+}
+
+// Rendezvous hashing: places a key on the node with the highest
+// RendezvousScore. The key is hashed only once (with a prepared HHStateT), and
+// the per-node scores are vectorized on AVX2, which is cheaper than the usual
+// one HighwayHash per (key, node). The chosen node identifier only depends on
+// the HHKey, the set of identifiers and the key bytes, not on the target or the
+// order of identifiers (except for ties, which favor the lower index).
+class RendezvousHash {
+ public:
+  static constexpr size_t kMaxNodes = 1 << 16;
+  static constexpr size_t kMaxReplicas = 16;
+
+  // Number of keys hashed per HighwayHashBatchT call in PlaceBatch.
+  static constexpr size_t kBatchSize = 64;
+
+  // "node_ids" are arbitrary but distinct identifiers of the "num_nodes" nodes
+  // (1 <= num_nodes <= kMaxNodes); the results are indices into "node_ids".
+  // Nodes are seeded with HighwayHash64 of their identifier under a key
+  // derived from "key", so that key bytes equal to an identifier do not cancel.
+  HH_INLINE RendezvousHash(const HHKey& key, const uint64_t* node_ids,
+                           const size_t num_nodes)
+      : keyed_(key), num_nodes_(num_nodes), seeds_(new uint64_t[num_nodes]) {
+    for (int i = 0; i < 4; ++i) {
+      key_[i] = key[i];
+    }
+    const HHKey seed_key = {key[0] ^ 0x48485365656430ull,
+                            key[1] ^ 0x48485365656431ull,
+                            key[2] ^ 0x48485365656432ull,
+                            key[3] ^ 0x48485365656433ull};  // "HHSeed0..3"
+    HHStateT<HH_TARGET> state(seed_key);
+    for (size_t node = 0; node < num_nodes; ++node) {
+      HHStateT<HH_TARGET> copy = state;
+      HighwayHashU64T(&copy, node_ids[node], &seeds_[node]);
+    }
+  }
+
+  RendezvousHash(const RendezvousHash&) = delete;
+  RendezvousHash& operator=(const RendezvousHash&) = delete;
+
+  HH_INLINE ~RendezvousHash() { delete[] seeds_; }
+
+  HH_INLINE size_t NumNodes() const { return num_nodes_; }
+
+  // Returns the index of the node for the key "bytes".
+  HH_INLINE uint32_t Place(const char* HH_RESTRICT bytes,
+                           const size_t size) const {
+    HHResult64 hash;
+    keyed_(bytes, size, &hash);
+    return PlaceHash(hash);
+  }
+
+  // Same as Place for a caller-computed HighwayHash64 of the key (with the
+  // same key as the constructor).
+  HH_INLINE uint32_t PlaceHash(const uint64_t hash) const {
+    return static_cast<uint32_t>(0xFFFF - (MaxScore(hash) & 0xFFFF));
+  }
+
+  // Stores the (distinct) indices of the "num_replicas" (<= min(kMaxReplicas,
+  // NumNodes())) highest-scoring nodes in "nodes", highest first. nodes[0] is
+  // the same as Place, and each node is also the first choice once all before
+  // it are removed.
+  HH_INLINE void PlaceReplicas(const char* HH_RESTRICT bytes, const size_t size,
+                               const size_t num_replicas,
+                               uint32_t* HH_RESTRICT nodes) const {
+    HHResult64 hash;
+    keyed_(bytes, size, &hash);
+
+    // Descending top scores.
+    uint64_t top[kMaxReplicas];
+    size_t num_top = 0;
+    const size_t kChunk = 64;
+    uint64_t scores[kChunk];
+    for (size_t first = 0; first < num_nodes_; first += kChunk) {
+      const size_t count =
+          num_nodes_ - first < kChunk ? num_nodes_ - first : kChunk;
+      Scores(hash, first, count, scores);
+      for (size_t i = 0; i < count; ++i) {
+        const uint64_t score = scores[i];
+        if (num_top == num_replicas && score <= top[num_top - 1]) continue;
+        // Insertion sort; drops the lowest if full.
+        size_t pos = num_top < num_replicas ? num_top++ : num_top - 1;
+        for (; pos != 0 && top[pos - 1] < score; --pos) {
+          top[pos] = top[pos - 1];
+        }
+        top[pos] = score;
+      }
+    }
+
+    for (size_t i = 0; i < num_replicas; ++i) {
+      nodes[i] = static_cast<uint32_t>(0xFFFF - (top[i] & 0xFFFF));
+    }
+  }
+
+  // Stores Place of each of the "num_keys" "keys" in "nodes". Faster than
+  // calling Place for each because the keys are hashed with HighwayHashBatchT.
+  HH_INLINE void PlaceBatch(const StringView* HH_RESTRICT keys,
+                            const size_t num_keys,
+                            uint32_t* HH_RESTRICT nodes) const {
+    HHResult64 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HighwayHashBatchT<HH_TARGET>(key_, keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        nodes[first + i] = PlaceHash(hashes[i]);
+      }
+    }
+  }
+
+ private:
+  // Stores the scores of nodes [first, first + count) in "scores".
+  HH_INLINE void Scores(const uint64_t hash, const size_t first,
+                        const size_t count,
+                        uint64_t* HH_RESTRICT scores) const {
+    size_t i = 0;
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    const V4x64U hashes(hash);
+    V4x64U tags(0xFFFF - first - 3, 0xFFFF - first - 2, 0xFFFF - first - 1,
+                0xFFFF - first);
+    for (; i + 4 <= count; i += 4) {
+      StoreUnaligned(Score4(hashes, first + i, tags), scores + i);
+      tags -= V4x64U(4);
+    }
+#endif
+    for (; i < count; ++i) {
+      const uint32_t node = static_cast<uint32_t>(first + i);
+      scores[i] = RendezvousScore(hash, seeds_[node], node);
+    }
+  }
+
+  // Returns the highest score of all nodes.
+  HH_INLINE uint64_t MaxScore(const uint64_t hash) const {
+    uint64_t max = 0;
+    size_t node = 0;
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    if (num_nodes_ >= 4) {
+      const V4x64U hashes(hash);
+      V4x64U tags(0xFFFF - 3, 0xFFFF - 2, 0xFFFF - 1, 0xFFFF);
+      V4x64U best = Score4(hashes, 0, tags);
+      for (node = 4; node + 4 <= num_nodes_; node += 4) {
+        tags -= V4x64U(4);
+        const V4x64U scores = Score4(hashes, node, tags);
+        // Scores are non-negative (see RendezvousScore).
+        best = V4x64U(
+            _mm256_blendv_epi8(best, scores, _mm256_cmpgt_epi64(scores, best)));
+      }
+      uint64_t lanes[4];
+      StoreUnaligned(best, lanes);
+      for (int i = 0; i < 4; ++i) {
+        max = lanes[i] > max ? lanes[i] : max;
+      }
+    }
+#endif
+    for (; node < num_nodes_; ++node) {
+      const uint64_t score =
+          RendezvousScore(hash, seeds_[node], static_cast<uint32_t>(node));
+      max = score > max ? score : max;
+    }
+    return max;
+  }
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+  // x * multiplier mod 2^64 for a 32-bit "multiplier" (AVX2 lacks 64-bit
+  // multiplication).
+  static HH_INLINE V4x64U Mul32(const V4x64U& x, const V4x64U& multiplier) {
+    const V4x64U lower(_mm256_mul_epu32(x, multiplier));
+    const V4x64U upper(_mm256_mul_epu32(x >> 32, multiplier));
+    return lower + (upper << 32);
+  }
+
+  // Vectorized RendezvousScore of nodes [node, node + 4) with ~node "tags".
+  HH_INLINE V4x64U Score4(const V4x64U& hashes, const size_t node,
+                          const V4x64U& tags) const {
+    V4x64U x = hashes ^ LoadUnaligned<V4x64U>(seeds_ + node);
+    x ^= x >> 32;
+    x = Mul32(x, V4x64U(0x9E3779B1ull));
+    x ^= x >> 29;
+    x = Mul32(x, V4x64U(0x85EBCA77ull));
+    x ^= x >> 32;
+    return (x & V4x64U(0x7FFFFFFFFFFF0000ull)) | tags;
+  }
+#endif
+
+  HHKey key_;
+  const HighwayHashKeyedT<HH_TARGET> keyed_;
+  const size_t num_nodes_;
+  uint64_t* const seeds_;
+};
+
+// Jump consistent hash (Lamping and Veach, 2014): returns a bucket in
+// [0, num_buckets) for a key with (uniformly distributed) "hash". Increasing
+// num_buckets by one only moves 1/num_buckets of the keys, all to the new
+// bucket. Takes O(log(num_buckets)) time and no memory, but unlike
+// RendezvousHash, only the last bucket can be removed.
+HH_INLINE uint32_t JumpConsistentHash(uint64_t hash,
+                                      const uint32_t num_buckets) {
+  int64_t bucket = -1;
+  int64_t next = 0;
+  while (next < static_cast<int64_t>(num_buckets)) {
+    bucket = next;
+    hash = hash * 2862933555777941757ull + 1;
+    next = static_cast<int64_t>((bucket + 1) *
+                                (static_cast<double>(1LL << 31) /
+                                 static_cast<double>((hash >> 33) + 1)));
+  }
+  return static_cast<uint32_t>(bucket);
+}
+
+// JumpConsistentHash of HighwayHash64 of keys.
+class JumpHash {
+ public:
+  static constexpr size_t kBatchSize = RendezvousHash::kBatchSize;
+
+  // "num_buckets" must be at least one.
+  HH_INLINE JumpHash(const HHKey& key, const uint32_t num_buckets)
+      : keyed_(key), num_buckets_(num_buckets) {
+    for (int i = 0; i < 4; ++i) {
+      key_[i] = key[i];
+    }
+  }
+
+  HH_INLINE uint32_t Place(const char* HH_RESTRICT bytes,
+                           const size_t size) const {
+    HHResult64 hash;
+    keyed_(bytes, size, &hash);
+    return JumpConsistentHash(hash, num_buckets_);
+  }
+
+  // Stores Place of each of the "num_keys" "keys" in "buckets".
+  HH_INLINE void PlaceBatch(const StringView* HH_RESTRICT keys,
+                            const size_t num_keys,
+                            uint32_t* HH_RESTRICT buckets) const {
+    HHResult64 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HighwayHashBatchT<HH_TARGET>(key_, keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        buckets[first + i] = JumpConsistentHash(hashes[i], num_buckets_);
+      }
+    }
+  }
+
+ private:
+  HHKey key_;
+  const HighwayHashKeyedT<HH_TARGET> keyed_;
+  const uint32_t num_buckets_;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_CONSISTENT_HASH_H_
@@ -0,0 +1,150 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures placements per second of RendezvousHash and JumpHash versus the
+// number of nodes, compared to rendezvous hashing with one HighwayHash64 per
+// (key, node).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "highwayhash/consistent_hash.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kNumKeys = 1 << 14;
+
+using HH_TARGET_NAME::JumpHash;
+using HH_TARGET_NAME::RendezvousHash;
+
+// Prints placements per second of "func", which places all keys and returns
+// the sum of their nodes (to prevent elision).
+template <class Func>
+void Measure(const char* caption, const Func& func) {
+  double best = 1E10;
+  uint64_t sum = 0;
+  for (int rep = 0; rep < 3; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    sum += func();
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  printf("%32s: %8.3f M placements/s (%llu)\n", caption,
+         kNumKeys / best * 1E-6, static_cast<unsigned long long>(sum % 10));
+}
+
+void Run(const std::vector<StringView>& keys, const size_t num_nodes) {
+  std::vector<uint64_t> node_ids(num_nodes);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    node_ids[i] = 1000 + i;
+  }
+  printf("Target %s, %zu nodes:\n", TargetName(HH_TARGET), num_nodes);
+
+  // Baseline: a key per node, one full hash per (key, node).
+  std::vector<uint64_t> node_keys(num_nodes * 4);
+  for (size_t i = 0; i < num_nodes; ++i) {
+    node_keys[i * 4 + 0] = kKey[0] ^ node_ids[i];
+    node_keys[i * 4 + 1] = kKey[1];
+    node_keys[i * 4 + 2] = kKey[2];
+    node_keys[i * 4 + 3] = kKey[3];
+  }
+  Measure("HighwayHash64 per node", [&] {
+    uint64_t sum = 0;
+    for (const StringView& key : keys) {
+      uint64_t best = 0;
+      size_t best_node = 0;
+      for (size_t i = 0; i < num_nodes; ++i) {
+        HHStateT<HH_TARGET> state(
+            *reinterpret_cast<const HHKey*>(&node_keys[i * 4]));
+        HHResult64 score;
+        HighwayHashT(&state, key.data, key.num_bytes, &score);
+        if (score > best) {
+          best = score;
+          best_node = i;
+        }
+      }
+      sum += best_node;
+    }
+    return sum;
+  });
+
+  const RendezvousHash rendezvous(kKey, node_ids.data(), num_nodes);
+  Measure("RendezvousHash::Place", [&] {
+    uint64_t sum = 0;
+    for (const StringView& key : keys) {
+      sum += rendezvous.Place(key.data, key.num_bytes);
+    }
+    return sum;
+  });
+
+  std::vector<uint32_t> nodes(keys.size());
+  Measure("RendezvousHash::PlaceBatch", [&] {
+    rendezvous.PlaceBatch(keys.data(), keys.size(), nodes.data());
+    uint64_t sum = 0;
+    for (const uint32_t node : nodes) {
+      sum += node;
+    }
+    return sum;
+  });
+
+  Measure("RendezvousHash::PlaceReplicas(3)", [&] {
+    uint64_t sum = 0;
+    uint32_t replicas[3];
+    for (const StringView& key : keys) {
+      rendezvous.PlaceReplicas(key.data, key.num_bytes, 3, replicas);
+      sum += replicas[2];
+    }
+    return sum;
+  });
+
+  const JumpHash jump(kKey, static_cast<uint32_t>(num_nodes));
+  Measure("JumpHash::PlaceBatch", [&] {
+    jump.PlaceBatch(keys.data(), keys.size(), nodes.data());
+    uint64_t sum = 0;
+    for (const uint32_t node : nodes) {
+      sum += node;
+    }
+    return sum;
+  });
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  // 16-byte request keys.
+  std::mt19937_64 rng(12345);
+  std::vector<char> bytes(highwayhash::kNumKeys * 16);
+  for (char& byte : bytes) {
+    byte = static_cast<char>(rng());
+  }
+  std::vector<highwayhash::StringView> keys(highwayhash::kNumKeys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = highwayhash::StringView{bytes.data() + i * 16, 16};
+  }
+
+  for (const size_t num_nodes : {4, 16, 64, 128, 512}) {
+    highwayhash::Run(keys, num_nodes);
+  }
+  return 0;
+}
@@ -0,0 +1,381 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_CUCKOO_FILTER_H_
+#define HIGHWAYHASH_CUCKOO_FILTER_H_
+
+// Cuckoo filter keyed with HighwayHash: an approximate set like BloomFilter
+// that also supports deleting elements, e.g. for cache admission. Keying
+// prevents attackers from choosing inputs that all map to the same buckets,
+// which would make inserts fail.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memset
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+#include "highwayhash/table_helpers.h"
+
+#if HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_AVX2 || \
+    HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector128.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Each element is represented by a 16-bit fingerprint in one of four slots of
+// one of its two candidate buckets (Fan et al., "Cuckoo Filter: Practically
+// Better Than Bloom", CoNEXT 2014). Both are derived from one HHResult64:
+// the upper 16 bits are the fingerprint (1 if they are zero, which denotes an
+// empty slot) and the lower 32 bits select the first bucket. The second
+// bucket is the first XOR a multiple of the fingerprint, so either bucket
+// can be computed from the other, which allows relocating ("kicking")
+// fingerprints to their alternate bucket when both are full.
+//
+// A bucket is one uint64_t with slot s in bits [16 * s, 16 * s + 16), i.e.
+// eight 16-bit lanes for the two buckets of a lookup, which SIMD targets
+// compare with the fingerprint in a single instruction. The layout is the
+// same for all targets, so a filter built by one target may be used by
+// another (see Data).
+//
+// Measured (see cuckoo_filter_benchmark): inserts succeed up to a load factor
+// of 96-98%; the false positive rate is about 0.01% at 90% load (at most
+// 8 / 2^16 = 0.012%). Batched queries are 1.4 times as fast as separate ones
+// for filters larger than the cache.
+class CuckooFilter {
+ public:
+  static constexpr size_t kSlotsPerBucket = 4;
+
+  // Relocations before an insert gives up. The last relocated fingerprint is
+  // then kept in a separate "victim" slot, so no element is lost, but
+  // subsequent inserts fail until an element is erased.
+  static constexpr size_t kMaxKicks = 500;
+
+  // Maximum number of keys per iteration of the batch functions.
+  static constexpr size_t kBatchSize = kMaxPrefetchKeys;
+
+  // Returns the number of buckets (a power of two) for "num_elements" at a
+  // load factor of at most "max_load" (inserts likely succeed up to 0.95).
+  static HH_INLINE size_t NumBucketsFor(const size_t num_elements,
+                                        const double max_load = 0.95) {
+    const double min_buckets = num_elements / (max_load * kSlotsPerBucket);
+    size_t num_buckets = 1;
+    while (num_buckets < min_buckets) num_buckets *= 2;
+    return num_buckets;
+  }
+
+  // "num_buckets" must be a power of two in [1, 2^32]. Initially empty.
+  HH_INLINE CuckooFilter(const HHKey& key, const size_t num_buckets)
+      : initial_(key),
+        mask_(num_buckets - 1),
+        allocated_(new char[num_buckets * sizeof(uint64_t) + kAlignment]) {
+    // So that each bucket is within one cache line.
+    buckets_ = reinterpret_cast<uint64_t*>(AlignUp(allocated_, kAlignment));
+    memset(buckets_, 0, num_buckets * sizeof(uint64_t));
+    // Any nonzero seed; determines which fingerprints are kicked.
+    random_ = key[0] | 1;
+  }
+
+  CuckooFilter(const CuckooFilter&) = delete;
+  CuckooFilter& operator=(const CuckooFilter&) = delete;
+
+  HH_INLINE ~CuckooFilter() { delete[] allocated_; }
+
+  HH_INLINE size_t NumBuckets() const { return mask_ + 1; }
+  HH_INLINE size_t Bytes() const { return NumBuckets() * sizeof(uint64_t); }
+
+  // Number of elements (including duplicates) inserted and not erased.
+  HH_INLINE size_t Size() const { return size_; }
+  HH_INLINE double LoadFactor() const {
+    return static_cast<double>(size_) / (NumBuckets() * kSlotsPerBucket);
+  }
+
+  // Bytes() bytes of native-endian buckets, e.g. for persisting the filter.
+  // Restoring them requires the same key and number of buckets (and byte
+  // order), and the victim slot must be empty (Size() == number of nonzero
+  // slots), which is the case unless an insert reported the filter as full.
+  HH_INLINE const uint64_t* Data() const { return buckets_; }
+
+  // Computes the 64-bit hash from which the other functions derive the
+  // buckets and fingerprint.
+  HH_INLINE HHResult64 Hash(const char* HH_RESTRICT bytes,
+                            const size_t size) const {
+    HHStateT<HH_TARGET> state = initial_;
+    HHResult64 hash;
+    HighwayHashT(&state, bytes, size, &hash);
+    return hash;
+  }
+
+  // Returns false if the filter is full, in which case "bytes" was not
+  // inserted. Inserting the same element again adds another copy, which
+  // requires another Erase to remove.
+  HH_INLINE bool Insert(const char* HH_RESTRICT bytes, const size_t size) {
+    return InsertHash(Hash(bytes, size));
+  }
+
+  // Returns false if "bytes" was definitely not inserted (or was erased).
+  HH_INLINE bool MayContain(const char* HH_RESTRICT bytes,
+                            const size_t size) const {
+    return MayContainHash(Hash(bytes, size));
+  }
+
+  // Removes one copy of "bytes", which must have been inserted: erasing
+  // other elements may remove the fingerprint of an element with the same
+  // fingerprint and bucket, and thus cause false negatives. Returns false if
+  // no matching fingerprint was found.
+  HH_INLINE bool Erase(const char* HH_RESTRICT bytes, const size_t size) {
+    return EraseHash(Hash(bytes, size));
+  }
+
+  // Same as Insert/MayContain/Erase for a caller-computed hash, which must be
+  // the result of Hash for the same key (otherwise the filter is not keyed).
+  // The HHResult128 overloads use only hash[0], e.g. for callers that already
+  // computed a 128-bit hash of the element for another purpose.
+  HH_INLINE bool InsertHash(const HHResult64 hash) {
+    if (victim_fingerprint_ != 0) return false;  // full
+    uint64_t fingerprint = Fingerprint(hash);
+    size_t index = FirstIndex(hash);
+    const size_t alternate = AlternateIndex(index, fingerprint);
+    ++size_;
+    if (TryAdd(index, fingerprint) || TryAdd(alternate, fingerprint)) {
+      return true;
+    }
+
+    // Both buckets are full: move a random fingerprint of one candidate to
+    // its alternate bucket, and so on.
+    if (NextRandom() & 1) index = alternate;
+    for (size_t kick = 0; kick < kMaxKicks; ++kick) {
+      const size_t shift = (NextRandom() % kSlotsPerBucket) * 16;
+      const uint64_t evicted = (buckets_[index] >> shift) & 0xFFFF;
+      buckets_[index] ^= (evicted ^ fingerprint) << shift;
+      fingerprint = evicted;
+      index = AlternateIndex(index, fingerprint);
+      if (TryAdd(index, fingerprint)) return true;
+    }
+    victim_fingerprint_ = fingerprint;
+    victim_index_ = index;
+    return true;
+  }
+  HH_INLINE bool InsertHash(const HHResult128& hash) {
+    return InsertHash(hash[0]);
+  }
+
+  HH_INLINE bool MayContainHash(const HHResult64 hash) const {
+    const uint64_t fingerprint = Fingerprint(hash);
+    const size_t index = FirstIndex(hash);
+    const size_t alternate = AlternateIndex(index, fingerprint);
+    if (victim_fingerprint_ == fingerprint &&
+        (victim_index_ == index || victim_index_ == alternate)) {
+      return true;
+    }
+    return EitherContains(buckets_[index], buckets_[alternate], fingerprint);
+  }
+  HH_INLINE bool MayContainHash(const HHResult128& hash) const {
+    return MayContainHash(hash[0]);
+  }
+
+  HH_INLINE bool EraseHash(const HHResult64 hash) {
+    const uint64_t fingerprint = Fingerprint(hash);
+    const size_t index = FirstIndex(hash);
+    const size_t alternate = AlternateIndex(index, fingerprint);
+    if (TryRemove(index, fingerprint) || TryRemove(alternate, fingerprint)) {
+      --size_;
+      // There is now room for the victim in one of its buckets, if this was
+      // one of them.
+      if (victim_fingerprint_ != 0 &&
+          (TryAdd(victim_index_, victim_fingerprint_) ||
+           TryAdd(AlternateIndex(victim_index_, victim_fingerprint_),
+                  victim_fingerprint_))) {
+        victim_fingerprint_ = 0;
+      }
+      return true;
+    }
+    if (victim_fingerprint_ == fingerprint &&
+        (victim_index_ == index || victim_index_ == alternate)) {
+      victim_fingerprint_ = 0;
+      --size_;
+      return true;
+    }
+    return false;
+  }
+  HH_INLINE bool EraseHash(const HHResult128& hash) {
+    return EraseHash(hash[0]);
+  }
+
+  // Inserts each of the "num_keys" "keys" and returns how many succeeded
+  // (all unless the filter became full). Hashes up to kBatchSize keys and
+  // prefetches both of their buckets before updating any, so that the cache
+  // misses overlap with each other and the remaining hashing.
+  HH_INLINE size_t InsertBatch(const StringView* HH_RESTRICT keys,
+                               const size_t num_keys) {
+    HHResult64 hashes[kBatchSize];
+    size_t num_inserted = 0;
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        num_inserted += InsertHash(hashes[i]);
+      }
+    }
+    return num_inserted;
+  }
+
+  // Sets results[i] to MayContain(keys[i]) for all i < "num_keys", in the
+  // same manner as InsertBatch.
+  HH_INLINE void MayContainBatch(const StringView* HH_RESTRICT keys,
+                                 const size_t num_keys,
+                                 bool* HH_RESTRICT results) const {
+    HHResult64 hashes[kBatchSize];
+    for (size_t first = 0; first < num_keys; first += kBatchSize) {
+      const size_t count =
+          num_keys - first < kBatchSize ? num_keys - first : kBatchSize;
+      HashAndPrefetch(keys + first, count, hashes);
+      for (size_t i = 0; i < count; ++i) {
+        results[first + i] = MayContainHash(hashes[i]);
+      }
+    }
+  }
+
+ private:
+  static constexpr uintptr_t kAlignment = 64;
+  // Broadcasts a 16-bit value to all slots of a bucket.
+  static constexpr uint64_t kLanes = 0x0001000100010001ull;
+
+  static HH_INLINE uint64_t Fingerprint(const HHResult64 hash) {
+    const uint64_t fingerprint = hash >> 48;
+    return fingerprint == 0 ? 1 : fingerprint;
+  }
+
+  HH_INLINE size_t FirstIndex(const HHResult64 hash) const {
+    return static_cast<size_t>(hash & 0xFFFFFFFFu) & mask_;
+  }
+
+  // Involution: AlternateIndex(AlternateIndex(i, f), f) == i. Multiplying by
+  // an odd constant spreads the fingerprint across all index bits.
+  HH_INLINE size_t AlternateIndex(const size_t index,
+                                  const uint64_t fingerprint) const {
+    const uint32_t offset = static_cast<uint32_t>(fingerprint * 0x5BD1E995u);
+    return (index ^ offset) & mask_;
+  }
+
+  // "x" must be nonzero.
+  static HH_INLINE int CountTrailingZeros(const uint64_t x) {
+#if HH_MSC_VERSION
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(x);
+#endif
+  }
+
+  // Returns nonzero in the upper bit of each slot of "bucket" that is zero
+  // (and possibly in higher slots, but the lowest one is exact).
+  static HH_INLINE uint64_t ZeroSlots(const uint64_t bucket) {
+    return (bucket - kLanes) & ~bucket & (kLanes << 15);
+  }
+
+  // Stores "fingerprint" in an empty slot of bucket "index", if any.
+  HH_INLINE bool TryAdd(const size_t index, const uint64_t fingerprint) {
+    const uint64_t bucket = buckets_[index];
+    const uint64_t zero = ZeroSlots(bucket);
+    if (zero == 0) return false;
+    // Bit 15 of the first empty slot.
+    const int shift = CountTrailingZeros(zero) - 15;
+    buckets_[index] = bucket | (fingerprint << shift);
+    return true;
+  }
+
+  // Clears one slot of bucket "index" that contains "fingerprint", if any.
+  HH_INLINE bool TryRemove(const size_t index, const uint64_t fingerprint) {
+    const uint64_t bucket = buckets_[index];
+    const uint64_t zero = ZeroSlots(bucket ^ (fingerprint * kLanes));
+    if (zero == 0) return false;
+    const int shift = CountTrailingZeros(zero) - 15;
+    buckets_[index] = bucket & ~(uint64_t(0xFFFF) << shift);
+    return true;
+  }
+
+  static HH_INLINE bool EitherContains(const uint64_t bucket0,
+                                       const uint64_t bucket1,
+                                       const uint64_t fingerprint) {
+#if HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_AVX2 || \
+    HH_TARGET == HH_TARGET_AVX512
+    const V8x16U slots(_mm_set_epi64x(static_cast<int64_t>(bucket1),
+                                      static_cast<int64_t>(bucket0)));
+    const V8x16U equal(slots == V8x16U(static_cast<uint16_t>(fingerprint)));
+    return _mm_movemask_epi8(equal) != 0;
+#elif HH_TARGET == HH_TARGET_NEON
+    const V8x16U slots(vreinterpretq_u16_u64(
+        vcombine_u64(vcreate_u64(bucket0), vcreate_u64(bucket1))));
+    const uint64x2_t equal = vreinterpretq_u64_u16(
+        slots == V8x16U(static_cast<uint16_t>(fingerprint)));
+    return (vgetq_lane_u64(equal, 0) | vgetq_lane_u64(equal, 1)) != 0;
+#else
+    const uint64_t broadcast = fingerprint * kLanes;
+    return (ZeroSlots(bucket0 ^ broadcast) | ZeroSlots(bucket1 ^ broadcast)) !=
+           0;
+#endif
+  }
+
+  HH_INLINE void HashAndPrefetch(const StringView* HH_RESTRICT keys,
+                                 const size_t count,
+                                 HHResult64* HH_RESTRICT hashes) const {
+    for (size_t i = 0; i < count; ++i) {
+      hashes[i] = Hash(keys[i].data, keys[i].num_bytes);
+      const size_t index = FirstIndex(hashes[i]);
+      HH_PREFETCH(buckets_ + index);
+      HH_PREFETCH(buckets_ + AlternateIndex(index, Fingerprint(hashes[i])));
+    }
+  }
+
+  // xorshift64 (Marsaglia 2003).
+  HH_INLINE uint64_t NextRandom() {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+    return random_;
+  }
+
+  const HHStateT<HH_TARGET> initial_;
+  const size_t mask_;  // NumBuckets() - 1
+  char* const allocated_;
+  uint64_t* buckets_;  // cache-line aligned, within allocated_
+  size_t size_ = 0;
+  uint64_t random_;
+  // Fingerprint (or zero if none) that did not fit after kMaxKicks, and one
+  // of its two buckets.
+  uint64_t victim_fingerprint_ = 0;
+  size_t victim_index_ = 0;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_CUCKOO_FILTER_H_
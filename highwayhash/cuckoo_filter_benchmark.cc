@@ -0,0 +1,180 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the maximum load factor and false positive rate of CuckooFilter,
+// and the throughput of Insert/MayContain/Erase per key and of the batch
+// functions.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "highwayhash/cuckoo_filter.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kKeyBytes = 16;
+
+// Fraction of the slots filled for the throughput measurements.
+const double kLoad = 0.9;
+
+using Filter = HH_TARGET_NAME::CuckooFilter;
+
+// Views of each kKeyBytes of "bytes", which are random and thus distinct (with
+// high probability).
+std::vector<StringView> MakeKeys(const std::vector<char>& bytes) {
+  std::vector<StringView> keys(bytes.size() / kKeyBytes);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    keys[i] = StringView{bytes.data() + i * kKeyBytes, kKeyBytes};
+  }
+  return keys;
+}
+
+// "operation" applies "num_ops" operations to a filter with "num_buckets"
+// into which the first "num_inserted" "keys" were inserted, and returns a
+// count that must equal "expected".
+template <class Operation>
+void Measure(const char* caption, const size_t num_ops,
+             const size_t num_buckets, const std::vector<StringView>& keys,
+             const size_t num_inserted, const Operation& operation,
+             const size_t expected) {
+  double best = 1E10;
+  for (int rep = 0; rep < 3; ++rep) {
+    Filter filter(kKey, num_buckets);
+    filter.InsertBatch(keys.data(), num_inserted);
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t count = operation(&filter);
+    const auto t1 = std::chrono::steady_clock::now();
+    if (count != expected) {
+      printf("%s: wrong count %zu\n", caption, count);
+      exit(1);
+    }
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  printf("%32s: %6.2f M ops/s\n", caption, num_ops / best * 1E-6);
+}
+
+void Run(const size_t num_buckets) {
+  const size_t capacity = num_buckets * Filter::kSlotsPerBucket;
+  const size_t num_elements = static_cast<size_t>(capacity * kLoad);
+  std::mt19937_64 rng(12345);
+  // Enough keys to fill the filter, and as many for negative queries.
+  std::vector<char> bytes(2 * capacity * kKeyBytes);
+  for (char& byte : bytes) {
+    byte = static_cast<char>(rng());
+  }
+  const std::vector<StringView> keys = MakeKeys(bytes);
+
+  // Load factor at the first failed insert.
+  double max_load;
+  {
+    Filter filter(kKey, num_buckets);
+    size_t i = 0;
+    while (i < capacity && filter.Insert(keys[i].data, keys[i].num_bytes)) {
+      ++i;
+    }
+    max_load = filter.LoadFactor();
+  }
+
+  // Half of the queries are inserted keys, the others were not inserted.
+  const size_t num_queries = 2 * num_elements;
+  std::vector<StringView> queries(num_queries);
+  for (size_t i = 0; i < num_queries; ++i) {
+    queries[i] = i % 2 == 0 ? keys[rng() % num_elements]
+                            : keys[capacity + i / 2];
+  }
+  size_t num_false_positives = 0;
+  {
+    Filter filter(kKey, num_buckets);
+    filter.InsertBatch(keys.data(), num_elements);
+    for (size_t i = 1; i < num_queries; i += 2) {
+      num_false_positives +=
+          filter.MayContain(queries[i].data, queries[i].num_bytes);
+    }
+  }
+  const size_t expected = num_elements + num_false_positives;
+
+  printf("Target %s, %zu buckets, %zu KiB: max load %.1f%%, %.4f%% FPR at"
+         " %.0f%% load\n",
+         TargetName(HH_TARGET), num_buckets,
+         num_buckets * sizeof(uint64_t) >> 10, 100.0 * max_load,
+         100.0 * num_false_positives / num_elements, 100.0 * kLoad);
+
+  const auto insert = [&](Filter* filter) {
+    size_t num_inserted = 0;
+    for (size_t i = 0; i < num_elements; ++i) {
+      num_inserted += filter->Insert(keys[i].data, keys[i].num_bytes);
+    }
+    return num_inserted;
+  };
+  const auto insert_batch = [&](Filter* filter) {
+    return filter->InsertBatch(keys.data(), num_elements);
+  };
+  const auto may_contain = [&](Filter* filter) {
+    size_t num_positive = 0;
+    for (const StringView& query : queries) {
+      num_positive += filter->MayContain(query.data, query.num_bytes);
+    }
+    return num_positive;
+  };
+  const auto may_contain_batch = [&](Filter* filter) {
+    size_t num_positive = 0;
+    bool results[Filter::kBatchSize];
+    for (size_t first = 0; first < num_queries; first += Filter::kBatchSize) {
+      const size_t count = std::min(Filter::kBatchSize, num_queries - first);
+      filter->MayContainBatch(queries.data() + first, count, results);
+      for (size_t i = 0; i < count; ++i) {
+        num_positive += results[i];
+      }
+    }
+    return num_positive;
+  };
+  const auto erase = [&](Filter* filter) {
+    size_t num_erased = 0;
+    for (size_t i = 0; i < num_elements; ++i) {
+      num_erased += filter->Erase(keys[i].data, keys[i].num_bytes);
+    }
+    return num_erased;
+  };
+
+  Measure("Insert", num_elements, num_buckets, keys, 0, insert, num_elements);
+  Measure("InsertBatch", num_elements, num_buckets, keys, 0, insert_batch,
+          num_elements);
+  Measure("MayContain", num_queries, num_buckets, keys, num_elements,
+          may_contain, expected);
+  Measure("MayContainBatch", num_queries, num_buckets, keys, num_elements,
+          may_contain_batch, expected);
+  Measure("Erase", num_elements, num_buckets, keys, num_elements, erase,
+          num_elements);
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  // Cache-resident (hashing dominates) and 32 MiB (cache misses dominate).
+  highwayhash::Run(size_t{1} << 10);
+  highwayhash::Run(size_t{1} << 12);
+  highwayhash::Run(size_t{1} << 22);
+  return 0;
+}
@@ -19,18 +19,29 @@
 // provides low-overhead ThreadPool, plus PerThread with support for reduction.
 
 #include <stdio.h>
-#include <algorithm>  // find_if
+#include <algorithm>  // remove_if
 #include <atomic>
+#include <chrono>  //NOLINT
 #include <condition_variable>  //NOLINT
 #include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <functional>
+#include <map>
 #include <memory>
+#include <new>
 #include <mutex>  //NOLINT
 #include <thread>  //NOLINT
 #include <utility>
 #include <vector>
 
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/os_specific.h"
+
+#if HH_ARCH_X64
+#include <emmintrin.h>  // _mm_pause
+#endif
+
 #define DATA_PARALLEL_CHECK(condition)                           \
   while (!(condition)) {                                         \
     printf("data_parallel check failed at line %d\n", __LINE__); \
@@ -53,36 +64,120 @@ namespace highwayhash {
 // 1M tasks that add to an atomic counter, overall runtime is 10-20x higher
 // when using std::async, and up to 200x for a queue-based ThreadPool.
 //
+// When task costs vary widely (e.g. hashing files of very different sizes),
+// the kWorkStealing schedule balances the load better and avoids contention
+// for the shared counter at high thread counts.
+//
 // Usage:
 // ThreadPool pool;
 // pool.Run(0, 1000000, [](const int i) { Func1(i); });
 // // When Run returns, all of its tasks have finished.
 //
+// pool.Run(0, num_files, [](const int i) { HashFile(i); },
+//          ThreadPool::Schedule::kWorkStealing);
+//
 // pool.RunTasks({Func2, Func3, Func4});
 // // The destructor waits until all worker threads have exited cleanly.
+//
+// Any number of threads may also Submit work to the same pool without
+// blocking, and later Wait for it (helping to run its tasks):
+// ThreadPool::Handle handle = pool.Submit(0, 100, [](const int i) { F(i); });
+// DoOtherWork();
+// handle.Wait();
 class ThreadPool {
+  struct Job;
+
  public:
+  // How Run distributes the tasks among the workers.
+  enum class Schedule {
+    // Workers reserve decreasing numbers of tasks from a shared atomic
+    // counter. Lowest overhead for tasks of similar cost.
+    kGuided,
+    // Each worker owns a contiguous part of the range and takes small chunks
+    // from its front. Workers that run out steal the back half of another
+    // worker's remaining range. Better balance for skewed task costs.
+    kWorkStealing
+  };
+
+  // Where the workers run, see AvailableCPUTopology.
+  enum class Placement {
+    // Wherever the OS scheduler decides.
+    kNone,
+    // Each worker is pinned to one CPU: first one per physical core, with
+    // consecutive workers on different NUMA nodes, then the SMT siblings.
+    kCores,
+    // Each worker may run on any CPU of one NUMA node; consecutive workers
+    // are on different nodes. Lets the OS balance within a node.
+    kNodes
+  };
+
+  // Refers to the tasks of one Submit call. Cheap to copy; all copies refer to
+  // the same tasks. Must not outlive the ThreadPool.
+  class Handle {
+   public:
+    // Returns whether all tasks have finished. Does not block.
+    bool Done() const { return job_->num_unfinished.load() == 0; }
+
+    // Runs any of the tasks that no worker has started yet, then blocks until
+    // all have finished. Afterwards, all side effects of the tasks are
+    // visible to the caller.
+    void Wait() const {
+      while (pool_->RunJobChunk(job_.get())) {
+      }
+      std::unique_lock<std::mutex> lock(pool_->mutex_);
+      pool_->job_done_cv_.wait(lock, [this]() { return Done(); });
+    }
+
+   private:
+    friend class ThreadPool;
+    Handle(ThreadPool* pool, std::shared_ptr<Job> job)
+        : pool_(pool), job_(std::move(job)) {}
+
+    ThreadPool* pool_;
+    std::shared_ptr<Job> job_;
+  };
+
   // Starts the given number of worker threads and blocks until they are ready.
-  // "num_threads" defaults to one per hyperthread.
+  // "num_threads" defaults to one per usable hyperthread, which respects
+  // container CPU quotas (see NumUsableCPUs).
   explicit ThreadPool(
-      const int num_threads = std::thread::hardware_concurrency())
-      : num_threads_(num_threads) {
+      const int num_threads = NumUsableCPUs(),
+      const Placement placement = Placement::kNone)
+      : num_threads_(num_threads),
+        placement_(placement),
+        ranges_(new std::atomic<uint64_t>[num_threads * kRangeStride]) {
     DATA_PARALLEL_CHECK(num_threads_ > 0);
+    if (placement_ != Placement::kNone) {
+      PlaceWorkers();
+    }
+    for (int i = 0; i < num_threads_; ++i) {
+      ranges_[i * kRangeStride].store(0);
+    }
     threads_.reserve(num_threads_);
     for (int i = 0; i < num_threads_; ++i) {
-      threads_.emplace_back(ThreadFunc, this);
+      threads_.emplace_back(ThreadFunc, this, i);
     }
 
     padding_[0] = 0;  // avoid unused member warning.
 
+    // Spinning only helps if the workers and the thread calling Run need not
+    // share a single CPU.
+    spin_nanoseconds_.store(NumUsableCPUs() > 1
+                                ? kDefaultSpinNanoseconds
+                                : 0);
+
     WorkersReadyBarrier();
   }
 
   ThreadPool(const ThreadPool&) = delete;
   ThreadPool& operator&(const ThreadPool&) = delete;
 
-  // Waits for all threads to exit.
+  // Waits for all submitted tasks to finish and all threads to exit.
   ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_done_cv_.wait(lock, [this]() { return num_unfinished_jobs_ == 0; });
+    }
     StartWorkers(kWorkerExit);
 
     for (std::thread& thread : threads_) {
@@ -92,24 +187,42 @@ class ThreadPool {
 
   // Runs func(i) on worker thread(s) for every i in [begin, end).
   // Not thread-safe - no two calls to Run and RunTasks may overlap.
-  // Subsequent calls will reuse the same threads.
+  // Subsequent calls will reuse the same threads. Neither copies "func" nor
+  // allocates memory, so it is also suitable for frequent small jobs.
   //
   // Precondition: 0 <= begin <= end.
   template <class Func>
-  void Run(const int begin, const int end, const Func& func) {
+  void Run(const int begin, const int end, const Func& func,
+           const Schedule schedule = Schedule::kGuided) {
     DATA_PARALLEL_CHECK(0 <= begin && begin <= end);
     if (begin == end) {
       return;
     }
     const WorkerCommand worker_command = (WorkerCommand(end) << 32) + begin;
     // Ensure the inputs do not result in a reserved command.
-    DATA_PARALLEL_CHECK(worker_command != kWorkerWait);
     DATA_PARALLEL_CHECK(worker_command != kWorkerExit);
 
-    // If Func is large (many captures), this will allocate memory, but it is
-    // still slower to use a std::ref wrapper.
-    task_ = func;
+    // Run returns only after all tasks have finished, so "func" outlives them
+    // and can be referenced instead of copied into a std::function, which
+    // would allocate for closures with more than a few captures.
+    task_ = &CallTask<Func>;
+    task_context_ = &func;
+    schedule_ = schedule;
     num_reserved_.store(0);
+    if (schedule == Schedule::kWorkStealing) {
+      const int num_tasks = end - begin;
+      // Small enough that a worker rarely holds back much work while it is
+      // busy with a chunk, large enough to amortize the compare-exchange.
+      grain_ = std::max(num_tasks / (num_threads_ * 64), 1);
+      // Contiguous, equal parts preserve locality for neighboring tasks.
+      for (int i = 0; i < num_threads_; ++i) {
+        const int64_t my_begin = int64_t(num_tasks) * i / num_threads_;
+        const int64_t my_end = int64_t(num_tasks) * (i + 1) / num_threads_;
+        ranges_[i * kRangeStride].store(
+            PackRange(begin + static_cast<int>(my_begin),
+                      begin + static_cast<int>(my_end)));
+      }
+    }
 
     StartWorkers(worker_command);
     WorkersReadyBarrier();
@@ -126,27 +239,134 @@ class ThreadPool {
         [&tasks](const int i) { tasks[i](); });
   }
 
+  // Queues func(i) for every i in [begin, end) and returns immediately.
+  // Thread-safe: any number of threads may Submit concurrently, also while
+  // another thread is inside Run (which then waits for the workers to finish
+  // their current chunk of submitted tasks). Workers take the oldest
+  // submission first. "func" is copied; anything it references must remain
+  // valid until the Handle reports Done or Wait returns.
+  //
+  // Precondition: 0 <= begin <= end.
+  template <class Func>
+  Handle Submit(const int begin, const int end, const Func& func) {
+    DATA_PARALLEL_CHECK(0 <= begin && begin <= end);
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->task = func;
+    job->end = end;
+    job->next.store(begin);
+    job->num_unfinished.store(end - begin);
+    if (begin != end) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+        num_queued_jobs_.store(jobs_.size());
+        ++num_unfinished_jobs_;
+      }
+      worker_start_cv_.notify_all();
+    }
+    return Handle(this, std::move(job));
+  }
+
+  // Submit for heterogeneous tasks, analogous to RunTasks.
+  Handle SubmitTasks(std::vector<std::function<void(void)>> tasks) {
+    const int num_tasks = static_cast<int>(tasks.size());
+    std::shared_ptr<std::vector<std::function<void(void)>>> shared =
+        std::make_shared<std::vector<std::function<void(void)>>>(
+            std::move(tasks));
+    return Submit(0, num_tasks, [shared](const int i) { (*shared)[i](); });
+  }
+
   // Statically (and deterministically) splits [begin, end) into ranges and
   // calls "func" for each of them. Useful when "func" involves some overhead
   // (e.g. for PerThread::Get or random seeding) that should be amortized over
   // a range of values. "func" is void(int chunk, uint32_t begin, uint32_t end).
+  // As with Run, there are no allocations.
   template <class Func>
   void RunRanges(const uint32_t begin, const uint32_t end, const Func& func) {
-    const uint32_t length = end - begin;
+    const Ranges ranges(begin, end);
+    Run(0, ranges.Num(), [&ranges, &func](const int i) {
+      func(i, ranges.Begin(i), ranges.End(i));
+    });
+  }
+
+  // Same ranges and "func" as RunRanges, but each range is preferably run by
+  // a worker on the NUMA node returned by node_of_index(range begin), e.g.
+  // NodeOfAddress of its input, which avoids remote memory accesses. Workers
+  // help with other nodes' ranges after their own are done. Only differs from
+  // RunRanges if the workers were placed (see Placement).
+  template <class NodeFunc, class Func>
+  void RunRangesOnNodes(const uint32_t begin, const uint32_t end,
+                        const NodeFunc& node_of_index, const Func& func) {
+    const Ranges ranges(begin, end);
+    if (placement_ == Placement::kNone) {
+      Run(0, ranges.Num(), [&ranges, &func](const int i) {
+        func(i, ranges.Begin(i), ranges.End(i));
+      });
+      return;
+    }
 
-    // Use constant rather than num_threads_ for machine-independent splitting.
-    const uint32_t chunk = std::max(1U, (length + 127) / 128);
-    std::vector<std::pair<uint32_t, uint32_t>> ranges;  // begin/end
-    ranges.reserve(length / chunk + 1);
-    for (uint32_t i = 0; i < length; i += chunk) {
-      ranges.emplace_back(begin + i, begin + std::min(i + chunk, length));
+    // Indices of the ranges whose memory is on each of nodes_.
+    const int num_nodes = static_cast<int>(nodes_.size());
+    std::vector<std::vector<int>> ranges_of_node(num_nodes);
+    for (int i = 0; i < ranges.Num(); ++i) {
+      const int node = node_of_index(ranges.Begin(i));
+      const auto it = std::find(nodes_.begin(), nodes_.end(), node);
+      // Ranges on unknown nodes are assigned round-robin.
+      const int slot = (it == nodes_.end())
+                           ? i % num_nodes
+                           : static_cast<int>(it - nodes_.begin());
+      ranges_of_node[slot].push_back(i);
+    }
+    std::unique_ptr<std::atomic<int>[]> num_claimed(
+        new std::atomic<int>[num_nodes]);
+    for (int slot = 0; slot < num_nodes; ++slot) {
+      num_claimed[slot].store(0);
     }
 
-    Run(0, static_cast<int>(ranges.size()), [&ranges, func](const int i) {
-      func(i, ranges[i].first, ranges[i].second);
+    // Each call claims one range, starting with the worker's own node. There
+    // are as many calls as ranges, so every call finds an unclaimed range.
+    Run(0, ranges.Num(), [&](const int) {
+      const int my_slot = std::max(WorkerNodeSlot(), 0);
+      for (int offset = 0; offset < num_nodes; ++offset) {
+        const int slot = (my_slot + offset) % num_nodes;
+        const int claimed = num_claimed[slot].fetch_add(1);
+        if (claimed < static_cast<int>(ranges_of_node[slot].size())) {
+          const int i = ranges_of_node[slot][claimed];
+          func(i, ranges.Begin(i), ranges.End(i));
+          return;
+        }
+      }
     });
   }
 
+  int NumThreads() const { return num_threads_; }
+  Placement placement() const { return placement_; }
+
+  // Reduces the power and SMT resources consumed while spinning. Also useful
+  // for other spin-waits, e.g. in pipeline.h.
+  static void Pause() {
+#if HH_ARCH_X64
+    _mm_pause();
+#elif (HH_ARCH_AARCH64 || HH_ARCH_ARM) && defined(__GNUC__)
+    asm volatile("yield");
+#endif
+  }
+
+  // Default for SetSpinNanoseconds: a multiple of the typical futex wakeup
+  // latency, but short enough not to waste much CPU time when idle.
+  static constexpr int64_t kDefaultSpinNanoseconds = 50000;
+
+  // Idle workers, and Run while waiting for the workers, busy-wait (with a
+  // pause instruction) for up to this long before blocking on a condition
+  // variable. Spinning avoids the futex wakeup latency (tens of microseconds)
+  // of each Run call, which matters when calling Run often for little work,
+  // at the cost of CPU time. Zero blocks immediately. Thread-safe; takes effect
+  // the next time a thread waits. Defaults to kDefaultSpinNanoseconds, or
+  // zero on single-CPU systems.
+  void SetSpinNanoseconds(const int64_t nanoseconds) {
+    spin_nanoseconds_.store(nanoseconds, std::memory_order_relaxed);
+  }
+
  private:
   // After construction and between calls to Run, workers are "ready", i.e.
   // waiting on worker_start_cv_. They are "started" by sending a "command"
@@ -155,21 +375,168 @@ class ThreadPool {
   // them and the main thread waits in vain for them to report readiness.)
   using WorkerCommand = uint64_t;
 
-  // Special values; all others encode the begin/end parameters.
-  static constexpr WorkerCommand kWorkerWait = 0;
+  // Special value; all others encode the begin/end parameters.
   static constexpr WorkerCommand kWorkerExit = ~0ULL;
 
-  void WorkersReadyBarrier() {
+  // Tasks of one Submit call.
+  struct Job {
+    std::function<void(int)> task;
+    int end;
+    std::atomic<int> next{0};            // first unreserved task
+    std::atomic<int> num_unfinished{0};  // Done when zero
+  };
+
+  // Type-erased call of the "func" passed to Run.
+  using Task = void (*)(const void* func, int i);
+  template <class Func>
+  static void CallTask(const void* func, const int i) {
+    (*static_cast<const Func*>(func))(i);
+  }
+
+  // Splits [begin, end) into up to 128 consecutive ranges of "chunk" values
+  // (the last may be shorter). Uses a constant rather than num_threads_ for
+  // machine-independent splitting. The bounds are computed on demand, so
+  // there is nothing to allocate.
+  class Ranges {
+   public:
+    Ranges(const uint32_t begin, const uint32_t end)
+        : begin_(begin),
+          length_(end - begin),
+          chunk_(std::max(1U, (length_ + 127) / 128)) {}
+
+    int Num() const {
+      return static_cast<int>((length_ + chunk_ - 1) / chunk_);
+    }
+    uint32_t Begin(const int i) const { return begin_ + i * chunk_; }
+    uint32_t End(const int i) const {
+      return begin_ + static_cast<uint32_t>(std::min<uint64_t>(
+                          uint64_t(i + 1) * chunk_, length_));
+    }
+
+   private:
+    const uint32_t begin_;
+    const uint32_t length_;
+    const uint32_t chunk_;
+  };
+
+  // Index within nodes_ of the node on which the current worker runs, or -1
+  // if not placed (or not a worker).
+  static int& WorkerNodeSlot() {
+    static thread_local int slot = -1;
+    return slot;
+  }
+
+  // Initializes worker_cpus_, worker_slots_ and nodes_ from the topology.
+  void PlaceWorkers() {
+    // CPUs of each physical core, grouped by node.
+    std::map<int, std::map<std::pair<int, int>, std::vector<int>>> cores;
+    for (const CPUTopology& location : AvailableCPUTopology()) {
+      cores[location.node][std::make_pair(location.package, location.core)]
+          .push_back(location.cpu);
+    }
+    std::vector<std::vector<std::vector<int>>> cores_of_node;
+    for (const auto& node_cores : cores) {
+      nodes_.push_back(node_cores.first);
+      cores_of_node.emplace_back();
+      for (const auto& core : node_cores.second) {
+        cores_of_node.back().push_back(core.second);
+      }
+    }
+    const int num_nodes = static_cast<int>(nodes_.size());
+    DATA_PARALLEL_CHECK(num_nodes != 0);
+
+    worker_cpus_.resize(num_threads_);
+    worker_slots_.resize(num_threads_);
+    if (placement_ == Placement::kNodes) {
+      for (int i = 0; i < num_threads_; ++i) {
+        const int slot = i % num_nodes;
+        worker_slots_[i] = slot;
+        for (const std::vector<int>& siblings : cores_of_node[slot]) {
+          worker_cpus_[i].insert(worker_cpus_[i].end(), siblings.begin(),
+                                 siblings.end());
+        }
+      }
+      return;
+    }
+
+    // kCores: the k-th sibling of every core (interleaving the nodes) before
+    // the (k+1)-th; wraps around if there are more workers than CPUs.
+    std::vector<std::pair<int, int>> order;  // slot, cpu
+    size_t max_cores = 0;
+    size_t max_siblings = 0;
+    for (const auto& node_cores : cores_of_node) {
+      max_cores = std::max(max_cores, node_cores.size());
+      for (const std::vector<int>& siblings : node_cores) {
+        max_siblings = std::max(max_siblings, siblings.size());
+      }
+    }
+    for (size_t sibling = 0; sibling < max_siblings; ++sibling) {
+      for (size_t core = 0; core < max_cores; ++core) {
+        for (int slot = 0; slot < num_nodes; ++slot) {
+          const auto& node_cores = cores_of_node[slot];
+          if (core < node_cores.size() && sibling < node_cores[core].size()) {
+            order.emplace_back(slot, node_cores[core][sibling]);
+          }
+        }
+      }
+    }
+    for (int i = 0; i < num_threads_; ++i) {
+      const std::pair<int, int>& slot_cpu = order[i % order.size()];
+      worker_slots_[i] = slot_cpu.first;
+      worker_cpus_[i].push_back(slot_cpu.second);
+    }
+  }
+
+  // Elements of ranges_ between those of consecutive workers, so that each
+  // occupies its own cache line.
+  static constexpr int kRangeStride = 64 / sizeof(std::atomic<uint64_t>);
+
+  // Encodes [begin, end) such that a single compare-exchange can update both,
+  // in the same format as WorkerCommand.
+  static uint64_t PackRange(const int begin, const int end) {
+    return (uint64_t(end) << 32) + begin;
+  }
+
+  // Returns once "condition" (which only reads atomics) is true: spins for
+  // up to spin_nanoseconds_, then blocks on "cv". To avoid lost wakeups,
+  // whoever makes the condition true must do so while holding mutex_, or lock
+  // mutex_ afterwards, before notifying "cv".
+  template <class Condition>
+  void SpinThenWait(std::condition_variable& cv, const Condition& condition) {
+    const int64_t spin_ns = spin_nanoseconds_.load(std::memory_order_relaxed);
+    if (spin_ns != 0) {
+      const auto deadline = std::chrono::steady_clock::now() +
+                            std::chrono::nanoseconds(spin_ns);
+      do {
+        if (condition()) return;
+        Pause();
+      } while (std::chrono::steady_clock::now() < deadline);
+    }
     std::unique_lock<std::mutex> lock(mutex_);
-    workers_ready_cv_.wait(lock,
-                           [this]() { return workers_ready_ == num_threads_; });
-    workers_ready_ = 0;
+    cv.wait(lock, condition);
   }
 
-  // Precondition: all workers are ready.
+  void WorkersReadyBarrier() {
+    SpinThenWait(workers_ready_cv_,
+                 [this]() { return workers_ready_.load() == num_threads_; });
+    workers_ready_.store(0);
+  }
+
+  // Called by each worker after finishing a command (or construction).
+  void ReportReady() {
+    if (workers_ready_.fetch_add(1) + 1 == num_threads_) {
+      // Ensures the main thread is either still spinning, or already waiting
+      // and will receive the notification.
+      { std::lock_guard<std::mutex> lock(mutex_); }
+      workers_ready_cv_.notify_one();
+    }
+  }
+
+  // Precondition: all workers are ready, i.e. none are running tasks of Run.
   void StartWorkers(const WorkerCommand worker_command) {
     std::unique_lock<std::mutex> lock(mutex_);
     worker_start_command_ = worker_command;
+    worker_start_generation_.fetch_add(1);
     // Workers will need this lock, so release it before they wake up.
     lock.unlock();
     worker_start_cv_.notify_all();
@@ -181,6 +548,8 @@ class ThreadPool {
     const int begin = command & 0xFFFFFFFF;
     const int end = command >> 32;
     const int num_tasks = end - begin;
+    const Task task = self->task_;
+    const void* task_context = self->task_context_;
 
     // OpenMP introduced several "schedule" strategies:
     // "single" (static assignment of exactly one chunk per thread): slower.
@@ -200,48 +569,169 @@ class ThreadPool {
         break;
       }
       for (int i = my_begin; i < my_end; ++i) {
-        self->task_(i);
+        task(task_context, i);
+      }
+    }
+  }
+
+  // Runs chunks from the front of the worker's own range, then steals the
+  // back half of another worker's range into its own. Returns after a scan
+  // of all workers found no remaining tasks; tasks that were stolen before
+  // then are run by their thieves, so none are lost.
+  //
+  // Compare-exchange of the packed range suffices: owners only increase
+  // begin, thieves only decrease end, and a worker only stores a new range
+  // into its own slot after it became empty, which thieves never modify.
+  static void StealRange(ThreadPool* self, const int worker) {
+    std::atomic<uint64_t>& mine = self->ranges_[worker * kRangeStride];
+    const int grain = self->grain_;
+    const Task task = self->task_;
+    const void* task_context = self->task_context_;
+    for (;;) {
+      uint64_t range = mine.load();
+      for (;;) {
+        const int begin = range & 0xFFFFFFFF;
+        const int end = range >> 32;
+        if (begin >= end) break;
+        const int my_end = std::min(begin + grain, end);
+        if (mine.compare_exchange_weak(range, PackRange(my_end, end))) {
+          for (int i = begin; i < my_end; ++i) {
+            task(task_context, i);
+          }
+          range = mine.load();
+        }
+      }
+
+      bool stole = false;
+      for (int offset = 1; offset < self->num_threads_ && !stole; ++offset) {
+        const int victim = (worker + offset) % self->num_threads_;
+        std::atomic<uint64_t>& theirs = self->ranges_[victim * kRangeStride];
+        uint64_t victim_range = theirs.load();
+        for (;;) {
+          const int begin = victim_range & 0xFFFFFFFF;
+          const int end = victim_range >> 32;
+          if (begin >= end) break;
+          const int split = end - (end - begin + 1) / 2;
+          if (theirs.compare_exchange_weak(victim_range,
+                                           PackRange(begin, split))) {
+            mine.store(PackRange(split, end));
+            stole = true;
+            break;
+          }
+        }
       }
+      if (!stole) return;
+    }
+  }
+
+  // Reserves a chunk of the job's remaining tasks (in the same guided manner
+  // as RunRange) and runs them. Returns false if all were already reserved.
+  bool RunJobChunk(Job* job) {
+    const int num_remaining = job->end - job->next.load();
+    const int my_size = std::max(num_remaining / (num_threads_ * 2), 1);
+    const int my_begin = job->next.fetch_add(my_size);
+    const int my_end = std::min(my_begin + my_size, job->end);
+    if (my_begin >= my_end) {
+      return false;
+    }
+    for (int i = my_begin; i < my_end; ++i) {
+      job->task(i);
     }
+    if (job->num_unfinished.fetch_sub(my_end - my_begin) ==
+        my_end - my_begin) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --num_unfinished_jobs_;
+      // Waiters check Done() while holding the lock, so they cannot miss this.
+      job_done_cv_.notify_all();
+    }
+    return true;
   }
 
-  static void ThreadFunc(ThreadPool* self) {
+  static void ThreadFunc(ThreadPool* self, const int worker) {
+    if (self->placement_ != Placement::kNone) {
+      PinThreadToCPUs(self->worker_cpus_[worker]);
+      WorkerNodeSlot() = self->worker_slots_[worker];
+    }
+
+    uint64_t generation = 0;
     // Until kWorkerExit command received:
     for (;;) {
-      std::unique_lock<std::mutex> lock(self->mutex_);
       // Notify main thread that this thread is ready.
-      if (++self->workers_ready_ == self->num_threads_) {
-        self->workers_ready_cv_.notify_one();
+      self->ReportReady();
+      // Wait for a command, helping with submitted jobs in the meantime. The
+      // generation (rather than only the notification) ensures commands are
+      // not missed while running jobs, and ignores spurious wakeups.
+      for (;;) {
+        self->SpinThenWait(self->worker_start_cv_, [self, generation]() {
+          return self->worker_start_generation_.load() != generation ||
+                 self->num_queued_jobs_.load() != 0;
+        });
+        if (self->worker_start_generation_.load() != generation) break;
+        std::shared_ptr<Job> job;
+        {
+          std::lock_guard<std::mutex> lock(self->mutex_);
+          if (!self->jobs_.empty()) job = self->jobs_.front();
+        }
+        if (job == nullptr || self->RunJobChunk(job.get())) continue;
+        // All tasks are reserved; others may still be running them.
+        std::lock_guard<std::mutex> lock(self->mutex_);
+        if (!self->jobs_.empty() && self->jobs_.front() == job) {
+          self->jobs_.pop_front();
+          self->num_queued_jobs_.store(self->jobs_.size());
+        }
       }
-    RESUME_WAIT:
-      // Wait for a command.
-      self->worker_start_cv_.wait(lock);
+      generation = self->worker_start_generation_.load();
+      // Written before the generation was incremented, and not modified until
+      // after all workers have reported ready.
       const WorkerCommand command = self->worker_start_command_;
-      switch (command) {
-        case kWorkerWait:    // spurious wakeup:
-          goto RESUME_WAIT;  // lock still held, avoid incrementing ready.
-        case kWorkerExit:
-          return;  // exits thread
+      if (command == kWorkerExit) {
+        return;  // exits thread
       }
 
-      lock.unlock();
-      RunRange(self, command);
+      if (self->schedule_ == Schedule::kWorkStealing) {
+        StealRange(self, worker);
+      } else {
+        RunRange(self, command);
+      }
     }
   }
 
   const int num_threads_;
+  const Placement placement_;
+
+  // Unmodified after ctor. Only initialized if placement_ != kNone.
+  std::vector<int> nodes_;  // distinct NUMA nodes, ascending
+  std::vector<std::vector<int>> worker_cpus_;  // affinity of each worker
+  std::vector<int> worker_slots_;              // index within nodes_
 
   // Unmodified after ctor, but cannot be const because we call thread::join().
   std::vector<std::thread> threads_;
 
-  std::mutex mutex_;  // guards both cv and their variables.
+  // Guards all cv and their variables, and jobs_. The atomics are modified
+  // while holding it, but may be read without, e.g. while spinning.
+  std::mutex mutex_;
   std::condition_variable workers_ready_cv_;
-  int workers_ready_ = 0;
+  std::atomic<int> workers_ready_{0};
   std::condition_variable worker_start_cv_;
   WorkerCommand worker_start_command_;
+  std::atomic<uint64_t> worker_start_generation_{0};  // see StartWorkers
+  std::atomic<int64_t> spin_nanoseconds_{0};
+
+  // Submitted jobs whose tasks are not yet all reserved, oldest first.
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::atomic<size_t> num_queued_jobs_{0};  // jobs_.size()
+  int num_unfinished_jobs_ = 0;
+  std::condition_variable job_done_cv_;
 
   // Written by main thread, read by workers (after mutex lock/unlock).
-  std::function<void(int)> task_;
+  Task task_ = nullptr;
+  const void* task_context_ = nullptr;  // the "func" passed to Run
+  Schedule schedule_ = Schedule::kGuided;
+  int grain_ = 1;  // tasks per chunk for kWorkStealing
+
+  // Remaining [begin, end) of each worker for kWorkStealing, see PackRange.
+  // Only every kRangeStride-th element is used to avoid false sharing.
+  const std::unique_ptr<std::atomic<uint64_t>[]> ranges_;
 
   // Updated by workers; alignment/padding avoids false sharing.
   alignas(64) std::atomic<int> num_reserved_{0};
@@ -254,6 +744,10 @@ class ThreadPool {
 // could eliminate this list and T allocations, but that is difficult to
 // arrange and we prefer this to be usable independently of ThreadPool.)
 //
+// Each T occupies its own cache lines, so that threads updating their copy
+// (e.g. counters or hash accumulators) do not slow each other down via false
+// sharing. Registering a thread's copy is lock-free.
+//
 // Usage:
 // for (int i = 0; i < N; ++i) {
 //   // in each thread:
@@ -261,7 +755,7 @@ class ThreadPool {
 //   my_copy.Modify();
 //
 //   // single-threaded:
-//   T& combined = PerThread<T>::Reduce();
+//   T& combined = PerThread<T>::Reduce();  // or Reduce(&pool)
 //   Use(combined);
 //   PerThread<T>::Destroy();
 // }
@@ -276,9 +770,16 @@ class ThreadPool {
 // void Destroy();
 //
 // // Merges in data from "victim". Precondition: !IsNull() && !victim.IsNull().
+// // Must be associative and commutative for Reduce(pool).
 // void Assimilate(const T& victim);
 template <class T>
 class PerThread {
+  // Padded to whole cache lines; also aligned to them by NewSlot.
+  struct alignas(64) Slot {
+    T t;
+    Slot* next;  // previously registered, or null
+  };
+
  public:
   // Returns reference to this thread's T instance (dynamically allocated,
   // so its address is unique). Callers are responsible for any initialization
@@ -286,19 +787,31 @@ class PerThread {
   static T& Get() {
     static thread_local T* t;
     if (t == nullptr) {
-      t = new T;
-      static std::mutex mutex;
-      std::lock_guard<std::mutex> lock(mutex);
-      Threads().push_back(t);
+      Slot* slot = NewSlot();
+      // Slots are never removed, hence no ABA problem. Release ordering
+      // publishes slot->next to Threads().
+      std::atomic<Slot*>& head = Head();
+      slot->next = head.load(std::memory_order_relaxed);
+      while (!head.compare_exchange_weak(slot->next, slot,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+      }
+      t = &slot->t;
     }
     return *t;
   }
 
-  // Returns vector of all per-thread T. Used inside Reduce() or by clients
-  // that require direct access to T instead of Assimilating them.
-  // Function wrapper avoids separate static member variable definition.
-  static std::vector<T*>& Threads() {
-    static std::vector<T*> threads;
+  // Returns all per-thread T in the order in which threads first called
+  // Get(). Used inside Reduce() or by clients that require direct access to T
+  // instead of Assimilating them. Only includes threads whose Get() returned
+  // before this call.
+  static std::vector<T*> Threads() {
+    std::vector<T*> threads;
+    for (Slot* slot = Head().load(std::memory_order_acquire); slot != nullptr;
+         slot = slot->next) {
+      threads.push_back(&slot->t);
+    }
+    std::reverse(threads.begin(), threads.end());
     return threads;
   }
 
@@ -306,22 +819,30 @@ class PerThread {
   // into it. Precondition: at least one non-null T exists (caller must have
   // called Get() and initialized the result).
   static T& Reduce() {
-    std::vector<T*>& threads = Threads();
-
-    // Find first non-null T
-    const auto it = std::find_if(threads.begin(), threads.end(),
-                                 [](const T* t) { return !t->IsNull(); });
-    if (it == threads.end()) {
-      abort();
+    const std::vector<T*> threads = NonNullThreads();
+    T* const first = threads[0];
+    for (size_t i = 1; i < threads.size(); ++i) {
+      first->Assimilate(*threads[i]);
     }
-    T* const first = *it;
+    return *first;
+  }
 
-    for (const T* t : threads) {
-      if (t != first && !t->IsNull()) {
-        first->Assimilate(*t);
-      }
+  // Same as Reduce(), but assimilates pairs of T in parallel on "pool", in
+  // log2(number of threads) rounds of Run. Worthwhile if there are many
+  // threads and Assimilate is expensive (e.g. large accumulators). Not
+  // thread-safe with respect to other Run calls on "pool".
+  static T& Reduce(ThreadPool* pool) {
+    const std::vector<T*> threads = NonNullThreads();
+    const int num_threads = static_cast<int>(threads.size());
+    // Round k merges the T at odd multiples of 2^k into their left neighbor.
+    for (int stride = 1; stride < num_threads; stride *= 2) {
+      const int num_pairs = (num_threads + stride - 1) / (2 * stride);
+      pool->Run(0, num_pairs, [&threads, stride](const int pair) {
+        const int left = pair * 2 * stride;
+        threads[left]->Assimilate(*threads[left + stride]);
+      });
     }
-    return *first;
+    return *threads[0];
   }
 
   // Calls each thread's T::Destroy to release resources and/or prepare for
@@ -334,6 +855,35 @@ class PerThread {
       t->Destroy();
     }
   }
+
+ private:
+  // Function wrapper avoids separate static member variable definition.
+  static std::atomic<Slot*>& Head() {
+    static std::atomic<Slot*> head{nullptr};
+    return head;
+  }
+
+  // Operator new only guarantees 16-byte alignment before C++17. Never freed,
+  // see Destroy.
+  static Slot* NewSlot() {
+    char* bytes = new char[sizeof(Slot) + alignof(Slot) - 1];
+    const uintptr_t address = reinterpret_cast<uintptr_t>(bytes);
+    const uintptr_t aligned =
+        (address + alignof(Slot) - 1) & ~uintptr_t{alignof(Slot) - 1};
+    return new (reinterpret_cast<void*>(aligned)) Slot();
+  }
+
+  // Aborts if there are none, see Reduce.
+  static std::vector<T*> NonNullThreads() {
+    std::vector<T*> threads = Threads();
+    threads.erase(std::remove_if(threads.begin(), threads.end(),
+                                 [](const T* t) { return t->IsNull(); }),
+                  threads.end());
+    if (threads.empty()) {
+      abort();
+    }
+    return threads;
+  }
 };
 
 }  // namespace highwayhash
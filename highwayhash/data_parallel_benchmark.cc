@@ -12,10 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <future>  //NOLINT
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "testing/base/public/gunit.h"
 #include "third_party/absl/container/btree_set.h"
@@ -23,11 +27,31 @@
 #include "third_party/absl/time/time.h"
 #include "highwayhash/arch_specific.h"
 #include "highwayhash/data_parallel.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/highwayhash_tree.h"
 #include "thread/threadpool.h"
 
 namespace highwayhash {
 namespace {
 
+// Incremented by the global operator new below.
+std::atomic<uint64_t> num_allocations{0};
+
+}  // namespace
+}  // namespace highwayhash
+
+// Counts allocations so that benchmarks can verify ThreadPool avoids them.
+void* operator new(size_t size) {
+  highwayhash::num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+
+namespace highwayhash {
+namespace {
+
 constexpr int kBenchmarkTasks = 1000000;
 
 // Returns elapsed time [nanoseconds] for std::async.
@@ -80,7 +104,7 @@ double BenchmarkPoolG(uint64_t* total) {
   std::atomic<uint64_t> sum2{0};
 
   {
-    ::ThreadPool pool(std::thread::hardware_concurrency());
+    ::ThreadPool pool(NumUsableCPUs());
     pool.StartWorkers();
     for (int i = 0; i < kBenchmarkTasks; ++i) {
       pool.Schedule([&sum1, &sum2, i]() {
@@ -114,10 +138,286 @@ TEST(DataParallelTest, Benchmarks) {
   EXPECT_EQ(sum2, sum3);
 }
 
+constexpr int kSkewedTasks = 20000;
+
+// Distributions of task costs.
+enum class Skew {
+  kUniform,
+  kFrontLoaded,  // the first tasks are 100x as expensive as the rest
+  kHeavyTailed   // rare tasks at pseudo-random indices are 1000x as expensive
+};
+
+const char* SkewName(const Skew skew) {
+  switch (skew) {
+    case Skew::kUniform:
+      return "uniform";
+    case Skew::kFrontLoaded:
+      return "front-loaded";
+    case Skew::kHeavyTailed:
+      return "heavy-tailed";
+  }
+  return "?";
+}
+
+// Busy-work whose cost depends on the task index; the result prevents the
+// computation from being elided.
+uint64_t SkewedTask(const int i, const Skew skew) {
+  int iterations = 200;
+  if (skew == Skew::kFrontLoaded && i < kSkewedTasks / 64) {
+    iterations *= 100;
+  }
+  if (skew == Skew::kHeavyTailed && ((i * 2654435761u) >> 22) == 0) {
+    iterations *= 1000;
+  }
+  uint64_t x = i + 1;
+  for (int rep = 0; rep < iterations; ++rep) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  return x >> 32;
+}
+
+// Returns elapsed time [nanoseconds] for std::async with skewed tasks.
+double BenchmarkSkewedAsync(const Skew skew, uint64_t* total) {
+  const absl::Time t0 = absl::Now();
+  std::atomic<uint64_t> sum{0};
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(kSkewedTasks);
+  for (int i = 0; i < kSkewedTasks; ++i) {
+    futures.push_back(std::async(
+        [&sum, skew](const int i) { sum.fetch_add(SkewedTask(i, skew)); },
+        i));
+  }
+
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  const absl::Time t1 = absl::Now();
+  *total = sum.load();
+  return absl::ToDoubleNanoseconds(t1 - t0);
+}
+
+// Returns elapsed time [nanoseconds] for ThreadPool with skewed tasks. The
+// pool is reused, hence not included in the measurement.
+double BenchmarkSkewedPool(ThreadPool* pool,
+                           const ThreadPool::Schedule schedule,
+                           const Skew skew, uint64_t* total) {
+  const absl::Time t0 = absl::Now();
+  std::atomic<uint64_t> sum{0};
+
+  pool->Run(0, kSkewedTasks,
+            [&sum, skew](const int i) { sum.fetch_add(SkewedTask(i, skew)); },
+            schedule);
+
+  const absl::Time t1 = absl::Now();
+  *total = sum.load();
+  return absl::ToDoubleNanoseconds(t1 - t0);
+}
+
+// Compares the guided and work-stealing schedules to std::async for tasks
+// of varying cost.
+TEST(DataParallelTest, BenchmarkSkewed) {
+  ThreadPool pool;
+  for (const Skew skew : {Skew::kUniform, Skew::kFrontLoaded,
+                          Skew::kHeavyTailed}) {
+    uint64_t sum1, sum2, sum3;
+    const double async_ns = BenchmarkSkewedAsync(skew, &sum1);
+    // Best of several repetitions to reduce noise from other processes.
+    double guided_ns = 1E30;
+    double stealing_ns = 1E30;
+    for (int rep = 0; rep < 5; ++rep) {
+      guided_ns = std::min(
+          guided_ns, BenchmarkSkewedPool(&pool, ThreadPool::Schedule::kGuided,
+                                         skew, &sum2));
+      stealing_ns = std::min(
+          stealing_ns,
+          BenchmarkSkewedPool(&pool, ThreadPool::Schedule::kWorkStealing, skew,
+                              &sum3));
+    }
+
+    printf("%-12s Async %11.0f ns Guided %11.0f ns Stealing %11.0f ns\n",
+           SkewName(skew), async_ns, guided_ns, stealing_ns);
+
+    // Should reach same result.
+    EXPECT_EQ(sum1, sum2);
+    EXPECT_EQ(sum2, sum3);
+  }
+}
+
+// Returns the median elapsed time [nanoseconds] of Run with one empty task per
+// worker, i.e. the fork-join overhead.
+double ForkJoinNanoseconds(ThreadPool* pool, const int num_threads) {
+  std::vector<double> elapsed;
+  for (int rep = 0; rep < 1001; ++rep) {
+    const absl::Time t0 = absl::Now();
+    pool->Run(0, num_threads, [](const int i) {});
+    const absl::Time t1 = absl::Now();
+    elapsed.push_back(absl::ToDoubleNanoseconds(t1 - t0));
+  }
+  std::nth_element(elapsed.begin(), elapsed.begin() + elapsed.size() / 2,
+                   elapsed.end());
+  return elapsed[elapsed.size() / 2];
+}
+
+// Returns the smallest power of two size for which hashing that many bytes,
+// split into one part per worker, is faster than hashing them serially, or
+// zero if there is none up to 16 MiB.
+size_t MinProfitableSize(ThreadPool* pool, const int num_threads) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  const HHKey key = {1, 2, 3, 4};
+  std::vector<char> in(16 << 20, 1);
+  for (size_t size = 1024; size <= in.size(); size *= 2) {
+    const size_t part = size / num_threads;
+    std::atomic<uint64_t> sum{0};
+    // Best of several repetitions to reduce noise from other processes.
+    double serial_ns = 1E30;
+    double parallel_ns = 1E30;
+    for (int rep = 0; rep < 21; ++rep) {
+      const absl::Time t0 = absl::Now();
+      HHResult64 hash;
+      functions.hash64(key, in.data(), size, &hash);
+      sum.fetch_add(hash);
+      const absl::Time t1 = absl::Now();
+      pool->Run(0, num_threads, [&functions, &key, &in, part, &sum](
+                                    const int i) {
+        HHResult64 hash;
+        functions.hash64(key, in.data() + i * part, part, &hash);
+        sum.fetch_add(hash);
+      });
+      const absl::Time t2 = absl::Now();
+      serial_ns = std::min(serial_ns, absl::ToDoubleNanoseconds(t1 - t0));
+      parallel_ns = std::min(parallel_ns, absl::ToDoubleNanoseconds(t2 - t1));
+    }
+    // (Ensure the hashing is not elided.)
+    EXPECT_NE(0, sum.load());
+    if (parallel_ns < serial_ns) return size;
+  }
+  return 0;
+}
+
+// Reports the fork-join overhead and the minimal input size for which
+// parallel hashing pays off, with and without spinning before blocking.
+TEST(DataParallelTest, BenchmarkForkJoin) {
+  const int num_threads = NumUsableCPUs();
+  ThreadPool pool(num_threads);
+  const int64_t default_spin_ns = ThreadPool::kDefaultSpinNanoseconds;
+  for (const int64_t spin_ns : {int64_t{0}, default_spin_ns}) {
+    pool.SetSpinNanoseconds(spin_ns);
+    const double fork_join_ns = ForkJoinNanoseconds(&pool, num_threads);
+    const size_t min_size = MinProfitableSize(&pool, num_threads);
+    printf("Spin %6lld ns: fork-join %8.0f ns, profitable from %zu bytes\n",
+           static_cast<long long>(spin_ns), fork_join_ns, min_size);
+  }
+}
+
+// Returns the median elapsed time [nanoseconds] of hashing one 1 KiB part per
+// worker via Run (with more captures than std::function stores inline) or
+// RunRanges, and stores the number of allocations per call.
+double SmallJobNanoseconds(ThreadPool* pool, const bool ranges,
+                           double* allocations) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  const HHKey key = {1, 2, 3, 4};
+  const int num_parts = pool->NumThreads();
+  const size_t part = 1024;
+  std::vector<char> in(num_parts * part, 1);
+  std::atomic<uint64_t> sum{0};
+  const char* bytes = in.data();
+
+  const int kReps = 1001;
+  std::vector<double> elapsed;
+  elapsed.reserve(kReps);
+  const uint64_t allocations_before = num_allocations.load();
+  for (int rep = 0; rep < kReps; ++rep) {
+    const absl::Time t0 = absl::Now();
+    if (ranges) {
+      pool->RunRanges(0, num_parts, [&functions, &key, bytes, part, &sum](
+                                        const int, const uint32_t begin,
+                                        const uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+          HHResult64 hash;
+          functions.hash64(key, bytes + i * part, part, &hash);
+          sum.fetch_add(hash);
+        }
+      });
+    } else {
+      pool->Run(0, num_parts, [&functions, &key, bytes, part, &sum](
+                                  const int i) {
+        HHResult64 hash;
+        functions.hash64(key, bytes + i * part, part, &hash);
+        sum.fetch_add(hash);
+      });
+    }
+    const absl::Time t1 = absl::Now();
+    elapsed.push_back(absl::ToDoubleNanoseconds(t1 - t0));
+  }
+  const uint64_t allocations_after = num_allocations.load();
+  *allocations =
+      static_cast<double>(allocations_after - allocations_before) / kReps;
+  EXPECT_NE(0, sum.load());
+
+  std::nth_element(elapsed.begin(), elapsed.begin() + elapsed.size() / 2,
+                   elapsed.end());
+  return elapsed[elapsed.size() / 2];
+}
+
+// Reports the cost of frequent small parallel hashing jobs, which must not
+// allocate.
+TEST(DataParallelTest, BenchmarkSmallJobs) {
+  ThreadPool pool;
+  for (const bool ranges : {false, true}) {
+    double allocations;
+    const double ns = SmallJobNanoseconds(&pool, ranges, &allocations);
+    printf("Small jobs %-9s %8.0f ns, %.2f allocations per call\n",
+           ranges ? "RunRanges" : "Run", ns, allocations);
+    EXPECT_EQ(0.0, allocations);
+  }
+}
+
+// Reports HighwayTreeHash throughput for increasing numbers of threads.
+TEST(DataParallelTest, BenchmarkTreeHash) {
+  const HHKey key = {1, 2, 3, 4};
+  const size_t size = 1ULL << 30;
+  std::vector<char> in(size);
+  for (size_t i = 0; i < size; ++i) {
+    in[i] = static_cast<char>(i);
+  }
+
+  HHResult256 serial;
+  HighwayTreeHash(key, in.data(), size, nullptr, &serial);
+
+  const std::pair<ThreadPool::Placement, const char*> placements[3] = {
+      {ThreadPool::Placement::kNone, "unpinned"},
+      {ThreadPool::Placement::kCores, "cores"},
+      {ThreadPool::Placement::kNodes, "nodes"}};
+  for (const auto& placement : placements) {
+    for (int num_threads = 1;
+         num_threads <= NumUsableCPUs(); num_threads *= 2) {
+      ThreadPool pool(num_threads, placement.first);
+      HHResult256 hash;
+      // Best of several repetitions to reduce noise from other processes.
+      double min_ns = 1E30;
+      for (int rep = 0; rep < 5; ++rep) {
+        const absl::Time t0 = absl::Now();
+        HighwayTreeHash(key, in.data(), size, &pool, &hash);
+        const absl::Time t1 = absl::Now();
+        min_ns = std::min(min_ns, absl::ToDoubleNanoseconds(t1 - t0));
+      }
+      printf("TreeHash %-8s %3d threads: %6.2f GB/s\n", placement.second,
+             num_threads, size / min_ns);
+
+      // Must not depend on the number of threads or their placement.
+      for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(serial[i], hash[i]);
+      }
+    }
+  }
+}
+
 #if HH_ARCH_X64
 // Ensures multiple hardware threads are used (decided by the OS scheduler).
 TEST(DataParallelTest, TestApicIds) {
-  for (int num_threads = 1; num_threads <= std::thread::hardware_concurrency();
+  for (int num_threads = 1; num_threads <= NumUsableCPUs();
        ++num_threads) {
     ThreadPool pool(num_threads);
 
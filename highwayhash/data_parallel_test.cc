@@ -13,10 +13,14 @@
 // limitations under the License.
 
 #include <unistd.h>
+#include <atomic>
 #include <cstdint>
+#include <thread>  //NOLINT
+#include <vector>
 
 #include "testing/base/public/gunit.h"
 #include "highwayhash/data_parallel.h"
+#include "highwayhash/pipeline.h"
 
 namespace highwayhash {
 namespace {
@@ -109,6 +113,98 @@ TEST(DataParallelTest, TestRunRanges) {
   }
 }
 
+// Ensures every task of concurrent Submit calls from several threads runs
+// exactly once, also while Run is busy, and that Done/Wait report completion.
+TEST(DataParallelTest, TestSubmit) {
+  for (int num_threads = 1; num_threads <= 8; ++num_threads) {
+    ThreadPool pool(num_threads);
+    std::vector<std::thread> submitters;
+    for (int submitter = 0; submitter < 4; ++submitter) {
+      submitters.emplace_back([&pool, submitter]() {
+        for (int rep = 0; rep < 100; ++rep) {
+          const int num_tasks = (rep * 7 + submitter) % 50;
+          std::vector<std::atomic<int>> counts(num_tasks);
+          for (std::atomic<int>& count : counts) {
+            count.store(0);
+          }
+          const ThreadPool::Handle handle = pool.Submit(
+              0, num_tasks, [&counts](const int i) { counts[i].fetch_add(1); });
+          if (rep & 1) {
+            while (!handle.Done()) {
+            }
+          } else {
+            handle.Wait();
+          }
+          for (const std::atomic<int>& count : counts) {
+            EXPECT_EQ(1, count.load());
+          }
+        }
+      });
+    }
+
+    for (int rep = 0; rep < 50; ++rep) {
+      std::vector<std::atomic<int>> counts(37);
+      for (std::atomic<int>& count : counts) {
+        count.store(0);
+      }
+      pool.Run(0, 37, [&counts](const int i) { counts[i].fetch_add(1); });
+      for (const std::atomic<int>& count : counts) {
+        EXPECT_EQ(1, count.load());
+      }
+    }
+
+    for (std::thread& submitter : submitters) {
+      submitter.join();
+    }
+  }
+}
+
+// Same as TestRunRanges, for each placement and with ranges on several
+// (possibly nonexistent) nodes.
+TEST(DataParallelTest, TestRunRangesOnNodes) {
+  for (const ThreadPool::Placement placement :
+       {ThreadPool::Placement::kNone, ThreadPool::Placement::kCores,
+        ThreadPool::Placement::kNodes}) {
+    for (int num_threads = 1; num_threads <= 6; ++num_threads) {
+      ThreadPool pool(num_threads, placement);
+      for (int num_tasks = 0; num_tasks < 300; num_tasks += 7) {
+        std::vector<int> mementos(num_tasks, 0);
+        const int begin = 3;
+        pool.RunRangesOnNodes(
+            begin, begin + num_tasks,
+            [](const uint32_t i) { return static_cast<int>(i % 3) - 1; },
+            [begin, num_tasks, &mementos](const int chunk,
+                                          const uint32_t my_begin,
+                                          const uint32_t my_end) {
+              for (uint32_t i = my_begin; i < my_end; ++i) {
+                // Parameter is in the given range
+                EXPECT_GE(i, begin);
+                EXPECT_LT(i, begin + num_tasks);
+
+                // Store mementos to be sure we visited each i.
+                mementos.at(i - begin) = 1000 + i;
+              }
+            });
+        for (int i = begin; i < begin + num_tasks; ++i) {
+          EXPECT_EQ(1000 + i, mementos.at(i - begin));
+        }
+      }
+    }
+  }
+}
+
+// The default number of threads respects the affinity mask and CPU quota.
+TEST(DataParallelTest, TestNumUsableCPUs) {
+  const int num_cpus = NumUsableCPUs();
+  EXPECT_GE(num_cpus, 1);
+  EXPECT_LE(num_cpus, static_cast<int>(AvailableCPUs().size()));
+  const double quota = CPUQuota();
+  EXPECT_GE(quota, 0.0);
+  if (quota >= 1.0) {
+    EXPECT_LE(num_cpus, quota);
+  }
+}
+
 // Ensures each of N threads processes exactly 1 of N tasks, i.e. the
 // work distribution is perfectly fair for small counts.
 TEST(DataParallelTest, TestSmallAssignments) {
@@ -171,5 +267,133 @@ TEST(DataParallelTest, TestPerThread) {
   }
 }
 
+// Test payload for PerThread::Reduce(pool).
+struct Counter {
+  bool IsNull() const { return count == 0; }
+  void Destroy() { count = 0; }
+  void Assimilate(const Counter& victim) { count += victim.count; }
+
+  uint64_t count = 0;
+};
+
+// Many threads register concurrently, each copy has its own cache line, and
+// the parallel reduction matches the serial one.
+TEST(DataParallelTest, TestPerThreadManyThreads) {
+  const int kNumThreads = 200;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([i]() {
+      Counter& counter = PerThread<Counter>::Get();
+      EXPECT_EQ(0, reinterpret_cast<uintptr_t>(&counter) % 64);
+      counter.count += i + 1;
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(kNumThreads, PerThread<Counter>::Threads().size());
+
+  const uint64_t expected = kNumThreads * (kNumThreads + 1) / 2;
+  ThreadPool pool(4);
+  EXPECT_EQ(expected, PerThread<Counter>::Reduce(&pool).count);
+
+  // Reduce modified the first copy, so start over.
+  PerThread<Counter>::Destroy();
+  PerThread<Counter>::Threads()[5]->count = 6;
+  PerThread<Counter>::Threads()[9]->count = 10;
+  EXPECT_EQ(16, PerThread<Counter>::Reduce(&pool).count);
+  PerThread<Counter>::Destroy();
+  PerThread<Counter>::Threads()[7]->count = 8;
+  EXPECT_EQ(8, PerThread<Counter>::Reduce().count);
+}
+
+// Several producers and consumers receive each element exactly once, and a
+// single producer and consumer preserve the order.
+TEST(DataParallelTest, TestBoundedQueue) {
+  BoundedQueue<int> queue(5);
+  EXPECT_EQ(8, queue.Capacity());
+  for (int i = 0; i < 8; ++i) {
+    int value = i;
+    EXPECT_TRUE(queue.TryPush(&value));
+  }
+  int value = 8;
+  EXPECT_FALSE(queue.TryPush(&value));
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(queue.TryPop(&value));
+
+  const int kNumValues = 100000;
+  for (const int num_threads : {1, 3}) {
+    BoundedQueue<int> shared(16);
+    std::vector<std::atomic<int>> counts(kNumValues);
+    std::vector<std::thread> threads;
+    std::atomic<int> num_producers{num_threads};
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&shared, &num_producers, t, num_threads]() {
+        for (int i = t; i < kNumValues; i += num_threads) {
+          EXPECT_TRUE(shared.Push(i));
+        }
+        if (num_producers.fetch_sub(1) == 1) shared.Close();
+      });
+      threads.emplace_back([&shared, &counts, num_threads]() {
+        int previous = -1;
+        int value;
+        while (shared.Pop(&value)) {
+          counts[value].fetch_add(1);
+          if (num_threads == 1) {
+            EXPECT_LT(previous, value);
+            previous = value;
+          }
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    for (int i = 0; i < kNumValues; ++i) {
+      EXPECT_EQ(1, counts[i].load());
+    }
+  }
+}
+
+// A pipeline with a multi-worker stage processes all elements, and closing
+// each stage's output shuts down the next.
+TEST(DataParallelTest, TestPipeline) {
+  const int kNumValues = 10000;
+  ThreadPool pool(4);
+  BoundedQueue<int> generated(8);
+  BoundedQueue<int> squared(8);
+  std::atomic<int> num_squarings{0};
+  int64_t sum = 0;
+  Pipeline pipeline(&pool);
+  pipeline.AddStage(1, [&generated](int) {
+    for (int i = 0; i < kNumValues; ++i) {
+      generated.Push(i);
+    }
+  }, &generated);
+  pipeline.AddStage(3, [&generated, &squared, &num_squarings](int worker) {
+    EXPECT_LT(worker, 3);
+    int value;
+    while (generated.Pop(&value)) {
+      num_squarings.fetch_add(1);
+      squared.Push(value * value);
+    }
+  }, &squared);
+  pipeline.AddStage(1, [&squared, &sum](int) {
+    int value;
+    while (squared.Pop(&value)) sum += value;
+  });
+  pipeline.Run();
+
+  EXPECT_EQ(kNumValues, num_squarings.load());
+  int64_t expected = 0;
+  for (int64_t i = 0; i < kNumValues; ++i) {
+    expected += i * i;
+  }
+  EXPECT_EQ(expected, sum);
+}
+
 }  // namespace
 }  // namespace highwayhash
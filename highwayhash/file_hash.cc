@@ -0,0 +1,470 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/file_hash.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <condition_variable>  //NOLINT
+#include <cstdio>
+#include <mutex>  //NOLINT
+#include <thread>  //NOLINT
+#include <vector>
+
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/highwayhash_tree.h"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define OS_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define OS_POSIX 0
+#endif
+
+namespace highwayhash {
+namespace {
+
+// Overloads for the exact HighwayHashFunctions member for each Result.
+void CatFinish(const HighwayHashFunctions& functions,
+               const HighwayHashCatStorage* cat, HHResult64* hash) {
+  functions.cat_finish64(cat, hash);
+}
+void CatFinish(const HighwayHashFunctions& functions,
+               const HighwayHashCatStorage* cat, HHResult128* hash) {
+  functions.cat_finish128(cat, hash);
+}
+void CatFinish(const HighwayHashFunctions& functions,
+               const HighwayHashCatStorage* cat, HHResult256* hash) {
+  functions.cat_finish256(cat, hash);
+}
+
+#if OS_POSIX
+
+// Closes the file descriptor when leaving the scope.
+class ScopedFd {
+ public:
+  explicit ScopedFd(const int fd) : fd_(fd) {}
+  ScopedFd(const ScopedFd&) = delete;
+  ScopedFd& operator=(const ScopedFd&) = delete;
+  ~ScopedFd() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  int get() const { return fd_; }
+
+ private:
+  const int fd_;
+};
+
+// Returns the read-only mapping of [offset, offset + size) within "fd", or
+// nullptr on failure. "offset" must be a multiple of the page size.
+const char* MapWindow(const int fd, const uint64_t offset, const size_t size) {
+  void* const mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd,
+                            static_cast<off_t>(offset));
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  // Hints only; failure is harmless. MADV_SEQUENTIAL allows the OS to read
+  // ahead aggressively and reclaim pages soon after we have hashed them.
+  // MADV_WILLNEED starts reading the window before we get to it.
+  (void)madvise(mapped, size, MADV_SEQUENTIAL);
+  (void)madvise(mapped, size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  // Only has an effect for file mappings if the kernel supports read-only
+  // transparent huge pages for the file system; reduces TLB misses.
+  (void)madvise(mapped, size, MADV_HUGEPAGE);
+#endif
+  return static_cast<const char*>(mapped);
+}
+
+void UnmapWindow(const char* window, const size_t size) {
+  (void)munmap(const_cast<char*>(window), size);
+}
+
+// Calls "func" for consecutive (non-empty) parts of the file read via read().
+template <class Func>
+bool ForEachBuffer(const int fd, const Func& func) {
+  std::vector<char> buffer(kFileHashWindowSize);
+  for (;;) {
+    ssize_t bytes_read;
+    do {
+      bytes_read = read(fd, buffer.data(), buffer.size());
+    } while (bytes_read < 0 && errno == EINTR);
+    if (bytes_read < 0) {
+      return false;
+    }
+    if (bytes_read == 0) {
+      return true;
+    }
+    func(buffer.data(), static_cast<size_t>(bytes_read));
+  }
+}
+
+// Calls "func" for consecutive (non-empty) parts of the file at "path".
+// At most two windows are mapped at a time.
+template <class Func>
+bool ForEachWindow(const char* path, const Func& func) {
+  const ScopedFd fd(open(path, O_RDONLY));
+  if (fd.get() < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd.get(), &info) != 0) {
+    return false;
+  }
+  if (!S_ISREG(info.st_mode)) {
+    return ForEachBuffer(fd.get(), func);
+  }
+
+  const uint64_t file_size = static_cast<uint64_t>(info.st_size);
+  uint64_t offset = 0;
+  size_t size = std::min<uint64_t>(file_size, kFileHashWindowSize);
+  const char* window = size == 0 ? nullptr : MapWindow(fd.get(), 0, size);
+  if (size != 0 && window == nullptr) {
+    return false;
+  }
+  while (size != 0) {
+    // Map (and prefetch) the next window before hashing the current one.
+    const uint64_t next_offset = offset + size;
+    const size_t next_size =
+        std::min<uint64_t>(file_size - next_offset, kFileHashWindowSize);
+    const char* next = nullptr;
+    if (next_size != 0) {
+      next = MapWindow(fd.get(), next_offset, next_size);
+      if (next == nullptr) {
+        UnmapWindow(window, size);
+        return false;
+      }
+    }
+
+    func(window, size);
+    UnmapWindow(window, size);
+
+    window = next;
+    offset = next_offset;
+    size = next_size;
+  }
+  return true;
+}
+
+// Calls func(bytes, size) once with the entire contents of the file.
+template <class Func>
+bool WithEntireFile(const char* path, const Func& func) {
+  const ScopedFd fd(open(path, O_RDONLY));
+  if (fd.get() < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd.get(), &info) != 0) {
+    return false;
+  }
+  // Larger files cannot be mapped, e.g. in 32-bit builds.
+  if (static_cast<uint64_t>(info.st_size) > SIZE_MAX) {
+    errno = EFBIG;
+    return false;
+  }
+  const size_t size = static_cast<size_t>(info.st_size);
+  if (!S_ISREG(info.st_mode) || size == 0) {
+    std::vector<char> contents;
+    const bool ok = ForEachBuffer(
+        fd.get(), [&contents](const char* bytes, const size_t num_bytes) {
+          contents.insert(contents.end(), bytes, bytes + num_bytes);
+        });
+    if (ok) {
+      func(contents.data(), contents.size());
+    }
+    return ok;
+  }
+
+  const char* mapped = MapWindow(fd.get(), 0, size);
+  if (mapped == nullptr) {
+    return false;
+  }
+  func(mapped, size);
+  UnmapWindow(mapped, size);
+  return true;
+}
+
+// Returns elapsed time [seconds] since an arbitrary point.
+double Seconds() {
+  using Clock = std::chrono::steady_clock;
+  return std::chrono::duration<double>(Clock::now().time_since_epoch())
+      .count();
+}
+
+// Ring of buffers filled by a reader thread and consumed (in order) by the
+// thread that calls Consume.
+class StreamBuffers {
+ public:
+  explicit StreamBuffers(const int fd)
+      : fd_(fd),
+        storage_(kStreamHashNumBuffers * kStreamHashBufferSize +
+                 kStreamHashAlignment) {
+    const uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+    const uintptr_t aligned =
+        (address + kStreamHashAlignment - 1) & ~(kStreamHashAlignment - 1);
+    buffers_ = storage_.data() + (aligned - address);
+    reader_ = std::thread(&StreamBuffers::ReadAll, this);
+  }
+
+  StreamBuffers(const StreamBuffers&) = delete;
+  StreamBuffers& operator=(const StreamBuffers&) = delete;
+
+  ~StreamBuffers() { reader_.join(); }
+
+  // Calls func(bytes, size) for each buffer in order until end of file or a
+  // read error. Returns false and sets errno in the latter case.
+  template <class Func>
+  bool Consume(const Func& func, StreamHashStats* stats) {
+    for (size_t i = 0;; i = (i + 1) % kStreamHashNumBuffers) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const double t0 = Seconds();
+      filled_cv_.wait(lock, [this]() { return num_filled_ != 0 || done_; });
+      stats->hash_stall_seconds += Seconds() - t0;
+      if (num_filled_ == 0) {
+        stats->read_stall_seconds = read_stall_seconds_;
+        if (error_ != 0) {
+          errno = error_;
+          return false;
+        }
+        return true;
+      }
+      lock.unlock();
+
+      func(buffers_ + i * kStreamHashBufferSize, sizes_[i]);
+      stats->bytes += sizes_[i];
+
+      lock.lock();
+      --num_filled_;
+      lock.unlock();
+      free_cv_.notify_one();
+    }
+  }
+
+ private:
+  // Reader thread: fills buffers until end of file or error.
+  void ReadAll() {
+    for (size_t i = 0;; i = (i + 1) % kStreamHashNumBuffers) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const double t0 = Seconds();
+        free_cv_.wait(lock,
+                      [this]() { return num_filled_ < kStreamHashNumBuffers; });
+        read_stall_seconds_ += Seconds() - t0;
+      }
+
+      ssize_t bytes_read;
+      do {
+        bytes_read = read(fd_, buffers_ + i * kStreamHashBufferSize,
+                          kStreamHashBufferSize);
+      } while (bytes_read < 0 && errno == EINTR);
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (bytes_read <= 0) {
+        error_ = bytes_read < 0 ? errno : 0;
+        done_ = true;
+        lock.unlock();
+        filled_cv_.notify_one();
+        return;
+      }
+      sizes_[i] = static_cast<size_t>(bytes_read);
+      ++num_filled_;
+      lock.unlock();
+      filled_cv_.notify_one();
+    }
+  }
+
+  const int fd_;
+  std::vector<char> storage_;
+  char* buffers_;  // kStreamHashNumBuffers, aligned.
+  size_t sizes_[kStreamHashNumBuffers];
+
+  std::mutex mutex_;  // guards all below.
+  std::condition_variable filled_cv_;
+  std::condition_variable free_cv_;
+  size_t num_filled_ = 0;
+  bool done_ = false;
+  int error_ = 0;
+  double read_stall_seconds_ = 0.0;
+
+  std::thread reader_;
+};
+
+template <typename Result>
+bool HashStream(const HHKey& key, const int fd, Result* hash,
+                StreamHashStats* stats) {
+  StreamHashStats unused_stats;
+  if (stats == nullptr) {
+    stats = &unused_stats;
+  }
+  *stats = StreamHashStats();
+  const double t0 = Seconds();
+
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  HighwayHashCatStorage cat;
+  functions.cat_start(key, &cat);
+  bool ok;
+  {
+    StreamBuffers buffers(fd);
+    ok = buffers.Consume(
+        [&functions, &cat](const char* bytes, const size_t size) {
+          functions.cat_append(&cat, bytes, size);
+        },
+        stats);
+  }
+  if (ok) {
+    CatFinish(functions, &cat, hash);
+  }
+
+  stats->seconds = Seconds() - t0;
+  return ok;
+}
+
+#else  // !OS_POSIX
+
+template <typename Result>
+bool HashStream(const HHKey& key, const int fd, Result* hash,
+                StreamHashStats* stats) {
+  errno = ENOSYS;
+  return false;
+}
+
+// Closes the file when leaving the scope.
+class ScopedFile {
+ public:
+  explicit ScopedFile(FILE* file) : file_(file) {}
+  ScopedFile(const ScopedFile&) = delete;
+  ScopedFile& operator=(const ScopedFile&) = delete;
+  ~ScopedFile() {
+    if (file_ != nullptr) {
+      fclose(file_);
+    }
+  }
+
+  FILE* get() const { return file_; }
+
+ private:
+  FILE* const file_;
+};
+
+template <class Func>
+bool ForEachWindow(const char* path, const Func& func) {
+  const ScopedFile file(fopen(path, "rb"));
+  if (file.get() == nullptr) {
+    return false;
+  }
+  std::vector<char> buffer(kFileHashWindowSize);
+  for (;;) {
+    const size_t bytes_read =
+        fread(buffer.data(), 1, buffer.size(), file.get());
+    if (bytes_read != 0) {
+      func(buffer.data(), bytes_read);
+    }
+    if (bytes_read != buffer.size()) {
+      return ferror(file.get()) == 0;
+    }
+  }
+}
+
+template <class Func>
+bool WithEntireFile(const char* path, const Func& func) {
+  std::vector<char> contents;
+  const bool ok =
+      ForEachWindow(path, [&contents](const char* bytes, const size_t size) {
+        contents.insert(contents.end(), bytes, bytes + size);
+      });
+  if (ok) {
+    func(contents.data(), contents.size());
+  }
+  return ok;
+}
+
+#endif  // OS_POSIX
+
+template <typename Result>
+bool HashFile(const HHKey& key, const char* path, Result* hash) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  HighwayHashCatStorage cat;
+  functions.cat_start(key, &cat);
+  const bool ok = ForEachWindow(
+      path, [&functions, &cat](const char* bytes, const size_t size) {
+        functions.cat_append(&cat, bytes, size);
+      });
+  if (ok) {
+    CatFinish(functions, &cat, hash);
+  }
+  return ok;
+}
+
+template <typename Result>
+bool TreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                  Result* hash) {
+  return WithEntireFile(
+      path, [&key, pool, hash](const char* bytes, const size_t size) {
+        HighwayTreeHash(key, bytes, size, pool, hash);
+      });
+}
+
+}  // namespace
+
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult64* hash,
+                       StreamHashStats* stats) {
+  return HashStream(key, fd, hash, stats);
+}
+
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult128* hash,
+                       StreamHashStats* stats) {
+  return HashStream(key, fd, hash, stats);
+}
+
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult256* hash,
+                       StreamHashStats* stats) {
+  return HashStream(key, fd, hash, stats);
+}
+
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult64* hash) {
+  return HashFile(key, path, hash);
+}
+
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult128* hash) {
+  return HashFile(key, path, hash);
+}
+
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult256* hash) {
+  return HashFile(key, path, hash);
+}
+
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult64* hash) {
+  return TreeHashFile(key, path, pool, hash);
+}
+
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult128* hash) {
+  return TreeHashFile(key, path, pool, hash);
+}
+
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult256* hash) {
+  return TreeHashFile(key, path, pool, hash);
+}
+
+}  // namespace highwayhash
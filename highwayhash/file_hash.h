@@ -0,0 +1,97 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_FILE_HASH_H_
+#define HIGHWAYHASH_FILE_HASH_H_
+
+// Hashes files and other file descriptors while overlapping I/O and hashing.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/hh_types.h"
+
+namespace highwayhash {
+
+class ThreadPool;  // data_parallel.h
+
+// Files are mapped (and unmapped after hashing) in windows of this many bytes,
+// so the resident size stays bounded regardless of the file size. A multiple
+// of the page and huge page sizes.
+static constexpr size_t kFileHashWindowSize = 16 << 20;
+
+// Stores a 64/128/256 bit hash of the contents of the file at "path" in
+// "hash". The result is identical to HighwayHash of the contents. Returns
+// false (and leaves "hash" unchanged) if the file cannot be opened or read;
+// errno then indicates the reason.
+//
+// On POSIX systems, regular files are memory-mapped with sequential-access
+// hints, and the next window is prefetched while the current one is hashed.
+// Other files (e.g. pipes) and platforms fall back to reading into a buffer.
+// Truncating the file while it is being hashed may raise SIGBUS.
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult64* hash);
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult128* hash);
+bool HighwayHashFile(const HHKey& key, const char* path, HHResult256* hash);
+
+// As above, but the result is identical to HighwayTreeHash (highwayhash_tree.h)
+// of the contents, computed using "pool" (if not null). The entire file is
+// mapped at once because its leaves are hashed in parallel; its pages can
+// still be reclaimed by the OS because they are not modified.
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult64* hash);
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult128* hash);
+bool HighwayTreeHashFile(const HHKey& key, const char* path, ThreadPool* pool,
+                         HHResult256* hash);
+
+// Size and number of the buffers used by HighwayHashStream. Buffers are
+// aligned to kStreamHashAlignment, which also satisfies O_DIRECT.
+static constexpr size_t kStreamHashBufferSize = 1 << 20;
+static constexpr size_t kStreamHashNumBuffers = 4;
+static constexpr size_t kStreamHashAlignment = 4096;
+
+// Optional output of HighwayHashStream for telling whether hashing is limited
+// by I/O or by the hash.
+struct StreamHashStats {
+  double BytesPerSecond() const {
+    return seconds == 0.0 ? 0.0 : bytes / seconds;
+  }
+
+  uint64_t bytes = 0;    // hashed
+  double seconds = 0.0;  // total elapsed time
+  // Time the hashing thread waited for data: mostly nonzero => I/O-bound.
+  double hash_stall_seconds = 0.0;
+  // Time the reading thread waited for a free buffer: nonzero => hash-bound.
+  double read_stall_seconds = 0.0;
+};
+
+// Stores a 64/128/256 bit hash of all bytes read from "fd" until end of file
+// in "hash". The result is identical to HighwayHash of those bytes. Returns
+// false (and leaves "hash" unchanged) if a read fails; errno then indicates
+// the reason. Does not close "fd".
+//
+// For pipes, sockets and devices that cannot be mapped (otherwise prefer
+// HighwayHashFile). A reader thread fills up to kStreamHashNumBuffers
+// buffers ahead while the calling thread hashes the completed buffers in
+// order, so that I/O and hashing overlap. POSIX only; elsewhere, returns false.
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult64* hash,
+                       StreamHashStats* stats = nullptr);
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult128* hash,
+                       StreamHashStats* stats = nullptr);
+bool HighwayHashStream(const HHKey& key, const int fd, HHResult256* hash,
+                       StreamHashStats* stats = nullptr);
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_FILE_HASH_H_
@@ -0,0 +1,338 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/fingerprint_index.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "highwayhash/hasher.h"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define OS_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define OS_POSIX 0
+#endif
+
+namespace highwayhash {
+
+// Entries for bucket 0 of an empty index.
+const uint64_t FingerprintIndex::kEmptyDirectory[2] = {0, 0};
+
+namespace {
+
+// Larger indexes would not fit in memory anyway.
+constexpr uint32_t kMaxBucketBits = 48;
+
+// Offsets of the directory and fingerprints within the file.
+struct Layout {
+  explicit Layout(const uint32_t bucket_bits, const uint64_t num_fingerprints)
+      : directory(sizeof(FingerprintIndexHeader)),
+        fingerprints((directory + ((1ull << bucket_bits) + 1) * 8 + 63) &
+                     ~uint64_t(63)),
+        size(fingerprints + num_fingerprints * sizeof(HHResult128)) {}
+
+  uint64_t directory;
+  uint64_t fingerprints;
+  uint64_t size;  // of the file
+};
+
+// Returns the number of bucket bits for "num_fingerprints".
+uint32_t BucketBits(const uint64_t num_fingerprints) {
+  uint32_t bits = 0;
+  while ((num_fingerprints >> bits) > kFingerprintsPerBucket &&
+         bits < kMaxBucketBits) {
+    ++bits;
+  }
+  return bits;
+}
+
+}  // namespace
+
+FingerprintIndex::FingerprintIndex(FingerprintIndex&& other) {
+  *this = std::move(other);
+}
+
+FingerprintIndex& FingerprintIndex::operator=(FingerprintIndex&& other) {
+  if (this != &other) {
+    Close();
+    directory_ = other.directory_;
+    fingerprints_ = other.fingerprints_;
+    num_fingerprints_ = other.num_fingerprints_;
+    bucket_bits_ = other.bucket_bits_;
+    mapping_ = other.mapping_;
+    mapping_size_ = other.mapping_size_;
+    other.mapping_ = nullptr;
+    other.Close();
+  }
+  return *this;
+}
+
+FingerprintIndex::~FingerprintIndex() { Close(); }
+
+void FingerprintIndex::Close() {
+#if OS_POSIX
+  if (mapping_ != nullptr) {
+    (void)munmap(mapping_, mapping_size_);
+  }
+#endif
+  directory_ = kEmptyDirectory;
+  fingerprints_ = nullptr;
+  num_fingerprints_ = 0;
+  bucket_bits_ = 0;
+  mapping_ = nullptr;
+  mapping_size_ = 0;
+}
+
+bool FingerprintIndex::Open(const char* path) {
+  Close();
+#if OS_POSIX
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return false;
+  }
+  const uint64_t file_size = static_cast<uint64_t>(info.st_size);
+  if (file_size < sizeof(FingerprintIndexHeader)) {
+    close(fd);
+    errno = EINVAL;
+    return false;
+  }
+  void* mapped = mmap(nullptr, static_cast<size_t>(file_size), PROT_READ,
+                      MAP_SHARED, fd, 0);
+  const int error = errno;
+  close(fd);  // The mapping remains valid.
+  if (mapped == MAP_FAILED) {
+    errno = error;
+    return false;
+  }
+  // Hint only: lookups are random, so reading ahead would waste I/O.
+  (void)madvise(mapped, static_cast<size_t>(file_size), MADV_RANDOM);
+  mapping_ = mapped;
+  mapping_size_ = static_cast<size_t>(file_size);
+
+  FingerprintIndexHeader header;
+  memcpy(&header, mapped, sizeof(header));
+  const char* bytes = static_cast<const char*>(mapped);
+  if (header.magic != kFingerprintIndexMagic ||
+      header.version != kFingerprintIndexVersion ||
+      header.bucket_bits > kMaxBucketBits ||
+      header.num_fingerprints > file_size / sizeof(HHResult128)) {
+    Close();
+    errno = EINVAL;
+    return false;
+  }
+  const Layout layout(header.bucket_bits, header.num_fingerprints);
+  const uint64_t* directory =
+      reinterpret_cast<const uint64_t*>(bytes + layout.directory);
+  const uint64_t num_buckets = 1ull << header.bucket_bits;
+  if (layout.size != file_size || directory[0] != 0 ||
+      directory[num_buckets] != header.num_fingerprints) {
+    Close();
+    errno = EINVAL;
+    return false;
+  }
+  directory_ = directory;
+  fingerprints_ =
+      reinterpret_cast<const uint64_t*>(bytes + layout.fingerprints);
+  num_fingerprints_ = header.num_fingerprints;
+  bucket_bits_ = header.bucket_bits;
+  return true;
+#else
+  (void)path;
+  errno = ENOSYS;
+  return false;
+#endif
+}
+
+void FingerprintIndex::ContainsBatch(
+    const HHResult128* HH_RESTRICT fingerprints, const size_t num,
+    bool* HH_RESTRICT found) const {
+  // Software pipeline: while fingerprint i prefetches its directory entry,
+  // i - kDistance (whose entry has arrived by now) prefetches the first and
+  // last cache line of its bucket, and i - 2 * kDistance searches its bucket.
+  constexpr size_t kDistance = kMaxPrefetchKeys;
+  constexpr size_t kRing = 2 * kDistance;  // > kDistance, power of two
+  uint64_t buckets[kRing];
+  uint64_t begin[kRing];
+  uint64_t end[kRing];
+  for (size_t i = 0; i < num + 2 * kDistance; ++i) {
+    if (i < num) {
+      buckets[i % kRing] = Bucket(fingerprints[i][1]);
+      HH_PREFETCH(directory_ + buckets[i % kRing]);
+    }
+    const size_t prefetch = i - kDistance;  // wraps around if i < kDistance
+    if (prefetch < num) {
+      const size_t r = prefetch % kRing;
+      begin[r] = BucketBegin(buckets[r], &end[r]);
+      if (begin[r] < end[r]) {
+        HH_PREFETCH(fingerprints_ + 2 * begin[r]);
+        HH_PREFETCH(fingerprints_ + 2 * end[r] - 1);
+      }
+    }
+    const size_t search = i - 2 * kDistance;
+    if (search < num) {
+      const size_t r = search % kRing;
+      const HHResult128& fingerprint = fingerprints[search];
+      bool is_found = false;
+      for (uint64_t pos = begin[r]; pos < end[r]; ++pos) {
+        const uint64_t* HH_RESTRICT entry = fingerprints_ + 2 * pos;
+        is_found |= entry[1] == fingerprint[1] && entry[0] == fingerprint[0];
+      }
+      found[search] = is_found;
+    }
+  }
+}
+
+#if OS_POSIX
+namespace {
+
+// Calls "func" for each fingerprint of "base" (sorted and unique) and
+// "added" (sorted) in sorted order, skipping duplicates.
+template <class Entry, class Func>
+void Merge(const FingerprintIndex* base, const std::vector<Entry>& added,
+           const Func& func) {
+  const auto less = [](const uint64_t* a, const uint64_t* b) {
+    return a[1] < b[1] || (a[1] == b[1] && a[0] < b[0]);
+  };
+  const bool has_old = base != nullptr && base->size() != 0;
+  const uint64_t* old = has_old ? base->data()[0] : nullptr;
+  const uint64_t* old_end = has_old ? old + 2 * base->size() : nullptr;
+  const uint64_t* previous = nullptr;
+  size_t i = 0;
+  while (old != old_end || i != added.size()) {
+    const uint64_t* next;
+    if (i == added.size() ||
+        (old != old_end && !less(added[i].words, old))) {
+      next = old;
+      old += 2;
+    } else {
+      next = added[i].words;
+      ++i;
+    }
+    if (previous == nullptr || less(previous, next)) {
+      func(next);
+      previous = next;
+    }
+  }
+}
+
+}  // namespace
+#endif
+
+bool FingerprintIndexBuilder::Write(const FingerprintIndex* base,
+                                    const char* path) {
+#if OS_POSIX
+  std::sort(added_.begin(), added_.end(), [](const Entry& a, const Entry& b) {
+    return a.words[1] < b.words[1] ||
+           (a.words[1] == b.words[1] && a.words[0] < b.words[0]);
+  });
+
+  // First pass: count, so that the layout is known before writing.
+  uint64_t num_fingerprints = 0;
+  Merge(base, added_, [&num_fingerprints](const uint64_t*) {
+    ++num_fingerprints;
+  });
+  const uint32_t bucket_bits = BucketBits(num_fingerprints);
+  const Layout layout(bucket_bits, num_fingerprints);
+
+  const std::string temp_path = std::string(path) + ".tmp";
+  const int fd = open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  const auto fail = [fd, &temp_path]() {
+    const int error = errno;
+    close(fd);
+    (void)unlink(temp_path.c_str());
+    errno = error;
+    return false;
+  };
+  if (ftruncate(fd, static_cast<off_t>(layout.size)) != 0) {
+    return fail();
+  }
+  void* mapped = mmap(nullptr, static_cast<size_t>(layout.size),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    return fail();
+  }
+  char* bytes = static_cast<char*>(mapped);
+
+  FingerprintIndexHeader header;
+  header.magic = kFingerprintIndexMagic;
+  header.version = kFingerprintIndexVersion;
+  header.bucket_bits = bucket_bits;
+  header.num_fingerprints = num_fingerprints;
+  header.reserved = 0;
+  memcpy(bytes, &header, sizeof(header));
+
+  // Second pass: the fingerprints are sorted, so the directory is also
+  // written in order.
+  uint64_t* directory = reinterpret_cast<uint64_t*>(bytes + layout.directory);
+  uint64_t* out = reinterpret_cast<uint64_t*>(bytes + layout.fingerprints);
+  const uint64_t num_buckets = 1ull << bucket_bits;
+  uint64_t next_bucket = 0;
+  uint64_t index = 0;
+  Merge(base, added_, [&](const uint64_t* fingerprint) {
+    const uint64_t bucket = (fingerprint[1] >> 1) >> (63 - bucket_bits);
+    while (next_bucket <= bucket) {
+      directory[next_bucket++] = index;
+    }
+    out[2 * index + 0] = fingerprint[0];
+    out[2 * index + 1] = fingerprint[1];
+    ++index;
+  });
+  while (next_bucket <= num_buckets) {
+    directory[next_bucket++] = index;
+  }
+
+  const bool synced = msync(mapped, static_cast<size_t>(layout.size),
+                            MS_SYNC) == 0;
+  const int error = errno;
+  (void)munmap(mapped, static_cast<size_t>(layout.size));
+  if (!synced) {
+    errno = error;
+    return fail();
+  }
+  if (close(fd) != 0 || rename(temp_path.c_str(), path) != 0) {
+    const int close_error = errno;
+    (void)unlink(temp_path.c_str());
+    errno = close_error;
+    return false;
+  }
+  added_.clear();
+  return true;
+#else
+  (void)base;
+  (void)path;
+  errno = ENOSYS;
+  return false;
+#endif
+}
+
+}  // namespace highwayhash
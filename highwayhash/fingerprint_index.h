@@ -0,0 +1,167 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_FINGERPRINT_INDEX_H_
+#define HIGHWAYHASH_FINGERPRINT_INDEX_H_
+
+// Memory-mapped set of 128-bit fingerprints (e.g. HHChunk::hash) for
+// deduplication, stored in a file at 16 bytes per fingerprint plus a bucket
+// directory of about one byte per fingerprint.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+
+namespace highwayhash {
+
+// File layout, in native (little-endian) byte order:
+// - FingerprintIndexHeader;
+// - num_buckets + 1 uint64_t: the index of the first fingerprint of each
+//   bucket, followed by num_fingerprints;
+// - padding to a multiple of 64 bytes;
+// - num_fingerprints HHResult128, sorted by [1] and then [0] and unique.
+// Bucket b contains the fingerprints whose [1] has b as its bucket_bits most
+// significant bits. HighwayHash outputs are uniformly distributed, so the
+// buckets have about the same size and no secondary hashing is needed.
+static constexpr uint64_t kFingerprintIndexMagic = 0x3158444950464848ull;
+static constexpr uint32_t kFingerprintIndexVersion = 1;
+
+struct FingerprintIndexHeader {
+  uint64_t magic;  // kFingerprintIndexMagic; also detects the byte order.
+  uint32_t version;
+  uint32_t bucket_bits;  // log2 of the number of buckets
+  uint64_t num_fingerprints;
+  uint64_t reserved;  // zero
+};
+
+// Upper bound on the average number of fingerprints per bucket chosen by
+// FingerprintIndexBuilder, i.e. two cache lines to scan per lookup. The
+// directory costs 8 bytes per bucket.
+static constexpr size_t kFingerprintsPerBucket = 8;
+
+// Read-only view of an index file. Lookups touch one directory entry and
+// one bucket, i.e. typically two or three cache misses (or page faults if the
+// file is not resident). Thread-compatible: concurrent lookups are safe.
+class FingerprintIndex {
+ public:
+  // Empty index; Contains always returns false.
+  FingerprintIndex() = default;
+  FingerprintIndex(FingerprintIndex&& other);
+  FingerprintIndex& operator=(FingerprintIndex&& other);
+  FingerprintIndex(const FingerprintIndex&) = delete;
+  FingerprintIndex& operator=(const FingerprintIndex&) = delete;
+  ~FingerprintIndex();
+
+  // Maps the index at "path" (written by FingerprintIndexBuilder), replacing
+  // any previously opened index. Returns false and leaves this index empty if
+  // the file cannot be mapped (errno then indicates the reason) or is not a
+  // valid index (errno = EINVAL). POSIX only; elsewhere, returns false.
+  bool Open(const char* path);
+
+  // Number of (unique) fingerprints.
+  size_t size() const { return static_cast<size_t>(num_fingerprints_); }
+
+  // All fingerprints in the order described above, e.g. for merging.
+  const HHResult128* data() const {
+    return reinterpret_cast<const HHResult128*>(fingerprints_);
+  }
+
+  bool Contains(const HHResult128& fingerprint) const {
+    const uint64_t bucket = Bucket(fingerprint[1]);
+    uint64_t end;
+    for (uint64_t i = BucketBegin(bucket, &end); i < end; ++i) {
+      const uint64_t* HH_RESTRICT entry = fingerprints_ + 2 * i;
+      if (entry[1] == fingerprint[1] && entry[0] == fingerprint[0]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Equivalent to found[i] = Contains(fingerprints[i]) for all i < num, but
+  // prefetches the directory entries kMaxPrefetchKeys (table_helpers.h) and the
+  // buckets 2 * kMaxPrefetchKeys fingerprints ahead, so that their cache
+  // misses overlap. About 1.5 times as fast as separate Contains for indexes
+  // larger than the cache.
+  void ContainsBatch(const HHResult128* HH_RESTRICT fingerprints,
+                     const size_t num, bool* HH_RESTRICT found) const;
+
+ private:
+  HH_INLINE uint64_t Bucket(const uint64_t upper) const {
+    // Avoids undefined shift counts for bucket_bits_ == 0.
+    return (upper >> 1) >> (63 - bucket_bits_);
+  }
+
+  // Returns the first index in "bucket" and its end. Clamped to the number of
+  // fingerprints, so that a corrupted directory cannot cause reads outside
+  // the mapping.
+  HH_INLINE uint64_t BucketBegin(const uint64_t bucket,
+                                 uint64_t* HH_RESTRICT end) const {
+    const uint64_t next = directory_[bucket + 1];
+    *end = next < num_fingerprints_ ? next : num_fingerprints_;
+    return directory_[bucket];
+  }
+
+  void Close();
+
+  // Points to kEmptyDirectory unless a file is mapped.
+  const uint64_t* directory_ = kEmptyDirectory;
+  const uint64_t* fingerprints_ = nullptr;
+  uint64_t num_fingerprints_ = 0;
+  uint32_t bucket_bits_ = 0;
+
+  void* mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+
+  static const uint64_t kEmptyDirectory[2];
+};
+
+// Collects new fingerprints in memory and writes them, merged with an
+// existing index, to a new index file. The existing index is read
+// sequentially from its mapping and never loaded into memory, so merging a
+// few new fingerprints into a large index only requires memory for the new
+// ones (16 bytes each).
+class FingerprintIndexBuilder {
+ public:
+  void Add(const HHResult128& fingerprint) {
+    added_.push_back({{fingerprint[0], fingerprint[1]}});
+  }
+
+  // Number of Add since the last successful Write, including duplicates.
+  size_t NumAdded() const { return added_.size(); }
+
+  // Writes the union of "base" (if not null) and all added fingerprints to
+  // "path" by creating "path".tmp, syncing it and renaming it to "path". The
+  // rename is atomic, so readers see either the old or the new index; "base"
+  // may be the index previously opened from "path" and remains valid
+  // (it keeps the old file mapped) until it is reopened. Clears the added
+  // fingerprints if successful; otherwise returns false (errno then
+  // indicates the reason) and "path" is unchanged. POSIX only; elsewhere,
+  // returns false.
+  bool Write(const FingerprintIndex* base, const char* path);
+
+ private:
+  struct Entry {
+    uint64_t words[2];  // HHResult128
+  };
+
+  std::vector<Entry> added_;
+};
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_FINGERPRINT_INDEX_H_
@@ -0,0 +1,186 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the lookup throughput of open addressing hash tables with the
+// hashers and HashAndPrefetch from hasher.h.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "highwayhash/hasher.h"
+#include "highwayhash/highwayhash_target.h"
+#include "highwayhash/instruction_sets.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kNumLookups = 1 << 22;
+
+// What callers wrote before hasher.h: dispatches on every call.
+struct RunHasher {
+  size_t operator()(const uint64_t key) const {
+    HHResult64 hash;
+    InstructionSets::Run<HighwayHash>(
+        kKey, reinterpret_cast<const char*>(&key), sizeof(key), &hash);
+    return static_cast<size_t>(hash);
+  }
+};
+
+// Linear probing; key 0 marks empty slots.
+class Table {
+ public:
+  struct Slot {
+    uint64_t key;
+    uint64_t value;
+  };
+
+  // "num_slots" must be a power of two.
+  explicit Table(const size_t num_slots)
+      : mask_(num_slots - 1), slots_(num_slots) {}
+
+  size_t Bytes() const { return slots_.size() * sizeof(Slot); }
+
+  const void* BucketAddress(const size_t hash) const {
+    return &slots_[hash & mask_];
+  }
+
+  void Insert(const size_t hash, const uint64_t key, const uint64_t value) {
+    size_t i = hash & mask_;
+    while (slots_[i].key != 0 && slots_[i].key != key) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i].key = key;
+    slots_[i].value = value;
+  }
+
+  // Returns 0 if not found.
+  uint64_t Find(const size_t hash, const uint64_t key) const {
+    size_t i = hash & mask_;
+    while (slots_[i].key != key) {
+      if (slots_[i].key == 0) return 0;
+      i = (i + 1) & mask_;
+    }
+    return slots_[i].value;
+  }
+
+ private:
+  const size_t mask_;
+  std::vector<Slot> slots_;
+};
+
+template <class Hasher>
+uint64_t LookupEach(const Hasher& hasher, const Table& table,
+                    const std::vector<uint64_t>& lookups) {
+  uint64_t sum = 0;
+  for (const uint64_t key : lookups) {
+    sum += table.Find(hasher(key), key);
+  }
+  return sum;
+}
+
+template <class Hasher>
+uint64_t LookupBatches(const Hasher& hasher, const Table& table,
+                       const std::vector<uint64_t>& lookups) {
+  const auto bucket_address = [&table](const size_t hash) {
+    return table.BucketAddress(hash);
+  };
+  uint64_t sum = 0;
+  size_t hashes[kMaxPrefetchKeys];
+  for (size_t first = 0; first < lookups.size(); first += kMaxPrefetchKeys) {
+    const size_t count = std::min(kMaxPrefetchKeys, lookups.size() - first);
+    const uint64_t* keys = lookups.data() + first;
+    HashAndPrefetch(hasher, keys, count, bucket_address, hashes);
+    for (size_t i = 0; i < count; ++i) {
+      sum += table.Find(hashes[i], keys[i]);
+    }
+  }
+  return sum;
+}
+
+template <class Lookup>
+void Measure(const char* caption, const Lookup& lookup,
+             const uint64_t expected) {
+  double best = 1E10;
+  for (int rep = 0; rep < 3; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const uint64_t sum = lookup();
+    const auto t1 = std::chrono::steady_clock::now();
+    if (sum != expected) {
+      printf("%s: wrong sum %llx\n", caption,
+             static_cast<unsigned long long>(sum));
+      exit(1);
+    }
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  printf("%32s: %6.2f M lookups/s\n", caption, kNumLookups / best * 1E-6);
+}
+
+// Looks up random keys in a half-full table with "num_slots" slots.
+void Run(const size_t num_slots) {
+  const HighwayHasher hasher(kKey);
+  const HighwayHasherT<HH_TARGET> hasher_target(kKey);
+
+  std::mt19937_64 rng(12345);
+  const size_t num_keys = num_slots / 2;
+  std::vector<uint64_t> keys(num_keys);
+  Table table(num_slots);
+  for (size_t i = 0; i < num_keys; ++i) {
+    keys[i] = rng() | 1;  // nonzero
+    table.Insert(hasher(keys[i]), keys[i], i + 1);
+  }
+  std::vector<uint64_t> lookups(kNumLookups);
+  uint64_t expected = 0;
+  for (uint64_t& key : lookups) {
+    const size_t i = rng() % num_keys;
+    key = keys[i];
+    expected += i + 1;
+  }
+
+  printf("Target %s, %zu lookups in %zu KiB\n", TargetName(HH_TARGET),
+         kNumLookups, table.Bytes() >> 10);
+  Measure("InstructionSets::Run per key", [&] {
+    return LookupEach(RunHasher(), table, lookups);
+  }, expected);
+  Measure("HighwayHasher", [&] {
+    return LookupEach(hasher, table, lookups);
+  }, expected);
+  Measure("HighwayHasherT", [&] {
+    return LookupEach(hasher_target, table, lookups);
+  }, expected);
+  Measure("HighwayHasher+HashAndPrefetch", [&] {
+    return LookupBatches(hasher, table, lookups);
+  }, expected);
+  Measure("HighwayHasherT+HashAndPrefetch", [&] {
+    return LookupBatches(hasher_target, table, lookups);
+  }, expected);
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  // Cache-resident (hashing dominates) and 128 MiB (cache misses dominate).
+  highwayhash::Run(size_t{1} << 12);
+  highwayhash::Run(size_t{1} << 23);
+  return 0;
+}
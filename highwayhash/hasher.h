@@ -0,0 +1,166 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HASHER_H_
+#define HIGHWAYHASH_HASHER_H_
+
+// Hash functors for hash tables (e.g. std::unordered_map or open addressing
+// tables). With a secret random key, they protect the table against hash
+// flooding, i.e. inputs chosen to collide.
+//
+// NOTE: unlike highwayhash.h, this header is not restricted because it
+// includes standard library headers. HighwayHasherT may only be used in
+// translation units compiled with the flags for its Target (e.g. HH_TARGET);
+// HighwayHasher can be used anywhere.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/table_helpers.h"
+
+namespace highwayhash {
+
+// Converts the supported key types to bytes and passes them to
+// Derived::HashBytes(const char* bytes, size_t size), which returns the hash.
+// Keys of different types (e.g. std::string and StringView, or int32_t "1"
+// and uint32_t "1") have the same hash if their bytes are equal.
+template <class Derived>
+class HighwayHasherBase {
+ public:
+  // Allows heterogeneous lookup (e.g. a string_view in a table of strings).
+  using is_transparent = void;
+
+  size_t operator()(const std::string& key) const {
+    return Self().HashBytes(key.data(), key.size());
+  }
+  size_t operator()(const StringView& key) const {
+    return Self().HashBytes(key.data, key.num_bytes);
+  }
+  // Null-terminated string; the terminator is not hashed.
+  size_t operator()(const char* key) const {
+    return Self().HashBytes(key, strlen(key));
+  }
+#if __cplusplus >= 201703L
+  size_t operator()(const std::string_view key) const {
+    return Self().HashBytes(key.data(), key.size());
+  }
+#endif
+
+  // Integers are hashed as their little-endian bytes, so the hashes are the
+  // same on all platforms.
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value, size_t>::type
+  operator()(const T key) const {
+    const uint64_t le = le64_from_host(static_cast<uint64_t>(key));
+    return Self().HashBytes(reinterpret_cast<const char*>(&le), sizeof(T));
+  }
+
+  // Other trivially copyable types (e.g. structs of integers) are hashed as
+  // their object representation. WARNING: any padding bytes must be
+  // initialized (e.g. by memset before assigning the members), and floating
+  // point members require care (0.0 and -0.0 differ). The hashes depend on
+  // the byte order of the host.
+  template <typename T>
+  typename std::enable_if<!std::is_integral<T>::value &&
+                              !std::is_pointer<T>::value &&
+                              std::is_trivially_copyable<T>::value,
+                          size_t>::type
+  operator()(const T& key) const {
+    return Self().HashBytes(reinterpret_cast<const char*>(&key), sizeof(T));
+  }
+
+ private:
+  const Derived& Self() const { return *static_cast<const Derived*>(this); }
+};
+
+// Hashes keys with HighwayHashT<Target>, which is inlined into the caller.
+// Only 32 bytes, which is cheap to copy into containers; the state is Reset
+// for each key (see HighwayHashKeyedT for why that is barely slower).
+template <TargetBits Target>
+class HighwayHasherT : public HighwayHasherBase<HighwayHasherT<Target>> {
+ public:
+  explicit HighwayHasherT(const HHKey& key) {
+    for (int i = 0; i < 4; ++i) {
+      key_[i] = key[i];
+    }
+  }
+
+  size_t HashBytes(const char* bytes, const size_t size) const {
+    HHStateT<Target> state(key_);
+    HHResult64 hash;
+    HighwayHashT(&state, bytes, size, &hash);
+    return static_cast<size_t>(hash);
+  }
+
+ private:
+  HHKey key_;
+};
+
+// Hashes keys with the best implementation for the current CPU, chosen once
+// when the hasher is constructed. The key is also prepared only once. Costs
+// an indirect call per key, but can be used from any translation unit.
+class HighwayHasher : public HighwayHasherBase<HighwayHasher> {
+ public:
+  explicit HighwayHasher(const HHKey& key)
+      : functions_(&HighwayHashDispatch()) {
+    functions_->prepare(key, &prepared_);
+  }
+
+  size_t HashBytes(const char* bytes, const size_t size) const {
+    HHResult64 hash;
+    functions_->prepared64(&prepared_, bytes, size, &hash);
+    return static_cast<size_t>(hash);
+  }
+
+ private:
+  const HighwayHashFunctions* functions_;
+  HighwayHashPreparedKey prepared_;
+};
+
+// Batch helper for looking up several independent keys in a hash table whose
+// buckets are likely not in cache. Stores hasher(keys[i]) in hashes[i] for all
+// i < num_keys and prefetches the cache line at
+// bucket_address(hashes[i]) as soon as each hash is known. The caller then
+// probes the table for each key using hashes[i]; the cache misses of all
+// probes overlap with each other and with the remaining hashing. "num_keys"
+// should be at most kMaxPrefetchKeys (table_helpers.h).
+//
+// "bucket_address" is a function object mapping a size_t hash to the
+// (const void*) address of the first bucket the probe will access.
+template <class Hasher, class Key, class BucketAddress>
+HH_INLINE void HashAndPrefetch(const Hasher& hasher,
+                               const Key* HH_RESTRICT keys,
+                               const size_t num_keys,
+                               const BucketAddress& bucket_address,
+                               size_t* HH_RESTRICT hashes) {
+  for (size_t i = 0; i < num_keys; ++i) {
+    hashes[i] = hasher(keys[i]);
+    HH_PREFETCH(bucket_address(hashes[i]));
+  }
+}
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HASHER_H_
@@ -41,6 +41,11 @@ class HHStateAVX2 {
  public:
   explicit HH_INLINE HHStateAVX2(const HHKey key_lanes) { Reset(key_lanes); }
 
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStateAVX2(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
   HH_INLINE void Reset(const HHKey key_lanes) {
     // "Nothing up my sleeve" numbers, concatenated hex digits of Pi from
     // http://www.numberworld.org/digits/Pi/, retrieved Feb 22, 2016.
@@ -115,6 +120,47 @@ def x(a,b,c):
     }
   }
 
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time, so the whole ints are loaded without masking.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    const V8x32U size256(_mm256_set1_epi32(static_cast<int>(kSizeMod32)));
+    v0 += V4x64U(size256);
+    v1 = Rotate32By(v1, size256);
+
+    const char* remainder = bytes + (kSizeMod32 & ~3);
+    const size_t size_mod4 = kSizeMod32 & 3;
+
+    // Whole ints after the first 16 bytes, if any.
+    const V4x32U int_lanes =
+        LoadInts<(kSizeMod32 & 15) / 4>(bytes + (kSizeMod32 & 16));
+
+    if (kSizeMod32 & 16) {
+      const V4x32U packetL =
+          LoadUnaligned<V4x32U>(reinterpret_cast<const uint32_t*>(bytes));
+      const uint32_t last4 =
+          Load3()(Load3::AllowReadBeforeAndReturn(), remainder, size_mod4);
+      const V4x32U packetH(_mm_insert_epi32(int_lanes, last4, 3));
+      Update(packetH, packetL);
+    } else {
+      const V4x32U& packetL = int_lanes;
+      const uint64_t last3 =
+          Load3()(Load3::AllowUnordered(), remainder, size_mod4);
+      const V4x32U packetH(_mm_cvtsi64_si128(last3));
+      Update(packetH, packetL);
+    }
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32). The caller promises
+  // that 32 bytes starting at "bytes" are readable, but unaligned loads and
+  // selecting the tail via masks instead of branching were slightly slower
+  // than the masked loads, even for unpredictable sizes.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    UpdateRemainder(bytes, size_mod32);
+  }
+
   HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
     // Mix together all lanes. It is slightly better to permute v0 than v1;
     // it will be added to v1.
@@ -122,34 +168,65 @@ def x(a,b,c):
     Update(Permute(v0));
     Update(Permute(v0));
     Update(Permute(v0));
-
-    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
-    const V2x64U sum1(_mm256_castsi256_si128(v1 + mul1));
-    const V2x64U hash = sum0 + sum1;
-    // Each lane is sufficiently mixed, so just truncate to 64 bits.
-    _mm_storel_epi64(reinterpret_cast<__m128i*>(result), hash);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
     for (int n = 0; n < 6; n++) {
       Update(Permute(v0));
     }
-
-    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
-    const V2x64U sum1(_mm256_extracti128_si256(v1 + mul1, 1));
-    const V2x64U hash = sum0 + sum1;
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(result), hash);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
     for (int n = 0; n < 10; n++) {
       Update(Permute(v0));
     }
+    StoreHash(result);
+  }
 
-    const V4x64U sum0 = v0 + mul0;
-    const V4x64U sum1 = v1 + mul1;
-    const V4x64U hash = ModularReduction(sum1, sum0);
-    StoreUnaligned(hash, &(*result)[0]);
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    StoreUnaligned(v0, lanes + 0);
+    StoreUnaligned(v1, lanes + 4);
+    StoreUnaligned(mul0, lanes + 8);
+    StoreUnaligned(mul1, lanes + 12);
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    v0 = LoadUnaligned<V4x64U>(lanes + 0);
+    v1 = LoadUnaligned<V4x64U>(lanes + 4);
+    mul0 = LoadUnaligned<V4x64U>(lanes + 8);
+    mul1 = LoadUnaligned<V4x64U>(lanes + 12);
   }
 
   // "buffer" must be 32-byte aligned.
@@ -241,6 +318,56 @@ def x(a,b,c):
   }
 
  private:
+  // Measures the operations below, see vector_benchmark_target.cc.
+  friend class VectorBenchmarkOps;
+
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
+    const V2x64U sum1(_mm256_castsi256_si128(v1 + mul1));
+    const V2x64U hash = sum0 + sum1;
+    // Each lane is sufficiently mixed, so just truncate to 64 bits.
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(result), hash);
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
+    const V2x64U sum1(_mm256_extracti128_si256(v1 + mul1, 1));
+    const V2x64U hash = sum0 + sum1;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result), hash);
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    const V4x64U sum0 = v0 + mul0;
+    const V4x64U sum1 = v1 + mul1;
+    const V4x64U hash = ModularReduction(sum1, sum0);
+    StoreUnaligned(hash, &(*result)[0]);
+  }
+
+  // Returns the first kNumInts = 0..3 ints from "from" in the lower lanes and
+  // zero in the others, like MaskedLoadInt.
+  template <size_t kNumInts>
+  static HH_INLINE V4x32U LoadInts(const char* from) {
+    static_assert(kNumInts <= 3, "Use LoadUnaligned instead");
+    if (kNumInts == 0) {
+      return V4x32U(_mm_setzero_si128());
+    }
+    // (load_ss zero-extends and does not require alignment.)
+    const __m128i last = _mm_castps_si128(
+        _mm_load_ss(reinterpret_cast<const float*>(from + kNumInts * 4 - 4)));
+    if (kNumInts == 1) {
+      return V4x32U(last);
+    }
+    const __m128i lower2 =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(from));
+    if (kNumInts == 2) {
+      return V4x32U(lower2);
+    }
+    return V4x32U(_mm_unpacklo_epi64(lower2, last));
+  }
+
   static HH_INLINE V4x32U MaskedLoadInt(const char* from,
                                         const V4x32U& int_mask) {
     // No faults will be raised when reading n=0..3 ints from "from" provided
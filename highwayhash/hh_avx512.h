@@ -0,0 +1,404 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HH_AVX512_H_
+#define HIGHWAYHASH_HH_AVX512_H_
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/load3.h"
+#include "highwayhash/vector128.h"
+#include "highwayhash/vector256.h"
+
+// For auto-dependency generation, we need to include all headers but not their
+// contents (otherwise compilation fails because -mavx512f is not specified).
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary; matching it here makes
+// it easier use the vector128 symbols, but requires textual inclusion.
+namespace HH_TARGET_NAME {
+
+// Same algorithm and state layout as HHStateAVX2 (the state still fits in
+// four 256-bit vectors), but uses the AVX-512VL/BW extensions on 256-bit
+// registers: masked loads for remainders and partial Cat buffers, variable
+// rotates and ternary logic.
+class HHStateAVX512 {
+ public:
+  explicit HH_INLINE HHStateAVX512(const HHKey key_lanes) { Reset(key_lanes); }
+
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStateAVX512(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
+  HH_INLINE void Reset(const HHKey key_lanes) {
+    // "Nothing up my sleeve" numbers, concatenated hex digits of Pi from
+    // http://www.numberworld.org/digits/Pi/, retrieved Feb 22, 2016.
+    //
+    // We use this python code to generate the fourth number to have
+    // more even mixture of bits:
+    /*
+def x(a,b,c):
+  retval = 0
+  for i in range(64):
+    count = ((a >> i) & 1) + ((b >> i) & 1) + ((c >> i) & 1)
+    if (count <= 1):
+      retval |= 1 << i
+  return retval
+    */
+    const V4x64U init0(0x243f6a8885a308d3ull, 0x13198a2e03707344ull,
+                       0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
+    const V4x64U init1(0x452821e638d01377ull, 0xbe5466cf34e90c6cull,
+                       0xc0acf169b5f18a8cull, 0x3bd39e10cb0ef593ull);
+    const V4x64U key = LoadUnaligned<V4x64U>(key_lanes);
+    v0 = key ^ init0;
+    v1 = Rotate64By32(key) ^ init1;
+    mul0 = init0;
+    mul1 = init1;
+  }
+
+  HH_INLINE void Update(const HHPacket& packet_bytes) {
+    const uint64_t* HH_RESTRICT packet =
+        reinterpret_cast<const uint64_t * HH_RESTRICT>(packet_bytes);
+    Update(LoadUnaligned<V4x64U>(packet));
+  }
+
+  HH_INLINE void UpdateRemainder(const char* bytes, const size_t size_mod32) {
+    // 'Length padding' differentiates zero-valued inputs that have the same
+    // size/32. mod32 is sufficient because each Update behaves as if a
+    // counter were injected, because the state is large and mixed thoroughly.
+    const V8x32U size256(_mm256_set1_epi32(static_cast<int>(size_mod32)));
+    // Equivalent to storing size_mod32 in packet.
+    v0 += V4x64U(size256);
+    // Boosts the avalanche effect of mod32.
+    v1 = Rotate32By(v1, size256);
+
+    const char* remainder = bytes + (size_mod32 & ~3);
+    const size_t size_mod4 = size_mod32 & 3;
+
+    // Loads all whole ints with a single masked load (masked-off lanes are
+    // zero and do not fault), which replaces IntMask + maskload.
+    const V4x64U int_lanes(
+        _mm256_maskz_loadu_epi32(LowerBits(size_mod32 >> 2), bytes));
+
+    if (HH_UNLIKELY(size_mod32 & 16)) {  // 16..31 bytes left
+      const uint32_t last4 =
+          Load3()(Load3::AllowReadBeforeAndReturn(), remainder, size_mod4);
+
+      // The upper four bytes of the packet are zero, so insert there.
+      Update(V4x64U(_mm256_mask_set1_epi32(int_lanes, 0x80, last4)));
+    } else {  // size_mod32 < 16
+      const uint64_t last3 =
+          Load3()(Load3::AllowUnordered(), remainder, size_mod4);
+
+      // The upper 16 bytes are zero; as in HHStateAVX2, last3 goes into the
+      // lower half of packetH.
+      Update(V4x64U(_mm256_mask_set1_epi64(int_lanes, 0x04, last3)));
+    }
+  }
+
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time: the branch folds and the load mask becomes
+  // an immediate after inlining.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    UpdateRemainder(bytes, kSizeMod32);
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32), but the caller promises
+  // that all 32 bytes starting at "bytes" are readable. The masked load does
+  // not require that, but the tail is then loaded without branching.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    const V8x32U size256(_mm256_set1_epi32(static_cast<int>(size_mod32)));
+    v0 += V4x64U(size256);
+    v1 = Rotate32By(v1, size256);
+
+    const __m256i int_lanes =
+        _mm256_maskz_loadu_epi32(LowerBits(size_mod32 >> 2), bytes);
+
+    // Instead of branching, both last4 and last3 are loaded. last3 fits in
+    // the lowest int of the upper half of the packet, and the write mask
+    // selects that or the highest int (for 16..31 bytes).
+    const uint64_t is16 = (size_mod32 >> 4) & 1;
+    const size_t size_mod4 = size_mod32 & 3;
+    const char* remainder = bytes + (size_mod32 & ~3);
+    const uint64_t last3 =
+        Load3()(Load3::AllowUnorderedReadAfter(), remainder, size_mod4);
+    const uint32_t last4 = Load3()(Load3::AllowReadBeforeAndReturn(),
+                                   bytes + 4 + ((size_mod32 - 4) & (0 - is16)),
+                                   0);
+    const uint32_t tail = is16 ? last4 : static_cast<uint32_t>(last3);
+    const __mmask8 tail_int = static_cast<__mmask8>(0x10 << (3 * is16));
+    Update(V4x64U(_mm256_mask_set1_epi32(int_lanes, tail_int,
+                                         static_cast<int>(tail))));
+  }
+
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
+    // Mix together all lanes. It is slightly better to permute v0 than v1;
+    // it will be added to v1.
+    Update(Permute(v0));
+    Update(Permute(v0));
+    Update(Permute(v0));
+    Update(Permute(v0));
+    StoreHash(result);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
+    for (int n = 0; n < 6; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result);
+  }
+
+  HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
+    for (int n = 0; n < 10; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result);
+  }
+
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      Update(Permute(v0));
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    StoreUnaligned(v0, lanes + 0);
+    StoreUnaligned(v1, lanes + 4);
+    StoreUnaligned(mul0, lanes + 8);
+    StoreUnaligned(mul1, lanes + 12);
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    v0 = LoadUnaligned<V4x64U>(lanes + 0);
+    v1 = LoadUnaligned<V4x64U>(lanes + 4);
+    mul0 = LoadUnaligned<V4x64U>(lanes + 8);
+    mul1 = LoadUnaligned<V4x64U>(lanes + 12);
+  }
+
+  // "buffer" must be 32-byte aligned.
+  static HH_INLINE void ZeroInitialize(char* HH_RESTRICT buffer) {
+    const __m256i zero = _mm256_setzero_si256();
+    _mm256_store_si256(reinterpret_cast<__m256i*>(buffer), zero);
+  }
+
+  // "buffer" must be 32-byte aligned.
+  static HH_INLINE void CopyPartial(const char* HH_RESTRICT from,
+                                    const size_t size_mod32,
+                                    char* HH_RESTRICT buffer) {
+    // Byte-granular masked loads only access bytes whose mask bit is set.
+    const __m256i in = _mm256_maskz_loadu_epi8(LowerBits(size_mod32), from);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(buffer), in);
+  }
+
+  // "buffer" must be 32-byte aligned.
+  static HH_INLINE void AppendPartial(const char* HH_RESTRICT from,
+                                      const size_t size_mod32,
+                                      char* HH_RESTRICT buffer,
+                                      const size_t buffer_valid) {
+    const __m256i out = LoadSuffix(from, size_mod32, buffer, buffer_valid);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(buffer), out);
+  }
+
+  // "buffer" must be 32-byte aligned.
+  HH_INLINE void AppendAndUpdate(const char* HH_RESTRICT from,
+                                 const size_t size_mod32,
+                                 const char* HH_RESTRICT buffer,
+                                 const size_t buffer_valid) {
+    Update(V4x64U(LoadSuffix(from, size_mod32, buffer, buffer_valid)));
+  }
+
+ private:
+  // Measures the operations below, see vector_benchmark_target.cc.
+  friend class VectorBenchmarkOps;
+
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
+    const V2x64U sum1(_mm256_castsi256_si128(v1 + mul1));
+    const V2x64U hash = sum0 + sum1;
+    // Each lane is sufficiently mixed, so just truncate to 64 bits.
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(result), hash);
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    const V2x64U sum0(_mm256_castsi256_si128(v0 + mul0));
+    const V2x64U sum1(_mm256_extracti128_si256(v1 + mul1, 1));
+    const V2x64U hash = sum0 + sum1;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result), hash);
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    const V4x64U sum0 = v0 + mul0;
+    const V4x64U sum1 = v1 + mul1;
+    const V4x64U hash = ModularReduction(sum1, sum0);
+    StoreUnaligned(hash, &(*result)[0]);
+  }
+
+  // Returns a lane mask with the lower "num_bits" (< 32) bits set.
+  static HH_INLINE uint32_t LowerBits(const size_t num_bits) {
+    return (1U << num_bits) - 1;
+  }
+
+  // Returns the buffer contents with from[0, size_mod32) inserted at offset
+  // buffer_valid. buffer_valid + size_mod32 <= 32, and neither is 32. The
+  // load address may precede "from", but masked-off bytes are not accessed.
+  static HH_INLINE __m256i LoadSuffix(const char* HH_RESTRICT from,
+                                      const size_t size_mod32,
+                                      const char* HH_RESTRICT buffer,
+                                      const size_t buffer_valid) {
+    const __m256i prior =
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(buffer));
+    const __mmask32 mask = LowerBits(size_mod32) << buffer_valid;
+    return _mm256_mask_loadu_epi8(prior, mask, from - buffer_valid);
+  }
+
+  static HH_INLINE V4x64U Rotate64By32(const V4x64U& v) {
+    return V4x64U(_mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+
+  // Rotates 32-bit lanes by "count" bits.
+  static HH_INLINE V4x64U Rotate32By(const V4x64U& v, const V8x32U& count) {
+    return V4x64U(_mm256_rolv_epi32(v, count));
+  }
+
+  static HH_INLINE V4x64U Permute(const V4x64U& v) {
+    // For complete mixing, we need to swap the upper and lower 128-bit halves;
+    // we also swap all 32-bit halves. This is faster than extracti128 plus
+    // inserti128 followed by Rotate64By32.
+    const V4x64U indices(0x0000000200000003ull, 0x0000000000000001ull,
+                         0x0000000600000007ull, 0x0000000400000005ull);
+    return V4x64U(_mm256_permutevar8x32_epi32(v, indices));
+  }
+
+  static HH_INLINE V4x64U MulLow32(const V4x64U& a, const V4x64U& b) {
+    return V4x64U(_mm256_mul_epu32(a, b));
+  }
+
+  static HH_INLINE V4x64U ZipperMerge(const V4x64U& v) {
+    // Multiplication mixes/scrambles bytes 0-7 of the 64-bit result to
+    // varying degrees. In descending order of goodness, bytes
+    // 3 4 2 5 1 6 0 7 have quality 228 224 164 160 100 96 36 32.
+    // As expected, the upper and lower bytes are much worse.
+    // For each 64-bit lane, our objectives are:
+    // 1) maximizing and equalizing total goodness across the four lanes.
+    // 2) mixing with bytes from the neighboring lane (AVX-2 makes it difficult
+    //    to cross the 128-bit wall, but PermuteAndUpdate takes care of that);
+    // 3) placing the worst bytes in the upper 32 bits because those will not
+    //    be used in the next 32x32 multiplication.
+    const uint64_t hi = 0x070806090D0A040Bull;
+    const uint64_t lo = 0x000F010E05020C03ull;
+    return V4x64U(_mm256_shuffle_epi8(v, V4x64U(hi, lo, hi, lo)));
+  }
+
+  // Updates four hash lanes in parallel by injecting four 64-bit packets.
+  HH_INLINE void Update(const V4x64U& packet) {
+    v1 += packet;
+    v1 += mul0;
+    mul0 ^= MulLow32(v1, v0 >> 32);
+    HH_COMPILER_FENCE;
+    v0 += mul1;
+    mul1 ^= MulLow32(v0, v1 >> 32);
+    HH_COMPILER_FENCE;
+    v0 += ZipperMerge(v1);
+    v1 += ZipperMerge(v0);
+  }
+
+  HH_INLINE void Update(const V4x32U& packetH, const V4x32U& packetL) {
+    const __m256i packetL256 = _mm256_castsi128_si256(packetL);
+    Update(V4x64U(_mm256_inserti128_si256(packetL256, packetH, 1)));
+  }
+
+  // XORs a << 1 and a << 2 into *out after clearing the upper two bits of a.
+  // Also does the same for the upper 128 bit lane "b". Bit shifts are only
+  // possible on independent 64-bit lanes. We therefore insert the upper bits
+  // of a[0] that were lost into a[1]. Unlike HHStateAVX2, the four XORs are
+  // fused into two ternary-logic instructions.
+  static HH_INLINE void XorByShift128Left12(const V4x64U& ba,
+                                            V4x64U* HH_RESTRICT out) {
+    // XOR is linear, so the lost bits of both shifts can be combined first.
+    const V4x64U top_bits = (ba >> (64 - 2)) ^ (ba >> (64 - 1));
+    const V4x64U new_low_bits(_mm256_bslli_epi128(top_bits, 8));
+    const V4x64U shifted1_unmasked = ba + ba;  // (avoids needing port0)
+    const V4x64U shifted2 = shifted1_unmasked + shifted1_unmasked;
+    const V4x64U upper_bit_of_128(1ULL << 63, 0, 1ULL << 63, 0);
+
+    // out ^ shifted2 ^ new_low_bits.
+    const V4x64U sum(
+        _mm256_ternarylogic_epi64(*out, shifted2, new_low_bits, 0x96));
+    // sum ^ AndNot(upper_bit_of_128, shifted1_unmasked): the result must be as
+    // if the upper two bits of the input had been clear, otherwise we're no
+    // longer computing a reduction.
+    *out = V4x64U(_mm256_ternarylogic_epi64(sum, shifted1_unmasked,
+                                            upper_bit_of_128, 0xB4));
+  }
+
+  // Modular reduction by the irreducible polynomial (x^128 + x^2 + x).
+  // Input: two 256-bit numbers a3210 and b3210, interleaved in 2 vectors.
+  // The upper and lower 128-bit halves are processed independently.
+  static HH_INLINE V4x64U ModularReduction(const V4x64U& b32a32,
+                                           const V4x64U& b10a10) {
+    // See Lemire, https://arxiv.org/pdf/1503.03465v8.pdf.
+    V4x64U out = b10a10;
+    XorByShift128Left12(b32a32, &out);
+    return out;
+  }
+
+  V4x64U v0;
+  V4x64U v1;
+  V4x64U mul0;
+  V4x64U mul1;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_HH_AVX512_H_
@@ -0,0 +1,367 @@
+// Copyright 2017-2019 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HH_GENERIC_H_
+#define HIGHWAYHASH_HH_GENERIC_H_
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <string.h>  // memcpy
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/load3.h"
+
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary; we match it here for
+// consistency. As a result, this header requires textual inclusion.
+namespace HH_TARGET_NAME {
+
+// GCC/Clang vector extensions: the compiler lowers each operation to the SIMD
+// instructions enabled by the baseline flags (e.g. the z13 vector facility,
+// LoongArch LSX or MIPS MSA), splitting 256-bit vectors as needed, or to
+// scalar code. Only operators and shuffles with constant indices are used.
+typedef uint64_t GenericV4x64U __attribute__((vector_size(32)));
+typedef uint32_t GenericV8x32U __attribute__((vector_size(32)));
+typedef uint8_t GenericV32x8U __attribute__((vector_size(32)));
+
+// The same algorithm as hh_avx2.h, which keeps each of v0, v1, mul0 and mul1
+// in a single vector.
+class HHStateGeneric {
+ public:
+  explicit HH_INLINE HHStateGeneric(const HHKey keys) { Reset(keys); }
+
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStateGeneric(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
+  HH_INLINE void Reset(const HHKey keys) {
+    // "Nothing up my sleeve numbers"; see HHStateTAVX2.
+    const GenericV4x64U init0 = {0xdbe6d5d5fe4cce2full, 0xa4093822299f31d0ull,
+                                 0x13198a2e03707344ull, 0x243f6a8885a308d3ull};
+    const GenericV4x64U init1 = {0x3bd39e10cb0ef593ull, 0xc0acf169b5f18a8cull,
+                                 0xbe5466cf34e90c6cull, 0x452821e638d01377ull};
+    GenericV4x64U key;
+    memcpy(&key, keys, sizeof(key));
+    v0 = key ^ init0;
+    Rotate64By32(key, &v1);
+    v1 ^= init1;
+    mul0 = init0;
+    mul1 = init1;
+  }
+
+  HH_INLINE void Update(const HHPacket& packet_bytes) {
+    GenericV4x64U packet;
+    memcpy(&packet, &packet_bytes[0], sizeof(packet));
+    HostFromLE(&packet);
+    Update(packet);
+  }
+
+  HH_INLINE void UpdateRemainder(const char* bytes, const size_t size_mod32) {
+    // 'Length padding' differentiates zero-valued inputs that have the same
+    // size/32. mod32 is sufficient because each Update behaves as if a
+    // counter were injected, because the state is large and mixed thoroughly.
+    const uint64_t mod32_pair =
+        (static_cast<uint64_t>(size_mod32) << 32) + size_mod32;
+    v0 += mod32_pair;
+    // (size_mod32 != 0, otherwise the right shift would be undefined.)
+    const uint32_t count = static_cast<uint32_t>(size_mod32);
+    const GenericV8x32U halves = reinterpret_cast<GenericV8x32U>(v1);
+    v1 = reinterpret_cast<GenericV4x64U>((halves << count) |
+                                         (halves >> (32 - count)));
+
+    const size_t size_mod4 = size_mod32 & 3;
+    const char* remainder = bytes + (size_mod32 & ~3);
+
+    HH_ALIGNAS(32) HHPacket packet = {0};
+    memcpy(&packet[0], bytes, remainder - bytes);
+
+    if (size_mod32 & 16) {  // 16..31 bytes left
+      // Read the last 0..3 bytes and previous 1..4 into the upper bits.
+      // Insert into the upper four bytes of packet, which are zero.
+      uint32_t last4 =
+          Load3()(Load3::AllowReadBeforeAndReturn(), remainder, size_mod4);
+      last4 = host_from_le32(last4);
+      memcpy(&packet[28], &last4, sizeof(last4));
+    } else {  // size_mod32 < 16
+      uint64_t last4 = Load3()(Load3::AllowUnordered(), remainder, size_mod4);
+      last4 = host_from_le64(last4);
+
+      // Rather than insert at packet + 28, it is faster to initialize
+      // the otherwise empty packet + 16 with up to 64 bits of padding.
+      memcpy(&packet[16], &last4, sizeof(last4));
+    }
+    Update(packet);
+  }
+
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time: memcpy becomes fixed-size copies after inlining.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    UpdateRemainder(bytes, kSizeMod32);
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32); the promise that 32
+  // bytes starting at "bytes" are readable is not needed here.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    UpdateRemainder(bytes, size_mod32);
+  }
+
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result);
+  }
+
+  HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
+    for (int n = 0; n < 10; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result);
+  }
+
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    memcpy(lanes + 0, &v0, sizeof(v0));
+    memcpy(lanes + 4, &v1, sizeof(v1));
+    memcpy(lanes + 8, &mul0, sizeof(mul0));
+    memcpy(lanes + 12, &mul1, sizeof(mul1));
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    memcpy(&v0, lanes + 0, sizeof(v0));
+    memcpy(&v1, lanes + 4, sizeof(v1));
+    memcpy(&mul0, lanes + 8, sizeof(mul0));
+    memcpy(&mul1, lanes + 12, sizeof(mul1));
+  }
+
+  static HH_INLINE void ZeroInitialize(char* HH_RESTRICT buffer) {
+    memset(buffer, 0, sizeof(HHPacket));
+  }
+
+  static HH_INLINE void CopyPartial(const char* HH_RESTRICT from,
+                                    const size_t size_mod32,
+                                    char* HH_RESTRICT buffer) {
+    memcpy(buffer, from, size_mod32);
+  }
+
+  static HH_INLINE void AppendPartial(const char* HH_RESTRICT from,
+                                      const size_t size_mod32,
+                                      char* HH_RESTRICT buffer,
+                                      const size_t buffer_valid) {
+    memcpy(buffer + buffer_valid, from, size_mod32);
+  }
+
+  HH_INLINE void AppendAndUpdate(const char* HH_RESTRICT from,
+                                 const size_t size_mod32,
+                                 const char* HH_RESTRICT buffer,
+                                 const size_t buffer_valid) {
+    HH_ALIGNAS(32) HHPacket tmp;
+    memcpy(tmp, buffer, buffer_valid);
+    memcpy(tmp + buffer_valid, from, size_mod32);
+    Update(tmp);
+  }
+
+ private:
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    const GenericV4x64U sum = (v0 + mul0) + (v1 + mul1);
+    *result = sum[0];
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    const GenericV4x64U sum0 = v0 + mul0;
+    const GenericV4x64U sum1 = v1 + mul1;
+    (*result)[0] = sum0[0] + sum1[2];
+    (*result)[1] = sum0[1] + sum1[3];
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    const GenericV4x64U sum0 = v0 + mul0;
+    const GenericV4x64U sum1 = v1 + mul1;
+    ModularReduction(sum1[1], sum1[0], sum0[1], sum0[0], &(*result)[1],
+                     &(*result)[0]);
+    ModularReduction(sum1[3], sum1[2], sum0[3], sum0[2], &(*result)[3],
+                     &(*result)[2]);
+  }
+
+  // Returns the lanes of "v" selected by the constant indices "...".
+#ifdef __clang__
+#define HH_GENERIC_SHUFFLE(v, ...) __builtin_shufflevector(v, v, __VA_ARGS__)
+#else
+#define HH_GENERIC_SHUFFLE(v, ...) \
+  __builtin_shuffle(v, decltype(v){__VA_ARGS__})
+#endif
+
+  // Vectors are returned via pointer because returning 256-bit vectors by
+  // value changes the ABI (and warns) when the target has narrower registers.
+
+  // Converts little-endian lanes (e.g. from a packet) to host byte order.
+  static HH_INLINE void HostFromLE(GenericV4x64U* HH_RESTRICT v) {
+#if !HH_IS_LITTLE_ENDIAN
+    const GenericV32x8U bytes = reinterpret_cast<GenericV32x8U>(*v);
+    *v = reinterpret_cast<GenericV4x64U>(HH_GENERIC_SHUFFLE(
+        bytes, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 23, 22,
+        21, 20, 19, 18, 17, 16, 31, 30, 29, 28, 27, 26, 25, 24));
+#else
+    (void)v;
+#endif
+  }
+
+  // Swaps the 32-bit halves of each lane. (Independent of byte order.)
+  static HH_INLINE void Rotate64By32(const GenericV4x64U& v,
+                                     GenericV4x64U* HH_RESTRICT rotated) {
+    const GenericV8x32U halves = reinterpret_cast<GenericV8x32U>(v);
+    *rotated = reinterpret_cast<GenericV4x64U>(
+        HH_GENERIC_SHUFFLE(halves, 1, 0, 3, 2, 5, 4, 7, 6));
+  }
+
+  // Rotate64By32 and also swaps the 128-bit halves, as in hh_avx2.h.
+  static HH_INLINE void Permute(const GenericV4x64U& v,
+                                GenericV4x64U* HH_RESTRICT permuted) {
+    const GenericV8x32U halves = reinterpret_cast<GenericV8x32U>(v);
+    *permuted = reinterpret_cast<GenericV4x64U>(
+        HH_GENERIC_SHUFFLE(halves, 5, 4, 7, 6, 1, 0, 3, 2));
+  }
+
+  // See hh_avx2.h for the choice of bytes. The byte indices refer to memory
+  // order, hence the big-endian version maps the same lane bytes.
+  static HH_INLINE void ZipperMerge(const GenericV4x64U& v,
+                                    GenericV4x64U* HH_RESTRICT merged) {
+    const GenericV32x8U bytes = reinterpret_cast<GenericV32x8U>(v);
+#if HH_IS_LITTLE_ENDIAN
+    *merged = reinterpret_cast<GenericV4x64U>(HH_GENERIC_SHUFFLE(
+        bytes, 3, 12, 2, 5, 14, 1, 15, 0, 11, 4, 10, 13, 9, 6, 8, 7, 19, 28,
+        18, 21, 30, 17, 31, 16, 27, 20, 26, 29, 25, 22, 24, 23));
+#else
+    *merged = reinterpret_cast<GenericV4x64U>(HH_GENERIC_SHUFFLE(
+        bytes, 7, 8, 6, 9, 2, 5, 11, 4, 0, 15, 1, 14, 10, 13, 3, 12, 23, 24,
+        22, 25, 18, 21, 27, 20, 16, 31, 17, 30, 26, 29, 19, 28));
+#endif
+  }
+
+#undef HH_GENERIC_SHUFFLE
+
+  // For inputs that are already in native byte order (e.g. PermuteAndUpdate).
+  HH_INLINE void Update(const GenericV4x64U& packet) {
+    const uint64_t kLow32 = 0xFFFFFFFFull;
+    v1 += packet;
+    v1 += mul0;
+    mul0 ^= (v1 & kLow32) * (v0 >> 32);
+    v0 += mul1;
+    mul1 ^= (v0 & kLow32) * (v1 >> 32);
+    GenericV4x64U merged;
+    ZipperMerge(v1, &merged);
+    v0 += merged;
+    ZipperMerge(v0, &merged);
+    v1 += merged;
+  }
+
+  HH_INLINE void PermuteAndUpdate() {
+    GenericV4x64U permuted;
+    Permute(v0, &permuted);
+    Update(permuted);
+  }
+
+  // Computes a << kBits for 128-bit a = (a1, a0).
+  // Bit shifts are only possible on independent 64-bit lanes. We therefore
+  // insert the upper bits of a0 that were lost into a1. This is slightly
+  // shorter than Lemire's (a << 1) | (((a >> 8) << 1) << 8) approach.
+  template <int kBits>
+  static HH_INLINE void Shift128Left(uint64_t* HH_RESTRICT a1,
+                                     uint64_t* HH_RESTRICT a0) {
+    const uint64_t shifted1 = (*a1) << kBits;
+    const uint64_t top_bits = (*a0) >> (64 - kBits);
+    *a0 <<= kBits;
+    *a1 = shifted1 | top_bits;
+  }
+
+  // Modular reduction by the irreducible polynomial (x^128 + x^2 + x).
+  // Input: a 256-bit number a3210.
+  static HH_INLINE void ModularReduction(const uint64_t a3_unmasked,
+                                         const uint64_t a2, const uint64_t a1,
+                                         const uint64_t a0,
+                                         uint64_t* HH_RESTRICT m1,
+                                         uint64_t* HH_RESTRICT m0) {
+    // The upper two bits must be clear, otherwise a3 << 2 would lose bits,
+    // in which case we're no longer computing a reduction.
+    const uint64_t a3 = a3_unmasked & 0x3FFFFFFFFFFFFFFFull;
+    // See Lemire, https://arxiv.org/pdf/1503.03465v8.pdf.
+    uint64_t a3_shl1 = a3;
+    uint64_t a2_shl1 = a2;
+    uint64_t a3_shl2 = a3;
+    uint64_t a2_shl2 = a2;
+    Shift128Left<1>(&a3_shl1, &a2_shl1);
+    Shift128Left<2>(&a3_shl2, &a2_shl2);
+    *m1 = a1 ^ a3_shl1 ^ a3_shl2;
+    *m0 = a0 ^ a2_shl1 ^ a2_shl2;
+  }
+
+  GenericV4x64U v0;
+  GenericV4x64U v1;
+  GenericV4x64U mul0;
+  GenericV4x64U mul1;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HH_GENERIC_H_
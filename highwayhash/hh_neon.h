@@ -43,6 +43,11 @@ class HHStateNEON {
  public:
   explicit HH_INLINE HHStateNEON(const HHKey key) { Reset(key); }
 
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStateNEON(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
   HH_INLINE void Reset(const HHKey key) {
     // "Nothing up my sleeve numbers"; see HHStateTAVX2.
     const V2x64U init0L(0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
@@ -122,42 +127,93 @@ class HHStateNEON {
     }
   }
 
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time: the branches of LoadMultipleOfFour fold after inlining.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    UpdateRemainder(bytes, kSizeMod32);
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32); the promise that 32
+  // bytes starting at "bytes" are readable is not needed here.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    UpdateRemainder(bytes, size_mod32);
+  }
+
   HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
     // Mix together all lanes.
     for (int n = 0; n < 4; n++) {
       PermuteAndUpdate();
     }
-
-    const V2x64U sum0 = v0L + mul0L;
-    const V2x64U sum1 = v1L + mul1L;
-    const V2x64U hash = sum0 + sum1;
-    vst1q_low_u64(reinterpret_cast<uint64_t*>(result), hash);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
     for (int n = 0; n < 6; n++) {
       PermuteAndUpdate();
     }
-
-    const V2x64U sum0 = v0L + mul0L;
-    const V2x64U sum1 = v1H + mul1H;
-    const V2x64U hash = sum0 + sum1;
-    StoreUnaligned(hash, &(*result)[0]);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
     for (int n = 0; n < 10; n++) {
       PermuteAndUpdate();
     }
+    StoreHash(result);
+  }
 
-    const V2x64U sum0L = v0L + mul0L;
-    const V2x64U sum1L = v1L + mul1L;
-    const V2x64U sum0H = v0H + mul0H;
-    const V2x64U sum1H = v1H + mul1H;
-    const V2x64U hashL = ModularReduction(sum1L, sum0L);
-    const V2x64U hashH = ModularReduction(sum1H, sum0H);
-    StoreUnaligned(hashL, &(*result)[0]);
-    StoreUnaligned(hashH, &(*result)[2]);
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    StoreUnaligned(v0L, lanes + 0);
+    StoreUnaligned(v0H, lanes + 2);
+    StoreUnaligned(v1L, lanes + 4);
+    StoreUnaligned(v1H, lanes + 6);
+    StoreUnaligned(mul0L, lanes + 8);
+    StoreUnaligned(mul0H, lanes + 10);
+    StoreUnaligned(mul1L, lanes + 12);
+    StoreUnaligned(mul1H, lanes + 14);
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    v0L = LoadUnaligned<V2x64U>(lanes + 0);
+    v0H = LoadUnaligned<V2x64U>(lanes + 2);
+    v1L = LoadUnaligned<V2x64U>(lanes + 4);
+    v1H = LoadUnaligned<V2x64U>(lanes + 6);
+    mul0L = LoadUnaligned<V2x64U>(lanes + 8);
+    mul0H = LoadUnaligned<V2x64U>(lanes + 10);
+    mul1L = LoadUnaligned<V2x64U>(lanes + 12);
+    mul1H = LoadUnaligned<V2x64U>(lanes + 14);
   }
 
   static HH_INLINE void ZeroInitialize(char* HH_RESTRICT buffer_bytes) {
@@ -198,6 +254,37 @@ class HHStateNEON {
   }
 
  private:
+  // Measures the operations below, see vector_benchmark_target.cc.
+  friend class VectorBenchmarkOps;
+
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    const V2x64U sum0 = v0L + mul0L;
+    const V2x64U sum1 = v1L + mul1L;
+    const V2x64U hash = sum0 + sum1;
+    vst1q_low_u64(reinterpret_cast<uint64_t*>(result), hash);
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    const V2x64U sum0 = v0L + mul0L;
+    const V2x64U sum1 = v1H + mul1H;
+    const V2x64U hash = sum0 + sum1;
+    StoreUnaligned(hash, &(*result)[0]);
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    const V2x64U sum0L = v0L + mul0L;
+    const V2x64U sum1L = v1L + mul1L;
+    const V2x64U sum0H = v0H + mul0H;
+    const V2x64U sum1H = v1H + mul1H;
+    const V2x64U hashL = ModularReduction(sum1L, sum0L);
+    const V2x64U hashH = ModularReduction(sum1H, sum0H);
+    StoreUnaligned(hashL, &(*result)[0]);
+    StoreUnaligned(hashH, &(*result)[2]);
+  }
+
   // Swap 32-bit halves of each lane (caller swaps 128-bit halves)
   static HH_INLINE V2x64U Rotate64By32(const V2x64U& v) {
     return V2x64U(vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(v))));
@@ -38,6 +38,11 @@ class HHStatePortable {
 
   explicit HH_INLINE HHStatePortable(const HHKey keys) { Reset(keys); }
 
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStatePortable(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
   HH_INLINE void Reset(const HHKey keys) {
     static const Lanes init0 = {0xdbe6d5d5fe4cce2full, 0xa4093822299f31d0ull,
                                 0x13198a2e03707344ull, 0x243f6a8885a308d3ull};
@@ -70,7 +75,7 @@ class HHStatePortable {
     for (int lane = 0; lane < kNumLanes; ++lane) {
       v0[lane] += mod32_pair;
     }
-    Rotate32By(reinterpret_cast<uint32_t*>(&v1), size_mod32);
+    Rotate32By(&v1, size_mod32);
 
     const size_t size_mod4 = size_mod32 & 3;
     const char* remainder = bytes + (size_mod32 & ~3);
@@ -98,32 +103,88 @@ class HHStatePortable {
     Update(packet);
   }
 
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time: CopyPartial becomes fixed-size copies after inlining.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    UpdateRemainder(bytes, kSizeMod32);
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32); the promise that 32
+  // bytes starting at "bytes" are readable is not needed here.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    UpdateRemainder(bytes, size_mod32);
+  }
+
   HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
     for (int n = 0; n < 4; n++) {
       PermuteAndUpdate();
     }
-
-    *result = v0[0] + v1[0] + mul0[0] + mul1[0];
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
     for (int n = 0; n < 6; n++) {
       PermuteAndUpdate();
     }
-
-    (*result)[0] = v0[0] + mul0[0] + v1[2] + mul1[2];
-    (*result)[1] = v0[1] + mul0[1] + v1[3] + mul1[3];
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
     for (int n = 0; n < 10; n++) {
       PermuteAndUpdate();
     }
+    StoreHash(result);
+  }
 
-    ModularReduction(v1[1] + mul1[1], v1[0] + mul1[0], v0[1] + mul0[1],
-                     v0[0] + mul0[0], &(*result)[1], &(*result)[0]);
-    ModularReduction(v1[3] + mul1[3], v1[2] + mul1[2], v0[3] + mul0[3],
-                     v0[2] + mul0[2], &(*result)[3], &(*result)[2]);
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      lanes[0 * kNumLanes + lane] = v0[lane];
+      lanes[1 * kNumLanes + lane] = v1[lane];
+      lanes[2 * kNumLanes + lane] = mul0[lane];
+      lanes[3 * kNumLanes + lane] = mul1[lane];
+    }
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      v0[lane] = lanes[0 * kNumLanes + lane];
+      v1[lane] = lanes[1 * kNumLanes + lane];
+      mul0[lane] = lanes[2 * kNumLanes + lane];
+      mul1[lane] = lanes[3 * kNumLanes + lane];
+    }
   }
 
   static HH_INLINE void ZeroInitialize(char* HH_RESTRICT buffer) {
@@ -164,6 +225,25 @@ class HHStatePortable {
   }
 
  private:
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    *result = v0[0] + v1[0] + mul0[0] + mul1[0];
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    (*result)[0] = v0[0] + mul0[0] + v1[2] + mul1[2];
+    (*result)[1] = v0[1] + mul0[1] + v1[3] + mul1[3];
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    ModularReduction(v1[1] + mul1[1], v1[0] + mul1[0], v0[1] + mul0[1],
+                     v0[0] + mul0[0], &(*result)[1], &(*result)[0]);
+    ModularReduction(v1[3] + mul1[3], v1[2] + mul1[2], v0[3] + mul0[3],
+                     v0[2] + mul0[2], &(*result)[3], &(*result)[2]);
+  }
+
   static HH_INLINE void Copy(const Lanes& source, Lanes* HH_RESTRICT dest) {
     for (int lane = 0; lane < kNumLanes; ++lane) {
       (*dest)[lane] = source[lane];
@@ -236,10 +316,17 @@ class HHStatePortable {
     }
   }
 
-  static HH_INLINE void Rotate32By(uint32_t* halves, const uint64_t count) {
-    for (int i = 0; i < 2 * kNumLanes; ++i) {
-      const uint32_t x = halves[i];
-      halves[i] = (x << count) | (x >> (32 - count));
+  // Rotates both 32-bit halves of each lane left by "count" (1..31) bits.
+  // Accessing the lanes through a uint32_t* would violate strict aliasing,
+  // which GCC -O3 miscompiled.
+  static HH_INLINE void Rotate32By(Lanes* HH_RESTRICT lanes,
+                                   const uint64_t count) {
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      const uint32_t lo = static_cast<uint32_t>((*lanes)[lane]);
+      const uint32_t hi = static_cast<uint32_t>((*lanes)[lane] >> 32);
+      const uint32_t lo_rotated = (lo << count) | (lo >> (32 - count));
+      const uint32_t hi_rotated = (hi << count) | (hi >> (32 - count));
+      (*lanes)[lane] = (static_cast<uint64_t>(hi_rotated) << 32) | lo_rotated;
     }
   }
 
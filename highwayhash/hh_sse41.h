@@ -51,6 +51,11 @@ class HHStateSSE41 {
  public:
   explicit HH_INLINE HHStateSSE41(const HHKey key) { Reset(key); }
 
+  // Same as LoadLanes, but skips the key setup of the above constructor.
+  HH_INLINE HHStateSSE41(HHLoadLanesTag, const uint64_t* HH_RESTRICT lanes) {
+    LoadLanes(lanes);
+  }
+
   HH_INLINE void Reset(const HHKey key) {
     // "Nothing up my sleeve numbers"; see HHStateTAVX2.
     const V2x64U init0L(0xa4093822299f31d0ull, 0xdbe6d5d5fe4cce2full);
@@ -116,42 +121,152 @@ class HHStateSSE41 {
     }
   }
 
+  // Same result as UpdateRemainder(bytes, kSizeMod32), but the size is known
+  // at compile time, so the whole ints are loaded with a single movd/movq
+  // (or both) instead of LoadMultipleOfFour's broadcast and mask.
+  template <size_t kSizeMod32>
+  HH_INLINE void UpdateRemainderFixed(const char* bytes) {
+    static_assert(0 < kSizeMod32 && kSizeMod32 < 32, "Use Update instead");
+    const V2x64U vsize_mod32(_mm_set1_epi32(static_cast<int>(kSizeMod32)));
+    v0L += vsize_mod32;
+    v0H += vsize_mod32;
+    Rotate32By(&v1H, &v1L, kSizeMod32);
+
+    const char* HH_RESTRICT remainder = bytes + (kSizeMod32 & ~3);
+    const size_t size_mod4 = kSizeMod32 & 3;
+
+    // Whole ints after the first 16 bytes, if any.
+    const V2x64U int_lanes =
+        LoadInts<(kSizeMod32 & 15) / 4>(bytes + (kSizeMod32 & 16));
+
+    if (kSizeMod32 & 16) {
+      const V2x64U packetL =
+          LoadUnaligned<V2x64U>(reinterpret_cast<const uint64_t*>(bytes));
+      const uint32_t last4 =
+          Load3()(Load3::AllowReadBeforeAndReturn(), remainder, size_mod4);
+      const V2x64U packetH(_mm_insert_epi32(int_lanes, last4, 3));
+      Update(packetH, packetL);
+    } else {
+      const V2x64U& packetL = int_lanes;
+      const uint64_t last3 =
+          Load3()(Load3::AllowUnordered(), remainder, size_mod4);
+      const V2x64U packetH(_mm_cvtsi64_si128(last3));
+      Update(packetH, packetL);
+    }
+  }
+
+  // Same result as UpdateRemainder(bytes, size_mod32), but the caller promises
+  // that all 32 bytes starting at "bytes" are readable. This allows unaligned
+  // loads instead of LoadMultipleOfFour and a branch-free tail, which is faster
+  // if successive sizes are unpredictable.
+  HH_INLINE void UpdateRemainderReadable(const char* bytes,
+                                         const size_t size_mod32) {
+    const V4x32U vsize_mod32(static_cast<uint32_t>(size_mod32));
+    v0L += V2x64U(vsize_mod32);
+    v0H += V2x64U(vsize_mod32);
+    Rotate32By(&v1H, &v1L, size_mod32);
+
+    // Whole ints, i.e. those whose last byte 4 * i + 3 < size_mod32.
+    const V2x64U maskL(
+        _mm_cmpgt_epi32(vsize_mod32, _mm_setr_epi32(3, 7, 11, 15)));
+    const V2x64U maskH(
+        _mm_cmpgt_epi32(vsize_mod32, _mm_setr_epi32(19, 23, 27, 31)));
+    const uint64_t* words = reinterpret_cast<const uint64_t*>(bytes);
+    const V2x64U packetL = LoadUnaligned<V2x64U>(words + 0) & maskL;
+    V2x64U packetH = LoadUnaligned<V2x64U>(words + 2) & maskH;
+
+    // Either last4 in the upper four bytes of packetH (if size_mod32 & 16), or
+    // last3 in its lower half. Both are loaded and the 64-bit lane is selected
+    // via mask instead of branching.
+    const uint64_t is16 = (size_mod32 >> 4) & 1;
+    const size_t size_mod4 = size_mod32 & 3;
+    const char* remainder = bytes + (size_mod32 & ~3);
+    const uint64_t last3 =
+        Load3()(Load3::AllowUnorderedReadAfter(), remainder, size_mod4);
+    // The last four bytes if is16, otherwise (unused) bytes [0, 4).
+    const uint32_t last4 = Load3()(Load3::AllowReadBeforeAndReturn(),
+                                   bytes + 4 + ((size_mod32 - 4) & (0 - is16)),
+                                   0);
+    const uint64_t tail = is16 ? (static_cast<uint64_t>(last4) << 32) : last3;
+    const V2x64U tail_mask(
+        _mm_cmpeq_epi64(_mm_set1_epi64x(static_cast<int64_t>(is16)),
+                        _mm_set_epi64x(1, 0)));
+    packetH |= V2x64U(_mm_set1_epi64x(static_cast<int64_t>(tail))) & tail_mask;
+    Update(packetH, packetL);
+  }
+
   HH_INLINE void Finalize(HHResult64* HH_RESTRICT result) {
     // Mix together all lanes.
     for (int n = 0; n < 4; n++) {
       PermuteAndUpdate();
     }
-
-    const V2x64U sum0 = v0L + mul0L;
-    const V2x64U sum1 = v1L + mul1L;
-    const V2x64U hash = sum0 + sum1;
-    _mm_storel_epi64(reinterpret_cast<__m128i*>(result), hash);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult128* HH_RESTRICT result) {
     for (int n = 0; n < 6; n++) {
       PermuteAndUpdate();
     }
-
-    const V2x64U sum0 = v0L + mul0L;
-    const V2x64U sum1 = v1H + mul1H;
-    const V2x64U hash = sum0 + sum1;
-    StoreUnaligned(hash, &(*result)[0]);
+    StoreHash(result);
   }
 
   HH_INLINE void Finalize(HHResult256* HH_RESTRICT result) {
     for (int n = 0; n < 10; n++) {
       PermuteAndUpdate();
     }
+    StoreHash(result);
+  }
 
-    const V2x64U sum0L = v0L + mul0L;
-    const V2x64U sum1L = v1L + mul1L;
-    const V2x64U sum0H = v0H + mul0H;
-    const V2x64U sum1H = v1H + mul1H;
-    const V2x64U hashL = ModularReduction(sum1L, sum0L);
-    const V2x64U hashH = ModularReduction(sum1H, sum0H);
-    StoreUnaligned(hashL, &(*result)[0]);
-    StoreUnaligned(hashH, &(*result)[2]);
+  // Same results as Finalize of two copies of the state, but computing both
+  // costs only as many permute rounds as the wider one (6 or 10 instead of
+  // 10 or 16), e.g. for a bucket index plus a fingerprint of the same key.
+  HH_INLINE void Finalize(HHResult64* HH_RESTRICT result64,
+                          HHResult128* HH_RESTRICT result128) {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result64);
+    for (int n = 0; n < 2; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+  }
+
+  HH_INLINE void Finalize(HHResult128* HH_RESTRICT result128,
+                          HHResult256* HH_RESTRICT result256) {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result128);
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    StoreHash(result256);
+  }
+
+  // Stores v0, v1, mul0 and mul1 (in that order, lane 0 first) in "lanes",
+  // which is the same for all targets. Used by HighwayHashCatT::Serialize.
+  HH_INLINE void StoreLanes(uint64_t* HH_RESTRICT lanes) const {
+    StoreUnaligned(v0L, lanes + 0);
+    StoreUnaligned(v0H, lanes + 2);
+    StoreUnaligned(v1L, lanes + 4);
+    StoreUnaligned(v1H, lanes + 6);
+    StoreUnaligned(mul0L, lanes + 8);
+    StoreUnaligned(mul0H, lanes + 10);
+    StoreUnaligned(mul1L, lanes + 12);
+    StoreUnaligned(mul1H, lanes + 14);
+  }
+
+  // Inverse of StoreLanes.
+  HH_INLINE void LoadLanes(const uint64_t* HH_RESTRICT lanes) {
+    v0L = LoadUnaligned<V2x64U>(lanes + 0);
+    v0H = LoadUnaligned<V2x64U>(lanes + 2);
+    v1L = LoadUnaligned<V2x64U>(lanes + 4);
+    v1H = LoadUnaligned<V2x64U>(lanes + 6);
+    mul0L = LoadUnaligned<V2x64U>(lanes + 8);
+    mul0H = LoadUnaligned<V2x64U>(lanes + 10);
+    mul1L = LoadUnaligned<V2x64U>(lanes + 12);
+    mul1H = LoadUnaligned<V2x64U>(lanes + 14);
   }
 
   static HH_INLINE void ZeroInitialize(char* HH_RESTRICT buffer_bytes) {
@@ -193,6 +308,37 @@ class HHStateSSE41 {
   }
 
  private:
+  // Measures the operations below, see vector_benchmark_target.cc.
+  friend class VectorBenchmarkOps;
+
+  // Stores the hash of the state after the four permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult64* HH_RESTRICT result) const {
+    const V2x64U sum0 = v0L + mul0L;
+    const V2x64U sum1 = v1L + mul1L;
+    const V2x64U hash = sum0 + sum1;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(result), hash);
+  }
+
+  // Stores the hash of the state after the six permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult128* HH_RESTRICT result) const {
+    const V2x64U sum0 = v0L + mul0L;
+    const V2x64U sum1 = v1H + mul1H;
+    const V2x64U hash = sum0 + sum1;
+    StoreUnaligned(hash, &(*result)[0]);
+  }
+
+  // Stores the hash of the state after the ten permute rounds of Finalize.
+  HH_INLINE void StoreHash(HHResult256* HH_RESTRICT result) const {
+    const V2x64U sum0L = v0L + mul0L;
+    const V2x64U sum1L = v1L + mul1L;
+    const V2x64U sum0H = v0H + mul0H;
+    const V2x64U sum1H = v1H + mul1H;
+    const V2x64U hashL = ModularReduction(sum1L, sum0L);
+    const V2x64U hashH = ModularReduction(sum1H, sum0H);
+    StoreUnaligned(hashL, &(*result)[0]);
+    StoreUnaligned(hashH, &(*result)[2]);
+  }
+
   // Swap 32-bit halves of each lane (caller swaps 128-bit halves)
   static HH_INLINE V2x64U Rotate64By32(const V2x64U& v) {
     return V2x64U(_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
@@ -278,6 +424,28 @@ class HHStateSSE41 {
     return ret;
   }
 
+  // Returns the first kNumInts = 0..3 ints from "from" in the lower lanes and
+  // zero in the others, like LoadMultipleOfFour. Reads only those bytes.
+  template <size_t kNumInts>
+  static HH_INLINE V2x64U LoadInts(const char* from) {
+    static_assert(kNumInts <= 3, "Use LoadUnaligned instead");
+    if (kNumInts == 0) {
+      return V2x64U(_mm_setzero_si128());
+    }
+    // (load_ss zero-extends and does not require alignment.)
+    const __m128i last = _mm_castps_si128(
+        _mm_load_ss(reinterpret_cast<const float*>(from + kNumInts * 4 - 4)));
+    if (kNumInts == 1) {
+      return V2x64U(last);
+    }
+    const __m128i lower2 =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(from));
+    if (kNumInts == 2) {
+      return V2x64U(lower2);
+    }
+    return V2x64U(_mm_unpacklo_epi64(lower2, last));
+  }
+
   // XORs x << 1 and x << 2 into *out after clearing the upper two bits of x.
   // Bit shifts are only possible on independent 64-bit lanes. We therefore
   // insert the upper bits of x[0] that were lost into x[1].
@@ -35,15 +35,50 @@ typedef uint64_t HHKey[4];
 // How much input is hashed by one call to HHStateT::Update.
 typedef char HHPacket[32];
 
+// Default distance [bytes] between the position being hashed and the one being
+// prefetched by HighwayHashNonTemporalT. Covers the DRAM latency at the
+// throughput of the vector targets without prefetching too far past the end.
+#define HH_PREFETCH_DISTANCE 1024
+
 // Hash 'return' types.
 typedef uint64_t HHResult64;  // returned directly
 typedef uint64_t HHResult128[2];
 typedef uint64_t HHResult256[4];
 
+// Replacement for C++17 std::string_view that avoids dependencies.
+// A struct requires fewer allocations when calling HighwayHashCat with
+// non-const "num_fragments".
+typedef struct StringView {
+  const char* data;  // not necessarily aligned/padded
+  size_t num_bytes;  // possibly zero
+} StringView;
+
+// Serialized state of an incremental hash (see HighwayHashCatT::Serialize),
+// independent of the target and byte order. Can be stored or sent to another
+// machine to resume hashing there.
+typedef struct HHCatSnapshot {
+  char bytes[168];
+} HHCatSnapshot;
+
+// Tightly packed state of an incremental hash (see HighwayHashCompactAppendT),
+// e.g. for arrays of millions of concurrent streams: 160 bytes and 8-byte
+// alignment, whereas HighwayHashCatT is padded to 192 bytes and 64-byte
+// aligned. The same for all targets of one process, but unlike
+// HHCatSnapshot, it depends on the byte order.
+typedef struct HHCompactCat {
+  uint64_t lanes[16];    // see HHStateT::StoreLanes
+  char buffer[31];       // partial packet
+  uint8_t buffer_usage;  // valid bytes in buffer, < sizeof(HHPacket)
+} HHCompactCat;
+
 // Called if a test fails, indicating which target and size.
 typedef void (*HHNotify)(const char*, size_t);
 
 #ifdef __cplusplus
+// Selects the HHStateT constructor that loads lanes stored by StoreLanes (e.g.
+// HHCompactCat::lanes) instead of deriving the state from a key.
+struct HHLoadLanesTag {};
+
 }  // namespace highwayhash
 #endif
 
@@ -0,0 +1,410 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Prints or verifies HighwayHash checksums of files, similar to sha256sum and
+// b3sum, using all cores.
+//
+// Usage: hhsum [options] [file...]    ("-" or no files: standard input)
+//   --bits=64|128|256     hash size (default 256)
+//   --key=HEX             64 hex digits: key[0] .. key[3], 16 digits each.
+//                         The default key is public; use a secret key if the
+//                         checksums must resist deliberate collisions.
+//   --threads=N           worker threads (default: NumUsableCPUs)
+//   --tree_threshold=N    files of at least N bytes (default 16 MiB) are
+//                         hashed with HighwayTreeHash using all threads.
+//                         Their checksums differ from HighwayHash and are
+//                         therefore tagged, see below.
+//   --check, -c           the files contain lines printed by hhsum; verifies
+//                         the checksums of the files named there with the
+//                         algorithm recorded in each line (--tree_threshold
+//                         is ignored).
+//   --stats               prints throughput to stderr.
+//
+// Standard input is read via HighwayHashStream (never tree hashed).
+// Output lines are "<hex>  <path>", where <hex> is the little-endian lanes of
+// the HHResult, most-significant digit first per lane, lane 0 first. Lines of
+// tree-hashed files are "tree:<hex>  <path>", so that the checksums do not
+// depend on the threshold at which they are verified. The exit status is
+// nonzero if any file could not be read or failed verification.
+//
+// Files are distributed among the ThreadPool workers. Files smaller than
+// kReadThreshold are read into a buffer, which is cheaper than mapping them;
+// larger ones are mapped via HighwayHashFile. Files above the tree threshold
+// are hashed one at a time afterwards, each with all workers.
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/file_hash.h"
+#include "highwayhash/highwayhash_dispatch.h"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define OS_POSIX 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define OS_POSIX 0
+#endif
+
+namespace highwayhash {
+namespace {
+
+// Files smaller than this are read instead of mapped.
+const size_t kReadThreshold = 1 << 20;
+
+const uint64_t kDefaultTreeThreshold = 16ULL << 20;
+
+// Prefix of output lines whose checksum is a HighwayTreeHash.
+const char kTreeTag[] = "tree:";
+const size_t kTreeTagLength = sizeof(kTreeTag) - 1;
+
+struct Options {
+  HHKey key = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+               0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  size_t num_lanes = 4;  // of 64 bits
+  int num_threads = 0;   // 0 = default
+  uint64_t tree_threshold = kDefaultTreeThreshold;
+  bool check = false;
+  bool stats = false;
+};
+
+// One file to hash, and the result.
+struct Job {
+  std::string path;
+  size_t num_lanes;
+  uint64_t expected[4];  // only used by --check
+
+  bool tree = false;      // HighwayTreeHash (tagged) instead of HighwayHash.
+  bool deferred = false;  // hashed in the second pass.
+  bool ok = false;
+  int error = 0;  // errno if !ok
+  uint64_t size = 0;
+  uint64_t lanes[4];
+};
+
+// Stores the HighwayHash of "size" bytes in job->lanes.
+void HashBytes(const HHKey& key, const char* bytes, const size_t size,
+               Job* job) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  if (job->num_lanes == 1) {
+    functions.hash64(key, bytes, size, &job->lanes[0]);
+  } else if (job->num_lanes == 2) {
+    functions.hash128(key, bytes, size,
+                      reinterpret_cast<HHResult128*>(job->lanes));
+  } else {
+    functions.hash256(key, bytes, size,
+                      reinterpret_cast<HHResult256*>(job->lanes));
+  }
+}
+
+// Calls the file_hash.h function for "Result" and stores the hash in
+// job->lanes. Tree hashing (if job->tree) uses "pool".
+template <typename Result>
+bool HashFileAs(const HHKey& key, ThreadPool* pool, Job* job) {
+  Result* hash = reinterpret_cast<Result*>(job->lanes);
+  if (job->path == "-") {
+    StreamHashStats stats;
+    const bool ok = HighwayHashStream(key, 0, hash, &stats);
+    job->size = stats.bytes;
+    return ok;
+  }
+  if (job->tree) {
+    return HighwayTreeHashFile(key, job->path.c_str(), pool, hash);
+  }
+  return HighwayHashFile(key, job->path.c_str(), hash);
+}
+
+bool HashFile(const HHKey& key, ThreadPool* pool, Job* job) {
+  if (job->num_lanes == 1) {
+    return HashFileAs<HHResult64>(key, pool, job);
+  } else if (job->num_lanes == 2) {
+    return HashFileAs<HHResult128>(key, pool, job);
+  }
+  return HashFileAs<HHResult256>(key, pool, job);
+}
+
+// First pass (on a worker): hashes small files via read() and medium files
+// via HighwayHashFile, and defers tree-hashed files and stdin. Unless
+// checking, decides whether to tree hash.
+void FirstPass(const Options& options, Job* job) {
+  if (job->path == "-") {
+    job->deferred = true;  // stdin is never tree hashed.
+    return;
+  }
+#if OS_POSIX
+  const int fd = open(job->path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    job->error = errno;
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    job->error = errno;
+    close(fd);
+    return;
+  }
+  if (S_ISDIR(info.st_mode)) {
+    job->error = EISDIR;
+    close(fd);
+    return;
+  }
+  job->size = static_cast<uint64_t>(info.st_size);
+  if (!options.check) {
+    job->tree = S_ISREG(info.st_mode) && job->size >= options.tree_threshold;
+  }
+  if (S_ISREG(info.st_mode) && job->size < kReadThreshold && !job->tree) {
+    std::vector<char> contents(job->size);
+    size_t pos = 0;
+    while (pos < contents.size()) {
+      const ssize_t bytes_read =
+          read(fd, contents.data() + pos, contents.size() - pos);
+      if (bytes_read < 0 && errno == EINTR) continue;
+      if (bytes_read <= 0) break;  // error or truncated meanwhile
+      pos += static_cast<size_t>(bytes_read);
+    }
+    job->error = pos == contents.size() ? 0 : (errno != 0 ? errno : EIO);
+    close(fd);
+    if (job->error == 0) {
+      HashBytes(options.key, contents.data(), contents.size(), job);
+      job->ok = true;
+    }
+    return;
+  }
+  close(fd);
+#endif
+  if (job->tree) {
+    job->deferred = true;
+    return;
+  }
+  errno = 0;
+  job->ok = HashFile(options.key, nullptr, job);
+  job->error = job->ok ? 0 : errno;
+}
+
+void PrintHex(const uint64_t* lanes, const size_t num_lanes, FILE* file) {
+  for (size_t i = 0; i < num_lanes; ++i) {
+    fprintf(file, "%016llx", static_cast<unsigned long long>(lanes[i]));
+  }
+}
+
+// Parses 16 * num_lanes hex digits; returns false if invalid.
+bool ParseHex(const char* hex, const size_t num_lanes, uint64_t* lanes) {
+  for (size_t i = 0; i < num_lanes; ++i) {
+    uint64_t lane = 0;
+    for (size_t j = 0; j < 16; ++j) {
+      const char c = hex[i * 16 + j];
+      int digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        return false;
+      }
+      lane = (lane << 4) | static_cast<uint64_t>(digit);
+    }
+    lanes[i] = lane;
+  }
+  return true;
+}
+
+// Appends a Job for each "[tree:]<hex>  <path>" line of "list_path". Returns
+// false if it cannot be read.
+bool ReadChecksums(const char* list_path, std::vector<Job>* jobs,
+                   size_t* num_malformed) {
+  const bool is_stdin = strcmp(list_path, "-") == 0;
+  FILE* list = is_stdin ? stdin : fopen(list_path, "r");
+  if (list == nullptr) {
+    fprintf(stderr, "hhsum: %s: %s\n", list_path, strerror(errno));
+    return false;
+  }
+  std::string line;
+  for (int c = 0; c != EOF;) {
+    line.clear();
+    while ((c = fgetc(list)) != EOF && c != '\n') {
+      line.push_back(static_cast<char>(c));
+    }
+    if (line.empty()) continue;
+
+    Job job;
+    job.tree = line.compare(0, kTreeTagLength, kTreeTag) == 0;
+    if (job.tree) line.erase(0, kTreeTagLength);
+    const size_t num_digits = line.find(' ');
+    job.num_lanes = num_digits / 16;
+    if (num_digits == std::string::npos || num_digits % 16 != 0 ||
+        (job.num_lanes != 1 && job.num_lanes != 2 && job.num_lanes != 4) ||
+        line.size() < num_digits + 3 ||
+        (line[num_digits + 1] != ' ' && line[num_digits + 1] != '*') ||
+        !ParseHex(line.data(), job.num_lanes, job.expected)) {
+      *num_malformed += 1;
+      continue;
+    }
+    job.path = line.substr(num_digits + 2);
+    if (job.tree && job.path == "-") {  // stdin is never tree hashed
+      *num_malformed += 1;
+      continue;
+    }
+    jobs->push_back(job);
+  }
+  if (!is_stdin) fclose(list);
+  return true;
+}
+
+double Now() {
+  using Clock = std::chrono::steady_clock;
+  return std::chrono::duration<double>(Clock::now().time_since_epoch())
+      .count();
+}
+
+void PrintUsage() {
+  fprintf(stderr,
+          "Usage: hhsum [--bits=64|128|256] [--key=HEX] [--threads=N]\n"
+          "             [--tree_threshold=N] [--check|-c] [--stats] "
+          "[file...]\n");
+}
+
+int Run(int argc, char* argv[]) {
+  Options options;
+  std::vector<const char*> paths;
+  bool only_paths = false;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (only_paths || arg[0] != '-' || strcmp(arg, "-") == 0) {
+      paths.push_back(arg);
+    } else if (strcmp(arg, "--") == 0) {
+      only_paths = true;
+    } else if (strncmp(arg, "--bits=", 7) == 0) {
+      const unsigned long bits = strtoul(arg + 7, nullptr, 10);
+      if (bits != 64 && bits != 128 && bits != 256) {
+        PrintUsage();
+        return 2;
+      }
+      options.num_lanes = bits / 64;
+    } else if (strncmp(arg, "--key=", 6) == 0) {
+      if (strlen(arg + 6) != 64 || !ParseHex(arg + 6, 4, options.key)) {
+        fprintf(stderr, "hhsum: --key requires 64 hex digits\n");
+        return 2;
+      }
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      options.num_threads = atoi(arg + 10);
+    } else if (strncmp(arg, "--tree_threshold=", 17) == 0) {
+      options.tree_threshold = strtoull(arg + 17, nullptr, 10);
+    } else if (strcmp(arg, "--check") == 0 || strcmp(arg, "-c") == 0) {
+      options.check = true;
+    } else if (strcmp(arg, "--stats") == 0) {
+      options.stats = true;
+    } else {
+      PrintUsage();
+      return 2;
+    }
+  }
+  if (paths.empty()) paths.push_back("-");
+
+  int status = 0;
+  std::vector<Job> jobs;
+  size_t num_malformed = 0;
+  for (const char* path : paths) {
+    if (options.check) {
+      if (!ReadChecksums(path, &jobs, &num_malformed)) status = 1;
+    } else {
+      Job job;
+      job.path = path;
+      job.num_lanes = options.num_lanes;
+      jobs.push_back(job);
+    }
+  }
+
+  const double t0 = Now();
+  const int num_threads =
+      options.num_threads > 0 ? options.num_threads : NumUsableCPUs();
+  ThreadPool pool(num_threads);
+  pool.Run(0, static_cast<int>(jobs.size()),
+           [&options, &jobs](const int i) { FirstPass(options, &jobs[i]); },
+           ThreadPool::Schedule::kWorkStealing);
+  for (Job& job : jobs) {
+    if (!job.deferred) continue;
+    errno = 0;
+    job.ok = HashFile(options.key, &pool, &job);
+    job.error = job.ok ? 0 : errno;
+  }
+  const double elapsed = Now() - t0;
+
+  size_t num_mismatches = 0;
+  size_t num_unreadable = 0;
+  uint64_t total_bytes = 0;
+  for (const Job& job : jobs) {
+    if (!job.ok) {
+      fprintf(stderr, "hhsum: %s: %s\n", job.path.c_str(),
+              strerror(job.error != 0 ? job.error : EIO));
+      if (options.check) printf("%s: FAILED open or read\n", job.path.c_str());
+      ++num_unreadable;
+      continue;
+    }
+    total_bytes += job.size;
+    if (options.check) {
+      const bool match =
+          memcmp(job.lanes, job.expected, job.num_lanes * 8) == 0;
+      num_mismatches += !match;
+      printf("%s: %s\n", job.path.c_str(), match ? "OK" : "FAILED");
+    } else {
+      if (job.tree) fputs(kTreeTag, stdout);
+      PrintHex(job.lanes, job.num_lanes, stdout);
+      printf("  %s\n", job.path.c_str());
+    }
+  }
+
+  if (num_malformed != 0) {
+    fprintf(stderr, "hhsum: WARNING: %zu lines are improperly formatted\n",
+            num_malformed);
+    status = 1;
+  }
+  if (num_unreadable != 0) {
+    if (options.check) {
+      fprintf(stderr, "hhsum: WARNING: %zu listed files could not be read\n",
+              num_unreadable);
+    }
+    status = 1;
+  }
+  if (num_mismatches != 0) {
+    fprintf(stderr,
+            "hhsum: WARNING: %zu computed checksums did NOT match\n",
+            num_mismatches);
+    status = 1;
+  }
+  if (options.stats) {
+    fprintf(stderr,
+            "hhsum: %zu files, %.1f MiB in %.3f s: %.1f MiB/s, %.0f files/s "
+            "(%d threads)\n",
+            jobs.size(), total_bytes / 1048576.0, elapsed,
+            total_bytes / 1048576.0 / elapsed, jobs.size() / elapsed,
+            num_threads);
+  }
+  return status;
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) { return highwayhash::Run(argc, argv); }
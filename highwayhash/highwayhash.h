@@ -27,8 +27,11 @@
 // dependencies must not define any function unless it is static inline and/or
 // within namespace HH_TARGET_NAME. See arch_specific.h for details.
 
+#include <string.h>  // memcpy
+
 #include "highwayhash/arch_specific.h"
 #include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
 #include "highwayhash/hh_types.h"
 
 #if HH_ARCH_X64
@@ -39,7 +42,9 @@
 // object in a target-specific namespace, e.g. AVX2::HHStateAVX2.
 // Attempts to use "computed includes" (#define MACRO "path/or_just_filename",
 // #include MACRO) fail with 'file not found', so we need an #if chain.
-#if HH_TARGET == HH_TARGET_AVX2
+#if HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/hh_avx512.h"
+#elif HH_TARGET == HH_TARGET_AVX2
 #include "highwayhash/hh_avx2.h"
 #elif HH_TARGET == HH_TARGET_SSE41
 #include "highwayhash/hh_sse41.h"
@@ -47,6 +52,8 @@
 #include "highwayhash/hh_vsx.h"
 #elif HH_TARGET == HH_TARGET_NEON
 #include "highwayhash/hh_neon.h"
+#elif HH_TARGET == HH_TARGET_Generic
+#include "highwayhash/hh_generic.h"
 #elif HH_TARGET == HH_TARGET_Portable
 #include "highwayhash/hh_portable.h"
 #else
@@ -114,6 +121,616 @@ HH_INLINE void HighwayHashT(State* HH_RESTRICT state,
   // EndIACA();
 }
 
+// Same results as HighwayHashT with "hash" and, starting again from the same
+// initial state, with "wider_hash", but the input is only hashed once and the
+// two Finalize share their permute rounds. The results must be HHResult64
+// and HHResult128, or HHResult128 and HHResult256 (in that order); see
+// HHStateT::Finalize. Useful for e.g. a bucket index plus a fingerprint.
+template <class State, typename Result, typename WiderResult>
+HH_INLINE void HighwayHashT(State* HH_RESTRICT state,
+                            const char* HH_RESTRICT bytes, const size_t size,
+                            Result* HH_RESTRICT hash,
+                            WiderResult* HH_RESTRICT wider_hash) {
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < truncated; offset += sizeof(HHPacket)) {
+    state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset));
+  }
+
+  if (remainder != 0) {
+    state->UpdateRemainder(bytes + truncated, remainder);
+  }
+
+  state->Finalize(hash, wider_hash);
+}
+
+// Calls State::UpdateRemainderFixed unless there is no remainder.
+template <size_t kSizeMod32>
+struct HHFixedRemainder {
+  template <class State>
+  static HH_INLINE void Update(State* HH_RESTRICT state,
+                               const char* HH_RESTRICT bytes) {
+    state->template UpdateRemainderFixed<kSizeMod32>(bytes);
+  }
+};
+
+template <>
+struct HHFixedRemainder<0> {
+  template <class State>
+  static HH_INLINE void Update(State* HH_RESTRICT, const char* HH_RESTRICT) {}
+};
+
+// Same result as HighwayHashT(state, bytes, kSize, hash), but for inputs whose
+// size is a compile-time constant, e.g. fixed-width keys such as UUIDs. The
+// packet loop has a constant trip count (and is unrolled for short inputs),
+// and the remainder is loaded without size-dependent branches or masks.
+template <size_t kSize, class State, typename Result>
+HH_INLINE void HighwayHashFixedT(State* HH_RESTRICT state,
+                                 const char* HH_RESTRICT bytes,
+                                 Result* HH_RESTRICT hash) {
+  const size_t kTruncated = kSize & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < kTruncated; offset += sizeof(HHPacket)) {
+    state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset));
+  }
+  HHFixedRemainder<kSize & (sizeof(HHPacket) - 1)>::Update(state,
+                                                            bytes + kTruncated);
+  state->Finalize(hash);
+}
+
+// Same result as HighwayHashT(state, bytes, size, hash), but only for short
+// inputs (size <= 32), and the caller promises that 32 bytes starting at
+// "bytes" are readable (e.g. keys stored in padded slots), even if "size" is
+// less. There is no packet loop, and the remainder is loaded without
+// size-dependent branches, which helps if successive sizes are unpredictable.
+template <class State, typename Result>
+HH_INLINE void HighwayHashShortT(State* HH_RESTRICT state,
+                                 const char* HH_RESTRICT bytes,
+                                 const size_t size, Result* HH_RESTRICT hash) {
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  if (remainder != 0) {
+    state->UpdateRemainderReadable(bytes, remainder);
+  } else if (size != 0) {
+    state->Update(*reinterpret_cast<const HHPacket*>(bytes));
+  }
+  state->Finalize(hash);
+}
+
+// Same result as HighwayHashT(state, bytes, size, hash) for any size, but the
+// caller promises that at least 32 bytes after the end of the input are
+// readable (e.g. arena allocations with padding). The remainder is then loaded
+// via UpdateRemainderReadable, which targets may implement with full unaligned
+// loads and masks instead of size-dependent partial loads.
+template <class State, typename Result>
+HH_INLINE void HighwayHashPaddedT(State* HH_RESTRICT state,
+                                  const char* HH_RESTRICT bytes,
+                                  const size_t size, Result* HH_RESTRICT hash) {
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < truncated; offset += sizeof(HHPacket)) {
+    state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset));
+  }
+  if (remainder != 0) {
+    state->UpdateRemainderReadable(bytes + truncated, remainder);
+  }
+  state->Finalize(hash);
+}
+
+// Same result as HighwayHashT(state, bytes, size, hash), and also copies the
+// "size" bytes to "copy", which must not overlap "bytes". Each packet is
+// loaded once and then both stored and hashed, so the input is only read from
+// memory once instead of twice for a memcpy followed by HighwayHashT, e.g.
+// when receiving payloads into application buffers.
+template <class State, typename Result>
+HH_INLINE void HighwayHashCopyT(State* HH_RESTRICT state,
+                                const char* HH_RESTRICT bytes,
+                                const size_t size, char* HH_RESTRICT copy,
+                                Result* HH_RESTRICT hash) {
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < truncated; offset += sizeof(HHPacket)) {
+    // (The compiler keeps the packet in registers.)
+    HH_ALIGNAS(32) HHPacket packet;
+    memcpy(packet, bytes + offset, sizeof(HHPacket));
+    memcpy(copy + offset, packet, sizeof(HHPacket));
+    state->Update(packet);
+  }
+
+  if (remainder != 0) {
+    memcpy(copy + truncated, bytes + truncated, remainder);
+    state->UpdateRemainder(bytes + truncated, remainder);
+  }
+
+  state->Finalize(hash);
+}
+
+// Same result as HighwayHashT(state, bytes, size, hash), but for large inputs
+// that are read once and not accessed again (e.g. backup streams much larger
+// than the last-level cache). Prefetches the cache line "prefetch_distance"
+// bytes ahead with a non-temporal hint, so that the input is already in flight
+// when needed and displaces less of the caller's working set. Shorter inputs
+// are hashed without prefetching. Only a hint; has no effect on MSVC.
+template <class State, typename Result>
+HH_INLINE void HighwayHashNonTemporalT(
+    State* HH_RESTRICT state, const char* HH_RESTRICT bytes, const size_t size,
+    Result* HH_RESTRICT hash,
+    const size_t prefetch_distance = HH_PREFETCH_DISTANCE) {
+  const size_t kLineSize = 2 * sizeof(HHPacket);
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  size_t offset = 0;
+  // One prefetch per (unaligned) 64-byte line, i.e. every two packets, until
+  // the prefetched address would lie beyond the last whole packet.
+  if (truncated >= prefetch_distance + kLineSize) {
+    const size_t end = truncated - prefetch_distance - kLineSize;
+    for (; offset <= end; offset += kLineSize) {
+      HH_PREFETCH_NTA(bytes + offset + prefetch_distance);
+      state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset));
+      state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset +
+                                                       sizeof(HHPacket)));
+    }
+  }
+  for (; offset < truncated; offset += sizeof(HHPacket)) {
+    state->Update(*reinterpret_cast<const HHPacket*>(bytes + offset));
+  }
+
+  if (remainder != 0) {
+    state->UpdateRemainder(bytes + truncated, remainder);
+  }
+
+  state->Finalize(hash);
+}
+
+// Hashes any number of inputs with the same key. Resetting HHStateT (loading
+// the key, xoring the constants and rotating) is a noticeable fraction of the
+// cost for short inputs; this does so only once, in the constructor, and
+// then starts each hash from a copy of the resulting state. The results are
+// identical to HighwayHashT with a new HHStateT<Target>(key). Thread-safe
+// after construction because hashing does not modify the prepared state.
+template <TargetBits Target>
+class HighwayHashKeyedT {
+ public:
+  explicit HH_INLINE HighwayHashKeyedT(const HHKey& key) : prepared_(key) {}
+
+  // Stores a 64/128/256 bit hash of "bytes" in "hash".
+  template <typename Result>
+  HH_INLINE void operator()(const char* HH_RESTRICT bytes, const size_t size,
+                            Result* HH_RESTRICT hash) const {
+    HHStateT<Target> state = prepared_;
+    HighwayHashT(&state, bytes, size, hash);
+  }
+
+  // The state after Reset, which can also be copied into other HHStateT.
+  HH_INLINE const HHStateT<Target>& Prepared() const { return prepared_; }
+
+ private:
+  HHStateT<Target> prepared_;
+};
+
+// Computes HighwayHash of each of the "num_messages" independent "messages"
+// and stores them in "hashes" (one HHResult* per message). The results are
+// identical to calling HighwayHashT for each message.
+//
+// Each Update depends on the previous one (multiply, ZipperMerge), so hashing
+// one message at a time leaves most execution ports idle. This instead hashes
+// pairs of messages in lockstep so that their dependency chains overlap. The
+// key is also only Reset once per call. Interleaving more than two states did
+// not help in our measurements, presumably because their registers spill.
+template <TargetBits Target, typename Result>
+HH_INLINE void HighwayHashBatchT(const HHKey& key,
+                                 const StringView* HH_RESTRICT messages,
+                                 const size_t num_messages,
+                                 Result* HH_RESTRICT hashes) {
+  const HHStateT<Target> initial(key);
+
+  size_t i = 0;
+  for (; i + 2 <= num_messages; i += 2) {
+    const char* bytes0 = messages[i + 0].data;
+    const char* bytes1 = messages[i + 1].data;
+    const size_t size0 = messages[i + 0].num_bytes;
+    const size_t size1 = messages[i + 1].num_bytes;
+
+    // Whole packets shared by both messages are hashed in lockstep.
+    const size_t min_size = size0 < size1 ? size0 : size1;
+    const size_t both = min_size & ~(sizeof(HHPacket) - 1);
+
+    HHStateT<Target> state0 = initial;
+    HHStateT<Target> state1 = initial;
+    for (size_t offset = 0; offset < both; offset += sizeof(HHPacket)) {
+      state0.Update(*reinterpret_cast<const HHPacket*>(bytes0 + offset));
+      state1.Update(*reinterpret_cast<const HHPacket*>(bytes1 + offset));
+    }
+
+    // Any remaining packets, the remainder and Finalize. "both" is a multiple
+    // of the packet size, so size - both has the same remainder as size.
+    HighwayHashT(&state0, bytes0 + both, size0 - both, &hashes[i + 0]);
+    HighwayHashT(&state1, bytes1 + both, size1 - both, &hashes[i + 1]);
+  }
+
+  if (i < num_messages) {
+    HHStateT<Target> state = initial;
+    HighwayHashT(&state, messages[i].data, messages[i].num_bytes, &hashes[i]);
+  }
+}
+
+// Computes HighwayHash of the same input under each of "kNumKeys" (1 to 4)
+// "keys" and stores them in the corresponding elements of "hashes", e.g. to
+// compute digests under both the old and new key during key rotation. The
+// results are identical to separate HighwayHashT, but the input is read only
+// once and each packet is passed to all states in lockstep. Unlike
+// HighwayHashBatchT, four states do not run out of registers because they
+// share the packet.
+template <TargetBits Target, size_t kNumKeys, typename Result>
+HH_INLINE void HighwayHashMultiKeyT(const HHKey* HH_RESTRICT keys,
+                                    const char* HH_RESTRICT bytes,
+                                    const size_t size,
+                                    Result* HH_RESTRICT hashes) {
+  static_assert(1 <= kNumKeys && kNumKeys <= 4, "Use 1 to 4 keys");
+  // Separate variables rather than an array, which compilers keep in memory.
+  // The states beyond kNumKeys are unused and optimized out.
+  HHStateT<Target> state0(keys[0]);
+  HHStateT<Target> state1(keys[kNumKeys > 1 ? 1 : 0]);
+  HHStateT<Target> state2(keys[kNumKeys > 2 ? 2 : 0]);
+  HHStateT<Target> state3(keys[kNumKeys > 3 ? 3 : 0]);
+
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < truncated; offset += sizeof(HHPacket)) {
+    const HHPacket& packet = *reinterpret_cast<const HHPacket*>(bytes + offset);
+    state0.Update(packet);
+    if (kNumKeys > 1) state1.Update(packet);
+    if (kNumKeys > 2) state2.Update(packet);
+    if (kNumKeys > 3) state3.Update(packet);
+  }
+
+  // The remainder (if any) and Finalize.
+  const char* rest = bytes + truncated;
+  const size_t rest_size = size - truncated;
+  HighwayHashT(&state0, rest, rest_size, &hashes[0]);
+  if (kNumKeys > 1) HighwayHashT(&state1, rest, rest_size, &hashes[1]);
+  if (kNumKeys > 2) HighwayHashT(&state2, rest, rest_size, &hashes[2]);
+  if (kNumKeys > 3) HighwayHashT(&state3, rest, rest_size, &hashes[3]);
+}
+
+// Same result as HighwayHashT of the 8 little-endian bytes of "value", e.g.
+// for integer keys. Avoids the size-dependent branches of HighwayHashT because
+// the size is known (see HighwayHashFixedT).
+template <class State, typename Result>
+HH_INLINE void HighwayHashU64T(State* HH_RESTRICT state, const uint64_t value,
+                               Result* HH_RESTRICT hash) {
+  char bytes[8];
+  for (int i = 0; i < 8; ++i) {
+    bytes[i] = static_cast<char>(value >> (i * 8));
+  }
+  HighwayHashFixedT<8>(state, bytes, hash);
+}
+
+// As above, for the 4 little-endian bytes of "value".
+template <class State, typename Result>
+HH_INLINE void HighwayHashU32T(State* HH_RESTRICT state, const uint32_t value,
+                               Result* HH_RESTRICT hash) {
+  char bytes[4];
+  for (int i = 0; i < 4; ++i) {
+    bytes[i] = static_cast<char>(value >> (i * 8));
+  }
+  HighwayHashFixedT<4>(state, bytes, hash);
+}
+
+// Stores HighwayHashU64T (or U32T, depending on the type of "values") of each
+// of the "num_values" "values" in the corresponding element of "hashes", e.g.
+// to hash a column of join keys. The key is only Reset once per call. Unlike
+// HighwayHashBatchT, this does not interleave states: the hashes are
+// independent, so the CPU already overlaps successive iterations, and
+// explicitly updating four states in lockstep was slower due to spills.
+template <TargetBits Target, typename Value, typename Result>
+HH_INLINE void HighwayHashValuesT(const HHKey& key,
+                                  const Value* HH_RESTRICT values,
+                                  const size_t num_values,
+                                  Result* HH_RESTRICT hashes) {
+  static_assert(sizeof(Value) == 4 || sizeof(Value) == 8, "Use U32 or U64");
+  const HHStateT<Target> initial(key);
+  for (size_t i = 0; i < num_values; ++i) {
+    HHStateT<Target> state = initial;
+    char bytes[sizeof(Value)];
+    for (size_t j = 0; j < sizeof(Value); ++j) {
+      bytes[j] = static_cast<char>(values[i] >> (j * 8));
+    }
+    HighwayHashFixedT<sizeof(Value)>(&state, bytes, &hashes[i]);
+  }
+}
+
+// Stores HighwayHashT of each of the "num_strings" variable-length strings of
+// a column in the Apache Arrow layout in the corresponding element of "hashes",
+// e.g. for hash aggregation, without first building a StringView array.
+//
+// String i consists of the bytes [data + offsets[i], data + offsets[i + 1]),
+// so "offsets" has num_strings + 1 non-decreasing int32_t or int64_t elements.
+// "validity" is null if there are no nulls, otherwise a bitmap whose bit i % 8
+// of byte i / 8 is zero if string i is null. The hash of null strings is zero
+// (all bits of Result), which differs from the hash of the empty string.
+//
+// The strings are hashed in order, so the reads of "data" are sequential and
+// benefit from hardware prefetching; there is no need for explicit prefetches.
+template <TargetBits Target, typename Offset, typename Result>
+HH_INLINE void HighwayHashOffsetsT(const HHKey& key,
+                                   const char* HH_RESTRICT data,
+                                   const Offset* HH_RESTRICT offsets,
+                                   const uint8_t* HH_RESTRICT validity,
+                                   const size_t num_strings,
+                                   Result* HH_RESTRICT hashes) {
+  static_assert(sizeof(Offset) == 4 || sizeof(Offset) == 8, "Use int32/64");
+  const HHStateT<Target> initial(key);
+  for (size_t i = 0; i < num_strings; ++i) {
+    if (validity != nullptr && ((validity[i / 8] >> (i % 8)) & 1) == 0) {
+      memset(&hashes[i], 0, sizeof(Result));
+      continue;
+    }
+    HHStateT<Target> state = initial;
+    HighwayHashT(&state, data + offsets[i],
+                 static_cast<size_t>(offsets[i + 1] - offsets[i]), &hashes[i]);
+  }
+}
+
+// Consistent (deterministic) sampling: a row is selected if its HHResult64
+// is less than "threshold", so the same keys are selected by every query and
+// machine using the same key, and the selected rows of a smaller threshold
+// are a subset of those of a larger one. The expected fraction of selected
+// rows is threshold / 2^64.
+
+// Returns the threshold that selects about "fraction" (in [0, 1]) of the rows,
+// i.e. fraction * 2^64 rounded down. 1 maps to ~0, which still rejects rows
+// whose hash is ~0 (a probability of 2^-64).
+static HH_INLINE uint64_t HighwayHashSampleThreshold(const double fraction) {
+  if (!(fraction > 0.0)) return 0;  // also for NaN
+  if (fraction >= 1.0) return ~0ull;
+  return static_cast<uint64_t>(fraction * 18446744073709551616.0);
+}
+
+// Sets bit i % 64 of selected[i / 64] if the HighwayHashValuesT hash of
+// values[i] is less than "threshold" (see above), and returns the number of
+// selected rows. "selected" must have room for (num_values + 63) / 64 words;
+// unused bits of the last are zero. On little-endian hosts, its bytes are an
+// Apache Arrow bitmap, e.g. for a filter kernel; HHSelectionFromBits converts
+// it to a selection vector.
+//
+// The comparison is fused into the hashing loop: each hash is compared as soon
+// as it is finalized, without storing the hashes and comparing them in a
+// second pass. The bits are assembled without data-dependent branches, which
+// the CPU would mispredict for sampling rates near 50%.
+template <TargetBits Target, typename Value>
+HH_INLINE size_t HighwayHashSampleValuesT(const HHKey& key,
+                                          const Value* HH_RESTRICT values,
+                                          const size_t num_values,
+                                          const uint64_t threshold,
+                                          uint64_t* HH_RESTRICT selected) {
+  static_assert(sizeof(Value) == 4 || sizeof(Value) == 8, "Use U32 or U64");
+  const HHStateT<Target> initial(key);
+  size_t num_selected = 0;
+  for (size_t first = 0; first < num_values; first += 64) {
+    const size_t count = num_values - first < 64 ? num_values - first : 64;
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+      HHStateT<Target> state = initial;
+      char bytes[sizeof(Value)];
+      for (size_t j = 0; j < sizeof(Value); ++j) {
+        bytes[j] = static_cast<char>(values[first + i] >> (j * 8));
+      }
+      HHResult64 hash;
+      HighwayHashFixedT<sizeof(Value)>(&state, bytes, &hash);
+      const uint64_t keep = hash < threshold;
+      word |= keep << i;
+      num_selected += static_cast<size_t>(keep);
+    }
+    selected[first / 64] = word;
+  }
+  return num_selected;
+}
+
+// Same as HighwayHashSampleValuesT, for the strings of a column in the Apache
+// Arrow layout (see HighwayHashOffsetsT, which also documents "data",
+// "offsets" and "validity"). Null strings are never selected.
+template <TargetBits Target, typename Offset>
+HH_INLINE size_t HighwayHashSampleOffsetsT(const HHKey& key,
+                                           const char* HH_RESTRICT data,
+                                           const Offset* HH_RESTRICT offsets,
+                                           const uint8_t* HH_RESTRICT validity,
+                                           const size_t num_strings,
+                                           const uint64_t threshold,
+                                           uint64_t* HH_RESTRICT selected) {
+  static_assert(sizeof(Offset) == 4 || sizeof(Offset) == 8, "Use int32/64");
+  const HHStateT<Target> initial(key);
+  size_t num_selected = 0;
+  for (size_t first = 0; first < num_strings; first += 64) {
+    const size_t count = num_strings - first < 64 ? num_strings - first : 64;
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const size_t row = first + i;
+      if (validity != nullptr && ((validity[row / 8] >> (row % 8)) & 1) == 0) {
+        continue;
+      }
+      HHStateT<Target> state = initial;
+      HHResult64 hash;
+      HighwayHashT(&state, data + offsets[row],
+                   static_cast<size_t>(offsets[row + 1] - offsets[row]), &hash);
+      const uint64_t keep = hash < threshold;
+      word |= keep << i;
+      num_selected += static_cast<size_t>(keep);
+    }
+    selected[first / 64] = word;
+  }
+  return num_selected;
+}
+
+// Stores the index of each set bit of the "num_rows" bits of "bits" (in the
+// layout of HighwayHashSampleValuesT) in ascending order in "selection" and
+// returns their number. "selection" must have room for that many indices,
+// e.g. the return value of HighwayHashSample*T. Only visits set bits, so the
+// cost is proportional to the number of selected rows plus num_rows / 64.
+static HH_INLINE size_t HHSelectionFromBits(const uint64_t* HH_RESTRICT bits,
+                                            const size_t num_rows,
+                                            uint32_t* HH_RESTRICT selection) {
+  size_t num_selected = 0;
+  for (size_t w = 0; w < (num_rows + 63) / 64; ++w) {
+    uint64_t word = bits[w];
+    while (word != 0) {
+#if HH_MSC_VERSION
+      unsigned long bit;
+      _BitScanForward64(&bit, word);
+#else
+      const int bit = __builtin_ctzll(word);
+#endif
+      selection[num_selected++] = static_cast<uint32_t>(w * 64 + bit);
+      word &= word - 1;  // clear lowest set bit
+    }
+  }
+  return num_selected;
+}
+
+// Returns 1 if "a" and "b" differ, otherwise 0, without data-dependent
+// branches or early exits, so that the time does not reveal how many leading
+// bytes of a forged tag were correct.
+static HH_INLINE uint64_t HHResultsDiffer(const HHResult64 a,
+                                          const HHResult64 b) {
+  const uint64_t x = a ^ b;
+  return (x | (0 - x)) >> 63;
+}
+
+static HH_INLINE uint64_t HHResultsDiffer(const HHResult128& a,
+                                          const HHResult128& b) {
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2 || \
+    HH_TARGET == HH_TARGET_SSE41
+  using HH_TARGET_NAME::LoadUnaligned;
+  using HH_TARGET_NAME::V2x64U;
+  const V2x64U x = LoadUnaligned<V2x64U>(a) ^ LoadUnaligned<V2x64U>(b);
+  return static_cast<uint64_t>(1 - _mm_testz_si128(x, x));
+#else
+  return HHResultsDiffer((a[0] ^ b[0]) | (a[1] ^ b[1]), 0);
+#endif
+}
+
+static HH_INLINE uint64_t HHResultsDiffer(const HHResult256& a,
+                                          const HHResult256& b) {
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2
+  using HH_TARGET_NAME::LoadUnaligned;
+  using HH_TARGET_NAME::V4x64U;
+  const V4x64U x = LoadUnaligned<V4x64U>(a) ^ LoadUnaligned<V4x64U>(b);
+  return static_cast<uint64_t>(1 - _mm256_testz_si256(x, x));
+#elif HH_TARGET == HH_TARGET_SSE41
+  using HH_TARGET_NAME::LoadUnaligned;
+  using HH_TARGET_NAME::V2x64U;
+  const V2x64U x0 = LoadUnaligned<V2x64U>(a) ^ LoadUnaligned<V2x64U>(b);
+  const V2x64U x1 = LoadUnaligned<V2x64U>(a + 2) ^ LoadUnaligned<V2x64U>(b + 2);
+  const V2x64U x = x0 | x1;
+  return static_cast<uint64_t>(1 - _mm_testz_si128(x, x));
+#else
+  return HHResultsDiffer(
+      (a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3]), 0);
+#endif
+}
+
+// Number of messages per HighwayHashBatchT call in HighwayHashVerifyT, which is
+// also the number of bits per word of its "failures".
+static constexpr size_t kHighwayHashVerifyBatch = 64;
+
+// Verifies HighwayHash (used as a MAC) tags of "num_messages" "messages":
+// sets bit i % 64 of failures[i / 64] if the HighwayHashT of message i under
+// "key" differs from expected[i], and returns the number of such mismatches.
+// "failures" must have room for (num_messages + 63) / 64 words; unused bits
+// of the last are zero.
+//
+// The tags are computed via HighwayHashBatchT and compared with
+// HHResultsDiffer. The running time thus depends only on the number and sizes
+// of the messages, not on the contents of "expected", unlike memcmp.
+template <TargetBits Target, typename Result>
+HH_INLINE size_t HighwayHashVerifyT(const HHKey& key,
+                                    const StringView* HH_RESTRICT messages,
+                                    const Result* HH_RESTRICT expected,
+                                    const size_t num_messages,
+                                    uint64_t* HH_RESTRICT failures) {
+  Result tags[kHighwayHashVerifyBatch];
+  size_t num_failures = 0;
+  for (size_t first = 0; first < num_messages;
+       first += kHighwayHashVerifyBatch) {
+    const size_t count = num_messages - first < kHighwayHashVerifyBatch
+                             ? num_messages - first
+                             : kHighwayHashVerifyBatch;
+    HighwayHashBatchT<Target>(key, messages + first, count, tags);
+    uint64_t word = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const uint64_t differ = HHResultsDiffer(tags[i], expected[first + i]);
+      word |= differ << i;
+      num_failures += static_cast<size_t>(differ);
+    }
+    failures[first / kHighwayHashVerifyBatch] = word;
+  }
+  return num_failures;
+}
+
+// Number of independent states ("lanes") in HighwayHashWideT. Changing this
+// would change all results.
+static constexpr size_t kHighwayHashWideLanes = 4;
+
+// Computes a "wide" hash of "bytes", which is faster than HighwayHashT for
+// long inputs but returns different results. As with SipTreeHash, packet i of
+// each group of kHighwayHashWideLanes consecutive packets updates lane i, so
+// that the lanes' dependency chains overlap. Each lane uses a different key
+// derived from "key". Lane 0 then absorbs the 256-bit hashes of the other
+// lanes, a packet holding the little-endian 64-bit "size" and finally the
+// partial group at the end of the input.
+//
+// "bytes" is the data to hash (possibly unaligned).
+// "size" is the number of bytes to hash; we do not read any additional bytes.
+// "hash" is a HHResult* (either 64, 128 or 256 bits).
+//
+// The results are the same for all targets. This is slower than HighwayHashT
+// for inputs shorter than a few KiB due to the additional Finalize calls.
+template <TargetBits Target, typename Result>
+HH_INLINE void HighwayHashWideT(const HHKey& key,
+                                const char* HH_RESTRICT bytes,
+                                const size_t size, Result* HH_RESTRICT hash) {
+  const uint64_t kTweak = 0x4848576964650000ull;  // "HHWide" in ASCII.
+  HHKey keys[kHighwayHashWideLanes];
+  for (size_t lane = 0; lane < kHighwayHashWideLanes; ++lane) {
+    for (int i = 0; i < 4; ++i) {
+      keys[lane][i] = key[i] ^ (kTweak + lane * 4 + i);
+    }
+  }
+
+  HHStateT<Target> state0(keys[0]);
+  HHStateT<Target> state1(keys[1]);
+  HHStateT<Target> state2(keys[2]);
+  HHStateT<Target> state3(keys[3]);
+
+  const size_t kGroupSize = kHighwayHashWideLanes * sizeof(HHPacket);
+  const size_t truncated = size - size % kGroupSize;
+  for (size_t offset = 0; offset < truncated; offset += kGroupSize) {
+    const HHPacket* packets = reinterpret_cast<const HHPacket*>(bytes + offset);
+    state0.Update(packets[0]);
+    state1.Update(packets[1]);
+    state2.Update(packets[2]);
+    state3.Update(packets[3]);
+  }
+
+  // Each packet holds little-endian lanes so that the result does not depend
+  // on the byte order.
+  HH_ALIGNAS(32) uint64_t packets[kHighwayHashWideLanes][4];
+  state1.Finalize(&packets[0]);
+  state2.Finalize(&packets[1]);
+  state3.Finalize(&packets[2]);
+  for (size_t lane = 0; lane < kHighwayHashWideLanes - 1; ++lane) {
+    for (int i = 0; i < 4; ++i) {
+      packets[lane][i] = le64_from_host(packets[lane][i]);
+    }
+  }
+  packets[kHighwayHashWideLanes - 1][0] = le64_from_host(size);
+  packets[kHighwayHashWideLanes - 1][1] = 0;
+  packets[kHighwayHashWideLanes - 1][2] = 0;
+  packets[kHighwayHashWideLanes - 1][3] = 0;
+  for (size_t lane = 0; lane < kHighwayHashWideLanes; ++lane) {
+    state0.Update(*reinterpret_cast<const HHPacket*>(packets[lane]));
+  }
+
+  HighwayHashT(&state0, bytes + truncated, size - truncated, hash);
+}
+
 // Wrapper class for incrementally hashing a series of data ranges. The final
 // result is the same as HighwayHashT of the concatenation of all the ranges.
 // This is useful for computing the hash of cords, iovecs, and similar
@@ -126,6 +743,14 @@ class HighwayHashCatT {
     HHStateT<Target>::ZeroInitialize(buffer_);
   }
 
+  // Resumes from "compact"; see Load.
+  explicit HH_INLINE HighwayHashCatT(const HHCompactCat& compact)
+      : state_(HHLoadLanesTag(), compact.lanes) {
+    memcpy(buffer_, compact.buffer, sizeof(compact.buffer));
+    buffer_[sizeof(compact.buffer)] = 0;  // never valid, see buffer_usage
+    buffer_usage_ = compact.buffer_usage;
+  }
+
   // Resets the state of the hasher so it can be used to hash a new string.
   HH_INLINE void Reset(const HHKey& key) {
     state_.Reset(key);
@@ -140,7 +765,8 @@ class HighwayHashCatT {
   // as {"", "A"}. To prevent this when hashing independent fields, you can
   // append some extra (non-empty) data when a field is empty, or
   // unconditionally also Append the field length. Either option would ensure
-  // the two examples above result in a different hash.
+  // the two examples above result in a different hash. HashFields in
+  // highwayhash_fields.h does the latter.
   //
   // There are no alignment requirements.
   HH_INLINE void Append(const char* HH_RESTRICT bytes, size_t num_bytes) {
@@ -158,36 +784,166 @@ class HighwayHashCatT {
     // Restrict-qualified pointers to external state or the state_ member are
     // not sufficient for keeping this in registers.
     HHStateT<Target> state_copy = state_;
+    buffer_usage_ =
+        UpdateAndBuffer(&state_copy, buffer_usage_, bytes, num_bytes);
+    state_ = state_copy;
+    // EndIACA();
+  }
 
-    // Have prior bytes to flush.
-    const size_t buffer_usage = buffer_usage_;
-    if (HH_LIKELY(buffer_usage != 0)) {
-      // Calls update with prior buffer contents plus new data. Does not modify
-      // the buffer because some implementations can load into SIMD registers
-      // and Append to them directly.
-      state_copy.AppendAndUpdate(bytes, capacity, buffer_, buffer_usage);
+  // Equivalent to Append(bytes, num_bytes) followed by copying them to "copy"
+  // (which must not overlap "bytes"), but reads "bytes" only once, as in
+  // HighwayHashCopyT.
+  HH_INLINE void AppendCopy(const char* HH_RESTRICT bytes, size_t num_bytes,
+                            char* HH_RESTRICT copy) {
+    const size_t capacity = sizeof(HHPacket) - buffer_usage_;
+    if (HH_UNLIKELY(num_bytes < capacity)) {
+      memcpy(copy, bytes, num_bytes);
+      HHStateT<Target>::AppendPartial(bytes, num_bytes, buffer_, buffer_usage_);
+      buffer_usage_ += num_bytes;
+      return;
+    }
+
+    // See Append.
+    HHStateT<Target> state_copy = state_;
+    if (HH_LIKELY(buffer_usage_ != 0)) {
+      memcpy(copy, bytes, capacity);
+      state_copy.AppendAndUpdate(bytes, capacity, buffer_, buffer_usage_);
       bytes += capacity;
+      copy += capacity;
       num_bytes -= capacity;
     }
 
-    // Buffer currently empty => Update directly from the source.
     while (num_bytes >= sizeof(HHPacket)) {
-      state_copy.Update(*reinterpret_cast<const HHPacket*>(bytes));
+      HH_ALIGNAS(32) HHPacket packet;
+      memcpy(packet, bytes, sizeof(HHPacket));
+      memcpy(copy, packet, sizeof(HHPacket));
+      state_copy.Update(packet);
       bytes += sizeof(HHPacket);
+      copy += sizeof(HHPacket);
       num_bytes -= sizeof(HHPacket);
     }
 
-    // Unconditionally assign even if zero because we didn't reset to zero
-    // after the AppendAndUpdate above.
+    if (HH_LIKELY(num_bytes != 0)) {
+      memcpy(copy, bytes, num_bytes);
+      HHStateT<Target>::CopyPartial(bytes, num_bytes, buffer_);
+    }
     buffer_usage_ = num_bytes;
+    state_ = state_copy;
+  }
 
+  // Equivalent to Append(bytes, num_bytes), but the caller promises that at
+  // least 32 bytes after "bytes + num_bytes" are readable, as for
+  // HighwayHashPaddedT. Bytes left over after the last whole packet are then
+  // buffered with a single 32-byte copy instead of a size-dependent one.
+  HH_INLINE void AppendPadded(const char* HH_RESTRICT bytes, size_t num_bytes) {
+    const size_t capacity = sizeof(HHPacket) - buffer_usage_;
+    if (HH_UNLIKELY(num_bytes < capacity)) {
+      if (buffer_usage_ == 0) {
+        memcpy(buffer_, bytes, sizeof(HHPacket));
+      } else {
+        HHStateT<Target>::AppendPartial(bytes, num_bytes, buffer_,
+                                        buffer_usage_);
+      }
+      buffer_usage_ += num_bytes;
+      return;
+    }
+
+    // See Append.
+    HHStateT<Target> state_copy = state_;
+    if (HH_LIKELY(buffer_usage_ != 0)) {
+      state_copy.AppendAndUpdate(bytes, capacity, buffer_, buffer_usage_);
+      bytes += capacity;
+      num_bytes -= capacity;
+    }
+    while (num_bytes >= sizeof(HHPacket)) {
+      state_copy.Update(*reinterpret_cast<const HHPacket*>(bytes));
+      bytes += sizeof(HHPacket);
+      num_bytes -= sizeof(HHPacket);
+    }
+    // Bytes after num_bytes are never hashed, see buffer_usage_.
+    memcpy(buffer_, bytes, sizeof(HHPacket));
+    buffer_usage_ = num_bytes;
     state_ = state_copy;
+  }
 
-    // Store any remainders in buffer, no-op if multiple of a packet.
-    if (HH_LIKELY(num_bytes != 0)) {
-      HHStateT<Target>::CopyPartial(bytes, num_bytes, buffer_);
+  // Equivalent to calling Append for each fragment in [begin, end), but faster
+  // for many short fragments because the state is only loaded and stored once,
+  // and the data of the next fragment is prefetched while hashing the current
+  // one. "Iterator" must support ++, != and ->, the latter returning a pointer
+  // to an object with "data" and "num_bytes" members, e.g. const StringView*.
+  template <class Iterator>
+  HH_INLINE void AppendFragments(Iterator begin, const Iterator end) {
+    HHStateT<Target> state_copy = state_;
+    size_t buffer_usage = buffer_usage_;
+    Iterator it = begin;
+    while (it != end) {
+      const char* HH_RESTRICT bytes = it->data;
+      const size_t num_bytes = it->num_bytes;
+      ++it;
+      if (it != end) {
+        HH_PREFETCH(it->data);
+      }
+
+      const size_t capacity = sizeof(HHPacket) - buffer_usage;
+      if (num_bytes < capacity) {
+        HHStateT<Target>::AppendPartial(bytes, num_bytes, buffer_,
+                                        buffer_usage);
+        buffer_usage += num_bytes;
+      } else {
+        buffer_usage =
+            UpdateAndBuffer(&state_copy, buffer_usage, bytes, num_bytes);
+      }
     }
-    // EndIACA();
+    buffer_usage_ = buffer_usage;
+    state_ = state_copy;
+  }
+
+  // Same as Append of the "kNumBytes" (1..8) least-significant bytes of
+  // "value" in little-endian order, e.g. an integer field. Faster because
+  // the bytes are stored directly into the packet buffer, which is then
+  // hashed in place once it is full, without the size-dependent copies in
+  // Append.
+  template <size_t kNumBytes>
+  HH_INLINE void AppendLE(const uint64_t value) {
+    static_assert(1 <= kNumBytes && kNumBytes <= 8, "Invalid kNumBytes");
+    const size_t buffer_usage = buffer_usage_;
+    if (HH_LIKELY(buffer_usage + kNumBytes < sizeof(HHPacket))) {
+      StoreLE<kNumBytes>(value, buffer_ + buffer_usage);
+      buffer_usage_ = buffer_usage + kNumBytes;
+      return;
+    }
+
+    // Completes the packet, hashes it and buffers any remaining bytes.
+    const size_t capacity = sizeof(HHPacket) - buffer_usage;
+    char bytes[8];
+    StoreLE<8>(value, bytes);
+    for (size_t i = 0; i < capacity; ++i) {
+      buffer_[buffer_usage + i] = bytes[i];
+    }
+    state_.Update(buffer_);
+    for (size_t i = capacity; i < kNumBytes; ++i) {
+      buffer_[i - capacity] = bytes[i];
+    }
+    buffer_usage_ = kNumBytes - capacity;
+  }
+
+  // Same as Append of the little-endian bytes of "value", e.g. for records
+  // consisting mostly of fixed-width fields.
+  HH_INLINE void AppendU32(const uint32_t value) { AppendLE<4>(value); }
+  HH_INLINE void AppendU64(const uint64_t value) { AppendLE<8>(value); }
+
+  // Same as AppendU64(lower) followed by AppendU64(upper), i.e. the 16
+  // little-endian bytes of a 128-bit integer.
+  HH_INLINE void AppendU128(const uint64_t lower, const uint64_t upper) {
+    const size_t buffer_usage = buffer_usage_;
+    if (HH_LIKELY(buffer_usage + 16 < sizeof(HHPacket))) {
+      StoreLE<8>(lower, buffer_ + buffer_usage);
+      StoreLE<8>(upper, buffer_ + buffer_usage + 8);
+      buffer_usage_ = buffer_usage + 16;
+      return;
+    }
+    AppendLE<8>(lower);
+    AppendLE<8>(upper);
   }
 
   // Stores the resulting 64, 128 or 256-bit hash of data previously passed to
@@ -198,19 +954,224 @@ class HighwayHashCatT {
     HHStateT<Target> state_copy = state_;
     const size_t buffer_usage = buffer_usage_;
     if (HH_LIKELY(buffer_usage != 0)) {
-      state_copy.UpdateRemainder(buffer_, buffer_usage);
+      // buffer_ is a whole packet, so all 32 bytes are readable.
+      state_copy.UpdateRemainderReadable(buffer_, buffer_usage);
     }
     state_copy.Finalize(hash);
     // EndIACA();
   }
 
+  // Same as Finalize(hash) and Finalize(wider_hash) for the same pairs of
+  // results as the two-result HighwayHashT, but for about the cost of one.
+  template <typename Result, typename WiderResult>
+  HH_INLINE void Finalize(Result* HH_RESTRICT hash,
+                          WiderResult* HH_RESTRICT wider_hash) const {
+    HHStateT<Target> state_copy = state_;
+    const size_t buffer_usage = buffer_usage_;
+    if (HH_LIKELY(buffer_usage != 0)) {
+      state_copy.UpdateRemainderReadable(buffer_, buffer_usage);
+    }
+    state_copy.Finalize(hash, wider_hash);
+  }
+
+  // Stores the state in "compact" (four vector stores on SIMD targets plus
+  // copying the partial packet), e.g. to keep it in an array between
+  // Append calls.
+  HH_INLINE void Store(HHCompactCat* HH_RESTRICT compact) const {
+    state_.StoreLanes(compact->lanes);
+    memcpy(compact->buffer, buffer_, sizeof(compact->buffer));
+    compact->buffer_usage = static_cast<uint8_t>(buffer_usage_);
+  }
+
+  // Replaces the state with that stored in "compact" by Store (possibly on
+  // another target of the same process) or HighwayHashCompactStartT.
+  HH_INLINE void Load(const HHCompactCat& compact) {
+    state_.LoadLanes(compact.lanes);
+    memcpy(buffer_, compact.buffer, sizeof(compact.buffer));
+    buffer_[sizeof(compact.buffer)] = 0;  // never valid, see buffer_usage
+    buffer_usage_ = compact.buffer_usage;
+  }
+
+  // Stores the state after all data previously passed to Append in
+  // "snapshot", which Deserialize accepts on any target and byte order, e.g.
+  // to resume hashing a large object in another process. WARNING: the
+  // snapshot reveals the key (trivially so right after Reset), so it must be
+  // protected like the key itself.
+  //
+  // Format (version 1, integers are little-endian): "HHC", version byte,
+  // buffer_usage byte, 3 zero bytes, 16 uint64 HHStateT::StoreLanes, then the
+  // buffered bytes, padded with zeros to 32 bytes. Identical states always
+  // result in identical snapshots.
+  HH_INLINE void Serialize(HHCatSnapshot* HH_RESTRICT snapshot) const {
+    char* HH_RESTRICT bytes = snapshot->bytes;
+    bytes[0] = 'H';
+    bytes[1] = 'H';
+    bytes[2] = 'C';
+    bytes[3] = kSnapshotVersion;
+    bytes[4] = static_cast<char>(buffer_usage_);
+    bytes[5] = bytes[6] = bytes[7] = 0;
+
+    uint64_t lanes[kNumSnapshotLanes];
+    state_.StoreLanes(lanes);
+    for (size_t i = 0; i < kNumSnapshotLanes; ++i) {
+      StoreLE64(lanes[i], bytes + kSnapshotLanesOffset + i * 8);
+    }
+
+    char* HH_RESTRICT buffer = bytes + kSnapshotBufferOffset;
+    for (size_t i = 0; i < sizeof(HHPacket); ++i) {
+      buffer[i] = (i < buffer_usage_) ? buffer_[i] : 0;
+    }
+  }
+
+  // Replaces the state with that stored in "snapshot" by Serialize (possibly
+  // on another target) and returns true. The key passed to the constructor
+  // or Reset does not matter because the snapshot already depends on the
+  // original key. Returns false and leaves the state unchanged if "snapshot"
+  // is invalid or of an unsupported version.
+  HH_INLINE bool Deserialize(const HHCatSnapshot& snapshot) {
+    const char* HH_RESTRICT bytes = snapshot.bytes;
+    const size_t buffer_usage = static_cast<unsigned char>(bytes[4]);
+    if (bytes[0] != 'H' || bytes[1] != 'H' || bytes[2] != 'C' ||
+        bytes[3] != kSnapshotVersion || buffer_usage >= sizeof(HHPacket) ||
+        bytes[5] != 0 || bytes[6] != 0 || bytes[7] != 0) {
+      return false;
+    }
+
+    uint64_t lanes[kNumSnapshotLanes];
+    for (size_t i = 0; i < kNumSnapshotLanes; ++i) {
+      lanes[i] = LoadLE64(bytes + kSnapshotLanesOffset + i * 8);
+    }
+    state_.LoadLanes(lanes);
+
+    const char* HH_RESTRICT buffer = bytes + kSnapshotBufferOffset;
+    for (size_t i = 0; i < sizeof(HHPacket); ++i) {
+      buffer_[i] = buffer[i];
+    }
+    buffer_usage_ = buffer_usage;
+    return true;
+  }
+
  private:
+  // Must be incremented whenever the snapshot format or the meaning of the
+  // state (i.e. the hash function) changes.
+  static constexpr char kSnapshotVersion = 1;
+  static constexpr size_t kNumSnapshotLanes = 16;
+  static constexpr size_t kSnapshotLanesOffset = 8;
+  static constexpr size_t kSnapshotBufferOffset =
+      kSnapshotLanesOffset + kNumSnapshotLanes * 8;
+  static_assert(kSnapshotBufferOffset + sizeof(HHPacket) ==
+                    sizeof(HHCatSnapshot),
+                "Update HHCatSnapshot");
+
+  static HH_INLINE void StoreLE64(const uint64_t value, char* HH_RESTRICT to) {
+    StoreLE<8>(value, to);
+  }
+
+  // (Compilers merge these into a single store on little-endian CPUs.)
+  template <size_t kNumBytes>
+  static HH_INLINE void StoreLE(const uint64_t value, char* HH_RESTRICT to) {
+    for (size_t i = 0; i < kNumBytes; ++i) {
+      to[i] = static_cast<char>(value >> (i * 8));
+    }
+  }
+
+  static HH_INLINE uint64_t LoadLE64(const char* HH_RESTRICT from) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(from[i]))
+               << (i * 8);
+    }
+    return value;
+  }
+
+  // Feeds the "buffer_usage" bytes in buffer_ followed by "bytes" to "state"
+  // and stores any remaining partial packet in buffer_. Returns the new number
+  // of valid bytes in buffer_. There are no copies if the fragment starts and
+  // ends at packet boundaries. Precondition: "num_bytes" is at least the
+  // remaining capacity of buffer_.
+  HH_INLINE size_t UpdateAndBuffer(HHStateT<Target>* HH_RESTRICT state,
+                                   const size_t buffer_usage,
+                                   const char* HH_RESTRICT bytes,
+                                   size_t num_bytes) {
+    // Have prior bytes to flush.
+    if (HH_LIKELY(buffer_usage != 0)) {
+      // Calls update with prior buffer contents plus new data. Does not modify
+      // the buffer because some implementations can load into SIMD registers
+      // and Append to them directly.
+      const size_t capacity = sizeof(HHPacket) - buffer_usage;
+      state->AppendAndUpdate(bytes, capacity, buffer_, buffer_usage);
+      bytes += capacity;
+      num_bytes -= capacity;
+    }
+
+    // Buffer currently empty => Update directly from the source.
+    while (num_bytes >= sizeof(HHPacket)) {
+      state->Update(*reinterpret_cast<const HHPacket*>(bytes));
+      bytes += sizeof(HHPacket);
+      num_bytes -= sizeof(HHPacket);
+    }
+
+    // Store any remainders in buffer, no-op if multiple of a packet.
+    if (HH_LIKELY(num_bytes != 0)) {
+      HHStateT<Target>::CopyPartial(bytes, num_bytes, buffer_);
+    }
+    return num_bytes;
+  }
+
   HH_ALIGNAS(64) HHPacket buffer_;
   HH_ALIGNAS(32) HHStateT<Target> state_;
   // How many bytes in buffer_ (starting with offset 0) are valid.
   size_t buffer_usage_ = 0;
 };
 
+// Incremental hashing of a tightly packed HHCompactCat, with identical
+// results to HighwayHashCatT. Appends that do not complete a packet only
+// copy into compact->buffer; the others load the state into registers,
+// update it and store it again. Usage:
+// HighwayHashCompactStartT<HH_TARGET>(key, &compact);
+// HighwayHashCompactAppendT<HH_TARGET>(&compact, bytes, size);  // repeated
+// HighwayHashCompactFinalizeT<HH_TARGET>(compact, &hash);
+
+// (Re)initializes "compact" for hashing a new string with "key".
+template <TargetBits Target>
+HH_INLINE void HighwayHashCompactStartT(const HHKey& key,
+                                        HHCompactCat* HH_RESTRICT compact) {
+  const HHStateT<Target> state(key);
+  state.StoreLanes(compact->lanes);
+  // Avoids msan uninitialized-memory warnings in Load.
+  memset(compact->buffer, 0, sizeof(compact->buffer));
+  compact->buffer_usage = 0;
+}
+
+// Same as HighwayHashCatT::Append.
+template <TargetBits Target>
+HH_INLINE void HighwayHashCompactAppendT(HHCompactCat* HH_RESTRICT compact,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t num_bytes) {
+  // Also avoids passing a null "bytes" to memcpy.
+  if (num_bytes == 0) return;
+  const size_t buffer_usage = compact->buffer_usage;
+  if (HH_LIKELY(buffer_usage + num_bytes < sizeof(HHPacket))) {
+    memcpy(compact->buffer + buffer_usage, bytes, num_bytes);
+    compact->buffer_usage = static_cast<uint8_t>(buffer_usage + num_bytes);
+    return;
+  }
+  HighwayHashCatT<Target> cat(*compact);
+  cat.Append(bytes, num_bytes);
+  cat.Store(compact);
+}
+
+// Same as HighwayHashCatT::Finalize; does not modify "compact".
+template <TargetBits Target, typename Result>  // Result = HHResult*
+HH_INLINE void HighwayHashCompactFinalizeT(const HHCompactCat& compact,
+                                           Result* HH_RESTRICT hash) {
+  HHStateT<Target> state(HHLoadLanesTag(), compact.lanes);
+  if (HH_LIKELY(compact.buffer_usage != 0)) {
+    state.UpdateRemainder(compact.buffer, compact.buffer_usage);
+  }
+  state.Finalize(hash);
+}
+
 }  // namespace highwayhash
 #endif  // HH_DISABLE_TARGET_SPECIFIC
 #endif  // HIGHWAYHASH_HIGHWAYHASH_H_
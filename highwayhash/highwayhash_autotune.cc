@@ -0,0 +1,187 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_autotune.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "highwayhash/instruction_sets.h"
+#include "highwayhash/nanobenchmark.h"
+
+namespace highwayhash {
+
+constexpr size_t HighwayHashTuning::kNumSizeClasses;
+constexpr size_t HighwayHashTuning::kMaxSize[];
+constexpr size_t HighwayHashTuning::kMaxTargets;
+
+namespace {
+
+// Representative sizes of each class; each is measured twice per round (see
+// DurationsForInputs for why repeating inputs is helpful).
+constexpr size_t kNumSizesPerClass = 4;
+const FuncInput kSizes[HighwayHashTuning::kNumSizeClasses][kNumSizesPerClass] =
+    {{8, 16, 8, 16},
+     {32, 64, 32, 64},
+     {128, 256, 128, 256},
+     {512, 1024, 512, 1024},
+     {4096, 16384, 4096, 16384}};
+
+// Even, so that CompareDurations runs as many AB as BA rounds.
+constexpr size_t kNumRounds = 8;
+// Far fewer than nanobenchmark's default, because the rounds already reduce
+// variability and calibration should not noticeably delay startup.
+constexpr size_t kSamplesPerRound = 32;
+
+// Minimum average speedup (relative to the default target) of another target.
+constexpr float kMinGain = 0.03f;
+
+constexpr size_t kMaxInput = 16384;
+
+// Stores the table of each supported target, best first.
+template <TargetBits Target>
+struct SelectInto {
+  void operator()(HighwayHashTuning* tuning,
+                  HighwayHashFunctions* functions) const {
+    if (tuning->num_targets == HighwayHashTuning::kMaxTargets) return;
+    tuning->targets[tuning->num_targets] = Target;
+    HighwayHashSelect<Target>()(&functions[tuning->num_targets]);
+    ++tuning->num_targets;
+  }
+};
+
+size_t SelectAll(HighwayHashTuning* tuning, HighwayHashFunctions* functions) {
+  tuning->num_targets = 0;
+  InstructionSets::RunAll<SelectInto>(tuning, functions);
+  return tuning->num_targets;
+}
+
+// Argument of HashInput.
+struct Measured {
+  const HighwayHashFunctions* functions;
+  const char* bytes;
+};
+
+// Func for nanobenchmark: hashes the first "size" bytes.
+FuncOutput HashInput(const void* arg, const FuncInput size) {
+  const Measured& measured = *static_cast<const Measured*>(arg);
+  static const HHKey key = {1, 2, 3, 4};
+  HHResult64 hash;
+  measured.functions->hash64(key, measured.bytes, size, &hash);
+  return hash;
+}
+
+}  // namespace
+
+HighwayHashTuning HighwayHashCalibrate() {
+  HighwayHashTuning tuning = {};
+  HighwayHashFunctions functions[HighwayHashTuning::kMaxTargets];
+  SelectAll(&tuning, functions);
+  tuning.default_target = tuning.targets[0];
+
+  char bytes[kMaxInput];
+  for (size_t i = 0; i < kMaxInput; ++i) {
+    bytes[i] = static_cast<char>(i * 131 + 7);
+  }
+  Measured measured[HighwayHashTuning::kMaxTargets];
+  for (size_t t = 0; t < tuning.num_targets; ++t) {
+    measured[t].functions = &functions[t];
+    measured[t].bytes = bytes;
+  }
+
+  for (size_t c = 0; c < HighwayHashTuning::kNumSizeClasses; ++c) {
+    tuning.best[c] = tuning.default_target;
+    for (size_t t = 1; t < tuning.num_targets; ++t) {
+      DurationsForInputs default_map(kSizes[c], kNumSizesPerClass, kNumRounds);
+      DurationsForInputs other_map(kSizes[c], kNumSizesPerClass, kNumRounds);
+      default_map.samples_per_round = kSamplesPerRound;
+      other_map.samples_per_round = kSamplesPerRound;
+      default_map.verbose = false;
+      other_map.verbose = false;
+      DurationComparison comparisons[kNumSizesPerClass];
+      const size_t num_comparisons = CompareDurations(
+          &HashInput, &HashInput, &default_map, &other_map, comparisons,
+          reinterpret_cast<const uint8_t*>(&measured[0]),
+          reinterpret_cast<const uint8_t*>(&measured[t]));
+      if (num_comparisons == 0) continue;
+
+      // The other target must be faster with confidence for every size,
+      // and by kMinGain on average, otherwise noise could cause a switch.
+      float ticks_default = 0.0f;
+      float ticks_other = 0.0f;
+      float change = 0.0f;
+      bool confidently_faster = true;
+      for (size_t i = 0; i < num_comparisons; ++i) {
+        ticks_default += comparisons[i].median_a / num_comparisons;
+        ticks_other += comparisons[i].median_b / num_comparisons;
+        change += comparisons[i].change / num_comparisons;
+        confidently_faster &= comparisons[i].change_upper < 0.0f;
+      }
+      tuning.ticks[c][0] += ticks_default / (tuning.num_targets - 1);
+      tuning.ticks[c][t] = ticks_other;
+
+      if (confidently_faster && change < -kMinGain &&
+          change < tuning.change[c]) {
+        tuning.best[c] = tuning.targets[t];
+        tuning.change[c] = change;
+      }
+    }
+  }
+  return tuning;
+}
+
+std::string HighwayHashTuning::Summary() const {
+  std::string summary;
+  for (size_t c = 0; c < kNumSizeClasses; ++c) {
+    char line[96];
+    const char* name = TargetName(best[c]);
+    if (c + 1 == kNumSizeClasses) {
+      snprintf(line, sizeof(line), "%s>%zu: %s", c == 0 ? "" : ", ",
+               kMaxSize[c - 1], name);
+    } else {
+      snprintf(line, sizeof(line), "%s<=%zu: %s", c == 0 ? "" : ", ",
+               kMaxSize[c], name);
+    }
+    summary += line;
+
+    if (best[c] != default_target) {
+      snprintf(line, sizeof(line), " (%+.0f%% vs %s)", change[c] * 100.0f,
+               TargetName(default_target));
+      summary += line;
+    }
+  }
+  return summary;
+}
+
+HighwayHashAutotuned::HighwayHashAutotuned(const HighwayHashTuning& tuning)
+    : tuning_(tuning) {
+  HighwayHashTuning selected;
+  SelectAll(&selected, functions_);
+  for (size_t c = 0; c < HighwayHashTuning::kNumSizeClasses; ++c) {
+    by_class_[c] = &functions_[0];
+    for (size_t t = 0; t < selected.num_targets; ++t) {
+      if (selected.targets[t] == tuning_.best[c]) {
+        by_class_[c] = &functions_[t];
+      }
+    }
+  }
+}
+
+const HighwayHashAutotuned& HighwayHashAutotuned::Get() {
+  // Function-local static => calibrates once, even if called concurrently.
+  static const HighwayHashAutotuned autotuned(HighwayHashCalibrate());
+  return autotuned;
+}
+
+}  // namespace highwayhash
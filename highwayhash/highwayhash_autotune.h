@@ -0,0 +1,127 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_AUTOTUNE_H_
+#define HIGHWAYHASH_HIGHWAYHASH_AUTOTUNE_H_
+
+// Optional alternative to HighwayHashDispatch that measures all supported
+// targets and routes each input size class to the fastest, e.g. for CPUs on
+// which AVX2 lowers the clock frequency or has slow permutes, so that SSE4.1
+// is faster for short keys.
+
+#include <stddef.h>
+#include <string>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash_target.h"
+
+namespace highwayhash {
+
+// Measurements of the supported targets and the resulting choices.
+struct HighwayHashTuning {
+  // Class i contains the sizes in (kMaxSize[i - 1], kMaxSize[i]]; the last
+  // class is unbounded.
+  static constexpr size_t kNumSizeClasses = 5;
+  static constexpr size_t kMaxSize[kNumSizeClasses] = {16, 64, 256, 1024,
+                                                       ~size_t(0)};
+  static constexpr size_t kMaxTargets = 8;
+
+  // Returns the index of the class containing "size".
+  static HH_INLINE size_t SizeClass(const size_t size) {
+    size_t size_class = 0;
+    while (size > kMaxSize[size_class]) ++size_class;
+    return size_class;
+  }
+
+  // Returns a single line for logging, e.g. "<=16: SSE41 (-12% vs AVX2),
+  // <=64: AVX2, ...".
+  std::string Summary() const;
+
+  // The target InstructionSets::Run would choose.
+  TargetBits default_target;
+
+  // All supported targets, best first (in the order of InstructionSets).
+  size_t num_targets;
+  TargetBits targets[kMaxTargets];
+
+  // Median ticks (see tsc_timer.h) per hash64 of each target, averaged over
+  // the measured sizes of each class (and, for targets[0], over all of its
+  // comparisons), or zero if there was no alternative to compare with.
+  float ticks[kNumSizeClasses][kMaxTargets];
+
+  // Fastest target of each class. Another target only replaces
+  // default_target if it is faster with 95% confidence for each measured
+  // size and by at least 3% on average, so that measurement noise does not
+  // cause arbitrary choices.
+  TargetBits best[kNumSizeClasses];
+
+  // Average relative change of the duration of best[] versus default_target,
+  // e.g. -0.2 if 20% faster; zero if best[] is the default target.
+  float change[kNumSizeClasses];
+};
+
+// Measures the hash64 of all supported targets on inputs of each size class
+// (via nanobenchmark's CompareDurations against the default target) and
+// returns the results. Takes about a second. The measurement is only
+// meaningful if the CPU is otherwise idle.
+HighwayHashTuning HighwayHashCalibrate();
+
+// Dispatches each hash to the target that HighwayHashCalibrate found fastest
+// for its size class. Results are identical to HighwayHashDispatch because all
+// targets return the same hashes; only the speed differs. Thread-safe.
+//
+// Usage: HighwayHashAutotuned::Get().Hash(key, bytes, size, &hash).
+class HighwayHashAutotuned {
+ public:
+  // Calibrates on the first call, which should thus happen during
+  // initialization (e.g. at startup or when the first hash table is created)
+  // rather than in a latency-sensitive path. Subsequent calls return the
+  // cached decision.
+  static const HighwayHashAutotuned& Get();
+
+  // Returns the implementations for inputs of "size" bytes.
+  HH_INLINE const HighwayHashFunctions& FunctionsFor(const size_t size) const {
+    return *by_class_[HighwayHashTuning::SizeClass(size)];
+  }
+
+  HH_INLINE void Hash(const HHKey& key, const char* HH_RESTRICT bytes,
+                      const size_t size, HHResult64* HH_RESTRICT hash) const {
+    FunctionsFor(size).hash64(key, bytes, size, hash);
+  }
+  HH_INLINE void Hash(const HHKey& key, const char* HH_RESTRICT bytes,
+                      const size_t size, HHResult128* HH_RESTRICT hash) const {
+    FunctionsFor(size).hash128(key, bytes, size, hash);
+  }
+  HH_INLINE void Hash(const HHKey& key, const char* HH_RESTRICT bytes,
+                      const size_t size, HHResult256* HH_RESTRICT hash) const {
+    FunctionsFor(size).hash256(key, bytes, size, hash);
+  }
+
+  // The measurements on which the choices are based, e.g. for logging via
+  // Tuning().Summary().
+  const HighwayHashTuning& Tuning() const { return tuning_; }
+
+ private:
+  explicit HighwayHashAutotuned(const HighwayHashTuning& tuning);
+
+  HighwayHashTuning tuning_;
+  HighwayHashFunctions functions_[HighwayHashTuning::kMaxTargets];
+  const HighwayHashFunctions* by_class_[HighwayHashTuning::kNumSizeClasses];
+};
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_AUTOTUNE_H_
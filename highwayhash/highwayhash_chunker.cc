@@ -0,0 +1,201 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_chunker.h"
+
+#include <algorithm>
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/highwayhash_dispatch.h"
+
+namespace highwayhash {
+namespace {
+
+// Derivation tweak for the Gear table of version 1: "HHChunk1" in ASCII.
+const uint64_t kGearTweak = 0x48484368756E6B31ull;
+
+// The rolling hash of a byte only depends on the preceding bytes within this
+// window because each byte shifts the hash left by one bit.
+const size_t kGearWindow = 64;
+
+// Returns a mask of the "bits" most significant bits. These depend on all
+// bytes in the Gear window, unlike the lower bits.
+uint64_t UpperMask(const int bits) {
+  return ~0ull << (64 - std::min(std::max(bits, 1), 63));
+}
+
+int FloorLog2(size_t x) {
+  int log2 = 0;
+  while (x >>= 1) ++log2;
+  return log2;
+}
+
+// Updates "rolling" with all "size" bytes.
+HH_INLINE void Roll(const uint64_t* HH_RESTRICT gear,
+                    const unsigned char* HH_RESTRICT bytes, const size_t size,
+                    uint64_t* HH_RESTRICT rolling) {
+  uint64_t hash = *rolling;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash << 1) + gear[bytes[i]];
+  }
+  *rolling = hash;
+}
+
+// Updates "rolling" with up to "size" bytes and returns how many were
+// consumed when (rolling & mask) == 0 after a byte, i.e. the chunk ends, or
+// zero if that was not the case for any of the bytes.
+HH_INLINE size_t FindBoundary(const uint64_t* HH_RESTRICT gear,
+                              const unsigned char* HH_RESTRICT bytes,
+                              const size_t size, const uint64_t mask,
+                              uint64_t* HH_RESTRICT rolling) {
+  uint64_t hash = *rolling;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash << 1) + gear[bytes[i]];
+    if (HH_UNLIKELY((hash & mask) == 0)) {
+      *rolling = hash;
+      return i + 1;
+    }
+  }
+  *rolling = hash;
+  return 0;
+}
+
+}  // namespace
+
+HighwayHashChunker::HighwayHashChunker(const HHKey& key,
+                                       const ChunkSizes& sizes)
+    : functions_(HighwayHashDispatch()), sizes_(sizes) {
+  for (int i = 0; i < 4; ++i) {
+    key_[i] = key[i];
+  }
+
+  const int avg_bits = FloorLog2(std::max<size_t>(sizes_.avg_size, 1));
+  sizes_.min_size = std::max<size_t>(sizes_.min_size, 1);
+  sizes_.avg_size = std::max(size_t{1} << avg_bits, sizes_.min_size);
+  sizes_.max_size = std::max(sizes_.max_size, sizes_.avg_size);
+  // Normalization level 2 as recommended by the FastCDC paper.
+  mask_small_ = UpperMask(avg_bits + 2);
+  mask_large_ = UpperMask(avg_bits - 2);
+
+  HHKey gear_key;
+  for (int i = 0; i < 4; ++i) {
+    gear_key[i] = key[i] ^ (kGearTweak + i);
+  }
+  for (int i = 0; i < 256; ++i) {
+    const char byte = static_cast<char>(i);
+    functions_.hash64(gear_key, &byte, 1, &gear_[i]);
+  }
+
+  functions_.cat_start(key_, &cat_);
+}
+
+void HighwayHashChunker::EndChunk(std::vector<HHChunk>* chunks) {
+  HHChunk chunk;
+  chunk.offset = offset_;
+  chunk.size = chunk_size_;
+  functions_.cat_finish128(&cat_, &chunk.hash);
+  chunks->push_back(chunk);
+
+  functions_.cat_start(key_, &cat_);
+  offset_ += chunk_size_;
+  chunk_size_ = 0;
+  rolling_ = 0;
+}
+
+void HighwayHashChunker::Append(const char* HH_RESTRICT bytes,
+                                size_t num_bytes,
+                                std::vector<HHChunk>* chunks) {
+  const unsigned char* HH_RESTRICT ubytes =
+      reinterpret_cast<const unsigned char*>(bytes);
+  // Only the last kGearWindow bytes before min_size affect the first
+  // boundary check, so skip the rest without updating the rolling hash.
+  const size_t roll_begin =
+      sizes_.min_size - std::min(sizes_.min_size, kGearWindow);
+
+  while (num_bytes != 0) {
+    const size_t window_size = std::min(num_bytes, kChunkerWindowSize);
+    size_t pos = 0;
+    size_t unhashed = 0;  // first byte not yet appended to cat_
+    while (pos != window_size) {
+      const size_t remaining = window_size - pos;
+      // Index within the chunk of the next byte; chunk_size_ < max_size.
+      const size_t index = static_cast<size_t>(chunk_size_);
+      size_t consumed;
+      bool boundary = false;
+      if (index < roll_begin) {
+        consumed = std::min(remaining, roll_begin - index);
+      } else if (index + 1 < sizes_.min_size) {
+        consumed = std::min(remaining, sizes_.min_size - 1 - index);
+        Roll(gear_, ubytes + pos, consumed, &rolling_);
+      } else {
+        // Boundaries are possible after the byte at "index". The condition
+        // becomes looser once the chunk reaches avg_size.
+        const bool before_avg = index + 1 < sizes_.avg_size;
+        const size_t limit = before_avg ? sizes_.avg_size - 1 - index
+                                        : sizes_.max_size - 1 - index;
+        const size_t max_consumed = std::min(remaining, limit);
+        consumed = FindBoundary(gear_, ubytes + pos, max_consumed,
+                                before_avg ? mask_small_ : mask_large_,
+                                &rolling_);
+        if (consumed != 0) {
+          boundary = true;
+        } else {
+          consumed = max_consumed;
+        }
+        // The chunk reaches max_size after the next byte.
+        if (!boundary && index + consumed + 1 == sizes_.max_size &&
+            consumed < remaining) {
+          ++consumed;
+          boundary = true;
+        }
+      }
+
+      pos += consumed;
+      chunk_size_ += consumed;
+      if (boundary) {
+        functions_.cat_append(&cat_, bytes + unhashed, pos - unhashed);
+        unhashed = pos;
+        EndChunk(chunks);
+      }
+    }
+    // Fingerprint the rest of the window while it is still in the cache.
+    functions_.cat_append(&cat_, bytes + unhashed, window_size - unhashed);
+
+    bytes += window_size;
+    ubytes += window_size;
+    num_bytes -= window_size;
+  }
+}
+
+void HighwayHashChunker::Finish(std::vector<HHChunk>* chunks) {
+  if (chunk_size_ != 0) {
+    EndChunk(chunks);
+  }
+  offset_ = 0;
+}
+
+std::vector<HHChunk> HighwayHashChunks(const HHKey& key,
+                                       const char* HH_RESTRICT bytes,
+                                       const size_t size,
+                                       const ChunkSizes& sizes) {
+  std::vector<HHChunk> chunks;
+  // Usually close to the expected number of chunks.
+  chunks.reserve(size / std::max<size_t>(sizes.avg_size, 1) + 1);
+  HighwayHashChunker chunker(key, sizes);
+  chunker.Append(bytes, size, &chunks);
+  chunker.Finish(&chunks);
+  return chunks;
+}
+
+}  // namespace highwayhash
@@ -0,0 +1,111 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_CHUNKER_H_
+#define HIGHWAYHASH_HIGHWAYHASH_CHUNKER_H_
+
+// Content-defined chunking (e.g. for deduplication) with a HighwayHash
+// fingerprint of each chunk, computed in the same pass over the data.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash_target.h"
+
+namespace highwayhash {
+
+// Changing the rolling hash, the derivation of its table from the key or the
+// boundary conditions below would move the chunk boundaries; such a change
+// must introduce a new version instead.
+static constexpr int kHighwayHashChunkerVersion = 1;
+
+// Bytes that are scanned for boundaries before they are appended to the
+// fingerprint of the current chunk. Small enough to remain in the L1 cache.
+static constexpr size_t kChunkerWindowSize = 16 * 1024;
+
+// Chunk size limits. The defaults are suitable for backups.
+struct ChunkSizes {
+  size_t min_size = 2 * 1024;   // no boundary before this many bytes
+  size_t avg_size = 8 * 1024;   // expected size, a power of two
+  size_t max_size = 64 * 1024;  // boundary after this many bytes
+};
+
+// One chunk of the input.
+struct HHChunk {
+  uint64_t offset;  // of the first byte, from the start of the input
+  uint64_t size;
+  HHResult128 hash;  // HighwayHash128 of the chunk with the chunker's key
+};
+
+// Splits a stream of bytes into chunks whose boundaries depend only on the
+// nearby content, so that inserting or removing bytes only changes the
+// chunks around the edit. Boundaries are found with a Gear rolling hash and
+// FastCDC-style normalized chunking (Xia et al., USENIX ATC 2016): a
+// stricter condition before avg_size and a looser one after it concentrate
+// the sizes around avg_size.
+//
+// The Gear table is derived from "key", so boundaries do not reveal the
+// content to anyone who does not know the key. The fingerprint is identical
+// to HighwayHash128 (with the best implementation for the current CPU) of
+// the chunk, which is appended to an incremental hash window by window while
+// that window is still in the cache, so the input is only read from memory
+// once.
+//
+// Chunk boundaries and fingerprints are independent of how the input is
+// split into Append calls, and of the CPU.
+class HighwayHashChunker {
+ public:
+  // Invalid "sizes" are adjusted: avg_size is rounded down to a power of two,
+  // then 1 <= min_size <= avg_size <= max_size is enforced by raising
+  // avg_size and max_size as necessary.
+  explicit HighwayHashChunker(const HHKey& key,
+                              const ChunkSizes& sizes = ChunkSizes());
+
+  // Scans "num_bytes" following the previously appended bytes and adds each
+  // chunk that ends within them to "chunks". "num_bytes" == 0 has no effect.
+  void Append(const char* HH_RESTRICT bytes, size_t num_bytes,
+              std::vector<HHChunk>* chunks);
+
+  // Adds the final (possibly shorter than min_size) chunk to "chunks", if
+  // any bytes remain, and resets the chunker for a new input.
+  void Finish(std::vector<HHChunk>* chunks);
+
+ private:
+  // Emits the current chunk and starts a new one.
+  void EndChunk(std::vector<HHChunk>* chunks);
+
+  const HighwayHashFunctions& functions_;
+  HHKey key_;
+  ChunkSizes sizes_;
+  uint64_t mask_small_;  // condition before avg_size (more bits)
+  uint64_t mask_large_;  // condition after avg_size (fewer bits)
+  uint64_t gear_[256];
+
+  uint64_t rolling_ = 0;     // Gear hash; only depends on the last 64 bytes
+  uint64_t offset_ = 0;      // of the current chunk
+  uint64_t chunk_size_ = 0;  // bytes in the current chunk so far
+  HighwayHashCatStorage cat_;  // fingerprint of the current chunk
+};
+
+// Convenience function: chunks all "size" bytes and returns their records.
+std::vector<HHChunk> HighwayHashChunks(const HHKey& key,
+                                       const char* HH_RESTRICT bytes,
+                                       const size_t size,
+                                       const ChunkSizes& sizes = ChunkSizes());
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_CHUNKER_H_
@@ -0,0 +1,290 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_CONSTEXPR_H_
+#define HIGHWAYHASH_HIGHWAYHASH_CONSTEXPR_H_
+
+// HighwayHash in C++14 constant expressions, e.g. to build tables keyed by the
+// hashes of string literals at compile time:
+//   constexpr HHKey kKey = {1, 2, 3, 4};
+//   switch (hash) { case HighwayHash64Constexpr(kKey, "help"): ... }
+// The results are identical to HighwayHashT for every target. This is a
+// transcription of hh_portable.h without reinterpret_cast, static locals and
+// Load3, which are not allowed in constant expressions; it is about as fast as
+// Portable if evaluated at runtime.
+//
+// NOTE: unlike highwayhash.h, this header is not restricted: its inline
+// functions are not target-specific, so it must only be included from
+// translation units compiled without target-specific flags (e.g. -mavx2).
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/hh_types.h"
+
+// Whether the functions below are available (they require relaxed constexpr).
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#define HH_HAVE_CONSTEXPR_HASH 1
+#else
+#define HH_HAVE_CONSTEXPR_HASH 0
+#endif
+
+#if HH_HAVE_CONSTEXPR_HASH
+namespace highwayhash {
+
+// Arrays cannot be returned, hence these replacements for HHResult128/256.
+struct HHConstexprResult128 {
+  uint64_t hash[2];
+};
+struct HHConstexprResult256 {
+  uint64_t hash[4];
+};
+
+// Same interface as HHStatePortable, but all members are constexpr.
+class HHStateConstexpr {
+ public:
+  static constexpr int kNumLanes = 4;
+
+  explicit constexpr HHStateConstexpr(const HHKey& keys)
+      : v0{}, v1{}, mul0{}, mul1{} {
+    const uint64_t init0[kNumLanes] = {
+        0xdbe6d5d5fe4cce2full, 0xa4093822299f31d0ull, 0x13198a2e03707344ull,
+        0x243f6a8885a308d3ull};
+    const uint64_t init1[kNumLanes] = {
+        0x3bd39e10cb0ef593ull, 0xc0acf169b5f18a8cull, 0xbe5466cf34e90c6cull,
+        0x452821e638d01377ull};
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      mul0[lane] = init0[lane];
+      mul1[lane] = init1[lane];
+      v0[lane] = init0[lane] ^ keys[lane];
+      v1[lane] = init1[lane] ^ Rotate64By32(keys[lane]);
+    }
+  }
+
+  // Hashes the 32 bytes starting at "bytes".
+  constexpr void Update(const char* bytes) {
+    uint64_t packet_lanes[kNumLanes] = {};
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      packet_lanes[lane] = LoadLE64(bytes + 8 * lane);
+    }
+    Update(packet_lanes);
+  }
+
+  constexpr void UpdateRemainder(const char* bytes, const size_t size_mod32) {
+    const uint64_t mod32_pair =
+        (static_cast<uint64_t>(size_mod32) << 32) + size_mod32;
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      v0[lane] += mod32_pair;
+      v1[lane] = Rotate32By(v1[lane], size_mod32);
+    }
+
+    const size_t size_mod4 = size_mod32 & 3;
+    const size_t truncated = size_mod32 & ~size_t(3);
+
+    char packet[sizeof(HHPacket)] = {};
+    for (size_t i = 0; i < truncated; ++i) {
+      packet[i] = bytes[i];
+    }
+
+    const char* remainder = bytes + truncated;
+    if (size_mod32 & 16) {
+      // Load3::AllowReadBeforeAndReturn: the 4 bytes ending at the last one.
+      for (size_t i = 0; i < 4; ++i) {
+        packet[28 + i] = remainder[size_mod4 - 4 + i];
+      }
+    } else if (size_mod4 != 0) {
+      // Load3::AllowUnordered: this order is part of the padding definition.
+      packet[16] = remainder[0];
+      packet[17] = remainder[size_mod4 >> 1];
+      packet[18] = remainder[size_mod4 - 1];
+    }
+    Update(packet);
+  }
+
+  constexpr HHResult64 Finalize64() {
+    for (int n = 0; n < 4; n++) {
+      PermuteAndUpdate();
+    }
+    return v0[0] + v1[0] + mul0[0] + mul1[0];
+  }
+
+  constexpr HHConstexprResult128 Finalize128() {
+    for (int n = 0; n < 6; n++) {
+      PermuteAndUpdate();
+    }
+    HHConstexprResult128 result = {};
+    result.hash[0] = v0[0] + mul0[0] + v1[2] + mul1[2];
+    result.hash[1] = v0[1] + mul0[1] + v1[3] + mul1[3];
+    return result;
+  }
+
+  constexpr HHConstexprResult256 Finalize256() {
+    for (int n = 0; n < 10; n++) {
+      PermuteAndUpdate();
+    }
+    HHConstexprResult256 result = {};
+    ModularReduction(v1[1] + mul1[1], v1[0] + mul1[0], v0[1] + mul0[1],
+                     v0[0] + mul0[0], &result.hash[1], &result.hash[0]);
+    ModularReduction(v1[3] + mul1[3], v1[2] + mul1[2], v0[3] + mul0[3],
+                     v0[2] + mul0[2], &result.hash[3], &result.hash[2]);
+    return result;
+  }
+
+ private:
+  static constexpr uint64_t LoadLE64(const char* from) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(from[i]))
+               << (8 * i);
+    }
+    return value;
+  }
+
+  static constexpr uint64_t Rotate64By32(const uint64_t x) {
+    return (x >> 32) | (x << 32);
+  }
+
+  // Rotates both 32-bit halves of "x" left by 1..31 bits.
+  static constexpr uint64_t Rotate32By(const uint64_t x, const size_t count) {
+    const uint32_t lo = static_cast<uint32_t>(x);
+    const uint32_t hi = static_cast<uint32_t>(x >> 32);
+    const uint32_t lo_rotated = (lo << count) | (lo >> (32 - count));
+    const uint32_t hi_rotated = (hi << count) | (hi >> (32 - count));
+    return (static_cast<uint64_t>(hi_rotated) << 32) | lo_rotated;
+  }
+
+  // Clears all bits except one byte at the given offset.
+  static constexpr uint64_t Mask(const uint64_t v, const int bytes) {
+    return v & (0xFFull << (bytes * 8));
+  }
+
+  // See HHStatePortable::ZipperMergeAndAdd.
+  static constexpr void ZipperMergeAndAdd(const uint64_t v1, const uint64_t v0,
+                                          uint64_t* add1, uint64_t* add0) {
+    *add0 += ((Mask(v0, 3) + Mask(v1, 4)) >> 24) +
+             ((Mask(v0, 5) + Mask(v1, 6)) >> 16) + Mask(v0, 2) +
+             (Mask(v0, 1) << 32) + (Mask(v1, 7) >> 8) + (v0 << 56);
+
+    *add1 += ((Mask(v1, 3) + Mask(v0, 4)) >> 24) + Mask(v1, 2) +
+             (Mask(v1, 5) >> 16) + (Mask(v1, 1) << 24) + (Mask(v0, 6) >> 8) +
+             (Mask(v1, 0) << 48) + Mask(v0, 7);
+  }
+
+  constexpr void Update(const uint64_t (&packet_lanes)[kNumLanes]) {
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+      v1[lane] += packet_lanes[lane] + mul0[lane];
+      const uint32_t v1_32 = static_cast<uint32_t>(v1[lane]);
+      mul0[lane] ^= v1_32 * (v0[lane] >> 32);
+      v0[lane] += mul1[lane];
+      const uint32_t v0_32 = static_cast<uint32_t>(v0[lane]);
+      mul1[lane] ^= v0_32 * (v1[lane] >> 32);
+    }
+
+    ZipperMergeAndAdd(v1[1], v1[0], &v0[1], &v0[0]);
+    ZipperMergeAndAdd(v1[3], v1[2], &v0[3], &v0[2]);
+
+    ZipperMergeAndAdd(v0[1], v0[0], &v1[1], &v1[0]);
+    ZipperMergeAndAdd(v0[3], v0[2], &v1[3], &v1[2]);
+  }
+
+  constexpr void PermuteAndUpdate() {
+    const uint64_t permuted[kNumLanes] = {
+        Rotate64By32(v0[2]), Rotate64By32(v0[3]), Rotate64By32(v0[0]),
+        Rotate64By32(v0[1])};
+    Update(permuted);
+  }
+
+  // See HHStatePortable::ModularReduction.
+  static constexpr void ModularReduction(const uint64_t a3_unmasked,
+                                         const uint64_t a2, const uint64_t a1,
+                                         const uint64_t a0, uint64_t* m1,
+                                         uint64_t* m0) {
+    const uint64_t a3 = a3_unmasked & 0x3FFFFFFFFFFFFFFFull;
+    const uint64_t a3_shl1 = (a3 << 1) | (a2 >> 63);
+    const uint64_t a2_shl1 = a2 << 1;
+    const uint64_t a3_shl2 = (a3 << 2) | (a2 >> 62);
+    const uint64_t a2_shl2 = a2 << 2;
+    *m1 = a1 ^ a3_shl1 ^ a3_shl2;
+    *m0 = a0 ^ a2_shl1 ^ a2_shl2;
+  }
+
+  uint64_t v0[kNumLanes];
+  uint64_t v1[kNumLanes];
+  uint64_t mul0[kNumLanes];
+  uint64_t mul1[kNumLanes];
+};
+
+// Hashes all whole packets of "bytes" and its remainder into "state".
+constexpr void HighwayHashConstexprUpdate(HHStateConstexpr* state,
+                                          const char* bytes,
+                                          const size_t size) {
+  const size_t remainder = size & (sizeof(HHPacket) - 1);
+  const size_t truncated = size & ~(sizeof(HHPacket) - 1);
+  for (size_t offset = 0; offset < truncated; offset += sizeof(HHPacket)) {
+    state->Update(bytes + offset);
+  }
+  if (remainder != 0) {
+    state->UpdateRemainder(bytes + truncated, remainder);
+  }
+}
+
+// Same results as HighwayHashT for "size" bytes starting at "bytes".
+constexpr HHResult64 HighwayHash64Constexpr(const HHKey& key,
+                                            const char* bytes,
+                                            const size_t size) {
+  HHStateConstexpr state(key);
+  HighwayHashConstexprUpdate(&state, bytes, size);
+  return state.Finalize64();
+}
+
+constexpr HHConstexprResult128 HighwayHash128Constexpr(const HHKey& key,
+                                                       const char* bytes,
+                                                       const size_t size) {
+  HHStateConstexpr state(key);
+  HighwayHashConstexprUpdate(&state, bytes, size);
+  return state.Finalize128();
+}
+
+constexpr HHConstexprResult256 HighwayHash256Constexpr(const HHKey& key,
+                                                       const char* bytes,
+                                                       const size_t size) {
+  HHStateConstexpr state(key);
+  HighwayHashConstexprUpdate(&state, bytes, size);
+  return state.Finalize256();
+}
+
+// String literals: hashes all characters except the terminating null, i.e.
+// the same as HighwayHash64(key, literal, strlen(literal)).
+template <size_t N>
+constexpr HHResult64 HighwayHash64Constexpr(const HHKey& key,
+                                            const char (&literal)[N]) {
+  return HighwayHash64Constexpr(key, literal, N - 1);
+}
+
+template <size_t N>
+constexpr HHConstexprResult128 HighwayHash128Constexpr(
+    const HHKey& key, const char (&literal)[N]) {
+  return HighwayHash128Constexpr(key, literal, N - 1);
+}
+
+template <size_t N>
+constexpr HHConstexprResult256 HighwayHash256Constexpr(
+    const HHKey& key, const char (&literal)[N]) {
+  return HighwayHash256Constexpr(key, literal, N - 1);
+}
+
+}  // namespace highwayhash
+#endif  // HH_HAVE_CONSTEXPR_HASH
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_CONSTEXPR_H_
@@ -0,0 +1,42 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_dispatch.h"
+
+#include "highwayhash/instruction_sets.h"
+
+namespace highwayhash {
+namespace {
+
+HighwayHashFunctions SelectBest() {
+  HighwayHashFunctions functions;
+  InstructionSets::Run<HighwayHashSelect>(&functions);
+  return functions;
+}
+
+}  // namespace
+
+const HighwayHashFunctions& HighwayHashDispatch() {
+  // Function-local static => safe to call from other static initializers.
+  static const HighwayHashFunctions functions = SelectBest();
+  return functions;
+}
+
+namespace {
+
+// Resolves the table at load time so the first hash does not pay for CPUID.
+const HighwayHashFunctions& resolved_at_load = HighwayHashDispatch();
+
+}  // namespace
+}  // namespace highwayhash
@@ -0,0 +1,37 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_DISPATCH_H_
+#define HIGHWAYHASH_HIGHWAYHASH_DISPATCH_H_
+
+// Table of the best HighwayHash implementations, resolved once per process
+// instead of on every call as with InstructionSets::Run.
+
+#include "highwayhash/highwayhash_target.h"
+
+namespace highwayhash {
+
+// Returns pointers to the implementations for the best target supported by
+// the current CPU. The table is initialized at load time (or by the first
+// call, if earlier) and never changes afterwards. Thread-safe.
+//
+// Usage: HighwayHashDispatch().hash64(key, bytes, size, &hash).
+// This is cheaper than InstructionSets::Run<HighwayHash> for short inputs,
+// but still incurs an indirect call; code compiled for the target CPU can
+// instead call HighwayHashT directly.
+const HighwayHashFunctions& HighwayHashDispatch();
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_DISPATCH_H_
@@ -0,0 +1,171 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_FIELDS_H_
+#define HIGHWAYHASH_HIGHWAYHASH_FIELDS_H_
+
+// Hashes structured values (integers, floats, strings, ranges and user types)
+// by appending their fields to a HighwayHashCatT, without first serializing
+// them into a temporary buffer:
+//   HighwayHashCatT<HH_TARGET> cat(key);
+//   HashFields(&cat, id, name, scores);
+//   cat.Finalize(&hash);
+// Strings and ranges are prefixed with their length, so unlike concatenating
+// their bytes, {"A", ""} and {"", "A"} have different hashes. Integers are
+// appended as their little-endian bytes, so the hashes are the same on all
+// platforms.
+//
+// User types opt in by defining, in their own namespace (found via ADL):
+//   template <class Cat>
+//   void HashValue(Cat* cat, const Point& p) { HashFields(cat, p.x, p.y); }
+//
+// NOTE: unlike highwayhash.h, this header is not restricted because it
+// includes standard library headers. It may only be used in translation units
+// compiled with the flags for the Target of the HighwayHashCatT.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+
+namespace highwayhash {
+
+// Integers, bool and enums: their sizeof(T) bytes, little-endian.
+template <TargetBits Target, typename T>
+HH_INLINE typename std::enable_if<std::is_integral<T>::value>::type HashValue(
+    HighwayHashCatT<Target>* cat, const T value) {
+  cat->template AppendLE<sizeof(T)>(static_cast<uint64_t>(value));
+}
+
+template <TargetBits Target, typename T>
+HH_INLINE typename std::enable_if<std::is_enum<T>::value>::type HashValue(
+    HighwayHashCatT<Target>* cat, const T value) {
+  using Underlying = typename std::underlying_type<T>::type;
+  HashValue(cat, static_cast<Underlying>(value));
+}
+
+// float/double: their IEEE-754 bits, except that -0.0 is hashed as 0.0 because
+// they compare equal. NaNs are hashed as their bits.
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat, const float value) {
+  uint32_t bits = 0;
+  if (value != 0.0f) {
+    memcpy(&bits, &value, sizeof(bits));
+  }
+  cat->template AppendLE<4>(bits);
+}
+
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat, const double value) {
+  uint64_t bits = 0;
+  if (value != 0.0) {
+    memcpy(&bits, &value, sizeof(bits));
+  }
+  cat->template AppendLE<8>(bits);
+}
+
+// Strings: 64-bit length, then the bytes.
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat, const StringView value) {
+  cat->template AppendLE<8>(value.num_bytes);
+  cat->Append(value.data, value.num_bytes);
+}
+
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat,
+                         const std::string& value) {
+  cat->template AppendLE<8>(value.size());
+  cat->Append(value.data(), value.size());
+}
+
+// Null-terminated string; the terminator is not hashed.
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat, const char* value) {
+  const size_t num_bytes = strlen(value);
+  cat->template AppendLE<8>(num_bytes);
+  cat->Append(value, num_bytes);
+}
+
+#if __cplusplus >= 201703L
+template <TargetBits Target>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat,
+                         const std::string_view value) {
+  cat->template AppendLE<8>(value.size());
+  cat->Append(value.data(), value.size());
+}
+#endif
+
+template <TargetBits Target, typename T1, typename T2>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat,
+                         const std::pair<T1, T2>& value) {
+  HashValue(cat, value.first);
+  HashValue(cat, value.second);
+}
+
+// Ranges: 64-bit number of elements, then each element. [begin, end) must be
+// forward iterators whose elements have a HashValue overload.
+template <TargetBits Target, class Iterator>
+HH_INLINE void HashRange(HighwayHashCatT<Target>* cat, const Iterator begin,
+                         const Iterator end) {
+  uint64_t num_elements = 0;
+  for (Iterator it = begin; it != end; ++it) {
+    ++num_elements;
+  }
+  cat->template AppendLE<8>(num_elements);
+  for (Iterator it = begin; it != end; ++it) {
+    HashValue(cat, *it);
+  }
+}
+
+template <TargetBits Target, typename T, class Allocator>
+HH_INLINE void HashValue(HighwayHashCatT<Target>* cat,
+                         const std::vector<T, Allocator>& value) {
+  cat->template AppendLE<8>(value.size());
+  for (const T& element : value) {
+    HashValue(cat, element);
+  }
+}
+
+// Appends each of "fields" (in order) via the HashValue overload for its type.
+template <TargetBits Target, class... Fields>
+HH_INLINE void HashFields(HighwayHashCatT<Target>* cat,
+                          const Fields&... fields) {
+  // Expands to one call per field; the array ensures they are in order.
+  const int unused[] = {0, (HashValue(cat, fields), 0)...};
+  (void)unused;
+}
+
+// Computes the 64, 128 or 256-bit hash of "fields", the same as HashFields
+// followed by Finalize.
+template <TargetBits Target, typename Result, class... Fields>
+HH_INLINE void HighwayHashFieldsT(const HHKey& key, Result* HH_RESTRICT hash,
+                                  const Fields&... fields) {
+  HighwayHashCatT<Target> cat(key);
+  HashFields(&cat, fields...);
+  cat.Finalize(hash);
+}
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_FIELDS_H_
@@ -0,0 +1,215 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_merkle.h"
+
+#include <algorithm>
+
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/highwayhash_dispatch.h"
+
+namespace highwayhash {
+namespace {
+
+// Nodes are passed to HighwayHashBatch in groups of this many, which
+// interleaves their dependency chains.
+const uint32_t kNodesPerBatch = 16;
+
+// A level is only hashed on the pool if its dirty nodes have at least this
+// many bytes; below that, waking the workers costs more than it saves.
+const size_t kMinParallelBytes = 256 * 1024;
+
+// See highwayhash_tree.cc.
+void DeriveKey(const HHKey& key, const uint64_t tweak, HHKey* derived) {
+  for (int i = 0; i < 4; ++i) {
+    (*derived)[i] = key[i] ^ (tweak + i);
+  }
+}
+
+// Derivation tweaks for version 1: "HHMrkl1L", "HHMrkl1P" and "HHMrkl1R" in
+// ASCII.
+const uint64_t kLeafTweak = 0x48484D726B6C314Cull;
+const uint64_t kParentTweak = 0x48484D726B6C3150ull;
+const uint64_t kRootTweak = 0x48484D726B6C3152ull;
+
+// Hashes the inputs returned by view_of(i) for i in [begin, end) and stores
+// them in level[nodes[i]].
+template <class ViewOf>
+void HashBatches(const HighwayHashFunctions& functions, const HHKey& key,
+                 const ViewOf& view_of, const uint32_t* HH_RESTRICT nodes,
+                 const uint32_t begin, const uint32_t end,
+                 HHResult128* HH_RESTRICT level) {
+  StringView views[kNodesPerBatch];
+  HHResult128 hashes[kNodesPerBatch];
+  for (uint32_t first = begin; first < end; first += kNodesPerBatch) {
+    const uint32_t count = std::min(end - first, kNodesPerBatch);
+    for (uint32_t i = 0; i < count; ++i) {
+      views[i] = view_of(first + i);
+    }
+    functions.batch128(key, views, count, hashes);
+    for (uint32_t i = 0; i < count; ++i) {
+      level[nodes[first + i]][0] = hashes[i][0];
+      level[nodes[first + i]][1] = hashes[i][1];
+    }
+  }
+}
+
+// Calls HashBatches for all "nodes", on "pool" if worthwhile.
+template <class ViewOf>
+void HashAll(const HighwayHashFunctions& functions, const HHKey& key,
+             const ViewOf& view_of, const std::vector<uint32_t>& nodes,
+             const size_t bytes_per_node, ThreadPool* pool,
+             HHResult128* HH_RESTRICT level) {
+  const uint32_t num_nodes = static_cast<uint32_t>(nodes.size());
+  if (pool == nullptr || num_nodes * bytes_per_node < kMinParallelBytes) {
+    HashBatches(functions, key, view_of, nodes.data(), 0, num_nodes, level);
+  } else {
+    // Nodes are independent, so the split does not affect the results.
+    pool->RunRanges(0, num_nodes,
+                    [&functions, &key, &view_of, &nodes, level](
+                        const int /*chunk*/, const uint32_t begin,
+                        const uint32_t end) {
+                      HashBatches(functions, key, view_of, nodes.data(), begin,
+                                  end, level);
+                    });
+  }
+}
+
+}  // namespace
+
+HighwayMerkleTree::HighwayMerkleTree(const HHKey& key,
+                                     const char* HH_RESTRICT bytes,
+                                     const size_t size, const size_t leaf_size,
+                                     ThreadPool* pool)
+    : functions_(HighwayHashDispatch()),
+      bytes_(bytes),
+      size_(size),
+      leaf_size_(leaf_size),
+      pool_(pool) {
+  DATA_PARALLEL_CHECK(leaf_size != 0);
+  DeriveKey(key, kLeafTweak, &leaf_key_);
+  DeriveKey(key, kParentTweak, &parent_key_);
+  DeriveKey(key, kRootTweak, &root_key_);
+
+  // (An empty input still has one (empty) leaf.)
+  const size_t num_leaves = size == 0 ? 1 : (size - 1) / leaf_size + 1;
+  DATA_PARALLEL_CHECK(num_leaves == static_cast<uint32_t>(num_leaves));
+
+  size_t num_nodes = num_leaves;
+  levels_.emplace_back(num_nodes);
+  while (num_nodes > 1) {
+    num_nodes = (num_nodes + 1) / 2;
+    levels_.emplace_back(num_nodes);
+  }
+
+  is_dirty_.assign(num_leaves, 1);
+  dirty_leaves_.resize(num_leaves);
+  for (size_t i = 0; i < num_leaves; ++i) {
+    dirty_leaves_[i] = static_cast<uint32_t>(i);
+  }
+}
+
+void HighwayMerkleTree::MarkDirty(const size_t offset, size_t num_bytes) {
+  if (offset >= size_) return;
+  num_bytes = std::min(num_bytes, size_ - offset);
+  if (num_bytes == 0) return;
+
+  const size_t last = (offset + num_bytes - 1) / leaf_size_;
+  for (size_t leaf = offset / leaf_size_; leaf <= last; ++leaf) {
+    if (!is_dirty_[leaf]) {
+      is_dirty_[leaf] = 1;
+      dirty_leaves_.push_back(static_cast<uint32_t>(leaf));
+    }
+  }
+}
+
+void HighwayMerkleTree::HashNodes(const size_t level,
+                                  const std::vector<uint32_t>& nodes) {
+  HHResult128* hashes = levels_[level].data();
+  if (level == 0) {
+    const auto view_of = [this, &nodes](const uint32_t i) {
+      const size_t offset = nodes[i] * leaf_size_;
+      return StringView{bytes_ + offset, std::min(size_ - offset, leaf_size_)};
+    };
+    HashAll(functions_, leaf_key_, view_of, nodes, leaf_size_, pool_, hashes);
+    return;
+  }
+
+  // Little-endian hashes of the (one or two) children of each node.
+  const std::vector<HHResult128>& children = levels_[level - 1];
+  inputs_.resize(nodes.size() * 4);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const size_t first_child = nodes[i] * size_t(2);
+    const size_t num_children =
+        std::min<size_t>(2, children.size() - first_child);
+    for (size_t c = 0; c < num_children; ++c) {
+      for (int j = 0; j < 2; ++j) {
+        inputs_[i * 4 + c * 2 + j] =
+            le64_from_host(children[first_child + c][j]);
+      }
+    }
+  }
+  const auto view_of = [this, &nodes, &children](const uint32_t i) {
+    const bool has_two = nodes[i] * size_t(2) + 1 < children.size();
+    return StringView{reinterpret_cast<const char*>(inputs_.data() + i * 4),
+                      has_two ? sizeof(HHResult128) * 2 : sizeof(HHResult128)};
+  };
+  HashAll(functions_, parent_key_, view_of, nodes, sizeof(HHResult128) * 2,
+          pool_, hashes);
+}
+
+void HighwayMerkleTree::Root(HHResult128* HH_RESTRICT root) {
+  if (!dirty_leaves_.empty()) {
+    std::sort(dirty_leaves_.begin(), dirty_leaves_.end());
+    HashNodes(0, dirty_leaves_);
+    for (const uint32_t leaf : dirty_leaves_) {
+      is_dirty_[leaf] = 0;
+    }
+
+    // The parents of sorted nodes are sorted, hence duplicates are adjacent.
+    nodes_ = dirty_leaves_;
+    for (size_t level = 1; level < levels_.size(); ++level) {
+      for (uint32_t& node : nodes_) {
+        node /= 2;
+      }
+      nodes_.erase(std::unique(nodes_.begin(), nodes_.end()), nodes_.end());
+      HashNodes(level, nodes_);
+    }
+    dirty_leaves_.clear();
+  }
+
+  // Root: the little-endian top node, size and leaf size.
+  const HHResult128& top = levels_.back()[0];
+  const uint64_t input[4] = {le64_from_host(top[0]), le64_from_host(top[1]),
+                             le64_from_host(size_),
+                             le64_from_host(leaf_size_)};
+  functions_.hash128(root_key_, reinterpret_cast<const char*>(input),
+                     sizeof(input), root);
+}
+
+void HighwayMerkleTree::LeafHash(const size_t leaf,
+                                 HHResult128* HH_RESTRICT hash) const {
+  (*hash)[0] = levels_[0][leaf][0];
+  (*hash)[1] = levels_[0][leaf][1];
+}
+
+void HighwayMerkleRoot(const HHKey& key, const char* HH_RESTRICT bytes,
+                       const size_t size, const size_t leaf_size,
+                       ThreadPool* pool, HHResult128* HH_RESTRICT root) {
+  HighwayMerkleTree tree(key, bytes, size, leaf_size, pool);
+  tree.Root(root);
+}
+
+}  // namespace highwayhash
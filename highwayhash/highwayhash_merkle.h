@@ -0,0 +1,116 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_MERKLE_H_
+#define HIGHWAYHASH_HIGHWAYHASH_MERKLE_H_
+
+// Incremental hashing of large mutable buffers: after a write, only the
+// leaves it touched and their ancestors are hashed again. WARNING: the
+// results differ from HighwayHash and HighwayTreeHash of the same data.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash_target.h"
+
+namespace highwayhash {
+
+class ThreadPool;  // data_parallel.h
+
+// Changing the derived keys, the node inputs or any other aspect of the
+// construction below would change all results; such a change must introduce
+// a new version instead.
+static constexpr int kHighwayMerkleVersion = 1;
+
+// Default leaf size; the unit of rehashing after a write. Matches the usual
+// page size.
+static constexpr size_t kHighwayMerkleLeafSize = 4096;
+
+// Binary Merkle tree of HighwayHash128 over the fixed-size leaves of a buffer
+// owned by the caller. Each leaf is hashed with a key derived from "key"; each
+// internal node hashes the little-endian hashes of its two children (or of
+// its only child, for the last node of a level with an odd number of nodes)
+// with another derived key. The root additionally binds the buffer size and
+// leaf size.
+//
+// The caller modifies the buffer in place and reports each write via
+// MarkDirty; Root then rehashes the dirty leaves and the nodes on their paths
+// to the root, so the cost is proportional to the number of modified leaves
+// (times the depth of the tree), not the buffer size. Dirty leaves are hashed
+// in batches via HighwayHashBatch, and in parallel on "pool" if there are
+// enough of them. Results are identical regardless of the pool, the CPU and
+// the best available instruction set.
+//
+// Not thread-safe: writes, MarkDirty and Root must not be concurrent, and
+// "pool" must not be used by other threads during Root (see ThreadPool::Run).
+class HighwayMerkleTree {
+ public:
+  // "bytes" must remain valid while the tree exists (they are only read by
+  // Root). "leaf_size" must be nonzero; the last leaf may be shorter, or empty
+  // if "size" is zero. All leaves are initially dirty, so the first Root
+  // hashes the entire buffer. "pool" may be null.
+  HighwayMerkleTree(const HHKey& key, const char* HH_RESTRICT bytes,
+                    size_t size, size_t leaf_size = kHighwayMerkleLeafSize,
+                    ThreadPool* pool = nullptr);
+
+  // Reports that bytes [offset, offset + num_bytes) were (or will be, before
+  // the next Root) modified. The range is clamped to the buffer size.
+  void MarkDirty(size_t offset, size_t num_bytes);
+
+  // Stores the root hash of the current buffer contents, after rehashing all
+  // nodes affected by MarkDirty since the previous call.
+  void Root(HHResult128* HH_RESTRICT root);
+
+  // Stores the hash of "leaf" as of the most recent Root.
+  void LeafHash(size_t leaf, HHResult128* HH_RESTRICT hash) const;
+
+  size_t NumLeaves() const { return levels_[0].size(); }
+  size_t NumDirty() const { return dirty_leaves_.size(); }
+  size_t LeafSize() const { return leaf_size_; }
+
+ private:
+  // Rehashes the (sorted, unique) "nodes" of levels_[level].
+  void HashNodes(size_t level, const std::vector<uint32_t>& nodes);
+
+  const HighwayHashFunctions& functions_;
+  HHKey leaf_key_;
+  HHKey parent_key_;
+  HHKey root_key_;
+  const char* const bytes_;
+  const size_t size_;
+  const size_t leaf_size_;
+  ThreadPool* const pool_;
+
+  // levels_[0] are the leaf hashes; each subsequent level has half as many
+  // (rounded up) nodes, and the last level has only one.
+  std::vector<std::vector<HHResult128>> levels_;
+
+  std::vector<uint8_t> is_dirty_;       // per leaf
+  std::vector<uint32_t> dirty_leaves_;  // indices of nonzero is_dirty_
+  std::vector<uint32_t> nodes_;         // scratch: dirty nodes of one level
+  std::vector<uint64_t> inputs_;        // scratch: their little-endian inputs
+};
+
+// Convenience function: stores the root hash of "bytes", which is the same
+// as the first HighwayMerkleTree::Root of a tree with the same arguments.
+void HighwayMerkleRoot(const HHKey& key, const char* HH_RESTRICT bytes,
+                       size_t size, size_t leaf_size, ThreadPool* pool,
+                       HHResult128* HH_RESTRICT root);
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_MERKLE_H_
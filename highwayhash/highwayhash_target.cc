@@ -17,7 +17,11 @@
 
 #include "highwayhash/highwayhash_target.h"
 
+#include <new>  // placement new, which is inline and target-independent
+
 #include "highwayhash/highwayhash.h"
+#include "highwayhash/sip_hash_batch.h"
+#include "highwayhash/sip_tree_hash_lanes.h"
 
 #ifndef HH_DISABLE_TARGET_SPECIFIC
 namespace highwayhash {
@@ -33,13 +37,291 @@ uint64_t HH_ADD_TARGET_SUFFIX(HighwayHash64_)(const HHKey key,
 }
 }  // extern "C"
 
+namespace HH_TARGET_NAME {
+namespace {
+
+// Non-member implementations of the functors, whose addresses are stored in
+// HighwayHashFunctions. Only instantiated for HH_TARGET.
+
+template <typename Result>
+void Hash(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+          Result* HH_RESTRICT hash) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashT(&state, bytes, size, hash);
+}
+
+template <typename Result, typename WiderResult>
+void HashBoth(const HHKey& key, const char* HH_RESTRICT bytes,
+              const size_t size, Result* HH_RESTRICT hash,
+              WiderResult* HH_RESTRICT wider_hash) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashT(&state, bytes, size, hash, wider_hash);
+}
+
+template <typename Result>
+void Cat(const HHKey& key, const StringView* HH_RESTRICT fragments,
+         const size_t num_fragments, Result* HH_RESTRICT hash) {
+  HighwayHashCatT<HH_TARGET> cat(key);
+  cat.AppendFragments(fragments, fragments + num_fragments);
+  cat.Finalize(hash);
+}
+
+#if HH_HAS_IOVEC
+
+// Presents iovec as StringView to HighwayHashCatT::AppendFragments.
+class IovecIterator {
+ public:
+  explicit IovecIterator(const iovec* pos) : pos_(pos) {}
+
+  bool operator!=(const IovecIterator& other) const {
+    return pos_ != other.pos_;
+  }
+
+  IovecIterator& operator++() {
+    ++pos_;
+    return *this;
+  }
+
+  const StringView* operator->() {
+    view_.data = static_cast<const char*>(pos_->iov_base);
+    view_.num_bytes = pos_->iov_len;
+    return &view_;
+  }
+
+ private:
+  const iovec* pos_;
+  StringView view_;
+};
+
+template <typename Result>
+void CatIovec(const HHKey& key, const iovec* HH_RESTRICT fragments,
+              const size_t num_fragments, Result* HH_RESTRICT hash) {
+  HighwayHashCatT<HH_TARGET> cat(key);
+  cat.AppendFragments(IovecIterator(fragments),
+                      IovecIterator(fragments + num_fragments));
+  cat.Finalize(hash);
+}
+
+#endif  // HH_HAS_IOVEC
+
+// Returns the HighwayHashCatT within "storage", aligned as required.
+HighwayHashCatT<HH_TARGET>* CatIn(HighwayHashCatStorage* storage) {
+  static_assert(sizeof(HighwayHashCatT<HH_TARGET>) + 63 <=
+                    sizeof(HighwayHashCatStorage),
+                "Enlarge HighwayHashCatStorage");
+  const uintptr_t address = reinterpret_cast<uintptr_t>(storage->bytes);
+  const uintptr_t aligned = (address + 63) & ~uintptr_t{63};
+  return reinterpret_cast<HighwayHashCatT<HH_TARGET>*>(aligned);
+}
+
+const HighwayHashCatT<HH_TARGET>* CatIn(const HighwayHashCatStorage* storage) {
+  return CatIn(const_cast<HighwayHashCatStorage*>(storage));
+}
+
+void CatStart(const HHKey& key, HighwayHashCatStorage* HH_RESTRICT storage) {
+  // The storage is raw bytes, so construct the object there. Its destructor
+  // is trivial and never called.
+  new (CatIn(storage)) HighwayHashCatT<HH_TARGET>(key);
+}
+
+void CatAppend(HighwayHashCatStorage* HH_RESTRICT storage,
+               const char* HH_RESTRICT bytes, const size_t num_bytes) {
+  CatIn(storage)->Append(bytes, num_bytes);
+}
+
+void CatAppendCopy(HighwayHashCatStorage* HH_RESTRICT storage,
+                   const char* HH_RESTRICT bytes, const size_t num_bytes,
+                   char* HH_RESTRICT copy) {
+  CatIn(storage)->AppendCopy(bytes, num_bytes, copy);
+}
+
+template <typename Result>
+void CatFinish(const HighwayHashCatStorage* HH_RESTRICT storage,
+               Result* HH_RESTRICT hash) {
+  CatIn(storage)->Finalize(hash);
+}
+
+void CatSerialize(const HighwayHashCatStorage* HH_RESTRICT storage,
+                  HHCatSnapshot* HH_RESTRICT snapshot) {
+  CatIn(storage)->Serialize(snapshot);
+}
+
+bool CatDeserialize(const HHCatSnapshot& snapshot,
+                    HighwayHashCatStorage* HH_RESTRICT storage) {
+  // Any key; Deserialize overwrites the state derived from it.
+  const HHKey unused_key = {0};
+  HighwayHashCatT<HH_TARGET> cat(unused_key);
+  if (!cat.Deserialize(snapshot)) return false;
+  new (CatIn(storage)) HighwayHashCatT<HH_TARGET>(cat);
+  return true;
+}
+
+void CompactStart(const HHKey& key, HHCompactCat* HH_RESTRICT compact) {
+  HighwayHashCompactStartT<HH_TARGET>(key, compact);
+}
+
+void CompactAppend(HHCompactCat* HH_RESTRICT compact,
+                   const char* HH_RESTRICT bytes, const size_t num_bytes) {
+  HighwayHashCompactAppendT<HH_TARGET>(compact, bytes, num_bytes);
+}
+
+template <typename Result>
+void CompactFinish(const HHCompactCat& compact, Result* HH_RESTRICT hash) {
+  HighwayHashCompactFinalizeT<HH_TARGET>(compact, hash);
+}
+
+// Returns the HighwayHashKeyedT within "storage", aligned as required.
+HighwayHashKeyedT<HH_TARGET>* KeyedIn(HighwayHashPreparedKey* storage) {
+  static_assert(sizeof(HighwayHashKeyedT<HH_TARGET>) + 63 <=
+                    sizeof(HighwayHashPreparedKey),
+                "Enlarge HighwayHashPreparedKey");
+  const uintptr_t address = reinterpret_cast<uintptr_t>(storage->bytes);
+  const uintptr_t aligned = (address + 63) & ~uintptr_t{63};
+  return reinterpret_cast<HighwayHashKeyedT<HH_TARGET>*>(aligned);
+}
+
+const HighwayHashKeyedT<HH_TARGET>* KeyedIn(
+    const HighwayHashPreparedKey* storage) {
+  return KeyedIn(const_cast<HighwayHashPreparedKey*>(storage));
+}
+
+void Prepare(const HHKey& key, HighwayHashPreparedKey* HH_RESTRICT storage) {
+  // As in CatStart.
+  new (KeyedIn(storage)) HighwayHashKeyedT<HH_TARGET>(key);
+}
+
+template <typename Result>
+void Prepared(const HighwayHashPreparedKey* HH_RESTRICT storage,
+              const char* HH_RESTRICT bytes, const size_t size,
+              Result* HH_RESTRICT hash) {
+  (*KeyedIn(storage))(bytes, size, hash);
+}
+
+template <typename Value>
+HHResult64 PreparedValue(const HighwayHashPreparedKey* HH_RESTRICT storage,
+                         const Value value) {
+  HHStateT<HH_TARGET> state = KeyedIn(storage)->Prepared();
+  HHResult64 hash;
+  if (sizeof(Value) == 8) {
+    HighwayHashU64T(&state, value, &hash);
+  } else {
+    HighwayHashU32T(&state, static_cast<uint32_t>(value), &hash);
+  }
+  return hash;
+}
+
+template <typename Value, typename Result>
+void Values(const HHKey& key, const Value* HH_RESTRICT values,
+            const size_t num_values, Result* HH_RESTRICT hashes) {
+  HighwayHashValuesT<HH_TARGET>(key, values, num_values, hashes);
+}
+
+template <typename Offset, typename Result>
+void Offsets(const HHKey& key, const char* HH_RESTRICT data,
+             const Offset* HH_RESTRICT offsets,
+             const uint8_t* HH_RESTRICT validity, const size_t num_strings,
+             Result* HH_RESTRICT hashes) {
+  HighwayHashOffsetsT<HH_TARGET>(key, data, offsets, validity, num_strings,
+                                 hashes);
+}
+
+template <typename Value>
+size_t SampleValues(const HHKey& key, const Value* HH_RESTRICT values,
+                    const size_t num_values, const uint64_t threshold,
+                    uint64_t* HH_RESTRICT selected) {
+  return HighwayHashSampleValuesT<HH_TARGET>(key, values, num_values, threshold,
+                                             selected);
+}
+
+template <typename Offset>
+size_t SampleOffsets(const HHKey& key, const char* HH_RESTRICT data,
+                     const Offset* HH_RESTRICT offsets,
+                     const uint8_t* HH_RESTRICT validity,
+                     const size_t num_strings, const uint64_t threshold,
+                     uint64_t* HH_RESTRICT selected) {
+  return HighwayHashSampleOffsetsT<HH_TARGET>(key, data, offsets, validity,
+                                              num_strings, threshold, selected);
+}
+
+template <typename Result>
+void Batch(const HHKey& key, const StringView* HH_RESTRICT messages,
+           const size_t num_messages, Result* HH_RESTRICT hashes) {
+  HighwayHashBatchT<HH_TARGET>(key, messages, num_messages, hashes);
+}
+
+template <typename Result>
+size_t Verify(const HHKey& key, const StringView* HH_RESTRICT messages,
+              const Result* HH_RESTRICT expected, const size_t num_messages,
+              uint64_t* HH_RESTRICT failures) {
+  return HighwayHashVerifyT<HH_TARGET>(key, messages, expected, num_messages,
+                                       failures);
+}
+
+template <typename Result>
+void Short(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+           Result* HH_RESTRICT hash) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashShortT(&state, bytes, size, hash);
+}
+
+template <typename Result>
+void Padded(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+            Result* HH_RESTRICT hash) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashPaddedT(&state, bytes, size, hash);
+}
+
+template <typename Result>
+void Copy(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+          char* HH_RESTRICT copy, Result* HH_RESTRICT hash) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashCopyT(&state, bytes, size, copy, hash);
+}
+
+template <typename Result>
+void NonTemporal(const HHKey& key, const char* HH_RESTRICT bytes,
+                 const size_t size, Result* HH_RESTRICT hash,
+                 const size_t prefetch_distance) {
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashNonTemporalT(&state, bytes, size, hash, prefetch_distance);
+}
+
+template <typename Result>
+void MultiKey(const HHKey* HH_RESTRICT keys, const size_t num_keys,
+              const char* HH_RESTRICT bytes, const size_t size,
+              Result* HH_RESTRICT hashes) {
+  size_t i = 0;
+  for (; i + 4 <= num_keys; i += 4) {
+    HighwayHashMultiKeyT<HH_TARGET, 4>(keys + i, bytes, size, hashes + i);
+  }
+  switch (num_keys - i) {
+    case 3:
+      HighwayHashMultiKeyT<HH_TARGET, 3>(keys + i, bytes, size, hashes + i);
+      break;
+    case 2:
+      HighwayHashMultiKeyT<HH_TARGET, 2>(keys + i, bytes, size, hashes + i);
+      break;
+    case 1:
+      HighwayHashMultiKeyT<HH_TARGET, 1>(keys + i, bytes, size, hashes + i);
+      break;
+  }
+}
+
+template <typename Result>
+void Wide(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+          Result* HH_RESTRICT hash) {
+  HighwayHashWideT<HH_TARGET>(key, bytes, size, hash);
+}
+
+}  // namespace
+}  // namespace HH_TARGET_NAME
+
 template <TargetBits Target>
 void HighwayHash<Target>::operator()(const HHKey& key,
                                      const char* HH_RESTRICT bytes,
                                      const size_t size,
                                      HHResult64* HH_RESTRICT hash) const {
-  HHStateT<Target> state(key);
-  HighwayHashT(&state, bytes, size, hash);
+  HH_TARGET_NAME::Hash(key, bytes, size, hash);
 }
 
 template <TargetBits Target>
@@ -47,8 +329,7 @@ void HighwayHash<Target>::operator()(const HHKey& key,
                                      const char* HH_RESTRICT bytes,
                                      const size_t size,
                                      HHResult128* HH_RESTRICT hash) const {
-  HHStateT<Target> state(key);
-  HighwayHashT(&state, bytes, size, hash);
+  HH_TARGET_NAME::Hash(key, bytes, size, hash);
 }
 
 template <TargetBits Target>
@@ -56,8 +337,7 @@ void HighwayHash<Target>::operator()(const HHKey& key,
                                      const char* HH_RESTRICT bytes,
                                      const size_t size,
                                      HHResult256* HH_RESTRICT hash) const {
-  HHStateT<Target> state(key);
-  HighwayHashT(&state, bytes, size, hash);
+  HH_TARGET_NAME::Hash(key, bytes, size, hash);
 }
 
 template <TargetBits Target>
@@ -65,11 +345,7 @@ void HighwayHashCat<Target>::operator()(const HHKey& key,
                                         const StringView* HH_RESTRICT fragments,
                                         const size_t num_fragments,
                                         HHResult64* HH_RESTRICT hash) const {
-  HighwayHashCatT<Target> cat(key);
-  for (size_t i = 0; i < num_fragments; ++i) {
-    cat.Append(fragments[i].data, fragments[i].num_bytes);
-  }
-  cat.Finalize(hash);
+  HH_TARGET_NAME::Cat(key, fragments, num_fragments, hash);
 }
 
 template <TargetBits Target>
@@ -77,11 +353,7 @@ void HighwayHashCat<Target>::operator()(const HHKey& key,
                                         const StringView* HH_RESTRICT fragments,
                                         const size_t num_fragments,
                                         HHResult128* HH_RESTRICT hash) const {
-  HighwayHashCatT<Target> cat(key);
-  for (size_t i = 0; i < num_fragments; ++i) {
-    cat.Append(fragments[i].data, fragments[i].num_bytes);
-  }
-  cat.Finalize(hash);
+  HH_TARGET_NAME::Cat(key, fragments, num_fragments, hash);
 }
 
 template <TargetBits Target>
@@ -89,16 +361,440 @@ void HighwayHashCat<Target>::operator()(const HHKey& key,
                                         const StringView* HH_RESTRICT fragments,
                                         const size_t num_fragments,
                                         HHResult256* HH_RESTRICT hash) const {
-  HighwayHashCatT<Target> cat(key);
-  for (size_t i = 0; i < num_fragments; ++i) {
-    cat.Append(fragments[i].data, fragments[i].num_bytes);
-  }
-  cat.Finalize(hash);
+  HH_TARGET_NAME::Cat(key, fragments, num_fragments, hash);
+}
+
+#if HH_HAS_IOVEC
+
+template <TargetBits Target>
+void HighwayHashCat<Target>::operator()(const HHKey& key,
+                                        const iovec* HH_RESTRICT fragments,
+                                        const size_t num_fragments,
+                                        HHResult64* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::CatIovec(key, fragments, num_fragments, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashCat<Target>::operator()(const HHKey& key,
+                                        const iovec* HH_RESTRICT fragments,
+                                        const size_t num_fragments,
+                                        HHResult128* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::CatIovec(key, fragments, num_fragments, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashCat<Target>::operator()(const HHKey& key,
+                                        const iovec* HH_RESTRICT fragments,
+                                        const size_t num_fragments,
+                                        HHResult256* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::CatIovec(key, fragments, num_fragments, hash);
+}
+
+#endif  // HH_HAS_IOVEC
+
+template <TargetBits Target>
+void HighwayHashBatch<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const size_t num_messages, HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Batch(key, messages, num_messages, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashBatch<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const size_t num_messages, HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Batch(key, messages, num_messages, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashBatch<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const size_t num_messages, HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Batch(key, messages, num_messages, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashShort<Target>::operator()(const HHKey& key,
+                                          const char* HH_RESTRICT bytes,
+                                          const size_t size,
+                                          HHResult64* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Short(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashShort<Target>::operator()(const HHKey& key,
+                                          const char* HH_RESTRICT bytes,
+                                          const size_t size,
+                                          HHResult128* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Short(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashShort<Target>::operator()(const HHKey& key,
+                                          const char* HH_RESTRICT bytes,
+                                          const size_t size,
+                                          HHResult256* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Short(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashCopy<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         char* HH_RESTRICT copy,
+                                         HHResult64* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Copy(key, bytes, size, copy, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashCopy<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         char* HH_RESTRICT copy,
+                                         HHResult128* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Copy(key, bytes, size, copy, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashCopy<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         char* HH_RESTRICT copy,
+                                         HHResult256* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Copy(key, bytes, size, copy, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporal<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    HHResult64* HH_RESTRICT hash, const size_t prefetch_distance) const {
+  HH_TARGET_NAME::NonTemporal(key, bytes, size, hash, prefetch_distance);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporal<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    HHResult128* HH_RESTRICT hash, const size_t prefetch_distance) const {
+  HH_TARGET_NAME::NonTemporal(key, bytes, size, hash, prefetch_distance);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporal<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    HHResult256* HH_RESTRICT hash, const size_t prefetch_distance) const {
+  HH_TARGET_NAME::NonTemporal(key, bytes, size, hash, prefetch_distance);
+}
+
+template <TargetBits Target>
+void HighwayHashWide<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         HHResult64* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Wide(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashWide<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         HHResult128* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Wide(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashWide<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         HHResult256* HH_RESTRICT hash) const {
+  HH_TARGET_NAME::Wide(key, bytes, size, hash);
+}
+
+template <TargetBits Target>
+void HighwayHashMultiKey<Target>::operator()(
+    const HHKey* HH_RESTRICT keys, const size_t num_keys,
+    const char* HH_RESTRICT bytes, const size_t size,
+    HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::MultiKey(keys, num_keys, bytes, size, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashMultiKey<Target>::operator()(
+    const HHKey* HH_RESTRICT keys, const size_t num_keys,
+    const char* HH_RESTRICT bytes, const size_t size,
+    HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::MultiKey(keys, num_keys, bytes, size, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashMultiKey<Target>::operator()(
+    const HHKey* HH_RESTRICT keys, const size_t num_keys,
+    const char* HH_RESTRICT bytes, const size_t size,
+    HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::MultiKey(keys, num_keys, bytes, size, hashes);
+}
+
+template <TargetBits Target>
+void SipHashBatch<Target>::operator()(const HH_U64 (&key)[2],
+                                      const StringView* HH_RESTRICT messages,
+                                      const size_t num_messages,
+                                      HH_U64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::SipHashBatchT<2, 4>(key, messages, num_messages, hashes);
+}
+
+template <TargetBits Target>
+void SipHash13Batch<Target>::operator()(const HH_U64 (&key)[2],
+                                        const StringView* HH_RESTRICT messages,
+                                        const size_t num_messages,
+                                        HH_U64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::SipHashBatchT<1, 3>(key, messages, num_messages, hashes);
+}
+
+template <TargetBits Target>
+void SipTreeHashTarget<Target>::operator()(const HH_U64 (&key)[4],
+                                           const char* HH_RESTRICT bytes,
+                                           const HH_U64 size,
+                                           HH_U64* HH_RESTRICT hash) const {
+  *hash = HH_TARGET_NAME::SipTreeHashT<2, 4>(key, bytes, size);
+}
+
+template <TargetBits Target>
+void SipTreeHash13Target<Target>::operator()(const HH_U64 (&key)[4],
+                                             const char* HH_RESTRICT bytes,
+                                             const HH_U64 size,
+                                             HH_U64* HH_RESTRICT hash) const {
+  *hash = HH_TARGET_NAME::SipTreeHashT<1, 3>(key, bytes, size);
+}
+
+template <TargetBits Target>
+void SipTreeHashCatUpdate<Target>::operator()(
+    const char* HH_RESTRICT packets, const size_t num_packets,
+    SipTreeHashLaneState<2, 4>* HH_RESTRICT state) const {
+  HH_TARGET_NAME::SipTreeHashCatUpdateT<2, 4>(packets, num_packets, state->v);
+}
+
+template <TargetBits Target>
+void SipTreeHashCatUpdate<Target>::operator()(
+    const char* HH_RESTRICT packets, const size_t num_packets,
+    SipTreeHashLaneState<1, 3>* HH_RESTRICT state) const {
+  HH_TARGET_NAME::SipTreeHashCatUpdateT<1, 3>(packets, num_packets, state->v);
+}
+
+template <TargetBits Target>
+void SipTreeHashCatFinish<Target>::operator()(
+    const HH_U64 (&key)[4], const SipTreeHashLaneState<2, 4>& state,
+    const char* HH_RESTRICT remaining_bytes, const size_t remainder,
+    HH_U64* HH_RESTRICT hash) const {
+  *hash = HH_TARGET_NAME::SipTreeHashCatFinishT<2, 4>(
+      key, state.v, remaining_bytes, remainder);
+}
+
+template <TargetBits Target>
+void SipTreeHashCatFinish<Target>::operator()(
+    const HH_U64 (&key)[4], const SipTreeHashLaneState<1, 3>& state,
+    const char* HH_RESTRICT remaining_bytes, const size_t remainder,
+    HH_U64* HH_RESTRICT hash) const {
+  *hash = HH_TARGET_NAME::SipTreeHashCatFinishT<1, 3>(
+      key, state.v, remaining_bytes, remainder);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint64_t* HH_RESTRICT values,
+    const size_t num_values, HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint64_t* HH_RESTRICT values,
+    const size_t num_values, HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint64_t* HH_RESTRICT values,
+    const size_t num_values, HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint32_t* HH_RESTRICT values,
+    const size_t num_values, HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint32_t* HH_RESTRICT values,
+    const size_t num_values, HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashValues<Target>::operator()(
+    const HHKey& key, const uint32_t* HH_RESTRICT values,
+    const size_t num_values, HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Values(key, values, num_values, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int32_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int32_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int32_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int64_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult64* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int64_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult128* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsets<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT data,
+    const int64_t* HH_RESTRICT offsets, const uint8_t* HH_RESTRICT validity,
+    const size_t num_strings, HHResult256* HH_RESTRICT hashes) const {
+  HH_TARGET_NAME::Offsets(key, data, offsets, validity, num_strings, hashes);
+}
+
+template <TargetBits Target>
+void HighwayHashVerify<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const HHResult64* HH_RESTRICT expected, const size_t num_messages,
+    uint64_t* HH_RESTRICT failures) const {
+  HH_TARGET_NAME::Verify(key, messages, expected, num_messages, failures);
+}
+
+template <TargetBits Target>
+void HighwayHashVerify<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const HHResult128* HH_RESTRICT expected, const size_t num_messages,
+    uint64_t* HH_RESTRICT failures) const {
+  HH_TARGET_NAME::Verify(key, messages, expected, num_messages, failures);
+}
+
+template <TargetBits Target>
+void HighwayHashVerify<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const HHResult256* HH_RESTRICT expected, const size_t num_messages,
+    uint64_t* HH_RESTRICT failures) const {
+  HH_TARGET_NAME::Verify(key, messages, expected, num_messages, failures);
+}
+
+template <TargetBits Target>
+void HighwayHashSelect<Target>::operator()(
+    HighwayHashFunctions* HH_RESTRICT functions) const {
+  functions->target = Target;
+  functions->hash64 = &HH_TARGET_NAME::Hash<HHResult64>;
+  functions->hash128 = &HH_TARGET_NAME::Hash<HHResult128>;
+  functions->hash256 = &HH_TARGET_NAME::Hash<HHResult256>;
+  functions->hash64_128 = &HH_TARGET_NAME::HashBoth<HHResult64, HHResult128>;
+  functions->hash128_256 =
+      &HH_TARGET_NAME::HashBoth<HHResult128, HHResult256>;
+  functions->cat64 = &HH_TARGET_NAME::Cat<HHResult64>;
+  functions->cat128 = &HH_TARGET_NAME::Cat<HHResult128>;
+  functions->cat256 = &HH_TARGET_NAME::Cat<HHResult256>;
+#if HH_HAS_IOVEC
+  functions->cat_iovec64 = &HH_TARGET_NAME::CatIovec<HHResult64>;
+  functions->cat_iovec128 = &HH_TARGET_NAME::CatIovec<HHResult128>;
+  functions->cat_iovec256 = &HH_TARGET_NAME::CatIovec<HHResult256>;
+#endif
+  functions->batch64 = &HH_TARGET_NAME::Batch<HHResult64>;
+  functions->batch128 = &HH_TARGET_NAME::Batch<HHResult128>;
+  functions->batch256 = &HH_TARGET_NAME::Batch<HHResult256>;
+  functions->verify64 = &HH_TARGET_NAME::Verify<HHResult64>;
+  functions->verify128 = &HH_TARGET_NAME::Verify<HHResult128>;
+  functions->verify256 = &HH_TARGET_NAME::Verify<HHResult256>;
+  functions->cat_start = &HH_TARGET_NAME::CatStart;
+  functions->cat_append = &HH_TARGET_NAME::CatAppend;
+  functions->cat_append_copy = &HH_TARGET_NAME::CatAppendCopy;
+  functions->cat_finish64 = &HH_TARGET_NAME::CatFinish<HHResult64>;
+  functions->cat_finish128 = &HH_TARGET_NAME::CatFinish<HHResult128>;
+  functions->cat_finish256 = &HH_TARGET_NAME::CatFinish<HHResult256>;
+  functions->cat_serialize = &HH_TARGET_NAME::CatSerialize;
+  functions->cat_deserialize = &HH_TARGET_NAME::CatDeserialize;
+  functions->compact_start = &HH_TARGET_NAME::CompactStart;
+  functions->compact_append = &HH_TARGET_NAME::CompactAppend;
+  functions->compact_finish64 = &HH_TARGET_NAME::CompactFinish<HHResult64>;
+  functions->compact_finish128 = &HH_TARGET_NAME::CompactFinish<HHResult128>;
+  functions->compact_finish256 = &HH_TARGET_NAME::CompactFinish<HHResult256>;
+  functions->short64 = &HH_TARGET_NAME::Short<HHResult64>;
+  functions->short128 = &HH_TARGET_NAME::Short<HHResult128>;
+  functions->short256 = &HH_TARGET_NAME::Short<HHResult256>;
+  functions->padded64 = &HH_TARGET_NAME::Padded<HHResult64>;
+  functions->padded128 = &HH_TARGET_NAME::Padded<HHResult128>;
+  functions->padded256 = &HH_TARGET_NAME::Padded<HHResult256>;
+  functions->wide64 = &HH_TARGET_NAME::Wide<HHResult64>;
+  functions->wide128 = &HH_TARGET_NAME::Wide<HHResult128>;
+  functions->wide256 = &HH_TARGET_NAME::Wide<HHResult256>;
+  functions->prepare = &HH_TARGET_NAME::Prepare;
+  functions->prepared64 = &HH_TARGET_NAME::Prepared<HHResult64>;
+  functions->prepared128 = &HH_TARGET_NAME::Prepared<HHResult128>;
+  functions->prepared256 = &HH_TARGET_NAME::Prepared<HHResult256>;
+  functions->prepared_u64 = &HH_TARGET_NAME::PreparedValue<uint64_t>;
+  functions->prepared_u32 = &HH_TARGET_NAME::PreparedValue<uint32_t>;
+  functions->multi_key64 = &HH_TARGET_NAME::MultiKey<HHResult64>;
+  functions->multi_key128 = &HH_TARGET_NAME::MultiKey<HHResult128>;
+  functions->multi_key256 = &HH_TARGET_NAME::MultiKey<HHResult256>;
+  functions->values_u64 = &HH_TARGET_NAME::Values<uint64_t, HHResult64>;
+  functions->values_u32 = &HH_TARGET_NAME::Values<uint32_t, HHResult64>;
+  functions->offsets32 = &HH_TARGET_NAME::Offsets<int32_t, HHResult64>;
+  functions->offsets64 = &HH_TARGET_NAME::Offsets<int64_t, HHResult64>;
+  functions->sample_values_u64 = &HH_TARGET_NAME::SampleValues<uint64_t>;
+  functions->sample_values_u32 = &HH_TARGET_NAME::SampleValues<uint32_t>;
+  functions->sample_offsets32 = &HH_TARGET_NAME::SampleOffsets<int32_t>;
+  functions->sample_offsets64 = &HH_TARGET_NAME::SampleOffsets<int64_t>;
 }
 
 // Instantiate for the current target.
 template struct HighwayHash<HH_TARGET>;
 template struct HighwayHashCat<HH_TARGET>;
+template struct HighwayHashBatch<HH_TARGET>;
+template struct HighwayHashShort<HH_TARGET>;
+template struct HighwayHashCopy<HH_TARGET>;
+template struct HighwayHashMultiKey<HH_TARGET>;
+template struct HighwayHashNonTemporal<HH_TARGET>;
+template struct HighwayHashOffsets<HH_TARGET>;
+template struct HighwayHashValues<HH_TARGET>;
+template struct HighwayHashVerify<HH_TARGET>;
+template struct HighwayHashWide<HH_TARGET>;
+template struct SipHashBatch<HH_TARGET>;
+template struct SipHash13Batch<HH_TARGET>;
+template struct SipTreeHashTarget<HH_TARGET>;
+template struct SipTreeHash13Target<HH_TARGET>;
+template struct SipTreeHashCatUpdate<HH_TARGET>;
+template struct SipTreeHashCatFinish<HH_TARGET>;
+template struct HighwayHashSelect<HH_TARGET>;
 
 }  // namespace highwayhash
 #endif  // HH_DISABLE_TARGET_SPECIFIC
@@ -26,6 +26,15 @@
 #include "highwayhash/arch_specific.h"
 #include "highwayhash/compiler_specific.h"
 #include "highwayhash/hh_types.h"
+#include "highwayhash/sip_tree_hash.h"  // SipTreeHashLaneState
+#include "highwayhash/state_helpers.h"  // HH_U64
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/uio.h>  // iovec
+#define HH_HAS_IOVEC 1
+#else
+#define HH_HAS_IOVEC 0
+#endif
 
 namespace highwayhash {
 
@@ -56,14 +65,6 @@ struct HighwayHash {
                   const size_t size, HHResult256* HH_RESTRICT hash) const;
 };
 
-// Replacement for C++17 std::string_view that avoids dependencies.
-// A struct requires fewer allocations when calling HighwayHashCat with
-// non-const "num_fragments".
-struct StringView {
-  const char* data;  // not necessarily aligned/padded
-  size_t num_bytes;  // possibly zero
-};
-
 // Note: this interface avoids dispatch overhead per fragment.
 template <TargetBits Target>
 struct HighwayHashCat {
@@ -84,6 +85,528 @@ struct HighwayHashCat {
   void operator()(const HHKey& key, const StringView* HH_RESTRICT fragments,
                   const size_t num_fragments,
                   HHResult256* HH_RESTRICT hash) const;
+
+#if HH_HAS_IOVEC
+  // Same as above, for scatter-gather lists as passed to readv/writev.
+  void operator()(const HHKey& key, const iovec* HH_RESTRICT fragments,
+                  const size_t num_fragments,
+                  HHResult64* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const iovec* HH_RESTRICT fragments,
+                  const size_t num_fragments,
+                  HHResult128* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const iovec* HH_RESTRICT fragments,
+                  const size_t num_fragments,
+                  HHResult256* HH_RESTRICT hash) const;
+#endif
+};
+
+// Usage: InstructionSets::Run<HighwayHashBatch>(key, messages, num, hashes).
+// Amortizes the dispatch overhead over many short messages, and hashes them
+// faster than individual HighwayHash calls by interleaving several states.
+template <TargetBits Target>
+struct HighwayHashBatch {
+  // Stores a 64/128/256 bit hash of each of the "num_messages" "messages" in
+  // the corresponding element of "hashes" using the HighwayHashBatchT
+  // implementation for "Target". Each hash is identical to HighwayHash of
+  // that message, regardless of Target.
+  //
+  // "key" is a (randomly generated or hard-coded) HHKey.
+  // "messages" contain unaligned pointers and the number of valid bytes.
+  // "num_messages" indicates the number of entries in "messages".
+  // "hashes" is an array of "num_messages" HHResult (64, 128 or 256 bits).
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const size_t num_messages,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const size_t num_messages,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const size_t num_messages,
+                  HHResult256* HH_RESTRICT hashes) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashShort>(key, bytes, size, hash).
+// Faster than HighwayHash for inputs of at most 32 bytes, e.g. hash table keys,
+// if at least 32 bytes starting at "bytes" are readable.
+template <TargetBits Target>
+struct HighwayHashShort {
+  // Stores the same 64/128/256 bit hash as HighwayHash<Target> using the
+  // HighwayHashShortT implementation. "size" must not exceed 32, but 32 bytes
+  // are read regardless of "size"; the others do not affect the result.
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult64* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult128* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult256* HH_RESTRICT hash) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashCopy>(key, bytes, size, copy, hash).
+// Faster than memcpy followed by HighwayHash for inputs that are not in the
+// caches, because they are only read once.
+template <TargetBits Target>
+struct HighwayHashCopy {
+  // Copies "size" bytes from "bytes" to "copy" (which must not overlap) and
+  // stores the same 64/128/256 bit hash of them as HighwayHash<Target> using
+  // the HighwayHashCopyT implementation.
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, char* HH_RESTRICT copy,
+                  HHResult64* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, char* HH_RESTRICT copy,
+                  HHResult128* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, char* HH_RESTRICT copy,
+                  HHResult256* HH_RESTRICT hash) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashNonTemporal>(key, bytes, size, hash).
+// For large inputs that are hashed once and not accessed again, e.g. streams
+// much larger than the last-level cache.
+template <TargetBits Target>
+struct HighwayHashNonTemporal {
+  // Stores the same 64/128/256 bit hash as HighwayHash<Target> using the
+  // HighwayHashNonTemporalT implementation, which prefetches
+  // "prefetch_distance" bytes ahead with a non-temporal hint to reduce the
+  // displacement of other data from the caches.
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult64* HH_RESTRICT hash,
+                  const size_t prefetch_distance = HH_PREFETCH_DISTANCE) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult128* HH_RESTRICT hash,
+                  const size_t prefetch_distance = HH_PREFETCH_DISTANCE) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult256* HH_RESTRICT hash,
+                  const size_t prefetch_distance = HH_PREFETCH_DISTANCE) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashValues>(key, values, num, hashes).
+// Hashes columns of integers, e.g. join keys or partitioning keys.
+template <TargetBits Target>
+struct HighwayHashValues {
+  // Stores a 64/128/256 bit hash of each of the "num_values" "values" in the
+  // corresponding element of "hashes" using the HighwayHashValuesT
+  // implementation for "Target". Each hash is identical to HighwayHash of the
+  // 8 (or 4 for uint32_t) little-endian bytes of that value.
+  void operator()(const HHKey& key, const uint64_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const uint64_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const uint64_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult256* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const uint32_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const uint32_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const uint32_t* HH_RESTRICT values,
+                  const size_t num_values,
+                  HHResult256* HH_RESTRICT hashes) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashOffsets>(key, data, offsets,
+//   validity, num, hashes).
+// Hashes columns of strings stored as Apache Arrow data and offsets buffers.
+template <TargetBits Target>
+struct HighwayHashOffsets {
+  // Stores a 64/128/256 bit hash of each of the "num_strings" strings in the
+  // corresponding element of "hashes" using the HighwayHashOffsetsT
+  // implementation for "Target", which also documents the arguments. Each hash
+  // of a non-null string is identical to HighwayHash of its bytes.
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int32_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int32_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int32_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult256* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int64_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int64_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT data,
+                  const int64_t* HH_RESTRICT offsets,
+                  const uint8_t* HH_RESTRICT validity,
+                  const size_t num_strings,
+                  HHResult256* HH_RESTRICT hashes) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashMultiKey>(keys, num_keys, bytes, size,
+// hashes).
+template <TargetBits Target>
+struct HighwayHashMultiKey {
+  // Stores a 64/128/256 bit hash of "bytes" under each of the "num_keys" keys
+  // in the corresponding element of "hashes", using the HighwayHashMultiKeyT
+  // implementation for the "Target" CPU. Each hash is identical to
+  // HighwayHash::operator() with that key. Up to four keys share one pass
+  // over the input; more keys require one pass per four.
+  void operator()(const HHKey* HH_RESTRICT keys, const size_t num_keys,
+                  const char* HH_RESTRICT bytes, const size_t size,
+                  HHResult64* HH_RESTRICT hashes) const;
+  void operator()(const HHKey* HH_RESTRICT keys, const size_t num_keys,
+                  const char* HH_RESTRICT bytes, const size_t size,
+                  HHResult128* HH_RESTRICT hashes) const;
+  void operator()(const HHKey* HH_RESTRICT keys, const size_t num_keys,
+                  const char* HH_RESTRICT bytes, const size_t size,
+                  HHResult256* HH_RESTRICT hashes) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashWide>(key, bytes, size, hash).
+// WARNING: the results differ from HighwayHash of the same input. Faster for
+// inputs of at least several hundred bytes.
+template <TargetBits Target>
+struct HighwayHashWide {
+  // Stores a 64/128/256 bit hash of "bytes" using the HighwayHashWideT
+  // implementation for the "Target" CPU. The hash result is identical
+  // regardless of which implementation is used. The arguments are the same as
+  // for HighwayHash::operator().
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult64* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult128* HH_RESTRICT hash) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, HHResult256* HH_RESTRICT hash) const;
+};
+
+// Usage: InstructionSets::Run<SipHashBatch>(key, messages, num, hashes).
+// For legacy protocols that require SipHash of many short messages (e.g.
+// rehashing the keys of a hash table). Hashes 8 (AVX-512), 4 (AVX2) or 2
+// (NEON) messages at a time, one per SIMD lane; the other targets hash them
+// one by one. See SipHashBatchT in sip_hash_batch.h.
+template <TargetBits Target>
+struct SipHashBatch {
+  // Stores SipHash (SipHash-2-4) of each of the "num_messages" "messages" in
+  // the corresponding element of "hashes". Each hash is identical to SipHash
+  // of that message, regardless of Target.
+  //
+  // "key" is a secret 128-bit key unknown to attackers.
+  // "messages" contain unaligned pointers and the number of valid bytes.
+  // "hashes" is an array of "num_messages" hashes.
+  void operator()(const HH_U64 (&key)[2],
+                  const StringView* HH_RESTRICT messages,
+                  const size_t num_messages,
+                  HH_U64* HH_RESTRICT hashes) const;
+};
+
+// Same as SipHashBatch, but the results are identical to SipHash13.
+template <TargetBits Target>
+struct SipHash13Batch {
+  void operator()(const HH_U64 (&key)[2],
+                  const StringView* HH_RESTRICT messages,
+                  const size_t num_messages,
+                  HH_U64* HH_RESTRICT hashes) const;
+};
+
+// Usage: InstructionSets::Run<SipTreeHashTarget>(key, bytes, size, &hash).
+// The implementation behind SipTreeHash in sip_tree_hash.h, which calls this.
+// See SipTreeHashT in sip_tree_hash_lanes.h.
+template <TargetBits Target>
+struct SipTreeHashTarget {
+  // Stores SipTreeHash of "size" bytes in "hash". The result is identical to
+  // ScalarSipTreeHash of the same input, regardless of Target.
+  void operator()(const HH_U64 (&key)[4], const char* HH_RESTRICT bytes,
+                  const HH_U64 size, HH_U64* HH_RESTRICT hash) const;
+};
+
+// Same as SipTreeHashTarget, but the results are identical to
+// ScalarSipTreeHash13.
+template <TargetBits Target>
+struct SipTreeHash13Target {
+  void operator()(const HH_U64 (&key)[4], const char* HH_RESTRICT bytes,
+                  const HH_U64 size, HH_U64* HH_RESTRICT hash) const;
+};
+
+// Usage: InstructionSets::Run<SipTreeHashCatUpdate>(packets, num, &state).
+// Used by SipTreeHashCatT in sip_tree_hash.h, which calls this once per Append.
+template <TargetBits Target>
+struct SipTreeHashCatUpdate {
+  // Updates "state" with "num_packets" consecutive (unaligned) 32-byte
+  // packets. The overload determines the number of rounds.
+  void operator()(const char* HH_RESTRICT packets, const size_t num_packets,
+                  SipTreeHashLaneState<2, 4>* HH_RESTRICT state) const;
+  void operator()(const char* HH_RESTRICT packets, const size_t num_packets,
+                  SipTreeHashLaneState<1, 3>* HH_RESTRICT state) const;
+};
+
+// Usage: InstructionSets::Run<SipTreeHashCatFinish>(key, state, remaining,
+// remainder, &hash).
+template <TargetBits Target>
+struct SipTreeHashCatFinish {
+  // Stores the hash of the packets in "state" followed by the "remainder"
+  // (< 32) "remaining_bytes" in "hash". Same result as SipTreeHash(13) of
+  // the entire input.
+  void operator()(const HH_U64 (&key)[4],
+                  const SipTreeHashLaneState<2, 4>& state,
+                  const char* HH_RESTRICT remaining_bytes,
+                  const size_t remainder, HH_U64* HH_RESTRICT hash) const;
+  void operator()(const HH_U64 (&key)[4],
+                  const SipTreeHashLaneState<1, 3>& state,
+                  const char* HH_RESTRICT remaining_bytes,
+                  const size_t remainder, HH_U64* HH_RESTRICT hash) const;
+};
+
+// Usage: InstructionSets::Run<HighwayHashVerify>(key, messages, expected, num,
+// failures). Verifies HighwayHash tags (MACs) of many messages without
+// timing leaks.
+template <TargetBits Target>
+struct HighwayHashVerify {
+  // Sets bit i % 64 of failures[i / 64] if the hash of message i differs from
+  // expected[i]; see HighwayHashVerifyT. "failures" must have room for
+  // (num_messages + 63) / 64 words.
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const HHResult64* HH_RESTRICT expected,
+                  const size_t num_messages,
+                  uint64_t* HH_RESTRICT failures) const;
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const HHResult128* HH_RESTRICT expected,
+                  const size_t num_messages,
+                  uint64_t* HH_RESTRICT failures) const;
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const HHResult256* HH_RESTRICT expected,
+                  const size_t num_messages,
+                  uint64_t* HH_RESTRICT failures) const;
+};
+
+// Opaque storage for HighwayHashCatT of any target, for callers that cannot
+// include highwayhash.h (e.g. the C bindings). Includes padding for 64-byte
+// alignment because operator new only guarantees 16 bytes before C++17.
+struct HighwayHashCatStorage {
+  char bytes[256 + 64];
+};
+
+// Opaque storage for HighwayHashKeyedT of any target, i.e. a HHStateT after
+// Reset, for hashing many inputs with the same key via the prepared* members
+// of HighwayHashFunctions. Includes padding for alignment as above.
+struct HighwayHashPreparedKey {
+  char bytes[128 + 64];
+};
+
+// Pointers to the above implementations for a single target. Callers that
+// cannot hoist InstructionSets::Run out of their loops (e.g. short keys hashed
+// from many call sites) can resolve this table once and then pay only for an
+// indirect call. See HighwayHashDispatch in highwayhash_dispatch.h.
+struct HighwayHashFunctions {
+  template <typename Result>
+  using HashFunc = void (*)(const HHKey& key, const char* HH_RESTRICT bytes,
+                            const size_t size, Result* HH_RESTRICT hash);
+  template <typename Result>
+  using CatFunc = void (*)(const HHKey& key,
+                           const StringView* HH_RESTRICT fragments,
+                           const size_t num_fragments,
+                           Result* HH_RESTRICT hash);
+  template <typename Result>
+  using BatchFunc = void (*)(const HHKey& key,
+                             const StringView* HH_RESTRICT messages,
+                             const size_t num_messages,
+                             Result* HH_RESTRICT hashes);
+  template <typename Result>
+  using VerifyFunc = size_t (*)(const HHKey& key,
+                                const StringView* HH_RESTRICT messages,
+                                const Result* HH_RESTRICT expected,
+                                const size_t num_messages,
+                                uint64_t* HH_RESTRICT failures);
+#if HH_HAS_IOVEC
+  template <typename Result>
+  using CatIovecFunc = void (*)(const HHKey& key,
+                                const iovec* HH_RESTRICT fragments,
+                                const size_t num_fragments,
+                                Result* HH_RESTRICT hash);
+#endif
+  template <typename Result>
+  using PreparedFunc = void (*)(
+      const HighwayHashPreparedKey* HH_RESTRICT prepared,
+      const char* HH_RESTRICT bytes, const size_t size,
+      Result* HH_RESTRICT hash);
+  template <typename Result>
+  using MultiKeyFunc = void (*)(const HHKey* HH_RESTRICT keys,
+                                const size_t num_keys,
+                                const char* HH_RESTRICT bytes,
+                                const size_t size, Result* HH_RESTRICT hashes);
+  template <typename Result>
+  using CatFinishFunc = void (*)(const HighwayHashCatStorage* HH_RESTRICT cat,
+                                 Result* HH_RESTRICT hash);
+
+  // The HH_TARGET_* (a single bit) whose implementations these are.
+  TargetBits target;
+
+  // Same interface and results as HighwayHash<target>::operator().
+  HashFunc<HHResult64> hash64;
+  HashFunc<HHResult128> hash128;
+  HashFunc<HHResult256> hash256;
+
+  // Same results as hash64 and hash128 (or hash128 and hash256) of the same
+  // input, at little more than the cost of the wider one; see the two-result
+  // HighwayHashT.
+  void (*hash64_128)(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, HHResult64* HH_RESTRICT hash64,
+                     HHResult128* HH_RESTRICT hash128);
+  void (*hash128_256)(const HHKey& key, const char* HH_RESTRICT bytes,
+                      const size_t size, HHResult128* HH_RESTRICT hash128,
+                      HHResult256* HH_RESTRICT hash256);
+
+  // Same interface and results as HighwayHashCat<target>::operator().
+  CatFunc<HHResult64> cat64;
+  CatFunc<HHResult128> cat128;
+  CatFunc<HHResult256> cat256;
+#if HH_HAS_IOVEC
+  CatIovecFunc<HHResult64> cat_iovec64;
+  CatIovecFunc<HHResult128> cat_iovec128;
+  CatIovecFunc<HHResult256> cat_iovec256;
+#endif
+
+  // Same interface and results as HighwayHashBatch<target>::operator().
+  BatchFunc<HHResult64> batch64;
+  BatchFunc<HHResult128> batch128;
+  BatchFunc<HHResult256> batch256;
+
+  // Same as HighwayHashVerify<target>::operator(), and also returns the
+  // number of mismatches.
+  VerifyFunc<HHResult64> verify64;
+  VerifyFunc<HHResult128> verify128;
+  VerifyFunc<HHResult256> verify256;
+
+  // Incremental hashing via HighwayHashCatT<target> in "cat", for callers
+  // that cannot include highwayhash.h. cat_start (re)initializes "cat" with
+  // a key and must be called first. The cat_finish* do not modify "cat".
+  void (*cat_start)(const HHKey& key, HighwayHashCatStorage* HH_RESTRICT cat);
+  void (*cat_append)(HighwayHashCatStorage* HH_RESTRICT cat,
+                     const char* HH_RESTRICT bytes, const size_t num_bytes);
+  // Same as cat_append, but also copies the bytes to "copy" (which must not
+  // overlap) while reading them only once; see HighwayHashCatT::AppendCopy.
+  void (*cat_append_copy)(HighwayHashCatStorage* HH_RESTRICT cat,
+                          const char* HH_RESTRICT bytes,
+                          const size_t num_bytes, char* HH_RESTRICT copy);
+  CatFinishFunc<HHResult64> cat_finish64;
+  CatFinishFunc<HHResult128> cat_finish128;
+  CatFinishFunc<HHResult256> cat_finish256;
+
+  // Stores the state of "cat" in the target- and byte order-independent
+  // "snapshot" (see HighwayHashCatT::Serialize). cat_deserialize initializes
+  // "cat" (it is not necessary to call cat_start first) from a snapshot
+  // created by any table, or returns false if it is invalid.
+  void (*cat_serialize)(const HighwayHashCatStorage* HH_RESTRICT cat,
+                        HHCatSnapshot* HH_RESTRICT snapshot);
+  bool (*cat_deserialize)(const HHCatSnapshot& snapshot,
+                          HighwayHashCatStorage* HH_RESTRICT cat);
+
+  // Incremental hashing of a tightly packed HHCompactCat, e.g. in arrays of
+  // many concurrent streams; same as HighwayHashCompact*T<target>. Results
+  // are identical to the cat_* members, and a HHCompactCat may be used with
+  // any table of the same process.
+  void (*compact_start)(const HHKey& key, HHCompactCat* HH_RESTRICT compact);
+  void (*compact_append)(HHCompactCat* HH_RESTRICT compact,
+                         const char* HH_RESTRICT bytes,
+                         const size_t num_bytes);
+  void (*compact_finish64)(const HHCompactCat& compact,
+                           HHResult64* HH_RESTRICT hash);
+  void (*compact_finish128)(const HHCompactCat& compact,
+                            HHResult128* HH_RESTRICT hash);
+  void (*compact_finish256)(const HHCompactCat& compact,
+                            HHResult256* HH_RESTRICT hash);
+
+  // Same interface and results as HighwayHashShort<target>::operator(), i.e.
+  // for sizes up to 32, with 32 readable bytes.
+  HashFunc<HHResult64> short64;
+  HashFunc<HHResult128> short128;
+  HashFunc<HHResult256> short256;
+
+  // Same results as hash*, but as HighwayHashPaddedT<target>: any size, and
+  // the caller promises that 32 bytes after the end of the input are readable.
+  HashFunc<HHResult64> padded64;
+  HashFunc<HHResult128> padded128;
+  HashFunc<HHResult256> padded256;
+
+  // Same interface and results as HighwayHashWide<target>::operator().
+  HashFunc<HHResult64> wide64;
+  HashFunc<HHResult128> wide128;
+  HashFunc<HHResult256> wide256;
+
+  // Hashing with a key that was prepared once via HighwayHashKeyedT<target>
+  // in "prepared". prepare must be called first. The prepared* return the same
+  // results as hash* with that key and do not modify "prepared", so they may
+  // be called concurrently. A HighwayHashPreparedKey must only be used with
+  // the table that prepared it (e.g. not copied to another machine).
+  void (*prepare)(const HHKey& key,
+                  HighwayHashPreparedKey* HH_RESTRICT prepared);
+  PreparedFunc<HHResult64> prepared64;
+  PreparedFunc<HHResult128> prepared128;
+  PreparedFunc<HHResult256> prepared256;
+
+  // Same results as prepared64 of the 8 (or 4) little-endian bytes of
+  // "value"; see HighwayHashU64T.
+  HHResult64 (*prepared_u64)(const HighwayHashPreparedKey* HH_RESTRICT prepared,
+                             const uint64_t value);
+  HHResult64 (*prepared_u32)(const HighwayHashPreparedKey* HH_RESTRICT prepared,
+                             const uint32_t value);
+
+  // Same interface and results as HighwayHashMultiKey<target>::operator().
+  MultiKeyFunc<HHResult64> multi_key64;
+  MultiKeyFunc<HHResult128> multi_key128;
+  MultiKeyFunc<HHResult256> multi_key256;
+
+  // Same interface and results as HighwayHashValues<target>::operator().
+  void (*values_u64)(const HHKey& key, const uint64_t* HH_RESTRICT values,
+                     const size_t num_values, HHResult64* HH_RESTRICT hashes);
+  void (*values_u32)(const HHKey& key, const uint32_t* HH_RESTRICT values,
+                     const size_t num_values, HHResult64* HH_RESTRICT hashes);
+
+  // Same interface and results as HighwayHashOffsets<target>::operator().
+  void (*offsets32)(const HHKey& key, const char* HH_RESTRICT data,
+                    const int32_t* HH_RESTRICT offsets,
+                    const uint8_t* HH_RESTRICT validity,
+                    const size_t num_strings, HHResult64* HH_RESTRICT hashes);
+  void (*offsets64)(const HHKey& key, const char* HH_RESTRICT data,
+                    const int64_t* HH_RESTRICT offsets,
+                    const uint8_t* HH_RESTRICT validity,
+                    const size_t num_strings, HHResult64* HH_RESTRICT hashes);
+
+  // Consistent sampling of integer or string columns: same interface and
+  // results as HighwayHashSampleValuesT/HighwayHashSampleOffsetsT<target>,
+  // i.e. sets the bits of rows whose HHResult64 is less than "threshold"
+  // (see HighwayHashSampleThreshold) and returns their number.
+  size_t (*sample_values_u64)(const HHKey& key,
+                              const uint64_t* HH_RESTRICT values,
+                              const size_t num_values, const uint64_t threshold,
+                              uint64_t* HH_RESTRICT selected);
+  size_t (*sample_values_u32)(const HHKey& key,
+                              const uint32_t* HH_RESTRICT values,
+                              const size_t num_values, const uint64_t threshold,
+                              uint64_t* HH_RESTRICT selected);
+  size_t (*sample_offsets32)(const HHKey& key, const char* HH_RESTRICT data,
+                             const int32_t* HH_RESTRICT offsets,
+                             const uint8_t* HH_RESTRICT validity,
+                             const size_t num_strings, const uint64_t threshold,
+                             uint64_t* HH_RESTRICT selected);
+  size_t (*sample_offsets64)(const HHKey& key, const char* HH_RESTRICT data,
+                             const int64_t* HH_RESTRICT offsets,
+                             const uint8_t* HH_RESTRICT validity,
+                             const size_t num_strings, const uint64_t threshold,
+                             uint64_t* HH_RESTRICT selected);
+};
+
+// Usage: InstructionSets::Run<HighwayHashSelect>(&functions).
+template <TargetBits Target>
+struct HighwayHashSelect {
+  // Sets all members of "functions" to the implementations for "Target".
+  void operator()(HighwayHashFunctions* HH_RESTRICT functions) const;
 };
 
 }  // namespace highwayhash
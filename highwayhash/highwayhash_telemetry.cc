@@ -0,0 +1,224 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_telemetry.h"
+
+#include <stdio.h>
+#include <atomic>
+
+#include "highwayhash/data_parallel.h"
+
+namespace highwayhash {
+
+constexpr size_t HighwayHashTelemetry::kNumSizeClasses;
+constexpr size_t HighwayHashTelemetry::kNumTargets;
+
+size_t HighwayHashTelemetry::SizeClass(const size_t size) {
+  if (size <= 16) return 0;
+  // Index of the most significant bit of size - 1 >= 16, minus 3.
+#if HH_MSC_VERSION
+  unsigned long index;
+  _BitScanReverse64(&index, size - 1);
+  const size_t size_class = index - 3;
+#else
+  const size_t size_class = 63 - __builtin_clzll(size - 1) - 3;
+#endif
+  return size_class < kNumSizeClasses ? size_class : kNumSizeClasses - 1;
+}
+
+size_t HighwayHashTelemetry::MaxSize(const size_t size_class) {
+  if (size_class + 1 >= kNumSizeClasses) return ~size_t(0);
+  return size_t(16) << size_class;
+}
+
+std::string HighwayHashTelemetry::ToString() const {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "calls=%llu bytes=%llu",
+           static_cast<unsigned long long>(calls),
+           static_cast<unsigned long long>(bytes));
+  std::string result = buf;
+  for (size_t c = 0; c < kNumSizeClasses; ++c) {
+    if (calls_by_size[c] == 0) continue;
+    const unsigned long long count = calls_by_size[c];
+    if (c + 1 == kNumSizeClasses) {
+      snprintf(buf, sizeof(buf), " size>%zu:%llu", MaxSize(c - 1), count);
+    } else {
+      snprintf(buf, sizeof(buf), " size<=%zu:%llu", MaxSize(c), count);
+    }
+    result += buf;
+  }
+  for (size_t t = 0; t < kNumTargets; ++t) {
+    if (calls_by_target[t] == 0) continue;
+    snprintf(buf, sizeof(buf), " %s:%llu", TargetName(1u << t),
+             static_cast<unsigned long long>(calls_by_target[t]));
+    result += buf;
+  }
+  return result;
+}
+
+namespace {
+
+// Per-thread counters. Only the owning thread writes them, so relaxed load
+// and store suffice (no lock prefix or contention) and snapshots from other
+// threads are not data races. Calls are the sum of calls_by_size.
+struct Counters {
+  Counters() {
+    bytes.store(0, std::memory_order_relaxed);
+    for (std::atomic<uint64_t>& count : calls_by_size) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> calls_by_size[HighwayHashTelemetry::kNumSizeClasses];
+};
+
+HH_INLINE void Add(std::atomic<uint64_t>* counter, const uint64_t amount) {
+  counter->store(counter->load(std::memory_order_relaxed) + amount,
+                 std::memory_order_relaxed);
+}
+
+HH_INLINE void Record(const size_t size) {
+  Counters& counters = PerThread<Counters>::Get();
+  Add(&counters.bytes, size);
+  Add(&counters.calls_by_size[HighwayHashTelemetry::SizeClass(size)], 1);
+}
+
+size_t TotalSize(const StringView* fragments, const size_t num_fragments) {
+  size_t size = 0;
+  for (size_t i = 0; i < num_fragments; ++i) {
+    size += fragments[i].num_bytes;
+  }
+  return size;
+}
+
+#if HH_HAS_IOVEC
+size_t TotalSize(const iovec* fragments, const size_t num_fragments) {
+  size_t size = 0;
+  for (size_t i = 0; i < num_fragments; ++i) {
+    size += fragments[i].iov_len;
+  }
+  return size;
+}
+#endif
+
+// The uninstrumented table; set before HighwayHashInstrumentedTable returns,
+// which is the only way to reach the wrappers below.
+const HighwayHashFunctions* dispatch;
+
+// Wrappers with the same signature as the "Member" of HighwayHashFunctions
+// they forward to.
+
+template <typename Result, HighwayHashFunctions::HashFunc<Result>
+                               HighwayHashFunctions::*Member>
+void Hash(const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+          Result* HH_RESTRICT hash) {
+  Record(size);
+  (dispatch->*Member)(key, bytes, size, hash);
+}
+
+template <typename Result, typename WiderResult,
+          void (*HighwayHashFunctions::*Member)(
+              const HHKey&, const char* HH_RESTRICT, const size_t,
+              Result* HH_RESTRICT, WiderResult* HH_RESTRICT)>
+void HashBoth(const HHKey& key, const char* HH_RESTRICT bytes,
+              const size_t size, Result* HH_RESTRICT hash,
+              WiderResult* HH_RESTRICT wider_hash) {
+  Record(size);
+  (dispatch->*Member)(key, bytes, size, hash, wider_hash);
+}
+
+template <typename Result, class Fragment,
+          void (*HighwayHashFunctions::*Member)(
+              const HHKey&, const Fragment* HH_RESTRICT, const size_t,
+              Result* HH_RESTRICT)>
+void Cat(const HHKey& key, const Fragment* HH_RESTRICT fragments,
+         const size_t num_fragments, Result* HH_RESTRICT hash) {
+  Record(TotalSize(fragments, num_fragments));
+  (dispatch->*Member)(key, fragments, num_fragments, hash);
+}
+
+void CatAppend(HighwayHashCatStorage* HH_RESTRICT cat,
+               const char* HH_RESTRICT bytes, const size_t num_bytes) {
+  Record(num_bytes);
+  dispatch->cat_append(cat, bytes, num_bytes);
+}
+
+void CatAppendCopy(HighwayHashCatStorage* HH_RESTRICT cat,
+                   const char* HH_RESTRICT bytes, const size_t num_bytes,
+                   char* HH_RESTRICT copy) {
+  Record(num_bytes);
+  dispatch->cat_append_copy(cat, bytes, num_bytes, copy);
+}
+
+void CompactAppend(HHCompactCat* HH_RESTRICT compact,
+                   const char* HH_RESTRICT bytes, const size_t num_bytes) {
+  Record(num_bytes);
+  dispatch->compact_append(compact, bytes, num_bytes);
+}
+
+HighwayHashFunctions Instrument(const HighwayHashFunctions& functions) {
+  dispatch = &functions;
+  using F = HighwayHashFunctions;
+  HighwayHashFunctions instrumented = functions;
+  instrumented.hash64 = &Hash<HHResult64, &F::hash64>;
+  instrumented.hash128 = &Hash<HHResult128, &F::hash128>;
+  instrumented.hash256 = &Hash<HHResult256, &F::hash256>;
+  instrumented.hash64_128 = &HashBoth<HHResult64, HHResult128, &F::hash64_128>;
+  instrumented.hash128_256 =
+      &HashBoth<HHResult128, HHResult256, &F::hash128_256>;
+  instrumented.cat64 = &Cat<HHResult64, StringView, &F::cat64>;
+  instrumented.cat128 = &Cat<HHResult128, StringView, &F::cat128>;
+  instrumented.cat256 = &Cat<HHResult256, StringView, &F::cat256>;
+#if HH_HAS_IOVEC
+  instrumented.cat_iovec64 = &Cat<HHResult64, iovec, &F::cat_iovec64>;
+  instrumented.cat_iovec128 = &Cat<HHResult128, iovec, &F::cat_iovec128>;
+  instrumented.cat_iovec256 = &Cat<HHResult256, iovec, &F::cat_iovec256>;
+#endif
+  instrumented.cat_append = &CatAppend;
+  instrumented.cat_append_copy = &CatAppendCopy;
+  instrumented.compact_append = &CompactAppend;
+  return instrumented;
+}
+
+}  // namespace
+
+const HighwayHashFunctions& HighwayHashInstrumentedTable() {
+  // Function-local static => safe to call from other static initializers.
+  static const HighwayHashFunctions instrumented =
+      Instrument(HighwayHashDispatch());
+  return instrumented;
+}
+
+HighwayHashTelemetry HighwayHashTelemetrySnapshot() {
+  HighwayHashTelemetry telemetry = {};
+  for (const Counters* counters : PerThread<Counters>::Threads()) {
+    telemetry.bytes += counters->bytes.load(std::memory_order_relaxed);
+    for (size_t c = 0; c < HighwayHashTelemetry::kNumSizeClasses; ++c) {
+      const uint64_t calls =
+          counters->calls_by_size[c].load(std::memory_order_relaxed);
+      telemetry.calls_by_size[c] += calls;
+      telemetry.calls += calls;
+    }
+  }
+
+  // All instrumented calls use the dispatched target.
+  const TargetBits target = HighwayHashDispatch().target;
+  for (size_t t = 0; t < HighwayHashTelemetry::kNumTargets; ++t) {
+    if (target == (1u << t)) telemetry.calls_by_target[t] = telemetry.calls;
+  }
+  return telemetry;
+}
+
+}  // namespace highwayhash
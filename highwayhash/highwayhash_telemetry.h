@@ -0,0 +1,95 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_TELEMETRY_H_
+#define HIGHWAYHASH_HIGHWAYHASH_TELEMETRY_H_
+
+// Opt-in counters of how much and what is hashed (calls, bytes, size mix and
+// target) without wrapping every call site: use HighwayHashInstrumented()
+// instead of HighwayHashDispatch() and export HighwayHashTelemetrySnapshot()
+// periodically.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/highwayhash_target.h"
+
+// Compiling with -DHH_TELEMETRY_ENABLED=0 makes HighwayHashInstrumented()
+// return the uninstrumented HighwayHashDispatch() table, so that callers pay
+// nothing for telemetry.
+#ifndef HH_TELEMETRY_ENABLED
+#define HH_TELEMETRY_ENABLED 1
+#endif
+
+namespace highwayhash {
+
+// Sum of the counters of all threads.
+struct HighwayHashTelemetry {
+  // Inputs of up to 16 bytes, then one class per power of two up to 64 KiB,
+  // then all larger inputs.
+  static constexpr size_t kNumSizeClasses = 14;
+  // One per HH_TARGET_* bit.
+  static constexpr size_t kNumTargets = 7;
+
+  // Returns the class containing "size" (the total of all fragments, or the
+  // bytes passed to one cat_append or compact_append).
+  static size_t SizeClass(const size_t size);
+
+  // Returns the largest size in "size_class", or ~0 for the last class.
+  static size_t MaxSize(const size_t size_class);
+
+  // Returns a single line for logging or export, e.g.
+  // "calls=3 bytes=4100 size<=16:2 size<=4096:1 AVX2:3".
+  std::string ToString() const;
+
+  // Number of calls of an instrumented member (each cat_append or
+  // compact_append counts as one call; cat_start and cat_finish* are not
+  // counted).
+  uint64_t calls;
+  uint64_t bytes;
+  uint64_t calls_by_size[kNumSizeClasses];
+  // Index is the position of the target's bit, e.g. 2 for HH_TARGET_AVX2.
+  // Currently all calls are attributed to HighwayHashDispatch().target.
+  uint64_t calls_by_target[kNumTargets];
+};
+
+// Returns a table with the same implementations and results as
+// HighwayHashDispatch(), whose hash*, hash64_128, hash128_256, cat*,
+// cat_iovec*, cat_append, cat_append_copy and compact_append also update
+// counters of the calling thread. Other members are not instrumented. The
+// counters are thread-local, so updating them only costs two loads and stores
+// (no atomic read-modify-write or shared cache lines), plus an indirect call.
+const HighwayHashFunctions& HighwayHashInstrumentedTable();
+
+// Returns the sum of all threads' counters since the start of the process.
+// They increase monotonically, so rates are differences between snapshots.
+// Thread-safe and does not block hashing, but may omit calls that finish
+// concurrently.
+HighwayHashTelemetry HighwayHashTelemetrySnapshot();
+
+// Usage: HighwayHashInstrumented().hash64(key, bytes, size, &hash).
+static HH_INLINE const HighwayHashFunctions& HighwayHashInstrumented() {
+#if HH_TELEMETRY_ENABLED
+  return HighwayHashInstrumentedTable();
+#else
+  return HighwayHashDispatch();
+#endif
+}
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_TELEMETRY_H_
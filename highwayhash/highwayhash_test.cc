@@ -18,17 +18,45 @@
 #include "highwayhash/highwayhash_test_target.h"
 
 #include <stddef.h>
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
 
 #ifdef HH_GOOGLETEST
 #include "testing/base/public/gunit.h"
 #endif
 
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <fcntl.h>
+#include <unistd.h>  // mkstemp, pipe
+#include <thread>  //NOLINT
+#define HH_TEST_FILES 1
+#else
+#define HH_TEST_FILES 0
+#endif
+
+#include "highwayhash/c_bindings.h"
 #include "highwayhash/data_parallel.h"
+#include "highwayhash/file_hash.h"
+#include "highwayhash/fingerprint_index.h"
+#include "highwayhash/hasher.h"
+#include "highwayhash/highwayhash_autotune.h"
+#include "highwayhash/highwayhash_constexpr.h"
+#include "highwayhash/highwayhash_chunker.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/highwayhash_fields.h"
+#include "highwayhash/highwayhash_merkle.h"
 #include "highwayhash/highwayhash_target.h"
+#include "highwayhash/highwayhash_telemetry.h"
+#include "highwayhash/highwayhash_tree.h"
 #include "highwayhash/instruction_sets.h"
+#include "highwayhash/scalar_sip_tree_hash.h"
+#include "highwayhash/sip_hash.h"
+#include "highwayhash/sip_tree_hash.h"
 
 // Define to nonzero in order to print the (new) golden outputs.
 // WARNING: HighwayHash is frozen, so the golden values must not change.
@@ -58,21 +86,68 @@ void Print(const HHResult64 (&result)[kNumLanes]) {
 #endif  // PRINT_RESULTS
 
 // Called when any test fails; exits immediately because one mismatch usually
-// implies many others.
+// implies many others. kTest names the test, e.g. kCat, and "target_name" the
+// implementation or non-target-specific caller. Also the HHNotify passed to
+// the tests run by InstructionSets::RunAll.
+template <const char* kTest>
 void OnFailure(const char* target_name, const size_t size) {
-  printf("Mismatch at size %zu for target %s\n", size, target_name);
+  printf("%s mismatch at size %zu for target %s\n", kTest, size, target_name);
 #ifdef HH_GOOGLETEST
   EXPECT_TRUE(false);
 #endif
   exit(1);
 }
 
+// Prints the targets that passed "test"; failures already exited.
+void PrintOK(const TargetBits tested, const char* test) {
+  HH_TARGET_NAME::ForeachTarget(tested, [test](const TargetBits target) {
+    printf("%10s%s: OK\n", TargetName(target), test);
+  });
+}
+
+// Deterministic on all platforms, unlike rand().
+void FillRandom(uint64_t seed, std::vector<char>* bytes) {
+  for (char& byte : *bytes) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    byte = static_cast<char>(seed >> 56);
+  }
+}
+
+// Input of the tests that compare implementations with each other (or with a
+// reference) rather than with known-good outputs.
+std::vector<char> RandomInput(const size_t size) {
+  std::vector<char> bytes(size);
+  FillRandom(0x9E3779B97F4A7C15ull, &bytes);
+  return bytes;
+}
+
+// Key for the same tests.
+const HHKey kTestKey = {0x0706050403020100ULL, 0x1F1E1D1C1B1A1918ULL,
+                        0x0F0E0D0C0B0A0908ULL, 0x1716151413121110ULL};
+
+// Calls Test<Target>()(kTestKey, RandomInput(size), size, args...) for all
+// targets; "args" typically end with OnFailure<kTest>. Returns which targets
+// were run/verified.
+template <template <TargetBits> class Test, typename... Args>
+TargetBits RunAllOnRandomInput(const size_t size, Args&&... args) {
+  const std::vector<char> flat = RandomInput(size);
+  return InstructionSets::RunAll<Test>(kTestKey, flat.data(), size,
+                                       std::forward<Args>(args)...);
+}
+
+const char kHighwayHash[] = "HighwayHash";
+
+// Key of the known-good outputs below.
+const HHKey kKnownGoodKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                             0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
 // Verifies every combination of implementation and input size. Returns which
 // targets were run/verified.
 template <typename Result>
 TargetBits VerifyImplementations(const Result (&known_good)[kMaxSize + 1]) {
-  const HHKey key = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
-                     0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+  const HHKey& key = kKnownGoodKey;
 
   TargetBits targets = ~0U;
 
@@ -87,8 +162,8 @@ TargetBits VerifyImplementations(const Result (&known_good)[kMaxSize + 1]) {
     Print(actual);
 #else
     const Result* expected = &known_good[size];
-    targets &= InstructionSets::RunAll<HighwayHashTest>(key, in, size, expected,
-                                                        &OnFailure);
+    targets &= InstructionSets::RunAll<HighwayHashTest>(
+        key, in, size, expected, &OnFailure<kHighwayHash>);
 #endif
   }
   return targets;
@@ -96,38 +171,834 @@ TargetBits VerifyImplementations(const Result (&known_good)[kMaxSize + 1]) {
 
 // Cat
 
-void OnCatFailure(const char* target_name, const size_t size) {
-  printf("Cat mismatch at size %zu\n", size);
-#ifdef HH_GOOGLETEST
-  EXPECT_TRUE(false);
+const char kCat[] = "Cat";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyCat(ThreadPool* pool) {
+  const size_t kMaxSize = 3 * 35;
+  const std::vector<char> flat = RandomInput(kMaxSize);
+
+  std::atomic<TargetBits> targets{~0U};
+
+  pool->Run(0, kMaxSize, [&flat, &targets](const uint32_t i) {
+    Result dummy;
+    targets.fetch_and(InstructionSets::RunAll<HighwayHashCatTest>(
+        kTestKey, flat.data(), i, &dummy, &OnFailure<kCat>));
+  });
+  return targets.load();
+}
+
+// Batch
+
+const char kBatch[] = "Batch";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyBatch() {
+  // Large enough for several whole packets shared by both messages of a pair.
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashBatchTest>(3 * 35, &dummy,
+                                                   &OnFailure<kBatch>);
+}
+
+// SipHash batch
+
+const char kSipBatch[] = "SipBatch";
+
+// Returns which targets were run/verified.
+TargetBits VerifySipBatch() {
+  // Several whole packets per message plus a partial one.
+  const size_t kMaxSize = 3 * 35;
+  const std::vector<char> input = RandomInput(kMaxSize);
+  const char* flat = input.data();
+  const TargetBits tested = InstructionSets::RunAll<SipHashBatchTest>(
+      flat, kMaxSize, &OnFailure<kSipBatch>);
+
+  // Also compare the dispatched functors with the non-target-specific SipHash
+  // (SipHashBatchTest can only use the implementation for its own target).
+  const HH_U64 key[2] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL};
+  StringView messages[kMaxSize + 1];
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    messages[size].data = flat;
+    messages[size].num_bytes = size;
+  }
+  HH_U64 hashes[kMaxSize + 1];
+  HH_U64 hashes13[kMaxSize + 1];
+  InstructionSets::Run<SipHashBatch>(key, messages, kMaxSize + 1, hashes);
+  InstructionSets::Run<SipHash13Batch>(key, messages, kMaxSize + 1, hashes13);
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    if (hashes[size] != SipHash(key, flat, size) ||
+        hashes13[size] != SipHash13(key, flat, size)) {
+      OnFailure<kSipBatch>("dispatch", size);
+    }
+  }
+  return tested;
+}
+
+// SipTreeHash
+
+const char kSipTree[] = "SipTree";
+
+// Compares the implementation for "Target" with ScalarSipTreeHash.
+template <TargetBits Target>
+struct SipTreeHashTest {
+  void operator()(const char* flat, const size_t max_size) const {
+    const HH_U64 key[4] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                           0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+    for (size_t size = 0; size <= max_size; ++size) {
+      HH_U64 hash;
+      HH_U64 hash13;
+      SipTreeHashTarget<Target>()(key, flat, size, &hash);
+      SipTreeHash13Target<Target>()(key, flat, size, &hash13);
+      if (hash != ScalarSipTreeHash(key, flat, size) ||
+          hash13 != ScalarSipTreeHash13(key, flat, size)) {
+        OnFailure<kSipTree>(TargetName(Target), size);
+      }
+    }
+  }
+};
+
+// Returns which targets were run/verified.
+TargetBits VerifySipTree() {
+  // Several whole packets plus each possible remainder.
+  const size_t kMaxSize = 4 * 32 + 31;
+  const std::vector<char> input = RandomInput(kMaxSize);
+  const char* flat = input.data();
+  const TargetBits tested =
+      InstructionSets::RunAll<SipTreeHashTest>(flat, kMaxSize);
+
+  // The incremental SipTreeHashCat must match the dispatched SipTreeHash for
+  // any fragmentation, including empty and packet-aligned fragments.
+  const HH_U64 key[4] = {1, 2, 3, 4};
+  const size_t kFragmentSizes[] = {1, 31, 0, 32, 5, 64, 27, 33};
+  const size_t kNumFragmentSizes = sizeof(kFragmentSizes) / sizeof(size_t);
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    for (size_t first = 0; first < kNumFragmentSizes; ++first) {
+      SipTreeHashCat cat(key);
+      SipTreeHash13Cat cat13(key);
+      cat.Append(nullptr, 0);
+      size_t pos = 0;
+      for (size_t i = first; pos != size; ++i) {
+        const size_t num_bytes =
+            std::min(kFragmentSizes[i % kNumFragmentSizes], size - pos);
+        cat.Append(flat + pos, num_bytes);
+        cat13.Append(flat + pos, num_bytes);
+        pos += num_bytes;
+      }
+      cat13.Append(nullptr, 0);
+      if (cat.Finalize() != SipTreeHash(key, flat, size) ||
+          cat13.Finalize() != SipTreeHash13(key, flat, size)) {
+        OnFailure<kSipTree>("cat", size);
+      }
+    }
+  }
+  return tested;
+}
+
+// Serialize
+
+const char kSerialize[] = "Serialize";
+
+// Returns which targets were run/verified.
+TargetBits VerifySerialize() {
+  const size_t kMaxSize = 3 * 35;
+  const std::vector<char> flat = RandomInput(kMaxSize);
+
+  // Snapshots of all prefixes from the best target, which all targets must
+  // reproduce and be able to resume.
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  std::vector<HHCatSnapshot> snapshots(kMaxSize + 1);
+  HighwayHashCatStorage cat;
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    dispatch.cat_start(kTestKey, &cat);
+    dispatch.cat_append(&cat, flat.data(), size);
+    dispatch.cat_serialize(&cat, &snapshots[size]);
+  }
+
+  return RunAllOnRandomInput<HighwayHashSerializeTest>(
+      kMaxSize, snapshots.data(), &OnFailure<kSerialize>);
+}
+
+// Fixed size
+
+const char kFixed[] = "Fixed";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyFixed() {
+  // The largest size tested by HighwayHashFixedTest.
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashFixedTest>(1000, &dummy,
+                                                   &OnFailure<kFixed>);
+}
+
+// Short inputs
+
+const char kShort[] = "Short";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyShort() {
+  // Inputs start at offsets 0..31, and 32 bytes must be readable after each,
+  // which kMaxSize (64) allows.
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashShortTest>(kMaxSize, &dummy,
+                                                   &OnFailure<kShort>);
+}
+
+// Padded inputs
+
+const char kPadded[] = "Padded";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyPadded() {
+  Result dummy;
+  return InstructionSets::RunAll<HighwayHashPaddedTest>(
+      kTestKey, nullptr, 0, &dummy, &OnFailure<kPadded>);
+}
+
+// Copy
+
+const char kCopy[] = "Copy";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyCopy() {
+  // Several packets plus any remainder.
+  const size_t kMaxSize = kMaxCopyTestSize;
+  const std::vector<char> input = RandomInput(kMaxSize);
+  const char* flat = input.data();
+  const HHKey& key = kTestKey;
+
+  // The dispatch table's streaming variant, in three fragments.
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  HighwayHashCatStorage cat;
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    char copy[kMaxSize];
+    dispatch.cat_start(key, &cat);
+    dispatch.cat_append_copy(&cat, flat, size / 3, copy);
+    dispatch.cat_append_copy(&cat, flat + size / 3, size / 3, copy + size / 3);
+    dispatch.cat_append_copy(&cat, flat + 2 * (size / 3), size - 2 * (size / 3),
+                             copy + 2 * (size / 3));
+    HHResult64 actual;
+    dispatch.cat_finish64(&cat, &actual);
+    HHResult64 expected;
+    dispatch.hash64(key, flat, size, &expected);
+    if (actual != expected || memcmp(copy, flat, size) != 0) {
+      OnFailure<kCopy>(TargetName(dispatch.target), size);
+    }
+  }
+
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashCopyTest>(kMaxSize, &dummy,
+                                                  &OnFailure<kCopy>);
+}
+
+// Integer values
+
+const char kValues[] = "Values";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyValues() {
+  // 9 uint64_t or 18 uint32_t values.
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashValuesTest>(72, &dummy,
+                                                    &OnFailure<kValues>);
+}
+
+// Verifies the prepared_u* and values_u* members of the dispatch table return
+// the same results as hash64 of the little-endian bytes.
+void VerifyValuesDispatch(const HighwayHashFunctions& dispatch) {
+  const HHKey key = {1, 2, 3, 4};
+  HighwayHashPreparedKey prepared;
+  dispatch.prepare(key, &prepared);
+  const uint64_t values64[3] = {0, 0x0807060504030201ull, ~0ull};
+  const uint32_t values32[3] = {0, 0x04030201u, ~0u};
+  HHResult64 hashes64[3];
+  HHResult64 hashes32[3];
+  dispatch.values_u64(key, values64, 3, hashes64);
+  dispatch.values_u32(key, values32, 3, hashes32);
+  for (size_t i = 0; i < 3; ++i) {
+    char bytes[8];
+    for (size_t j = 0; j < 8; ++j) {
+      bytes[j] = static_cast<char>(values64[i] >> (j * 8));
+    }
+    HHResult64 expected64;
+    dispatch.hash64(key, bytes, 8, &expected64);
+    if (hashes64[i] != expected64 ||
+        dispatch.prepared_u64(&prepared, values64[i]) != expected64) {
+      OnFailure<kValues>("Dispatch", 8);
+    }
+
+    for (size_t j = 0; j < 4; ++j) {
+      bytes[j] = static_cast<char>(values32[i] >> (j * 8));
+    }
+    HHResult64 expected32;
+    dispatch.hash64(key, bytes, 4, &expected32);
+    if (hashes32[i] != expected32 ||
+        dispatch.prepared_u32(&prepared, values32[i]) != expected32) {
+      OnFailure<kValues>("Dispatch", 4);
+    }
+  }
+}
+
+// MAC verification
+
+const char kVerify[] = "Verify";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyMacs() {
+  // Enough for 150 messages (see TestHighwayHashVerify).
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashVerifyTest>(219, &dummy,
+                                                    &OnFailure<kVerify>);
+}
+
+// Verifies the verify* members of the dispatch table accept the tags returned
+// by hash* and reject a forged one.
+void VerifyMacsDispatch(const HighwayHashFunctions& dispatch) {
+  const HHKey key = {1, 2, 3, 4};
+  const StringView messages[3] = {
+      {"", 0}, {"cache entry", 11}, {"another cache entry, 32+ bytes", 31}};
+  HHResult64 tags64[3];
+  HHResult128 tags128[3];
+  HHResult256 tags256[3];
+  for (size_t i = 0; i < 3; ++i) {
+    dispatch.hash64(key, messages[i].data, messages[i].num_bytes, &tags64[i]);
+    dispatch.hash128(key, messages[i].data, messages[i].num_bytes,
+                     &tags128[i]);
+    dispatch.hash256(key, messages[i].data, messages[i].num_bytes,
+                     &tags256[i]);
+  }
+  tags64[1] ^= 1;
+  tags128[1][1] ^= 1ULL << 63;
+  tags256[1][3] ^= 1ULL << 32;
+
+  uint64_t failures64, failures128, failures256;
+  if (dispatch.verify64(key, messages, tags64, 3, &failures64) != 1 ||
+      dispatch.verify128(key, messages, tags128, 3, &failures128) != 1 ||
+      dispatch.verify256(key, messages, tags256, 3, &failures256) != 1 ||
+      failures64 != 2 || failures128 != 2 || failures256 != 2) {
+    OnFailure<kVerify>("Dispatch", 3);
+  }
+}
+
+// Arrow-style string columns
+
+const char kOffsets[] = "Offsets";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyOffsets() {
+  // Enough for lengths 0..69 (see TestHighwayHashOffsetsOf).
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashOffsetsTest>(2415, &dummy,
+                                                     &OnFailure<kOffsets>);
+}
+
+// Verifies the offsets* members of the dispatch table return the same results
+// as hash64 of each string, and zero for nulls.
+void VerifyOffsetsDispatch(const HighwayHashFunctions& dispatch) {
+  const HHKey key = {1, 2, 3, 4};
+  const char data[] = "nullempty-abcdefghijklmnopqrstuvwxyz0123456789";
+  const int32_t offsets32[5] = {0, 4, 4, 10, 46};
+  const int64_t offsets64[5] = {0, 4, 4, 10, 46};
+  const uint8_t validity = 0xE;  // String 0 is null.
+  HHResult64 hashes32[4];
+  HHResult64 hashes64[4];
+  dispatch.offsets32(key, data, offsets32, &validity, 4, hashes32);
+  dispatch.offsets64(key, data, offsets64, &validity, 4, hashes64);
+  for (size_t i = 0; i < 4; ++i) {
+    const size_t size = offsets32[i + 1] - offsets32[i];
+    HHResult64 expected = 0;
+    if (i != 0) {
+      dispatch.hash64(key, data + offsets32[i], size, &expected);
+    }
+    if (hashes32[i] != expected || hashes64[i] != expected) {
+      OnFailure<kOffsets>("Dispatch", size);
+    }
+  }
+}
+
+// Consistent sampling
+
+const char kSample[] = "Sample";
+
+// Returns which targets were run/verified.
+TargetBits VerifySample() {
+  // 300 uint64_t values, i.e. several words of bits; about 94 strings.
+  return RunAllOnRandomInput<HighwayHashSampleTest>(2400, &OnFailure<kSample>);
+}
+
+// Verifies the sample_* members of the dispatch table select the rows whose
+// values_u64/u32 or offsets32/64 hash is below a threshold.
+void VerifySampleDispatch(const HighwayHashFunctions& dispatch) {
+  const HHKey key = {1, 2, 3, 4};
+  const uint64_t threshold = HighwayHashSampleThreshold(0.5);
+  uint64_t values64[100];
+  uint32_t values32[100];
+  for (size_t i = 0; i < 100; ++i) {
+    values64[i] = i * 0x9E3779B97F4A7C15ull;
+    values32[i] = static_cast<uint32_t>(values64[i] >> 32);
+  }
+  HHResult64 hashes64[100];
+  HHResult64 hashes32[100];
+  dispatch.values_u64(key, values64, 100, hashes64);
+  dispatch.values_u32(key, values32, 100, hashes32);
+  uint64_t selected64[2];
+  uint64_t selected32[2];
+  const size_t num64 =
+      dispatch.sample_values_u64(key, values64, 100, threshold, selected64);
+  const size_t num32 =
+      dispatch.sample_values_u32(key, values32, 100, threshold, selected32);
+  size_t expected64 = 0;
+  size_t expected32 = 0;
+  for (size_t i = 0; i < 100; ++i) {
+    expected64 += hashes64[i] < threshold;
+    expected32 += hashes32[i] < threshold;
+    if (((selected64[i / 64] >> (i % 64)) & 1) != (hashes64[i] < threshold) ||
+        ((selected32[i / 64] >> (i % 64)) & 1) != (hashes32[i] < threshold)) {
+      OnFailure<kSample>("Dispatch", i);
+    }
+  }
+  if (num64 != expected64 || num32 != expected32) {
+    OnFailure<kSample>("Dispatch", 100);
+  }
+
+  // Same strings as VerifyOffsetsDispatch; selects all but the null string.
+  const char data[] = "nullempty-abcdefghijklmnopqrstuvwxyz0123456789";
+  const int32_t offsets32[5] = {0, 4, 4, 10, 46};
+  const int64_t offsets64[5] = {0, 4, 4, 10, 46};
+  const uint8_t validity = 0xE;  // String 0 is null.
+  uint64_t selected = 0;
+  if (dispatch.sample_offsets32(key, data, offsets32, &validity, 4, ~0ull,
+                                &selected) != 3 ||
+      selected != 0xE) {
+    OnFailure<kSample>("Dispatch", 32);
+  }
+  selected = 0;
+  if (dispatch.sample_offsets64(key, data, offsets64, &validity, 4, ~0ull,
+                                &selected) != 3 ||
+      selected != 0xE) {
+    OnFailure<kSample>("Dispatch", 64);
+  }
+}
+
+// Bloom filter
+
+const char kBloomFilter[] = "BloomFilter";
+
+// Returns which targets were run/verified.
+TargetBits VerifyBloomFilter() {
+  // 250 keys, i.e. more than one batch and about 36 per block.
+  return RunAllOnRandomInput<BloomFilterTest>(500, &OnFailure<kBloomFilter>);
+}
+
+// Cuckoo filter
+
+const char kCuckooFilter[] = "CuckooFilter";
+
+// Returns which targets were run/verified.
+TargetBits VerifyCuckooFilter() {
+  // 250 keys: more than one batch, and more than 16 buckets can hold.
+  return RunAllOnRandomInput<CuckooFilterTest>(500, &OnFailure<kCuckooFilter>);
+}
+
+// Concurrent hash set
+
+const char kConcurrentHashSet[] = "ConcurrentHashSet";
+
+// Returns which targets were run/verified.
+TargetBits VerifyConcurrentHashSet() {
+  // 250 keys: more than one batch, and more than one group can hold.
+  return RunAllOnRandomInput<ConcurrentHashSetTest>(
+      500, &OnFailure<kConcurrentHashSet>);
+}
+
+// HyperLogLog
+
+const char kHyperLogLog[] = "HyperLogLog";
+
+// Returns which targets were run/verified.
+TargetBits VerifyHyperLogLog() {
+  return InstructionSets::RunAll<HyperLogLogTest>(kTestKey,
+                                                  &OnFailure<kHyperLogLog>);
+}
+
+// MinHash
+
+const char kMinHash[] = "MinHash";
+
+// Returns which targets were run/verified.
+TargetBits VerifyMinHash() {
+  return InstructionSets::RunAll<MinHashTest>(kTestKey, &OnFailure<kMinHash>);
+}
+
+// Consistent hashing
+
+const char kConsistentHash[] = "ConsistentHash";
+
+// Returns which targets were run/verified.
+TargetBits VerifyConsistentHash() {
+  return InstructionSets::RunAll<ConsistentHashTest>(
+      kTestKey, &OnFailure<kConsistentHash>);
+}
+
+// Keyed random numbers
+
+const char kKeyedRandom[] = "KeyedRandom";
+
+// Returns which targets were run/verified.
+TargetBits VerifyKeyedRandom() {
+  return InstructionSets::RunAll<KeyedRandomTest>(kTestKey,
+                                                  &OnFailure<kKeyedRandom>);
+}
+
+// Non-temporal
+
+const char kNonTemporal[] = "NonTemporal";
+
+// Returns which targets were run/verified.
+template <typename Result>
+TargetBits VerifyNonTemporal() {
+  // Several times the default prefetch distance, so that the prefetching loop
+  // runs for multiple iterations.
+  Result dummy;
+  return RunAllOnRandomInput<HighwayHashNonTemporalTest>(
+      4 * HH_PREFETCH_DISTANCE, &dummy, &OnFailure<kNonTemporal>);
+}
+
+// Dispatch table
+
+// Verifies the functions of the dispatch table (which InstructionSets::Run
+// must also have chosen) return the known-good hashes.
+template <typename Result>
+void VerifyDispatch(const HighwayHashFunctions::HashFunc<Result> hash,
+                    const HighwayHashFunctions::CatFunc<Result> cat,
+                    const HighwayHashFunctions::BatchFunc<Result> batch,
+                    const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  const char* target_name = TargetName(dispatch.target);
+  HighwayHashFunctions selected;
+  if (InstructionSets::Run<HighwayHashSelect>(&selected) != dispatch.target) {
+    OnFailure<kHighwayHash>(target_name, 0);
+  }
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    const StringView view = {in, size};
+    Result actual;
+    hash(key, in, size, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kHighwayHash>(target_name, size);
+    }
+    cat(key, &view, 1, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kCat>(target_name, size);
+    }
+    batch(key, &view, 1, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kBatch>(target_name, size);
+    }
+  }
+}
+
+// Verifies hash64_128 or hash128_256 of the dispatch table return both of
+// the known-good hashes.
+template <typename Result, typename WiderResult, class HashBoth>
+void VerifyBothDispatch(const HashBoth hash_both,
+                        const Result (&known_good)[kMaxSize + 1],
+                        const WiderResult (&known_good_wider)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+  const char* target_name = TargetName(HighwayHashDispatch().target);
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    Result actual;
+    WiderResult actual_wider;
+    hash_both(key, in, size, &actual, &actual_wider);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0 ||
+        memcmp(&actual_wider, &known_good_wider[size], sizeof(WiderResult)) !=
+            0) {
+      OnFailure<kHighwayHash>(target_name, size);
+    }
+  }
+}
+
+// Verifies multi_key* of the dispatch table return the same results as
+// "hash" under each key, also for more than four keys.
+template <typename Result>
+void VerifyMultiKeyDispatch(
+    const HighwayHashFunctions::MultiKeyFunc<Result> multi_key,
+    const HighwayHashFunctions::HashFunc<Result> hash) {
+  const size_t kMaxKeys = 9;
+  HHKey keys[kMaxKeys];
+  for (size_t i = 0; i < kMaxKeys; ++i) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      keys[i][lane] = 0x0706050403020100ULL * (lane + 1) + i;
+    }
+  }
+  const char* target_name = TargetName(HighwayHashDispatch().target);
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    for (size_t num_keys = 0; num_keys <= kMaxKeys; ++num_keys) {
+      Result actual[kMaxKeys];
+      multi_key(keys, num_keys, in, size, actual);
+      for (size_t i = 0; i < num_keys; ++i) {
+        Result expected;
+        hash(keys[i], in, size, &expected);
+        if (memcmp(&actual[i], &expected, sizeof(Result)) != 0) {
+          OnFailure<kHighwayHash>(target_name, size);
+        }
+      }
+    }
+  }
+}
+
+// Verifies HighwayHashAutotuned chose supported targets and returns the
+// known-good hashes for all sizes (and thus size classes).
+void VerifyAutotuned(const HHResult64 (&known_good64)[kMaxSize + 1],
+                     const HHResult128 (&known_good128)[kMaxSize + 1],
+                     const HHResult256 (&known_good256)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+  const HighwayHashAutotuned& autotuned = HighwayHashAutotuned::Get();
+  const HighwayHashTuning& tuning = autotuned.Tuning();
+  if (tuning.default_target != HighwayHashDispatch().target) {
+    OnFailure<kHighwayHash>("autotuned", 0);
+  }
+  for (size_t c = 0; c < HighwayHashTuning::kNumSizeClasses; ++c) {
+    if ((tuning.best[c] & InstructionSets::Supported()) == 0) {
+      OnFailure<kHighwayHash>(TargetName(tuning.best[c]), c);
+    }
+  }
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    const char* target_name = TargetName(autotuned.FunctionsFor(size).target);
+    if (autotuned.FunctionsFor(size).target !=
+        tuning.best[HighwayHashTuning::SizeClass(size)]) {
+      OnFailure<kHighwayHash>(target_name, size);
+    }
+    HHResult64 actual64;
+    HHResult128 actual128;
+    HHResult256 actual256;
+    autotuned.Hash(key, in, size, &actual64);
+    autotuned.Hash(key, in, size, &actual128);
+    autotuned.Hash(key, in, size, &actual256);
+    if (actual64 != known_good64[size] ||
+        memcmp(&actual128, &known_good128[size], sizeof(actual128)) != 0 ||
+        memcmp(&actual256, &known_good256[size], sizeof(actual256)) != 0) {
+      OnFailure<kHighwayHash>(target_name, size);
+    }
+  }
+  if (HighwayHashTuning::SizeClass(~size_t(0)) + 1 !=
+      HighwayHashTuning::kNumSizeClasses) {
+    OnFailure<kHighwayHash>("autotuned", ~size_t(0));
+  }
+}
+
+// Verifies the instrumented table returns the known-good hashes and counts
+// the calls and bytes of all threads in the expected size classes.
+void VerifyTelemetry(const HHResult64 (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+  const size_t kBoundaries[][2] = {{0, 0},     {16, 0},     {17, 1},
+                                   {32, 1},    {33, 2},     {1024, 6},
+                                   {65536, 12}, {65537, 13}, {~size_t(0), 13}};
+  for (const auto& boundary : kBoundaries) {
+    if (HighwayHashTelemetry::SizeClass(boundary[0]) != boundary[1]) {
+      OnFailure<kHighwayHash>("telemetry", boundary[0]);
+    }
+  }
+
+  const HighwayHashFunctions& instrumented = HighwayHashInstrumented();
+  const HighwayHashTelemetry before = HighwayHashTelemetrySnapshot();
+  const int kNumThreads = 3;
+  ThreadPool pool(kNumThreads);
+  pool.Run(0, kNumThreads, [&key, &known_good, &instrumented](int) {
+    char in[kMaxSize + 1] = {0};
+    for (uint64_t size = 0; size <= kMaxSize; ++size) {
+      in[size] = static_cast<char>(size);
+      const StringView view = {in, size};
+      HHResult64 actual;
+      instrumented.hash64(key, in, size, &actual);
+      if (actual != known_good[size]) {
+        OnFailure<kHighwayHash>("telemetry", size);
+      }
+      instrumented.cat64(key, &view, 1, &actual);
+      if (actual != known_good[size]) OnFailure<kCat>("telemetry", size);
+    }
+  });
+  const HighwayHashTelemetry after = HighwayHashTelemetrySnapshot();
+
+#if HH_TELEMETRY_ENABLED
+  uint64_t expected_bytes = 0;
+  uint64_t expected_by_size[HighwayHashTelemetry::kNumSizeClasses] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    expected_bytes += 2 * kNumThreads * size;
+    expected_by_size[HighwayHashTelemetry::SizeClass(size)] += 2 * kNumThreads;
+  }
+  if (after.calls - before.calls != 2 * kNumThreads * (kMaxSize + 1) ||
+      after.bytes - before.bytes != expected_bytes) {
+    OnFailure<kHighwayHash>("telemetry", after.calls - before.calls);
+  }
+  for (size_t c = 0; c < HighwayHashTelemetry::kNumSizeClasses; ++c) {
+    if (after.calls_by_size[c] - before.calls_by_size[c] !=
+        expected_by_size[c]) {
+      OnFailure<kHighwayHash>("telemetry", c);
+    }
+  }
+  uint64_t by_target = 0;
+  for (size_t t = 0; t < HighwayHashTelemetry::kNumTargets; ++t) {
+    by_target += after.calls_by_target[t];
+  }
+  if (by_target != after.calls) OnFailure<kHighwayHash>("telemetry", by_target);
 #endif
-  exit(1);
 }
 
-// Returns which targets were run/verified.
-template <typename Result>
-TargetBits VerifyCat(ThreadPool* pool) {
-  // Reversed order vs prior test.
-  const HHKey key = {0x1F1E1D1C1B1A1918ULL, 0x1716151413121110ULL,
-                     0x0F0E0D0C0B0A0908ULL, 0x0706050403020100ULL};
+// Verifies the compact_* members of the dispatch table return the
+// known-good hashes, also if each byte is appended separately (after an empty
+// null fragment).
+template <typename Result>
+void VerifyCompactDispatch(
+    void (*compact_finish)(const HHCompactCat&, Result* HH_RESTRICT),
+    const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  const char* target_name = TargetName(dispatch.target);
+  static_assert(sizeof(HHCompactCat) == 160, "HHCompactCat is not packed");
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    Result actual;
+    HHCompactCat compact;
+    dispatch.compact_start(key, &compact);
+    dispatch.compact_append(&compact, in, size);
+    compact_finish(compact, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kCat>(target_name, size);
+    }
+
+    dispatch.compact_start(key, &compact);
+    dispatch.compact_append(&compact, nullptr, 0);
+    for (uint64_t i = 0; i < size; ++i) {
+      dispatch.compact_append(&compact, in + i, 1);
+    }
+    compact_finish(compact, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kCat>(target_name, size);
+    }
+  }
+}
+
+// Verifies the short* members of the dispatch table return the known-good
+// hashes even if the bytes after the input are nonzero.
+template <typename Result>
+void VerifyShortDispatch(const HighwayHashFunctions::HashFunc<Result> hash,
+                         const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+
+  char in[32];
+  for (uint64_t size = 0; size <= 32; ++size) {
+    for (uint64_t i = 0; i < 32; ++i) {
+      in[i] = static_cast<char>(i < size ? i : 0xFF);
+    }
+    Result actual;
+    hash(key, in, size, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kShort>("dispatch", size);
+    }
+  }
+}
+
+// Verifies the padded* members of the dispatch table return the known-good
+// hashes even if the 32 bytes after the input are nonzero.
+template <typename Result>
+void VerifyPaddedDispatch(const HighwayHashFunctions::HashFunc<Result> hash,
+                          const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+
+  char in[kMaxSize + 32];
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    for (uint64_t i = 0; i < sizeof(in); ++i) {
+      in[i] = static_cast<char>(i < size ? i : 0xFF);
+    }
+    Result actual;
+    hash(key, in, size, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kPadded>("dispatch", size);
+    }
+  }
+}
+
+// Verifies hashing with a key prepared via the dispatch table returns the
+// known-good hashes.
+template <typename Result>
+void VerifyPrepared(const HighwayHashFunctions::PreparedFunc<Result> prepared,
+                    const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
+
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  HighwayHashPreparedKey prepared_key;
+  dispatch.prepare(key, &prepared_key);
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    Result actual;
+    prepared(&prepared_key, in, size, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kHighwayHash>("prepared", size);
+    }
+  }
+}
+
+#if HH_HAS_IOVEC
 
-  const size_t kMaxSize = 3 * 35;
-  char flat[kMaxSize];
-  srand(129);
-  for (size_t size = 0; size < kMaxSize; ++size) {
-    flat[size] = static_cast<char>(rand() & 0xFF);
-  }
+// Verifies hashing iovec via the dispatch table and InstructionSets::Run
+// returns the known-good hashes.
+template <typename Result>
+void VerifyIovec(const HighwayHashFunctions::CatIovecFunc<Result> cat_iovec,
+                 const Result (&known_good)[kMaxSize + 1]) {
+  const HHKey& key = kKnownGoodKey;
 
-  std::atomic<TargetBits> targets{~0U};
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    // Three fragments, the first of which may be packet-aligned.
+    const size_t size1 = size / 2;
+    const size_t size2 = size / 4;
+    iovec fragments[3];
+    fragments[0].iov_base = in;
+    fragments[0].iov_len = size1;
+    fragments[1].iov_base = in + size1;
+    fragments[1].iov_len = size2;
+    fragments[2].iov_base = in + size1 + size2;
+    fragments[2].iov_len = size - size1 - size2;
 
-  pool->Run(0, kMaxSize, [&key, &flat, &targets](const uint32_t i) {
-    Result dummy;
-    targets.fetch_and(InstructionSets::RunAll<HighwayHashCatTest>(
-        key, flat, i, &dummy, &OnCatFailure));
-  });
-  return targets.load();
+    Result actual;
+    cat_iovec(key, fragments, 3, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kCat>("iovec", size);
+    }
+    InstructionSets::Run<HighwayHashCat>(key, fragments, 3, &actual);
+    if (memcmp(&actual, &known_good[size], sizeof(Result)) != 0) {
+      OnFailure<kCat>("iovec", size);
+    }
+  }
 }
 
+#endif  // HH_HAS_IOVEC
+
 // WARNING: HighwayHash is frozen, so the golden values must not change.
 const HHResult64 kExpected64[kMaxSize + 1] = {
     0x907A56DE22C26E53ull, 0x7EAB43AAC7CDDD78ull, 0xB8D0569AB0B53D62ull,
@@ -354,6 +1225,741 @@ const HHResult256 kExpected256[kMaxSize + 1] = {
     {0x90D8E6FF6AC12475ull, 0x1A422A196EDAC1F2ull, 0x9E3765FE1F8EB002ull,
      0xC1BDD7C4C351CFBEull}};
 
+// Verifies the dispatched C functions return the known-good hashes.
+void VerifyCBindings() {
+  const HHKey& key = kKnownGoodKey;
+  HighwayHashCatC* cat = HighwayHashCatStartC(key);
+  HighwayHashPreparedKeyC* prepared = HighwayHashPrepareKeyC(key);
+  if (cat == nullptr || prepared == nullptr) {
+    OnFailure<kHighwayHash>("C", 0);
+  }
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    HHResult64 hash64;
+    HHResult128 hash128;
+    HHResult256 hash256;
+
+    if (HighwayHash64(key, in, size) != kExpected64[size]) {
+      OnFailure<kHighwayHash>("C", size);
+    }
+    HighwayHash128(key, in, size, hash128);
+    HighwayHash256(key, in, size, hash256);
+    if (memcmp(hash128, kExpected128[size], sizeof(hash128)) != 0 ||
+        memcmp(hash256, kExpected256[size], sizeof(hash256)) != 0) {
+      OnFailure<kHighwayHash>("C", size);
+    }
+
+    const StringView view = {in, size};
+    HighwayHashBatch64(key, &view, 1, &hash64);
+    HighwayHashBatch128(key, &view, 1, &hash128);
+    HighwayHashBatch256(key, &view, 1, &hash256);
+    if (hash64 != kExpected64[size] ||
+        memcmp(hash128, kExpected128[size], sizeof(hash128)) != 0 ||
+        memcmp(hash256, kExpected256[size], sizeof(hash256)) != 0) {
+      OnFailure<kBatch>("C", size);
+    }
+
+    // Two fragments, so that the second Append starts with a partial buffer.
+    HighwayHashCatResetC(cat, key);
+    HighwayHashCatAppendC(cat, in, size / 2);
+    HighwayHashCatAppendC(cat, in + size / 2, size - size / 2);
+    HighwayHashCatFinish128C(cat, hash128);
+    HighwayHashCatFinish256C(cat, hash256);
+    if (HighwayHashCatFinish64C(cat) != kExpected64[size] ||
+        memcmp(hash128, kExpected128[size], sizeof(hash128)) != 0 ||
+        memcmp(hash256, kExpected256[size], sizeof(hash256)) != 0) {
+      OnFailure<kCat>("C", size);
+    }
+
+    // Resume from a snapshot taken after the first fragment.
+    HighwayHashCatResetC(cat, key);
+    HighwayHashCatAppendC(cat, in, size / 2);
+    HHCatSnapshot snapshot;
+    HighwayHashCatSerializeC(cat, &snapshot);
+    HighwayHashCatC* resumed = HighwayHashCatDeserializeC(&snapshot);
+    HighwayHashCatAppendC(resumed, in + size / 2, size - size / 2);
+    if (HighwayHashCatFinish64C(resumed) != kExpected64[size]) {
+      OnFailure<kCat>("C snapshot", size);
+    }
+    HighwayHashCatFreeC(resumed);
+    snapshot.bytes[0] = 0;
+    if (HighwayHashCatDeserializeC(&snapshot) != nullptr) {
+      OnFailure<kCat>("C snapshot", size);
+    }
+
+    HighwayHashPrepared128C(prepared, in, size, hash128);
+    HighwayHashPrepared256C(prepared, in, size, hash256);
+    if (HighwayHashPrepared64C(prepared, in, size) != kExpected64[size] ||
+        memcmp(hash128, kExpected128[size], sizeof(hash128)) != 0 ||
+        memcmp(hash256, kExpected256[size], sizeof(hash256)) != 0) {
+      OnFailure<kHighwayHash>("C prepared", size);
+    }
+  }
+  HighwayHashPreparedKeyFreeC(prepared);
+  HighwayHashCatFreeC(cat);
+}
+
+// Hasher
+
+// Verifies the hasher.h functors return the known-good hashes for all key
+// types that are hashed as the same bytes.
+void VerifyHasher() {
+  const HHKey& key = kKnownGoodKey;
+  const HighwayHasher hasher(key);
+  const HighwayHasherT<HH_TARGET> hasher_target(key);
+
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    const size_t expected = static_cast<size_t>(kExpected64[size]);
+    const std::string string(in, size);
+    const StringView view = {in, size};
+    if (hasher(string) != expected || hasher(view) != expected) {
+      OnFailure<kHighwayHash>("HighwayHasher", size);
+    }
+    if (hasher_target(string) != expected) {
+      OnFailure<kHighwayHash>("HighwayHasherT", size);
+    }
+  }
+
+  // Integers and structs hash as their (little-endian) bytes.
+  const char le_bytes[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  const StringView le4 = {le_bytes, 4};
+  const StringView le8 = {le_bytes, 8};
+  struct Pair {
+    uint32_t first;
+    uint32_t second;
+  };
+  const Pair pair = {0x04030201u, 0x08070605u};
+  if (hasher(uint32_t{0x04030201u}) != hasher(le4) ||
+      hasher(int32_t{0x04030201}) != hasher(le4) ||
+      hasher(uint64_t{0x0807060504030201ull}) != hasher(le8) ||
+      hasher_target(uint64_t{0x0807060504030201ull}) != hasher(le8) ||
+      (HH_IS_LITTLE_ENDIAN && hasher(pair) != hasher(le8))) {
+    OnFailure<kHighwayHash>("HighwayHasher", 8);
+  }
+  printf("%10s: OK\n", "Hasher");
+}
+
+// Fields
+
+// User type with a HashValue overload (found via ADL).
+struct FieldsPoint {
+  int32_t x;
+  int32_t y;
+};
+
+template <class Cat>
+void HashValue(Cat* cat, const FieldsPoint& point) {
+  HashFields(cat, point.x, point.y);
+}
+
+template <typename Result>
+bool SameHash(const HighwayHashCatT<HH_TARGET>& cat1,
+              const HighwayHashCatT<HH_TARGET>& cat2) {
+  Result hash1;
+  Result hash2;
+  cat1.Finalize(&hash1);
+  cat2.Finalize(&hash2);
+  return memcmp(&hash1, &hash2, sizeof(Result)) == 0;
+}
+
+// Verifies AppendLE, AppendU* and HashFields append the same bytes as the
+// equivalent Append, including across packet boundaries.
+void VerifyFields() {
+  const HHKey& key = kKnownGoodKey;
+  const char le[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  const uint64_t value = 0x0807060504030201ull;
+  char prefix[2 * sizeof(HHPacket)] = {0};
+  for (size_t size = 0; size < sizeof(prefix); ++size) {
+    prefix[size] = static_cast<char>(size);
+    HighwayHashCatT<HH_TARGET> expected(key);
+    HighwayHashCatT<HH_TARGET> actual(key);
+    expected.Append(prefix, size);
+    actual.Append(prefix, size);
+    expected.Append(le, 1);
+    actual.AppendLE<1>(value);
+    expected.Append(le, 2);
+    actual.AppendLE<2>(value);
+    expected.Append(le, 4);
+    actual.AppendLE<4>(value);
+    expected.Append(le, 8);
+    actual.AppendLE<8>(value);
+    expected.Append(le, 4);
+    actual.AppendU32(static_cast<uint32_t>(value));
+    expected.Append(le, 8);
+    actual.AppendU64(value);
+    expected.Append(le, 8);
+    expected.Append(le, 8);
+    actual.AppendU128(value, value);
+    if (!SameHash<HHResult64>(expected, actual) ||
+        !SameHash<HHResult256>(expected, actual)) {
+      OnFailure<kHighwayHash>("AppendLE", size);
+    }
+  }
+
+  // Fields are little-endian; strings and ranges are prefixed with lengths.
+  const char bytes[] = {1, 2, 3, 4,                     // uint32_t
+                        2, 0, 0, 0, 0, 0, 0, 0, 'A', 'B',  // std::string
+                        0, 0, 0, 0, 0, 0, 0, 0,        // -0.0
+                        2, 0, 0, 0, 0, 0, 0, 0,        // vector size
+                        -1, -1, -1, -1, 5, 0, 0, 0,    // FieldsPoint
+                        6, 0, 0, 0, 7, 0, 0, 0,        // FieldsPoint
+                        1};                            // bool
+  HighwayHashCatT<HH_TARGET> expected(key);
+  expected.Append(bytes, sizeof(bytes));
+  const std::vector<FieldsPoint> points = {{-1, 5}, {6, 7}};
+  HighwayHashCatT<HH_TARGET> actual(key);
+  HashFields(&actual, uint32_t{0x04030201u}, std::string("AB"), -0.0, points,
+             true);
+  HHResult64 hash;
+  HighwayHashFieldsT<HH_TARGET>(key, &hash, uint32_t{0x04030201u},
+                                std::string("AB"), -0.0, points, true);
+  HHResult64 actual_hash;
+  actual.Finalize(&actual_hash);
+  if (!SameHash<HHResult64>(expected, actual) || hash != actual_hash) {
+    OnFailure<kHighwayHash>("HashFields", sizeof(bytes));
+  }
+
+  // Length framing distinguishes fields that concatenate to the same bytes.
+  HighwayHashCatT<HH_TARGET> a_empty(key);
+  HighwayHashCatT<HH_TARGET> empty_a(key);
+  HashFields(&a_empty, "A", "");
+  HashFields(&empty_a, "", "A");
+  if (SameHash<HHResult64>(a_empty, empty_a)) {
+    OnFailure<kHighwayHash>("HashFields framing", 1);
+  }
+  printf("%10s: OK\n", "Fields");
+}
+
+// Constexpr
+
+#if HH_HAVE_CONSTEXPR_HASH
+
+constexpr HHKey kConstexprKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                                 0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+// Evaluated by the compiler, see kConstexprExpected64.
+struct ConstexprTable {
+  HHResult64 hashes[kMaxSize + 1];
+};
+
+constexpr ConstexprTable MakeConstexprTable() {
+  ConstexprTable table = {};
+  char in[kMaxSize + 1] = {};
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    table.hashes[size] = HighwayHash64Constexpr(kConstexprKey, in, size);
+  }
+  return table;
+}
+
+constexpr ConstexprTable kConstexprExpected64 = MakeConstexprTable();
+constexpr char kConstexprName0[] = "help";
+constexpr char kConstexprName1[] = "requests.latency.p99.by_region.eu-west";
+
+static_assert(HighwayHash64Constexpr(kConstexprKey, "") ==
+                  0x907A56DE22C26E53ull,
+              "Must match kExpected64[0]");
+
+const char kConstexpr[] = "Constexpr";
+
+// Verifies the compile-time hashes (and the same functions evaluated at
+// runtime) match the known-good hashes and all runtime targets.
+void VerifyConstexpr() {
+  char in[kMaxSize + 1] = {0};
+  for (uint64_t size = 0; size <= kMaxSize; ++size) {
+    in[size] = static_cast<char>(size);
+    const HHConstexprResult128 hash128 =
+        HighwayHash128Constexpr(kConstexprKey, in, size);
+    const HHConstexprResult256 hash256 =
+        HighwayHash256Constexpr(kConstexprKey, in, size);
+    if (kConstexprExpected64.hashes[size] != kExpected64[size] ||
+        memcmp(hash128.hash, kExpected128[size], sizeof(hash128)) != 0 ||
+        memcmp(hash256.hash, kExpected256[size], sizeof(hash256)) != 0) {
+      OnFailure<kHighwayHash>("Constexpr", size);
+    }
+  }
+
+  // Typical use case: names, including ones longer than a packet.
+  constexpr HHResult64 expected[2] = {
+      HighwayHash64Constexpr(kConstexprKey, kConstexprName0),
+      HighwayHash64Constexpr(kConstexprKey, kConstexprName1)};
+  InstructionSets::RunAll<HighwayHashTest>(
+      kConstexprKey, kConstexprName0, sizeof(kConstexprName0) - 1,
+      &expected[0], &OnFailure<kConstexpr>);
+  InstructionSets::RunAll<HighwayHashTest>(
+      kConstexprKey, kConstexprName1, sizeof(kConstexprName1) - 1,
+      &expected[1], &OnFailure<kConstexpr>);
+  printf("%10s: OK\n", "Constexpr");
+}
+
+#endif  // HH_HAVE_CONSTEXPR_HASH
+
+// Wide
+
+const char kWide[] = "Wide";
+
+// Sizes around multiples of the packet and lane group sizes.
+const size_t kWideSizes[] = {0, 1, 31, 32, 127, 128, 129, 255, 256, 1000, 4099};
+const size_t kNumWideSizes = sizeof(kWideSizes) / sizeof(kWideSizes[0]);
+
+// Verifies all implementations of HighwayHashWide for kWideSizes. Returns which
+// targets were run/verified.
+template <typename Result>
+TargetBits VerifyWide(const Result (&known_good)[kNumWideSizes]) {
+  const HHKey& key = kKnownGoodKey;
+
+  // Same pattern as VerifyImplementations: 00 01 02 ..
+  std::vector<char> in(kWideSizes[kNumWideSizes - 1]);
+  for (size_t i = 0; i < in.size(); ++i) {
+    in[i] = static_cast<char>(i);
+  }
+
+  TargetBits targets = ~0U;
+  for (size_t i = 0; i < kNumWideSizes; ++i) {
+#if PRINT_RESULTS
+    Result actual;
+    targets &= InstructionSets::Run<HighwayHashWide>(key, in.data(),
+                                                     kWideSizes[i], &actual);
+    Print(actual);
+#else
+    targets &= InstructionSets::RunAll<HighwayHashWideTest>(
+        key, in.data(), kWideSizes[i], &known_good[i], &OnFailure<kWide>);
+#endif
+  }
+  return targets;
+}
+
+// Verifies the dispatch table's "wide" function returns the known-good hashes.
+template <typename Result>
+void VerifyWideDispatch(const HighwayHashFunctions::HashFunc<Result> wide,
+                        const Result (&known_good)[kNumWideSizes]) {
+  const HHKey& key = kKnownGoodKey;
+  std::vector<char> in(kWideSizes[kNumWideSizes - 1]);
+  for (size_t i = 0; i < in.size(); ++i) {
+    in[i] = static_cast<char>(i);
+  }
+
+  for (size_t i = 0; i < kNumWideSizes; ++i) {
+    Result actual;
+    wide(key, in.data(), kWideSizes[i], &actual);
+    if (memcmp(&actual, &known_good[i], sizeof(Result)) != 0) {
+      OnFailure<kWide>(TargetName(HighwayHashDispatch().target), kWideSizes[i]);
+    }
+  }
+}
+
+// WARNING: HighwayHashWide is frozen, so the golden values must not change.
+const HHResult64 kExpectedWide64[kNumWideSizes] = {
+    0x8EEB35DB2E3D51B4ull, 0x45DACB00AFFA0AF9ull, 0x79025375FD78F264ull,
+    0xAEAF19566B142D2Eull, 0x8039ACAAADDACB54ull, 0xF33000DB9FCC5929ull,
+    0x651C3E2759A675D6ull, 0x26AAEBDABD92E76Full, 0x85593986003D07C7ull,
+    0x2F9E04A7D1110BD6ull, 0xB3C183E9CD18638Full};
+
+// WARNING: HighwayHashWide is frozen, so the golden values must not change.
+const HHResult128 kExpectedWide128[kNumWideSizes] = {
+    {0x1807E79973A53D6Cull, 0x0EEBB08CE2AE825Bull},
+    {0xB51E5C0DD204B3E3ull, 0x287DCC04BCB1B14Aull},
+    {0xFCE81069CC0C484Bull, 0x29A40243D234191Full},
+    {0xCA886580E1033508ull, 0x663F588DE57F4306ull},
+    {0x79F69C799322A325ull, 0x49A96A946F5F9DE4ull},
+    {0xD35B58D4C6744F49ull, 0x7B07B3C9546B617Aull},
+    {0xD54BA0438A7134B6ull, 0x725B7E9F87443519ull},
+    {0x7B2714D1EDF305F5ull, 0x7A21818464DA019Full},
+    {0xEE16A6AE3192B1E2ull, 0xC7794C6EB85770BAull},
+    {0x70238B24F4DAC7D6ull, 0xF0A196348B0062AEull},
+    {0x769AE65667558567ull, 0xBA43E7F3F49E0B9Aull}};
+
+// WARNING: HighwayHashWide is frozen, so the golden values must not change.
+const HHResult256 kExpectedWide256[kNumWideSizes] = {
+    {0x6926727F0B334823ull, 0x17AD2FEB19F88C62ull, 0xBDB579E0ECA5D02Bull,
+     0xBCDB55C0A3938482ull},
+    {0x2CF44E33F6D49D3Eull, 0x0652BEA34426E0E0ull, 0x420297C11E6AB6C3ull,
+     0x506FE7E8785DF2E7ull},
+    {0x0574E79CB6FE9665ull, 0xEB10530EA50196EBull, 0xF0D808005398A9E0ull,
+     0x207CB16773CE0F32ull},
+    {0x69C19244917DA809ull, 0x9187E57AAC9B3854ull, 0xBDB04B3D1BF7D9CBull,
+     0xC51D9620EE44F847ull},
+    {0x1BFDD8E3F5A85084ull, 0x45EDEA4F5BAB187Aull, 0xF6712374BF006A4Cull,
+     0x270178F2CDFA52E2ull},
+    {0x2F6D6D6FA717FEC9ull, 0xE31D2C296621DE15ull, 0x0309BF5F24565688ull,
+     0x11426EB86D6A1E1Dull},
+    {0x01F181545E8B668Cull, 0x9E8E829F9FC9C1FFull, 0xAC6C41EAA49F8F4Full,
+     0xAD6924FCB31F67A3ull},
+    {0x78E9C18E6FF3B571ull, 0x1114301330BB9EF1ull, 0xF555719BDA70370Eull,
+     0x48193EBAD0C01C9Eull},
+    {0xD5AF379B8EEABC74ull, 0x6B2D3003F0A8ACE5ull, 0xEE6AF31AD1BBA023ull,
+     0x90A93E4F8D2AA5D3ull},
+    {0x8E66A597704088C0ull, 0x5BE6330F067F3C99ull, 0xFB1E68ABB418B136ull,
+     0x613A502385553A3Cull},
+    {0xE1F831C200C83631ull, 0x3C13523F491FA34Cull, 0x8CBD804EA167DA93ull,
+     0xF8178643F79A2222ull}};
+
+// Tree hash
+
+// Sizes around leaf boundaries, with the expected HighwayTreeHash (64 bit)
+// of the bytes i * 7 for i in [0, size).
+// WARNING: version 1 is frozen, so the golden values must not change.
+struct TreeHashExpected {
+  size_t size;
+  HHResult64 hash;
+};
+const TreeHashExpected kExpectedTree64[] = {
+    {0, 0xA01A5B4AFC4FC13Dull},
+    {1, 0xB869DDCDDA72ADA6ull},
+    {kHighwayTreeHashLeafSize - 1, 0xDA1F99974452C400ull},
+    {kHighwayTreeHashLeafSize, 0x83B7F2EAD63949F6ull},
+    {kHighwayTreeHashLeafSize + 1, 0xD18D972C9F512DAAull},
+    {17 * kHighwayTreeHashLeafSize + 33, 0x42433DA297B93718ull}};
+
+// Verifies HighwayTreeHash returns the same (known-good) results for any
+// number of threads.
+void VerifyTreeHash(ThreadPool* pool) {
+  const HHKey& key = kKnownGoodKey;
+  const size_t max_size = 17 * kHighwayTreeHashLeafSize + 33;
+  std::vector<char> in(max_size);
+  for (size_t i = 0; i < max_size; ++i) {
+    in[i] = static_cast<char>(i * 7);
+  }
+
+  ThreadPool pool1(1);
+  for (const TreeHashExpected& expected : kExpectedTree64) {
+    HHResult64 serial, single, parallel;
+    HighwayTreeHash(key, in.data(), expected.size, nullptr, &serial);
+    HighwayTreeHash(key, in.data(), expected.size, &pool1, &single);
+    HighwayTreeHash(key, in.data(), expected.size, pool, &parallel);
+#if PRINT_RESULTS
+    Print(serial);
+#endif
+    if (serial != expected.hash || single != serial || parallel != serial) {
+      OnFailure<kHighwayHash>("Tree", expected.size);
+    }
+
+    HHResult256 serial256, parallel256;
+    HighwayTreeHash(key, in.data(), expected.size, nullptr, &serial256);
+    HighwayTreeHash(key, in.data(), expected.size, pool, &parallel256);
+    if (memcmp(serial256, parallel256, sizeof(HHResult256)) != 0) {
+      OnFailure<kHighwayHash>("Tree", expected.size);
+    }
+  }
+}
+
+// Merkle tree
+
+// Verifies the root of HighwayMerkleTree after random writes equals that of
+// a new tree over the modified buffer, regardless of "pool", and that the
+// leaf size and every write affect the root.
+void VerifyMerkle(ThreadPool* pool) {
+  const HHKey& key = kKnownGoodKey;
+  std::vector<char> in((1 << 20) + 33);
+  for (size_t i = 0; i < in.size(); ++i) {
+    in[i] = static_cast<char>(i * 7);
+  }
+
+  // Small leaves (hence 2^14 dirty leaves initially) also reach the threshold
+  // for hashing parents in parallel.
+  for (const size_t leaf_size : {size_t(64), kHighwayMerkleLeafSize}) {
+    std::vector<char> bytes(in);
+    HighwayMerkleTree serial(key, bytes.data(), bytes.size(), leaf_size);
+    HighwayMerkleTree parallel(key, bytes.data(), bytes.size(), leaf_size,
+                               pool);
+    HHResult128 root, parallel_root, expected;
+    serial.Root(&root);
+    parallel.Root(&parallel_root);
+    HighwayMerkleRoot(key, bytes.data(), bytes.size(), leaf_size, nullptr,
+                      &expected);
+    if (memcmp(root, expected, sizeof(root)) != 0 ||
+        memcmp(parallel_root, expected, sizeof(root)) != 0 ||
+        serial.NumDirty() != 0) {
+      OnFailure<kHighwayHash>("Merkle", leaf_size);
+    }
+
+    uint64_t seed = leaf_size;
+    for (int round = 0; round < 8; ++round) {
+      // More writes in later rounds, including ones spanning leaves and the
+      // end of the buffer.
+      for (int write = 0; write < (1 << round); ++write) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        const size_t offset = seed % bytes.size();
+        const size_t num_bytes = 1 + (seed >> 40) % (3 * leaf_size);
+        for (size_t i = 0; i < num_bytes && offset + i < bytes.size(); ++i) {
+          ++bytes[offset + i];
+        }
+        serial.MarkDirty(offset, num_bytes);
+        parallel.MarkDirty(offset, num_bytes);
+      }
+      const HHResult128 previous = {root[0], root[1]};
+      serial.Root(&root);
+      parallel.Root(&parallel_root);
+      HighwayMerkleRoot(key, bytes.data(), bytes.size(), leaf_size, pool,
+                        &expected);
+      if (memcmp(root, expected, sizeof(root)) != 0 ||
+          memcmp(parallel_root, expected, sizeof(root)) != 0 ||
+          memcmp(root, previous, sizeof(root)) == 0) {
+        OnFailure<kHighwayHash>("Merkle", round);
+      }
+    }
+  }
+
+  HHResult128 root64, root4096, root_empty;
+  HighwayMerkleRoot(key, in.data(), in.size(), 64, nullptr, &root64);
+  HighwayMerkleRoot(key, in.data(), in.size(), 4096, nullptr, &root4096);
+  HighwayMerkleRoot(key, in.data(), 0, 4096, nullptr, &root_empty);
+  if (memcmp(root64, root4096, sizeof(root64)) == 0 ||
+      memcmp(root_empty, root4096, sizeof(root64)) == 0) {
+    OnFailure<kHighwayHash>("Merkle", 0);
+  }
+}
+
+// Chunker
+
+// Sizes of the first chunks of FillRandom(1) with the default ChunkSizes. Must
+// not change without incrementing kHighwayHashChunkerVersion.
+const uint64_t kExpectedChunkSizes[] = {8407, 8375,  11694, 9586, 9565,
+                                        11022, 8448, 12232, 9141, 11808};
+
+// Verifies the chunks of HighwayHashChunker cover the input, respect the size
+// limits, are fingerprinted with HighwayHash128, do not depend on how the
+// input is split into Append calls and mostly survive an insertion.
+void VerifyChunker() {
+  const HHKey& key = kKnownGoodKey;
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  const ChunkSizes sizes;
+  std::vector<char> in(1 << 20);
+  FillRandom(1, &in);
+
+  const std::vector<HHChunk> chunks =
+      HighwayHashChunks(key, in.data(), in.size());
+  uint64_t offset = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    const HHChunk& chunk = chunks[i];
+    const bool is_last = i == chunks.size() - 1;
+    HHResult128 expected;
+    dispatch.hash128(key, in.data() + offset, chunk.size, &expected);
+    if (chunk.offset != offset || chunk.size > sizes.max_size ||
+        (!is_last && chunk.size < sizes.min_size) ||
+        memcmp(chunk.hash, expected, sizeof(expected)) != 0) {
+      OnFailure<kHighwayHash>("Chunker", offset);
+    }
+    offset += chunk.size;
+  }
+  if (offset != in.size() ||
+      chunks.size() < in.size() / sizes.avg_size / 2 ||
+      chunks.size() > in.size() / sizes.avg_size * 2) {
+    OnFailure<kHighwayHash>("Chunker", offset);
+  }
+  for (size_t i = 0; i < sizeof(kExpectedChunkSizes) / sizeof(uint64_t); ++i) {
+    if (chunks[i].size != kExpectedChunkSizes[i]) {
+      OnFailure<kHighwayHash>("Chunker", i);
+    }
+  }
+
+  // Appending in pieces of varying sizes (including zero) has the same result.
+  HighwayHashChunker chunker(key);
+  std::vector<HHChunk> pieces;
+  size_t pos = 0;
+  for (size_t piece = 0; pos < in.size(); piece = (piece * 3 + 1) % 70001) {
+    const size_t size = std::min(piece, in.size() - pos);
+    chunker.Append(in.data() + pos, size, &pieces);
+    pos += size;
+  }
+  chunker.Finish(&pieces);
+  if (pieces.size() != chunks.size()) {
+    OnFailure<kHighwayHash>("Chunker", pieces.size());
+  }
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    if (pieces[i].offset != chunks[i].offset ||
+        pieces[i].size != chunks[i].size ||
+        memcmp(pieces[i].hash, chunks[i].hash, sizeof(HHResult128)) != 0) {
+      OnFailure<kHighwayHash>("Chunker", i);
+    }
+  }
+
+  // Inserting bytes only changes the chunks near the insertion.
+  std::vector<char> inserted(in.begin(), in.begin() + 100000);
+  inserted.insert(inserted.end(), 100, 'x');
+  inserted.insert(inserted.end(), in.begin() + 100000, in.end());
+  const std::vector<HHChunk> shifted =
+      HighwayHashChunks(key, inserted.data(), inserted.size());
+  size_t num_unchanged = 0;
+  for (const HHChunk& chunk : chunks) {
+    for (const HHChunk& other : shifted) {
+      if (memcmp(chunk.hash, other.hash, sizeof(HHResult128)) == 0) {
+        ++num_unchanged;
+        break;
+      }
+    }
+  }
+  if (num_unchanged + 3 < chunks.size()) {
+    OnFailure<kHighwayHash>("Chunker", num_unchanged);
+  }
+}
+
+// Files
+
+#if HH_TEST_FILES
+
+// Verifies HighwayHashFile and HighwayTreeHashFile return the same results as
+// hashing the contents from memory, including across window boundaries.
+void VerifyFileHash(ThreadPool* pool) {
+  const HHKey& key = kKnownGoodKey;
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+
+  char path[] = "/tmp/highwayhash_test_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    OnFailure<kHighwayHash>("File", 0);
+  }
+  close(fd);
+
+  const size_t sizes[] = {0, 33, kFileHashWindowSize + 33};
+  for (const size_t size : sizes) {
+    std::vector<char> contents(size);
+    for (size_t i = 0; i < size; ++i) {
+      contents[i] = static_cast<char>(i * 3);
+    }
+    FILE* file = fopen(path, "wb");
+    // (contents.data() may be null if size == 0, which fwrite must not get.)
+    if (file == nullptr ||
+        (size != 0 && fwrite(contents.data(), 1, size, file) != size) ||
+        fclose(file) != 0) {
+      OnFailure<kHighwayHash>("File", size);
+    }
+
+    HHResult64 expected, actual;
+    dispatch.hash64(key, contents.data(), size, &expected);
+    if (!HighwayHashFile(key, path, &actual) || actual != expected) {
+      OnFailure<kHighwayHash>("File", size);
+    }
+
+    HHResult256 expected256, actual256;
+    HighwayTreeHash(key, contents.data(), size, nullptr, &expected256);
+    if (!HighwayTreeHashFile(key, path, pool, &actual256) ||
+        memcmp(actual256, expected256, sizeof(HHResult256)) != 0) {
+      OnFailure<kHighwayHash>("File", size);
+    }
+  }
+
+  // Stream from the file (the last one written) and from a pipe, whose writer
+  // runs concurrently. Both span several buffers.
+  const size_t size = sizes[2];
+  std::vector<char> contents(size);
+  for (size_t i = 0; i < size; ++i) {
+    contents[i] = static_cast<char>(i * 3);
+  }
+  HHResult128 expected128, actual128;
+  dispatch.hash128(key, contents.data(), size, &expected128);
+
+  const int file_fd = open(path, O_RDONLY);
+  StreamHashStats stats;
+  if (file_fd < 0 || !HighwayHashStream(key, file_fd, &actual128, &stats) ||
+      memcmp(actual128, expected128, sizeof(HHResult128)) != 0 ||
+      stats.bytes != size) {
+    OnFailure<kHighwayHash>("Stream", size);
+  }
+  close(file_fd);
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    OnFailure<kHighwayHash>("Stream", 0);
+  }
+  std::thread writer([&contents, &pipe_fds]() {
+    size_t pos = 0;
+    while (pos < contents.size()) {
+      // Odd sizes so that reads end in the middle of a packet.
+      const size_t chunk = std::min<size_t>(contents.size() - pos, 70001);
+      const ssize_t written = write(pipe_fds[1], contents.data() + pos, chunk);
+      if (written <= 0) {
+        break;
+      }
+      pos += written;
+    }
+    close(pipe_fds[1]);
+  });
+  const bool ok = HighwayHashStream(key, pipe_fds[0], &actual128);
+  writer.join();
+  close(pipe_fds[0]);
+  if (!ok || memcmp(actual128, expected128, sizeof(HHResult128)) != 0) {
+    OnFailure<kHighwayHash>("Stream", size);
+  }
+
+  remove(path);
+  HHResult64 unused;
+  if (HighwayHashFile(key, path, &unused)) {
+    OnFailure<kHighwayHash>("File", 0);
+  }
+}
+
+// Writes an index, merges more fingerprints (including duplicates) into it
+// and verifies lookups, the order and the rejection of invalid files.
+void VerifyFingerprintIndex() {
+  const HHKey key = {1, 2, 3, 4};
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  // Fingerprints of the decimal numbers [0, num).
+  const auto fingerprints = [&key, &dispatch](const size_t num) {
+    std::vector<HHResult128> result(num);
+    for (size_t i = 0; i < num; ++i) {
+      char digits[24];
+      const int len = snprintf(digits, sizeof(digits), "%zu", i);
+      dispatch.hash128(key, digits, len, &result[i]);
+    }
+    return result;
+  };
+  const std::vector<HHResult128> all = fingerprints(3000);
+
+  char path[] = "/tmp/highwayhash_index_XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) {
+    OnFailure<kHighwayHash>("FingerprintIndex", 0);
+  }
+  close(fd);
+
+  FingerprintIndexBuilder builder;
+  FingerprintIndex index;
+  size_t prev_num = 0;
+  for (const size_t num : {size_t(0), size_t(1000), all.size()}) {
+    // Also re-adds half of the previous fingerprints, which must be ignored.
+    for (size_t i = prev_num / 2; i < num; ++i) {
+      builder.Add(all[i]);
+    }
+    prev_num = num;
+    if (!builder.Write(&index, path) || builder.NumAdded() != 0 ||
+        !index.Open(path) || index.size() != num) {
+      OnFailure<kHighwayHash>("FingerprintIndex", num);
+    }
+
+    for (size_t i = 1; i < index.size(); ++i) {
+      const uint64_t* prev = index.data()[i - 1];
+      const uint64_t* next = index.data()[i];
+      if (prev[1] > next[1] || (prev[1] == next[1] && prev[0] >= next[0])) {
+        OnFailure<kHighwayHash>("FingerprintIndex order", i);
+      }
+    }
+
+    bool found[3000];
+    index.ContainsBatch(all.data(), all.size(), found);
+    for (size_t i = 0; i < all.size(); ++i) {
+      if (index.Contains(all[i]) != (i < num) || found[i] != (i < num)) {
+        OnFailure<kHighwayHash>("FingerprintIndex", i);
+      }
+    }
+  }
+
+  FILE* file = fopen(path, "r+b");
+  if (file == nullptr || fputc('X', file) == EOF || fclose(file) != 0 ||
+      index.Open(path) || index.size() != 0 || index.Contains(all[0])) {
+    OnFailure<kHighwayHash>("FingerprintIndex", 1);
+  }
+  remove(path);
+}
+
+#endif  // HH_TEST_FILES
+
 void RunTests() {
   // TODO(janwas): detect number of cores.
   ThreadPool pool(4);
@@ -371,9 +1977,186 @@ void RunTests() {
   tested &= VerifyCat<HHResult64>(&pool);
   tested &= VerifyCat<HHResult128>(&pool);
   tested &= VerifyCat<HHResult256>(&pool);
-  HH_TARGET_NAME::ForeachTarget(tested, [](const TargetBits target) {
-    printf("%10sCat: OK\n", TargetName(target));
-  });
+  PrintOK(tested, "Cat");
+
+  tested = VerifySerialize();
+  PrintOK(tested, "Serialize");
+
+  tested = ~0U;
+  tested &= VerifyBatch<HHResult64>();
+  tested &= VerifyBatch<HHResult128>();
+  tested &= VerifyBatch<HHResult256>();
+  PrintOK(tested, "Batch");
+
+  tested = VerifySipBatch();
+  PrintOK(tested, "SipBatch");
+
+  tested = VerifySipTree();
+  PrintOK(tested, "SipTree");
+
+  tested = ~0U;
+  tested &= VerifyFixed<HHResult64>();
+  tested &= VerifyFixed<HHResult128>();
+  tested &= VerifyFixed<HHResult256>();
+  PrintOK(tested, "Fixed");
+
+  tested = ~0U;
+  tested &= VerifyShort<HHResult64>();
+  tested &= VerifyShort<HHResult128>();
+  tested &= VerifyShort<HHResult256>();
+  PrintOK(tested, "Short");
+
+  tested = ~0U;
+  tested &= VerifyPadded<HHResult64>();
+  tested &= VerifyPadded<HHResult128>();
+  tested &= VerifyPadded<HHResult256>();
+  PrintOK(tested, "Padded");
+
+  tested = ~0U;
+  tested &= VerifyCopy<HHResult64>();
+  tested &= VerifyCopy<HHResult128>();
+  tested &= VerifyCopy<HHResult256>();
+  PrintOK(tested, "Copy");
+
+  tested = ~0U;
+  tested &= VerifyValues<HHResult64>();
+  tested &= VerifyValues<HHResult128>();
+  tested &= VerifyValues<HHResult256>();
+  PrintOK(tested, "Values");
+
+  tested = ~0U;
+  tested &= VerifyMacs<HHResult64>();
+  tested &= VerifyMacs<HHResult128>();
+  tested &= VerifyMacs<HHResult256>();
+  PrintOK(tested, "Verify");
+
+  tested = ~0U;
+  tested &= VerifyOffsets<HHResult64>();
+  tested &= VerifyOffsets<HHResult128>();
+  tested &= VerifyOffsets<HHResult256>();
+  PrintOK(tested, "Offsets");
+
+  tested = VerifySample();
+  PrintOK(tested, "Sample");
+
+  tested = VerifyBloomFilter();
+  PrintOK(tested, "BloomFilter");
+
+  tested = VerifyCuckooFilter();
+  PrintOK(tested, "CuckooFilter");
+
+  tested = VerifyConcurrentHashSet();
+  PrintOK(tested, "ConcurrentHashSet");
+
+  tested = VerifyHyperLogLog();
+  PrintOK(tested, "HyperLogLog");
+
+  tested = VerifyMinHash();
+  PrintOK(tested, "MinHash");
+
+  tested = VerifyConsistentHash();
+  PrintOK(tested, "ConsistentHash");
+
+  tested = VerifyKeyedRandom();
+  PrintOK(tested, "KeyedRandom");
+
+  tested = ~0U;
+  tested &= VerifyNonTemporal<HHResult64>();
+  tested &= VerifyNonTemporal<HHResult128>();
+  tested &= VerifyNonTemporal<HHResult256>();
+  PrintOK(tested, "NonTemporal");
+
+  const HighwayHashFunctions& dispatch = HighwayHashDispatch();
+  VerifyDispatch(dispatch.hash64, dispatch.cat64, dispatch.batch64,
+                 kExpected64);
+  VerifyDispatch(dispatch.hash128, dispatch.cat128, dispatch.batch128,
+                 kExpected128);
+  VerifyDispatch(dispatch.hash256, dispatch.cat256, dispatch.batch256,
+                 kExpected256);
+  VerifyShortDispatch(dispatch.short64, kExpected64);
+  VerifyShortDispatch(dispatch.short128, kExpected128);
+  VerifyShortDispatch(dispatch.short256, kExpected256);
+  VerifyPaddedDispatch(dispatch.padded64, kExpected64);
+  VerifyPaddedDispatch(dispatch.padded128, kExpected128);
+  VerifyPaddedDispatch(dispatch.padded256, kExpected256);
+  VerifyBothDispatch(dispatch.hash64_128, kExpected64, kExpected128);
+  VerifyBothDispatch(dispatch.hash128_256, kExpected128, kExpected256);
+  VerifyMultiKeyDispatch(dispatch.multi_key64, dispatch.hash64);
+  VerifyMultiKeyDispatch(dispatch.multi_key128, dispatch.hash128);
+  VerifyMultiKeyDispatch(dispatch.multi_key256, dispatch.hash256);
+  VerifyCompactDispatch(dispatch.compact_finish64, kExpected64);
+  VerifyCompactDispatch(dispatch.compact_finish128, kExpected128);
+  VerifyCompactDispatch(dispatch.compact_finish256, kExpected256);
+  printf("%10sDispatch: OK\n", TargetName(dispatch.target));
+
+  VerifyAutotuned(kExpected64, kExpected128, kExpected256);
+  printf("%10s: OK (%s)\n", "Autotuned",
+         HighwayHashAutotuned::Get().Tuning().Summary().c_str());
+
+  VerifyTelemetry(kExpected64);
+  printf("%10s: OK (%s)\n", "Telemetry",
+         HighwayHashTelemetrySnapshot().ToString().c_str());
+
+  VerifyPrepared(dispatch.prepared64, kExpected64);
+  VerifyPrepared(dispatch.prepared128, kExpected128);
+  VerifyPrepared(dispatch.prepared256, kExpected256);
+  printf("%10s: OK\n", "Prepared");
+
+  VerifyValuesDispatch(dispatch);
+  printf("%10s: OK\n", "Values");
+
+  VerifyOffsetsDispatch(dispatch);
+  printf("%10s: OK\n", "Offsets");
+
+  VerifySampleDispatch(dispatch);
+  printf("%10s: OK\n", "Sample");
+
+  VerifyMacsDispatch(dispatch);
+  printf("%10s: OK\n", "Verify");
+
+#if HH_HAS_IOVEC
+  VerifyIovec(dispatch.cat_iovec64, kExpected64);
+  VerifyIovec(dispatch.cat_iovec128, kExpected128);
+  VerifyIovec(dispatch.cat_iovec256, kExpected256);
+  printf("%10s: OK\n", "iovec");
+#endif
+
+  tested = ~0U;
+  tested &= VerifyWide(kExpectedWide64);
+  tested &= VerifyWide(kExpectedWide128);
+  tested &= VerifyWide(kExpectedWide256);
+  PrintOK(tested, "Wide");
+  VerifyWideDispatch(dispatch.wide64, kExpectedWide64);
+  VerifyWideDispatch(dispatch.wide128, kExpectedWide128);
+  VerifyWideDispatch(dispatch.wide256, kExpectedWide256);
+
+  VerifyCBindings();
+  printf("%10s: OK\n", "C bindings");
+
+  VerifyHasher();
+
+  VerifyFields();
+
+#if HH_HAVE_CONSTEXPR_HASH
+  VerifyConstexpr();
+#endif
+
+  VerifyTreeHash(&pool);
+  printf("%10s: OK\n", "Tree hash");
+
+  VerifyMerkle(&pool);
+  printf("%10s: OK\n", "Merkle");
+
+  VerifyChunker();
+  printf("%10s: OK\n", "Chunker");
+
+#if HH_TEST_FILES
+  VerifyFileHash(&pool);
+  printf("%10s: OK\n", "File hash");
+
+  VerifyFingerprintIndex();
+  printf("%10s: OK\n", "FP index");
+#endif
 }
 
 #ifdef HH_GOOGLETEST
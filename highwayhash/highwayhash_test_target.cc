@@ -17,7 +17,16 @@
 
 #include "highwayhash/highwayhash_test_target.h"
 
+#include "highwayhash/bloom_filter.h"
+#include "highwayhash/concurrent_hash_set.h"
+#include "highwayhash/cuckoo_filter.h"
 #include "highwayhash/highwayhash.h"
+#include "highwayhash/hyperloglog.h"
+#include "highwayhash/consistent_hash.h"
+#include "highwayhash/keyed_random.h"
+#include "highwayhash/minhash.h"
+#include "highwayhash/sip_hash.h"
+#include "highwayhash/sip_hash_batch.h"
 
 #ifndef HH_DISABLE_TARGET_SPECIFIC
 namespace highwayhash {
@@ -43,18 +52,83 @@ void NotifyIfUnequal(const size_t size, const uint64_t (&expected)[kNumLanes],
   }
 }
 
+// Verifies HighwayHashMultiKeyT<kNumKeys> matches HighwayHashT under each
+// of the "keys".
+template <size_t kNumKeys, typename Result>
+void TestHighwayHashMultiKeyOf(const HHKey (&keys)[4],
+                               const char* HH_RESTRICT bytes,
+                               const size_t size, const Result (&expected)[4],
+                               const HHNotify notify) {
+  Result actual[kNumKeys];
+  HighwayHashMultiKeyT<HH_TARGET, kNumKeys>(keys, bytes, size, actual);
+  for (size_t i = 0; i < kNumKeys; ++i) {
+    NotifyIfUnequal(size, expected[i], actual[i], notify);
+  }
+}
+
+template <typename Result>
+void TestHighwayHashMultiKey(const HHKey& key, const char* HH_RESTRICT bytes,
+                             const size_t size, const HHNotify notify) {
+  HHKey keys[4];
+  Result expected[4];
+  for (size_t i = 0; i < 4; ++i) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      keys[i][lane] = key[lane] ^ (i * 0x9E3779B97F4A7C15ull);
+    }
+    HHStateT<HH_TARGET> state(keys[i]);
+    HighwayHashT(&state, bytes, size, &expected[i]);
+  }
+  TestHighwayHashMultiKeyOf<1>(keys, bytes, size, expected, notify);
+  TestHighwayHashMultiKeyOf<2>(keys, bytes, size, expected, notify);
+  TestHighwayHashMultiKeyOf<3>(keys, bytes, size, expected, notify);
+  TestHighwayHashMultiKeyOf<4>(keys, bytes, size, expected, notify);
+}
+
 // Shared logic for all HighwayHashTest::operator() overloads.
 template <typename Result>
-void TestHighwayHash(HHStateT<HH_TARGET>* HH_RESTRICT state,
-                     const char* HH_RESTRICT bytes, const size_t size,
-                     const Result* expected, const HHNotify notify) {
-  // TODO(janwas): investigate (length=33)
-#if HH_TARGET == HH_TARGET_Portable && HH_GCC_VERSION && !HH_CLANG_VERSION
-  return;
-#endif
+void TestHighwayHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, const Result* expected,
+                     const HHNotify notify) {
+  HHStateT<HH_TARGET> state(key);
   Result actual;
-  HighwayHashT(state, bytes, size, &actual);
+  HighwayHashT(&state, bytes, size, &actual);
   NotifyIfUnequal(size, *expected, actual, notify);
+
+  // Twice, to verify hashing does not modify the prepared state.
+  const HighwayHashKeyedT<HH_TARGET> keyed(key);
+  for (int rep = 0; rep < 2; ++rep) {
+    keyed(bytes, size, &actual);
+    NotifyIfUnequal(size, *expected, actual, notify);
+  }
+
+  TestHighwayHashMultiKey<Result>(key, bytes, size, notify);
+}
+
+// Verifies the two-result HighwayHashT and HighwayHashCatT::Finalize match
+// separate hashes of the same input.
+template <typename Result, typename WiderResult>
+void TestHighwayHashBoth(const HHKey& key, const char* HH_RESTRICT bytes,
+                         const size_t size, const HHNotify notify) {
+  Result expected;
+  WiderResult expected_wider;
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashT(&state, bytes, size, &expected);
+  HHStateT<HH_TARGET> state_wider(key);
+  HighwayHashT(&state_wider, bytes, size, &expected_wider);
+
+  Result actual;
+  WiderResult actual_wider;
+  HHStateT<HH_TARGET> state_both(key);
+  HighwayHashT(&state_both, bytes, size, &actual, &actual_wider);
+  NotifyIfUnequal(size, expected, actual, notify);
+  NotifyIfUnequal(size, expected_wider, actual_wider, notify);
+
+  HighwayHashCatT<HH_TARGET> cat(key);
+  cat.Append(bytes, size / 2);
+  cat.Append(bytes + size / 2, size - size / 2);
+  cat.Finalize(&actual, &actual_wider);
+  NotifyIfUnequal(size, expected, actual, notify);
+  NotifyIfUnequal(size, expected_wider, actual_wider, notify);
 }
 
 // Shared logic for all HighwayHashCatTest::operator() overloads.
@@ -62,11 +136,6 @@ template <typename Result>
 void TestHighwayHashCat(const HHKey& key, const char* HH_RESTRICT bytes,
                         const size_t size, const Result* expected,
                         const HHNotify notify) {
-  // TODO(janwas): investigate (length=33)
-#if HH_TARGET == HH_TARGET_Portable && HH_GCC_VERSION && !HH_CLANG_VERSION
-  return;
-#endif
-
   // Slightly faster to compute the expected prefix hashes only once.
   // Use new instead of vector to avoid headers with inline functions.
   Result* results = new Result[size + 1];
@@ -92,13 +161,1245 @@ void TestHighwayHashCat(const HHKey& key, const char* HH_RESTRICT bytes,
         Result result_cat;
         cat.Finalize(&result_cat);
 
-        const size_t total_size = pos - bytes;
-        NotifyIfUnequal(total_size, results[total_size], result_cat, notify);
-      }
+        const size_t total_size = pos - bytes;
+        NotifyIfUnequal(total_size, results[total_size], result_cat, notify);
+
+        const StringView fragments[3] = {{bytes, size1},
+                                         {bytes + size1, size2},
+                                         {bytes + size1 + size2, size3}};
+        HighwayHashCatT<HH_TARGET> cat_fragments(key);
+        cat_fragments.AppendFragments(fragments, fragments + 3);
+        cat_fragments.Finalize(&result_cat);
+        NotifyIfUnequal(total_size, results[total_size], result_cat, notify);
+
+        // Same fragments in a HHCompactCat, whose state must match Store.
+        HHCompactCat compact;
+        HighwayHashCompactStartT<HH_TARGET>(key, &compact);
+        for (const StringView& fragment : fragments) {
+          HighwayHashCompactAppendT<HH_TARGET>(&compact, fragment.data,
+                                               fragment.num_bytes);
+        }
+        HighwayHashCompactFinalizeT<HH_TARGET>(compact, &result_cat);
+        NotifyIfUnequal(total_size, results[total_size], result_cat, notify);
+        HHCompactCat stored;
+        cat.Store(&stored);
+        if (memcmp(stored.lanes, compact.lanes, sizeof(stored.lanes)) != 0 ||
+            stored.buffer_usage != compact.buffer_usage ||
+            memcmp(stored.buffer, compact.buffer, stored.buffer_usage) != 0) {
+          (*notify)(TargetName(HH_TARGET), total_size);
+        }
+
+        // Resuming a HighwayHashCatT from the compact state.
+        HighwayHashCatT<HH_TARGET> resumed(compact);
+        resumed.Finalize(&result_cat);
+        NotifyIfUnequal(total_size, results[total_size], result_cat, notify);
+      }
+    }
+  }
+
+  delete[] results;
+}
+
+// Shared logic for all HighwayHashBatchTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashBatch(const HHKey& key, const char* HH_RESTRICT bytes,
+                          const size_t size, const Result*,
+                          const HHNotify notify) {
+  // Ascending and then descending sizes, so that the lockstep pairs differ in
+  // both directions and the tail of either message may be longer. The start
+  // offsets also vary so that pairs do not share the same data.
+  const size_t num_messages = 2 * (size + 1);
+  StringView* messages = new StringView[num_messages];
+  for (size_t i = 0; i <= size; ++i) {
+    messages[i].data = bytes + size - i;
+    messages[i].num_bytes = i;
+    messages[num_messages - 1 - i].data = bytes;
+    messages[num_messages - 1 - i].num_bytes = i;
+  }
+
+  // Also covers an odd number of messages.
+  Result* hashes = new Result[num_messages];
+  for (size_t count = num_messages - 1; count <= num_messages; ++count) {
+    HighwayHashBatchT<HH_TARGET>(key, messages, count, hashes);
+    for (size_t i = 0; i < count; ++i) {
+      HHStateT<HH_TARGET> state(key);
+      Result result_flat;
+      HighwayHashT(&state, messages[i].data, messages[i].num_bytes,
+                   &result_flat);
+      NotifyIfUnequal(messages[i].num_bytes, result_flat, hashes[i], notify);
+    }
+  }
+
+  delete[] hashes;
+  delete[] messages;
+}
+
+// Verifies SipHashBatchT<kUpdateIters, kFinalizeIters> for the first
+// "num_messages" of "messages".
+template <int kUpdateIters, int kFinalizeIters>
+void TestSipHashBatchCount(const HH_U64 (&key)[2],
+                           const StringView* HH_RESTRICT messages,
+                           const size_t num_messages,
+                           HH_U64* HH_RESTRICT hashes, const HHNotify notify) {
+  using State = SipHashStateT<kUpdateIters, kFinalizeIters,
+                              HH_TARGET_NAME::SipHashBatchTag>;
+  HH_TARGET_NAME::SipHashBatchT<kUpdateIters, kFinalizeIters>(
+      key, messages, num_messages, hashes);
+  for (size_t i = 0; i < num_messages; ++i) {
+    State state(key);
+    UpdateState(messages[i].data, messages[i].num_bytes, &state);
+    if (state.Finalize() != hashes[i]) {
+      (*notify)(TargetName(HH_TARGET), messages[i].num_bytes);
+    }
+  }
+}
+
+// Verifies HighwayHashFixedT<kSize> if kSize <= size.
+template <size_t kSize, typename Result>
+void TestHighwayHashFixedSize(const HHKey& key, const char* HH_RESTRICT bytes,
+                              const size_t size, const HHNotify notify) {
+  if (kSize > size) return;
+  HHStateT<HH_TARGET> state_fixed(key);
+  Result actual;
+  HighwayHashFixedT<kSize>(&state_fixed, bytes, &actual);
+  HHStateT<HH_TARGET> state(key);
+  Result expected;
+  HighwayHashT(&state, bytes, kSize, &expected);
+  NotifyIfUnequal(kSize, expected, actual, notify);
+}
+
+// Calls TestHighwayHashFixedSize for all sizes in [kSize, kEnd).
+template <size_t kSize, size_t kEnd>
+struct FixedSizes {
+  template <typename Result>
+  static void Test(const HHKey& key, const char* HH_RESTRICT bytes,
+                   const size_t size, const HHNotify notify) {
+    TestHighwayHashFixedSize<kSize, Result>(key, bytes, size, notify);
+    FixedSizes<kSize + 1, kEnd>::template Test<Result>(key, bytes, size,
+                                                       notify);
+  }
+};
+
+template <size_t kEnd>
+struct FixedSizes<kEnd, kEnd> {
+  template <typename Result>
+  static void Test(const HHKey&, const char* HH_RESTRICT, const size_t,
+                   const HHNotify) {}
+};
+
+// Shared logic for all HighwayHashFixedTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashFixed(const HHKey& key, const char* HH_RESTRICT bytes,
+                          const size_t size, const Result*,
+                          const HHNotify notify) {
+  FixedSizes<0, 65>::Test<Result>(key, bytes, size, notify);
+  TestHighwayHashFixedSize<100, Result>(key, bytes, size, notify);
+  TestHighwayHashFixedSize<127, Result>(key, bytes, size, notify);
+  TestHighwayHashFixedSize<128, Result>(key, bytes, size, notify);
+  TestHighwayHashFixedSize<1000, Result>(key, bytes, size, notify);
+}
+
+// Shared logic for all HighwayHashShortTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashShort(const HHKey& key, const char* HH_RESTRICT bytes,
+                          const size_t size, const Result*,
+                          const HHNotify notify) {
+  for (size_t offset = 0; offset < 32 && offset + 32 <= size; ++offset) {
+    for (size_t short_size = 0; short_size <= 32; ++short_size) {
+      HHStateT<HH_TARGET> state_short(key);
+      Result actual;
+      HighwayHashShortT(&state_short, bytes + offset, short_size, &actual);
+      HHStateT<HH_TARGET> state(key);
+      Result expected;
+      HighwayHashT(&state, bytes + offset, short_size, &expected);
+      NotifyIfUnequal(short_size, expected, actual, notify);
+    }
+  }
+}
+
+// Shared logic for all HighwayHashPaddedTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashPadded(const HHKey& key, const Result*,
+                           const HHNotify notify) {
+  char in[32 + kMaxPaddedTestSize + 32];
+  for (size_t offset = 0; offset < 32; ++offset) {
+    for (size_t size = 0; size <= kMaxPaddedTestSize; ++size) {
+      char* HH_RESTRICT bytes = in + offset;
+      for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>(i * 131 + offset);
+      }
+      memset(bytes + size, 0xFF, 32);
+
+      HHStateT<HH_TARGET> state(key);
+      Result expected;
+      HighwayHashT(&state, bytes, size, &expected);
+
+      HHStateT<HH_TARGET> state_padded(key);
+      Result actual;
+      HighwayHashPaddedT(&state_padded, bytes, size, &actual);
+      NotifyIfUnequal(size, expected, actual, notify);
+
+      // The first fragment's padding is the start of the second.
+      const size_t splits[4] = {0, 1, size / 2, size};
+      for (const size_t split : splits) {
+        if (split > size) continue;
+        HighwayHashCatT<HH_TARGET> cat(key);
+        cat.AppendPadded(bytes, split);
+        cat.AppendPadded(bytes + split, size - split);
+        cat.Finalize(&actual);
+        NotifyIfUnequal(size, expected, actual, notify);
+      }
+    }
+  }
+}
+
+// Returns whether "copy" holds the "size" bytes followed by "guard" bytes
+// that are still zero.
+bool IsExactCopy(const char* HH_RESTRICT bytes, const size_t size,
+                 const char* HH_RESTRICT copy, const size_t guard) {
+  if (memcmp(copy, bytes, size) != 0) return false;
+  for (size_t i = size; i < size + guard; ++i) {
+    if (copy[i] != 0) return false;
+  }
+  return true;
+}
+
+// Shared logic for all HighwayHashCopyTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashCopy(const HHKey& key, const char* HH_RESTRICT bytes,
+                         const size_t size, const Result*,
+                         const HHNotify notify) {
+  const size_t kGuard = 32;
+  char copy[kMaxCopyTestSize + kGuard];
+  for (size_t actual_size = 0;
+       actual_size <= size && actual_size <= kMaxCopyTestSize; ++actual_size) {
+    HHStateT<HH_TARGET> state(key);
+    Result expected;
+    HighwayHashT(&state, bytes, actual_size, &expected);
+
+    memset(copy, 0, sizeof(copy));
+    HHStateT<HH_TARGET> state_copy(key);
+    Result actual;
+    HighwayHashCopyT(&state_copy, bytes, actual_size, copy, &actual);
+    NotifyIfUnequal(actual_size, expected, actual, notify);
+    if (!IsExactCopy(bytes, actual_size, copy, kGuard)) {
+      notify(TargetName(HH_TARGET), actual_size);
+    }
+
+    // First fragment shorter than, equal to or longer than a packet.
+    const size_t kSplits[] = {0, 1, 31, 32, 33, 70};
+    for (const size_t split : kSplits) {
+      if (split > actual_size) continue;
+      memset(copy, 0, sizeof(copy));
+      HighwayHashCatT<HH_TARGET> cat(key);
+      cat.AppendCopy(bytes, split, copy);
+      cat.AppendCopy(bytes + split, actual_size - split, copy + split);
+      cat.Finalize(&actual);
+      NotifyIfUnequal(actual_size, expected, actual, notify);
+      if (!IsExactCopy(bytes, actual_size, copy, kGuard)) {
+        notify(TargetName(HH_TARGET), actual_size);
+      }
+    }
+  }
+}
+
+// Loads the little-endian "Value" at "bytes"; the byte order of the host
+// must not affect the results.
+template <typename Value>
+Value LoadValue(const char* HH_RESTRICT bytes) {
+  Value value = 0;
+  for (size_t i = 0; i < sizeof(Value); ++i) {
+    value |= static_cast<Value>(static_cast<unsigned char>(bytes[i]))
+             << (i * 8);
+  }
+  return value;
+}
+
+// Shared logic for all HighwayHashValuesTest::operator() overloads.
+template <typename Value, typename Result>
+void TestHighwayHashValuesOf(const HHKey& key, const char* HH_RESTRICT bytes,
+                             const size_t size, const HHNotify notify) {
+  const size_t num_values = size / sizeof(Value);
+  Value* values = new Value[num_values];
+  for (size_t i = 0; i < num_values; ++i) {
+    values[i] = LoadValue<Value>(bytes + i * sizeof(Value));
+  }
+
+  Result* hashes = new Result[num_values];
+  for (size_t count = 0; count <= num_values; ++count) {
+    HighwayHashValuesT<HH_TARGET>(key, values, count, hashes);
+    for (size_t i = 0; i < count; ++i) {
+      HHStateT<HH_TARGET> state(key);
+      Result expected;
+      HighwayHashT(&state, bytes + i * sizeof(Value), sizeof(Value), &expected);
+      NotifyIfUnequal(sizeof(Value), expected, hashes[i], notify);
+    }
+  }
+
+  for (size_t i = 0; i < num_values; ++i) {
+    HHStateT<HH_TARGET> state(key);
+    Result actual;
+    if (sizeof(Value) == 8) {
+      HighwayHashU64T(&state, values[i], &actual);
+    } else {
+      HighwayHashU32T(&state, static_cast<uint32_t>(values[i]), &actual);
+    }
+    NotifyIfUnequal(sizeof(Value), hashes[i], actual, notify);
+  }
+
+  delete[] hashes;
+  delete[] values;
+}
+
+template <typename Result>
+void TestHighwayHashValues(const HHKey& key, const char* HH_RESTRICT bytes,
+                           const size_t size, const Result*,
+                           const HHNotify notify) {
+  TestHighwayHashValuesOf<uint64_t, Result>(key, bytes, size, notify);
+  TestHighwayHashValuesOf<uint32_t, Result>(key, bytes, size, notify);
+}
+
+// Shared logic for all HighwayHashVerifyTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashVerify(const HHKey& key, const char* HH_RESTRICT bytes,
+                           const size_t size, const Result*,
+                           const HHNotify notify) {
+  // Message i has length i % 70 and starts at offset i.
+  const size_t kMaxMessages = 150;
+  const size_t num_messages = size < 70 ? 0 : (size - 69 < kMaxMessages
+                                                   ? size - 69
+                                                   : kMaxMessages);
+  StringView messages[kMaxMessages];
+  Result tags[kMaxMessages];
+  for (size_t i = 0; i < num_messages; ++i) {
+    messages[i] = StringView{bytes + i, i % 70};
+    HHStateT<HH_TARGET> state(key);
+    HighwayHashT(&state, messages[i].data, messages[i].num_bytes, &tags[i]);
+    // Forge every seventh tag by flipping a single (varying) bit.
+    if (i % 7 == 3) {
+      uint8_t* tag_bytes = reinterpret_cast<uint8_t*>(&tags[i]);
+      const size_t bit = i * 13 % (sizeof(Result) * 8);
+      tag_bytes[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+    }
+  }
+
+  const size_t kCounts[] = {0, 1, 2, 63, 64, 65, 128, kMaxMessages};
+  for (const size_t count : kCounts) {
+    if (count > num_messages) break;
+    uint64_t failures[(kMaxMessages + 63) / 64];
+    memset(failures, 0xFF, sizeof(failures));
+    const size_t num_failures =
+        HighwayHashVerifyT<HH_TARGET>(key, messages, tags, count, failures);
+    size_t expected_failures = 0;
+    for (size_t i = 0; i < (count + 63) / 64 * 64; ++i) {
+      const bool forged = i < count && i % 7 == 3;
+      expected_failures += forged;
+      if (((failures[i / 64] >> (i % 64)) & 1) != forged) {
+        notify(TargetName(HH_TARGET), i);
+      }
+    }
+    if (num_failures != expected_failures) {
+      notify(TargetName(HH_TARGET), count);
+    }
+  }
+}
+
+// Shared logic for all HighwayHashOffsetsTest::operator() overloads.
+template <typename Offset, typename Result>
+void TestHighwayHashOffsetsOf(const HHKey& key, const char* HH_RESTRICT bytes,
+                              const size_t size, const HHNotify notify) {
+  // Lengths cycle through 0..kMaxLength so that every remainder and up to two
+  // whole packets occur; every third string is null.
+  const size_t kMaxLength = 2 * sizeof(HHPacket) + 5;
+  // There are at most size + 1 strings because only one per cycle is empty.
+  Offset* offsets = new Offset[size + 2];
+  uint8_t* validity = new uint8_t[size / 8 + 1];
+  memset(validity, 0, size / 8 + 1);
+  size_t num_strings = 0;
+  offsets[0] = 0;
+  for (size_t pos = 0;; ++num_strings) {
+    const size_t length = num_strings % (kMaxLength + 1);
+    if (pos + length > size) break;
+    pos += length;
+    offsets[num_strings + 1] = static_cast<Offset>(pos);
+    if (num_strings % 3 != 2) {
+      validity[num_strings / 8] |= 1 << (num_strings % 8);
+    }
+  }
+
+  Result* hashes = new Result[num_strings];
+  for (int with_nulls = 0; with_nulls < 2; ++with_nulls) {
+    const uint8_t* bitmap = with_nulls ? validity : nullptr;
+    HighwayHashOffsetsT<HH_TARGET>(key, bytes, offsets, bitmap, num_strings,
+                                   hashes);
+    for (size_t i = 0; i < num_strings; ++i) {
+      const size_t length = static_cast<size_t>(offsets[i + 1] - offsets[i]);
+      Result expected;
+      if (with_nulls && (validity[i / 8] & (1 << (i % 8))) == 0) {
+        memset(&expected, 0, sizeof(expected));
+      } else {
+        HHStateT<HH_TARGET> state(key);
+        HighwayHashT(&state, bytes + offsets[i], length, &expected);
+      }
+      NotifyIfUnequal(length, expected, hashes[i], notify);
+    }
+  }
+
+  delete[] hashes;
+  delete[] validity;
+  delete[] offsets;
+}
+
+template <typename Result>
+void TestHighwayHashOffsets(const HHKey& key, const char* HH_RESTRICT bytes,
+                            const size_t size, const Result*,
+                            const HHNotify notify) {
+  TestHighwayHashOffsetsOf<int32_t, Result>(key, bytes, size, notify);
+  TestHighwayHashOffsetsOf<int64_t, Result>(key, bytes, size, notify);
+}
+
+// Verifies "selected" and "num_selected" (from HighwayHashSample*T) against
+// the "num_rows" "hashes" (zero for null rows if "validity" is non-null).
+void VerifySample(const HHResult64* HH_RESTRICT hashes,
+                  const uint8_t* HH_RESTRICT validity, const size_t num_rows,
+                  const uint64_t threshold,
+                  const uint64_t* HH_RESTRICT selected,
+                  const size_t num_selected, const HHNotify notify) {
+  uint32_t* selection = new uint32_t[num_rows + 1];
+  if (HHSelectionFromBits(selected, num_rows, selection) != num_selected) {
+    notify(TargetName(HH_TARGET), num_selected);
+  }
+  size_t num_expected = 0;
+  for (size_t i = 0; i < (num_rows + 63) / 64 * 64; ++i) {
+    const bool expected =
+        i < num_rows && hashes[i] < threshold &&
+        (validity == nullptr || ((validity[i / 8] >> (i % 8)) & 1));
+    if (((selected[i / 64] >> (i % 64)) & 1) != expected) {
+      notify(TargetName(HH_TARGET), i);
+    }
+    if (expected && selection[num_expected++] != i) {
+      notify(TargetName(HH_TARGET), i);
+    }
+  }
+  if (num_expected != num_selected) notify(TargetName(HH_TARGET), num_rows);
+  delete[] selection;
+}
+
+template <typename Value>
+void TestHighwayHashSampleValues(const HHKey& key,
+                                 const char* HH_RESTRICT bytes,
+                                 const size_t size, const uint64_t threshold,
+                                 const HHNotify notify) {
+  const size_t num_values = size / sizeof(Value);
+  Value* values = new Value[num_values];
+  memcpy(values, bytes, num_values * sizeof(Value));
+  HHResult64* hashes = new HHResult64[num_values];
+  // Poison, so that VerifySample detects unwritten words.
+  uint64_t* selected = new uint64_t[num_values / 64 + 1];
+  memset(selected, 0xFF, (num_values / 64 + 1) * sizeof(uint64_t));
+
+  HighwayHashValuesT<HH_TARGET>(key, values, num_values, hashes);
+  const size_t num_selected = HighwayHashSampleValuesT<HH_TARGET>(
+      key, values, num_values, threshold, selected);
+  VerifySample(hashes, nullptr, num_values, threshold, selected, num_selected,
+               notify);
+
+  delete[] selected;
+  delete[] hashes;
+  delete[] values;
+}
+
+template <typename Offset>
+void TestHighwayHashSampleOffsets(const HHKey& key,
+                                  const char* HH_RESTRICT bytes,
+                                  const size_t size, const uint64_t threshold,
+                                  const HHNotify notify) {
+  // Lengths cycle through 0..40; every third string is null.
+  Offset* offsets = new Offset[size + 2];
+  uint8_t* validity = new uint8_t[size / 8 + 1];
+  memset(validity, 0, size / 8 + 1);
+  size_t num_strings = 0;
+  offsets[0] = 0;
+  for (size_t pos = 0;; ++num_strings) {
+    const size_t length = num_strings % 41;
+    if (pos + length > size) break;
+    pos += length;
+    offsets[num_strings + 1] = static_cast<Offset>(pos);
+    if (num_strings % 3 != 2) {
+      validity[num_strings / 8] |= 1 << (num_strings % 8);
+    }
+  }
+
+  HHResult64* hashes = new HHResult64[num_strings];
+  uint64_t* selected = new uint64_t[num_strings / 64 + 1];
+  HighwayHashOffsetsT<HH_TARGET>(key, bytes, offsets, nullptr, num_strings,
+                                 hashes);
+  for (int with_nulls = 0; with_nulls < 2; ++with_nulls) {
+    const uint8_t* bitmap = with_nulls ? validity : nullptr;
+    memset(selected, 0xFF, (num_strings / 64 + 1) * sizeof(uint64_t));
+    const size_t num_selected = HighwayHashSampleOffsetsT<HH_TARGET>(
+        key, bytes, offsets, bitmap, num_strings, threshold, selected);
+    VerifySample(hashes, bitmap, num_strings, threshold, selected,
+                 num_selected, notify);
+  }
+
+  delete[] selected;
+  delete[] hashes;
+  delete[] validity;
+  delete[] offsets;
+}
+
+void TestHighwayHashSample(const HHKey& key, const char* HH_RESTRICT bytes,
+                           const size_t size, const HHNotify notify) {
+  if (HighwayHashSampleThreshold(0.0) != 0 ||
+      HighwayHashSampleThreshold(0.5) != 1ULL << 63 ||
+      HighwayHashSampleThreshold(1.0) != ~0ULL ||
+      HighwayHashSampleThreshold(-1.0) != 0) {
+    notify(TargetName(HH_TARGET), 0);
+  }
+
+  const uint64_t kThresholds[5] = {0, 1ULL << 58, 1ULL << 62, 1ULL << 63,
+                                   ~0ULL};
+  for (const uint64_t threshold : kThresholds) {
+    // Also sizes that are not a multiple of 64 values.
+    const size_t kNumBytes[2] = {size, size - 8 * 13};
+    for (const size_t num_bytes : kNumBytes) {
+      TestHighwayHashSampleValues<uint64_t>(key, bytes, num_bytes, threshold,
+                                            notify);
+      TestHighwayHashSampleValues<uint32_t>(key, bytes, num_bytes, threshold,
+                                            notify);
+    }
+    TestHighwayHashSampleOffsets<int32_t>(key, bytes, size, threshold, notify);
+    TestHighwayHashSampleOffsets<int64_t>(key, bytes, size, threshold, notify);
+  }
+}
+
+// Key i of TestBloomFilter: up to 23 bytes starting at offset i.
+StringView BloomKey(const char* HH_RESTRICT bytes, const size_t size,
+                    const size_t i) {
+  const size_t length = i % 24 < size - i ? i % 24 : size - i;
+  return StringView{bytes + i, length};
+}
+
+void TestBloomFilter(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, const HHNotify notify) {
+  using Filter = HH_TARGET_NAME::BloomFilter;
+  // Not a power of two; few enough that blocks receive several keys.
+  const size_t kNumBlocks = 7;
+  const size_t kWords = kNumBlocks * Filter::kWordsPerBlock;
+  Filter filter(key, kNumBlocks);
+  Filter batch_filter(key, kNumBlocks);
+
+  // Even keys are inserted, one by one and via InsertBatch.
+  const size_t num_keys = size / 2;
+  StringView* keys = new StringView[num_keys];
+  uint64_t* expected = new uint64_t[kWords];
+  memset(expected, 0, kWords * sizeof(uint64_t));
+  for (size_t k = 0; k < num_keys; ++k) {
+    keys[k] = BloomKey(bytes, size, 2 * k);
+    filter.Insert(keys[k].data, keys[k].num_bytes);
+
+    // Reference: the layout documented in bloom_filter.h.
+    HHStateT<HH_TARGET> state(key);
+    HHResult128 hash;
+    HighwayHashT(&state, keys[k].data, keys[k].num_bytes, &hash);
+    const size_t block = ((hash[0] >> 32) * kNumBlocks) >> 32;
+    for (size_t w = 0; w < Filter::kWordsPerBlock; ++w) {
+      expected[block * Filter::kWordsPerBlock + w] |=
+          1ULL << ((hash[1] >> (w * 6)) & 63);
+    }
+  }
+  batch_filter.InsertBatch(keys, num_keys);
+
+  for (size_t i = 0; i < kWords; ++i) {
+    if (filter.Data()[i] != expected[i] ||
+        batch_filter.Data()[i] != expected[i]) {
+      notify(TargetName(HH_TARGET), i);
+    }
+  }
+
+  // All keys, including the odd ones that were not inserted.
+  StringView* queries = new StringView[size];
+  bool* results = new bool[size];
+  for (size_t i = 0; i < size; ++i) {
+    queries[i] = BloomKey(bytes, size, i);
+  }
+  filter.MayContainBatch(queries, size, results);
+  for (size_t i = 0; i < size; ++i) {
+    const bool may_contain =
+        filter.MayContain(queries[i].data, queries[i].num_bytes);
+    if (results[i] != may_contain || (i % 2 == 0 && !may_contain)) {
+      notify(TargetName(HH_TARGET), queries[i].num_bytes);
+    }
+  }
+
+  delete[] results;
+  delete[] queries;
+  delete[] expected;
+  delete[] keys;
+}
+
+// Key i of TestCuckooFilter: 8 to 23 bytes starting at offset i (fewer near
+// the end). Unlike BloomKey, there are no duplicates, of which a cuckoo filter
+// can only hold 2 * kSlotsPerBucket.
+StringView CuckooKey(const char* HH_RESTRICT bytes, const size_t size,
+                     const size_t i) {
+  const size_t length = 8 + i % 16 < size - i ? 8 + i % 16 : size - i;
+  return StringView{bytes + i, length};
+}
+
+// Returns whether "bucket" (the layout documented in cuckoo_filter.h) has a
+// slot equal to "fingerprint".
+bool CuckooBucketContains(const uint64_t bucket, const uint64_t fingerprint) {
+  for (size_t slot = 0; slot < 4; ++slot) {
+    if (((bucket >> (slot * 16)) & 0xFFFF) == fingerprint) return true;
+  }
+  return false;
+}
+
+// Inserts "keys" into "filter" and verifies the buckets of those inserted.
+void TestCuckooInserts(const HHKey& key, const StringView* HH_RESTRICT keys,
+                       const size_t num_keys,
+                       HH_TARGET_NAME::CuckooFilter* filter,
+                       const HHNotify notify) {
+  const size_t mask = filter->NumBuckets() - 1;
+  size_t num_inserted = 0;
+  size_t num_missing = 0;
+  for (size_t k = 0; k < num_keys; ++k) {
+    if (!filter->Insert(keys[k].data, keys[k].num_bytes)) continue;
+    ++num_inserted;
+  }
+  if (filter->Size() != num_inserted) notify(TargetName(HH_TARGET), 0);
+  for (size_t k = 0; k < num_inserted; ++k) {
+    // Reference: fingerprint and buckets as documented in cuckoo_filter.h.
+    HHStateT<HH_TARGET> state(key);
+    HHResult64 hash;
+    HighwayHashT(&state, keys[k].data, keys[k].num_bytes, &hash);
+    const uint64_t fingerprint = (hash >> 48) == 0 ? 1 : hash >> 48;
+    const size_t index = (hash & 0xFFFFFFFFu) & mask;
+    const size_t alternate =
+        (index ^ static_cast<uint32_t>(fingerprint * 0x5BD1E995u)) & mask;
+    if (!CuckooBucketContains(filter->Data()[index], fingerprint) &&
+        !CuckooBucketContains(filter->Data()[alternate], fingerprint)) {
+      ++num_missing;  // only allowed for the victim
+    }
+    if (!filter->MayContain(keys[k].data, keys[k].num_bytes)) {
+      notify(TargetName(HH_TARGET), keys[k].num_bytes);
+    }
+  }
+  if (num_missing > 1) notify(TargetName(HH_TARGET), num_missing);
+}
+
+void TestCuckooFilter(const HHKey& key, const char* HH_RESTRICT bytes,
+                      const size_t size, const HHNotify notify) {
+  using Filter = HH_TARGET_NAME::CuckooFilter;
+  const size_t num_keys = size / 2;
+  StringView* keys = new StringView[num_keys];
+  for (size_t k = 0; k < num_keys; ++k) {
+    keys[k] = CuckooKey(bytes, size, 2 * k);
+  }
+
+  // Large enough for all keys, and too small (which requires kicking and
+  // eventually fills the filter).
+  const size_t kNumBuckets[2] = {Filter::NumBucketsFor(num_keys), 16};
+  for (const size_t num_buckets : kNumBuckets) {
+    Filter filter(key, num_buckets);
+    Filter batch_filter(key, num_buckets);
+    TestCuckooInserts(key, keys, num_keys, &filter, notify);
+    const size_t num_inserted = batch_filter.InsertBatch(keys, num_keys);
+    if (num_inserted != filter.Size() ||
+        memcmp(filter.Data(), batch_filter.Data(), filter.Bytes()) != 0) {
+      notify(TargetName(HH_TARGET), num_buckets);
+    }
+    if (num_buckets != 16 && num_inserted != num_keys) {
+      notify(TargetName(HH_TARGET), num_inserted);
+    }
+
+    // All keys, including the odd ones that were not inserted.
+    StringView* queries = new StringView[size];
+    bool* results = new bool[size];
+    for (size_t i = 0; i < size; ++i) {
+      queries[i] = CuckooKey(bytes, size, i);
+    }
+    filter.MayContainBatch(queries, size, results);
+    for (size_t i = 0; i < size; ++i) {
+      if (results[i] !=
+          filter.MayContain(queries[i].data, queries[i].num_bytes)) {
+        notify(TargetName(HH_TARGET), queries[i].num_bytes);
+      }
+    }
+
+    // Erasing in reverse order also erases the victim, if any.
+    for (size_t k = num_inserted; k != 0; --k) {
+      if (!filter.Erase(keys[k - 1].data, keys[k - 1].num_bytes)) {
+        notify(TargetName(HH_TARGET), keys[k - 1].num_bytes);
+      }
+    }
+    for (size_t i = 0; i < num_buckets; ++i) {
+      if (filter.Data()[i] != 0) notify(TargetName(HH_TARGET), i);
+    }
+    if (filter.Size() != 0 || filter.Erase(keys[0].data, keys[0].num_bytes)) {
+      notify(TargetName(HH_TARGET), filter.Size());
+    }
+
+    delete[] results;
+    delete[] queries;
+  }
+  delete[] keys;
+}
+
+// Returns whether "slots" (the layout documented in concurrent_hash_set.h)
+// have the tag of "hash" before the first empty slot of its probe sequence.
+bool ConcurrentHashSetHasTag(const uint64_t* HH_RESTRICT slots,
+                             const size_t num_groups, const HHResult64 hash) {
+  const uint64_t tag = hash == 0 ? 1 : hash;
+  const size_t mask = num_groups - 1;
+  for (size_t probes = 0; probes <= mask; ++probes) {
+    const uint64_t* group = slots + ((hash + probes) & mask) * 8;
+    for (size_t i = 0; i < 8; ++i) {
+      if (group[i] == tag) return true;
+      if (group[i] == 0) return false;
+    }
+  }
+  return false;
+}
+
+void TestConcurrentHashSet(const HHKey& key, const char* HH_RESTRICT bytes,
+                           const size_t size, const HHNotify notify) {
+  using Set = HH_TARGET_NAME::ConcurrentHashSet;
+  // Distinct keys, see CuckooKey.
+  const size_t num_keys = size / 2;
+  StringView* keys = new StringView[num_keys];
+  for (size_t k = 0; k < num_keys; ++k) {
+    keys[k] = CuckooKey(bytes, size, 2 * k);
+  }
+  bool* inserted = new bool[num_keys];
+
+  Set set(key, Set::NumGroupsFor(num_keys));
+  Set batch_set(key, set.NumGroups());
+  for (size_t k = 0; k < num_keys; ++k) {
+    HHStateT<HH_TARGET> state(key);
+    HHResult64 hash;
+    HighwayHashT(&state, keys[k].data, keys[k].num_bytes, &hash);
+    if (set.Hash(keys[k].data, keys[k].num_bytes) != hash ||
+        !set.Insert(keys[k].data, keys[k].num_bytes) ||
+        set.Insert(keys[k].data, keys[k].num_bytes) ||
+        !set.Contains(keys[k].data, keys[k].num_bytes)) {
+      notify(TargetName(HH_TARGET), keys[k].num_bytes);
+    }
+  }
+  if (batch_set.InsertBatch(keys, num_keys, inserted) != num_keys ||
+      batch_set.InsertBatch(keys, num_keys, inserted) != 0) {
+    notify(TargetName(HH_TARGET), num_keys);
+  }
+  if (set.Size() != num_keys || batch_set.Size() != num_keys ||
+      set.Overflowed() || batch_set.Overflowed()) {
+    notify(TargetName(HH_TARGET), set.Size());
+  }
+
+  for (size_t k = 0; k < num_keys; ++k) {
+    const HHResult64 hash = set.Hash(keys[k].data, keys[k].num_bytes);
+    if (!ConcurrentHashSetHasTag(set.Data(), set.NumGroups(), hash) ||
+        !ConcurrentHashSetHasTag(batch_set.Data(), set.NumGroups(), hash)) {
+      notify(TargetName(HH_TARGET), k);
+    }
+  }
+
+  // All keys, including the odd ones that were not inserted.
+  StringView* queries = new StringView[size];
+  bool* results = new bool[size];
+  for (size_t i = 0; i < size; ++i) {
+    queries[i] = CuckooKey(bytes, size, i);
+  }
+  set.ContainsBatch(queries, size, results);
+  for (size_t i = 0; i < size; ++i) {
+    const bool expected = i % 2 == 0 && i / 2 < num_keys;
+    if (results[i] != expected ||
+        set.Contains(queries[i].data, queries[i].num_bytes) != expected) {
+      notify(TargetName(HH_TARGET), queries[i].num_bytes);
+    }
+  }
+
+  // A single group holds only kSlotsPerGroup keys.
+  Set full_set(key, 1);
+  size_t num_inserted = full_set.InsertBatch(keys, num_keys, inserted);
+  for (size_t k = 0; k < num_keys; ++k) {
+    num_inserted += full_set.Insert(keys[k].data, keys[k].num_bytes);
+  }
+  if (num_inserted != Set::kSlotsPerGroup ||
+      full_set.Size() != Set::kSlotsPerGroup || !full_set.Overflowed() ||
+      !full_set.Contains(keys[0].data, keys[0].num_bytes)) {
+    notify(TargetName(HH_TARGET), num_inserted);
+  }
+  full_set.Clear();
+  if (full_set.Size() != 0 || full_set.Overflowed() ||
+      full_set.Contains(keys[0].data, keys[0].num_bytes)) {
+    notify(TargetName(HH_TARGET), full_set.Size());
+  }
+
+  delete[] results;
+  delete[] queries;
+  delete[] inserted;
+  delete[] keys;
+}
+
+// Element i of TestHyperLogLog: the 8 little-endian bytes of i.
+void HyperLogLogElement(const uint64_t i, char (&bytes)[8]) {
+  for (size_t j = 0; j < 8; ++j) {
+    bytes[j] = static_cast<char>(i >> (j * 8));
+  }
+}
+
+// Adds elements [begin, end) to "sketch", one by one or via AddBatch.
+void AddHyperLogLogElements(const uint64_t begin, const uint64_t end,
+                            const bool batch,
+                            HH_TARGET_NAME::HyperLogLog* sketch) {
+  if (!batch) {
+    for (uint64_t i = begin; i < end; ++i) {
+      char bytes[8];
+      HyperLogLogElement(i, bytes);
+      sketch->Add(bytes, sizeof(bytes));
+    }
+    return;
+  }
+
+  const size_t num_elements = static_cast<size_t>(end - begin);
+  char* bytes = new char[num_elements * 8];
+  StringView* elements = new StringView[num_elements];
+  for (size_t i = 0; i < num_elements; ++i) {
+    char element[8];
+    HyperLogLogElement(begin + i, element);
+    memcpy(bytes + i * 8, element, 8);
+    elements[i] = StringView{bytes + i * 8, 8};
+  }
+  sketch->AddBatch(elements, num_elements);
+  delete[] elements;
+  delete[] bytes;
+}
+
+// Notifies if the registers of "sketch" differ from those of a scalar
+// reference (the layout documented in hyperloglog.h) for elements [0, end).
+void VerifyHyperLogLogRegisters(const HHKey& key, const uint64_t end,
+                                const HH_TARGET_NAME::HyperLogLog& sketch,
+                                const HHNotify notify) {
+  const int precision = sketch.Precision();
+  const size_t num_registers = size_t(1) << precision;
+  uint8_t* expected = new uint8_t[num_registers];
+  uint8_t* actual = new uint8_t[num_registers];
+  memset(expected, 0, num_registers);
+  for (uint64_t i = 0; i < end; ++i) {
+    char bytes[8];
+    HyperLogLogElement(i, bytes);
+    HHStateT<HH_TARGET> state(key);
+    HHResult64 hash;
+    HighwayHashT(&state, bytes, sizeof(bytes), &hash);
+    uint8_t value = 1;
+    for (int bit = 63 - precision; bit >= 0 && ((hash >> bit) & 1) == 0;
+         --bit) {
+      ++value;
+    }
+    uint8_t& reg = expected[hash >> (64 - precision)];
+    reg = reg > value ? reg : value;
+  }
+  sketch.CopyRegisters(actual);
+  if (memcmp(expected, actual, num_registers) != 0) {
+    notify(TargetName(HH_TARGET), static_cast<size_t>(end));
+  }
+  delete[] actual;
+  delete[] expected;
+}
+
+void TestHyperLogLog(const HHKey& key, const HHNotify notify) {
+  using Sketch = HH_TARGET_NAME::HyperLogLog;
+  // Sparse, sparse until merged with another, and dense.
+  const uint64_t kSizes[3] = {100, 1500, 50000};
+  for (const uint64_t size0 : kSizes) {
+    Sketch sketch(key);
+    AddHyperLogLogElements(0, size0, false, &sketch);
+    VerifyHyperLogLogRegisters(key, size0, sketch, notify);
+
+    Sketch batch_sketch(key);
+    AddHyperLogLogElements(0, size0, true, &batch_sketch);
+    VerifyHyperLogLogRegisters(key, size0, batch_sketch, notify);
+
+    // Relative standard error is 0.81%; allow five times that.
+    const double error = sketch.Estimate() / size0 - 1.0;
+    if (error < -0.04 || error > 0.04 ||
+        sketch.Estimate() != batch_sketch.Estimate()) {
+      notify(TargetName(HH_TARGET), static_cast<size_t>(size0));
+    }
+
+    for (const uint64_t size1 : kSizes) {
+      Sketch other(key);
+      AddHyperLogLogElements(size0, size0 + size1, true, &other);
+      Sketch merged(key);
+      merged.Merge(sketch);
+      merged.Merge(other);
+      VerifyHyperLogLogRegisters(key, size0 + size1, merged, notify);
+      // Merging with itself has no effect.
+      merged.Merge(merged);
+      VerifyHyperLogLogRegisters(key, size0 + size1, merged, notify);
+
+      uint8_t* registers = new uint8_t[size_t(1) << sketch.Precision()];
+      other.CopyRegisters(registers);
+      Sketch restored(key);
+      restored.MergeRegisters(registers);
+      restored.Merge(sketch);
+      VerifyHyperLogLogRegisters(key, size0 + size1, restored, notify);
+      delete[] registers;
+    }
+  }
+
+  // The smallest precision is always dense.
+  Sketch small(key, Sketch::kMinPrecision);
+  AddHyperLogLogElements(0, 1000, false, &small);
+  VerifyHyperLogLogRegisters(key, 1000, small, notify);
+}
+
+// Adds shingles [begin, end) (their 8 little-endian bytes) to "sketch".
+template <class Sketch>
+void AddShingles(const uint64_t begin, const uint64_t end, Sketch* sketch) {
+  for (uint64_t i = begin; i < end; ++i) {
+    char bytes[8];
+    HyperLogLogElement(i, bytes);
+    sketch->Add(bytes, sizeof(bytes));
+  }
+}
+
+template <typename Value>
+void TestMinHashOf(const HHKey& key, const HHNotify notify) {
+  using Sketch = HH_TARGET_NAME::MinHashT<Value>;
+  const size_t kNumValues = 256;
+  const size_t kPerHash = Sketch::kValuesPerHash;
+
+  // Shingles [0, 1000) and [500, 1500): Jaccard similarity 1/3.
+  Sketch sketch_a(key, kNumValues);
+  Sketch sketch_b(key, kNumValues);
+  AddShingles(0, 1000, &sketch_a);
+  AddShingles(500, 1500, &sketch_b);
+
+  // Reference: the layout documented in minhash.h.
+  Value expected[kNumValues];
+  for (size_t i = 0; i < kNumValues; ++i) {
+    expected[i] = ~Value(0);
+  }
+  for (uint64_t shingle = 0; shingle < 1000; ++shingle) {
+    char bytes[8];
+    HyperLogLogElement(shingle, bytes);
+    for (size_t c = 0; c < kNumValues / kPerHash; ++c) {
+      HHKey derived;
+      for (int i = 0; i < 4; ++i) {
+        derived[i] = key[i] ^ (0x48484D696E480000ull + c * 4 + i);
+      }
+      HHStateT<HH_TARGET> state(derived);
+      HHResult256 hash;
+      HighwayHashT(&state, bytes, sizeof(bytes), &hash);
+      for (size_t i = 0; i < kPerHash; ++i) {
+        const size_t per_lane = 8 / sizeof(Value);
+        const Value value = static_cast<Value>(
+            hash[i / per_lane] >> ((i % per_lane) * 8 * sizeof(Value)));
+        Value& minimum = expected[c * kPerHash + i];
+        minimum = value < minimum ? value : minimum;
+      }
+    }
+  }
+  for (size_t i = 0; i < kNumValues; ++i) {
+    if (sketch_a.Values()[i] != expected[i]) {
+      notify(TargetName(HH_TARGET), sizeof(Value));
+    }
+  }
+
+  // Standard error is sqrt(1/3 * 2/3 / 256) = 0.03; b-bit is less accurate.
+  const double similarity = HH_TARGET_NAME::MinHashSimilarity(
+      sketch_a.Values(), sketch_b.Values(), kNumValues);
+  if (similarity < 1.0 / 3 - 0.12 || similarity > 1.0 / 3 + 0.12) {
+    notify(TargetName(HH_TARGET), sizeof(Value));
+  }
+  for (int bits = 1; bits <= 16; bits *= 2) {
+    uint64_t packed_a[kNumValues / 4];
+    uint64_t packed_b[kNumValues / 4];
+    HH_TARGET_NAME::BBitCompress(sketch_a.Values(), kNumValues, bits,
+                                 packed_a);
+    HH_TARGET_NAME::BBitCompress(sketch_b.Values(), kNumValues, bits,
+                                 packed_b);
+    const double bbit = HH_TARGET_NAME::BBitSimilarity(packed_a, packed_b,
+                                                       kNumValues, bits);
+    // Estimates of identical sketches are exact.
+    if (bbit < 1.0 / 3 - 0.2 || bbit > 1.0 / 3 + 0.2 ||
+        HH_TARGET_NAME::BBitSimilarity(packed_a, packed_a, kNumValues,
+                                       bits) != 1.0) {
+      notify(TargetName(HH_TARGET), bits);
+    }
+  }
+
+  // Adding the same shingles in a different order and AddBatch.
+  Sketch sketch_c(key, kNumValues);
+  StringView shingles[1000];
+  char bytes[1000][8];
+  for (size_t i = 0; i < 1000; ++i) {
+    HyperLogLogElement(999 - i, bytes[i]);
+    shingles[i] = StringView{bytes[i], 8};
+  }
+  sketch_c.AddBatch(shingles, 1000);
+  for (size_t i = 0; i < kNumValues; ++i) {
+    if (sketch_c.Values()[i] != expected[i]) {
+      notify(TargetName(HH_TARGET), sizeof(Value));
+    }
+  }
+}
+
+void TestMinHash(const HHKey& key, const HHNotify notify) {
+  TestMinHashOf<uint64_t>(key, notify);
+  TestMinHashOf<uint32_t>(key, notify);
+  TestMinHashOf<uint16_t>(key, notify);
+}
+
+// Returns the index of the highest-scoring of "num_nodes" nodes, computed as
+// documented in consistent_hash.h.
+uint32_t RendezvousReference(const HHKey& key, const uint64_t* node_ids,
+                             const size_t num_nodes, const char* bytes,
+                             const size_t size) {
+  HHStateT<HH_TARGET> state(key);
+  HHResult64 hash;
+  HighwayHashT(&state, bytes, size, &hash);
+
+  const HHKey seed_key = {key[0] ^ 0x48485365656430ull,
+                          key[1] ^ 0x48485365656431ull,
+                          key[2] ^ 0x48485365656432ull,
+                          key[3] ^ 0x48485365656433ull};
+  uint32_t best_node = 0;
+  uint64_t best_score = 0;
+  for (uint32_t node = 0; node < num_nodes; ++node) {
+    HHStateT<HH_TARGET> seed_state(seed_key);
+    HHResult64 seed;
+    HighwayHashU64T(&seed_state, node_ids[node], &seed);
+    const uint64_t score =
+        HH_TARGET_NAME::RendezvousScore(hash, seed, node);
+    if (node == 0 || score > best_score) {
+      best_score = score;
+      best_node = node;
+    }
+  }
+  return best_node;
+}
+
+void TestConsistentHash(const HHKey& key, const HHNotify notify) {
+  using HH_TARGET_NAME::JumpHash;
+  using HH_TARGET_NAME::RendezvousHash;
+  const size_t kNumKeys = 1000;
+  uint64_t key_values[kNumKeys];
+  StringView keys[kNumKeys];
+  for (size_t i = 0; i < kNumKeys; ++i) {
+    key_values[i] = i * 0x9E3779B97F4A7C15ull;
+    keys[i] = StringView{reinterpret_cast<const char*>(&key_values[i]), 8};
+  }
+
+  uint64_t node_ids[513];
+  for (size_t i = 0; i < 513; ++i) {
+    node_ids[i] = 1000 + i * 7;
+  }
+
+  uint32_t nodes[kNumKeys];
+  const size_t kNumNodes[] = {1, 3, 4, 5, 8, 64, 101, 513};
+  for (const size_t num_nodes : kNumNodes) {
+    const RendezvousHash placement(key, node_ids, num_nodes);
+    // Without the last node.
+    const RendezvousHash fewer(key, node_ids,
+                               num_nodes == 1 ? 1 : num_nodes - 1);
+    placement.PlaceBatch(keys, kNumKeys, nodes);
+
+    size_t counts[8] = {0};
+    for (size_t i = 0; i < kNumKeys; ++i) {
+      const uint32_t node = placement.Place(keys[i].data, keys[i].num_bytes);
+      if (node >= num_nodes || node != nodes[i] ||
+          (i < 100 && node != RendezvousReference(key, node_ids, num_nodes,
+                                                  keys[i].data, 8))) {
+        notify(TargetName(HH_TARGET), num_nodes);
+      }
+      if (num_nodes == 8) counts[node] += 1;
+
+      if (num_nodes != 1 && node != num_nodes - 1 &&
+          fewer.Place(keys[i].data, keys[i].num_bytes) != node) {
+        notify(TargetName(HH_TARGET), num_nodes);
+      }
+
+      const size_t num_replicas = num_nodes < 4 ? num_nodes : 4;
+      uint32_t replicas[4] = {0};
+      placement.PlaceReplicas(keys[i].data, 8, num_replicas, replicas);
+      if (replicas[0] != node) notify(TargetName(HH_TARGET), num_nodes);
+      for (size_t r = 1; r < num_replicas; ++r) {
+        for (size_t prev = 0; prev < r; ++prev) {
+          if (replicas[r] == replicas[prev] || replicas[r] >= num_nodes) {
+            notify(TargetName(HH_TARGET), num_nodes);
+          }
+        }
+      }
+    }
+
+    // Expected 125 keys per node.
+    if (num_nodes == 8) {
+      for (const size_t count : counts) {
+        if (count < 80 || count > 170) notify(TargetName(HH_TARGET), 8);
+      }
+    }
+  }
+
+  // Adding bucket n only moves keys to it. Also verifies PlaceBatch.
+  uint32_t previous[kNumKeys] = {0};
+  for (uint32_t num_buckets = 1; num_buckets <= 100; ++num_buckets) {
+    const JumpHash jump(key, num_buckets);
+    jump.PlaceBatch(keys, kNumKeys, nodes);
+    for (size_t i = 0; i < kNumKeys; ++i) {
+      if (nodes[i] != jump.Place(keys[i].data, keys[i].num_bytes) ||
+          (nodes[i] != previous[i] && nodes[i] != num_buckets - 1)) {
+        notify(TargetName(HH_TARGET), num_buckets);
+      }
+      previous[i] = nodes[i];
+    }
+  }
+}
+
+// Stores block "counter" of KeyedRandom(key, stream) as documented in
+// keyed_random.h.
+void KeyedRandomReference(const HHKey& key, const uint64_t stream,
+                          const uint64_t counter, HHResult256* block) {
+  HHKey derived;
+  for (int i = 0; i < 4; ++i) {
+    derived[i] = key[i] ^ (0x484852616E640000ull + i);
+  }
+  char packet[32] = {0};
+  for (int i = 0; i < 8; ++i) {
+    packet[i] = static_cast<char>(counter >> (i * 8));
+    packet[8 + i] = static_cast<char>(stream >> (i * 8));
+  }
+  HHStateT<HH_TARGET> state(derived);
+  HighwayHashT(&state, packet, sizeof(packet), block);
+}
+
+void TestKeyedRandom(const HHKey& key, const HHNotify notify) {
+  using HH_TARGET_NAME::KeyedRandom;
+  const size_t kNumBlocks = 37;  // not a multiple of the interleaved states
+  const uint64_t kFirst = 0xFFFFFFFFull - 5;  // crosses a 32-bit boundary
+  HHResult256 expected[kNumBlocks];
+  for (size_t i = 0; i < kNumBlocks; ++i) {
+    KeyedRandomReference(key, 7, kFirst + i, &expected[i]);
+  }
+
+  const KeyedRandom random(key, 7);
+  HHResult256 blocks[kNumBlocks];
+  for (size_t num_blocks = 0; num_blocks <= kNumBlocks; ++num_blocks) {
+    random.Generate(kFirst, num_blocks, blocks);
+    for (size_t i = 0; i < num_blocks; ++i) {
+      NotifyIfUnequal(num_blocks, expected[i], blocks[i], notify);
+    }
+  }
+
+  // Other streams differ.
+  KeyedRandom(key, 8).Generate(kFirst, 1, blocks);
+  if (blocks[0][0] == expected[0][0]) notify(TargetName(HH_TARGET), 8);
+
+  // Fill at any offset and length matches the little-endian blocks.
+  char stream_bytes[kNumBlocks * 32];
+  for (size_t i = 0; i < sizeof(stream_bytes); ++i) {
+    stream_bytes[i] = static_cast<char>(expected[i / 32][i % 32 / 8] >>
+                                        (i % 8 * 8));
+  }
+  char bytes[kNumBlocks * 32];
+  for (size_t offset = 0; offset < 70; ++offset) {
+    for (size_t size = 0; offset + size <= sizeof(bytes); size += 13) {
+      random.Fill(kFirst * 32 + offset, bytes, size);
+      if (memcmp(bytes, stream_bytes + offset, size) != 0) {
+        notify(TargetName(HH_TARGET), offset);
+      }
+    }
+  }
+
+  // Next64 reads consecutive lanes, also after Seek.
+  KeyedRandom sequential(key, 7);
+  sequential.Seek(kFirst);
+  for (size_t i = 0; i < kNumBlocks * 4; ++i) {
+    if (sequential.Next64() != expected[i / 4][i % 4]) {
+      notify(TargetName(HH_TARGET), i);
+    }
+  }
+  sequential.Seek(kFirst + 3);
+  if (sequential.Next64() != expected[3][0]) notify(TargetName(HH_TARGET), 3);
+
+  // Bounded integers are in range and roughly uniform; doubles and floats
+  // are in [0, 1) with the expected mean.
+  const size_t kNumSamples = 60000;
+  const uint32_t kBounds[] = {1, 3, 6, 1000, 0x80000001u, 0xFFFFFFFFu};
+  for (const uint32_t bound : kBounds) {
+    size_t counts[6] = {0};
+    for (size_t i = 0; i < kNumSamples; ++i) {
+      const uint32_t value = sequential.NextBounded(bound);
+      if (value >= bound) notify(TargetName(HH_TARGET), bound);
+      if (bound == 6) counts[value] += 1;
+    }
+    if (bound == 6) {
+      // Expected 10000 each; the standard deviation is about 91.
+      for (const size_t count : counts) {
+        if (count < 9500 || count > 10500) notify(TargetName(HH_TARGET), 6);
+      }
+    }
+  }
+
+  double sum_double = 0.0;
+  double sum_float = 0.0;
+  size_t num_true = 0;
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    const double d = sequential.NextDouble();
+    const float f = sequential.NextFloat();
+    if (!(d >= 0.0 && d < 1.0) || !(f >= 0.0f && f < 1.0f)) {
+      notify(TargetName(HH_TARGET), i);
+    }
+    sum_double += d;
+    sum_float += f;
+    num_true += sequential.NextBernoulli(0.25);
+  }
+  // The standard deviation of the means is about 0.0012.
+  if (sum_double / kNumSamples < 0.49 || sum_double / kNumSamples > 0.51 ||
+      sum_float / kNumSamples < 0.49 || sum_float / kNumSamples > 0.51 ||
+      num_true < 14400 || num_true > 15600) {
+    notify(TargetName(HH_TARGET), kNumSamples);
+  }
+  if (HH_TARGET_NAME::RandomToDouble(~0ull) >= 1.0 ||
+      HH_TARGET_NAME::RandomToFloat(~0u) >= 1.0f ||
+      HH_TARGET_NAME::RandomToDouble(0) != 0.0) {
+    notify(TargetName(HH_TARGET), 0);
+  }
+}
+
+// Shared logic for all HighwayHashNonTemporalTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashNonTemporal(const HHKey& key, const char* HH_RESTRICT bytes,
+                                const size_t size, const Result*,
+                                const HHNotify notify) {
+  const size_t kDistances[] = {0, 32, 64, 100, HH_PREFETCH_DISTANCE};
+  for (const size_t distance : kDistances) {
+    // All sizes around the loop boundaries, then a sparser sampling.
+    for (size_t actual_size = 0; actual_size <= size;
+         actual_size += (actual_size < 300) ? 1 : 37) {
+      HHStateT<HH_TARGET> state_non_temporal(key);
+      Result actual;
+      HighwayHashNonTemporalT(&state_non_temporal, bytes, actual_size, &actual,
+                              distance);
+      HHStateT<HH_TARGET> state(key);
+      Result expected;
+      HighwayHashT(&state, bytes, actual_size, &expected);
+      NotifyIfUnequal(actual_size, expected, actual, notify);
     }
   }
+}
 
-  delete[] results;
+// Shared logic for all HighwayHashWideTest::operator() overloads.
+template <typename Result>
+void TestHighwayHashWide(const HHKey& key, const char* HH_RESTRICT bytes,
+                         const size_t size, const Result* expected,
+                         const HHNotify notify) {
+  Result actual;
+  HighwayHashWideT<HH_TARGET>(key, bytes, size, &actual);
+  NotifyIfUnequal(size, *expected, actual, notify);
 }
 
 }  // namespace
@@ -109,8 +1410,8 @@ void HighwayHashTest<Target>::operator()(const HHKey& key,
                                          const size_t size,
                                          const HHResult64* expected,
                                          const HHNotify notify) const {
-  HHStateT<Target> state(key);
-  TestHighwayHash(&state, bytes, size, expected, notify);
+  TestHighwayHash(key, bytes, size, expected, notify);
+  TestHighwayHashBoth<HHResult64, HHResult128>(key, bytes, size, notify);
 }
 
 template <TargetBits Target>
@@ -119,8 +1420,8 @@ void HighwayHashTest<Target>::operator()(const HHKey& key,
                                          const size_t size,
                                          const HHResult128* expected,
                                          const HHNotify notify) const {
-  HHStateT<Target> state(key);
-  TestHighwayHash(&state, bytes, size, expected, notify);
+  TestHighwayHash(key, bytes, size, expected, notify);
+  TestHighwayHashBoth<HHResult128, HHResult256>(key, bytes, size, notify);
 }
 
 template <TargetBits Target>
@@ -129,8 +1430,7 @@ void HighwayHashTest<Target>::operator()(const HHKey& key,
                                          const size_t size,
                                          const HHResult256* expected,
                                          const HHNotify notify) const {
-  HHStateT<Target> state(key);
-  TestHighwayHash(&state, bytes, size, expected, notify);
+  TestHighwayHash(key, bytes, size, expected, notify);
 }
 
 template <TargetBits Target>
@@ -160,9 +1460,440 @@ void HighwayHashCatTest<Target>::operator()(const HHKey& key,
   TestHighwayHashCat(key, bytes, size, expected, notify);
 }
 
+template <TargetBits Target>
+void HighwayHashSerializeTest<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const uint64_t size,
+    const HHCatSnapshot* snapshots, const HHNotify notify) const {
+  HHResult64 expected64;
+  HHResult128 expected128;
+  HHResult256 expected256;
+  HHStateT<HH_TARGET> state(key);
+  HighwayHashT(&state, bytes, size, &expected64);
+  state.Reset(key);
+  HighwayHashT(&state, bytes, size, &expected128);
+  state.Reset(key);
+  HighwayHashT(&state, bytes, size, &expected256);
+
+  // Deserialize must not depend on this key.
+  const HHKey other_key = {1, 2, 3, 4};
+  for (size_t split = 0; split <= size; ++split) {
+    // Two fragments, so that the second Append starts with a partial buffer.
+    HighwayHashCatT<HH_TARGET> cat(key);
+    cat.Append(bytes, split / 2);
+    cat.Append(bytes + split / 2, split - split / 2);
+    HHCatSnapshot snapshot;
+    cat.Serialize(&snapshot);
+    for (size_t i = 0; i < sizeof(snapshot.bytes); ++i) {
+      if (snapshot.bytes[i] != snapshots[split].bytes[i]) {
+        (*notify)(TargetName(HH_TARGET), split);
+      }
+    }
+
+    HighwayHashCatT<HH_TARGET> resumed(other_key);
+    if (!resumed.Deserialize(snapshots[split])) {
+      (*notify)(TargetName(HH_TARGET), split);
+    }
+    resumed.Append(bytes + split, size - split);
+    HHResult64 actual64;
+    HHResult128 actual128;
+    HHResult256 actual256;
+    resumed.Finalize(&actual64);
+    resumed.Finalize(&actual128);
+    resumed.Finalize(&actual256);
+    NotifyIfUnequal(split, expected64, actual64, notify);
+    NotifyIfUnequal(split, expected128, actual128, notify);
+    NotifyIfUnequal(split, expected256, actual256, notify);
+
+    // Invalid snapshots are rejected without changing the state.
+    snapshot.bytes[3] = 0;  // version
+    if (resumed.Deserialize(snapshot)) {
+      (*notify)(TargetName(HH_TARGET), split);
+    }
+    resumed.Finalize(&actual64);
+    NotifyIfUnequal(split, expected64, actual64, notify);
+  }
+}
+
+template <TargetBits Target>
+void HighwayHashBatchTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult64* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashBatch(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashBatchTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult128* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashBatch(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashBatchTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult256* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashBatch(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void SipHashBatchTest<Target>::operator()(const char* HH_RESTRICT bytes,
+                                          const size_t size,
+                                          const HHNotify notify) const {
+  const HH_U64 key[2] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL};
+
+  // Ascending sizes, then descending, then each size repeated as often as
+  // there are lanes (up to 8), so that groups of lanes contain messages of
+  // similar, very different and equal sizes. The start offsets also vary.
+  const size_t kMaxLanes = 8;
+  const size_t num_messages = (2 + kMaxLanes) * (size + 1);
+  StringView* messages = new StringView[num_messages];
+  for (size_t i = 0; i <= size; ++i) {
+    messages[i].data = bytes + size - i;
+    messages[i].num_bytes = i;
+    messages[2 * (size + 1) - 1 - i].data = bytes;
+    messages[2 * (size + 1) - 1 - i].num_bytes = i;
+    for (size_t lane = 0; lane < kMaxLanes; ++lane) {
+      StringView* message = &messages[2 * (size + 1) + i * kMaxLanes + lane];
+      const size_t offset = lane < size ? lane : size;
+      message->data = bytes + offset;
+      message->num_bytes = i < size - offset ? i : size - offset;
+    }
+  }
+
+  HH_U64* hashes = new HH_U64[num_messages];
+  // The last group of lanes may be incomplete.
+  for (size_t count = num_messages - kMaxLanes; count <= num_messages;
+       ++count) {
+    TestSipHashBatchCount<2, 4>(key, messages, count, hashes, notify);
+    TestSipHashBatchCount<1, 3>(key, messages, count, hashes, notify);
+  }
+
+  delete[] hashes;
+  delete[] messages;
+}
+
+template <TargetBits Target>
+void HighwayHashFixedTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult64* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashFixed(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashFixedTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult128* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashFixed(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashFixedTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const uint64_t size,
+                                              const HHResult256* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashFixed(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashShortTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const size_t size,
+                                              const HHResult64* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashShort(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashShortTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const size_t size,
+                                              const HHResult128* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashShort(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashShortTest<Target>::operator()(const HHKey& key,
+                                              const char* HH_RESTRICT bytes,
+                                              const size_t size,
+                                              const HHResult256* expected,
+                                              const HHNotify notify) const {
+  TestHighwayHashShort(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashPaddedTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT,
+                                               const size_t,
+                                               const HHResult64* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashPadded(key, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashPaddedTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT,
+                                               const size_t,
+                                               const HHResult128* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashPadded(key, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashPaddedTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT,
+                                               const size_t,
+                                               const HHResult256* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashPadded(key, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashCopyTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult64* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashCopy(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashCopyTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult128* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashCopy(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashCopyTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult256* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashCopy(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashValuesTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult64* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashValues(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashValuesTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult128* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashValues(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashValuesTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult256* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashValues(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashVerifyTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult64* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashVerify(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashVerifyTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult128* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashVerify(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashVerifyTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHResult256* expected,
+                                               const HHNotify notify) const {
+  TestHighwayHashVerify(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsetsTest<Target>::operator()(const HHKey& key,
+                                                const char* HH_RESTRICT bytes,
+                                                const size_t size,
+                                                const HHResult64* expected,
+                                                const HHNotify notify) const {
+  TestHighwayHashOffsets(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsetsTest<Target>::operator()(const HHKey& key,
+                                                const char* HH_RESTRICT bytes,
+                                                const size_t size,
+                                                const HHResult128* expected,
+                                                const HHNotify notify) const {
+  TestHighwayHashOffsets(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashOffsetsTest<Target>::operator()(const HHKey& key,
+                                                const char* HH_RESTRICT bytes,
+                                                const size_t size,
+                                                const HHResult256* expected,
+                                                const HHNotify notify) const {
+  TestHighwayHashOffsets(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashSampleTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHNotify notify) const {
+  TestHighwayHashSample(key, bytes, size, notify);
+}
+
+template <TargetBits Target>
+void BloomFilterTest<Target>::operator()(const HHKey& key,
+                                         const char* HH_RESTRICT bytes,
+                                         const size_t size,
+                                         const HHNotify notify) const {
+  TestBloomFilter(key, bytes, size, notify);
+}
+
+template <TargetBits Target>
+void CuckooFilterTest<Target>::operator()(const HHKey& key,
+                                          const char* HH_RESTRICT bytes,
+                                          const size_t size,
+                                          const HHNotify notify) const {
+  TestCuckooFilter(key, bytes, size, notify);
+}
+
+template <TargetBits Target>
+void ConcurrentHashSetTest<Target>::operator()(const HHKey& key,
+                                               const char* HH_RESTRICT bytes,
+                                               const size_t size,
+                                               const HHNotify notify) const {
+  TestConcurrentHashSet(key, bytes, size, notify);
+}
+
+template <TargetBits Target>
+void HyperLogLogTest<Target>::operator()(const HHKey& key,
+                                         const HHNotify notify) const {
+  TestHyperLogLog(key, notify);
+}
+
+template <TargetBits Target>
+void MinHashTest<Target>::operator()(const HHKey& key,
+                                     const HHNotify notify) const {
+  TestMinHash(key, notify);
+}
+
+template <TargetBits Target>
+void ConsistentHashTest<Target>::operator()(const HHKey& key,
+                                            const HHNotify notify) const {
+  TestConsistentHash(key, notify);
+}
+
+template <TargetBits Target>
+void KeyedRandomTest<Target>::operator()(const HHKey& key,
+                                         const HHNotify notify) const {
+  TestKeyedRandom(key, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporalTest<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    const HHResult64* expected, const HHNotify notify) const {
+  TestHighwayHashNonTemporal(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporalTest<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    const HHResult128* expected, const HHNotify notify) const {
+  TestHighwayHashNonTemporal(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashNonTemporalTest<Target>::operator()(
+    const HHKey& key, const char* HH_RESTRICT bytes, const size_t size,
+    const HHResult256* expected, const HHNotify notify) const {
+  TestHighwayHashNonTemporal(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashWideTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult64* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashWide(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashWideTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult128* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashWide(key, bytes, size, expected, notify);
+}
+
+template <TargetBits Target>
+void HighwayHashWideTest<Target>::operator()(const HHKey& key,
+                                             const char* HH_RESTRICT bytes,
+                                             const size_t size,
+                                             const HHResult256* expected,
+                                             const HHNotify notify) const {
+  TestHighwayHashWide(key, bytes, size, expected, notify);
+}
+
 // Instantiate for the current target.
 template struct HighwayHashTest<HH_TARGET>;
 template struct HighwayHashCatTest<HH_TARGET>;
+template struct HighwayHashSerializeTest<HH_TARGET>;
+template struct HighwayHashBatchTest<HH_TARGET>;
+template struct SipHashBatchTest<HH_TARGET>;
+template struct HighwayHashFixedTest<HH_TARGET>;
+template struct HighwayHashShortTest<HH_TARGET>;
+template struct HighwayHashPaddedTest<HH_TARGET>;
+template struct HighwayHashCopyTest<HH_TARGET>;
+template struct HighwayHashValuesTest<HH_TARGET>;
+template struct HighwayHashVerifyTest<HH_TARGET>;
+template struct HighwayHashOffsetsTest<HH_TARGET>;
+template struct HighwayHashNonTemporalTest<HH_TARGET>;
+template struct HighwayHashWideTest<HH_TARGET>;
+template struct HighwayHashSampleTest<HH_TARGET>;
+template struct BloomFilterTest<HH_TARGET>;
+template struct CuckooFilterTest<HH_TARGET>;
+template struct ConcurrentHashSetTest<HH_TARGET>;
+template struct HyperLogLogTest<HH_TARGET>;
+template struct MinHashTest<HH_TARGET>;
+template struct ConsistentHashTest<HH_TARGET>;
+template struct KeyedRandomTest<HH_TARGET>;
 
 //-----------------------------------------------------------------------------
 // benchmark
@@ -194,6 +1925,211 @@ uint64_t RunHighwayCat(const void*, const size_t size) {
   return result;
 }
 
+template <TargetBits Target>
+uint64_t RunHighwayWide(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  char in[kMaxBenchmarkInputSize];
+  in[0] = static_cast<char>(size & 0xFF);
+  HHResult64 result;
+  HighwayHashWideT<Target>(key, in, size, &result);
+  return result;
+}
+
+// Both variants hash the same kBenchmarkBatchSize messages, which start at
+// consecutive offsets so that they differ, and store their results.
+struct BatchBenchmarkInput {
+  explicit BatchBenchmarkInput(const size_t size) {
+    in[0] = static_cast<char>(size & 0xFF);
+    for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+      messages[i].data = in + i;
+      messages[i].num_bytes = size;
+    }
+  }
+
+  HHResult64 Sum() const {
+    HHResult64 sum = 0;
+    for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+      sum += results[i];
+    }
+    return sum;
+  }
+
+  char in[kMaxBenchmarkInputSize + kBenchmarkBatchSize];
+  StringView messages[kBenchmarkBatchSize];
+  HHResult64 results[kBenchmarkBatchSize];
+};
+
+template <TargetBits Target>
+uint64_t RunHighwayLoop(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  BatchBenchmarkInput batch(size);
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    HHStateT<Target> state(key);
+    HighwayHashT(&state, batch.messages[i].data, batch.messages[i].num_bytes,
+                 &batch.results[i]);
+  }
+  return batch.Sum();
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayBatch(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  BatchBenchmarkInput batch(size);
+  HighwayHashBatchT<Target>(key, batch.messages, kBenchmarkBatchSize,
+                            batch.results);
+  return batch.Sum();
+}
+
+template <int kUpdateIters, int kFinalizeIters>
+uint64_t RunSipLoop(const void*, const size_t size) {
+  static const HH_U64 key[2] = {0, 1};
+  BatchBenchmarkInput batch(size);
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    SipHashStateT<kUpdateIters, kFinalizeIters,
+                  HH_TARGET_NAME::SipHashBatchTag> state(key);
+    UpdateState(batch.messages[i].data, batch.messages[i].num_bytes, &state);
+    batch.results[i] = state.Finalize();
+  }
+  return batch.Sum();
+}
+
+template <int kUpdateIters, int kFinalizeIters>
+uint64_t RunSipBatch(const void*, const size_t size) {
+  static const HH_U64 key[2] = {0, 1};
+  BatchBenchmarkInput batch(size);
+  HH_U64 hashes[kBenchmarkBatchSize];
+  HH_TARGET_NAME::SipHashBatchT<kUpdateIters, kFinalizeIters>(
+      key, batch.messages, kBenchmarkBatchSize, hashes);
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    batch.results[i] = hashes[i];
+  }
+  return batch.Sum();
+}
+
+// (Not inlined into the switch in RunHighwayFixed; that was 1.5-2x slower,
+// presumably because the five loops then share one register allocation.)
+template <TargetBits Target, size_t kSize>
+HH_NOINLINE void HashFixedBatch(BatchBenchmarkInput* batch) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    HHStateT<Target> state(key);
+    HighwayHashFixedT<kSize>(&state, batch->messages[i].data,
+                             &batch->results[i]);
+  }
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayFixed(const void*, const size_t size) {
+  BatchBenchmarkInput batch(size);
+  switch (size) {
+    case 8:
+      HashFixedBatch<Target, 8>(&batch);
+      break;
+    case 16:
+      HashFixedBatch<Target, 16>(&batch);
+      break;
+    case 24:
+      HashFixedBatch<Target, 24>(&batch);
+      break;
+    case 32:
+      HashFixedBatch<Target, 32>(&batch);
+      break;
+    case 64:
+      HashFixedBatch<Target, 64>(&batch);
+      break;
+  }
+  return batch.Sum();
+}
+
+// The messages of "batch" are followed by at least 32 readable bytes because
+// "in" is larger than the input size plus the offsets.
+template <TargetBits Target>
+void HashShortBatch(BatchBenchmarkInput* batch) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    HHStateT<Target> state(key);
+    HighwayHashShortT(&state, batch->messages[i].data,
+                      batch->messages[i].num_bytes, &batch->results[i]);
+  }
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayShort(const void*, const size_t size) {
+  BatchBenchmarkInput batch(size);
+  HashShortBatch<Target>(&batch);
+  return batch.Sum();
+}
+
+// Sets the message sizes to a fixed pseudo-random sequence in [1, size], so
+// that the size-dependent branches are hard to predict.
+void MixSizes(const size_t size, BatchBenchmarkInput* batch) {
+  uint32_t bits = 0x12345678u;
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    bits = bits * 1103515245u + 12345u;
+    batch->messages[i].num_bytes = 1 + (bits >> 16) % size;
+  }
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayLoopMixed(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  BatchBenchmarkInput batch(size);
+  MixSizes(size, &batch);
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    HHStateT<Target> state(key);
+    HighwayHashT(&state, batch.messages[i].data, batch.messages[i].num_bytes,
+                 &batch.results[i]);
+  }
+  return batch.Sum();
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayShortMixed(const void*, const size_t size) {
+  BatchBenchmarkInput batch(size);
+  MixSizes(size, &batch);
+  HashShortBatch<Target>(&batch);
+  return batch.Sum();
+}
+
+// Both variants hash the same kBenchmarkBatchSize fragments, which are not
+// contiguous.
+struct FragmentsBenchmarkInput {
+  explicit FragmentsBenchmarkInput(const size_t size) {
+    in[0] = static_cast<char>(size & 0xFF);
+    for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+      fragments[i].data = in + i * (kMaxBenchmarkFragmentSize + 8);
+      fragments[i].num_bytes = size;
+    }
+  }
+
+  char in[kBenchmarkBatchSize * (kMaxBenchmarkFragmentSize + 8)];
+  StringView fragments[kBenchmarkBatchSize];
+};
+
+template <TargetBits Target>
+uint64_t RunHighwayCatAppend(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  FragmentsBenchmarkInput input(size);
+  HH_ALIGNAS(64) HighwayHashCatT<Target> cat(key);
+  for (size_t i = 0; i < kBenchmarkBatchSize; ++i) {
+    cat.Append(input.fragments[i].data, input.fragments[i].num_bytes);
+  }
+  HHResult64 result;
+  cat.Finalize(&result);
+  return result;
+}
+
+template <TargetBits Target>
+uint64_t RunHighwayCatFragments(const void*, const size_t size) {
+  HH_ALIGNAS(32) static const HHKey key = {0, 1, 2, 3};
+  FragmentsBenchmarkInput input(size);
+  HH_ALIGNAS(64) HighwayHashCatT<Target> cat(key);
+  cat.AppendFragments(input.fragments, input.fragments + kBenchmarkBatchSize);
+  HHResult64 result;
+  cat.Finalize(&result);
+  return result;
+}
+
 }  // namespace
 
 template <TargetBits Target>
@@ -212,9 +2148,96 @@ void HighwayHashCatBenchmark<Target>::operator()(DurationsForInputs* input_map,
   notify("HighwayHashCat", TargetName(Target), input_map, context);
 }
 
+template <TargetBits Target>
+void HighwayHashWideBenchmark<Target>::operator()(
+    DurationsForInputs* input_map, NotifyBenchmark notify,
+    void* context) const {
+  MeasureDurations(&RunHighwayWide<Target>, input_map);
+  notify("HighwayHashWide", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void HighwayHashBatchBenchmark<Target>::operator()(
+    DurationsForInputs* input_map, NotifyBenchmark notify,
+    void* context) const {
+  MeasureDurations(&RunHighwayLoop<Target>, input_map);
+  notify("HighwayHashLoop", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayBatch<Target>, input_map);
+  notify("HighwayHashBatch", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void SipHashBatchBenchmark<Target>::operator()(DurationsForInputs* input_map,
+                                               NotifyBenchmark notify,
+                                               void* context) const {
+  MeasureDurations(&RunSipLoop<2, 4>, input_map);
+  notify("SipHashLoop", TargetName(Target), input_map, context);
+  MeasureDurations(&RunSipBatch<2, 4>, input_map);
+  notify("SipHashBatch", TargetName(Target), input_map, context);
+  MeasureDurations(&RunSipLoop<1, 3>, input_map);
+  notify("SipHash13Loop", TargetName(Target), input_map, context);
+  MeasureDurations(&RunSipBatch<1, 3>, input_map);
+  notify("SipHash13Batch", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void HighwayHashFixedBenchmark<Target>::operator()(
+    DurationsForInputs* input_map, NotifyBenchmark notify,
+    void* context) const {
+  MeasureDurations(&RunHighwayLoop<Target>, input_map);
+  notify("HighwayHashLoop", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayFixed<Target>, input_map);
+  notify("HighwayHashFixed", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void HighwayHashShortBenchmark<Target>::operator()(
+    DurationsForInputs* input_map, NotifyBenchmark notify,
+    void* context) const {
+  MeasureDurations(&RunHighwayLoop<Target>, input_map);
+  notify("HighwayHashLoop", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayShort<Target>, input_map);
+  notify("HighwayHashShort", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayLoopMixed<Target>, input_map);
+  notify("HighwayHashLoopMixed", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayShortMixed<Target>, input_map);
+  notify("HighwayHashShortMixed", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void HighwayHashFragmentsBenchmark<Target>::operator()(
+    DurationsForInputs* input_map, NotifyBenchmark notify,
+    void* context) const {
+  MeasureDurations(&RunHighwayCatAppend<Target>, input_map);
+  notify("HighwayHashCatAppend", TargetName(Target), input_map, context);
+  MeasureDurations(&RunHighwayCatFragments<Target>, input_map);
+  notify("HighwayHashCatFragments", TargetName(Target), input_map, context);
+}
+
+template <TargetBits Target>
+void HighwayHashMessagesBenchmark<Target>::operator()(
+    const HHKey& key, const StringView* HH_RESTRICT messages,
+    const size_t num_messages, HHResult64* HH_RESTRICT sum) const {
+  HHResult64 total = 0;
+  for (size_t i = 0; i < num_messages; ++i) {
+    HHStateT<Target> state(key);
+    HHResult64 result;
+    HighwayHashT(&state, messages[i].data, messages[i].num_bytes, &result);
+    total += result;
+  }
+  *sum = total;
+}
+
 // Instantiate for the current target.
 template struct HighwayHashBenchmark<HH_TARGET>;
 template struct HighwayHashCatBenchmark<HH_TARGET>;
+template struct HighwayHashWideBenchmark<HH_TARGET>;
+template struct HighwayHashBatchBenchmark<HH_TARGET>;
+template struct SipHashBatchBenchmark<HH_TARGET>;
+template struct HighwayHashFixedBenchmark<HH_TARGET>;
+template struct HighwayHashShortBenchmark<HH_TARGET>;
+template struct HighwayHashFragmentsBenchmark<HH_TARGET>;
+template struct HighwayHashMessagesBenchmark<HH_TARGET>;
 
 }  // namespace highwayhash
 #endif  // HH_DISABLE_TARGET_SPECIFIC
@@ -33,7 +33,9 @@
 
 namespace highwayhash {
 
-// Verifies the hash result matches "expected" and calls "notify" if not.
+// Verifies the hash result matches "expected" (also when computed together
+// with the next wider result), that HighwayHashMultiKeyT matches separate
+// hashes, and calls "notify" if not.
 template <TargetBits Target>
 struct HighwayHashTest {
   void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
@@ -64,6 +66,282 @@ struct HighwayHashCatTest {
                   const HHNotify notify) const;
 };
 
+// Verifies HighwayHashCatT::Serialize after appending the first i bytes
+// results in "snapshots[i]" (e.g. from another target) for all i <= "size",
+// and that resuming from each snapshot via Deserialize and appending the
+// remaining bytes returns the same hashes as HighwayHashT. Calls "notify" if
+// not.
+template <TargetBits Target>
+struct HighwayHashSerializeTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHCatSnapshot* snapshots,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashBatchT returns the same results as HighwayHashT of each
+// message for batches of messages with all sizes up to "size", in various
+// orders, and calls "notify" if not. The value of "expected" is ignored; it is
+// only used for overloading.
+template <TargetBits Target>
+struct HighwayHashBatchTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies SipHashBatchT returns the same results as SipHash and SipHash13 of
+// each message for batches of messages with all sizes up to "size", in various
+// orders and with all possible numbers of messages in the last group of lanes,
+// and calls "notify" if not.
+template <TargetBits Target>
+struct SipHashBatchTest {
+  void operator()(const char* HH_RESTRICT bytes, const size_t size,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashFixedT returns the same results as HighwayHashT for
+// sizes 0..64 and several larger sizes (all at most "size"), and calls
+// "notify" if not. The value of "expected" is ignored; it is only used for
+// overloading.
+template <TargetBits Target>
+struct HighwayHashFixedTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const uint64_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashShortT returns the same results as HighwayHashT for
+// sizes 0..32 at all offsets within the first 32 bytes (which requires
+// "size" >= 64) and calls "notify" if not. The bytes after each input differ
+// from those of the next offset. "expected" is only used for overloading.
+template <TargetBits Target>
+struct HighwayHashShortTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashPaddedT and HighwayHashCatT::AppendPadded return the
+// same results as HighwayHashT (also if the input is split into two fragments)
+// for sizes 0..kMaxPaddedTestSize at offsets 0..31, with 32 bytes of 0xFF
+// padding after each input, and calls "notify" if not. "bytes" and "size" are
+// unused, and "expected" is only used for overloading.
+constexpr size_t kMaxPaddedTestSize = 100;
+
+template <TargetBits Target>
+struct HighwayHashPaddedTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Largest "size" for HighwayHashCopyTest.
+constexpr size_t kMaxCopyTestSize = 256;
+
+// Verifies HighwayHashCopyT and HighwayHashCatT::AppendCopy (of the input
+// split into two fragments at several positions) return the same results as
+// HighwayHashT for sizes 0..size, and copy the input exactly without writing
+// past its end. Calls "notify" if not. "expected" is only used for
+// overloading.
+template <TargetBits Target>
+struct HighwayHashCopyTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashValuesT, HighwayHashU64T and HighwayHashU32T return the
+// same results as HighwayHashT of the little-endian bytes of each value, for
+// the 8 and 4-byte values loaded from "bytes" (of length "size") and all
+// counts up to that number, and calls "notify" if not. "expected" is only used
+// for overloading.
+template <TargetBits Target>
+struct HighwayHashValuesTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashVerifyT flags exactly the tags of messages from "bytes"
+// (of length "size") in which a bit was flipped, for various numbers of
+// messages, and calls "notify" if not. "expected" is only used for
+// overloading.
+template <TargetBits Target>
+struct HighwayHashVerifyTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashOffsetsT returns the same results as HighwayHashT of each
+// string (or zero if null), for int32_t and int64_t offsets that split "bytes"
+// (of length "size") into strings of various lengths, with and without a
+// validity bitmap, and calls "notify" if not. "expected" is only used for
+// overloading.
+template <TargetBits Target>
+struct HighwayHashOffsetsTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies HighwayHashSampleValuesT and HighwayHashSampleOffsetsT select
+// exactly the rows whose HighwayHashValuesT/OffsetsT hash is below various
+// thresholds, for values and strings from "bytes" (of length "size"), and
+// that HHSelectionFromBits lists them. Calls "notify" if not.
+template <TargetBits Target>
+struct HighwayHashSampleTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHNotify notify) const;
+};
+
+// Verifies HighwayHashNonTemporalT returns the same results as HighwayHashT
+// for sizes up to "size" and several prefetch distances, including ones
+// shorter than a cache line, and calls "notify" if not. "expected" is only
+// used for overloading.
+template <TargetBits Target>
+struct HighwayHashNonTemporalTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies the HighwayHashWideT result matches "expected" and calls "notify"
+// if not.
+template <TargetBits Target>
+struct HighwayHashWideTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult64* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult128* expected,
+                  const HHNotify notify) const;
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHResult256* expected,
+                  const HHNotify notify) const;
+};
+
+// Verifies BloomFilter stores the same bits as a scalar reference for all
+// targets, reports every inserted key (a substring of "bytes", which has
+// length "size") as present, and that the batch functions return the same
+// results as Insert/MayContain. Calls "notify" if not.
+template <TargetBits Target>
+struct BloomFilterTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHNotify notify) const;
+};
+
+// Verifies CuckooFilter stores each inserted key (a substring of "bytes",
+// which has length "size") in one of the buckets documented in
+// cuckoo_filter.h for all targets, including after the filter became full,
+// that the batch functions agree with Insert/MayContain and that erasing all
+// keys empties the filter. Calls "notify" if not.
+template <TargetBits Target>
+struct CuckooFilterTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHNotify notify) const;
+};
+
+// Verifies ConcurrentHashSet stores each inserted key (a substring of
+// "bytes", which has length "size") in the probe sequence documented in
+// concurrent_hash_set.h, reports duplicates, agrees with the batch functions
+// and stops inserting when full until cleared. Calls "notify" if not.
+template <TargetBits Target>
+struct ConcurrentHashSetTest {
+  void operator()(const HHKey& key, const char* HH_RESTRICT bytes,
+                  const size_t size, const HHNotify notify) const;
+};
+
+// Verifies HyperLogLog has the same registers as a scalar reference for all
+// targets, regardless of the representation, AddBatch or merging, and that
+// its estimates are within a few standard errors. Calls "notify" with the
+// number of elements if not.
+template <TargetBits Target>
+struct HyperLogLogTest {
+  void operator()(const HHKey& key, const HHNotify notify) const;
+};
+
+// Verifies MinHash16/32/64 have the same values as a scalar reference for all
+// targets, that their similarity estimates and those of the b-bit compressed
+// sketches are close to the actual Jaccard similarity, and calls "notify"
+// with the number of values if not.
+template <TargetBits Target>
+struct MinHashTest {
+  void operator()(const HHKey& key, const HHNotify notify) const;
+};
+
+// Verifies RendezvousHash matches a scalar reference for all targets, that
+// PlaceReplicas and PlaceBatch agree with Place, and that removing a node or
+// adding a JumpHash bucket only moves the keys on it; calls "notify" with the
+// number of nodes if not.
+template <TargetBits Target>
+struct ConsistentHashTest {
+  void operator()(const HHKey& key, const HHNotify notify) const;
+};
+
+// Verifies KeyedRandom blocks match HighwayHash256 of the documented packets
+// for all targets, that Fill and Next64 return the same stream at any
+// position, and that the bounded integers and floating-point values are in
+// range and roughly uniform; calls "notify" (with a size) if not.
+template <TargetBits Target>
+struct KeyedRandomTest {
+  void operator()(const HHKey& key, const HHNotify notify) const;
+};
+
 // Called by benchmark with prefix, target_name, input_map, context.
 // This function must set input_map->num_items to 0.
 using NotifyBenchmark = void (*)(const char*, const char*, DurationsForInputs*,
@@ -85,6 +363,79 @@ struct HighwayHashCatBenchmark {
                   void* context) const;
 };
 
+template <TargetBits Target>
+struct HighwayHashWideBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Number of messages hashed per measurement by HighwayHashBatchBenchmark.
+constexpr size_t kBenchmarkBatchSize = 64;
+
+// Measures the time to hash kBenchmarkBatchSize messages of the input size,
+// first with one HighwayHashT call per message (prefix "HighwayHashLoop") and
+// then with HighwayHashBatchT (prefix "HighwayHashBatch"), and calls "notify"
+// after each.
+template <TargetBits Target>
+struct HighwayHashBatchBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Measures the time to hash kBenchmarkBatchSize messages of the input size,
+// first with one SipHash call per message (prefix "SipHashLoop") and then with
+// SipHashBatchT (prefix "SipHashBatch"), then likewise for SipHash13, and
+// calls "notify" after each.
+template <TargetBits Target>
+struct SipHashBatchBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Measures the time to hash kBenchmarkBatchSize messages of the input size
+// (8, 16, 24, 32 or 64) with HighwayHashT (prefix "HighwayHashLoop") and with
+// HighwayHashFixedT (prefix "HighwayHashFixed"), and calls "notify" after
+// each.
+template <TargetBits Target>
+struct HighwayHashFixedBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Measures the time to hash kBenchmarkBatchSize messages of the input size
+// (at most 32) with HighwayHashT (prefix "HighwayHashLoop") and with
+// HighwayHashShortT (prefix "HighwayHashShort"), then likewise for messages
+// whose sizes vary pseudo-randomly between 1 and the input size (suffix
+// "Mixed"), and calls "notify" after each.
+template <TargetBits Target>
+struct HighwayHashShortBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Largest fragment size for HighwayHashFragmentsBenchmark.
+constexpr size_t kMaxBenchmarkFragmentSize = 64;
+
+// Measures the time to hash kBenchmarkBatchSize separate fragments of the
+// input size, first with one HighwayHashCatT::Append call per fragment (prefix
+// "HighwayHashCatAppend") and then with AppendFragments (prefix
+// "HighwayHashCatFragments"), and calls "notify" after each.
+template <TargetBits Target>
+struct HighwayHashFragmentsBenchmark {
+  void operator()(DurationsForInputs* input_map, NotifyBenchmark notify,
+                  void* context) const;
+};
+
+// Hashes each of "messages" with HighwayHashT in order and stores the sum of
+// their 64-bit hashes in "sum". Unlike the benchmarks above, the caller
+// measures the entire loop, e.g. to include branch mispredictions caused by
+// message sizes that vary from one call to the next.
+template <TargetBits Target>
+struct HighwayHashMessagesBenchmark {
+  void operator()(const HHKey& key, const StringView* HH_RESTRICT messages,
+                  const size_t num_messages, HHResult64* HH_RESTRICT sum) const;
+};
+
 }  // namespace highwayhash
 
 #endif  // HIGHWAYHASH_HIGHWAYHASH_TEST_TARGET_H_
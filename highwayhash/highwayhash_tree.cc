@@ -0,0 +1,156 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "highwayhash/highwayhash_tree.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/os_specific.h"
+
+namespace highwayhash {
+namespace {
+
+// Leaves are passed to HighwayHashBatch in groups of this many, which
+// interleaves their dependency chains.
+const uint32_t kLeavesPerBatch = 16;
+
+// Stores "key" with a different tweak xor-ed into each lane, so that leaf
+// and parent hashes are independent of each other and of HighwayHash.
+void DeriveKey(const HHKey& key, const uint64_t tweak, HHKey* derived) {
+  for (int i = 0; i < 4; ++i) {
+    (*derived)[i] = key[i] ^ (tweak + i);
+  }
+}
+
+// Derivation tweaks for version 1: "HHTree1L" and "HHTree1P" in ASCII.
+const uint64_t kLeafTweak = 0x484854726565314Cull;
+const uint64_t kParentTweak = 0x4848547265653150ull;
+
+// Stores the hashes of leaves [begin, end) in "leaves".
+void HashLeaves(const HighwayHashFunctions& functions, const HHKey& leaf_key,
+                const char* HH_RESTRICT bytes, const size_t size,
+                const uint32_t begin, const uint32_t end,
+                HHResult256* HH_RESTRICT leaves) {
+  StringView views[kLeavesPerBatch];
+  for (uint32_t first = begin; first < end; first += kLeavesPerBatch) {
+    const uint32_t count = std::min(end - first, kLeavesPerBatch);
+    for (uint32_t i = 0; i < count; ++i) {
+      const size_t offset = (first + i) * kHighwayTreeHashLeafSize;
+      views[i].data = bytes + offset;
+      views[i].num_bytes = std::min(size - offset, kHighwayTreeHashLeafSize);
+    }
+    functions.batch256(leaf_key, views, count, leaves + first);
+  }
+}
+
+// Overloads for the exact HighwayHashFunctions member for each Result.
+void HashParent(const HighwayHashFunctions& functions, const HHKey& key,
+                const char* HH_RESTRICT bytes, const size_t size,
+                HHResult64* HH_RESTRICT hash) {
+  functions.hash64(key, bytes, size, hash);
+}
+void HashParent(const HighwayHashFunctions& functions, const HHKey& key,
+                const char* HH_RESTRICT bytes, const size_t size,
+                HHResult128* HH_RESTRICT hash) {
+  functions.hash128(key, bytes, size, hash);
+}
+void HashParent(const HighwayHashFunctions& functions, const HHKey& key,
+                const char* HH_RESTRICT bytes, const size_t size,
+                HHResult256* HH_RESTRICT hash) {
+  functions.hash256(key, bytes, size, hash);
+}
+
+template <typename Result>
+void TreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+              const size_t size, ThreadPool* pool,
+              Result* HH_RESTRICT hash) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+
+  // (An empty input still has one (empty) leaf.)
+  const size_t num_leaves64 =
+      size == 0 ? 1
+                : (size + kHighwayTreeHashLeafSize - 1) /
+                      kHighwayTreeHashLeafSize;
+  const uint32_t num_leaves = static_cast<uint32_t>(num_leaves64);
+  DATA_PARALLEL_CHECK(num_leaves == num_leaves64);
+
+  HHKey leaf_key;
+  DeriveKey(key, kLeafTweak, &leaf_key);
+  std::vector<HHResult256> leaves(num_leaves);
+  if (pool == nullptr) {
+    HashLeaves(functions, leaf_key, bytes, size, 0, num_leaves, leaves.data());
+  } else {
+    // RunRanges splits independently of the number of threads, but the
+    // result would be the same regardless because leaves are independent.
+    const auto hash_leaves = [&functions, &leaf_key, bytes, size, &leaves](
+                                 const int /*chunk*/, const uint32_t begin,
+                                 const uint32_t end) {
+      HashLeaves(functions, leaf_key, bytes, size, begin, end, leaves.data());
+    };
+    if (pool->placement() == ThreadPool::Placement::kNone) {
+      pool->RunRanges(0, num_leaves, hash_leaves);
+    } else {
+      // Hash each range on the node where its input resides.
+      pool->RunRangesOnNodes(0, num_leaves,
+                             [bytes](const uint32_t leaf) {
+                               return NodeOfAddress(
+                                   bytes + leaf * kHighwayTreeHashLeafSize);
+                             },
+                             hash_leaves);
+    }
+  }
+
+  // Parent node: little-endian leaf hashes followed by the total size.
+  std::vector<uint64_t> parent;
+  parent.reserve(num_leaves * 4 + 1);
+  for (const HHResult256& leaf : leaves) {
+    for (int i = 0; i < 4; ++i) {
+      parent.push_back(le64_from_host(leaf[i]));
+    }
+  }
+  parent.push_back(le64_from_host(size));
+
+  HHKey parent_key;
+  DeriveKey(key, kParentTweak, &parent_key);
+  HashParent(functions, parent_key,
+             reinterpret_cast<const char*>(parent.data()),
+             parent.size() * sizeof(uint64_t), hash);
+}
+
+}  // namespace
+
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult64* HH_RESTRICT hash) {
+  TreeHash(key, bytes, size, pool, hash);
+}
+
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult128* HH_RESTRICT hash) {
+  TreeHash(key, bytes, size, pool, hash);
+}
+
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult256* HH_RESTRICT hash) {
+  TreeHash(key, bytes, size, pool, hash);
+}
+
+}  // namespace highwayhash
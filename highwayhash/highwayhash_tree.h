@@ -0,0 +1,61 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HIGHWAYHASH_TREE_H_
+#define HIGHWAYHASH_HIGHWAYHASH_TREE_H_
+
+// Multithreaded hashing of very large buffers. WARNING: the results differ
+// from HighwayHash of the same data.
+
+#include <stddef.h>
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+
+namespace highwayhash {
+
+class ThreadPool;  // data_parallel.h
+
+// Changing the leaf size or any other aspect of the construction below would
+// change all results; such a change must introduce a new version instead.
+static constexpr int kHighwayTreeHashVersion = 1;
+
+// Version 1 splits the input into leaves of this many bytes (the last leaf
+// may be shorter, or empty if the input is).
+static constexpr size_t kHighwayTreeHashLeafSize = 64 * 1024;
+
+// Stores a 64/128/256 bit "tree hash" of "bytes". Each leaf is hashed
+// independently via HighwayHash (256 bit) with a key derived from "key". The
+// result is HighwayHash (with a different derived key) of the concatenated
+// little-endian leaf hashes followed by the little-endian 64-bit "size".
+//
+// "pool" hashes the leaves in parallel; if null, they are hashed on the
+// calling thread. The result is identical regardless of the number of
+// threads, the CPU and the best available instruction set. This is worthwhile
+// for inputs of at least several hundred KiB.
+//
+// Not thread-safe with respect to "pool" - see ThreadPool::Run.
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult64* HH_RESTRICT hash);
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult128* HH_RESTRICT hash);
+void HighwayTreeHash(const HHKey& key, const char* HH_RESTRICT bytes,
+                     const size_t size, ThreadPool* pool,
+                     HHResult256* HH_RESTRICT hash);
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_HIGHWAYHASH_TREE_H_
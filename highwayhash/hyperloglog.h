@@ -0,0 +1,414 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_HYPERLOGLOG_H_
+#define HIGHWAYHASH_HYPERLOGLOG_H_
+
+// HyperLogLog cardinality sketch fed by HighwayHash64, e.g. for counting
+// distinct users per segment and merging the per-segment sketches in rollups.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memcpy, memmove
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_SSE41
+#include "highwayhash/vector128.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Sketch of the number of distinct elements added to it, with a relative
+// standard error of 1.04 / sqrt(2^precision), e.g. 0.81% for the default
+// precision 14 (16 KiB once dense). The upper "precision" bits of each 64-bit
+// hash select one of the 2^precision one-byte registers, which holds the
+// maximum number of leading zeros (plus one) of the remaining bits.
+//
+// Sketches with a precision of at least 10 start out sparse: a sorted list of
+// four-byte (register, value) entries, converted to the dense registers once
+// it holds more than 2^precision / 8 entries (half the size of the registers).
+// Small sketches thus require far less memory; the registers and estimates are
+// the same in both representations.
+//
+// The registers only depend on the key and the inserted elements, not the
+// target or the order of insertion, so sketches may be merged across machines
+// (see CopyRegisters).
+class HyperLogLog {
+ public:
+  static constexpr int kMinPrecision = 4;
+  static constexpr int kMaxPrecision = 18;
+
+  // Number of elements hashed per HighwayHashBatchT call in AddBatch.
+  static constexpr size_t kBatchSize = 64;
+
+  // "precision" must be in [kMinPrecision, kMaxPrecision].
+  HH_INLINE HyperLogLog(const HHKey& key, const int precision = 14)
+      : precision_(precision),
+        num_registers_(size_t(1) << precision),
+        max_sparse_(num_registers_ / 8) {
+    for (int i = 0; i < 4; ++i) {
+      key_[i] = key[i];
+    }
+    Clear();
+  }
+
+  HyperLogLog(const HyperLogLog&) = delete;
+  HyperLogLog& operator=(const HyperLogLog&) = delete;
+
+  HH_INLINE ~HyperLogLog() { Free(); }
+
+  // Removes all elements; the sketch is sparse again if its precision allows.
+  HH_INLINE void Clear() {
+    Free();
+    if (max_sparse_ < kPendingEntries) {
+      registers_ = new uint8_t[num_registers_];
+      memset(registers_, 0, num_registers_);
+    } else {
+      pending_ = new uint32_t[kPendingEntries];
+    }
+  }
+
+  HH_INLINE int Precision() const { return precision_; }
+  HH_INLINE bool IsSparse() const { return registers_ == nullptr; }
+
+  // Heap memory currently used by the sketch.
+  HH_INLINE size_t Bytes() const {
+    if (!IsSparse()) return num_registers_;
+    return (sparse_capacity_ + kPendingEntries) * sizeof(uint32_t);
+  }
+
+  HH_INLINE void Add(const char* HH_RESTRICT bytes, const size_t size) {
+    HHStateT<HH_TARGET> state(key_);
+    HHResult64 hash;
+    HighwayHashT(&state, bytes, size, &hash);
+    AddHash(hash);
+  }
+
+  // Adds each of the "num_elements" "elements", hashed in groups of kBatchSize
+  // via HighwayHashBatchT.
+  HH_INLINE void AddBatch(const StringView* HH_RESTRICT elements,
+                          const size_t num_elements) {
+    HHResult64 hashes[kBatchSize];
+    for (size_t first = 0; first < num_elements; first += kBatchSize) {
+      const size_t count = num_elements - first < kBatchSize
+                               ? num_elements - first
+                               : kBatchSize;
+      HighwayHashBatchT<HH_TARGET>(key_, elements + first, count, hashes);
+      AddHashes(hashes, count);
+    }
+  }
+
+  // Same as Add for caller-computed hashes, e.g. from HighwayHashValuesT or
+  // HighwayHashOffsetsT. These must be HighwayHash64 with the same key,
+  // otherwise the sketch is not keyed and cannot be merged with others.
+  HH_INLINE void AddHash(const HHResult64 hash) {
+    const uint32_t index = static_cast<uint32_t>(hash >> (64 - precision_));
+    // The guard bit bounds the value by 65 - precision_ if all bits are zero.
+    const uint64_t bits = (hash << precision_) | (1ULL << (precision_ - 1));
+    const uint32_t value = static_cast<uint32_t>(CountLeadingZeros(bits)) + 1;
+    AddEntry((index << 8) | value);
+  }
+
+  HH_INLINE void AddHashes(const HHResult64* HH_RESTRICT hashes,
+                           const size_t num_hashes) {
+    for (size_t i = 0; i < num_hashes; ++i) {
+      AddHash(hashes[i]);
+    }
+  }
+
+  // Adds all elements of "other", which must have the same key and
+  // precision. The dense case is a vector maximum of the registers.
+  HH_INLINE void Merge(const HyperLogLog& other) {
+    // Already contains all of its own elements. (AddEntry could also
+    // reallocate the entries being read.)
+    if (&other == this) return;
+
+    if (other.IsSparse()) {
+      for (size_t i = 0; i < other.num_sparse_; ++i) {
+        AddEntry(other.sparse_[i]);
+      }
+      for (size_t i = 0; i < other.num_pending_; ++i) {
+        AddEntry(other.pending_[i]);
+      }
+      return;
+    }
+
+    ToDense();
+    MaxRegisters(other.registers_, num_registers_, registers_);
+  }
+
+  // Stores the 2^precision registers (one byte each) to "registers", e.g. for
+  // serializing the sketch. Loading them via MergeRegisters into an empty
+  // sketch restores it.
+  HH_INLINE void CopyRegisters(uint8_t* HH_RESTRICT registers) const {
+    if (!IsSparse()) {
+      memcpy(registers, registers_, num_registers_);
+      return;
+    }
+    memset(registers, 0, num_registers_);
+    ForEachSparseRegister([registers](const uint32_t index,
+                                      const uint32_t value) {
+      registers[index] = static_cast<uint8_t>(value);
+    });
+  }
+
+  // Same as Merge with a sketch whose CopyRegisters stored "registers".
+  HH_INLINE void MergeRegisters(const uint8_t* HH_RESTRICT registers) {
+    ToDense();
+    MaxRegisters(registers, num_registers_, registers_);
+  }
+
+  // Returns the estimated number of distinct elements. Like the other const
+  // member functions, this does not modify the sketch, so it may be called
+  // concurrently with them (but not with Add* or Merge*).
+  HH_INLINE double Estimate() const {
+    // Number of registers with each value.
+    uint32_t counts[64] = {0};
+    if (IsSparse()) {
+      counts[0] = static_cast<uint32_t>(num_registers_);
+      ForEachSparseRegister([&counts](const uint32_t /*index*/,
+                                      const uint32_t value) {
+        counts[0] -= 1;
+        counts[value] += 1;
+      });
+    } else {
+      for (size_t i = 0; i < num_registers_; ++i) {
+        counts[registers_[i]] += 1;
+      }
+    }
+
+    double sum = 0.0;
+    for (int value = 0; value < 64; ++value) {
+      sum += counts[value] / static_cast<double>(1ULL << value);
+    }
+    const double m = static_cast<double>(num_registers_);
+    const double alpha = precision_ == 4   ? 0.673
+                         : precision_ == 5 ? 0.697
+                         : precision_ == 6 ? 0.709
+                                           : 0.7213 / (1.0 + 1.079 / m);
+    const double estimate = alpha * m * m / sum;
+    // Linear counting is more accurate for small cardinalities. 64-bit hashes
+    // do not require a correction for large cardinalities.
+    if (estimate <= 2.5 * m && counts[0] != 0) {
+      return m * log(m / counts[0]);
+    }
+    return estimate;
+  }
+
+ private:
+  // Sparse entries are buffered and then merged into the sorted list.
+  static constexpr size_t kPendingEntries = 128;
+
+  static HH_INLINE int CountLeadingZeros(const uint64_t x) {
+#if HH_MSC_VERSION
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(x);
+#endif
+  }
+
+  // to[i] = max(to[i], from[i]) for all i < "num".
+  static HH_INLINE void MaxRegisters(const uint8_t* HH_RESTRICT from,
+                                     const size_t num,
+                                     uint8_t* HH_RESTRICT to) {
+    size_t i = 0;
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+    for (; i + 2 * V32x8U::N <= num; i += 2 * V32x8U::N) {
+      const V32x8U max0 = Max(LoadUnaligned<V32x8U>(to + i),
+                              LoadUnaligned<V32x8U>(from + i));
+      const V32x8U max1 = Max(LoadUnaligned<V32x8U>(to + i + V32x8U::N),
+                              LoadUnaligned<V32x8U>(from + i + V32x8U::N));
+      StoreUnaligned(max0, to + i);
+      StoreUnaligned(max1, to + i + V32x8U::N);
+    }
+#elif HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+    for (; i + V16x8U::N <= num; i += V16x8U::N) {
+      const V16x8U max = Max(LoadUnaligned<V16x8U>(to + i),
+                             LoadUnaligned<V16x8U>(from + i));
+      StoreUnaligned(max, to + i);
+    }
+#endif
+    for (; i < num; ++i) {
+      to[i] = to[i] > from[i] ? to[i] : from[i];
+    }
+  }
+
+  HH_INLINE void AddEntry(const uint32_t entry) {
+    if (!IsSparse()) {
+      uint8_t& reg = registers_[entry >> 8];
+      const uint8_t value = static_cast<uint8_t>(entry & 0xFF);
+      reg = reg > value ? reg : value;
+      return;
+    }
+
+    pending_[num_pending_++] = entry;
+    if (num_pending_ == kPendingEntries) {
+      Flush();
+      if (num_sparse_ > max_sparse_) {
+        ToDense();
+      }
+    }
+  }
+
+  // Insertion sort; entries are ordered by register, then value.
+  static HH_INLINE void SortEntries(uint32_t* HH_RESTRICT entries,
+                                    const size_t num_entries) {
+    for (size_t i = 1; i < num_entries; ++i) {
+      const uint32_t entry = entries[i];
+      size_t j = i;
+      for (; j != 0 && entries[j - 1] > entry; --j) {
+        entries[j] = entries[j - 1];
+      }
+      entries[j] = entry;
+    }
+  }
+
+  // Calls func(index, value) once for each nonzero register of a sparse
+  // sketch, in ascending order of index, including the pending entries. Sorts
+  // a copy of the latter instead of calling Flush, so the sketch is unchanged.
+  template <class Func>
+  HH_INLINE void ForEachSparseRegister(const Func& func) const {
+    uint32_t pending[kPendingEntries];
+    memcpy(pending, pending_, num_pending_ * sizeof(uint32_t));
+    SortEntries(pending, num_pending_);
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i != num_sparse_ || j != num_pending_) {
+      const uint32_t sparse_index = i != num_sparse_ ? sparse_[i] >> 8 : ~0u;
+      const uint32_t pending_index = j != num_pending_ ? pending[j] >> 8 : ~0u;
+      const uint32_t index =
+          sparse_index < pending_index ? sparse_index : pending_index;
+      // Values are nonzero, and the last entry of a register is its maximum.
+      uint32_t value = 0;
+      if (sparse_index == index) {
+        value = sparse_[i++] & 0xFF;
+      }
+      for (; j != num_pending_ && (pending[j] >> 8) == index; ++j) {
+        const uint32_t pending_value = pending[j] & 0xFF;
+        value = value > pending_value ? value : pending_value;
+      }
+      func(index, value);
+    }
+  }
+
+  // Merges the pending entries into the sorted list, which holds at most one
+  // entry (with the maximum value) per register. Does not change the
+  // registers.
+  HH_INLINE void Flush() {
+    if (num_pending_ == 0) return;
+
+    SortEntries(pending_, num_pending_);
+
+    const size_t capacity = num_sparse_ + num_pending_;
+    if (capacity > sparse_capacity_) {
+      // Doubling, but at most the capacity required before ToDense.
+      const size_t max_capacity = max_sparse_ + kPendingEntries;
+      sparse_capacity_ = 2 * capacity < max_capacity ? 2 * capacity
+                                                     : max_capacity;
+      uint32_t* grown = new uint32_t[sparse_capacity_];
+      if (num_sparse_ != 0) {  // sparse_ is null before the first Flush
+        memcpy(grown, sparse_, num_sparse_ * sizeof(uint32_t));
+      }
+      delete[] sparse_;
+      sparse_ = grown;
+    }
+
+    // In-place merge from the back, where the first entry of each register
+    // has the largest value. The output never overtakes the sparse entries
+    // not yet read because it has room for all pending entries.
+    size_t out = capacity;
+    size_t i = num_sparse_;
+    size_t j = num_pending_;
+    while (i != 0 || j != 0) {
+      const bool take_sparse =
+          j == 0 || (i != 0 && sparse_[i - 1] > pending_[j - 1]);
+      const uint32_t entry = take_sparse ? sparse_[--i] : pending_[--j];
+      if (out == capacity || (sparse_[out] >> 8) != (entry >> 8)) {
+        sparse_[--out] = entry;
+      }
+    }
+
+    num_sparse_ = capacity - out;
+    memmove(sparse_, sparse_ + out, num_sparse_ * sizeof(uint32_t));
+    num_pending_ = 0;
+  }
+
+  HH_INLINE void ToDense() {
+    if (!IsSparse()) return;
+    Flush();
+    registers_ = new uint8_t[num_registers_];
+    memset(registers_, 0, num_registers_);
+    for (size_t i = 0; i < num_sparse_; ++i) {
+      registers_[sparse_[i] >> 8] = static_cast<uint8_t>(sparse_[i] & 0xFF);
+    }
+    delete[] sparse_;
+    delete[] pending_;
+    sparse_ = nullptr;
+    pending_ = nullptr;
+    num_sparse_ = 0;
+    sparse_capacity_ = 0;
+  }
+
+  HH_INLINE void Free() {
+    delete[] registers_;
+    delete[] sparse_;
+    delete[] pending_;
+    registers_ = nullptr;
+    sparse_ = nullptr;
+    pending_ = nullptr;
+    num_sparse_ = 0;
+    sparse_capacity_ = 0;
+    num_pending_ = 0;
+  }
+
+  HHKey key_;
+  const int precision_;
+  const size_t num_registers_;
+  const size_t max_sparse_;  // entries, before converting to dense
+
+  uint8_t* registers_ = nullptr;  // num_registers_ once dense, else null.
+
+  // Only while sparse.
+  uint32_t* sparse_ = nullptr;  // num_sparse_, sorted, unique register
+  size_t num_sparse_ = 0;
+  size_t sparse_capacity_ = 0;
+  uint32_t* pending_ = nullptr;  // kPendingEntries, unsorted
+  size_t num_pending_ = 0;
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_HYPERLOGLOG_H_
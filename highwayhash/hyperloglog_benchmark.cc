@@ -0,0 +1,109 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the throughput of adding elements to HyperLogLog and of merging
+// sketches (as in rollups), and reports the estimation error and memory use.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "highwayhash/hyperloglog.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+using Sketch = HH_TARGET_NAME::HyperLogLog;
+
+// Returns the best of three measurements of "func" in seconds.
+template <class Func>
+double Time(const Func& func) {
+  double best = 1E10;
+  for (int rep = 0; rep < 3; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    func();
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  return best;
+}
+
+void MeasureAdd(const size_t num_elements) {
+  std::mt19937_64 rng(12345);
+  std::vector<uint64_t> values(num_elements);
+  std::vector<StringView> elements(num_elements);
+  for (size_t i = 0; i < num_elements; ++i) {
+    values[i] = rng();
+    elements[i] = StringView{reinterpret_cast<const char*>(&values[i]), 8};
+  }
+
+  Sketch sketch(kKey);
+  const double add = Time([&] {
+    sketch.Clear();
+    for (const StringView& element : elements) {
+      sketch.Add(element.data, element.num_bytes);
+    }
+  });
+  const double batch = Time([&] {
+    sketch.Clear();
+    sketch.AddBatch(elements.data(), num_elements);
+  });
+  printf("Target %s, %zu elements: estimate %.0f, %zu bytes\n",
+         TargetName(HH_TARGET), num_elements, sketch.Estimate(),
+         sketch.Bytes());
+  printf("%32s: %6.2f M elements/s\n", "Add", num_elements / add * 1E-6);
+  printf("%32s: %6.2f M elements/s\n", "AddBatch",
+         num_elements / batch * 1E-6);
+}
+
+// Merges "num_sketches" dense sketches into one, as in a rollup.
+void MeasureMerge(const size_t num_sketches) {
+  std::mt19937_64 rng(12345);
+  std::vector<std::unique_ptr<Sketch>> sketches;
+  for (size_t i = 0; i < num_sketches; ++i) {
+    sketches.emplace_back(new Sketch(kKey));
+    for (size_t j = 0; j < 5000; ++j) {
+      sketches.back()->AddHash(rng());
+    }
+  }
+
+  Sketch total(kKey);
+  const double merge = Time([&] {
+    total.Clear();
+    for (const std::unique_ptr<Sketch>& sketch : sketches) {
+      total.Merge(*sketch);
+    }
+  });
+  const double bytes = static_cast<double>(num_sketches) * sketches[0]->Bytes();
+  printf("%32s: %6.2f K sketches/s, %5.2f GB/s (estimate %.0f)\n", "Merge",
+         num_sketches / merge * 1E-3, bytes / merge * 1E-9, total.Estimate());
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  highwayhash::MeasureAdd(1000);             // sparse
+  highwayhash::MeasureAdd(size_t{1} << 22);  // dense
+  highwayhash::MeasureMerge(1000);
+  return 0;
+}
@@ -15,8 +15,8 @@
 #include "highwayhash/instruction_sets.h"
 #include "highwayhash/arch_specific.h"
 
-// Currently there are only specialized targets for X64; other architectures
-// only use HH_TARGET_Portable, in which case Supported() just returns that.
+// Only X64 requires runtime detection; other architectures have a fixed set
+// of targets, in which case Supported() is inline and returns that.
 #if HH_ARCH_X64
 
 #include <atomic>
@@ -62,8 +62,14 @@ enum {
   kBitLZCNT = 1 << 9,
   kBitBMI = 1 << 10,
   kBitBMI2 = 1 << 11,
+  kBitAVX512F = 1 << 12,
+  kBitAVX512VL = 1 << 13,
+  kBitAVX512DQ = 1 << 14,
+  kBitAVX512BW = 1 << 15,
 
   kGroupAVX2 = kBitAVX | kBitAVX2 | kBitFMA | kBitLZCNT | kBitBMI | kBitBMI2,
+  kGroupAVX512 = kGroupAVX2 | kBitAVX512F | kBitAVX512VL | kBitAVX512DQ |
+                 kBitAVX512BW,
   kGroupSSE41 = kBitSSE | kBitSSE2 | kBitSSE3 | kBitSSSE3 | kBitSSE41
 };
 
@@ -105,6 +111,10 @@ TargetBits InstructionSets::Supported() {
     flags |= IsBitSet(abcd[1], 3) ? kBitBMI : 0;
     flags |= IsBitSet(abcd[1], 5) ? kBitAVX2 : 0;
     flags |= IsBitSet(abcd[1], 8) ? kBitBMI2 : 0;
+    flags |= IsBitSet(abcd[1], 16) ? kBitAVX512F : 0;
+    flags |= IsBitSet(abcd[1], 17) ? kBitAVX512DQ : 0;
+    flags |= IsBitSet(abcd[1], 30) ? kBitAVX512BW : 0;
+    flags |= IsBitSet(abcd[1], 31) ? kBitAVX512VL : 0;
   }
 
   // Verify OS support for XSAVE, without which XMM/YMM registers are not
@@ -115,19 +125,26 @@ TargetBits InstructionSets::Supported() {
     if ((xcr0 & 2) == 0 || (xcr0 & 4) == 0) {
       flags &= ~(kBitAVX | kBitAVX2);
     }
+    // Opmask, upper halves of ZMM0-15 and ZMM16-31
+    if ((xcr0 & 0xE0) != 0xE0) {
+      flags &= ~kBitAVX512F;
+    }
   } else {
     // Clear the AVX/AVX2 bits if the CPU or OS does not support XSAVE.
     //
     // The lower 128 bits of XMM0-XMM15 are guaranteed to be preserved across
     // context switches on x86_64 and any modern 32-bit system, so only AVX2
     // needs to be disabled.
-    flags &= ~(kBitAVX | kBitAVX2);
+    flags &= ~(kBitAVX | kBitAVX2 | kBitAVX512F);
   }
 
   // Also indicates "supported" has been initialized.
-  supported = HH_TARGET_Portable;
+  supported = HH_TARGETS_BASELINE;
 
   // Set target bit(s) if all their group's flags are all set.
+  if ((flags & kGroupAVX512) == kGroupAVX512) {
+    supported |= HH_TARGET_AVX512;
+  }
   if ((flags & kGroupAVX2) == kGroupAVX2) {
     supported |= HH_TARGET_AVX2;
   }
@@ -29,23 +29,31 @@
 
 namespace highwayhash {
 
+// Bit array of the HH_TARGET_* supported by every CPU of the current HH_ARCH.
+#if HH_ARCH_GENERIC
+#define HH_TARGETS_BASELINE (HH_TARGET_Generic | HH_TARGET_Portable)
+#else
+#define HH_TARGETS_BASELINE HH_TARGET_Portable
+#endif
+
 // Detects TargetBits and calls specializations of a user-defined functor.
 class InstructionSets {
  public:
 // Returns bit array of HH_TARGET_* supported by the current CPU.
-// The HH_TARGET_Portable bit is guaranteed to be set.
+// The HH_TARGETS_BASELINE bits (including HH_TARGET_Portable) are guaranteed
+// to be set.
 #if HH_ARCH_X64
   static TargetBits Supported();
 #elif HH_ARCH_PPC
   static HH_INLINE TargetBits Supported() {
-    return HH_TARGET_VSX | HH_TARGET_Portable;
+    return HH_TARGET_VSX | HH_TARGETS_BASELINE;
   }
 #elif HH_ARCH_NEON
   static HH_INLINE TargetBits Supported() {
-    return HH_TARGET_NEON | HH_TARGET_Portable;
+    return HH_TARGET_NEON | HH_TARGETS_BASELINE;
   }
 #else
-  static HH_INLINE TargetBits Supported() { return HH_TARGET_Portable; }
+  static HH_INLINE TargetBits Supported() { return HH_TARGETS_BASELINE; }
 #endif
 
   // Chooses the best available "Target" for the current CPU, runs the
@@ -56,6 +64,10 @@ class InstructionSets {
   static HH_INLINE TargetBits Run(Args&&... args) {
 #if HH_ARCH_X64
     const TargetBits supported = Supported();
+    if (supported & HH_TARGET_AVX512) {
+      Func<HH_TARGET_AVX512>()(std::forward<Args>(args)...);
+      return HH_TARGET_AVX512;
+    }
     if (supported & HH_TARGET_AVX2) {
       Func<HH_TARGET_AVX2>()(std::forward<Args>(args)...);
       return HH_TARGET_AVX2;
@@ -78,6 +90,13 @@ class InstructionSets {
     }
 #endif
 
+#if HH_ARCH_GENERIC
+    // No matching HH_ARCH or no supported HH_TARGET, but the compiler can
+    // still vectorize (always supported, see HH_ARCH_GENERIC):
+    Func<HH_TARGET_Generic>()(std::forward<Args>(args)...);
+    return HH_TARGET_Generic;
+#endif
+
     // No matching HH_ARCH or no supported HH_TARGET:
     Func<HH_TARGET_Portable>()(std::forward<Args>(args)...);
     return HH_TARGET_Portable;
@@ -90,6 +109,9 @@ class InstructionSets {
     const TargetBits supported = Supported();
 
 #if HH_ARCH_X64
+    if (supported & HH_TARGET_AVX512) {
+      Func<HH_TARGET_AVX512>()(std::forward<Args>(args)...);
+    }
     if (supported & HH_TARGET_AVX2) {
       Func<HH_TARGET_AVX2>()(std::forward<Args>(args)...);
     }
@@ -107,6 +129,9 @@ class InstructionSets {
     }
 #endif
 
+#if HH_ARCH_GENERIC
+    Func<HH_TARGET_Generic>()(std::forward<Args>(args)...);
+#endif
     Func<HH_TARGET_Portable>()(std::forward<Args>(args)...);
 
     return supported;  // i.e. all that were run
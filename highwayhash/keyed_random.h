@@ -0,0 +1,227 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_KEYED_RANDOM_H_
+#define HIGHWAYHASH_KEYED_RANDOM_H_
+
+// Deterministic keyed pseudorandom numbers in counter mode: any part of the
+// stream can be regenerated independently (e.g. by another thread or a later
+// run), as needed for idempotent sampling decisions or synthetic test data.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Returns a double in [0, 1) from the upper 53 bits of "bits", i.e. all
+// multiples of 2^-53 with equal probability.
+HH_INLINE double RandomToDouble(const uint64_t bits) {
+  return static_cast<double>(bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Returns a float in [0, 1) from the upper 24 bits of "bits".
+HH_INLINE float RandomToFloat(const uint32_t bits) {
+  return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// Pseudorandom stream of 32-byte blocks: block i is HighwayHash256 of the
+// 32-byte packet (little-endian i, little-endian "stream", 16 zero bytes)
+// with key[j] ^ (0x484852616E640000 + j) ("HHRand" in ASCII). The output is
+// thus as unpredictable as HighwayHash without the key, and identical for all
+// targets.
+//
+// Generate/Fill are const and random-access (thread-safe); the Next* members
+// read the same stream sequentially as 64-bit words (little-endian lanes of
+// consecutive blocks), buffering several blocks. Filling buffers is much
+// faster than hashing one counter at a time: there is no Reset per counter,
+// the packet is complete (no remainder handling), and four states are updated
+// and finalized in lockstep so that their dependency chains overlap (unlike
+// long inputs, see HighwayHashBatchT, a single Update per state does not run
+// out of registers).
+class KeyedRandom {
+ public:
+  static constexpr size_t kBlockSize = sizeof(HHResult256);
+
+  // Different "stream" values yield independent sequences for the same key.
+  explicit HH_INLINE KeyedRandom(const HHKey& key, const uint64_t stream = 0)
+      : initial_(DerivedKey(key).key), stream_(stream) {}
+
+  // Stores blocks [counter, counter + num_blocks) in "blocks".
+  HH_INLINE void Generate(const uint64_t counter, const size_t num_blocks,
+                          HHResult256* HH_RESTRICT blocks) const {
+    // Separate variables rather than an array, which compilers keep in memory.
+    const size_t num_interleaved = num_blocks & ~size_t(3);
+    for (size_t i = 0; i < num_interleaved; i += 4) {
+      HHStateT<HH_TARGET> state0 = initial_;
+      HHStateT<HH_TARGET> state1 = initial_;
+      HHStateT<HH_TARGET> state2 = initial_;
+      HHStateT<HH_TARGET> state3 = initial_;
+      state0.Update(Packet(counter + i + 0, stream_).bytes);
+      state1.Update(Packet(counter + i + 1, stream_).bytes);
+      state2.Update(Packet(counter + i + 2, stream_).bytes);
+      state3.Update(Packet(counter + i + 3, stream_).bytes);
+      state0.Finalize(&blocks[i + 0]);
+      state1.Finalize(&blocks[i + 1]);
+      state2.Finalize(&blocks[i + 2]);
+      state3.Finalize(&blocks[i + 3]);
+    }
+    for (size_t i = num_interleaved; i < num_blocks; ++i) {
+      HHStateT<HH_TARGET> state = initial_;
+      state.Update(Packet(counter + i, stream_).bytes);
+      state.Finalize(&blocks[i]);
+    }
+  }
+
+  // Stores bytes [position, position + num_bytes) of the stream, i.e. of the
+  // concatenated little-endian blocks. Any "position" is allowed.
+  HH_INLINE void Fill(const uint64_t position, char* HH_RESTRICT bytes,
+                      size_t num_bytes) const {
+    uint64_t counter = position / kBlockSize;
+    HHResult256 blocks[kBufferBlocks];
+
+    // Partial first block.
+    const size_t skip = position % kBlockSize;
+    if (skip != 0 && num_bytes != 0) {
+      Generate(counter++, 1, blocks);
+      const size_t copy = min(kBlockSize - skip, num_bytes);
+      CopyBytes(blocks, skip, copy, bytes);
+      bytes += copy;
+      num_bytes -= copy;
+    }
+
+    while (num_bytes != 0) {
+      const size_t num_blocks =
+          min(kBufferBlocks, (num_bytes + kBlockSize - 1) / kBlockSize);
+      Generate(counter, num_blocks, blocks);
+      counter += num_blocks;
+      const size_t copy = min(num_blocks * kBlockSize, num_bytes);
+      CopyBytes(blocks, 0, copy, bytes);
+      bytes += copy;
+      num_bytes -= copy;
+    }
+  }
+
+  // Subsequent Next* continue with the first word of block "counter".
+  HH_INLINE void Seek(const uint64_t counter) {
+    next_counter_ = counter;
+    next_word_ = kBufferWords;
+  }
+
+  // Returns the next 64-bit word of the stream.
+  HH_INLINE uint64_t Next64() {
+    if (next_word_ == kBufferWords) {
+      Generate(next_counter_, kBufferBlocks, buffer_);
+      next_counter_ += kBufferBlocks;
+      next_word_ = 0;
+    }
+    const uint64_t word = buffer_[next_word_ / 4][next_word_ % 4];
+    ++next_word_;
+    return word;
+  }
+
+  // Uniform in [0, 1).
+  HH_INLINE double NextDouble() { return RandomToDouble(Next64()); }
+  HH_INLINE float NextFloat() {
+    return RandomToFloat(static_cast<uint32_t>(Next64() >> 32));
+  }
+
+  // Returns true with probability "p", e.g. for sampling.
+  HH_INLINE bool NextBernoulli(const double p) { return NextDouble() < p; }
+
+  // Uniform in [0, bound) without bias, for bound != 0. Uses Lemire's
+  // multiply-and-shift with rejection (ACM TOMACS 2019), which rarely needs
+  // more than one word and avoids the division of "% bound".
+  HH_INLINE uint32_t NextBounded(const uint32_t bound) {
+    uint64_t product = (Next64() >> 32) * bound;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < bound) {
+      const uint32_t threshold = (0u - bound) % bound;
+      while (low < threshold) {
+        product = (Next64() >> 32) * bound;
+        low = static_cast<uint32_t>(product);
+      }
+    }
+    return static_cast<uint32_t>(product >> 32);
+  }
+
+ private:
+  static constexpr size_t kBufferBlocks = 8;
+  static constexpr size_t kBufferWords = kBufferBlocks * 4;
+
+  // Input of HighwayHash for one block.
+  struct Packet {
+    HH_INLINE Packet(const uint64_t counter, const uint64_t stream) {
+      const uint64_t words[4] = {le64_from_host(counter),
+                                 le64_from_host(stream), 0, 0};
+      memcpy(bytes, words, sizeof(bytes));
+    }
+    HHPacket bytes;
+  };
+
+  static HH_INLINE size_t min(const size_t a, const size_t b) {
+    return a < b ? a : b;
+  }
+
+  struct DerivedKey {
+    explicit HH_INLINE DerivedKey(const HHKey& original) {
+      for (int i = 0; i < 4; ++i) {
+        key[i] = original[i] ^ (0x484852616E640000ull + i);
+      }
+    }
+    HHKey key;
+  };
+
+  // Copies "num_bytes" of the little-endian "blocks", starting at "skip".
+  static HH_INLINE void CopyBytes(const HHResult256* HH_RESTRICT blocks,
+                                  const size_t skip, const size_t num_bytes,
+                                  char* HH_RESTRICT bytes) {
+#if HH_IS_LITTLE_ENDIAN
+    memcpy(bytes, reinterpret_cast<const char*>(blocks) + skip, num_bytes);
+#else
+    for (size_t i = 0; i < num_bytes; ++i) {
+      const size_t pos = skip + i;
+      const uint64_t lane = blocks[pos / kBlockSize][pos % kBlockSize / 8];
+      bytes[i] = static_cast<char>(lane >> (pos % 8 * 8));
+    }
+#endif
+  }
+
+  const HHStateT<HH_TARGET> initial_;
+  const uint64_t stream_;
+
+  uint64_t next_counter_ = 0;
+  size_t next_word_ = kBufferWords;  // none buffered
+  HHResult256 buffer_[kBufferBlocks];
+};
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_KEYED_RANDOM_H_
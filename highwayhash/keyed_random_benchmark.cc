@@ -0,0 +1,111 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the throughput of KeyedRandom (buffers and sequential words),
+// compared to hashing one counter at a time with HighwayHash64.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "highwayhash/keyed_random.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kNumBytes = 16 << 20;
+
+using HH_TARGET_NAME::KeyedRandom;
+
+// Prints GB/s of "func", which generates kNumBytes and returns a checksum
+// (to prevent elision).
+template <class Func>
+void Measure(const char* caption, const Func& func) {
+  double best = 1E10;
+  uint64_t sum = 0;
+  for (int rep = 0; rep < 5; ++rep) {
+    const auto t0 = std::chrono::steady_clock::now();
+    sum += func();
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+  }
+  printf("%28s: %6.3f GB/s (%llu)\n", caption, kNumBytes / best * 1E-9,
+         static_cast<unsigned long long>(sum % 10));
+}
+
+void Run() {
+  printf("Target %s, %zu MiB:\n", TargetName(HH_TARGET), kNumBytes >> 20);
+  std::vector<uint64_t> words(kNumBytes / 8);
+
+  // Baseline: a full HighwayHash64 (Reset, Update, Pad, Finalize) of each
+  // 8-byte counter.
+  Measure("HighwayHash64 per counter", [&] {
+    for (size_t i = 0; i < words.size(); ++i) {
+      HHStateT<HH_TARGET> state(kKey);
+      const uint64_t counter = i;
+      HHResult64 hash;
+      HighwayHashT(&state, reinterpret_cast<const char*>(&counter),
+                   sizeof(counter), &hash);
+      words[i] = hash;
+    }
+    return words[words.size() / 2];
+  });
+
+  const KeyedRandom random(kKey);
+  Measure("KeyedRandom::Fill", [&] {
+    random.Fill(0, reinterpret_cast<char*>(words.data()), kNumBytes);
+    return words[words.size() / 2];
+  });
+
+  // Many small requests at unaligned positions.
+  Measure("KeyedRandom::Fill(100 bytes)", [&] {
+    char* bytes = reinterpret_cast<char*>(words.data());
+    for (size_t pos = 0; pos + 100 <= kNumBytes; pos += 100) {
+      random.Fill(pos, bytes + pos, 100);
+    }
+    return words[words.size() / 2];
+  });
+
+  Measure("KeyedRandom::Next64", [&] {
+    KeyedRandom sequential(kKey);
+    for (uint64_t& word : words) {
+      word = sequential.Next64();
+    }
+    return words[words.size() / 2];
+  });
+
+  Measure("KeyedRandom::NextBounded(6)", [&] {
+    KeyedRandom sequential(kKey);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+      sum += sequential.NextBounded(6);
+    }
+    return sum;
+  });
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  highwayhash::Run();
+  return 0;
+}
@@ -44,6 +44,7 @@ class Load3 {
   struct AllowReadBeforeAndReturn {};
   struct AllowReadBefore {};
   struct AllowUnordered {};
+  struct AllowUnorderedReadAfter {};
   struct AllowNone {};
 
   // Up to 4 preceding bytes may be read and returned along with the 0..3
@@ -99,6 +100,18 @@ class Load3 {
     return last3;
   }
 
+  // Same result as AllowUnordered, but up to 4 bytes starting at "from" may be
+  // read even if size_mod4 is smaller. This avoids the early-out branch.
+  HH_INLINE uint64_t operator()(AllowUnorderedReadAfter, const char* from,
+                                const size_t size_mod4) {
+    // (size_mod4 - 1) & 3 is a valid index also if size_mod4 == 0.
+    uint64_t last3 = U64FromChar(from[0]);
+    last3 += U64FromChar(from[size_mod4 >> 1]) << 8;
+    last3 += U64FromChar(from[(size_mod4 - 1) & 3]) << 16;
+    // Zero if size_mod4 == 0.
+    return last3 & (0ULL - static_cast<uint64_t>(size_mod4 != 0));
+  }
+
   // Must read exactly [0, size) bytes in little-endian order.
   HH_INLINE uint64_t operator()(AllowNone, const char* from,
                                 const size_t size_mod4) {
@@ -0,0 +1,296 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_MINHASH_H_
+#define HIGHWAYHASH_MINHASH_H_
+
+// MinHash sketches for estimating the Jaccard similarity of sets (e.g. the
+// shingles of documents, for near-duplicate detection), plus b-bit
+// compression of the sketches for storage.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/highwayhash.h"
+
+#if HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_SSE41
+#include "highwayhash/vector128.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// minima[i] = min(minima[i], value i of "hash") for all values of "hash",
+// i.e. the i-th sizeof(*minima)-byte part of its little-endian lanes.
+template <typename Value>
+HH_INLINE void MinHashUpdateScalar(const HHResult256& hash,
+                                   Value* HH_RESTRICT minima) {
+  constexpr size_t kPerLane = 8 / sizeof(Value);
+  for (size_t i = 0; i < 4 * kPerLane; ++i) {
+    const Value value = static_cast<Value>(hash[i / kPerLane] >>
+                                           (i % kPerLane * 8 * sizeof(Value)));
+    minima[i] = value < minima[i] ? value : minima[i];
+  }
+}
+
+#if HH_IS_LITTLE_ENDIAN && \
+    (HH_TARGET == HH_TARGET_AVX2 || HH_TARGET == HH_TARGET_AVX512)
+
+// The parts of the lanes are in little-endian order, so vectors of the smaller
+// type can load them directly.
+template <class V>
+HH_INLINE void MinHashUpdateVector(const HHResult256& hash,
+                                   typename V::T* HH_RESTRICT minima) {
+  const typename V::T* parts = reinterpret_cast<const typename V::T*>(hash);
+  StoreUnaligned(Min(LoadUnaligned<V>(minima), LoadUnaligned<V>(parts)),
+                 minima);
+}
+
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint16_t* HH_RESTRICT minima) {
+  MinHashUpdateVector<V16x16U>(hash, minima);
+}
+
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint32_t* HH_RESTRICT minima) {
+  MinHashUpdateVector<V8x32U>(hash, minima);
+}
+
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint64_t* HH_RESTRICT minima) {
+  // AVX2 lacks unsigned 64-bit comparisons; flipping the sign bits turns
+  // unsigned order into signed order.
+  const V4x64U sign(0x8000000000000000ull);
+  const V4x64U old = LoadUnaligned<V4x64U>(minima);
+  const V4x64U lanes = LoadUnaligned<V4x64U>(hash);
+  V4x64U old_signed(old);
+  old_signed ^= sign;
+  V4x64U lanes_signed(lanes);
+  lanes_signed ^= sign;
+  const __m256i old_greater = _mm256_cmpgt_epi64(old_signed, lanes_signed);
+  StoreUnaligned(V4x64U(_mm256_blendv_epi8(old, lanes, old_greater)), minima);
+}
+
+#elif HH_IS_LITTLE_ENDIAN && \
+    (HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON)
+
+// See above; two 128-bit vectors.
+template <class V>
+HH_INLINE void MinHashUpdateVector(const HHResult256& hash,
+                                   typename V::T* HH_RESTRICT minima) {
+  const typename V::T* parts = reinterpret_cast<const typename V::T*>(hash);
+  for (size_t i = 0; i < 2 * V::N; i += V::N) {
+    StoreUnaligned(
+        Min(LoadUnaligned<V>(minima + i), LoadUnaligned<V>(parts + i)),
+        minima + i);
+  }
+}
+
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint16_t* HH_RESTRICT minima) {
+  MinHashUpdateVector<V8x16U>(hash, minima);
+}
+
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint32_t* HH_RESTRICT minima) {
+  MinHashUpdateVector<V4x32U>(hash, minima);
+}
+
+// Neither has unsigned 64-bit min/comparisons.
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             uint64_t* HH_RESTRICT minima) {
+  MinHashUpdateScalar(hash, minima);
+}
+
+#else
+
+template <typename Value>
+HH_INLINE void MinHashUpdate(const HHResult256& hash,
+                             Value* HH_RESTRICT minima) {
+  MinHashUpdateScalar(hash, minima);
+}
+
+#endif
+
+// Running minima of "num_values" independent hash functions ("permutations")
+// over all elements added to the sketch. Each HighwayHash256 of an element
+// provides kValuesPerHash of them: its four 64-bit lanes for Value = uint64_t,
+// or their 32 or 16-bit parts (least-significant first) for Value = uint32_t
+// or uint16_t. Hash call c uses key[i] ^ (0x48484D696E480000 + c * 4 + i)
+// ("HHMinH" in ASCII).
+//
+// The probability that value i of two sketches (with the same key and
+// num_values) is equal is the Jaccard similarity of their sets, plus the
+// probability 2^-(8 * sizeof(Value)) of a collision, which is negligible for
+// near-duplicate detection even for uint16_t. Smaller values are thus
+// recommended: each hash call provides more of them, and BBitCompress only
+// keeps up to 16 bits anyway. The values only depend on the key and the set of
+// elements, not on the target or the order of additions.
+template <typename Value>
+class MinHashT {
+  static_assert(sizeof(Value) == 2 || sizeof(Value) == 4 || sizeof(Value) == 8,
+                "Use U16, U32 or U64");
+
+ public:
+  static constexpr size_t kValuesPerHash = 32 / sizeof(Value);
+
+  // "num_values" must be a nonzero multiple of kValuesPerHash.
+  HH_INLINE MinHashT(const HHKey& key, const size_t num_values)
+      : num_hashes_(num_values / kValuesPerHash),
+        keys_(new HHKey[num_hashes_]),
+        values_(new Value[num_values]) {
+    const uint64_t kTweak = 0x48484D696E480000ull;  // "HHMinH" in ASCII.
+    for (size_t c = 0; c < num_hashes_; ++c) {
+      for (int i = 0; i < 4; ++i) {
+        keys_[c][i] = key[i] ^ (kTweak + c * 4 + i);
+      }
+    }
+    Clear();
+  }
+
+  MinHashT(const MinHashT&) = delete;
+  MinHashT& operator=(const MinHashT&) = delete;
+
+  HH_INLINE ~MinHashT() {
+    delete[] values_;
+    delete[] keys_;
+  }
+
+  // Empties the set; all values are the maximum.
+  HH_INLINE void Clear() {
+    for (size_t i = 0; i < NumValues(); ++i) {
+      values_[i] = ~Value(0);
+    }
+  }
+
+  HH_INLINE size_t NumValues() const { return num_hashes_ * kValuesPerHash; }
+  HH_INLINE const Value* Values() const { return values_; }
+
+  // Adds one element (e.g. a shingle) to the set.
+  HH_INLINE void Add(const char* HH_RESTRICT bytes, const size_t size) {
+    for (size_t c = 0; c < num_hashes_; ++c) {
+      HHStateT<HH_TARGET> state(keys_[c]);
+      HHResult256 hash;
+      HighwayHashT(&state, bytes, size, &hash);
+      MinHashUpdate(hash, values_ + c * kValuesPerHash);
+    }
+  }
+
+  HH_INLINE void AddBatch(const StringView* HH_RESTRICT elements,
+                          const size_t num_elements) {
+    for (size_t i = 0; i < num_elements; ++i) {
+      Add(elements[i].data, elements[i].num_bytes);
+    }
+  }
+
+ private:
+  const size_t num_hashes_;
+  HHKey* const keys_;
+  Value* const values_;
+};
+
+using MinHash64 = MinHashT<uint64_t>;
+using MinHash32 = MinHashT<uint32_t>;
+using MinHash16 = MinHashT<uint16_t>;
+
+// Returns the fraction of equal values, i.e. the estimated Jaccard similarity
+// of the sets of two sketches "a" and "b" with "num_values" values each.
+template <typename Value>
+HH_INLINE double MinHashSimilarity(const Value* HH_RESTRICT a,
+                                   const Value* HH_RESTRICT b,
+                                   const size_t num_values) {
+  size_t num_equal = 0;
+  for (size_t i = 0; i < num_values; ++i) {
+    num_equal += a[i] == b[i];
+  }
+  return static_cast<double>(num_equal) / num_values;
+}
+
+// b-bit MinHash: keeps only the lowest "bits" (1, 2, 4, 8 or 16) bits of each
+// value, which reduces storage by 8 * sizeof(Value) / bits at the cost of a
+// higher variance. Returns the number of uint64_t written to "packed", which
+// must have room for (num_values * bits + 63) / 64. Value i is stored in bits
+// [i * bits % 64, ...) of packed[i * bits / 64]; unused bits are zero.
+template <typename Value>
+HH_INLINE size_t BBitCompress(const Value* HH_RESTRICT values,
+                              const size_t num_values, const int bits,
+                              uint64_t* HH_RESTRICT packed) {
+  const size_t num_words = (num_values * bits + 63) / 64;
+  for (size_t i = 0; i < num_words; ++i) {
+    packed[i] = 0;
+  }
+  const uint64_t mask = (1ULL << bits) - 1;
+  for (size_t i = 0; i < num_values; ++i) {
+    const size_t bit = i * bits;
+    packed[bit / 64] |= (static_cast<uint64_t>(values[i]) & mask) << (bit % 64);
+  }
+  return num_words;
+}
+
+// Returns the estimated Jaccard similarity of the sets of two BBitCompress
+// outputs "a" and "b" with the same "num_values" and "bits". Corrects for the
+// 2^-bits probability that the lowest bits of unequal values match.
+HH_INLINE double BBitSimilarity(const uint64_t* HH_RESTRICT a,
+                                const uint64_t* HH_RESTRICT b,
+                                const size_t num_values, const int bits) {
+  // Lowest bit of each group of "bits" bits.
+  uint64_t lowest = 0;
+  for (int bit = 0; bit < 64; bit += bits) {
+    lowest |= 1ULL << bit;
+  }
+
+  // Unused bits are zero in both, hence not counted.
+  size_t num_unequal = 0;
+  const size_t num_words = (num_values * bits + 63) / 64;
+  for (size_t i = 0; i < num_words; ++i) {
+    // Or-reduce each group into its lowest bit.
+    uint64_t differ = a[i] ^ b[i];
+    for (int shift = 1; shift < bits; shift *= 2) {
+      differ |= differ >> shift;
+    }
+    differ &= lowest;
+#if HH_MSC_VERSION
+    num_unequal += static_cast<size_t>(__popcnt64(differ));
+#else
+    num_unequal += static_cast<size_t>(__builtin_popcountll(differ));
+#endif
+  }
+
+  const double matches =
+      static_cast<double>(num_values - num_unequal) / num_values;
+  const double chance = 1.0 / (1ULL << bits);
+  const double similarity = (matches - chance) / (1.0 - chance);
+  return similarity < 0.0 ? 0.0 : similarity;
+}
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_MINHASH_H_
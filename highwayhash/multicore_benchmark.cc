@@ -0,0 +1,263 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the aggregate HighwayHash throughput of 1..N pinned threads for
+// each target, either one thread per physical core ("cores") or filling both
+// SMT siblings of each core first ("smt"). Shared execution ports and lower
+// clock rates under heavy SIMD load on all cores reduce the per-core
+// throughput, which single-threaded benchmarks do not show. N defaults to
+// NumUsableCPUs, so that CPU quotas of containers are respected.
+//
+// Usage: multicore_benchmark [--size=N] [--max_threads=N]
+//                            [--format=text|json|csv]
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/highwayhash_target.h"
+#include "highwayhash/instruction_sets.h"
+#include "highwayhash/os_specific.h"
+
+namespace highwayhash {
+namespace {
+
+// Bytes hashed by each thread per measurement, excluding the warm-up.
+const uint64_t kBytesPerThread = 256ULL << 20;
+
+// Collects the implementations of all targets via InstructionSets::RunAll.
+template <TargetBits Target>
+struct CollectFunctions {
+  void operator()(std::vector<HighwayHashFunctions>* all) const {
+    HighwayHashFunctions functions;
+    HighwayHashSelect<Target>()(&functions);
+    all->push_back(functions);
+  }
+};
+
+// Returns the available CPUs grouped by physical core.
+std::vector<std::vector<int>> CoresOfCPUs() {
+  std::map<std::pair<int, int>, std::vector<int>> cpus_for_core;
+  for (const CPUTopology& location : AvailableCPUTopology()) {
+    cpus_for_core[std::make_pair(location.package, location.core)].push_back(
+        location.cpu);
+  }
+  std::vector<std::vector<int>> cores;
+  for (const auto& item : cpus_for_core) {
+    cores.push_back(item.second);
+  }
+  return cores;
+}
+
+// Returns the CPUs for "num_threads" threads: one per core, or if "smt", all
+// siblings of a core before the next. Returns an empty vector if there are
+// not enough CPUs.
+std::vector<int> ChooseCPUs(const std::vector<std::vector<int>>& cores,
+                            const size_t num_threads, const bool smt) {
+  std::vector<int> cpus;
+  if (smt) {
+    for (const std::vector<int>& siblings : cores) {
+      for (const int cpu : siblings) {
+        if (cpus.size() < num_threads) cpus.push_back(cpu);
+      }
+    }
+  } else {
+    for (const std::vector<int>& siblings : cores) {
+      if (cpus.size() < num_threads) cpus.push_back(siblings[0]);
+    }
+  }
+  if (cpus.size() < num_threads) cpus.clear();
+  return cpus;
+}
+
+// Hashes kBytesPerThread on each of "cpus" concurrently and returns the sum
+// of the per-thread throughputs [GB/s].
+double MeasureThreads(const HighwayHashFunctions& functions,
+                      const std::vector<int>& cpus, const size_t size) {
+  const int num_threads = static_cast<int>(cpus.size());
+  ThreadPool pool(num_threads);
+  std::atomic<int> num_started{0};
+  std::vector<double> gbps(num_threads);
+  const uint64_t iterations = kBytesPerThread / size;
+
+  pool.Run(0, num_threads, [&](const int task) {
+    PinThreadToCPU(cpus[task]);
+    // Each task blocks its thread until all have started, so every task runs
+    // on a different thread (and thus CPU), and they all hash concurrently.
+    num_started.fetch_add(1);
+    while (num_started.load() != num_threads) {
+    }
+
+    std::vector<char> in(size, static_cast<char>(task));
+    const HHKey key = {1, 2, 3, static_cast<uint64_t>(task)};
+    HHResult64 hash = 0;
+    // Warm-up, including any change of clock rate due to SIMD load.
+    for (uint64_t i = 0; i < iterations / 8; ++i) {
+      functions.hash64(key, in.data(), size, &hash);
+      in[0] = static_cast<char>(hash);
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+      functions.hash64(key, in.data(), size, &hash);
+      in[0] = static_cast<char>(hash);  // serializes iterations
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(t1 - t0).count();
+    gbps[task] = iterations * size / seconds * 1E-9;
+  });
+
+  double total = 0.0;
+  for (const double thread_gbps : gbps) {
+    total += thread_gbps;
+  }
+  return total;
+}
+
+// Powers of two, plus "max_threads" itself.
+size_t NextThreadCount(const size_t num_threads, const size_t max_threads) {
+  if (num_threads == max_threads) return max_threads + 1;  // done
+  return std::min(num_threads * 2, max_threads);
+}
+
+struct Result {
+  const char* target;
+  const char* placement;  // "cores" or "smt"
+  size_t num_threads;
+  double gbps;        // aggregate
+  double efficiency;  // gbps / (num_threads * single-thread gbps)
+};
+
+void PrintResults(const std::vector<Result>& results, const size_t size,
+                  const size_t num_cores, const size_t num_cpus,
+                  const std::string& format) {
+  if (format == "json") {
+    printf("{\n  \"size\": %zu,\n  \"cores\": %zu,\n  \"cpus\": %zu,\n", size,
+           num_cores, num_cpus);
+    printf("  \"results\": [");
+    for (size_t i = 0; i < results.size(); ++i) {
+      const Result& r = results[i];
+      printf("%s\n    {\"target\": \"%s\", \"placement\": \"%s\", "
+             "\"threads\": %zu, \"gb_per_s\": %.3f, \"efficiency\": %.3f}",
+             i == 0 ? "" : ",", r.target, r.placement, r.num_threads, r.gbps,
+             r.efficiency);
+    }
+    printf("\n  ]\n}\n");
+  } else if (format == "csv") {
+    printf("target,placement,threads,gb_per_s,efficiency\n");
+    for (const Result& r : results) {
+      printf("%s,%s,%zu,%.3f,%.3f\n", r.target, r.placement, r.num_threads,
+             r.gbps, r.efficiency);
+    }
+  } else {
+    printf("%zu-byte inputs, %zu cores, %zu CPUs\n", size, num_cores,
+           num_cpus);
+    printf("%-8s %-9s %7s %9s %11s %10s\n", "Target", "Placement", "Threads",
+           "GB/s", "GB/s/thread", "Efficiency");
+    for (const Result& r : results) {
+      printf("%-8s %-9s %7zu %9.3f %11.3f %9.1f%%\n", r.target, r.placement,
+             r.num_threads, r.gbps, r.gbps / r.num_threads,
+             r.efficiency * 100.0);
+    }
+  }
+}
+
+int Run(int argc, char* argv[]) {
+  size_t size = 1024;
+  size_t max_threads = 0;  // all usable CPUs
+  std::string format = "text";
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--size=", 7) == 0) {
+      size = strtoul(argv[i] + 7, nullptr, 10);
+    } else if (strncmp(argv[i], "--max_threads=", 14) == 0) {
+      max_threads = strtoul(argv[i] + 14, nullptr, 10);
+    } else if (strncmp(argv[i], "--format=", 9) == 0) {
+      format = argv[i] + 9;
+    } else {
+      fprintf(stderr,
+              "Usage: multicore_benchmark [--size=N] [--max_threads=N] "
+              "[--format=text|json|csv]\n");
+      return 1;
+    }
+  }
+  if (size == 0 || (format != "text" && format != "json" && format != "csv")) {
+    fprintf(stderr, "Invalid --size or --format\n");
+    return 1;
+  }
+
+  const std::vector<std::vector<int>> cores = CoresOfCPUs();
+  size_t num_cpus = 0;
+  for (const std::vector<int>& siblings : cores) {
+    num_cpus += siblings.size();
+  }
+  // More threads than the CPU quota allows would be throttled, which
+  // understates the efficiency of each thread.
+  const size_t num_usable = static_cast<size_t>(NumUsableCPUs());
+  if (max_threads == 0) max_threads = std::min(num_cpus, num_usable);
+  if (max_threads > num_cpus) max_threads = num_cpus;
+  if (CPUQuota() != 0.0 && format == "text") {
+    printf("CPU quota: %.2f CPUs, measuring up to %zu threads\n", CPUQuota(),
+           max_threads);
+  }
+  const bool has_siblings = num_cpus > cores.size();
+
+  std::vector<HighwayHashFunctions> all_functions;
+  InstructionSets::RunAll<CollectFunctions>(&all_functions);
+
+  std::vector<Result> results;
+  for (const HighwayHashFunctions& functions : all_functions) {
+    const char* target = TargetName(functions.target);
+    double single_gbps = 0.0;
+    for (const bool smt : {false, true}) {
+      // Without siblings, "smt" would just repeat "cores".
+      if (smt && !has_siblings) break;
+      for (size_t num_threads = 1; num_threads <= max_threads;
+           num_threads = NextThreadCount(num_threads, max_threads)) {
+        // A single thread is the same for both placements.
+        if (smt && num_threads == 1) continue;
+        const std::vector<int> cpus = ChooseCPUs(cores, num_threads, smt);
+        if (cpus.empty()) break;
+
+        Result result;
+        result.target = target;
+        result.placement = smt ? "smt" : "cores";
+        result.num_threads = num_threads;
+        result.gbps = MeasureThreads(functions, cpus, size);
+        if (num_threads == 1) single_gbps = result.gbps;
+        result.efficiency = result.gbps / (num_threads * single_gbps);
+        results.push_back(result);
+        fprintf(stderr, "%s %s %zu: %.3f GB/s\n", target, result.placement,
+                num_threads, result.gbps);
+      }
+    }
+  }
+
+  PrintResults(results, size, cores.size(), num_cpus, format);
+  return 0;
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) { return highwayhash::Run(argc, argv); }
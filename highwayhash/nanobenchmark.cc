@@ -15,11 +15,20 @@
 #include "highwayhash/nanobenchmark.h"
 
 #include <algorithm>
+#include <array>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 #include <random>
 #include <vector>
 
 #include <map>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 #include "highwayhash/os_specific.h"
 #include "highwayhash/robust_statistics.h"
 #include "highwayhash/tsc_timer.h"
@@ -112,7 +121,8 @@ Duration EstimateResolutionOnCurrentCPU(const Func func, const uint8_t* arg) {
 // Returns mode of EstimateResolutionOnCurrentCPU across all CPUs. This
 // increases repeatability because some CPUs may be throttled or slowed down by
 // interrupts.
-Duration EstimateResolution(const Func func_to_measure, const uint8_t* arg) {
+Duration EstimateResolution(const Func func_to_measure, const uint8_t* arg,
+                            const bool verbose) {
   Func func = (func_to_measure == &Func2) ? &Func1 : &Func2;
 
   const size_t kNumSamples = 512;
@@ -135,25 +145,120 @@ Duration EstimateResolution(const Func func_to_measure, const uint8_t* arg) {
   Duration* const begin = resolutions.data();
   CountingSort(begin, begin + resolutions.size());
   const Duration resolution = Mode(begin, resolutions.size());
-  printf("Resolution %lu\n", long(resolution));
+  if (verbose) fprintf(stderr, "Resolution %lu\n", long(resolution));
   return resolution;
 }
 
 // Returns ticks elapsed when running an empty region, i.e. the timer
 // resolution/overhead, which will be deducted from other measurements and
 // also used by InitReplicas.
-Duration Resolution(const Func func, const uint8_t* arg) {
+Duration Resolution(const Func func, const uint8_t* arg, const bool verbose) {
   // Initialization is expensive and should only happen once.
-  static const Duration resolution = EstimateResolution(func, arg);
+  static const Duration resolution = EstimateResolution(func, arg, verbose);
   return resolution;
 }
 
+// Order of the events in EventCounts, same as in EventsPerCall.
+enum { kInstructions, kCycles, kBranchMisses, kL1DMisses, kNumEvents };
+
+// Event counts of one measurement; only meaningful if "valid".
+struct EventCounts {
+  bool valid;
+  std::array<int64_t, kNumEvents> values;
+};
+
+// Counts hardware events of this thread in user mode as a perf_event group,
+// so that all are enabled and read together. Events the CPU or OS does not
+// support are omitted from the group.
+class EventCounters {
+ public:
+  EventCounters() {
+#if defined(__linux__)
+    const uint32_t types[kNumEvents] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    const uint64_t configs[kNumEvents] = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    for (int event = 0; event < kNumEvents; ++event) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.type = types[event];
+      attr.size = sizeof(attr);
+      attr.config = configs[event];
+      attr.disabled = fds_.empty();  // only the group leader
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      const int leader = fds_.empty() ? -1 : fds_[0];
+      const int fd = static_cast<int>(
+          syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+      if (fd < 0) continue;
+      fds_.push_back(fd);
+      events_.push_back(event);
+    }
+#endif
+  }
+
+  ~EventCounters() {
+#if defined(__linux__)
+    for (const int fd : fds_) {
+      close(fd);
+    }
+#endif
+  }
+
+  // Returns whether any event can be counted.
+  bool Any() const { return !fds_.empty(); }
+
+  // Returns whether "event" is counted.
+  bool Has(const int event) const {
+    return std::find(events_.begin(), events_.end(), event) != events_.end();
+  }
+
+  void Start() {
+#if defined(__linux__)
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  // Stores the counts since Start. They are invalid if the group was not
+  // scheduled the entire time, e.g. because other users of the PMU caused
+  // multiplexing.
+  void Stop(EventCounts* counts) {
+    counts->valid = false;
+    counts->values.fill(0);
+#if defined(__linux__)
+    ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // nr, time_enabled, time_running, values[nr].
+    uint64_t buf[3 + kNumEvents];
+    const ssize_t bytes = read(fds_[0], buf, sizeof(buf));
+    if (bytes < static_cast<ssize_t>(3 * sizeof(uint64_t))) return;
+    if (buf[0] != events_.size() || buf[1] != buf[2]) return;
+    for (size_t i = 0; i < events_.size(); ++i) {
+      counts->values[events_[i]] = static_cast<int64_t>(buf[3 + i]);
+    }
+    counts->valid = true;
+#endif
+  }
+
+ private:
+  std::vector<int> fds_;     // fds_[0] is the group leader
+  std::vector<int> events_;  // which event each of fds_ counts
+};
+
 // Returns total ticks elapsed when passing each of "inputs" (after in-place
 // shuffling) to "func", which must return something it has computed so the
-// compiler does not optimize it away.
+// compiler does not optimize it away. If "counters" is not null, also
+// stores the events during the same calls in "counts".
 Duration TotalDuration(const Duration resolution, const Func func,
                        const uint8_t* arg, std::vector<FuncInput>* inputs,
-                       std::mt19937_64* rng) {
+                       std::mt19937_64* rng,
+                       EventCounters* counters = nullptr,
+                       EventCounts* counts = nullptr) {
   // This benchmark attempts to measure the performance of "func" when
   // called with realistic inputs, which we assume are randomly drawn
   // from the given "inputs" distribution, so we shuffle those values.
@@ -161,11 +266,15 @@ Duration TotalDuration(const Duration resolution, const Func func,
     std::shuffle(inputs->begin(), inputs->end(), *rng);
   }
 
+  // Outside of the timed region; the syscalls contribute a constant number of
+  // events to all measurements, which cancels out in the differences.
+  if (counters != nullptr) counters->Start();
   const Duration t0 = Start<Duration>();
   for (const FuncInput input : *inputs) {
     PreventElision(func(arg, input));
   }
   const Duration t1 = Stop<Duration>();
+  if (counters != nullptr) counters->Stop(counts);
   const Duration elapsed = t1 - t0;
   NANOBENCHMARK_CHECK(elapsed > resolution);
   return elapsed - resolution;
@@ -181,12 +290,13 @@ class Inputs {
 
  public:
   Inputs(const Duration resolution, const std::vector<FuncInput>& distribution,
-         const Func func, const uint8_t* arg, std::mt19937_64* rng)
+         const Func func, const uint8_t* arg, std::mt19937_64* rng,
+         const bool verbose)
       : unique_(InitUnique(distribution)),
         replicas_(InitReplicas(distribution, resolution, func, arg, rng)),
         num_replicas_(replicas_.size() / distribution.size()) {
-    if (num_replicas_ != 1) {
-      printf("NumReplicas %zu\n", num_replicas_);
+    if (verbose && num_replicas_ != 1) {
+      fprintf(stderr, "NumReplicas %zu\n", num_replicas_);
     }
   }
 
@@ -327,17 +437,63 @@ class DurationSamples {
   std::map<FuncInput, std::vector<Duration>> samples_for_input_;
 };
 
+// Holds the differences in event counts between the leave-one-out
+// measurements, and reduces them to the median for each unique input value.
+class EventSamples {
+ public:
+  void Add(const FuncInput input, const EventCounts& total,
+           const EventCounts& without) {
+    if (!total.valid || !without.valid) return;
+    auto& samples = samples_for_input_[input];
+    for (int event = 0; event < kNumEvents; ++event) {
+      samples[event].push_back(
+          static_cast<double>(total.values[event] - without.values[event]));
+    }
+  }
+
+  // Returns the median of the events of each call with "input", or negative
+  // values for events that were not counted.
+  EventsPerCall PerCall(const FuncInput input, const double per_call,
+                        const EventCounters& counters) {
+    float medians[kNumEvents];
+    auto& samples = samples_for_input_[input];
+    for (int event = 0; event < kNumEvents; ++event) {
+      medians[event] = -1.0f;
+      if (counters.Has(event) && !samples[event].empty()) {
+        const double median = Median(&samples[event]) * per_call;
+        medians[event] = static_cast<float>(std::max(median, 0.0));
+      }
+    }
+    EventsPerCall events;
+    events.instructions = medians[kInstructions];
+    events.cycles = medians[kCycles];
+    events.branch_misses = medians[kBranchMisses];
+    events.l1d_misses = medians[kL1DMisses];
+    return events;
+  }
+
+ private:
+  std::map<FuncInput, std::array<std::vector<double>, kNumEvents>>
+      samples_for_input_;
+};
+
 // Gathers "num_samples" durations via repeated leave-one-out measurements.
+// If "counters" is not null, also adds the events of the same measurements
+// to "events".
 DurationSamples GatherDurationSamples(const Duration resolution, Inputs& inputs,
                                       const Func func, const uint8_t* arg,
                                       const size_t num_samples,
+                                      EventCounters* counters,
+                                      EventSamples* events,
                                       std::mt19937_64* rng) {
   DurationSamples samples(inputs.Unique(), num_samples);
+  EventCounts total_counts, without_counts;
   for (size_t i = 0; i < num_samples; ++i) {
     // Total duration for all shuffled input values. This may change over time,
     // so recompute it for each sample.
-    const Duration total =
-        TotalDuration(resolution, func, arg, &inputs.Replicas(), rng);
+    const Duration total = TotalDuration(resolution, func, arg,
+                                         &inputs.Replicas(), rng, counters,
+                                         &total_counts);
 
     for (const FuncInput input : inputs.Unique()) {
       // To isolate the durations of the calls with this input value,
@@ -345,10 +501,13 @@ DurationSamples GatherDurationSamples(const Duration resolution, Inputs& inputs,
       // from the total, and later divide by NumReplicas.
       std::vector<FuncInput> without = inputs.Without(input);
       for (int rep = 0; rep < 3; ++rep) {
-        const Duration elapsed =
-            TotalDuration(resolution, func, arg, &without, rng);
+        const Duration elapsed = TotalDuration(resolution, func, arg, &without,
+                                               rng, counters, &without_counts);
         if (elapsed < total) {
           samples.Add(input, total - elapsed);
+          if (counters != nullptr) {
+            events->Add(input, total_counts, without_counts);
+          }
           break;
         }
       }
@@ -357,12 +516,83 @@ DurationSamples GatherDurationSamples(const Duration resolution, Inputs& inputs,
   return samples;
 }
 
+// Measures one function in rounds of GatherDurationSamples, each of which
+// adds one sample per unique input value to "input_map".
+class RoundMeasurer {
+ public:
+  RoundMeasurer(const Func func, const uint8_t* arg,
+                const std::vector<FuncInput>& distribution,
+                DurationsForInputs* input_map)
+      : func_(func),
+        arg_(arg),
+        input_map_(input_map),
+        resolution_(Resolution(func, arg, input_map->verbose)),
+        // Adds enough 'replicas' of the distribution to measure "func" given
+        // the timer resolution.
+        inputs_(resolution_, distribution, func, arg, &rng_,
+                input_map->verbose),
+        per_call_(1.0 / static_cast<int>(inputs_.NumReplicas())) {
+    if (input_map->measure_events) {
+      counters_.reset(new EventCounters);
+      if (!counters_->Any()) {
+        if (input_map->verbose) {
+          fprintf(stderr, "Hardware event counters are unavailable\n");
+        }
+        counters_.reset();
+      }
+    }
+  }
+
+  void Round() {
+    auto samples = GatherDurationSamples(resolution_, inputs_, func_, arg_,
+                                         input_map_->samples_per_round,
+                                         counters_.get(), &events_, &rng_);
+    // First round: populate input_map items, then append to their arrays.
+    const bool first = (num_rounds_++ == 0);
+    DurationsForInputs* input_map = input_map_;
+    const double per_call = per_call_;
+    samples.Reduce([first, per_call, input_map](const FuncInput input,
+                                                const Duration duration) {
+      const float sample = static_cast<float>(duration * per_call);
+      if (first) {
+        input_map->AddItem(input, sample);
+      } else {
+        input_map->AddSample(input, sample);
+      }
+    });
+  }
+
+  // Stores the events per call, if requested.
+  void Finish() {
+    if (counters_ == nullptr) return;
+    for (size_t i = 0; i < input_map_->num_items; ++i) {
+      DurationsForInputs::Item& item = input_map_->items[i];
+      item.events = events_.PerCall(item.input, per_call_, *counters_);
+    }
+  }
+
+ private:
+  const Func func_;
+  const uint8_t* const arg_;
+  DurationsForInputs* const input_map_;
+  std::mt19937_64 rng_;
+  const Duration resolution_;
+  Inputs inputs_;
+  const double per_call_;
+  std::unique_ptr<EventCounters> counters_;
+  EventSamples events_;
+  size_t num_rounds_ = 0;
+};
+
 }  // namespace
 
 DurationsForInputs::DurationsForInputs(const FuncInput* inputs,
                                        const size_t num_inputs,
                                        const size_t max_durations)
     : num_items(0),
+      measure_events(false),
+      samples_per_round(512),
+      verbose(true),
       inputs_(inputs),
       num_inputs_(num_inputs),
       max_durations_(max_durations),
@@ -391,6 +621,8 @@ void DurationsForInputs::AddItem(const FuncInput input, const float sample) {
   item.input = input;
   item.num_durations = 1;
   item.durations[0] = sample;
+  item.events.instructions = item.events.cycles = -1.0f;
+  item.events.branch_misses = item.events.l1d_misses = -1.0f;
   ++num_items;
 }
 
@@ -413,39 +645,92 @@ void DurationsForInputs::Item::PrintMedianAndVariability(const double mul) {
   const float variability = MedianAbsoluteDeviation(duration_vec, median);
   printf("%5zu: median=%6.2f ticks; median abs. deviation=%6.3f ticks\n", input,
          median * mul, variability * mul);
+
+  const float counts[4] = {events.instructions, events.cycles,
+                           events.branch_misses, events.l1d_misses};
+  const char* names[4] = {"instructions", "cycles", "branch misses",
+                          "L1D misses"};
+  bool any = false;
+  for (int i = 0; i < 4; ++i) {
+    if (counts[i] < 0.0f) continue;
+    printf("%s%s=%.2f", any ? "; " : "       ", names[i], counts[i]);
+    any = true;
+  }
+  if (any) printf("\n");
 }
 
 void MeasureDurations(const Func func, DurationsForInputs* input_map,
                       const uint8_t* arg) {
-  std::mt19937_64 rng;
-  const Duration resolution = Resolution(func, arg);
-
-  // Adds enough 'replicas' of the distribution to measure "func" given
-  // the timer resolution.
   const std::vector<FuncInput> distribution(
       input_map->inputs_, input_map->inputs_ + input_map->num_inputs_);
-  Inputs inputs(resolution, distribution, func, arg, &rng);
-  const double per_call = 1.0 / static_cast<int>(inputs.NumReplicas());
-
-  // First iteration: populate input_map items.
-  auto samples =
-      GatherDurationSamples(resolution, inputs, func, arg, 512, &rng);
-  samples.Reduce(
-      [per_call, input_map](const FuncInput input, const Duration duration) {
-        const float sample = static_cast<float>(duration * per_call);
-        input_map->AddItem(input, sample);
-      });
-
-  // Subsequent iteration(s): append to input_map items' array.
-  for (size_t rep = 1; rep < input_map->max_durations_; ++rep) {
-    auto samples =
-        GatherDurationSamples(resolution, inputs, func, arg, 512, &rng);
-    samples.Reduce(
-        [per_call, input_map](const FuncInput input, const Duration duration) {
-          const float sample = static_cast<float>(duration * per_call);
-          input_map->AddSample(input, sample);
-        });
+  RoundMeasurer measurer(func, arg, distribution, input_map);
+  for (size_t rep = 0; rep < input_map->max_durations_; ++rep) {
+    measurer.Round();
+  }
+  measurer.Finish();
+}
+
+size_t CompareDurations(const Func func_a, const Func func_b,
+                        DurationsForInputs* input_map_a,
+                        DurationsForInputs* input_map_b,
+                        DurationComparison* comparisons,
+                        const uint8_t* arg_a, const uint8_t* arg_b) {
+  NANOBENCHMARK_CHECK(input_map_a->num_inputs_ == input_map_b->num_inputs_);
+  NANOBENCHMARK_CHECK(input_map_a->max_durations_ ==
+                      input_map_b->max_durations_);
+  const std::vector<FuncInput> distribution(
+      input_map_a->inputs_, input_map_a->inputs_ + input_map_a->num_inputs_);
+  RoundMeasurer a(func_a, arg_a, distribution, input_map_a);
+  RoundMeasurer b(func_b, arg_b, distribution, input_map_b);
+  for (size_t rep = 0; rep < input_map_a->max_durations_; ++rep) {
+    if (rep % 2 == 0) {
+      a.Round();
+      b.Round();
+    } else {
+      b.Round();
+      a.Round();
+    }
+  }
+  a.Finish();
+  b.Finish();
+
+  // Both maps have the same unique inputs, but look them up to be safe.
+  size_t num_comparisons = 0;
+  for (size_t i = 0; i < input_map_a->num_items; ++i) {
+    const DurationsForInputs::Item& item_a = input_map_a->items[i];
+    for (size_t j = 0; j < input_map_b->num_items; ++j) {
+      const DurationsForInputs::Item& item_b = input_map_b->items[j];
+      if (item_b.input != item_a.input) continue;
+
+      // Ratios of adjacent rounds cancel drift between rounds.
+      const size_t num_pairs =
+          std::min(item_a.num_durations, item_b.num_durations);
+      std::vector<float> changes;
+      for (size_t k = 0; k < num_pairs; ++k) {
+        if (item_a.durations[k] <= 0.0f) continue;
+        changes.push_back((item_b.durations[k] - item_a.durations[k]) /
+                          item_a.durations[k]);
+      }
+      std::vector<float> durations_a(item_a.durations,
+                                     item_a.durations + item_a.num_durations);
+      std::vector<float> durations_b(item_b.durations,
+                                     item_b.durations + item_b.num_durations);
+
+      DurationComparison& comparison = comparisons[num_comparisons++];
+      comparison.input = item_a.input;
+      comparison.median_a = Median(&durations_a);
+      comparison.median_b = Median(&durations_b);
+      if (changes.empty()) {
+        comparison.change = comparison.change_lower = 0.0f;
+        comparison.change_upper = 0.0f;
+      } else {
+        comparison.change = Median(&changes);
+        MedianConfidenceInterval(changes, &comparison.change_lower,
+                                 &comparison.change_upper);
+      }
+    }
   }
+  return num_comparisons;
 }
 
 }  // namespace highwayhash
@@ -93,18 +93,42 @@ using FuncOutput = uint64_t;
 // with captures) to this kind of function pointer.
 using Func = FuncOutput (*)(const void*, FuncInput);
 
+// Hardware events per call of the function being measured, or negative if
+// unavailable (e.g. not Linux, a VM, or forbidden by perf_event_paranoid).
+struct EventsPerCall {
+  float instructions;
+  float cycles;         // core clock cycles (PMU cycles on ARM), not ticks
+  float branch_misses;  // mispredicted branches
+  float l1d_misses;     // L1 data cache read misses
+};
+
+// Result of CompareDurations for one unique input value.
+struct DurationComparison {
+  FuncInput input;
+  float median_a;  // ticks per call of "func_a"
+  float median_b;  // ticks per call of "func_b"
+  // Relative change of B versus A, i.e. (b - a) / a, as the median across
+  // pairs of adjacent rounds, and its 95% confidence interval. B is slower
+  // with high confidence if change_lower > 0.
+  float change;
+  float change_lower;
+  float change_upper;
+};
+
 // Flat map of input -> durations[]. NOTE: durations are 'ticks' (tsc_timer.h);
 // convert to seconds via division by InvariantTicksPerSecond.
 class DurationsForInputs {
  public:
   struct Item {
     // The optional "mul" scaling factor is applied to median and variability
-    // (useful for reporting cycles per byte etc.)
+    // (useful for reporting cycles per byte etc.) but not to the events,
+    // which are also printed if available.
     void PrintMedianAndVariability(const double mul = 1.0);
 
     FuncInput input;       // read-only (set by AddItem).
     size_t num_durations;  // written so far: [0, max_durations).
     float* durations;      // max_durations entries; points into all_durations.
+    EventsPerCall events;  // medians; only measured if measure_events.
   };
 
   // "inputs" is an array of "num_inputs" (not necessarily unique) arguments to
@@ -136,8 +160,25 @@ class DurationsForInputs {
   Item* items;       // owned by this class, do not allocate/free.
   size_t num_items;  // safe to reset to zero.
 
+  // Whether MeasureDurations also counts hardware events (Linux
+  // perf_event_open) during the same measurements. Defaults to false because
+  // reading the counters makes the measurements slower.
+  bool measure_events;
+
+  // Leave-one-out samples per round, whose mode is the duration of each
+  // round. Defaults to 512; fewer are faster but less precise, e.g. for
+  // one-time calibration at startup.
+  size_t samples_per_round;
+
+  // Whether to print diagnostics (e.g. the timer resolution) to stderr.
+  // Defaults to true; false is useful for measuring in the background.
+  bool verbose;
+
  private:
   friend void MeasureDurations(Func, DurationsForInputs*, const uint8_t*);
+  friend size_t CompareDurations(Func, Func, DurationsForInputs*,
+                                 DurationsForInputs*, DurationComparison*,
+                                 const uint8_t*, const uint8_t*);
 
   const FuncInput* const inputs_;
   const size_t num_inputs_;
@@ -156,11 +197,30 @@ static HH_INLINE DurationsForInputs MakeDurationsForInputs(
 // elapsed when calling "func" with each unique input value in "input_map",
 // taking special care to maintain realistic branch prediction hit rates.
 //
+// If input_map->measure_events, also stores the hardware events per call in
+// each item's "events", or negative values if the counters are unavailable.
+//
 // "func" returns a 'proof of work' to ensure its computations are not elided.
 // "arg*" are for use by MeasureClosureDurations.
 void MeasureDurations(const Func func, DurationsForInputs* input_map,
                       const uint8_t* arg = nullptr);
 
+// A/B comparison: measures "func_a" and "func_b" like MeasureDurations, but in
+// interleaved rounds (ABBA order) on the same inputs, so that slow drifts such
+// as frequency changes affect both equally. Each round yields the mode (see
+// robust_statistics.h) of many leave-one-out samples per input. "input_map_b"
+// must have been constructed with the same arguments as "input_map_a"; both
+// receive the durations of their function.
+//
+// Writes one DurationComparison per unique input value to "comparisons",
+// which must have room for the number of inputs, and returns how many.
+size_t CompareDurations(const Func func_a, const Func func_b,
+                        DurationsForInputs* input_map_a,
+                        DurationsForInputs* input_map_b,
+                        DurationComparison* comparisons,
+                        const uint8_t* arg_a = nullptr,
+                        const uint8_t* arg_b = nullptr);
+
 namespace HH_TARGET_NAME {
 // Calls operator() of the given closure (lambda function).
 template <class Closure>
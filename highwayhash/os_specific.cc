@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <random>
 
@@ -34,8 +35,11 @@
 
 #ifdef __linux__
 #define OS_LINUX 1
+#include <dirent.h>
 #include <sched.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <unistd.h>
 #else
 #define OS_LINUX 0
 #endif
@@ -257,4 +261,266 @@ void PinThreadToRandomCPU() {
 #endif
 }
 
+void PinThreadToCPUs(const std::vector<int>& cpus) {
+  CHECK(!cpus.empty());
+  ThreadAffinity affinity;
+#if OS_WIN
+  // The mask only covers the CPUs of the current processor group, which are
+  // also the only ones returned by AvailableCPUs. Skip any others rather than
+  // shifting by their (too large) number.
+  const int kMaskBits = static_cast<int>(sizeof(affinity.mask) * 8);
+  affinity.mask = 0;
+  for (const int cpu : cpus) {
+    if (cpu < kMaskBits) {
+      affinity.mask |= DWORD_PTR(1) << cpu;
+    }
+  }
+  CHECK(affinity.mask != 0);
+#elif OS_LINUX || OS_FREEBSD || OS_MAC
+  CPU_ZERO(&affinity.set);
+  for (const int cpu : cpus) {
+    CPU_SET(cpu, &affinity.set);
+  }
+#else
+#error "port"
+#endif
+  SetThreadAffinity(&affinity);
+}
+
+namespace {
+
+#if OS_LINUX
+
+// Returns the contents of a small sysfs file as an integer, or -1.
+int ReadSysInt(const char* format, const int cpu) {
+  char path[128];
+  snprintf(path, sizeof(path), format, cpu);
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return -1;
+  int value = -1;
+  if (fscanf(f, "%d", &value) != 1) value = -1;
+  fclose(f);
+  return value;
+}
+
+// Returns the N of the "nodeN" link in the CPU's sysfs directory, or -1.
+int ReadSysNode(const int cpu) {
+  char path[128];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR* dir = opendir(path);
+  if (dir == nullptr) return -1;
+  int node = -1;
+  while (const dirent* entry = readdir(dir)) {
+    int number;
+    if (sscanf(entry->d_name, "node%d", &number) == 1) {
+      node = number;
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+// Returns the CPU limit of a cgroup v2 "cpu.max" file ("$QUOTA $PERIOD" in
+// microseconds, or "max $PERIOD"), or 0 if unlimited or not found.
+double ReadCpuMax(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == nullptr) return 0.0;
+  char quota[32];
+  long long period = 0;
+  double limit = 0.0;
+  if (fscanf(f, "%31s %lld", quota, &period) == 2 && period > 0 &&
+      strcmp(quota, "max") != 0) {
+    limit = strtoll(quota, nullptr, 10) / static_cast<double>(period);
+  }
+  fclose(f);
+  return limit;
+}
+
+// Returns the CPU limit of the cgroup v1 "dir" from its cpu.cfs_quota_us
+// (-1 if unlimited) and cpu.cfs_period_us, or 0 if unlimited or not found.
+double ReadCfsQuota(const char* dir) {
+  char path[544];  // "dir" is at most 511 characters
+  snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+  long long quota = -1;
+  if (FILE* f = fopen(path, "r")) {
+    if (fscanf(f, "%lld", &quota) != 1) quota = -1;
+    fclose(f);
+  }
+  snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+  long long period = 0;
+  if (FILE* f = fopen(path, "r")) {
+    if (fscanf(f, "%lld", &period) != 1) period = 0;
+    fclose(f);
+  }
+  return (quota > 0 && period > 0) ? quota / static_cast<double>(period) : 0.0;
+}
+
+// Returns the smallest nonzero limit of "limit" and "other".
+double MinLimit(const double limit, const double other) {
+  if (other == 0.0) return limit;
+  return (limit == 0.0 || other < limit) ? other : limit;
+}
+
+// Returns the CPU limit of this process' cgroup (and its ancestors, which
+// also apply), or 0 if unlimited. /proc/self/cgroup lists "0::$PATH" for
+// cgroup v2 and "$ID:$CONTROLLERS:$PATH" for v1. Within a container, the
+// cgroup namespace usually makes $PATH "/", i.e. the root of the mount.
+double CgroupCPULimit() {
+  FILE* f = fopen("/proc/self/cgroup", "r");
+  if (f == nullptr) return 0.0;
+  double limit = 0.0;
+  char line[512];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    line[strcspn(line, "\n")] = '\0';
+    char* controllers = strchr(line, ':');
+    char* cgroup =
+        controllers == nullptr ? nullptr : strchr(controllers + 1, ':');
+    if (cgroup == nullptr) continue;
+    *cgroup++ = '\0';
+    ++controllers;
+
+    if (strcmp(cgroup, "/") == 0) *cgroup = '\0';  // root of the mount
+
+    char path[512];
+    if (strcmp(line, "0") == 0 && *controllers == '\0') {
+      // v2: the limits of the cgroup and each of its ancestors.
+      for (char* end = cgroup + strlen(cgroup); end != nullptr;
+           end = strrchr(cgroup, '/')) {
+        *end = '\0';
+        snprintf(path, sizeof(path), "/sys/fs/cgroup%s/cpu.max", cgroup);
+        limit = MinLimit(limit, ReadCpuMax(path));
+      }
+      continue;
+    }
+
+    // v1: the "cpu" controller, mounted as "cpu" or "cpu,cpuacct".
+    bool has_cpu = false;
+    char* rest = nullptr;
+    for (char* name = strtok_r(controllers, ",", &rest); name != nullptr;
+         name = strtok_r(nullptr, ",", &rest)) {
+      has_cpu |= strcmp(name, "cpu") == 0;
+    }
+    if (!has_cpu) continue;
+    // As above, the cgroup and each of its ancestors (hierarchies are nested
+    // directories of the mount).
+    for (char* end = cgroup + strlen(cgroup); end != nullptr;
+         end = strrchr(cgroup, '/')) {
+      *end = '\0';
+      snprintf(path, sizeof(path), "/sys/fs/cgroup/cpu%s", cgroup);
+      limit = MinLimit(limit, ReadCfsQuota(path));
+    }
+  }
+  fclose(f);
+  return limit;
+}
+
+#endif  // OS_LINUX
+
+#if HH_ARCH_X64
+
+// Sets package and core from the x2APIC ID of the current CPU. Returns false
+// if CPUID leaf 0xB is not supported.
+bool TopologyFromApicId(CPUTopology* topology) {
+  uint32_t abcd[4];
+  Cpuid(0, 0, abcd);
+  if (abcd[0] < 0xB) return false;
+  // Subleaf 0 describes SMT, subleaf 1 the cores. EAX[4:0] are the number of
+  // low x2APIC ID bits to remove to obtain the ID of the next higher level.
+  Cpuid(0xB, 0, abcd);
+  const uint32_t smt_shift = abcd[0] & 0x1F;
+  const uint32_t x2apic_id = abcd[3];
+  if (smt_shift == 0 && abcd[1] == 0) return false;  // leaf is invalid
+  Cpuid(0xB, 1, abcd);
+  const uint32_t core_shift = abcd[0] & 0x1F;
+  topology->package = static_cast<int>(x2apic_id >> core_shift);
+  topology->core = static_cast<int>(x2apic_id >> smt_shift);
+  return true;
+}
+
+#endif  // HH_ARCH_X64
+
+}  // namespace
+
+std::vector<CPUTopology> AvailableCPUTopology() {
+  const std::vector<int> cpus = AvailableCPUs();
+  std::vector<CPUTopology> topology;
+  topology.reserve(cpus.size());
+  for (const int cpu : cpus) {
+    CPUTopology location = {cpu, -1, -1, -1};
+#if OS_LINUX
+    location.package = ReadSysInt(
+        "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    location.core =
+        ReadSysInt("/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    location.node = ReadSysNode(cpu);
+#endif
+    topology.push_back(location);
+  }
+
+#if HH_ARCH_X64
+  bool any_unknown = false;
+  for (const CPUTopology& location : topology) {
+    any_unknown |= location.package < 0 || location.core < 0;
+  }
+  if (any_unknown) {
+    ThreadAffinity* original = GetThreadAffinity();
+    for (CPUTopology& location : topology) {
+      PinThreadToCPU(location.cpu);
+      if (!TopologyFromApicId(&location)) break;
+    }
+    SetThreadAffinity(original);
+    free(original);
+  }
+#endif
+
+  for (CPUTopology& location : topology) {
+    if (location.package < 0 || location.core < 0) {
+      location.package = 0;
+      location.core = location.cpu;
+    }
+    if (location.node < 0) {
+      location.node = location.package;
+    }
+  }
+  return topology;
+}
+
+double CPUQuota() {
+#if OS_LINUX
+  static const double quota = CgroupCPULimit();
+  return quota;
+#else
+  return 0.0;
+#endif
+}
+
+int NumUsableCPUs() {
+  static const int num_cpus = [] {
+    int num = static_cast<int>(AvailableCPUs().size());
+    const double quota = CPUQuota();
+    // Rounding down avoids exceeding the quota (which would be throttled).
+    if (quota != 0.0 && quota < num) num = static_cast<int>(quota);
+    return std::max(num, 1);
+  }();
+  return num_cpus;
+}
+
+int NodeOfAddress(const void* address) {
+#if OS_LINUX && defined(SYS_move_pages)
+  const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) &
+                                       ~(page_size - 1));
+  // Without target nodes, move_pages only reports the current node.
+  int status = -1;
+  if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0) {
+    return -1;
+  }
+  return status < 0 ? -1 : status;
+#else
+  (void)address;
+  return -1;
+#endif
+}
+
 }  // namespace highwayhash
@@ -31,6 +31,17 @@ void RaiseThreadPriority();
 // thread's initial affinity (unaffected by any SetThreadAffinity).
 std::vector<int> AvailableCPUs();
 
+// Returns the number of CPUs this process may fully use, as limited by the
+// quota of its cgroup (e.g. CPU limits of a container), or 0 if unlimited.
+// Uses cgroup v2 cpu.max, or v1 cpu.cfs_quota_us, on Linux. The result is
+// computed once, so later changes to the quota are not reflected.
+double CPUQuota();
+
+// Returns the number of threads that can run concurrently without exceeding
+// the affinity mask or CPUQuota (rounded down): the default size of
+// ThreadPool and benchmarks. At least 1.
+int NumUsableCPUs();
+
 // Opaque.
 struct ThreadAffinity;
 
@@ -49,6 +60,28 @@ void PinThreadToCPU(const int cpu);
 // Uses SetThreadAffinity.
 void PinThreadToRandomCPU();
 
+// Allows the thread to run on any of the specified cpus, e.g. all CPUs of one
+// NUMA node. Precondition: "cpus" is not empty. Uses SetThreadAffinity.
+void PinThreadToCPUs(const std::vector<int>& cpus);
+
+// Location of an available CPU within the system.
+struct CPUTopology {
+  int cpu;      // as returned by AvailableCPUs
+  int package;  // socket
+  int core;     // SMT siblings have the same package and core
+  int node;     // NUMA node whose memory is closest
+};
+
+// Returns the location of each of AvailableCPUs(). Uses /sys on Linux. If
+// that is unavailable on x86, derives package and core from the x2APIC ID of
+// each CPU (briefly pinning the calling thread to it) and assumes one node per
+// package. Otherwise, each CPU is reported as its own core, all on node 0.
+std::vector<CPUTopology> AvailableCPUTopology();
+
+// Returns the NUMA node of the memory backing "address", or -1 if unknown
+// (e.g. the page has not yet been touched, or the OS lacks support).
+int NodeOfAddress(const void* address);
+
 }  // namespace highwayhash
 
 #endif  // HIGHWAYHASH_OS_SPECIFIC_H_
@@ -0,0 +1,307 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_PIPELINE_H_
+#define HIGHWAYHASH_PIPELINE_H_
+
+// Producer/consumer pipelines on top of ThreadPool: stages (e.g. read,
+// decompress, hash, write) run concurrently and pass elements through bounded
+// queues, so that no stage waits for a barrier after the previous one.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>  //NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  //NOLINT
+#include <utility>
+#include <vector>
+
+#include "highwayhash/data_parallel.h"
+
+namespace highwayhash {
+
+// Bounded multi-producer, multi-consumer FIFO queue. TryPush/TryPop are
+// lock-free: each slot has a sequence number that tells producers and
+// consumers whether it is free or full (Vyukov's bounded MPMC queue), so a
+// single producer and consumer only contend for the slot they both access.
+// Push/Pop spin briefly before blocking on a condition variable, which only
+// costs a mutex if a thread is actually blocked. "T" must be default-
+// constructible and movable; queues of pointers or indices are cheapest.
+template <typename T>
+class BoundedQueue {
+ public:
+  // "capacity" is rounded up to a power of two (at least 2).
+  explicit BoundedQueue(const size_t capacity)
+      : mask_(RoundUpToPow2(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // Returns false if the queue is full; "value" is then unchanged.
+  bool TryPush(T* value) {
+    size_t pos = push_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (push_pos_.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // not yet popped since the previous lap
+      } else {
+        pos = push_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(*value);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if the queue is empty.
+  bool TryPop(T* value) {
+    size_t pos = pop_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (pop_pos_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // not yet pushed
+      } else {
+        pos = pop_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    *value = std::move(slot->value);
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Blocks while the queue is full. Returns false if it is still full after
+  // Close, which indicates a bug because producers must not Push after Close.
+  bool Push(T value) {
+    const bool pushed = Wait(&num_blocked_pushers_, &not_full_,
+                             [this, &value]() { return TryPush(&value); });
+    if (pushed) Wake(&num_blocked_poppers_, &not_empty_);
+    return pushed;
+  }
+
+  // Blocks while the queue is empty and not closed. Returns false once the
+  // queue is closed and empty.
+  bool Pop(T* value) {
+    const bool popped = Wait(&num_blocked_poppers_, &not_empty_,
+                             [this, value]() { return TryPop(value); });
+    if (popped) Wake(&num_blocked_pushers_, &not_full_);
+    return popped;
+  }
+
+  // Indicates that all producers are finished. Consumers still receive the
+  // remaining elements; subsequent Pop of an empty queue returns false
+  // instead of blocking.
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_.store(true, std::memory_order_release);
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+ private:
+  // Spin iterations before blocking; on the order of the futex wakeup
+  // latency. As in ThreadPool, spinning only helps if the other side of the
+  // queue can run at the same time.
+  static constexpr int kSpinIterations = 2000;
+
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUpToPow2(const size_t capacity) {
+    size_t pow2 = 2;
+    while (pow2 < capacity) pow2 *= 2;
+    return pow2;
+  }
+
+  // Returns true once "attempt" succeeds, or false if it fails after the
+  // queue was closed. Elements pushed before Close are visible to an attempt
+  // after observing closed_.
+  template <class Attempt>
+  bool Wait(std::atomic<int>* num_blocked, std::condition_variable* cv,
+            const Attempt& attempt) {
+    for (int spin = 0; spin < spin_iterations_; ++spin) {
+      if (attempt()) return true;
+      if (closed_.load(std::memory_order_acquire)) return attempt();
+      ThreadPool::Pause();
+    }
+
+    // Wake reads num_blocked after its push/pop, and we attempt again after
+    // incrementing it, so at least one of us sees the other's update. Holding
+    // the mutex until waiting ensures the notification is not missed.
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_blocked->fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool success;
+    for (;;) {
+      if ((success = attempt())) break;
+      if (closed_.load(std::memory_order_acquire)) {
+        success = attempt();
+        break;
+      }
+      cv->wait(lock);
+    }
+    num_blocked->fetch_sub(1);
+    return success;
+  }
+
+  // Called after a successful push/pop to unblock a thread waiting for it.
+  void Wake(std::atomic<int>* num_blocked, std::condition_variable* cv) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_blocked->load(std::memory_order_relaxed) != 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cv->notify_one();
+    }
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  const int spin_iterations_ = NumUsableCPUs() > 1 ? kSpinIterations : 0;
+
+  // Separate cache lines avoid false sharing between producers and consumers.
+  alignas(64) std::atomic<size_t> push_pos_{0};
+  alignas(64) std::atomic<size_t> pop_pos_{0};
+
+  alignas(64) std::atomic<bool> closed_{false};
+  std::atomic<int> num_blocked_pushers_{0};
+  std::atomic<int> num_blocked_poppers_{0};
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
+
+// Runs the stages of a pipeline concurrently on a ThreadPool. Each stage
+// consists of one or more workers (each a task of the pool) that typically
+// Pop from the previous stage's queue until it returns false and Push their
+// results into the next queue. When all workers of a stage have returned,
+// its output queue is closed, which shuts down the next stage.
+//
+// Elements passed between stages with one worker each remain in order
+// (e.g. for HighwayHashCatT, which must see them in order); stages with more
+// workers are useful for independent elements, e.g. decompressing blocks.
+//
+// Usage:
+// BoundedQueue<Block*> read(16), decompressed(16);
+// Pipeline pipeline(&pool);
+// pipeline.AddStage(1, [&](int) { while (Block* b = Read()) read.Push(b); },
+//                   &read);
+// pipeline.AddStage(2, [&](int) {
+//   Block* b;
+//   while (read.Pop(&b)) decompressed.Push(Decompress(b));
+// }, &decompressed);
+// pipeline.AddStage(1, [&](int) {
+//   Block* b;
+//   while (decompressed.Pop(&b)) cat.Append(b->data, b->size);
+// });
+// pipeline.Run();
+class Pipeline {
+ public:
+  // "pool" must outlive the pipeline.
+  explicit Pipeline(ThreadPool* pool) : pool_(pool) {}
+
+  // Adds a stage in which func(worker) is called for each worker in
+  // [0, num_workers), concurrently. "output" (if not null) is closed after all
+  // of them have returned.
+  template <class Func, typename T>
+  void AddStage(const int num_workers, const Func& func,
+                BoundedQueue<T>* output) {
+    DATA_PARALLEL_CHECK(num_workers > 0);
+    Stage stage;
+    stage.num_workers = num_workers;
+    stage.func = func;
+    if (output != nullptr) {
+      stage.close = [output]() { output->Close(); };
+    }
+    stages_.push_back(std::move(stage));
+  }
+
+  // Adds a final stage without an output queue.
+  template <class Func>
+  void AddStage(const int num_workers, const Func& func) {
+    AddStage(num_workers, func, static_cast<BoundedQueue<int>*>(nullptr));
+  }
+
+  // Runs all stages and returns after all of their workers have returned.
+  // The calling thread runs one of the workers; each of the others needs a
+  // thread of the pool, because a blocked worker occupies its thread. Call at
+  // most once, because the queues remain closed afterwards. Not thread-safe
+  // with respect to Run of the same pool.
+  void Run() {
+    int num_tasks = 0;
+    for (const Stage& stage : stages_) {
+      num_tasks += stage.num_workers;
+    }
+    DATA_PARALLEL_CHECK(num_tasks <= pool_->NumThreads() + 1);
+
+    std::vector<std::atomic<int>> num_running(stages_.size());
+    std::vector<std::function<void(void)>> tasks;
+    tasks.reserve(num_tasks);
+    for (size_t i = 0; i < stages_.size(); ++i) {
+      const Stage& stage = stages_[i];
+      num_running[i].store(stage.num_workers);
+      std::atomic<int>* running = &num_running[i];
+      for (int worker = 0; worker < stage.num_workers; ++worker) {
+        tasks.push_back([&stage, running, worker]() {
+          stage.func(worker);
+          if (running->fetch_sub(1) == 1 && stage.close) {
+            stage.close();
+          }
+        });
+      }
+    }
+    // Fewer tasks than twice the threads are reserved one at a time, so each
+    // runs on a different thread.
+    pool_->SubmitTasks(std::move(tasks)).Wait();
+  }
+
+ private:
+  struct Stage {
+    int num_workers;
+    std::function<void(int)> func;
+    std::function<void(void)> close;  // empty for the last stage
+  };
+
+  ThreadPool* const pool_;
+  std::vector<Stage> stages_;
+};
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_PIPELINE_H_
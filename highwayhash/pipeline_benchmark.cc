@@ -0,0 +1,286 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the end-to-end throughput of read -> decompress -> hash -> write
+// of a run-length encoded temporary file, either in batches with a barrier
+// after each stage (ThreadPool::Run) or as a Pipeline whose stages overlap.
+// The hash is an incremental HighwayHash256 (HighwayHashCatT) of the
+// decompressed blocks, in order.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>  //NOLINT
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "highwayhash/data_parallel.h"
+#include "highwayhash/highwayhash_dispatch.h"
+#include "highwayhash/os_specific.h"
+#include "highwayhash/pipeline.h"
+
+namespace highwayhash {
+namespace {
+
+const HHKey kKey = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL,
+                    0x1716151413121110ULL, 0x1F1E1D1C1B1A1918ULL};
+
+const size_t kBlockSize = 64 * 1024;  // decompressed
+const int kNumBlocks = 1024;
+// Blocks in flight: the batch size, or the number of buffers for the
+// pipeline, hence the same memory for both.
+const int kNumBuffers = 16;
+
+// Run-length encoding: (count, byte) pairs with count in [1, 255].
+std::vector<uint8_t> Compress(const uint8_t* bytes, const size_t size) {
+  std::vector<uint8_t> compressed;
+  for (size_t i = 0; i < size;) {
+    size_t run = 1;
+    while (i + run < size && run < 255 && bytes[i + run] == bytes[i]) ++run;
+    compressed.push_back(static_cast<uint8_t>(run));
+    compressed.push_back(bytes[i]);
+    i += run;
+  }
+  return compressed;
+}
+
+size_t Decompress(const uint8_t* compressed, const size_t size,
+                  uint8_t* bytes) {
+  size_t pos = 0;
+  for (size_t i = 0; i + 1 < size; i += 2) {
+    memset(bytes + pos, compressed[i + 1], compressed[i]);
+    pos += compressed[i];
+  }
+  return pos;
+}
+
+// One block in flight.
+struct Buffer {
+  int index;
+  size_t compressed_size;
+  std::vector<uint8_t> compressed;
+  std::vector<uint8_t> bytes;
+};
+
+// The run-length encoded input file and where its blocks are.
+struct Input {
+  FILE* file;
+  std::vector<long> offsets;  // kNumBlocks + 1
+  size_t max_compressed;
+  HHResult256 expected;  // HighwayHash256 of the decompressed input
+};
+
+Input MakeInput() {
+  Input input;
+  input.file = tmpfile();
+  if (input.file == nullptr) {
+    perror("tmpfile");
+    abort();
+  }
+
+  // Runs of random length, so that decompression costs more than reading.
+  std::mt19937 rng(123);
+  std::vector<uint8_t> all(kNumBlocks * kBlockSize);
+  for (size_t i = 0; i < all.size();) {
+    const size_t run = std::min<size_t>(1 + rng() % 48, all.size() - i);
+    memset(all.data() + i, static_cast<int>(rng()), run);
+    i += run;
+  }
+  HighwayHashDispatch().hash256(kKey, reinterpret_cast<const char*>(all.data()),
+                                all.size(), &input.expected);
+
+  input.offsets.push_back(0);
+  input.max_compressed = 0;
+  for (int i = 0; i < kNumBlocks; ++i) {
+    const std::vector<uint8_t> compressed =
+        Compress(all.data() + i * kBlockSize, kBlockSize);
+    fwrite(compressed.data(), 1, compressed.size(), input.file);
+    input.offsets.push_back(input.offsets.back() + compressed.size());
+    input.max_compressed = std::max(input.max_compressed, compressed.size());
+  }
+  fflush(input.file);
+  return input;
+}
+
+void Read(const Input& input, Buffer* buffer) {
+  const int i = buffer->index;
+  buffer->compressed_size = input.offsets[i + 1] - input.offsets[i];
+  fseek(input.file, input.offsets[i], SEEK_SET);
+  if (fread(buffer->compressed.data(), 1, buffer->compressed_size,
+            input.file) != buffer->compressed_size) {
+    perror("fread");
+    abort();
+  }
+}
+
+void DecompressBuffer(Buffer* buffer) {
+  const size_t size = Decompress(buffer->compressed.data(),
+                                 buffer->compressed_size, buffer->bytes.data());
+  if (size != kBlockSize) abort();
+}
+
+void Write(FILE* output, const Buffer& buffer) {
+  fseek(output, static_cast<long>(buffer.index * kBlockSize), SEEK_SET);
+  fwrite(buffer.bytes.data(), 1, kBlockSize, output);
+}
+
+std::vector<Buffer> MakeBuffers(const Input& input) {
+  std::vector<Buffer> buffers(kNumBuffers);
+  for (Buffer& buffer : buffers) {
+    buffer.compressed.resize(input.max_compressed);
+    buffer.bytes.resize(kBlockSize);
+  }
+  return buffers;
+}
+
+// Reads and writes on the calling thread, decompresses each batch with
+// ThreadPool::Run, then hashes it.
+void RunBarrier(const Input& input, FILE* output, ThreadPool* pool,
+                HHResult256* hash) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  HighwayHashCatStorage cat;
+  functions.cat_start(kKey, &cat);
+  std::vector<Buffer> buffers = MakeBuffers(input);
+  for (int first = 0; first < kNumBlocks; first += kNumBuffers) {
+    for (int i = 0; i < kNumBuffers; ++i) {
+      buffers[i].index = first + i;
+      Read(input, &buffers[i]);
+    }
+    pool->Run(0, kNumBuffers,
+              [&buffers](const int i) { DecompressBuffer(&buffers[i]); });
+    for (const Buffer& buffer : buffers) {
+      functions.cat_append(&cat,
+                           reinterpret_cast<const char*>(buffer.bytes.data()),
+                           kBlockSize);
+    }
+    for (const Buffer& buffer : buffers) {
+      Write(output, buffer);
+    }
+  }
+  functions.cat_finish256(&cat, hash);
+}
+
+// Same stages, connected by queues. Free buffers circulate from the writer
+// back to the reader.
+void RunPipeline(const Input& input, FILE* output, ThreadPool* pool,
+                 const int num_decompressors, HHResult256* hash) {
+  const HighwayHashFunctions& functions = HighwayHashDispatch();
+  std::vector<Buffer> buffers = MakeBuffers(input);
+  BoundedQueue<Buffer*> free_buffers(kNumBuffers);
+  BoundedQueue<Buffer*> read(kNumBuffers);
+  BoundedQueue<Buffer*> decompressed(kNumBuffers);
+  BoundedQueue<Buffer*> hashed(kNumBuffers);
+  for (Buffer& buffer : buffers) {
+    free_buffers.Push(&buffer);
+  }
+
+  Pipeline pipeline(pool);
+  pipeline.AddStage(1, [&](int) {
+    for (int i = 0; i < kNumBlocks; ++i) {
+      Buffer* buffer = nullptr;
+      free_buffers.Pop(&buffer);
+      buffer->index = i;
+      Read(input, buffer);
+      read.Push(buffer);
+    }
+  }, &read);
+  pipeline.AddStage(num_decompressors, [&](int) {
+    Buffer* buffer = nullptr;
+    while (read.Pop(&buffer)) {
+      DecompressBuffer(buffer);
+      decompressed.Push(buffer);
+    }
+  }, &decompressed);
+  // Decompressors may finish out of order; hash in order.
+  pipeline.AddStage(1, [&](int) {
+    HighwayHashCatStorage cat;
+    functions.cat_start(kKey, &cat);
+    std::vector<Buffer*> pending(kNumBlocks, nullptr);
+    int next = 0;
+    Buffer* buffer = nullptr;
+    while (decompressed.Pop(&buffer)) {
+      pending[buffer->index] = buffer;
+      for (; next < kNumBlocks && pending[next] != nullptr; ++next) {
+        functions.cat_append(
+            &cat, reinterpret_cast<const char*>(pending[next]->bytes.data()),
+            kBlockSize);
+        hashed.Push(pending[next]);
+      }
+    }
+    functions.cat_finish256(&cat, hash);
+  }, &hashed);
+  pipeline.AddStage(1, [&](int) {
+    Buffer* buffer = nullptr;
+    while (hashed.Pop(&buffer)) {
+      Write(output, *buffer);
+      free_buffers.Push(buffer);
+    }
+  });
+  pipeline.Run();
+}
+
+// Prints the best throughput of "func" over several repetitions.
+template <class Func>
+void Measure(const char* caption, const Input& input, const Func& func) {
+  double best = 1E10;
+  for (int rep = 0; rep < 5; ++rep) {
+    HHResult256 hash;
+    const auto t0 = std::chrono::steady_clock::now();
+    func(&hash);
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    if (memcmp(hash, input.expected, sizeof(hash)) != 0) {
+      printf("%s: hash mismatch\n", caption);
+      abort();
+    }
+  }
+  printf("%24s: %7.1f MB/s\n", caption,
+         kNumBlocks * kBlockSize / best * 1E-6);
+}
+
+int Run() {
+  const Input input = MakeInput();
+  FILE* output = tmpfile();
+  if (output == nullptr) {
+    perror("tmpfile");
+    return 1;
+  }
+
+  // Reader, hasher and writer each occupy a thread; the pool has one thread
+  // fewer than there are stage workers because the caller runs one.
+  const int num_decompressors = std::max(1, NumUsableCPUs() - 3);
+  ThreadPool pool(num_decompressors + 2);
+  printf("%d usable CPUs, %d decompressors, %.1f MB (%.1f MB compressed)\n",
+         NumUsableCPUs(), num_decompressors, kNumBlocks * kBlockSize * 1E-6,
+         input.offsets.back() * 1E-6);
+
+  Measure("Barrier per batch", input, [&](HHResult256* hash) {
+    RunBarrier(input, output, &pool, hash);
+  });
+  Measure("Pipeline", input, [&](HHResult256* hash) {
+    RunPipeline(input, output, &pool, num_decompressors, hash);
+  });
+
+  fclose(output);
+  fclose(input.file);
+  return 0;
+}
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) { return highwayhash::Run(); }
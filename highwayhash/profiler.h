@@ -24,6 +24,14 @@
 // After all threads have exited any zones, invoke PROFILER_PRINT_RESULTS() to
 // print call counts and average durations [CPU cycles] to stdout, sorted in
 // descending order of total duration.
+//
+// To also obtain the timeline of every zone entry/exit (e.g. to debug tail
+// latency), call PROFILER_TRACE("trace.json") before any thread enters a zone.
+// PROFILER_PRINT_RESULTS then also finishes that file, which is in the Chrome
+// trace event format and can be opened in chrome://tracing or
+// https://ui.perfetto.dev. Recording is unchanged; packets are converted only
+// when they would otherwise be discarded, i.e. when a thread's storage is full
+// and in PROFILER_PRINT_RESULTS.
 
 // Configuration settings:
 
@@ -35,11 +43,25 @@
 // How many mebibytes to allocate (if PROFILER_ENABLED) per thread that
 // enters at least one zone. Once this buffer is full, the thread will analyze
 // and discard packets, thus temporarily adding some observer overhead.
-// Each zone occupies 16 bytes.
+// Each zone occupies 16 bytes. This is the default for
+// PROFILER_SET_THREAD_STORAGE.
 #ifndef PROFILER_THREAD_STORAGE
 #define PROFILER_THREAD_STORAGE 200ULL
 #endif
 
+// How many threads can enter a zone. Only costs a pointer per thread.
+#ifndef PROFILER_MAX_THREADS
+#define PROFILER_MAX_THREADS 1024
+#endif
+
+// Runtime control, e.g. for long-running servers (all thread-safe):
+// PROFILER_SET_ENABLED(false) stops recording zones entered afterwards;
+// PROFILER_SET_THREAD_STORAGE(mebibytes) changes the storage of threads that
+// enter their first zone afterwards; PROFILER_PRINT_SNAPSHOT() prints the
+// results so far like PROFILER_PRINT_RESULTS, but while other threads keep
+// running. It waits (up to a timeout) for each thread to exit its
+// outermost zone.
+
 #if PROFILER_ENABLED
 
 #define PROFILER_PRINT_OVERHEAD 0
@@ -47,6 +69,8 @@
 #include <algorithm>  // min/max
 #include <atomic>
 #include <cassert>
+#include <chrono>  //NOLINT
+#include <thread>
 #include <cstddef>  // ptrdiff_t
 #include <cstdint>
 #include <cstdio>
@@ -85,9 +109,9 @@ namespace highwayhash {
 // Upper bounds for various fixed-size data structures (guarded via assert):
 
 // How many threads can actually enter a zone (those that don't do not count).
-// Memory use is about kMaxThreads * PROFILER_THREAD_STORAGE MiB.
+// Memory use is about PROFILER_THREAD_STORAGE MiB per such thread.
 // WARNING: a fiber library can spawn hundreds of threads.
-static constexpr size_t kMaxThreads = 128;
+static constexpr size_t kMaxThreads = PROFILER_MAX_THREADS;
 
 // Maximum nesting of zones.
 static constexpr size_t kMaxDepth = 64;
@@ -210,13 +234,97 @@ struct Node {
 // Holds statistics for all zones with the same name. POD.
 struct Accumulator {
   static constexpr size_t kNumCallBits = 64 - Packet::kOffsetBits;
+  static constexpr size_t kDurationBits = 56;
 
   uint64_t BiasedOffset() const { return num_calls >> kNumCallBits; }
   uint64_t NumCalls() const { return num_calls & ((1ULL << kNumCallBits) - 1); }
+  uint64_t TotalDuration() const {
+    return total_duration & ((1ULL << kDurationBits) - 1);
+  }
+  // Index of the zone's DurationHistogram within Results.
+  size_t HistogramIndex() const { return total_duration >> kDurationBits; }
 
   // UpdateOrAdd relies upon this layout.
-  uint64_t num_calls = 0;  // upper bits = biased_offset.
-  uint64_t total_duration = 0;
+  uint64_t num_calls = 0;       // upper bits = biased_offset.
+  uint64_t total_duration = 0;  // upper bits = histogram index.
+};
+static_assert(kMaxZones <= (1ULL << (64 - Accumulator::kDurationBits)),
+              "Histogram index does not fit");
+
+// Returns the index of the most significant set bit of "x" != 0.
+static inline size_t FloorLog2(const uint64_t x) {
+#if HH_MSC_VERSION
+  unsigned long index;
+  _BitScanReverse64(&index, x);
+  return index;
+#else
+  return 63 - __builtin_clzll(x);
+#endif
+}
+
+// Log-scale histogram of zone durations with four buckets per power of two
+// (similar to HdrHistogram), so percentiles are within 25% of the actual
+// value; the maximum is exact. POD.
+class DurationHistogram {
+ public:
+  static constexpr size_t kSubBucketBits = 2;
+  static constexpr size_t kNumBuckets = 64 << kSubBucketBits;
+
+  void Clear() { memset(this, 0, sizeof(*this)); }
+
+  void Add(const uint64_t duration) {
+    ++counts_[Bucket(duration)];
+    max_ = std::max(max_, duration);
+  }
+
+  void Assimilate(const DurationHistogram& other) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    max_ = std::max(max_, other.max_);
+  }
+
+  // Returns an upper bound for the duration below which "quantile" (e.g.
+  // 0.99) of the calls fall, or zero if there were none.
+  uint64_t Percentile(const double quantile) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      total += counts_[i];
+    }
+    const uint64_t rank = std::max<uint64_t>(
+        static_cast<uint64_t>(quantile * total + 0.999999), 1);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+      cumulative += counts_[i];
+      if (cumulative >= rank) return std::min(UpperBound(i), max_);
+    }
+    return max_;
+  }
+
+  uint64_t Max() const { return max_; }
+
+ private:
+  static size_t Bucket(const uint64_t duration) {
+    const size_t kSubBuckets = 1 << kSubBucketBits;
+    if (duration < kSubBuckets) return duration;
+    const size_t log2 = FloorLog2(duration);
+    const size_t sub =
+        (duration >> (log2 - kSubBucketBits)) & (kSubBuckets - 1);
+    return ((log2 - kSubBucketBits + 1) << kSubBucketBits) + sub;
+  }
+
+  // Returns the largest duration in "bucket".
+  static uint64_t UpperBound(const size_t bucket) {
+    const size_t kSubBuckets = 1 << kSubBucketBits;
+    if (bucket < kSubBuckets) return bucket;
+    const size_t shift = (bucket >> kSubBucketBits) - 1;
+    const uint64_t lower = (kSubBuckets + (bucket & (kSubBuckets - 1)))
+                           << shift;
+    return lower + (1ULL << shift) - 1;
+  }
+
+  uint64_t counts_[kNumBuckets];
+  uint64_t max_;
 };
 #if HH_ARCH_X64
 static_assert(sizeof(Accumulator) == sizeof(__m128i), "Wrong Accumulator size");
@@ -236,6 +344,7 @@ class Results {
   Results() {
     // Zero-initialize first accumulator to avoid a check for num_zones_ == 0.
     memset(zones_, 0, sizeof(Accumulator));
+    histograms_[0].Clear();
   }
 
   // Used for computing overhead when this thread encounters its first Zone.
@@ -244,11 +353,13 @@ class Results {
     PROFILER_CHECK(depth_ == 0);
     PROFILER_CHECK(num_zones_ == 0);
     AnalyzePackets(packets, 2);
-    const uint64_t duration = zones_[0].total_duration;
+    const uint64_t duration = zones_[0].TotalDuration();
     zones_[0].num_calls = 0;
     zones_[0].total_duration = 0;
+    histograms_[0].Clear();
     PROFILER_CHECK(depth_ == 0);
     num_zones_ = 0;
+    num_histograms_ = 0;
     return duration;
   }
 
@@ -284,7 +395,9 @@ class Results {
       const uint64_t self_duration = ClampedSubtract(
           duration, self_overhead_ + child_overhead_ + node.child_total);
 
-      UpdateOrAdd(node.packet.BiasedOffset(), 1, self_duration);
+      const size_t index =
+          UpdateOrAdd(node.packet.BiasedOffset(), 1, self_duration);
+      histograms_[index].Add(self_duration);
       --depth_;
 
       // Deduct this nested node's time from its parent's self_duration.
@@ -306,34 +419,42 @@ class Results {
 
     for (size_t i = 0; i < other.num_zones_; ++i) {
       const Accumulator& zone = other.zones_[i];
-      UpdateOrAdd(zone.BiasedOffset(), zone.NumCalls(), zone.total_duration);
+      const size_t index = UpdateOrAdd(zone.BiasedOffset(), zone.NumCalls(),
+                                       zone.TotalDuration());
+      histograms_[index].Assimilate(other.histograms_[zone.HistogramIndex()]);
     }
     const uint64_t t1 = Stop<uint64_t>();
     analyze_elapsed_ += t1 - t0 + other.analyze_elapsed_;
   }
 
   // Single-threaded.
-  void Print() {
+  void Print(FILE* file = stdout) {
     const uint64_t t0 = Start<uint64_t>();
     MergeDuplicates();
 
     // Sort by decreasing total (self) cost.
     std::sort(zones_, zones_ + num_zones_,
               [](const Accumulator& r1, const Accumulator& r2) {
-                return r1.total_duration > r2.total_duration;
+                return r1.TotalDuration() > r2.TotalDuration();
               });
 
+    // Name: calls x mean = total, then percentiles of the self durations.
     const char* string_origin = StringOrigin();
     for (size_t i = 0; i < num_zones_; ++i) {
       const Accumulator& r = zones_[i];
       const uint64_t num_calls = r.NumCalls();
-      printf("%40s: %10zu x %15zu = %15zu\n", string_origin + r.BiasedOffset(),
-             num_calls, r.total_duration / num_calls, r.total_duration);
+      const DurationHistogram& histogram = histograms_[r.HistogramIndex()];
+      fprintf(file,
+              "%40s: %10zu x %15zu = %15zu; p50 %zu p90 %zu p99 %zu max %zu\n",
+              string_origin + r.BiasedOffset(), num_calls,
+              r.TotalDuration() / num_calls, r.TotalDuration(),
+              histogram.Percentile(0.5), histogram.Percentile(0.9),
+              histogram.Percentile(0.99), histogram.Max());
     }
 
     const uint64_t t1 = Stop<uint64_t>();
     analyze_elapsed_ += t1 - t0;
-    printf("Total clocks during analysis: %zu\n", analyze_elapsed_);
+    fprintf(file, "Total clocks during analysis: %zu\n", analyze_elapsed_);
   }
 
  private:
@@ -342,15 +463,22 @@ class Results {
     const uint64_t num_calls = _mm_cvtsi128_si64(zone);
     return (num_calls >> Accumulator::kNumCallBits) == biased_offset;
   }
+
+  static size_t HistogramIndex(const __m128i& zone) {
+    const uint64_t total_duration =
+        _mm_cvtsi128_si64(_mm_unpackhi_epi64(zone, zone));
+    return total_duration >> Accumulator::kDurationBits;
+  }
 #endif
 
   // Updates an existing Accumulator (uniquely identified by biased_offset) or
   // adds one if this is the first time this thread analyzed that zone.
   // Uses a self-organizing list data structure, which avoids dynamic memory
   // allocations and is far faster than unordered_map. Loads, updates and
-  // stores the entire Accumulator with vector instructions.
-  void UpdateOrAdd(const size_t biased_offset, const uint64_t num_calls,
-                   const uint64_t duration) {
+  // stores the entire Accumulator with vector instructions. Returns the index
+  // of the zone's histogram, which the caller updates.
+  size_t UpdateOrAdd(const size_t biased_offset, const uint64_t num_calls,
+                     const uint64_t duration) {
     assert(biased_offset < (1ULL << Packet::kOffsetBits));
 
 #if HH_ARCH_X64
@@ -367,7 +495,7 @@ class Results {
       prev = _mm_add_epi64(prev, add_duration_call);
       assert(SameOffset(prev, biased_offset));
       _mm_store_si128(zones, prev);
-      return;
+      return HistogramIndex(prev);
     }
 
     // Look for a zone with the same offset.
@@ -380,27 +508,33 @@ class Results {
         // but at least as successful).
         _mm_store_si128(zones + i - 1, zone);
         _mm_store_si128(zones + i, prev);
-        return;
+        return HistogramIndex(zone);
       }
       prev = zone;
     }
 
-    // Not found; create a new Accumulator.
-    const __m128i biased_offset_64 = _mm_slli_epi64(
-        _mm_cvtsi64_si128(biased_offset), Accumulator::kNumCallBits);
-    const __m128i zone = _mm_add_epi64(biased_offset_64, add_duration_call);
+    // Not found; create a new Accumulator and histogram.
+    assert(num_histograms_ < kMaxZones);
+    const size_t index = num_histograms_++;
+    histograms_[index].Clear();
+    const __m128i offset_index_64 = _mm_unpacklo_epi64(
+        _mm_slli_epi64(_mm_cvtsi64_si128(biased_offset),
+                       Accumulator::kNumCallBits),
+        _mm_slli_epi64(_mm_cvtsi64_si128(index), Accumulator::kDurationBits));
+    const __m128i zone = _mm_add_epi64(offset_index_64, add_duration_call);
     assert(SameOffset(zone, biased_offset));
 
     assert(num_zones_ < kMaxZones);
     _mm_store_si128(zones + num_zones_, zone);
     ++num_zones_;
+    return index;
 #else
     // Special case for first zone: (maybe) update, without swapping.
     if (zones_[0].BiasedOffset() == biased_offset) {
       zones_[0].total_duration += duration;
       zones_[0].num_calls += num_calls;
       assert(zones_[0].BiasedOffset() == biased_offset);
-      return;
+      return zones_[0].HistogramIndex();
     }
 
     // Look for a zone with the same offset.
@@ -414,17 +548,22 @@ class Results {
         const Accumulator prev = zones_[i - 1];
         zones_[i - 1] = zones_[i];
         zones_[i] = prev;
-        return;
+        return zones_[i - 1].HistogramIndex();
       }
     }
 
-    // Not found; create a new Accumulator.
+    // Not found; create a new Accumulator and histogram.
+    assert(num_histograms_ < kMaxZones);
+    const size_t index = num_histograms_++;
+    histograms_[index].Clear();
     assert(num_zones_ < kMaxZones);
     Accumulator* HH_RESTRICT zone = zones_ + num_zones_;
     zone->num_calls = (biased_offset << Accumulator::kNumCallBits) + num_calls;
-    zone->total_duration = duration;
+    zone->total_duration =
+        (static_cast<uint64_t>(index) << Accumulator::kDurationBits) + duration;
     assert(zone->BiasedOffset() == biased_offset);
     ++num_zones_;
+    return index;
 #endif
   }
 
@@ -439,11 +578,14 @@ class Results {
       // Separate num_calls from biased_offset so we can add them together.
       uint64_t num_calls = zones_[i].NumCalls();
 
-      // Add any subsequent duplicates to num_calls and total_duration.
+      // Add any subsequent duplicates to num_calls, total_duration and the
+      // histogram.
       for (size_t j = i + 1; j < num_zones_;) {
         if (!strcmp(name, string_origin + zones_[j].BiasedOffset())) {
           num_calls += zones_[j].NumCalls();
-          zones_[i].total_duration += zones_[j].total_duration;
+          zones_[i].total_duration += zones_[j].TotalDuration();
+          histograms_[zones_[i].HistogramIndex()].Assimilate(
+              histograms_[zones_[j].HistogramIndex()]);
           // Fill hole with last item.
           zones_[j] = zones_[--num_zones_];
         } else {  // Name differed, try next Accumulator.
@@ -463,13 +605,126 @@ class Results {
   uint64_t self_overhead_ = 0;
   uint64_t child_overhead_ = 0;
 
-  size_t depth_ = 0;      // Number of active zones.
-  size_t num_zones_ = 0;  // Number of retired zones.
+  size_t depth_ = 0;           // Number of active zones.
+  size_t num_zones_ = 0;       // Number of retired zones.
+  size_t num_histograms_ = 0;  // Not reduced by MergeDuplicates.
 
   HH_ALIGNAS(64) Node nodes_[kMaxDepth];         // Stack
   HH_ALIGNAS(64) Accumulator zones_[kMaxZones];  // Self-organizing list
+  // Indexed by Accumulator::HistogramIndex because zones_ are reordered.
+  DurationHistogram histograms_[kMaxZones];
 };
 
+// Writes the packets of all threads to a file in the Chrome trace event format
+// (JSON). Only Write is called while zones are active, and only when a
+// thread's storage is full, so it need not be fast.
+class TraceWriter {
+ public:
+  // Returns the singleton. Non time-critical.
+  static TraceWriter& Get() {
+    static TraceWriter writer;
+    return writer;
+  }
+
+  // Creates or truncates the file at "path" and writes the header. Must be
+  // called before any thread enters a zone. Prints an error if unsuccessful.
+  void Open(const char* path) {
+    PROFILER_CHECK(file_ == nullptr);
+    file_ = fopen(path, "w");
+    if (file_ == nullptr) {
+      fprintf(stderr, "Profiler: cannot open trace %s\n", path);
+      return;
+    }
+
+    // Timestamps are ticks, but the format requires microseconds. Calibrate
+    // against the steady clock because the tick rate may not be known.
+    const auto time0 = std::chrono::steady_clock::now();
+    const uint64_t ticks0 = Start<uint64_t>();
+    double elapsed_us;
+    do {
+      elapsed_us = std::chrono::duration<double, std::micro>(
+                       std::chrono::steady_clock::now() - time0)
+                       .count();
+    } while (elapsed_us < 10000.0);
+    const uint64_t ticks1 = Stop<uint64_t>();
+    ticks_per_us_ = (ticks1 - ticks0) / elapsed_us;
+    origin_ = ticks1;
+
+    fprintf(file_, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  }
+
+  bool IsOpen() const { return file_ != nullptr; }
+
+  // Appends the "num_packets" entry/exit events of "thread". "last" is the
+  // thread's previous full-resolution timestamp (initially zero), which is
+  // required to undo the masking of Packet timestamps. Thread-safe.
+  void Write(const uint32_t thread, const Packet* packets,
+             const size_t num_packets, uint64_t* HH_RESTRICT last) {
+    while (lock_.test_and_set(std::memory_order_acquire)) {
+    }
+
+    const char* string_origin = StringOrigin();
+    uint64_t timestamp = (*last == 0) ? origin_ : *last;
+    for (size_t i = 0; i < num_packets; ++i) {
+      const Packet p = packets[i];
+      // Masking correctly handles unsigned wraparound.
+      timestamp += (p.Timestamp() - timestamp) & Packet::kTimestampMask;
+      const double us = (timestamp - origin_) / ticks_per_us_;
+      fprintf(file_, "%s\n{\"pid\": 0, \"tid\": %u, \"ts\": %.3f, ",
+              num_events_ == 0 ? "" : ",", thread, us);
+      if (p.BiasedOffset() == Packet::kOffsetBias) {
+        fprintf(file_, "\"ph\": \"E\"}");
+      } else {
+        fprintf(file_, "\"ph\": \"B\", \"name\": \"");
+        WriteEscaped(string_origin + p.BiasedOffset());
+        fprintf(file_, "\"}");
+      }
+      ++num_events_;
+    }
+    *last = timestamp;
+
+    lock_.clear(std::memory_order_release);
+  }
+
+  // Finishes the file. Single-threaded.
+  void Close() {
+    if (file_ == nullptr) return;
+    fprintf(file_, "\n]}\n");
+    fclose(file_);
+    file_ = nullptr;
+  }
+
+ private:
+  // Writes "name" as the contents of a JSON string.
+  void WriteEscaped(const char* name) {
+    for (const char* p = name; *p != '\0'; ++p) {
+      if (*p == '"' || *p == '\\') fputc('\\', file_);
+      fputc(*p, file_);
+    }
+  }
+
+  FILE* file_ = nullptr;
+  std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+  double ticks_per_us_ = 1.0;
+  uint64_t origin_ = 0;  // timestamp corresponding to ts = 0
+  uint64_t num_events_ = 0;
+};
+
+// Settings that may change at runtime. Constant-initialized, so accessing
+// them does not require a guard variable.
+struct ProfilerSettings {
+  std::atomic<bool> enabled{true};
+  std::atomic<size_t> thread_storage_mib{PROFILER_THREAD_STORAGE};
+};
+
+// Returns the settings shared by all threads. This function must not be
+// static - each call (even from other translation units) must return the
+// same object.
+inline ProfilerSettings& GetProfilerSettings() {
+  static ProfilerSettings settings;
+  return settings;
+}
+
 // Per-thread packet storage, allocated via CacheAligned.
 class ThreadSpecific {
   static constexpr size_t kBufferCapacity =
@@ -478,11 +733,15 @@ class ThreadSpecific {
  public:
   // "name" is used to sanity-check offsets fit in kOffsetBits.
   explicit ThreadSpecific(const char* name)
+      : ThreadSpecific(name, StorageMiB()) {}
+
+  ThreadSpecific(const char* name, const size_t storage_mib)
       : packets_(static_cast<Packet*>(
-            CacheAligned::Allocate(PROFILER_THREAD_STORAGE << 20))),
+            CacheAligned::Allocate(storage_mib << 20))),
         num_packets_(0),
-        max_packets_(PROFILER_THREAD_STORAGE << 17),
+        max_packets_(storage_mib << 17),
         string_origin_(StringOrigin()) {
+    PROFILER_CHECK(packets_ != nullptr);
     // Even in optimized builds (with NDEBUG), verify that this zone's name
     // offset fits within the allotted space. If not, UpdateOrAdd is likely to
     // overrun zones_[]. We also assert(), but users often do not run debug
@@ -492,11 +751,101 @@ class ThreadSpecific {
     PROFILER_CHECK(biased_offset <= (1ULL << Packet::kOffsetBits));
   }
 
-  ~ThreadSpecific() { CacheAligned::Free(packets_); }
+  ~ThreadSpecific() {
+    CacheAligned::Free(packets_);
+    if (snapshot_ != nullptr) {
+      snapshot_->~Results();
+      CacheAligned::Free(snapshot_);
+    }
+  }
 
   // Depends on Zone => defined below.
   void ComputeOverhead();
 
+  // Allows snapshots once the thread is initialized.
+  void MarkReady() { state_.store(kIdle, std::memory_order_release); }
+
+  // Called by Zone before writing the entry packet. Only the outermost zone
+  // synchronizes with snapshots.
+  void Enter() {
+    if (depth_++ == 0) {
+      uint32_t expected = kIdle;
+      while (HH_UNLIKELY(!state_.compare_exchange_weak(
+          expected, kBusy, std::memory_order_acquire))) {
+        // A snapshot is analyzing our packets.
+        expected = kIdle;
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Called by Zone after writing the exit packet.
+  void Exit() {
+    if (--depth_ != 0) return;
+#if HH_ARCH_X64
+    // A snapshot may analyze our packets on another core.
+    _mm_sfence();
+#endif
+    uint32_t expected = kBusy;
+    if (HH_LIKELY(state_.compare_exchange_strong(expected, kIdle,
+                                                 std::memory_order_release))) {
+      return;
+    }
+    // A snapshot was requested (unless it was just cancelled).
+    if (expected == kRequested &&
+        state_.compare_exchange_strong(expected, kPublishing,
+                                       std::memory_order_acquire)) {
+      AnalyzeRemainingPackets();
+      *snapshot_ = results_;
+    }
+    state_.store(kIdle, std::memory_order_release);
+  }
+
+  // Thread-safe. Stores a copy of this thread's results so far, either by
+  // analyzing its packets while it is outside of all zones, or by asking it
+  // to do so when it exits its outermost zone. Returns null if that did not
+  // happen before "deadline".
+  const Results* Snapshot(
+      const std::chrono::steady_clock::time_point deadline) {
+    if (snapshot_ == nullptr) {
+      void* mem = CacheAligned::Allocate(sizeof(Results));
+      snapshot_ = new (mem) Results;
+    }
+    for (;;) {
+      uint32_t expected = kIdle;
+      if (state_.compare_exchange_strong(expected, kSnapshotting,
+                                         std::memory_order_acquire)) {
+        AnalyzeRemainingPackets();
+        *snapshot_ = results_;
+        state_.store(kIdle, std::memory_order_release);
+        return snapshot_;
+      }
+      if (expected == kBusy &&
+          state_.compare_exchange_strong(expected, kRequested,
+                                         std::memory_order_acq_rel)) {
+        break;
+      }
+      std::this_thread::yield();  // initializing, or the state just changed
+      if (std::chrono::steady_clock::now() > deadline) return nullptr;
+    }
+
+    for (;;) {
+      const uint32_t state = state_.load(std::memory_order_acquire);
+      if (state != kRequested && state != kPublishing) return snapshot_;
+      if (state == kRequested && std::chrono::steady_clock::now() > deadline) {
+        uint32_t expected = kRequested;
+        if (state_.compare_exchange_strong(expected, kBusy,
+                                           std::memory_order_relaxed)) {
+          return nullptr;  // cancelled
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  // Identifies the thread in the trace.
+  void SetThreadIndex(const uint32_t index) { thread_index_ = index; }
+
   void WriteEntry(const char* name, const uint64_t timestamp) {
     const size_t biased_offset = name - string_origin_;
     Write(Packet::Make(biased_offset, timestamp));
@@ -514,20 +863,30 @@ class ThreadSpecific {
 
     // Storage full => empty it.
     if (num_packets_ + buffer_size_ > max_packets_) {
-      results_.AnalyzePackets(packets_, num_packets_);
-      num_packets_ = 0;
+      Analyze();
     }
     memcpy(packets_ + num_packets_, buffer_, buffer_size_ * sizeof(Packet));
     num_packets_ += buffer_size_;
+    buffer_size_ = 0;
 #endif
 
-    results_.AnalyzePackets(packets_, num_packets_);
-    num_packets_ = 0;
+    Analyze();
   }
 
   Results& GetResults() { return results_; }
 
  private:
+  // Converts all stored packets to results (and trace events, if enabled)
+  // and empties the storage.
+  void Analyze() {
+    TraceWriter& trace = TraceWriter::Get();
+    if (HH_UNLIKELY(trace.IsOpen())) {
+      trace.Write(thread_index_, packets_, num_packets_, &trace_timestamp_);
+    }
+    results_.AnalyzePackets(packets_, num_packets_);
+    num_packets_ = 0;
+  }
+
   // Write packet to buffer/storage, emptying them as needed.
   void Write(const Packet packet) {
 #if HH_ARCH_X64
@@ -535,8 +894,7 @@ class ThreadSpecific {
     if (buffer_size_ == kBufferCapacity) {
       // Storage full => empty it.
       if (num_packets_ + kBufferCapacity > max_packets_) {
-        results_.AnalyzePackets(packets_, num_packets_);
-        num_packets_ = 0;
+        Analyze();
       }
       // This buffering halves observer overhead and decreases the overall
       // runtime by about 3%.
@@ -549,8 +907,7 @@ class ThreadSpecific {
 #else
     // Write directly to storage.
     if (num_packets_ >= max_packets_) {
-      results_.AnalyzePackets(packets_, num_packets_);
-      num_packets_ = 0;
+      Analyze();
     }
     packets_[num_packets_] = packet;
     ++num_packets_;
@@ -570,39 +927,98 @@ class ThreadSpecific {
   const size_t max_packets_;
   // Cached here because we already read this cache line on zone entry/exit.
   const char* HH_RESTRICT string_origin_;
+  uint32_t thread_index_ = 0;
+  uint32_t depth_ = 0;  // Number of active zones.
+  uint64_t trace_timestamp_ = 0;  // of the last packet written to the trace
   Results results_;
+
+  // Synchronization with Snapshot: kIdle and kBusy (in a zone) are set by
+  // this thread, kSnapshotting (packets are being analyzed by Snapshot) and
+  // kRequested by Snapshot, and kPublishing while this thread stores its
+  // results for a requested snapshot.
+  enum : uint32_t { kIdle, kBusy, kSnapshotting, kRequested, kPublishing };
+  std::atomic<uint32_t> state_{kBusy};  // until MarkReady
+  Results* snapshot_ = nullptr;  // allocated via CacheAligned when first used
+
+  static size_t StorageMiB() {
+    // At least enough for ComputeOverhead.
+    return std::max<size_t>(GetProfilerSettings().thread_storage_mib.load(), 1);
+  }
 };
 
 class ThreadList {
  public:
-  // Thread-safe.
-  void Add(ThreadSpecific* const ts) {
+  // Thread-safe. Returns the index of the thread.
+  uint32_t Add(ThreadSpecific* const ts) {
     const uint32_t index = num_threads_.fetch_add(1);
     PROFILER_CHECK(index < kMaxThreads);
-    threads_[index] = ts;
+    threads_[index].store(ts, std::memory_order_release);
+    return index;
   }
 
   // Single-threaded.
   void PrintResults() {
     const uint32_t num_threads = num_threads_.load();
     for (uint32_t i = 0; i < num_threads; ++i) {
-      threads_[i]->AnalyzeRemainingPackets();
+      threads_[i].load()->AnalyzeRemainingPackets();
     }
+    TraceWriter::Get().Close();
 
     // Combine all threads into a single Result.
     for (uint32_t i = 1; i < num_threads; ++i) {
-      threads_[0]->GetResults().Assimilate(threads_[i]->GetResults());
+      threads_[0].load()->GetResults().Assimilate(
+          threads_[i].load()->GetResults());
     }
 
     if (num_threads != 0) {
-      threads_[0]->GetResults().Print();
+      threads_[0].load()->GetResults().Print();
     }
   }
 
+  // Thread-safe, including while other threads are inside zones. Prints the
+  // combined results of all threads so far to "file" and returns how many
+  // threads were omitted because they did not exit their outermost zone
+  // within "timeout_seconds".
+  size_t PrintSnapshot(FILE* file, const double timeout_seconds) {
+    while (snapshot_lock_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(timeout_seconds));
+
+    void* mem = CacheAligned::Allocate(sizeof(Results));
+    Results* combined = new (mem) Results;
+    size_t num_omitted = 0;
+    const uint32_t num_threads = num_threads_.load();
+    for (uint32_t i = 0; i < num_threads; ++i) {
+      ThreadSpecific* ts = threads_[i].load(std::memory_order_acquire);
+      const Results* results =
+          (ts == nullptr) ? nullptr : ts->Snapshot(deadline);
+      if (results == nullptr) {
+        ++num_omitted;
+        continue;
+      }
+      combined->Assimilate(*results);
+    }
+    combined->Print(file);
+    if (num_omitted != 0) {
+      fprintf(file, "(%zu threads omitted: still inside a zone)\n",
+              num_omitted);
+    }
+    combined->~Results();
+    CacheAligned::Free(combined);
+
+    snapshot_lock_.clear(std::memory_order_release);
+    return num_omitted;
+  }
+
  private:
   // Owning pointers.
-  HH_ALIGNAS(64) ThreadSpecific* threads_[kMaxThreads];
+  HH_ALIGNAS(64) std::atomic<ThreadSpecific*> threads_[kMaxThreads];
   std::atomic<uint32_t> num_threads_{0};
+  std::atomic_flag snapshot_lock_ = ATOMIC_FLAG_INIT;
 };
 
 // RAII zone enter/exit recorder constructed by the ZONE macro; also
@@ -612,15 +1028,19 @@ class Zone {
   // "name" must be a string literal (see StringOrigin).
   HH_NOINLINE explicit Zone(const char* name) {
     HH_COMPILER_FENCE;
+    active_ = GetProfilerSettings().enabled.load(std::memory_order_relaxed);
+    if (HH_UNLIKELY(!active_)) return;
     ThreadSpecific* HH_RESTRICT thread_specific = StaticThreadSpecific();
     if (HH_UNLIKELY(thread_specific == nullptr)) {
       void* mem = CacheAligned::Allocate(sizeof(ThreadSpecific));
       thread_specific = new (mem) ThreadSpecific(name);
       // Must happen before ComputeOverhead, which re-enters this ctor.
-      Threads().Add(thread_specific);
+      thread_specific->SetThreadIndex(Threads().Add(thread_specific));
       StaticThreadSpecific() = thread_specific;
       thread_specific->ComputeOverhead();
+      thread_specific->MarkReady();
     }
+    thread_specific->Enter();
 
     // (Capture timestamp ASAP, not inside WriteEntry.)
     HH_COMPILER_FENCE;
@@ -629,15 +1049,37 @@ class Zone {
   }
 
   HH_NOINLINE ~Zone() {
+    if (HH_UNLIKELY(!active_)) return;
     HH_COMPILER_FENCE;
     const uint64_t timestamp = Stop<uint64_t>();
-    StaticThreadSpecific()->WriteExit(timestamp);
+    ThreadSpecific* HH_RESTRICT thread_specific = StaticThreadSpecific();
+    thread_specific->WriteExit(timestamp);
+    thread_specific->Exit();
     HH_COMPILER_FENCE;
   }
 
   // Call exactly once after all threads have exited all zones.
   static void PrintResults() { Threads().PrintResults(); }
 
+  // See PROFILER_PRINT_SNAPSHOT. Returns the number of omitted threads.
+  static size_t PrintSnapshot(FILE* file = stdout,
+                              const double timeout_seconds = 1.0) {
+    return Threads().PrintSnapshot(file, timeout_seconds);
+  }
+
+  // Affects zones entered afterwards; zones already entered are recorded.
+  static void SetEnabled(const bool enabled) {
+    GetProfilerSettings().enabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  // Affects threads that enter their first zone afterwards.
+  static void SetThreadStorage(const size_t mebibytes) {
+    GetProfilerSettings().thread_storage_mib.store(mebibytes);
+  }
+
+  // Call before any thread enters a zone (see PROFILER_TRACE).
+  static void Trace(const char* path) { TraceWriter::Get().Open(path); }
+
  private:
   // Returns reference to the thread's ThreadSpecific pointer (initially null).
   // Function-local static avoids needing a separate definition.
@@ -651,6 +1093,8 @@ class Zone {
     static ThreadList threads_;
     return threads_;
   }
+
+  bool active_;  // whether this zone is recorded
 };
 
 // Creates a zone starting from here until the end of the current scope.
@@ -670,7 +1114,17 @@ class Zone {
 
 #define PROFILER_PRINT_RESULTS Zone::PrintResults
 
+// Usage: PROFILER_TRACE("path.json") before entering any zone.
+#define PROFILER_TRACE Zone::Trace
+
+#define PROFILER_PRINT_SNAPSHOT Zone::PrintSnapshot
+#define PROFILER_SET_ENABLED Zone::SetEnabled
+#define PROFILER_SET_THREAD_STORAGE Zone::SetThreadStorage
+
 inline void ThreadSpecific::ComputeOverhead() {
+  // The dummy zones below are nested within the zone being constructed, so
+  // they do not synchronize with snapshots.
+  ++depth_;
   // Delay after capturing timestamps before/after the actual zone runs. Even
   // with frequency throttling disabled, this has a multimodal distribution,
   // including 32, 34, 48, 52, 59, 62.
@@ -749,6 +1203,7 @@ inline void ThreadSpecific::ComputeOverhead() {
   printf("Child overhead: %zu\n", child_overhead);
 #endif
   results_.SetChildOverhead(child_overhead);
+  --depth_;
 }
 
 }  // namespace highwayhash
@@ -757,6 +1212,10 @@ inline void ThreadSpecific::ComputeOverhead() {
 #define PROFILER_ZONE(name)
 #define PROFILER_FUNC
 #define PROFILER_PRINT_RESULTS()
+#define PROFILER_TRACE(path)
+#define PROFILER_PRINT_SNAPSHOT(...)
+#define PROFILER_SET_ENABLED(enabled)
+#define PROFILER_SET_THREAD_STORAGE(mebibytes)
 #endif
 
 #endif  // HIGHWAYHASH_PROFILER_H_
@@ -76,7 +76,11 @@ void Level1() {
   Level2();
 }
 
-void ProfilerExample() {
+// Also writes a Chrome trace to "trace_path" unless it is null.
+void ProfilerExample(const char* trace_path) {
+  if (trace_path != nullptr) {
+    PROFILER_TRACE(trace_path);
+  }
   PinThreadToRandomCPU();
   {
     PROFILER_FUNC;
@@ -91,7 +95,8 @@ void ProfilerExample() {
 }  // namespace
 }  // namespace highwayhash
 
+// Usage: profiler_example [trace.json]
 int main(int argc, char* argv[]) {
-  highwayhash::ProfilerExample();
+  highwayhash::ProfilerExample(argc > 1 ? argv[1] : nullptr);
   return 0;
 }
@@ -15,7 +15,8 @@
 #ifndef HIGHWAYHASH_ROBUST_STATISTICS_H_
 #define HIGHWAYHASH_ROBUST_STATISTICS_H_
 
-// Robust statistics: Mode, Median, MedianAbsoluteDeviation.
+// Robust statistics: Mode, Median, Quantile, MedianAbsoluteDeviation,
+// MedianConfidenceInterval.
 
 #include <stddef.h>
 #include <algorithm>
@@ -118,6 +119,37 @@ T Median(std::vector<T>* samples) {
   return ((*samples)[half] + (*samples)[half - 1]) / 2;
 }
 
+// Returns the nearest-rank value at "quantile" (0 = minimum, 1 = maximum).
+// "sorted" must be in ascending order, e.g. after Median.
+template <typename T>
+T Quantile(const std::vector<T>& sorted, const double quantile) {
+  assert(!sorted.empty());
+  assert(0.0 <= quantile && quantile <= 1.0);
+  const double rank = std::ceil(quantile * sorted.size());
+  const size_t idx = (rank < 1.0) ? 0 : static_cast<size_t>(rank) - 1;
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// Stores approximate 95% confidence bounds for the median of the population
+// from which "sorted" (ascending order) was drawn. Uses ranks of the binomial
+// distribution as in the sign test, i.e. no assumption about its shape.
+template <typename T>
+void MedianConfidenceInterval(const std::vector<T>& sorted, T* lower,
+                              T* upper) {
+  assert(!sorted.empty());
+  const double n = static_cast<double>(sorted.size());
+  const double half_width = 1.96 * std::sqrt(n) / 2;
+  // 1-based ranks, clamped to the available samples.
+  const double lower_rank = std::floor(n / 2 - half_width);
+  const double upper_rank = std::ceil(1 + n / 2 + half_width);
+  const size_t lower_idx =
+      (lower_rank < 1.0) ? 0 : static_cast<size_t>(lower_rank) - 1;
+  const size_t upper_idx =
+      std::min(static_cast<size_t>(upper_rank) - 1, sorted.size() - 1);
+  *lower = sorted[lower_idx];
+  *upper = sorted[upper_idx];
+}
+
 // Returns a robust measure of variability.
 template <typename T>
 T MedianAbsoluteDeviation(const std::vector<T>& samples, const T median) {
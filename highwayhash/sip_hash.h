@@ -28,7 +28,11 @@
 namespace highwayhash {
 
 // Paper: https://www.131002.net/siphash/siphash.pdf
-template <int kUpdateIters, int kFinalizeIters>
+//
+// Restricted headers (e.g. sip_hash_batch.h) pass a "Tag" type declared in
+// their HH_TARGET_NAME namespace so that the member functions they instantiate
+// with target-specific flags are distinct symbols (see arch_specific.h).
+template <int kUpdateIters, int kFinalizeIters, class Tag = void>
 class SipHashStateT {
  public:
   using Key = HH_U64[2];
@@ -104,29 +108,17 @@ using SipHashState = SipHashStateT<2, 4>;
 using SipHash13State = SipHashStateT<1, 3>;
 
 // Override the HighwayTreeHash padding scheme with that of SipHash so that
-// the hash output matches the known-good values in sip_hash_test.
-template <>
-HH_INLINE void PaddedUpdate<SipHashState>(const HH_U64 size,
-                                          const char* remaining_bytes,
-                                          const HH_U64 remaining_size,
-                                          SipHashState* state) {
-  // Copy to avoid overrunning the input buffer.
-  char final_packet[SipHashState::kPacketSize] = {0};
-  memcpy(final_packet, remaining_bytes, remaining_size);
-  final_packet[SipHashState::kPacketSize - 1] = static_cast<char>(size & 0xFF);
-  state->Update(final_packet);
-}
-
-template <>
-HH_INLINE void PaddedUpdate<SipHash13State>(const HH_U64 size,
-                                            const char* remaining_bytes,
-                                            const HH_U64 remaining_size,
-                                            SipHash13State* state) {
+// the hash output matches the known-good values in sip_hash_test. (An overload
+// rather than specializations so that it also applies to every "Tag".)
+template <int kUpdateIters, int kFinalizeIters, class Tag>
+HH_INLINE void PaddedUpdate(
+    const HH_U64 size, const char* remaining_bytes, const HH_U64 remaining_size,
+    SipHashStateT<kUpdateIters, kFinalizeIters, Tag>* state) {
+  using State = SipHashStateT<kUpdateIters, kFinalizeIters, Tag>;
   // Copy to avoid overrunning the input buffer.
-  char final_packet[SipHash13State::kPacketSize] = {0};
+  char final_packet[State::kPacketSize] = {0};
   memcpy(final_packet, remaining_bytes, remaining_size);
-  final_packet[SipHash13State::kPacketSize - 1] =
-      static_cast<char>(size & 0xFF);
+  final_packet[State::kPacketSize - 1] = static_cast<char>(size & 0xFF);
   state->Update(final_packet);
 }
 
@@ -153,11 +145,83 @@ static HH_INLINE HH_U64 SipHash13(const SipHash13State::Key& key,
   return ComputeHash<SipHash13State>(key, bytes, size);
 }
 
-template <int kNumLanes, int kUpdateIters, int kFinalizeIters>
+// Incremental SipHash for inputs that are not contiguous in memory (e.g.
+// cords or network fragments), analogous to HighwayHashCatT. Finalize returns
+// the same hash as SipHash/SipHash13 of the concatenation of all appended
+// bytes, without having to copy them into one buffer first.
+template <int kUpdateIters, int kFinalizeIters>
+class SipHashCatT {
+  using State = SipHashStateT<kUpdateIters, kFinalizeIters>;
+  static const size_t kPacketSize = State::kPacketSize;
+
+ public:
+  using Key = typename State::Key;
+
+  explicit HH_INLINE SipHashCatT(const Key& key) : state_(key) {}
+
+  // Resets the state of the hasher so it can be used to hash a new string.
+  HH_INLINE void Reset(const Key& key) {
+    state_ = State(key);
+    size_ = 0;
+  }
+
+  // Adds "bytes" to the input. Call this as often as desired. Only reads
+  // bytes within [bytes, bytes + num_bytes); "num_bytes" == 0 has no effect.
+  // Whole packets are hashed directly from "bytes"; only a partial packet at
+  // either end of a fragment is copied into the internal buffer, so there are
+  // no copies at all if the fragment sizes are multiples of 8.
+  HH_INLINE void Append(const char* HH_RESTRICT bytes, size_t num_bytes) {
+    // Also avoids passing a null "bytes" to memcpy.
+    if (num_bytes == 0) return;
+    size_t buffer_usage = static_cast<size_t>(size_) & (kPacketSize - 1);
+    size_ += num_bytes;
+    if (buffer_usage != 0) {
+      const size_t capacity = kPacketSize - buffer_usage;
+      if (num_bytes < capacity) {
+        memcpy(buffer_ + buffer_usage, bytes, num_bytes);
+        return;
+      }
+      memcpy(buffer_ + buffer_usage, bytes, capacity);
+      state_.Update(buffer_);
+      bytes += capacity;
+      num_bytes -= capacity;
+    }
+
+    // Ensures the state is kept in registers, see HighwayHashCatT::Append.
+    State state = state_;
+    const size_t truncated_size = num_bytes & ~(kPacketSize - 1);
+    for (size_t i = 0; i < truncated_size; i += kPacketSize) {
+      state.Update(bytes + i);
+    }
+    state_ = state;
+    memcpy(buffer_, bytes + truncated_size, num_bytes - truncated_size);
+  }
+
+  // Returns the hash of all bytes passed to Append since construction or the
+  // last Reset. Does not modify the state, so Append may be called again.
+  HH_INLINE HH_U64 Finalize() const {
+    State state = state_;
+    const size_t buffer_usage = static_cast<size_t>(size_) & (kPacketSize - 1);
+    PaddedUpdate(size_, buffer_, buffer_usage, &state);
+    return state.Finalize();
+  }
+
+ private:
+  State state_;
+  HH_U64 size_ = 0;  // of all appended bytes
+  char buffer_[kPacketSize];  // the first (size_ % kPacketSize) are valid
+};
+
+using SipHashCat = SipHashCatT<2, 4>;
+using SipHash13Cat = SipHashCatT<1, 3>;
+
+// "Tag" as for SipHashStateT.
+template <int kNumLanes, int kUpdateIters, int kFinalizeIters,
+          class Tag = void>
 static HH_INLINE HH_U64 ReduceSipTreeHash(
-    const typename SipHashStateT<kUpdateIters, kFinalizeIters>::Key& key,
+    const typename SipHashStateT<kUpdateIters, kFinalizeIters, Tag>::Key& key,
     const uint64_t (&hashes)[kNumLanes]) {
-  SipHashStateT<kUpdateIters, kFinalizeIters> state(key);
+  SipHashStateT<kUpdateIters, kFinalizeIters, Tag> state(key);
 
   for (int i = 0; i < kNumLanes; ++i) {
     state.Update(reinterpret_cast<const char*>(&hashes[i]));
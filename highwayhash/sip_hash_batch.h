@@ -0,0 +1,329 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_SIP_HASH_BATCH_H_
+#define HIGHWAYHASH_SIP_HASH_BATCH_H_
+
+// Multi-buffer SipHash: hashes several independent messages at once, one per
+// SIMD lane, with results identical to SipHash/SipHash13 of each message.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details. sip_hash.h
+// is not restricted, hence SipHashStateT is only used with SipHashBatchTag.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memcpy
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/endianess.h"
+#include "highwayhash/hh_types.h"
+#include "highwayhash/sip_hash.h"
+
+#if HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector512.h"
+#elif HH_TARGET == HH_TARGET_AVX2
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+#if HH_TARGET == HH_TARGET_AVX512
+#define HH_SIP_HASH_LANES 1
+using SipHashLanes = V8x64U;
+#elif HH_TARGET == HH_TARGET_AVX2
+#define HH_SIP_HASH_LANES 1
+using SipHashLanes = V4x64U;
+#elif HH_TARGET == HH_TARGET_NEON
+#define HH_SIP_HASH_LANES 1
+using SipHashLanes = V2x64U;
+#else
+// SSE4.1 lacks vector rotates, so two lanes were no faster than the scalar
+// code in our measurements. VSX lacks a vector class and Portable has no
+// SIMD. All three hash one message at a time.
+#define HH_SIP_HASH_LANES 0
+#endif
+
+#if HH_SIP_HASH_LANES
+
+// SipHashStateT for SipHashLanes::N messages, one per lane. Lanes are
+// updated in lockstep, but a lane whose message has no more packets can be
+// masked out so that its state remains unchanged until the final Finalize.
+template <int kUpdateIters, int kFinalizeIters>
+class SipHashLanesT {
+ public:
+  static constexpr size_t kNumLanes = SipHashLanes::N;
+
+  explicit HH_INLINE SipHashLanesT(const HH_U64 (&key)[2]) {
+    const SipHashLanes key0(key[0]);
+    const SipHashLanes key1(key[1]);
+    v0 = SipHashLanes(0x736f6d6570736575ull) ^ key0;
+    v1 = SipHashLanes(0x646f72616e646f6dull) ^ key1;
+    v2 = SipHashLanes(0x6c7967656e657261ull) ^ key0;
+    v3 = SipHashLanes(0x7465646279746573ull) ^ key1;
+  }
+
+  // "packets" are the next (host byte order) packet of each lane.
+  HH_INLINE void Update(const SipHashLanes& packets) {
+    v3 ^= packets;
+
+    Compress<kUpdateIters>();
+
+    v0 ^= packets;
+  }
+
+  // Same as Update for lanes whose "mask" is all ones; lanes whose mask is
+  // zero are unchanged. Branch-free, so the cost does not depend on sizes.
+  HH_INLINE void MaskedUpdate(const SipHashLanes& packets,
+                              const SipHashLanes& mask) {
+    const SipHashLanes prev0(v0);
+    const SipHashLanes prev1(v1);
+    const SipHashLanes prev2(v2);
+    const SipHashLanes prev3(v3);
+    Update(packets);
+    v0 = prev0 ^ ((v0 ^ prev0) & mask);
+    v1 = prev1 ^ ((v1 ^ prev1) & mask);
+    v2 = prev2 ^ ((v2 ^ prev2) & mask);
+    v3 = prev3 ^ ((v3 ^ prev3) & mask);
+  }
+
+  // Stores the hash of each lane in the aligned "hashes".
+  HH_INLINE void Finalize(uint64_t* HH_RESTRICT hashes) {
+    // Mix in bits to avoid leaking the key if all packets were zero.
+    v2 ^= SipHashLanes(0xFFull);
+
+    Compress<kFinalizeIters>();
+
+    Store((v0 ^ v1) ^ (v2 ^ v3), hashes);
+  }
+
+ private:
+  template <int kBits>
+  static HH_INLINE SipHashLanes RotateLeft(const SipHashLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX512
+    // (The unmasked _mm512_rol_epi64 triggers -Wmaybe-uninitialized in GCC.)
+    return SipHashLanes(_mm512_maskz_rol_epi64(0xFF, v, kBits));
+#elif HH_TARGET == HH_TARGET_NEON
+    // Inserts the shifted bits into the upper bits shifted down.
+    return SipHashLanes(vsliq_n_u64(vshrq_n_u64(v, 64 - kBits), v, kBits));
+#else
+    return (v << kBits) | (v >> (64 - kBits));
+#endif
+  }
+
+  // Byte-granular rotates are a single shuffle.
+  static HH_INLINE SipHashLanes RotateLeft16(const SipHashLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX2
+    const SipHashLanes control(0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL,
+                               0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL);
+    return SipHashLanes(_mm256_shuffle_epi8(v, control));
+#else
+    return RotateLeft<16>(v);
+#endif
+  }
+
+  static HH_INLINE SipHashLanes RotateLeft32(const SipHashLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX2
+    return SipHashLanes(_mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+#elif HH_TARGET == HH_TARGET_NEON
+    return SipHashLanes(
+        vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(v))));
+#else
+    return RotateLeft<32>(v);
+#endif
+  }
+
+  template <size_t rounds>
+  HH_INLINE void Compress() {
+    for (size_t i = 0; i < rounds; ++i) {
+      // ARX network: add, rotate, exclusive-or.
+      v0 += v1;
+      v2 += v3;
+      v1 = RotateLeft<13>(v1);
+      v3 = RotateLeft16(v3);
+      v1 ^= v0;
+      v3 ^= v2;
+
+      v0 = RotateLeft32(v0);
+
+      v2 += v1;
+      v0 += v3;
+      v1 = RotateLeft<17>(v1);
+      v3 = RotateLeft<21>(v3);
+      v1 ^= v2;
+      v3 ^= v0;
+
+      v2 = RotateLeft32(v2);
+    }
+  }
+
+  SipHashLanes v0;
+  SipHashLanes v1;
+  SipHashLanes v2;
+  SipHashLanes v3;
+};
+
+// Returns the final padded packet of a message of "size" bytes as defined by
+// PaddedUpdate in sip_hash.h.
+static HH_INLINE uint64_t SipHashFinalPacket(const char* HH_RESTRICT bytes,
+                                           const size_t size) {
+  const size_t remainder = size & (sizeof(uint64_t) - 1);
+  // Copy to avoid overrunning the input buffer.
+  char packet[sizeof(uint64_t)] = {0};
+  memcpy(packet, bytes + size - remainder, remainder);
+  packet[sizeof(uint64_t) - 1] = static_cast<char>(size & 0xFF);
+  uint64_t lane;
+  memcpy(&lane, packet, sizeof(lane));
+  return host_from_le64(lane);
+}
+
+static HH_INLINE uint64_t SipHashLoadPacket(const char* HH_RESTRICT bytes) {
+  uint64_t lane;
+  memcpy(&lane, bytes, sizeof(lane));
+  return host_from_le64(lane);
+}
+
+// Returns a vector with the packet at "offset" in each of "bytes".
+static HH_INLINE SipHashLanes SipHashLoadPackets(
+    const char* const (&bytes)[SipHashLanes::N], const size_t offset) {
+#if HH_TARGET == HH_TARGET_AVX512
+  return SipHashLanes(SipHashLoadPacket(bytes[7] + offset),
+                      SipHashLoadPacket(bytes[6] + offset),
+                      SipHashLoadPacket(bytes[5] + offset),
+                      SipHashLoadPacket(bytes[4] + offset),
+                      SipHashLoadPacket(bytes[3] + offset),
+                      SipHashLoadPacket(bytes[2] + offset),
+                      SipHashLoadPacket(bytes[1] + offset),
+                      SipHashLoadPacket(bytes[0] + offset));
+#elif HH_TARGET == HH_TARGET_AVX2
+  return SipHashLanes(SipHashLoadPacket(bytes[3] + offset),
+                      SipHashLoadPacket(bytes[2] + offset),
+                      SipHashLoadPacket(bytes[1] + offset),
+                      SipHashLoadPacket(bytes[0] + offset));
+#else
+  return SipHashLanes(SipHashLoadPacket(bytes[1] + offset),
+                      SipHashLoadPacket(bytes[0] + offset));
+#endif
+}
+
+#endif  // HH_SIP_HASH_LANES
+
+// SipHashStateT "Tag" for instantiations in this namespace.
+struct SipHashBatchTag {};
+
+// Computes SipHashStateT<kUpdateIters, kFinalizeIters> (i.e. SipHash for
+// <2, 4> and SipHash13 for <1, 3>) of all "num_messages" "messages" and stores
+// them in "hashes". The results are identical to calling SipHash/SipHash13
+// for each message.
+//
+// SIMD rotates are slower than scalar ones before AVX-512, so a single
+// message is faster with scalar code (see README.md), but the lanes of a
+// vector can instead each hash a different message: 8 for AVX-512, 4 for
+// AVX2 and 2 for NEON. Other targets hash one message at a time. Consecutive
+// groups of SipHashLanes::N messages are hashed together; all lanes update in
+// lockstep until the shortest message of the group ends, after which each lane
+// is masked out once its final packet is done, so the work is proportional to
+// the longest message in each group. Sorting messages by size thus helps if
+// their lengths vary widely. Not constant-time with respect to the length of
+// the messages, same as SipHash.
+template <int kUpdateIters, int kFinalizeIters>
+HH_INLINE void SipHashBatchT(const HH_U64 (&key)[2],
+                             const StringView* HH_RESTRICT messages,
+                             const size_t num_messages,
+                             HH_U64* HH_RESTRICT hashes) {
+#if HH_SIP_HASH_LANES
+  using Lanes = SipHashLanesT<kUpdateIters, kFinalizeIters>;
+  constexpr size_t kNumLanes = Lanes::kNumLanes;
+  HH_ALIGNAS(64) uint64_t packets[kNumLanes];
+  HH_ALIGNAS(64) uint64_t mask[kNumLanes];
+  HH_ALIGNAS(64) uint64_t results[kNumLanes];
+
+  for (size_t first = 0; first < num_messages; first += kNumLanes) {
+    const size_t num_lanes = num_messages - first < kNumLanes
+                                 ? num_messages - first
+                                 : kNumLanes;
+    // Unused lanes hash an empty message, whose result is discarded.
+    const char* bytes[kNumLanes];
+    size_t num_whole[kNumLanes];  // packets before the padded final packet
+    uint64_t final_packets[kNumLanes];
+    size_t min_whole = ~size_t(0);
+    size_t max_whole = 0;
+    for (size_t lane = 0; lane < kNumLanes; ++lane) {
+      const bool used = lane < num_lanes;
+      const size_t size = used ? messages[first + lane].num_bytes : 0;
+      bytes[lane] = used ? messages[first + lane].data : "";
+      num_whole[lane] = size / sizeof(uint64_t);
+      final_packets[lane] = SipHashFinalPacket(bytes[lane], size);
+      min_whole = num_whole[lane] < min_whole ? num_whole[lane] : min_whole;
+      max_whole = num_whole[lane] > max_whole ? num_whole[lane] : max_whole;
+    }
+
+    Lanes state(key);
+
+    // Whole packets of all lanes.
+    size_t index = 0;
+    for (; index < min_whole; ++index) {
+      state.Update(SipHashLoadPackets(bytes, index * sizeof(uint64_t)));
+    }
+
+    if (min_whole == max_whole) {
+      // Typical for keys of a hash table: all final packets at once.
+      for (size_t lane = 0; lane < kNumLanes; ++lane) {
+        packets[lane] = final_packets[lane];
+      }
+      state.Update(Load<SipHashLanes>(packets));
+    } else {
+      // Each lane's remaining whole packets and then its final packet.
+      for (; index <= max_whole; ++index) {
+        for (size_t lane = 0; lane < kNumLanes; ++lane) {
+          const size_t offset = index * sizeof(uint64_t);
+          packets[lane] = index < num_whole[lane]
+                              ? SipHashLoadPacket(bytes[lane] + offset)
+                              : final_packets[lane];
+          mask[lane] = index <= num_whole[lane] ? ~uint64_t(0) : 0;
+        }
+        state.MaskedUpdate(Load<SipHashLanes>(packets),
+                           Load<SipHashLanes>(mask));
+      }
+    }
+
+    state.Finalize(results);
+    memcpy(hashes + first, results, num_lanes * sizeof(HH_U64));
+  }
+#else
+  using State = SipHashStateT<kUpdateIters, kFinalizeIters, SipHashBatchTag>;
+  for (size_t i = 0; i < num_messages; ++i) {
+    // Not ComputeHash, which is not inline (see arch_specific.h).
+    State state(key);
+    UpdateState(messages[i].data, messages[i].num_bytes, &state);
+    hashes[i] = state.Finalize();
+  }
+#endif
+}
+
+#undef HH_SIP_HASH_LANES
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_SIP_HASH_BATCH_H_
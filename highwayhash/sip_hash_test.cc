@@ -74,9 +74,58 @@ void VerifySipHash() {
   }
 }
 
+// SipHashCat must return the same hash as SipHash of the concatenation for
+// any fragmentation, including empty and packet-aligned fragments. Empty
+// fragments may also pass a null pointer.
+template <class Cat>
+void VerifyCat(const char* name,
+               HH_U64 (*hash_func)(const HH_U64 (&key)[2], const char* bytes,
+                                   const HH_U64 size)) {
+  const int kMaxSize = 64;
+  char in[kMaxSize];
+  for (int i = 0; i < kMaxSize; ++i) {
+    in[i] = static_cast<char>(i);
+  }
+  const HH_U64 key[2] = {0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL};
+  const size_t kFragmentSizes[] = {1, 7, 0, 8, 3, 16, 9};
+  const size_t kNumFragmentSizes = sizeof(kFragmentSizes) / sizeof(size_t);
+
+  for (size_t size = 0; size <= kMaxSize; ++size) {
+    for (size_t first = 0; first < kNumFragmentSizes; ++first) {
+      Cat cat(key);
+      cat.Append(nullptr, 0);
+      size_t pos = 0;
+      for (size_t i = first; pos != size; ++i) {
+        size_t num_bytes = kFragmentSizes[i % kNumFragmentSizes];
+        if (num_bytes > size - pos) num_bytes = size - pos;
+        cat.Append(in + pos, num_bytes);
+        pos += num_bytes;
+      }
+      cat.Append(nullptr, 0);
+      const HH_U64 hash = cat.Finalize();
+#ifdef HH_GOOGLETEST
+      EXPECT_EQ(hash_func(key, in, size), hash)
+          << name << " mismatch at length " << size;
+#else
+      if (hash != hash_func(key, in, size)) {
+        printf("%s mismatch at length %zu\n", name, size);
+        abort();
+      }
+#endif
+    }
+  }
+}
+
+void VerifySipHashCat() {
+  VerifyCat<SipHashCat>("SipHashCat", &SipHash);
+  VerifyCat<SipHash13Cat>("SipHash13Cat", &SipHash13);
+}
+
 #ifdef HH_GOOGLETEST
 TEST(SipHashTest, OutputMatchesExpectations) { VerifySipHash(); }
 
+TEST(SipHashTest, CatMatchesSipHash) { VerifySipHashCat(); }
+
 namespace bm {
 /* Run with:
    blaze run -c opt --cpu=haswell third_party/highwayhash:sip_hash_test -- \
@@ -128,10 +177,8 @@ BENCHMARK(BM<SipHasher>)->Apply(Args);
 DEFINE_HASHER(ScalarSipTreeHash, 4);
 BENCHMARK(BM<ScalarSipTreeHasher>)->Apply(Args);
 
-#ifdef __AVX2__
 DEFINE_HASHER(SipTreeHash, 4);
 BENCHMARK(BM<SipTreeHasher>)->Apply(Args);
-#endif
 
 }  // namespace bm
 #endif  // HH_GOOGLETEST
@@ -143,6 +190,8 @@ BENCHMARK(BM<SipTreeHasher>)->Apply(Args);
 int main(int argc, char* argv[]) {
   highwayhash::VerifySipHash();
   printf("VerifySipHash succeeded.\n");
+  highwayhash::VerifySipHashCat();
+  printf("VerifySipHashCat succeeded.\n");
   return 0;
 }
 #endif
@@ -15,6 +15,9 @@
 #ifndef HIGHWAYHASH_SIP_TREE_HASH_H_
 #define HIGHWAYHASH_SIP_TREE_HASH_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "highwayhash/state_helpers.h"
 
 #ifdef __cplusplus
@@ -31,8 +34,9 @@ extern "C" {
 //
 // Robust versus timing attacks because memory accesses are sequential
 // and the algorithm is branch-free. Compute time is proportional to the
-// number of 8-byte packets and 1.5x faster than an sse41 implementation.
-// Requires an AVX-2 capable CPU.
+// number of 8-byte packets. Uses the best of the AVX2, SSE4.1, NEON, VSX or
+// portable implementations for the current CPU, which all return the same
+// hash as ScalarSipTreeHash.
 //
 // "key" is a secret 256-bit key unknown to attackers.
 // "bytes" is the data to hash (possibly unaligned).
@@ -46,6 +50,50 @@ HH_U64 SipTreeHash13(const HH_U64 (&key)[4], const char* bytes,
 
 #ifdef __cplusplus
 }  // extern "C"
+
+// State of SipTreeHashCatT after hashing some whole 32-byte packets:
+// v0..v3 of each of the four j-lanes, in host byte order. The rounds are
+// template arguments so that the dispatched functors can overload on them.
+template <int kUpdateRounds, int kFinalizeRounds>
+struct SipTreeHashLaneState {
+  uint64_t v[4][4];  // [v0..v3][lane]
+};
+
+// Incremental SipTreeHash for inputs that are not contiguous in memory (e.g.
+// cords or network fragments), analogous to HighwayHashCatT. Finalize returns
+// the same hash as SipTreeHash/SipTreeHash13 of the concatenation of all
+// appended bytes, without having to copy them into one buffer first. Each
+// Append and Finalize chooses the best implementation for the current CPU
+// (see SipTreeHash).
+template <int kUpdateRounds, int kFinalizeRounds>
+class SipTreeHashCatT {
+ public:
+  explicit SipTreeHashCatT(const HH_U64 (&key)[4]);
+
+  // Resets the state of the hasher so it can be used to hash a new string.
+  void Reset(const HH_U64 (&key)[4]);
+
+  // Adds "bytes" to the input. Call this as often as desired. Only reads
+  // bytes within [bytes, bytes + num_bytes); "num_bytes" == 0 has no effect.
+  // Whole packets are hashed directly from "bytes"; only a partial packet at
+  // either end of a fragment is copied into the internal buffer, so there are
+  // no copies at all if the fragment sizes are multiples of 32.
+  void Append(const char* bytes, size_t num_bytes);
+
+  // Returns the hash of all bytes passed to Append since construction or the
+  // last Reset. Does not modify the state, so Append may be called again.
+  HH_U64 Finalize() const;
+
+ private:
+  HH_U64 key_[4];
+  SipTreeHashLaneState<kUpdateRounds, kFinalizeRounds> state_;
+  size_t buffer_usage_ = 0;  // = size % 32 because whole packets are hashed
+  char buffer_[32];
+};
+
+using SipTreeHashCat = SipTreeHashCatT<2, 4>;
+using SipTreeHash13Cat = SipTreeHashCatT<1, 3>;
+
 }  // namespace highwayhash
 #endif
 
@@ -0,0 +1,370 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_SIP_TREE_HASH_LANES_H_
+#define HIGHWAYHASH_SIP_TREE_HASH_LANES_H_
+
+// SipTreeHash for every target, with results identical to
+// scalar_sip_tree_hash.cc. The four j-lanes are held in one (AVX2, AVX-512),
+// two (SSE4.1, NEON, VSX) or four (Portable) vectors.
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details. sip_hash.h
+// is not restricted, hence ReduceSipTreeHash is only used with SipTreeHashTag.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>  // memcpy
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/sip_hash.h"
+
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2
+#include "highwayhash/vector256.h"
+#elif HH_TARGET == HH_TARGET_SSE41
+#include "highwayhash/vector128.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/vector_neon.h"
+#elif HH_TARGET == HH_TARGET_VSX
+#include "highwayhash/hh_vsx.h"
+#endif
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+namespace highwayhash {
+// See vector128.h for why this namespace is necessary.
+namespace HH_TARGET_NAME {
+
+// Paper: https://www.131002.net/siphash/siphash.pdf
+// Tree hash extension: https://doi.org/10.4236/jis.2014.53010
+
+// The hash state is updated by injecting 4x8-byte packets;
+// XORing together all state vectors yields 32 bytes that are
+// reduced to 64 bits via 8-byte SipHash.
+
+// SipHashStateT "Tag" for instantiations in this namespace.
+struct SipTreeHashTag {};
+
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2
+using SipTreeLanes = V4x64U;
+#elif HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+using SipTreeLanes = V2x64U;
+#elif HH_TARGET == HH_TARGET_VSX
+using SipTreeLanes = PPC_VEC_U64;
+#else
+// Portable, and also Generic, for which the compiler already vectorizes the
+// scalar loops.
+#define HH_SIP_TREE_SCALAR 1
+using SipTreeLanes = uint64_t;
+#endif
+
+static constexpr size_t kSipTreeNumLanes = 4;
+static constexpr size_t kSipTreePacketSize = kSipTreeNumLanes * 8;
+static constexpr size_t kSipTreeLanesPerVector =
+    sizeof(SipTreeLanes) / sizeof(uint64_t);
+static constexpr size_t kSipTreeNumVectors =
+    kSipTreeNumLanes / kSipTreeLanesPerVector;
+
+// Loads kSipTreeLanesPerVector (host byte order) lanes from unaligned "from".
+static HH_INLINE SipTreeLanes SipTreeLoad(const char* HH_RESTRICT from) {
+#if HH_TARGET == HH_TARGET_VSX
+  return vec_vsx_ld(0, reinterpret_cast<const PPC_VEC_U64*>(from));
+#elif defined(HH_SIP_TREE_SCALAR)
+  uint64_t lane;
+  memcpy(&lane, from, sizeof(lane));
+  return lane;
+#else
+  return LoadUnaligned<SipTreeLanes>(reinterpret_cast<const uint64_t*>(from));
+#endif
+}
+
+static HH_INLINE void SipTreeStore(const SipTreeLanes& lanes,
+                                   uint64_t* HH_RESTRICT to) {
+#if HH_TARGET == HH_TARGET_VSX
+  vec_vsx_st(lanes, 0, reinterpret_cast<PPC_VEC_U64*>(to));
+#elif defined(HH_SIP_TREE_SCALAR)
+  *to = lanes;
+#else
+  StoreUnaligned(lanes, to);
+#endif
+}
+
+static HH_INLINE SipTreeLanes SipTreeBroadcast(const uint64_t value) {
+#if HH_TARGET == HH_TARGET_VSX
+  return vec_splats(static_cast<unsigned long long>(value));  // NOLINT
+#else
+  return SipTreeLanes(value);
+#endif
+}
+
+// Rotates each 64-bit lane of "v" left by kBits.
+template <int kBits>
+static HH_INLINE SipTreeLanes SipTreeRotateLeft(const SipTreeLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX512
+  // (The unmasked _mm256_rol_epi64 triggers -Wmaybe-uninitialized in GCC.)
+  return SipTreeLanes(_mm256_maskz_rol_epi64(0xF, v, kBits));
+#elif HH_TARGET == HH_TARGET_NEON
+  // Inserts the shifted bits into the upper bits shifted down.
+  return SipTreeLanes(vsliq_n_u64(vshrq_n_u64(v, 64 - kBits), v, kBits));
+#elif HH_TARGET == HH_TARGET_VSX
+  return vec_rl(v, vec_splats(static_cast<unsigned long long>(kBits)));
+#else
+  return (v << kBits) | (v >> (64 - kBits));
+#endif
+}
+
+// Byte-granular rotates are a single shuffle.
+static HH_INLINE SipTreeLanes SipTreeRotateLeft16(const SipTreeLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX2
+  const SipTreeLanes control(0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL,
+                             0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL);
+  return SipTreeLanes(_mm256_shuffle_epi8(v, control));
+#elif HH_TARGET == HH_TARGET_SSE41
+  const SipTreeLanes control(0x0D0C0B0A09080F0EULL, 0x0504030201000706ULL);
+  return SipTreeLanes(_mm_shuffle_epi8(v, control));
+#else
+  return SipTreeRotateLeft<16>(v);
+#endif
+}
+
+static HH_INLINE SipTreeLanes SipTreeRotateLeft32(const SipTreeLanes& v) {
+#if HH_TARGET == HH_TARGET_AVX2
+  return SipTreeLanes(_mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+#elif HH_TARGET == HH_TARGET_SSE41
+  return SipTreeLanes(_mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+#elif HH_TARGET == HH_TARGET_NEON
+  return SipTreeLanes(
+      vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(v))));
+#else
+  return SipTreeRotateLeft<32>(v);
+#endif
+}
+
+// 32 bytes key. The kSipTreeNumVectors vectors are independent, so the
+// compiler can interleave their rounds to hide the latency of each.
+template <int kUpdateRounds, int kFinalizeRounds>
+class SipTreeHashStateT {
+ public:
+  // Leaves the state uninitialized; call Restore before any Update.
+  HH_INLINE SipTreeHashStateT() {}
+
+  explicit HH_INLINE SipTreeHashStateT(const HH_U64 (&keys)[kSipTreeNumLanes]) {
+    // Each lane's key is also tweaked by its index.
+    const uint64_t tweaks[kSipTreeNumLanes] = {
+        kSipTreeNumLanes | 0, kSipTreeNumLanes | 1, kSipTreeNumLanes | 2,
+        kSipTreeNumLanes | 3};
+    const char* key_bytes = reinterpret_cast<const char*>(keys);
+    const char* tweak_bytes = reinterpret_cast<const char*>(tweaks);
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      const size_t offset = i * sizeof(SipTreeLanes);
+      const SipTreeLanes key(SipTreeLoad(key_bytes + offset) ^
+                             SipTreeLoad(tweak_bytes + offset));
+      v0[i] = SipTreeBroadcast(0x736f6d6570736575ull) ^ key;
+      v1[i] = SipTreeBroadcast(0x646f72616e646f6dull) ^ key;
+      v2[i] = SipTreeBroadcast(0x6c7967656e657261ull) ^ key;
+      v3[i] = SipTreeBroadcast(0x7465646279746573ull) ^ key;
+    }
+  }
+
+  // Copies the state to/from "words" [v0..v3][lane], e.g. between the
+  // Append calls of SipTreeHashCatT.
+  HH_INLINE void Save(uint64_t (&words)[4][kSipTreeNumLanes]) const {
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      const size_t lane = i * kSipTreeLanesPerVector;
+      SipTreeStore(v0[i], &words[0][lane]);
+      SipTreeStore(v1[i], &words[1][lane]);
+      SipTreeStore(v2[i], &words[2][lane]);
+      SipTreeStore(v3[i], &words[3][lane]);
+    }
+  }
+
+  HH_INLINE void Restore(const uint64_t (&words)[4][kSipTreeNumLanes]) {
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      const size_t lane = i * kSipTreeLanesPerVector;
+      v0[i] = SipTreeLoad(reinterpret_cast<const char*>(&words[0][lane]));
+      v1[i] = SipTreeLoad(reinterpret_cast<const char*>(&words[1][lane]));
+      v2[i] = SipTreeLoad(reinterpret_cast<const char*>(&words[2][lane]));
+      v3[i] = SipTreeLoad(reinterpret_cast<const char*>(&words[3][lane]));
+    }
+  }
+
+  // "packet" points to the next kSipTreePacketSize bytes of input.
+  HH_INLINE void Update(const char* HH_RESTRICT packet) {
+    SipTreeLanes packets[kSipTreeNumVectors];
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      packets[i] = SipTreeLoad(packet + i * sizeof(SipTreeLanes));
+      v3[i] ^= packets[i];
+    }
+
+    Compress<kUpdateRounds>();
+
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      v0[i] ^= packets[i];
+    }
+  }
+
+  // Stores the hash of each lane in "hashes".
+  HH_INLINE void Finalize(uint64_t (&hashes)[kSipTreeNumLanes]) {
+    // Mix in bits to avoid leaking the key if all packets were zero.
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      v2[i] ^= SipTreeBroadcast(0xFF);
+    }
+
+    Compress<kFinalizeRounds>();
+
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      SipTreeStore((v0[i] ^ v1[i]) ^ (v2[i] ^ v3[i]),
+                   hashes + i * kSipTreeLanesPerVector);
+    }
+  }
+
+ private:
+  template <int kRounds>
+  HH_INLINE void Compress() {
+    // Loop is faster than unrolling!
+    for (size_t i = 0; i < kSipTreeNumVectors; ++i) {
+      for (int round = 0; round < kRounds; ++round) {
+        // ARX network: add, rotate, exclusive-or.
+        v0[i] += v1[i];
+        v2[i] += v3[i];
+        v1[i] = SipTreeRotateLeft<13>(v1[i]);
+        v3[i] = SipTreeRotateLeft16(v3[i]);
+        v1[i] ^= v0[i];
+        v3[i] ^= v2[i];
+
+        v0[i] = SipTreeRotateLeft32(v0[i]);
+
+        v2[i] += v1[i];
+        v0[i] += v3[i];
+        v1[i] = SipTreeRotateLeft<17>(v1[i]);
+        v3[i] = SipTreeRotateLeft<21>(v3[i]);
+        v1[i] ^= v2[i];
+        v3[i] ^= v0[i];
+
+        v2[i] = SipTreeRotateLeft32(v2[i]);
+      }
+    }
+  }
+
+  SipTreeLanes v0[kSipTreeNumVectors];
+  SipTreeLanes v1[kSipTreeNumVectors];
+  SipTreeLanes v2[kSipTreeNumVectors];
+  SipTreeLanes v3[kSipTreeNumVectors];
+};
+
+// Updates "state" with the final packet: the remaining 0..31 bytes, with the
+// "remainder" (size % 32) in the upper byte and any intervening bytes zero.
+template <class State>
+static HH_INLINE void SipTreeUpdateFinal(const char* HH_RESTRICT bytes,
+                                         const size_t remainder,
+                                         State* HH_RESTRICT state) {
+  // Load any remaining bytes individually and combine into a uint32_t.
+  // Length padding ensures that zero-valued buffers of different lengths
+  // result in different hashes.
+  const size_t remainder_mod4 = remainder & 3;
+  const size_t remaining_32 = remainder >> 2;  // 0..7
+  uint32_t packet4 = static_cast<uint32_t>(remainder << 24);
+  const char* final_bytes = bytes + remaining_32 * 4;
+  for (size_t i = 0; i < remainder_mod4; ++i) {
+    const uint32_t byte = static_cast<unsigned char>(final_bytes[i]);
+    packet4 += byte << (i * 8);
+  }
+
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2
+  // Copying into a buffer would incur a store-to-load-forwarding stall.
+  // Instead, masked loads read any remaining whole uint32_t without
+  // incurring page faults for the others. The packed mask has one byte per
+  // uint32_t and is sign-extended to the 0xFFFFFFFF required by maskload.
+  const uint64_t packed_mask =
+      0x00FFFFFFFFFFFFFFULL >> ((7 - remaining_32) * 8);
+  const V4x64U mask(_mm256_cvtepi8_epi32(_mm_cvtsi64_si128(packed_mask)));
+  const V4x64U packet28(
+      _mm256_maskload_epi32(reinterpret_cast<const int*>(bytes), mask));
+  // The upper 4 bytes of packet28 are zero; replace with packet4.
+  const __m256i v4 = _mm256_broadcastd_epi32(_mm_cvtsi32_si128(packet4));
+  HH_ALIGNAS(32) char packet[kSipTreePacketSize];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(packet),
+                     _mm256_blend_epi32(packet28, v4, 0x80));
+#else
+  char packet[kSipTreePacketSize] = {0};
+  memcpy(packet, bytes, remaining_32 * 4);
+  memcpy(packet + kSipTreePacketSize - 4, &packet4, sizeof(packet4));
+#endif
+  state->Update(packet);
+}
+
+// Updates "state" with the final packet and returns the hash of the entire
+// input. "remaining_bytes" are the last "remainder" (size % 32) bytes.
+template <int kUpdateRounds, int kFinalizeRounds>
+HH_INLINE HH_U64 SipTreeHashFinish(
+    const HH_U64 (&key)[kSipTreeNumLanes],
+    const char* HH_RESTRICT remaining_bytes, const size_t remainder,
+    SipTreeHashStateT<kUpdateRounds, kFinalizeRounds>* HH_RESTRICT state) {
+  SipTreeUpdateFinal(remaining_bytes, remainder, state);
+
+  uint64_t hashes[kSipTreeNumLanes];
+  state->Finalize(hashes);
+
+  typename SipHashStateT<kUpdateRounds, kFinalizeRounds>::Key reduce_key;
+  memcpy(&reduce_key, &key, sizeof(reduce_key));
+  return ReduceSipTreeHash<kSipTreeNumLanes, kUpdateRounds, kFinalizeRounds,
+                           SipTreeHashTag>(reduce_key, hashes);
+}
+
+// Returns the same hash as ScalarSipTreeHashT.
+template <int kUpdateRounds, int kFinalizeRounds>
+HH_INLINE HH_U64 SipTreeHashT(const HH_U64 (&key)[kSipTreeNumLanes],
+                              const char* HH_RESTRICT bytes,
+                              const HH_U64 size) {
+  SipTreeHashStateT<kUpdateRounds, kFinalizeRounds> state(key);
+
+  const size_t remainder = size & (kSipTreePacketSize - 1);
+  const size_t truncated_size = size - remainder;
+  for (size_t i = 0; i < truncated_size; i += kSipTreePacketSize) {
+    state.Update(bytes + i);
+  }
+  return SipTreeHashFinish(key, bytes + truncated_size, remainder, &state);
+}
+
+// Incremental hashing for SipTreeHashCatT, whose state is stored in "words"
+// between calls. Updates "words" with "num_packets" consecutive packets.
+template <int kUpdateRounds, int kFinalizeRounds>
+HH_INLINE void SipTreeHashCatUpdateT(const char* HH_RESTRICT packets,
+                                     const size_t num_packets,
+                                     uint64_t (&words)[4][kSipTreeNumLanes]) {
+  SipTreeHashStateT<kUpdateRounds, kFinalizeRounds> state;
+  state.Restore(words);
+  for (size_t i = 0; i < num_packets; ++i) {
+    state.Update(packets + i * kSipTreePacketSize);
+  }
+  state.Save(words);
+}
+
+template <int kUpdateRounds, int kFinalizeRounds>
+HH_INLINE HH_U64 SipTreeHashCatFinishT(
+    const HH_U64 (&key)[kSipTreeNumLanes],
+    const uint64_t (&words)[4][kSipTreeNumLanes],
+    const char* HH_RESTRICT remaining_bytes, const size_t remainder) {
+  SipTreeHashStateT<kUpdateRounds, kFinalizeRounds> state;
+  state.Restore(words);
+  return SipTreeHashFinish(key, remaining_bytes, remainder, &state);
+}
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+
+#endif  // HIGHWAYHASH_SIP_TREE_HASH_LANES_H_
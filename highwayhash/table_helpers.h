@@ -0,0 +1,52 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_TABLE_HELPERS_H_
+#define HIGHWAYHASH_TABLE_HELPERS_H_
+
+// Constants and helper functions shared by the hash tables and filters
+// (hasher.h, bloom_filter.h, cuckoo_filter.h, concurrent_hash_set.h).
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/compiler_specific.h"
+
+namespace highwayhash {
+
+// Recommended maximum number of keys to hash and prefetch before probing the
+// first of their buckets (HashAndPrefetch and the batch functions of the
+// filters). More prefetches than this exceed the number of outstanding L1
+// misses on current CPUs, so that the first buckets may already be evicted
+// when they are probed.
+static constexpr size_t kMaxPrefetchKeys = 16;
+
+// Returns the first address at or after "allocated" that is a multiple of
+// "alignment" (a power of two, e.g. the cache line size). new[] only
+// guarantees alignof(max_align_t), so callers allocate "alignment" additional
+// bytes and use the returned pointer instead.
+static HH_INLINE char* AlignUp(char* allocated, const size_t alignment) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(allocated);
+  const uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+  return allocated + (aligned - address);
+}
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_TABLE_HELPERS_H_
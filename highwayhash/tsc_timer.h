@@ -80,6 +80,15 @@ namespace highwayhash {
 // requires fences. Unfortunately, it is not accessible on all OSes and we
 // prefer to avoid kernel-mode drivers. Performance counters are also affected
 // by several under/over-count errata, so we use the TSC instead.
+//
+// On AArch64, CNTVCT_EL0 counts at the fixed CNTFRQ_EL0 (e.g. 25 MHz to
+// 1 GHz, unrelated to the CPU clock), and reads may be speculated. ISB is the
+// analog of LFENCE: it completes earlier instructions and refetches later
+// ones, so Start = ISB/MRS/ISB and Stop = ISB/MRS. With HH_TIMER_PMU_CYCLES
+// (see arch_specific.h), PMCCNTR_EL0 is read instead, with the same fences.
+// On PPC, the time base (mftb, i.e. SPR 268) is read after isync for the same
+// reason. nanobenchmark converts ticks to cycles via InvariantTicksPerSecond
+// and NominalClockRate, so cycles/byte remain comparable to x86.
 
 // Primary templates; must use one of the specializations.
 template <typename T>
@@ -94,9 +103,11 @@ template <>
 inline uint64_t Start<uint64_t>() {
   uint64_t t;
 #if HH_ARCH_PPC
-  asm volatile("mfspr %0, %1" : "=r"(t) : "i"(268));
+  asm volatile("isync\n\tmfspr %0, %1" : "=r"(t) : "i"(268) : "memory");
+#elif HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+  asm volatile("isb\n\tmrs %0, pmccntr_el0\n\tisb" : "=r"(t) : : "memory");
 #elif HH_ARCH_AARCH64
-  asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+  asm volatile("isb\n\tmrs %0, cntvct_el0\n\tisb" : "=r"(t) : : "memory");
 #elif HH_ARCH_X64 && HH_MSC_VERSION
   _mm_lfence();
   HH_COMPILER_FENCE;
@@ -125,9 +136,11 @@ template <>
 inline uint64_t Stop<uint64_t>() {
   uint64_t t;
 #if HH_ARCH_PPC
-  asm volatile("mfspr %0, %1" : "=r"(t) : "i"(268));
+  asm volatile("isync\n\tmfspr %0, %1" : "=r"(t) : "i"(268) : "memory");
+#elif HH_ARCH_AARCH64 && HH_TIMER_PMU_CYCLES
+  asm volatile("isb\n\tmrs %0, pmccntr_el0" : "=r"(t) : : "memory");
 #elif HH_ARCH_AARCH64
-  asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+  asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(t) : : "memory");
 #elif HH_ARCH_X64 && HH_MSC_VERSION
   HH_COMPILER_FENCE;
   unsigned aux;
@@ -0,0 +1,769 @@
+// Copyright 2016 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_VECTOR512_H_
+#define HIGHWAYHASH_VECTOR512_H_
+
+// Defines SIMD vector classes ("V8x64U") with overloaded arithmetic operators:
+// const V8x64U masked_sum = (a + b) & m;
+// This is shorter and more readable than compiler intrinsics:
+// const __m512i masked_sum = _mm512_and_si512(_mm512_add_epi64(a, b), m);
+// There is typically no runtime cost for these abstractions.
+//
+// The naming convention is VNxBBT where N is the number of lanes, BB the
+// number of bits per lane and T is the lane type: unsigned integer (U),
+// signed integer (I), or floating-point (F).
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/compiler_specific.h"
+
+// For auto-dependency generation, we need to include all headers but not their
+// contents (otherwise compilation fails because -mavx512f is not specified).
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+
+// (This include cannot be moved within a namespace due to conflicts with
+// other system headers; see the comment in hh_sse41.h.)
+#include <immintrin.h>
+
+namespace highwayhash {
+// To prevent ODR violations when including this from multiple translation
+// units (TU) that are compiled with different flags, the contents must reside
+// in a namespace whose name is unique to the TU. NOTE: this behavior is
+// incompatible with precompiled modules and requires textual inclusion instead.
+namespace HH_TARGET_NAME {
+
+// Primary template for 512-bit AVX-512 vectors; only specializations are used.
+// Requires AVX-512F plus BW (8/16-bit lanes) and DQ (movm, float logic ops).
+template <typename T>
+class V512 {};
+
+template <>
+class V512<uint8_t> {
+ public:
+  using Intrinsic = __m512i;
+  using T = uint8_t;
+  static constexpr size_t N = 64;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Broadcasts i to all lanes.
+  HH_INLINE explicit V512(T i)
+      : v_(_mm512_set1_epi8(static_cast<char>(i))) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // There are no greater-than comparison instructions for unsigned T.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_movm_epi8(_mm512_cmpeq_epi8_mask(v_, other.v_)));
+  }
+
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_epi8(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_epi8(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_si512(v_, other.v_);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+template <>
+class V512<uint16_t> {
+ public:
+  using Intrinsic = __m512i;
+  using T = uint16_t;
+  static constexpr size_t N = 32;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Broadcasts i to all lanes.
+  HH_INLINE explicit V512(T i)
+      : v_(_mm512_set1_epi16(static_cast<short>(i))) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // There are no greater-than comparison instructions for unsigned T.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_movm_epi16(_mm512_cmpeq_epi16_mask(v_, other.v_)));
+  }
+
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_epi16(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_epi16(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_si512(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator<<=(const int count) {
+    v_ = _mm512_slli_epi16(v_, count);
+    return *this;
+  }
+
+  HH_INLINE V512& operator>>=(const int count) {
+    v_ = _mm512_srli_epi16(v_, count);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+template <>
+class V512<uint32_t> {
+ public:
+  using Intrinsic = __m512i;
+  using T = uint32_t;
+  static constexpr size_t N = 16;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Lane 0 (p_0) is the lowest.
+  HH_INLINE V512(T p_F, T p_E, T p_D, T p_C, T p_B, T p_A, T p_9, T p_8, T p_7,
+                 T p_6, T p_5, T p_4, T p_3, T p_2, T p_1, T p_0)
+      : v_(_mm512_set_epi32(p_F, p_E, p_D, p_C, p_B, p_A, p_9, p_8, p_7, p_6,
+                            p_5, p_4, p_3, p_2, p_1, p_0)) {}
+
+  // Broadcasts i to all lanes.
+  HH_INLINE explicit V512(T i)
+      : v_(_mm512_set1_epi32(static_cast<int>(i))) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // There are no greater-than comparison instructions for unsigned T.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_movm_epi32(_mm512_cmpeq_epi32_mask(v_, other.v_)));
+  }
+
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_epi32(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_epi32(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_si512(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator<<=(const int count) {
+    v_ = _mm512_slli_epi32(v_, count);
+    return *this;
+  }
+
+  HH_INLINE V512& operator>>=(const int count) {
+    v_ = _mm512_srli_epi32(v_, count);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+template <>
+class V512<uint64_t> {
+ public:
+  using Intrinsic = __m512i;
+  using T = uint64_t;
+  static constexpr size_t N = 8;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Lane 0 (p_0) is the lowest.
+  HH_INLINE V512(T p_7, T p_6, T p_5, T p_4, T p_3, T p_2, T p_1, T p_0)
+      : v_(_mm512_set_epi64(p_7, p_6, p_5, p_4, p_3, p_2, p_1, p_0)) {}
+
+  // Broadcasts i to all lanes.
+  HH_INLINE explicit V512(T i)
+      : v_(_mm512_set1_epi64(static_cast<long long>(i))) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // There are no greater-than comparison instructions for unsigned T.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_movm_epi64(_mm512_cmpeq_epi64_mask(v_, other.v_)));
+  }
+
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_epi64(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_epi64(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_si512(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_si512(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator<<=(const int count) {
+    v_ = _mm512_slli_epi64(v_, count);
+    return *this;
+  }
+
+  HH_INLINE V512& operator>>=(const int count) {
+    v_ = _mm512_srli_epi64(v_, count);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+template <>
+class V512<float> {
+ public:
+  using Intrinsic = __m512;
+  using T = float;
+  static constexpr size_t N = 16;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Lane 0 (p_0) is the lowest.
+  HH_INLINE V512(T p_F, T p_E, T p_D, T p_C, T p_B, T p_A, T p_9, T p_8, T p_7,
+                 T p_6, T p_5, T p_4, T p_3, T p_2, T p_1, T p_0)
+      : v_(_mm512_set_ps(p_F, p_E, p_D, p_C, p_B, p_A, p_9, p_8, p_7, p_6, p_5,
+                         p_4, p_3, p_2, p_1, p_0)) {}
+
+  // Broadcasts to all lanes.
+  HH_INLINE explicit V512(T f) : v_(_mm512_set1_ps(f)) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // AVX-512 comparisons return masks; expand them to all-ones lanes.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_castsi512_ps(_mm512_movm_epi32(
+        _mm512_cmp_ps_mask(v_, other.v_, _CMP_EQ_OQ))));
+  }
+  HH_INLINE V512 operator<(const V512& other) const {
+    return V512(_mm512_castsi512_ps(_mm512_movm_epi32(
+        _mm512_cmp_ps_mask(v_, other.v_, _CMP_LT_OS))));
+  }
+  HH_INLINE V512 operator>(const V512& other) const {
+    return V512(_mm512_castsi512_ps(_mm512_movm_epi32(
+        _mm512_cmp_ps_mask(other.v_, v_, _CMP_LT_OS))));
+  }
+
+  HH_INLINE V512& operator*=(const V512& other) {
+    v_ = _mm512_mul_ps(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator/=(const V512& other) {
+    v_ = _mm512_div_ps(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_ps(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_ps(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_ps(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_ps(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_ps(v_, other.v_);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+template <>
+class V512<double> {
+ public:
+  using Intrinsic = __m512d;
+  using T = double;
+  static constexpr size_t N = 8;
+
+  // Leaves v_ uninitialized - typically used for output parameters.
+  HH_INLINE V512() {}
+
+  // Lane 0 (p_0) is the lowest.
+  HH_INLINE V512(T p_7, T p_6, T p_5, T p_4, T p_3, T p_2, T p_1, T p_0)
+      : v_(_mm512_set_pd(p_7, p_6, p_5, p_4, p_3, p_2, p_1, p_0)) {}
+
+  // Broadcasts to all lanes.
+  HH_INLINE explicit V512(T f) : v_(_mm512_set1_pd(f)) {}
+
+  // Copy from other vector.
+  HH_INLINE explicit V512(const V512& other) : v_(other.v_) {}
+  template <typename U>
+  HH_INLINE explicit V512(const V512<U>& other) : v_(other) {}
+  HH_INLINE V512& operator=(const V512& other) {
+    v_ = other.v_;
+    return *this;
+  }
+
+  // Convert from/to intrinsics.
+  HH_INLINE V512(const Intrinsic& v) : v_(v) {}
+  HH_INLINE V512& operator=(const Intrinsic& v) {
+    v_ = v;
+    return *this;
+  }
+  HH_INLINE operator Intrinsic() const { return v_; }
+
+  // AVX-512 comparisons return masks; expand them to all-ones lanes.
+  HH_INLINE V512 operator==(const V512& other) const {
+    return V512(_mm512_castsi512_pd(_mm512_movm_epi64(
+        _mm512_cmp_pd_mask(v_, other.v_, _CMP_EQ_OQ))));
+  }
+  HH_INLINE V512 operator<(const V512& other) const {
+    return V512(_mm512_castsi512_pd(_mm512_movm_epi64(
+        _mm512_cmp_pd_mask(v_, other.v_, _CMP_LT_OS))));
+  }
+  HH_INLINE V512 operator>(const V512& other) const {
+    return V512(_mm512_castsi512_pd(_mm512_movm_epi64(
+        _mm512_cmp_pd_mask(other.v_, v_, _CMP_LT_OS))));
+  }
+
+  HH_INLINE V512& operator*=(const V512& other) {
+    v_ = _mm512_mul_pd(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator/=(const V512& other) {
+    v_ = _mm512_div_pd(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator+=(const V512& other) {
+    v_ = _mm512_add_pd(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator-=(const V512& other) {
+    v_ = _mm512_sub_pd(v_, other.v_);
+    return *this;
+  }
+
+  HH_INLINE V512& operator&=(const V512& other) {
+    v_ = _mm512_and_pd(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator|=(const V512& other) {
+    v_ = _mm512_or_pd(v_, other.v_);
+    return *this;
+  }
+  HH_INLINE V512& operator^=(const V512& other) {
+    v_ = _mm512_xor_pd(v_, other.v_);
+    return *this;
+  }
+
+ private:
+  Intrinsic v_;
+};
+
+// Nonmember functions for any V512 via member functions.
+
+template <typename T>
+HH_INLINE V512<T> operator*(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t *= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator/(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t /= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator+(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t += right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator-(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t -= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator&(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t &= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator|(const V512<T> left, const V512<T>& right) {
+  V512<T> t(left);
+  return t |= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator^(const V512<T>& left, const V512<T>& right) {
+  V512<T> t(left);
+  return t ^= right;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator<<(const V512<T>& v, const int count) {
+  V512<T> t(v);
+  return t <<= count;
+}
+
+template <typename T>
+HH_INLINE V512<T> operator>>(const V512<T>& v, const int count) {
+  V512<T> t(v);
+  return t >>= count;
+}
+
+// We do not provide operator<<(V, __m128i) because it has 4 cycle latency
+// (to broadcast the shift count). It is faster to use sllv_epi64 etc. instead.
+
+using V64x8U = V512<uint8_t>;
+using V32x16U = V512<uint16_t>;
+using V16x32U = V512<uint32_t>;
+using V8x64U = V512<uint64_t>;
+using V16x32F = V512<float>;
+using V8x64F = V512<double>;
+
+// Load/Store for any V512.
+
+// We differentiate between targets' vector types via template specialization.
+// Calling Load<V>(floats) is more natural than Load(V16x32F(), floats) and may
+// generate better code in unoptimized builds. Only declare the primary
+// templates to avoid needing mutual exclusion with vector128/256.
+
+template <class V>
+HH_INLINE V Load(const typename V::T* const HH_RESTRICT from);
+
+template <class V>
+HH_INLINE V LoadUnaligned(const typename V::T* const HH_RESTRICT from);
+
+template <>
+HH_INLINE V64x8U Load(const V64x8U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V64x8U(_mm512_load_si512(p));
+}
+template <>
+HH_INLINE V32x16U Load(const V32x16U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V32x16U(_mm512_load_si512(p));
+}
+template <>
+HH_INLINE V16x32U Load(const V16x32U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V16x32U(_mm512_load_si512(p));
+}
+template <>
+HH_INLINE V8x64U Load(const V8x64U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V8x64U(_mm512_load_si512(p));
+}
+template <>
+HH_INLINE V16x32F Load(const V16x32F::T* const HH_RESTRICT from) {
+  return V16x32F(_mm512_load_ps(from));
+}
+template <>
+HH_INLINE V8x64F Load(const V8x64F::T* const HH_RESTRICT from) {
+  return V8x64F(_mm512_load_pd(from));
+}
+
+template <>
+HH_INLINE V64x8U LoadUnaligned(const V64x8U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V64x8U(_mm512_loadu_si512(p));
+}
+template <>
+HH_INLINE V32x16U LoadUnaligned(const V32x16U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V32x16U(_mm512_loadu_si512(p));
+}
+template <>
+HH_INLINE V16x32U LoadUnaligned(const V16x32U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V16x32U(_mm512_loadu_si512(p));
+}
+template <>
+HH_INLINE V8x64U LoadUnaligned(const V8x64U::T* const HH_RESTRICT from) {
+  const __m512i* const HH_RESTRICT p = reinterpret_cast<const __m512i*>(from);
+  return V8x64U(_mm512_loadu_si512(p));
+}
+template <>
+HH_INLINE V16x32F LoadUnaligned(const V16x32F::T* const HH_RESTRICT from) {
+  return V16x32F(_mm512_loadu_ps(from));
+}
+template <>
+HH_INLINE V8x64F LoadUnaligned(const V8x64F::T* const HH_RESTRICT from) {
+  return V8x64F(_mm512_loadu_pd(from));
+}
+
+// "to" must be vector-aligned.
+template <typename T>
+HH_INLINE void Store(const V512<T>& v, T* const HH_RESTRICT to) {
+  _mm512_store_si512(reinterpret_cast<__m512i * HH_RESTRICT>(to), v);
+}
+HH_INLINE void Store(const V512<float>& v, float* const HH_RESTRICT to) {
+  _mm512_store_ps(to, v);
+}
+HH_INLINE void Store(const V512<double>& v, double* const HH_RESTRICT to) {
+  _mm512_store_pd(to, v);
+}
+
+template <typename T>
+HH_INLINE void StoreUnaligned(const V512<T>& v, T* const HH_RESTRICT to) {
+  _mm512_storeu_si512(reinterpret_cast<__m512i * HH_RESTRICT>(to), v);
+}
+HH_INLINE void StoreUnaligned(const V512<float>& v,
+                              float* const HH_RESTRICT to) {
+  _mm512_storeu_ps(to, v);
+}
+HH_INLINE void StoreUnaligned(const V512<double>& v,
+                              double* const HH_RESTRICT to) {
+  _mm512_storeu_pd(to, v);
+}
+
+// Writes directly to (aligned) memory, bypassing the cache. This is useful for
+// data that will not be read again in the near future.
+template <typename T>
+HH_INLINE void Stream(const V512<T>& v, T* const HH_RESTRICT to) {
+  _mm512_stream_si512(reinterpret_cast<__m512i * HH_RESTRICT>(to), v);
+}
+HH_INLINE void Stream(const V512<float>& v, float* const HH_RESTRICT to) {
+  _mm512_stream_ps(to, v);
+}
+HH_INLINE void Stream(const V512<double>& v, double* const HH_RESTRICT to) {
+  _mm512_stream_pd(to, v);
+}
+
+// Miscellaneous functions.
+
+template <typename T>
+HH_INLINE V512<T> RotateLeft(const V512<T>& v, const int count) {
+  constexpr size_t num_bits = sizeof(T) * 8;
+  return (v << count) | (v >> (num_bits - count));
+}
+
+template <typename T>
+HH_INLINE V512<T> AndNot(const V512<T>& neg_mask, const V512<T>& values) {
+  return V512<T>(_mm512_andnot_si512(neg_mask, values));
+}
+template <>
+HH_INLINE V512<float> AndNot(const V512<float>& neg_mask,
+                             const V512<float>& values) {
+  return V512<float>(_mm512_andnot_ps(neg_mask, values));
+}
+template <>
+HH_INLINE V512<double> AndNot(const V512<double>& neg_mask,
+                              const V512<double>& values) {
+  return V512<double>(_mm512_andnot_pd(neg_mask, values));
+}
+
+// Returns b[i] if the sign bit of mask[i] is set, otherwise a[i].
+HH_INLINE V16x32F Select(const V16x32F& a, const V16x32F& b,
+                         const V16x32F& mask) {
+  const __mmask16 k = _mm512_movepi32_mask(_mm512_castps_si512(mask));
+  return V16x32F(_mm512_mask_blend_ps(k, a, b));
+}
+
+HH_INLINE V8x64F Select(const V8x64F& a, const V8x64F& b, const V8x64F& mask) {
+  const __mmask8 k = _mm512_movepi64_mask(_mm512_castpd_si512(mask));
+  return V8x64F(_mm512_mask_blend_pd(k, a, b));
+}
+
+// Min/Max
+
+HH_INLINE V64x8U Min(const V64x8U& v0, const V64x8U& v1) {
+  return V64x8U(_mm512_min_epu8(v0, v1));
+}
+
+HH_INLINE V64x8U Max(const V64x8U& v0, const V64x8U& v1) {
+  return V64x8U(_mm512_max_epu8(v0, v1));
+}
+
+HH_INLINE V32x16U Min(const V32x16U& v0, const V32x16U& v1) {
+  return V32x16U(_mm512_min_epu16(v0, v1));
+}
+
+HH_INLINE V32x16U Max(const V32x16U& v0, const V32x16U& v1) {
+  return V32x16U(_mm512_max_epu16(v0, v1));
+}
+
+HH_INLINE V16x32U Min(const V16x32U& v0, const V16x32U& v1) {
+  return V16x32U(_mm512_min_epu32(v0, v1));
+}
+
+HH_INLINE V16x32U Max(const V16x32U& v0, const V16x32U& v1) {
+  return V16x32U(_mm512_max_epu32(v0, v1));
+}
+
+HH_INLINE V16x32F Min(const V16x32F& v0, const V16x32F& v1) {
+  return V16x32F(_mm512_min_ps(v0, v1));
+}
+
+HH_INLINE V16x32F Max(const V16x32F& v0, const V16x32F& v1) {
+  return V16x32F(_mm512_max_ps(v0, v1));
+}
+
+HH_INLINE V8x64F Min(const V8x64F& v0, const V8x64F& v1) {
+  return V8x64F(_mm512_min_pd(v0, v1));
+}
+
+HH_INLINE V8x64F Max(const V8x64F& v0, const V8x64F& v1) {
+  return V8x64F(_mm512_max_pd(v0, v1));
+}
+
+}  // namespace HH_TARGET_NAME
+}  // namespace highwayhash
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+#endif  // HIGHWAYHASH_VECTOR512_H_
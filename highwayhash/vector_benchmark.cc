@@ -0,0 +1,77 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the latency and reciprocal throughput of each operation that the
+// hh_*.h kernels build from the vector wrappers, so that kernel changes can be
+// evaluated op by op. Prints core clock cycles per call if the hardware
+// counters are available (Linux), otherwise ticks (see tsc_timer.h).
+
+#include <stdio.h>
+#include <vector>
+
+#include "highwayhash/instruction_sets.h"
+#include "highwayhash/nanobenchmark.h"
+#include "highwayhash/robust_statistics.h"
+#include "highwayhash/vector_benchmark_target.h"
+
+namespace highwayhash {
+namespace {
+
+#ifdef HH_DISABLE_TARGET_SPECIFIC
+void RunBenchmarks() {}
+#else
+
+// Returns ticks or cycles per call of the operation, i.e. the increase of the
+// median duration from the smaller to the larger number of calls divided by
+// the additional calls. This cancels the loop and timer overhead.
+float PerCall(const DurationsForInputs& input_map, const bool cycles) {
+  float values[2];
+  FuncInput inputs[2];
+  for (size_t i = 0; i < 2; ++i) {
+    const DurationsForInputs::Item& item = input_map.items[i];
+    std::vector<float> durations(item.durations,
+                                 item.durations + item.num_durations);
+    values[i] = cycles ? item.events.cycles : Median(&durations);
+    inputs[i] = item.input;
+  }
+  return (values[1] - values[0]) / (static_cast<float>(inputs[1]) -
+                                    static_cast<float>(inputs[0]));
+}
+
+// VectorBenchmark callback.
+void Print(const char* op_name, const char* target_name,
+           DurationsForInputs* latency, DurationsForInputs* throughput,
+           void* context) {
+  const bool cycles = latency->items[0].events.cycles >= 0.0f &&
+                      throughput->items[0].events.cycles >= 0.0f;
+  printf("%10s %-18s latency %5.2f  reciprocal throughput %5.2f %s\n",
+         target_name, op_name, PerCall(*latency, cycles),
+         PerCall(*throughput, cycles), cycles ? "cycles" : "ticks");
+  latency->num_items = 0;
+  throughput->num_items = 0;
+}
+
+void RunBenchmarks() {
+  InstructionSets::RunAll<VectorBenchmark>(&Print, nullptr);
+}
+
+#endif  // HH_DISABLE_TARGET_SPECIFIC
+
+}  // namespace
+}  // namespace highwayhash
+
+int main(int argc, char* argv[]) {
+  highwayhash::RunBenchmarks();
+  return 0;
+}
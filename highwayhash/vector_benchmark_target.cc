@@ -0,0 +1,253 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// WARNING: this is a "restricted" source file; avoid including any headers
+// unless they are also restricted. See arch_specific.h for details.
+
+#include "highwayhash/vector_benchmark_target.h"
+
+#include "highwayhash/arch_specific.h"
+
+#ifndef HH_DISABLE_TARGET_SPECIFIC
+#if HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/hh_avx512.h"
+#elif HH_TARGET == HH_TARGET_AVX2
+#include "highwayhash/hh_avx2.h"
+#elif HH_TARGET == HH_TARGET_SSE41
+#include "highwayhash/hh_sse41.h"
+#elif HH_TARGET == HH_TARGET_NEON
+#include "highwayhash/hh_neon.h"
+#elif HH_TARGET == HH_TARGET_Portable || HH_TARGET == HH_TARGET_Generic
+// (No vector wrapper class, see vector_test_target.cc.)
+#else
+#error "Unknown target, add its include here."
+#endif
+
+#include "highwayhash/compiler_specific.h"
+#include "highwayhash/nanobenchmark.h"
+
+namespace highwayhash {
+namespace HH_TARGET_NAME {
+
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2 || \
+    HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+
+namespace {
+
+// Total number of calls per measurement. Dividing the difference between the
+// two durations by that of the inputs cancels the loop and timer overhead.
+const FuncInput kNumCalls[] = {256, 512};
+
+// Few samples suffice because the durations hardly vary.
+constexpr size_t kMaxDurations = 7;
+
+// Prevents the compiler from folding consecutive calls (e.g. two
+// Rotate64By32 are the identity) without emitting any instruction.
+template <class V>
+HH_INLINE void Launder(V* HH_RESTRICT v) {
+  typename V::Intrinsic raw = *v;
+#if HH_MSC_VERSION
+  // (MSVC has no x64 inline assembly; the fence is weaker but suffices in
+  // practice because the intrinsics are opaque.)
+  HH_COMPILER_FENCE;
+#elif HH_TARGET == HH_TARGET_NEON
+  asm volatile("" : "+w"(raw));
+#else
+  asm volatile("" : "+x"(raw));
+#endif
+  *v = V(raw);
+}
+
+// Returns the lower 64 (or 32 for V4x32U) bits, without a store to memory.
+#if HH_TARGET == HH_TARGET_NEON
+HH_INLINE FuncOutput Lane0(const V2x64U& v) { return vgetq_lane_u64(v, 0); }
+#else
+HH_INLINE FuncOutput Lane0(const V2x64U& v) { return _mm_cvtsi128_si64(v); }
+HH_INLINE FuncOutput Lane0(const V4x32U& v) {
+  return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+#if HH_TARGET != HH_TARGET_SSE41
+HH_INLINE FuncOutput Lane0(const V4x64U& v) {
+  return _mm_cvtsi128_si64(_mm256_castsi256_si128(v));
+}
+#endif
+#endif
+
+// Measures the latency and reciprocal throughput of "op", a V -> V function.
+// The chains start with zero (num_calls >> 32), which is unknown to the
+// compiler; the duration of the operations does not depend on their
+// inputs, but the loads use lane 0 as an offset into LoadBuffer.
+template <class V, class Op>
+void MeasureOp(const char* caption, const Op& op,
+               const NotifyVectorBenchmark notify, void* context) {
+  DurationsForInputs latency_map = MakeDurationsForInputs(kNumCalls,
+                                                          kMaxDurations);
+  latency_map.measure_events = true;
+  MeasureClosureDurations(
+      [&op](const FuncInput num_calls) {
+        V v(static_cast<typename V::T>(num_calls >> 32));
+        for (size_t i = 0; i < num_calls; ++i) {
+          v = op(v);
+          Launder(&v);
+        }
+        return Lane0(v);
+      },
+      &latency_map);
+
+  DurationsForInputs throughput_map = MakeDurationsForInputs(kNumCalls,
+                                                             kMaxDurations);
+  throughput_map.measure_events = true;
+  MeasureClosureDurations(
+      [&op](const FuncInput num_calls) {
+        V v[kVectorBenchmarkChains];
+        for (size_t c = 0; c < kVectorBenchmarkChains; ++c) {
+          v[c] = V(static_cast<typename V::T>(num_calls >> 32));
+          Launder(&v[c]);  // prevents merging the first calls of all chains
+        }
+        for (size_t i = 0; i < num_calls; i += kVectorBenchmarkChains) {
+          // (Fully unrolled by the compiler, so v[] remains in registers.)
+          for (size_t c = 0; c < kVectorBenchmarkChains; ++c) {
+            v[c] = op(v[c]);
+            Launder(&v[c]);
+          }
+        }
+        FuncOutput sum = 0;
+        for (size_t c = 0; c < kVectorBenchmarkChains; ++c) {
+          sum += Lane0(v[c]);
+        }
+        return sum;
+      },
+      &throughput_map);
+
+  notify(caption, TargetName(HH_TARGET), &latency_map, &throughput_map,
+         context);
+}
+
+// The loads read from a zero-filled buffer, and their result (zero) is added
+// to the address of the next load, so the latency also includes moving lane 0
+// to a general-purpose register.
+struct LoadBuffer {
+  HH_ALIGNAS(64) char bytes[64] = {0};
+};
+
+}  // namespace
+
+// Befriended by the HHState* classes to call their private operations.
+class VectorBenchmarkOps {
+ public:
+#if HH_TARGET == HH_TARGET_AVX512
+  using State = HHStateAVX512;
+#elif HH_TARGET == HH_TARGET_AVX2
+  using State = HHStateAVX2;
+#elif HH_TARGET == HH_TARGET_SSE41
+  using State = HHStateSSE41;
+#elif HH_TARGET == HH_TARGET_NEON
+  using State = HHStateNEON;
+#endif
+
+  static void Run(const NotifyVectorBenchmark notify, void* context) {
+    // Arbitrary constant operand for the binary operations.
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    // (Opaque to the compiler because the closures are called via pointer.)
+    LoadBuffer buffer;
+    const char* bytes = buffer.bytes;
+
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2
+    const V4x64U k4(k);
+    const V8x32U count(5);
+    MeasureOp<V4x64U>(
+        "Permute", [](const V4x64U& v) { return State::Permute(v); }, notify,
+        context);
+    MeasureOp<V4x64U>(
+        "ZipperMerge", [](const V4x64U& v) { return State::ZipperMerge(v); },
+        notify, context);
+    MeasureOp<V4x64U>(
+        "Rotate64By32", [](const V4x64U& v) { return State::Rotate64By32(v); },
+        notify, context);
+    MeasureOp<V4x64U>(
+        "Rotate32By",
+        [&count](const V4x64U& v) { return State::Rotate32By(v, count); },
+        notify, context);
+    MeasureOp<V4x64U>(
+        "MulLow32", [&k4](const V4x64U& v) { return State::MulLow32(v, k4); },
+        notify, context);
+    MeasureOp<V4x64U>(
+        "ModularReduction",
+        [&k4](const V4x64U& v) { return State::ModularReduction(v, k4); },
+        notify, context);
+#endif
+
+#if HH_TARGET == HH_TARGET_AVX512
+    MeasureOp<V4x64U>(
+        "LoadSuffix",
+        [bytes](const V4x64U& v) {
+          // 11 bytes after the 5 valid bytes of the (aligned) buffer.
+          const char* from = bytes + 32 + Lane0(v);
+          return V4x64U(State::LoadSuffix(from, 11, bytes, 5));
+        },
+        notify, context);
+#elif HH_TARGET == HH_TARGET_AVX2
+    MeasureOp<V4x32U>(
+        "MaskedLoadInt",
+        [bytes](const V4x32U& v) {
+          const V4x32U int_mask = IntMask<0>()(V4x32U(11));
+          return State::MaskedLoadInt(bytes + Lane0(v), int_mask);
+        },
+        notify, context);
+    MeasureOp<V4x32U>(
+        "Load0To16",
+        [bytes](const V4x32U& v) {
+          return State::Load0To16<>(bytes + Lane0(v), 11, V4x32U(11));
+        },
+        notify, context);
+#elif HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+    const V2x64U k2(k);
+    MeasureOp<V2x64U>(
+        "ZipperMerge", [](const V2x64U& v) { return State::ZipperMerge(v); },
+        notify, context);
+    MeasureOp<V2x64U>(
+        "Rotate64By32", [](const V2x64U& v) { return State::Rotate64By32(v); },
+        notify, context);
+    MeasureOp<V2x64U>(
+        "ModularReduction",
+        [&k2](const V2x64U& v) { return State::ModularReduction(v, k2); },
+        notify, context);
+    MeasureOp<V2x64U>(
+        "LoadMultipleOfFour",
+        [bytes](const V2x64U& v) {
+          return State::LoadMultipleOfFour(bytes + Lane0(v), 12);
+        },
+        notify, context);
+#endif
+  }
+};
+
+#endif  // HH_TARGET has vector wrappers
+
+}  // namespace HH_TARGET_NAME
+
+template <TargetBits Target>
+void VectorBenchmark<Target>::operator()(const NotifyVectorBenchmark notify,
+                                         void* context) const {
+#if HH_TARGET == HH_TARGET_AVX512 || HH_TARGET == HH_TARGET_AVX2 || \
+    HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
+  HH_TARGET_NAME::VectorBenchmarkOps::Run(notify, context);
+#endif
+}
+
+// Instantiate for the current target.
+template struct VectorBenchmark<HH_TARGET>;
+
+}  // namespace highwayhash
+#endif  // HH_DISABLE_TARGET_SPECIFIC
@@ -0,0 +1,51 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HIGHWAYHASH_VECTOR_BENCHMARK_TARGET_H_
+#define HIGHWAYHASH_VECTOR_BENCHMARK_TARGET_H_
+
+// WARNING: this is a "restricted" header because it is included from
+// translation units compiled with different flags. This header and its
+// dependencies must not define any function unless it is static inline and/or
+// within namespace HH_TARGET_NAME. See arch_specific.h for details.
+
+#include "highwayhash/arch_specific.h"
+#include "highwayhash/nanobenchmark.h"
+
+namespace highwayhash {
+
+// Called by VectorBenchmark with op_name, target_name, latency, throughput,
+// context. "latency" holds the durations of a chain of dependent calls and
+// "throughput" those of kVectorBenchmarkChains independent chains; for both,
+// the input of each item is the total number of calls.
+using NotifyVectorBenchmark = void (*)(const char*, const char*,
+                                       DurationsForInputs*,
+                                       DurationsForInputs*, void*);
+
+// Number of independent chains for measuring reciprocal throughput; enough to
+// cover the latency of any of the operations times the number of ports.
+constexpr size_t kVectorBenchmarkChains = 8;
+
+// Usage: InstructionSets::RunAll<VectorBenchmark>(notify, context). Measures
+// the operations of the HHState* classes built on the vector wrappers
+// (vector128.h, vector256.h, vector_neon.h) and calls "notify" once per
+// operation. Targets without these wrappers measure nothing.
+template <TargetBits Target>
+struct VectorBenchmark {
+  void operator()(NotifyVectorBenchmark notify, void* context) const;
+};
+
+}  // namespace highwayhash
+
+#endif  // HIGHWAYHASH_VECTOR_BENCHMARK_TARGET_H_
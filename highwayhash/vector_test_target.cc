@@ -20,13 +20,15 @@
 #include "highwayhash/arch_specific.h"
 
 #ifndef HH_DISABLE_TARGET_SPECIFIC
-#if HH_TARGET == HH_TARGET_AVX2
+#if HH_TARGET == HH_TARGET_AVX512
+#include "highwayhash/vector512.h"
+#elif HH_TARGET == HH_TARGET_AVX2
 #include "highwayhash/vector256.h"
 #elif HH_TARGET == HH_TARGET_SSE41
 #include "highwayhash/vector128.h"
 #elif HH_TARGET == HH_TARGET_NEON
 #include "highwayhash/vector_neon.h"
-#elif HH_TARGET == HH_TARGET_Portable
+#elif HH_TARGET == HH_TARGET_Portable || HH_TARGET == HH_TARGET_Generic
 #include "highwayhash/scalar.h"
 #else
 #error "Unknown target, add its include here."
@@ -36,13 +38,18 @@ namespace highwayhash {
 namespace HH_TARGET_NAME {
 namespace {
 
-#if HH_TARGET == HH_TARGET_AVX2
+#if HH_TARGET == HH_TARGET_AVX512
+template <typename T>
+using V = V512<T>;
+#elif HH_TARGET == HH_TARGET_AVX2
 template <typename T>
 using V = V256<T>;
 #elif HH_TARGET == HH_TARGET_SSE41 || HH_TARGET == HH_TARGET_NEON
 template <typename T>
 using V = V128<T>;
-#elif HH_TARGET == HH_TARGET_Portable
+#elif HH_TARGET == HH_TARGET_Portable || HH_TARGET == HH_TARGET_Generic
+// (Generic has no vector wrapper class; hh_generic.h uses the compiler
+// vector extensions directly.)
 template <typename T>
 using V = Scalar<T>;
 #else
@@ -52,7 +59,7 @@ using V = Scalar<T>;
 template <class T>
 void NotifyIfUnequal(const V<T>& v, const T expected, const size_t line,
                      const HHNotify notify) {
-  HH_ALIGNAS(32) T lanes[V<T>::N];
+  HH_ALIGNAS(64) T lanes[V<T>::N];
   Store(v, lanes);
   for (size_t i = 0; i < V<T>::N; ++i) {
     if (lanes[i] != expected) {
@@ -158,7 +165,7 @@ void TestShifts(const HHNotify notify) {
 template <class T>
 void TestLoadStore(const HHNotify notify) {
   const size_t n = V<T>::N;
-  HH_ALIGNAS(32) T lanes[2 * n];
+  HH_ALIGNAS(64) T lanes[2 * n];
   for (size_t i = 0; i < n; ++i) {
     lanes[i] = 4;
   }
@@ -170,7 +177,7 @@ void TestLoadStore(const HHNotify notify) {
   NotifyIfUnequal(v4, T(4), __LINE__, notify);
 
   // Aligned store
-  HH_ALIGNAS(32) T lanes4[n];
+  HH_ALIGNAS(64) T lanes4[n];
   Store(v4, lanes4);
   NotifyIfUnequal(Load<V<T>>(lanes4), T(4), __LINE__, notify);
 
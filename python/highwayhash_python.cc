@@ -0,0 +1,453 @@
+// Copyright 2017 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// CPython extension module "highwayhash". Accepts any contiguous object that
+// supports the buffer protocol (bytes, bytearray, memoryview, mmap, numpy
+// arrays, Arrow buffers) without copying it, and releases the GIL while
+// hashing large inputs so that other threads can run. Uses the best
+// implementation for the current CPU via HighwayHashDispatch, so the module
+// needs no special compiler flags.
+//
+// Keys are sequences of four integers, e.g. (1, 2, 3, 4). Single hashes are
+// returned as int, with element [0] of HHResult128/256 in the least
+// significant bits. Batch and column hashes are stored as consecutive native
+// HHResult in a bytearray (or writable buffer "out"), e.g. for
+// numpy.frombuffer(hashes, dtype=numpy.uint64).
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "highwayhash/highwayhash_dispatch.h"
+
+namespace highwayhash {
+namespace {
+
+// The GIL is released while hashing at least this many bytes. Releasing and
+// reacquiring it costs about as much as hashing this many bytes, so smaller
+// inputs are hashed while holding it.
+const size_t kReleaseGilBytes = 8192;
+
+bool KeyFromPython(PyObject* object, HHKey* key) {
+  PyObject* sequence = PySequence_Fast(object, "key must be a sequence");
+  if (sequence == nullptr) return false;
+  bool ok = PySequence_Fast_GET_SIZE(sequence) == 4;
+  if (!ok) {
+    PyErr_SetString(PyExc_ValueError, "key must have four elements");
+  }
+  for (Py_ssize_t i = 0; ok && i < 4; ++i) {
+    const unsigned long long word =
+        PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(sequence, i));
+    ok = !PyErr_Occurred();  // also if not an int or out of range
+    (*key)[i] = static_cast<uint64_t>(word);
+  }
+  Py_DECREF(sequence);
+  return ok;
+}
+
+// Releases the buffer when leaving the scope.
+class ScopedBuffer {
+ public:
+  ScopedBuffer() { view_.obj = nullptr; }
+  ScopedBuffer(const ScopedBuffer&) = delete;
+  ScopedBuffer& operator=(const ScopedBuffer&) = delete;
+  ~ScopedBuffer() {
+    if (view_.obj != nullptr) PyBuffer_Release(&view_);
+  }
+
+  // Returns false (with a pending exception) unless "object" is a contiguous
+  // buffer, writable if requested. "flags" may add PyBUF_FORMAT etc.
+  bool Get(PyObject* object, const int flags) {
+    return PyObject_GetBuffer(object, &view_, flags | PyBUF_C_CONTIGUOUS) == 0;
+  }
+
+  const char* data() const { return static_cast<const char*>(view_.buf); }
+  char* mutable_data() { return static_cast<char*>(view_.buf); }
+  size_t size() const { return static_cast<size_t>(view_.len); }
+  size_t itemsize() const { return static_cast<size_t>(view_.itemsize); }
+  // Only valid if Get was called with PyBUF_FORMAT.
+  const char* format() const { return view_.format; }
+
+ private:
+  Py_buffer view_;
+};
+
+// Releases the GIL for the lifetime of this object if "release".
+class ScopedAllowThreads {
+ public:
+  explicit ScopedAllowThreads(const bool release)
+      : state_(release ? PyEval_SaveThread() : nullptr) {}
+  ScopedAllowThreads(const ScopedAllowThreads&) = delete;
+  ScopedAllowThreads& operator=(const ScopedAllowThreads&) = delete;
+  ~ScopedAllowThreads() {
+    if (state_ != nullptr) PyEval_RestoreThread(state_);
+  }
+
+ private:
+  PyThreadState* const state_;
+};
+
+// Returns int from the little-endian words of "hash".
+PyObject* IntFromWords(const uint64_t* words, const size_t num_words) {
+  PyObject* result = PyLong_FromUnsignedLongLong(words[num_words - 1]);
+  for (size_t i = num_words - 1; result != nullptr && i-- != 0;) {
+    PyObject* shift = PyLong_FromLong(64);
+    PyObject* shifted =
+        shift == nullptr ? nullptr : PyNumber_Lshift(result, shift);
+    Py_XDECREF(shift);
+    Py_DECREF(result);
+    PyObject* word = PyLong_FromUnsignedLongLong(words[i]);
+    result = shifted == nullptr || word == nullptr
+                 ? nullptr
+                 : PyNumber_Or(shifted, word);
+    Py_XDECREF(shifted);
+    Py_XDECREF(word);
+  }
+  return result;
+}
+
+PyObject* IntFromHash(const HHResult64 hash) {
+  return PyLong_FromUnsignedLongLong(hash);
+}
+template <size_t kWords>
+PyObject* IntFromHash(const uint64_t (&hash)[kWords]) {
+  return IntFromWords(hash, kWords);
+}
+
+// Returns whether the struct module "format" of a buffer is a single
+// integer, e.g. "q" or "<I". A null format means unsigned bytes.
+bool IsIntegerFormat(const char* format) {
+  if (format == nullptr) return true;
+  if (format[0] != '\0' && strchr("@=<>!", format[0]) != nullptr) ++format;
+  return format[0] != '\0' && format[1] == '\0' &&
+         strchr("bBhHiIlLqQnN", format[0]) != nullptr;
+}
+
+// Returns "bytes" or, if they are not aligned for T (e.g. a memoryview
+// slice) or "always_copy", a copy in "copy". Buffers of numpy and Arrow
+// arrays are aligned.
+template <typename T>
+const T* Aligned(const char* bytes, const size_t size, std::vector<T>* copy,
+                 const bool always_copy = false) {
+  if (!always_copy && reinterpret_cast<uintptr_t>(bytes) % alignof(T) == 0) {
+    return reinterpret_cast<const T*>(bytes);
+  }
+  copy->resize(size / sizeof(T));
+  memcpy(copy->data(), bytes, copy->size() * sizeof(T));
+  return copy->data();
+}
+
+// Returns the optional "out" buffer (with a new reference) or a new bytearray
+// of "size" bytes, to which *bytes then points; null on failure.
+PyObject* OutputBuffer(PyObject* out, const size_t size, ScopedBuffer* buffer,
+                       char** bytes) {
+  if (out == nullptr || out == Py_None) {
+    PyObject* array =
+        PyByteArray_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(size));
+    if (array != nullptr) *bytes = PyByteArray_AS_STRING(array);
+    return array;
+  }
+  if (!buffer->Get(out, PyBUF_WRITABLE)) return nullptr;
+  if (buffer->size() < size) {
+    PyErr_Format(PyExc_ValueError, "out must have at least %zu bytes", size);
+    return nullptr;
+  }
+  *bytes = buffer->mutable_data();
+  Py_INCREF(out);
+  return out;
+}
+
+// hash64/128/256(key, data) -> int
+template <typename Result, HighwayHashFunctions::HashFunc<Result>
+                               HighwayHashFunctions::*Member>
+PyObject* Hash(PyObject*, PyObject* args) {
+  PyObject* key_object;
+  PyObject* data_object;
+  if (!PyArg_ParseTuple(args, "OO", &key_object, &data_object)) return nullptr;
+  HHKey key;
+  ScopedBuffer data;
+  if (!KeyFromPython(key_object, &key) ||
+      !data.Get(data_object, PyBUF_SIMPLE)) {
+    return nullptr;
+  }
+  Result hash;
+  {
+    const ScopedAllowThreads allow(data.size() >= kReleaseGilBytes);
+    (HighwayHashDispatch().*Member)(key, data.data(), data.size(), &hash);
+  }
+  return IntFromHash(hash);
+}
+
+// hash64/128/256_batch(key, messages, out=None) -> bytearray or out
+template <typename Result, HighwayHashFunctions::BatchFunc<Result>
+                               HighwayHashFunctions::*Member>
+PyObject* HashBatch(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"key", "messages", "out", nullptr};
+  PyObject* key_object;
+  PyObject* messages_object;
+  PyObject* out = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O",
+                                   const_cast<char**>(keywords), &key_object,
+                                   &messages_object, &out)) {
+    return nullptr;
+  }
+  HHKey key;
+  if (!KeyFromPython(key_object, &key)) return nullptr;
+  PyObject* sequence =
+      PySequence_Fast(messages_object, "messages must be a sequence");
+  if (sequence == nullptr) return nullptr;
+
+  // Holds the buffers (and thus prevents resizing them) until hashed.
+  const size_t num = static_cast<size_t>(PySequence_Fast_GET_SIZE(sequence));
+  std::vector<ScopedBuffer> buffers(num);
+  std::vector<StringView> views(num);
+  size_t total = 0;
+  for (size_t i = 0; i < num; ++i) {
+    if (!buffers[i].Get(PySequence_Fast_GET_ITEM(sequence, i), PyBUF_SIMPLE)) {
+      Py_DECREF(sequence);
+      return nullptr;
+    }
+    views[i].data = buffers[i].data();
+    views[i].num_bytes = buffers[i].size();
+    total += views[i].num_bytes;
+  }
+
+  ScopedBuffer out_buffer;
+  char* bytes;
+  PyObject* result = OutputBuffer(out, num * sizeof(Result), &out_buffer,
+                                  &bytes);
+  if (result != nullptr) {
+    // Aligned copy of the results, because "out" may be unaligned.
+    std::vector<Result> hashes(num);
+    {
+      const ScopedAllowThreads allow(total >= kReleaseGilBytes);
+      (HighwayHashDispatch().*Member)(key, views.data(), num, hashes.data());
+    }
+    if (num != 0) memcpy(bytes, hashes.data(), num * sizeof(Result));
+  }
+  Py_DECREF(sequence);
+  return result;
+}
+
+// hash64_values(key, values, out=None) -> bytearray or out
+PyObject* HashValues(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"key", "values", "out", nullptr};
+  PyObject* key_object;
+  PyObject* values_object;
+  PyObject* out = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O",
+                                   const_cast<char**>(keywords), &key_object,
+                                   &values_object, &out)) {
+    return nullptr;
+  }
+  HHKey key;
+  ScopedBuffer values;
+  if (!KeyFromPython(key_object, &key) ||
+      !values.Get(values_object, PyBUF_FORMAT)) {
+    return nullptr;
+  }
+  const size_t itemsize = values.itemsize();
+  if (!IsIntegerFormat(values.format()) || (itemsize != 4 && itemsize != 8)) {
+    PyErr_SetString(PyExc_TypeError, "values must be 32 or 64-bit integers");
+    return nullptr;
+  }
+  const size_t num = values.size() / itemsize;
+
+  ScopedBuffer out_buffer;
+  char* bytes;
+  PyObject* result = OutputBuffer(out, num * sizeof(HHResult64), &out_buffer,
+                                  &bytes);
+  if (result == nullptr) return nullptr;
+  std::vector<HHResult64> hashes(num);
+  std::vector<uint64_t> copy64;
+  std::vector<uint32_t> copy32;
+  {
+    const ScopedAllowThreads allow(values.size() >= kReleaseGilBytes);
+    if (itemsize == 8) {
+      HighwayHashDispatch().values_u64(
+          key, Aligned(values.data(), values.size(), &copy64), num,
+          hashes.data());
+    } else {
+      HighwayHashDispatch().values_u32(
+          key, Aligned(values.data(), values.size(), &copy32), num,
+          hashes.data());
+    }
+  }
+  if (num != 0) memcpy(bytes, hashes.data(), num * sizeof(HHResult64));
+  return result;
+}
+
+// Returns whether the "num_strings" + 1 "offsets" are non-decreasing and
+// within [0, data_size], so that hashing cannot read outside "data".
+template <typename Offset>
+bool ValidOffsets(const Offset* offsets, const size_t num_strings,
+                  const size_t data_size) {
+  if (offsets[0] < 0 ||
+      static_cast<uint64_t>(offsets[num_strings]) > data_size) {
+    return false;
+  }
+  for (size_t i = 0; i < num_strings; ++i) {
+    if (offsets[i + 1] < offsets[i]) return false;
+  }
+  return true;
+}
+
+// hash64_offsets(key, data, offsets, validity=None, out=None)
+//   -> bytearray or out
+PyObject* HashOffsets(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"key",      "data", "offsets",
+                                   "validity", "out",  nullptr};
+  PyObject* key_object;
+  PyObject* data_object;
+  PyObject* offsets_object;
+  PyObject* validity_object = nullptr;
+  PyObject* out = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|OO",
+                                   const_cast<char**>(keywords), &key_object,
+                                   &data_object, &offsets_object,
+                                   &validity_object, &out)) {
+    return nullptr;
+  }
+  HHKey key;
+  ScopedBuffer data;
+  ScopedBuffer offsets;
+  if (!KeyFromPython(key_object, &key) ||
+      !data.Get(data_object, PyBUF_SIMPLE) ||
+      !offsets.Get(offsets_object, PyBUF_FORMAT)) {
+    return nullptr;
+  }
+  const size_t itemsize = offsets.itemsize();
+  if (!IsIntegerFormat(offsets.format()) || (itemsize != 4 && itemsize != 8) ||
+      offsets.size() < itemsize) {
+    PyErr_SetString(PyExc_TypeError,
+                    "offsets must be at least one 32 or 64-bit integer");
+    return nullptr;
+  }
+  const size_t num = offsets.size() / itemsize - 1;
+  // Other threads may modify "offsets" while the GIL is released, so validate
+  // and then hash a private copy. Otherwise, no other Python code can run.
+  const bool release_gil = data.size() >= kReleaseGilBytes;
+  std::vector<int32_t> copy32;
+  std::vector<int64_t> copy64;
+  const int32_t* offsets32 = nullptr;
+  const int64_t* offsets64 = nullptr;
+  if (itemsize == 4) {
+    offsets32 = Aligned(offsets.data(), offsets.size(), &copy32, release_gil);
+  } else {
+    offsets64 = Aligned(offsets.data(), offsets.size(), &copy64, release_gil);
+  }
+  const bool valid = offsets32 != nullptr
+                         ? ValidOffsets(offsets32, num, data.size())
+                         : ValidOffsets(offsets64, num, data.size());
+  if (!valid) {
+    PyErr_SetString(PyExc_ValueError,
+                    "offsets must be non-decreasing and within data");
+    return nullptr;
+  }
+  ScopedBuffer validity;
+  const uint8_t* validity_bits = nullptr;
+  if (validity_object != nullptr && validity_object != Py_None) {
+    if (!validity.Get(validity_object, PyBUF_SIMPLE)) return nullptr;
+    if (validity.size() < (num + 7) / 8) {
+      PyErr_SetString(PyExc_ValueError, "validity has too few bits");
+      return nullptr;
+    }
+    validity_bits = reinterpret_cast<const uint8_t*>(validity.data());
+  }
+
+  ScopedBuffer out_buffer;
+  char* bytes;
+  PyObject* result = OutputBuffer(out, num * sizeof(HHResult64), &out_buffer,
+                                  &bytes);
+  if (result == nullptr) return nullptr;
+  std::vector<HHResult64> hashes(num);
+  {
+    const ScopedAllowThreads allow(release_gil);
+    if (offsets32 != nullptr) {
+      HighwayHashDispatch().offsets32(key, data.data(), offsets32,
+                                      validity_bits, num, hashes.data());
+    } else {
+      HighwayHashDispatch().offsets64(key, data.data(), offsets64,
+                                      validity_bits, num, hashes.data());
+    }
+  }
+  if (num != 0) memcpy(bytes, hashes.data(), num * sizeof(HHResult64));
+  return result;
+}
+
+template <typename Func>
+PyCFunction WithKeywords(Func func) {
+  return reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(func));
+}
+
+using F = HighwayHashFunctions;
+
+PyMethodDef kMethods[] = {
+    {"hash64", &Hash<HHResult64, &F::hash64>, METH_VARARGS,
+     "hash64(key, data) -> int: 64-bit HighwayHash of a buffer."},
+    {"hash128", &Hash<HHResult128, &F::hash128>, METH_VARARGS,
+     "hash128(key, data) -> int: 128-bit HighwayHash of a buffer."},
+    {"hash256", &Hash<HHResult256, &F::hash256>, METH_VARARGS,
+     "hash256(key, data) -> int: 256-bit HighwayHash of a buffer."},
+    {"hash64_batch", WithKeywords(&HashBatch<HHResult64, &F::batch64>),
+     METH_VARARGS | METH_KEYWORDS,
+     "hash64_batch(key, messages, out=None): 64-bit hashes of a sequence of "
+     "buffers, stored as uint64 in out or a new bytearray."},
+    {"hash128_batch", WithKeywords(&HashBatch<HHResult128, &F::batch128>),
+     METH_VARARGS | METH_KEYWORDS,
+     "hash128_batch(key, messages, out=None): as hash64_batch, two uint64 "
+     "per hash."},
+    {"hash256_batch", WithKeywords(&HashBatch<HHResult256, &F::batch256>),
+     METH_VARARGS | METH_KEYWORDS,
+     "hash256_batch(key, messages, out=None): as hash64_batch, four uint64 "
+     "per hash."},
+    {"hash64_values", WithKeywords(&HashValues), METH_VARARGS | METH_KEYWORDS,
+     "hash64_values(key, values, out=None): hash64 of the little-endian bytes "
+     "of each 32 or 64-bit integer of a buffer (e.g. a numpy array)."},
+    {"hash64_offsets", WithKeywords(&HashOffsets),
+     METH_VARARGS | METH_KEYWORDS,
+     "hash64_offsets(key, data, offsets, validity=None, out=None): hash64 of "
+     "each string of an Arrow string/binary column (e.g. the buffers of a "
+     "pyarrow array); null strings hash to zero."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef kModule = {
+    PyModuleDef_HEAD_INIT,
+    "highwayhash",
+    "HighwayHash of buffer-protocol objects without copying.",
+    -1,
+    kMethods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr};
+
+}  // namespace
+}  // namespace highwayhash
+
+PyMODINIT_FUNC PyInit_highwayhash() {
+  PyObject* module = PyModule_Create(&highwayhash::kModule);
+  if (module != nullptr &&
+      PyModule_AddIntConstant(
+          module, "RELEASE_GIL_BYTES",
+          static_cast<long>(highwayhash::kReleaseGilBytes)) != 0) {
+    Py_DECREF(module);
+    return nullptr;
+  }
+  return module;
+}
@@ -0,0 +1,144 @@
+# Copyright 2017 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests the highwayhash extension module (make lib/highwayhash.so).
+
+Usage: PYTHONPATH=lib python3 python/highwayhash_test.py
+"""
+
+import array
+import struct
+import threading
+import unittest
+
+import highwayhash
+
+KEY = (0x0706050403020100, 0x0F0E0D0C0B0A0908,
+       0x1716151413121110, 0x1F1E1D1C1B1A1918)
+
+# From highwayhash_test.cc: hashes of bytes(range(size)) under KEY.
+EXPECTED64 = {0: 0x907A56DE22C26E53, 1: 0x7EAB43AAC7CDDD78,
+              64: 0x75542C5D4CD2A6FF}
+EXPECTED128 = {0: (0x0FED268F9D8FFEC7, 0x33565E767F093E6F)}
+EXPECTED256 = {0: (0xDD44482AC2C874F5, 0xD946017313C7351F,
+                   0xB3AEBECCB98714FF, 0x41DA233145751DF4)}
+
+
+def ToInt(words):
+  return sum(word << (64 * i) for i, word in enumerate(words))
+
+
+class HighwayHashTest(unittest.TestCase):
+
+  def testExpected(self):
+    for size, expected in EXPECTED64.items():
+      self.assertEqual(expected, highwayhash.hash64(KEY, bytes(range(size))))
+    self.assertEqual(ToInt(EXPECTED128[0]), highwayhash.hash128(KEY, b''))
+    self.assertEqual(ToInt(EXPECTED256[0]), highwayhash.hash256(KEY, b''))
+
+  def testBufferTypes(self):
+    data = bytes(range(64))
+    expected = highwayhash.hash64(KEY, data)
+    for view in (bytearray(data), memoryview(data), array.array('B', data),
+                 array.array('Q', data).tobytes(), memoryview(data).cast('Q')):
+      self.assertEqual(expected, highwayhash.hash64(KEY, view))
+    with self.assertRaises(BufferError):
+      highwayhash.hash64(KEY, memoryview(data)[::2])  # not contiguous
+    with self.assertRaises(ValueError):
+      highwayhash.hash64(KEY[:3], data)
+
+  def testBatch(self):
+    messages = [bytes(range(size)) for size in range(100)]
+    for bits, func, batch in ((64, highwayhash.hash64,
+                               highwayhash.hash64_batch),
+                              (128, highwayhash.hash128,
+                               highwayhash.hash128_batch),
+                              (256, highwayhash.hash256,
+                               highwayhash.hash256_batch)):
+      hashes = batch(KEY, messages)
+      words = bits // 64
+      self.assertEqual(len(messages) * words * 8, len(hashes))
+      values = struct.unpack('=%dQ' % (len(messages) * words), hashes)
+      for i, message in enumerate(messages):
+        self.assertEqual(func(KEY, message),
+                         ToInt(values[i * words:(i + 1) * words]))
+
+    out = bytearray(8 * len(messages) + 3)
+    self.assertIs(out, highwayhash.hash64_batch(KEY, messages, out=out))
+    self.assertEqual(highwayhash.hash64_batch(KEY, messages), out[:-3])
+    with self.assertRaises(ValueError):
+      highwayhash.hash64_batch(KEY, messages, out=bytearray(8))
+
+  def testValues(self):
+    for typecode in ('Q', 'q', 'I', 'i'):
+      values = array.array(typecode, range(1000))
+      hashes = array.array('Q', highwayhash.hash64_values(KEY, values))
+      for value, hash64 in zip(values, hashes):
+        self.assertEqual(highwayhash.hash64(KEY, array.array(typecode,
+                                                             [value])), hash64)
+    with self.assertRaises(TypeError):
+      highwayhash.hash64_values(KEY, b'12345678')
+    for typecode in ('d', 'f'):  # same size as integers, but not integers
+      with self.assertRaises(TypeError):
+        highwayhash.hash64_values(KEY, array.array(typecode, [1.0]))
+
+  def testOffsets(self):
+    strings = [b'', b'a', b'bc', b'', b'hello world' * 10]
+    data = b''.join(strings)
+    for typecode in ('i', 'q'):
+      offsets = array.array(typecode, [0])
+      for s in strings:
+        offsets.append(offsets[-1] + len(s))
+      hashes = array.array('Q', highwayhash.hash64_offsets(KEY, data, offsets))
+      self.assertEqual([highwayhash.hash64(KEY, s) for s in strings],
+                       list(hashes))
+      # Strings 1 and 3 are null.
+      hashes = array.array('Q', highwayhash.hash64_offsets(
+          KEY, data, offsets, validity=bytes([0b10101])))
+      self.assertEqual([highwayhash.hash64(KEY, strings[0]), 0,
+                        highwayhash.hash64(KEY, strings[2]), 0,
+                        highwayhash.hash64(KEY, strings[4])], list(hashes))
+      with self.assertRaises(ValueError):
+        highwayhash.hash64_offsets(KEY, data[:-1], offsets)
+      with self.assertRaises(ValueError):
+        highwayhash.hash64_offsets(KEY, data, offsets[::-1])
+    with self.assertRaises(TypeError):
+      highwayhash.hash64_offsets(KEY, data, array.array('d', [0.0, 1.0]))
+    # Large enough to release the GIL, which hashes a copy of the offsets.
+    data = bytes(range(256)) * 64
+    offsets = array.array('q', range(0, len(data) + 1, 256))
+    hashes = array.array('Q', highwayhash.hash64_offsets(KEY, data, offsets))
+    self.assertEqual([highwayhash.hash64(KEY, bytes(range(256)))] * 64,
+                     list(hashes))
+
+  def testThreads(self):
+    # Large enough to release the GIL.
+    data = bytes(range(256)) * 4096
+    expected = highwayhash.hash128(KEY, data)
+    results = []
+
+    def Run():
+      for _ in range(10):
+        results.append(highwayhash.hash128(KEY, data) == expected)
+
+    threads = [threading.Thread(target=Run) for _ in range(4)]
+    for thread in threads:
+      thread.start()
+    for thread in threads:
+      thread.join()
+    self.assertEqual([True] * 40, results)
+
+
+if __name__ == '__main__':
+  unittest.main()